@@ -1,5 +1,6 @@
 #include "App.h"
 
+#include <chrono>
 #include "Utils.h"
 #include "Graphics/Renderer.h"
 #include "SDL.h"
@@ -11,6 +12,8 @@ namespace WoohooDX12
     m_window = std::make_shared<MainWindow>();
     m_core = std::make_shared<WohCore>();
     m_scene = std::make_shared<Scene>();
+    m_jobSystem = std::make_shared<JobSystem>();
+    m_scene->SetJobSystem(m_jobSystem);
   }
 
   App::~App()
@@ -19,6 +22,7 @@ namespace WoohooDX12
 
     m_core = nullptr;
     m_scene = nullptr;
+    m_jobSystem = nullptr;
     m_window = nullptr;
   }
 
@@ -36,6 +40,7 @@ namespace WoohooDX12
 
   void App::Run()
   {
+    std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
     while (!m_quit)
     {
       bool shouldRender = true;
@@ -47,8 +52,19 @@ namespace WoohooDX12
         {
           m_quit = true;
         }
+        else if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.sym == SDLK_F9 && sdlEvent.key.repeat == 0)
+        {
+          m_core->ToggleCapture();
+        }
       }
 
+      const std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+      const float deltaTime = std::chrono::duration<float>(time - lastTime).count();
+      lastTime = time;
+
+      if (!m_quit)
+        m_scene->Update(deltaTime);
+
       if (shouldRender && !m_quit)
       {
         // TODO create a class that app can access Renderer via WohCore->GetRenderer()->RenderImGui()
@@ -3,6 +3,7 @@
 #include <memory>
 #include "MainWindow.h"
 #include "WohCore.h"
+#include "Jobs/JobSystem.h"
 
 namespace WoohooDX12
 {
@@ -22,6 +23,7 @@ namespace WoohooDX12
     std::shared_ptr<MainWindow> m_window = nullptr;
     std::shared_ptr<WohCore> m_core = nullptr;
     std::shared_ptr<Scene> m_scene = nullptr;
+    std::shared_ptr<JobSystem> m_jobSystem = nullptr;
     bool m_quit = false;
   };
 }
@@ -0,0 +1,363 @@
+#include "FrameEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include "Utils.h"
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    uint32 Crc32(uint32 crc, const uint8* data, size_t size)
+    {
+      static const std::array<uint32, 256> table = []()
+      {
+        std::array<uint32, 256> result = {};
+        for (uint32 n = 0; n < 256; ++n)
+        {
+          uint32 c = n;
+          for (uint32 k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+          result[n] = c;
+        }
+        return result;
+      }();
+
+      crc = ~crc;
+      for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+      return ~crc;
+    }
+
+    void PutBigEndian(std::vector<uint8>& out, uint32 value)
+    {
+      out.push_back((uint8)(value >> 24));
+      out.push_back((uint8)(value >> 16));
+      out.push_back((uint8)(value >> 8));
+      out.push_back((uint8)value);
+    }
+
+    void WriteChunk(std::ofstream& stream, const char* type, const std::vector<uint8>& data)
+    {
+      std::vector<uint8> chunk;
+      chunk.reserve(data.size() + 12);
+      PutBigEndian(chunk, (uint32)data.size());
+      chunk.insert(chunk.end(), type, type + 4);
+      chunk.insert(chunk.end(), data.begin(), data.end());
+      PutBigEndian(chunk, Crc32(0, chunk.data() + 4, data.size() + 4));
+      stream.write((const char*)chunk.data(), chunk.size());
+    }
+
+    String MakeFramePath(const String& outputPath, uint64 frameIndex, const char* extension)
+    {
+      char fileName[64];
+      snprintf(fileName, sizeof(fileName), "frame_%06llu.%s", (unsigned long long)frameIndex, extension);
+      return (std::filesystem::path(outputPath) / fileName).string();
+    }
+  }
+
+  FrameEncoder::~FrameEncoder()
+  {
+    Stop();
+  }
+
+  int FrameEncoder::Start(const String& outputPath, CaptureFormat format, CaptureOverflowPolicy policy, uint32 maxQueuedFrames)
+  {
+    if (m_running)
+      return -1;
+
+    std::error_code error;
+    std::filesystem::create_directories(outputPath, error);
+    if (error)
+    {
+      Log("Failed to create capture directory: " + outputPath, LogType::LT_ERROR);
+      return -1;
+    }
+
+    m_outputPath = outputPath;
+    m_format = format;
+    m_policy = policy;
+    m_maxQueuedFrames = maxQueuedFrames > 0 ? maxQueuedFrames : 1;
+    m_encodedCount = 0;
+    m_droppedCount = 0;
+    m_stopRequested = false;
+    m_running = true;
+
+    m_worker = std::thread(&FrameEncoder::WorkerMain, this);
+
+    return 0;
+  }
+
+  int FrameEncoder::Stop()
+  {
+    if (!m_running)
+      return 0;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopRequested = true;
+    }
+    m_queueChanged.notify_all();
+    m_worker.join();
+
+    m_running = false;
+    m_freeBuffers.clear();
+
+    return 0;
+  }
+
+  CapturedFrame FrameEncoder::AcquireFrame(uint32 width, uint32 height)
+  {
+    CapturedFrame frame;
+    frame.width = width;
+    frame.height = height;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_freeBuffers.empty())
+      {
+        frame.pixels = std::move(m_freeBuffers.back());
+        m_freeBuffers.pop_back();
+      }
+    }
+    frame.pixels.resize((size_t)width * height * 4);
+
+    return frame;
+  }
+
+  bool FrameEncoder::Submit(CapturedFrame&& frame)
+  {
+    assert(frame.pixels.size() == (size_t)frame.width * frame.height * 4 && "Captured frame must be tightly packed RGBA8!");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopRequested)
+      return false;
+
+    if (m_queue.size() >= m_maxQueuedFrames)
+    {
+      if (m_policy == CaptureOverflowPolicy::Drop)
+      {
+        m_droppedCount++;
+        m_freeBuffers.push_back(std::move(frame.pixels));
+        return false;
+      }
+
+      m_queueChanged.wait(lock, [this] { return m_queue.size() < m_maxQueuedFrames; });
+    }
+
+    m_queue.push_back(std::move(frame));
+    lock.unlock();
+    m_queueChanged.notify_all();
+
+    return true;
+  }
+
+  void FrameEncoder::WorkerMain()
+  {
+    m_sequenceWidth = 0;
+    m_sequenceHeight = 0;
+    m_sequenceCount = 0;
+
+    while (true)
+    {
+      CapturedFrame frame;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queueChanged.wait(lock, [this] { return !m_queue.empty() || m_stopRequested; });
+        if (m_queue.empty())
+          break; // Stop requested and everything is flushed
+
+        frame = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      // Wake up a producer blocked on a full queue
+      m_queueChanged.notify_all();
+
+      Encode(frame);
+      m_encodedCount++;
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_freeBuffers.push_back(std::move(frame.pixels));
+    }
+
+    if (m_sequenceStream.is_open())
+      m_sequenceStream.close();
+  }
+
+  void FrameEncoder::Encode(const CapturedFrame& frame)
+  {
+    switch (m_format)
+    {
+    case CaptureFormat::Raw:
+      WriteRaw(MakeFramePath(m_outputPath, frame.frameIndex, "rgba"), frame);
+      break;
+    case CaptureFormat::PNG:
+      WritePNG(MakeFramePath(m_outputPath, frame.frameIndex, "png"), frame);
+      break;
+    case CaptureFormat::Y4M:
+      // The size of a sequence is fixed by its header, a resized back buffer goes to a new file
+      if (frame.width != m_sequenceWidth || frame.height != m_sequenceHeight)
+        BeginSequence(frame.width, frame.height);
+      WriteY4MFrame(m_sequenceStream, frame, m_scratch);
+      break;
+    }
+  }
+
+  void FrameEncoder::BeginSequence(uint32 width, uint32 height)
+  {
+    if (m_sequenceStream.is_open())
+      m_sequenceStream.close();
+
+    m_sequenceStream.open(MakeSequencePath(m_outputPath, m_sequenceCount), std::ios::out | std::ios::binary);
+    WriteY4MHeader(m_sequenceStream, width, height);
+    m_sequenceWidth = width;
+    m_sequenceHeight = height;
+    m_sequenceCount++;
+  }
+
+  bool FrameEncoder::WritePNG(const String& path, const CapturedFrame& frame)
+  {
+    std::ofstream stream(path, std::ios::out | std::ios::binary);
+    if (!stream)
+      return false;
+
+    static const uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    stream.write((const char*)signature, sizeof(signature));
+
+    std::vector<uint8> header;
+    PutBigEndian(header, frame.width);
+    PutBigEndian(header, frame.height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+    WriteChunk(stream, "IHDR", header);
+
+    // zlib stream made of uncompressed deflate blocks, each scanline is prefixed with filter type 0.
+    // Captures favour encoding speed over file size.
+    const size_t rowSize = (size_t)frame.width * 4;
+    const size_t rawSize = (rowSize + 1) * frame.height;
+    const size_t maxBlockSize = 65535;
+
+    std::vector<uint8> data;
+    data.reserve(rawSize + (rawSize / maxBlockSize + 1) * 5 + 6);
+    data.push_back(0x78);
+    data.push_back(0x01);
+
+    uint32 adlerA = 1;
+    uint32 adlerB = 0;
+    size_t blockRemaining = 0;
+    size_t rawRemaining = rawSize;
+    auto putByte = [&](uint8 value)
+    {
+      if (blockRemaining == 0)
+      {
+        const uint16 blockSize = (uint16)(rawRemaining < maxBlockSize ? rawRemaining : maxBlockSize);
+        data.push_back(rawRemaining <= maxBlockSize ? 1 : 0); // final block flag
+        data.push_back((uint8)blockSize);
+        data.push_back((uint8)(blockSize >> 8));
+        data.push_back((uint8)~blockSize);
+        data.push_back((uint8)(~blockSize >> 8));
+        blockRemaining = blockSize;
+      }
+      data.push_back(value);
+      adlerA = (adlerA + value) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+      blockRemaining--;
+      rawRemaining--;
+    };
+
+    for (uint32 y = 0; y < frame.height; ++y)
+    {
+      putByte(0);
+      const uint8* row = frame.pixels.data() + rowSize * y;
+      for (size_t x = 0; x < rowSize; ++x)
+        putByte(row[x]);
+    }
+    PutBigEndian(data, (adlerB << 16) | adlerA);
+
+    WriteChunk(stream, "IDAT", data);
+    WriteChunk(stream, "IEND", std::vector<uint8>());
+
+    return stream.good();
+  }
+
+  bool FrameEncoder::WriteRaw(const String& path, const CapturedFrame& frame)
+  {
+    std::ofstream stream(path, std::ios::out | std::ios::binary);
+    if (!stream)
+      return false;
+
+    stream.write((const char*)frame.pixels.data(), frame.pixels.size());
+    return stream.good();
+  }
+
+  void FrameEncoder::WriteY4MHeader(std::ostream& stream, uint32 width, uint32 height)
+  {
+    stream << "YUV4MPEG2 W" << width << " H" << height << " F60:1 Ip A1:1 C420jpeg\n";
+  }
+
+  String FrameEncoder::MakeSequencePath(const String& outputPath, uint32 sequenceIndex)
+  {
+    if (sequenceIndex == 0)
+      return (std::filesystem::path(outputPath) / "capture.y4m").string();
+
+    return (std::filesystem::path(outputPath) / ("capture_" + std::to_string(sequenceIndex) + ".y4m")).string();
+  }
+
+  void FrameEncoder::WriteY4MFrame(std::ostream& stream, const CapturedFrame& frame, std::vector<uint8>& scratch)
+  {
+    const uint32 width = frame.width;
+    const uint32 height = frame.height;
+    const uint32 chromaWidth = (width + 1) / 2;
+    const uint32 chromaHeight = (height + 1) / 2;
+
+    scratch.resize((size_t)width * height + (size_t)chromaWidth * chromaHeight * 2);
+    uint8* planeY = scratch.data();
+    uint8* planeU = planeY + (size_t)width * height;
+    uint8* planeV = planeU + (size_t)chromaWidth * chromaHeight;
+
+    // BT.601 full range, fixed point
+    auto pixel = [&](uint32 x, uint32 y) { return frame.pixels.data() + ((size_t)y * width + x) * 4; };
+    for (uint32 y = 0; y < height; ++y)
+    {
+      for (uint32 x = 0; x < width; ++x)
+      {
+        const uint8* p = pixel(x, y);
+        planeY[(size_t)y * width + x] = (uint8)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+      }
+    }
+
+    for (uint32 y = 0; y < chromaHeight; ++y)
+    {
+      for (uint32 x = 0; x < chromaWidth; ++x)
+      {
+        // Average the 2x2 block, clamped at the right and bottom edges
+        int r = 0, g = 0, b = 0;
+        for (uint32 i = 0; i < 4; ++i)
+        {
+          const uint32 sx = std::min(x * 2 + (i & 1), width - 1);
+          const uint32 sy = std::min(y * 2 + (i >> 1), height - 1);
+          const uint8* p = pixel(sx, sy);
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+        r = (r + 2) >> 2;
+        g = (g + 2) >> 2;
+        b = (b + 2) >> 2;
+
+        // Saturated blue and red round up to 256
+        planeU[(size_t)y * chromaWidth + x] = (uint8)std::min((-43 * r - 85 * g + 128 * b + 128 * 256 + 128) >> 8, 255);
+        planeV[(size_t)y * chromaWidth + x] = (uint8)std::min((128 * r - 107 * g - 21 * b + 128 * 256 + 128) >> 8, 255);
+      }
+    }
+
+    stream << "FRAME\n";
+    stream.write((const char*)scratch.data(), scratch.size());
+  }
+}
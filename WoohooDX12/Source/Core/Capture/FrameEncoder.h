@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  enum class CaptureFormat
+  {
+    Raw, // One .rgba file per frame, tightly packed RGBA8
+    PNG, // One .png file per frame
+    Y4M  // One .y4m sequence per frame size (4:2:0), a frame of another size starts the next file
+  };
+
+  // What to do when the encoder can not keep up with the submitted frames
+  enum class CaptureOverflowPolicy
+  {
+    Drop, // Discard the new frame
+    Block // Wait until the encoder makes room
+  };
+
+  // Tightly packed RGBA8 frame
+  struct CapturedFrame
+  {
+    uint32 width = 0;
+    uint32 height = 0;
+    uint64 frameIndex = 0;
+    std::vector<uint8> pixels;
+  };
+
+  /*
+  * Encodes captured frames to disk on a worker thread.
+  * Pixel buffers are recycled between frames, use AcquireFrame() to get a frame to fill and Submit() to hand it over.
+  */
+  class FrameEncoder
+  {
+  public:
+    FrameEncoder() {}
+    ~FrameEncoder();
+
+    int Start(const String& outputPath, CaptureFormat format, CaptureOverflowPolicy policy, uint32 maxQueuedFrames = 4);
+    int Stop(); // Flushes the queued frames
+
+    CapturedFrame AcquireFrame(uint32 width, uint32 height);
+    bool Submit(CapturedFrame&& frame); // Returns false if the frame is dropped
+
+    inline bool IsRunning() const { return m_running; }
+    inline uint64 GetEncodedCount() const { return m_encodedCount; }
+    inline uint64 GetDroppedCount() const { return m_droppedCount; }
+
+    static bool WritePNG(const String& path, const CapturedFrame& frame);
+    static bool WriteRaw(const String& path, const CapturedFrame& frame);
+    static void WriteY4MHeader(std::ostream& stream, uint32 width, uint32 height);
+    // capture.y4m for the first sequence of a capture, capture_<index>.y4m for the next ones
+    static String MakeSequencePath(const String& outputPath, uint32 sequenceIndex);
+    static void WriteY4MFrame(std::ostream& stream, const CapturedFrame& frame, std::vector<uint8>& scratch);
+
+  private:
+    void WorkerMain();
+    void Encode(const CapturedFrame& frame);
+    // Closes the current sequence and opens the next one with the header of the frame size
+    void BeginSequence(uint32 width, uint32 height);
+
+  private:
+    String m_outputPath;
+    CaptureFormat m_format = CaptureFormat::PNG;
+    CaptureOverflowPolicy m_policy = CaptureOverflowPolicy::Drop;
+    uint32 m_maxQueuedFrames = 4;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_queueChanged;
+    std::deque<CapturedFrame> m_queue;
+    std::vector<std::vector<uint8>> m_freeBuffers;
+    bool m_running = false;
+    bool m_stopRequested = false;
+
+    // Worker only
+    std::ofstream m_sequenceStream;
+    uint32 m_sequenceWidth = 0;
+    uint32 m_sequenceHeight = 0;
+    uint32 m_sequenceCount = 0;
+    std::vector<uint8> m_scratch;
+
+    std::atomic<uint64> m_encodedCount = 0;
+    std::atomic<uint64> m_droppedCount = 0;
+  };
+}
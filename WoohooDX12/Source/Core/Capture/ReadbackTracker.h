@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Bookkeeping of a ring of readback slots, independent of the graphics API.
+  * A slot is acquired, submitted with the fence value that marks the end of its copy and retired once the GPU
+  * passed that fence value. Slots are retired in submission order.
+  */
+  class ReadbackTracker
+  {
+  public:
+    static constexpr uint32 InvalidSlot = 0xFFFFFFFF;
+
+    explicit ReadbackTracker(uint32 slotCount = 0) { Reset(slotCount); }
+
+    void Reset(uint32 slotCount)
+    {
+      m_fenceValues.assign(slotCount, 0);
+      m_next = 0;
+      m_oldest = 0;
+      m_pendingCount = 0;
+    }
+
+    // Returns InvalidSlot if every slot is still in flight. The caller decides to drop the capture or wait.
+    inline uint32 AcquireSlot() const
+    {
+      return m_pendingCount < (uint32)m_fenceValues.size() ? m_next : InvalidSlot;
+    }
+
+    inline void Submit(uint32 slot, uint64 fenceValue)
+    {
+      m_fenceValues[slot] = fenceValue;
+      m_next = (m_next + 1) % (uint32)m_fenceValues.size();
+      m_pendingCount++;
+    }
+
+    // Calls retire(slot) for every in flight slot whose copy is done, oldest first
+    template<typename Func>
+    uint32 Retire(uint64 completedFenceValue, Func&& retire)
+    {
+      uint32 retired = 0;
+      while (m_pendingCount > 0 && m_fenceValues[m_oldest] <= completedFenceValue)
+      {
+        retire(m_oldest);
+        m_oldest = (m_oldest + 1) % (uint32)m_fenceValues.size();
+        m_pendingCount--;
+        retired++;
+      }
+      return retired;
+    }
+
+    // Fence value to wait for to free the oldest slot
+    inline uint64 GetOldestFenceValue() const { return m_pendingCount > 0 ? m_fenceValues[m_oldest] : 0; }
+    // Fence value to wait for to free every slot
+    inline uint64 GetNewestFenceValue() const
+    {
+      return m_pendingCount > 0 ? m_fenceValues[(m_next + (uint32)m_fenceValues.size() - 1) % (uint32)m_fenceValues.size()] : 0;
+    }
+
+    inline uint32 GetPendingCount() const { return m_pendingCount; }
+    inline uint32 GetSlotCount() const { return (uint32)m_fenceValues.size(); }
+
+  private:
+    std::vector<uint64> m_fenceValues;
+    uint32 m_next = 0;
+    uint32 m_oldest = 0;
+    uint32 m_pendingCount = 0;
+  };
+}
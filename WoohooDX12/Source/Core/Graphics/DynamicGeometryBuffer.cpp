@@ -0,0 +1,212 @@
+#include "DynamicGeometryBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include "Utils.h"
+#include "Memory/StreamCopy.h"
+#include "d3dx12.h"
+
+namespace WoohooDX12
+{
+  DynamicGeometryBuffer::~DynamicGeometryBuffer()
+  {
+    // UnInit should be called externally
+    assert(!m_initialized && "Dynamic geometry buffer is not uninitialized!");
+  }
+
+  int DynamicGeometryBuffer::Init(ID3D12Device* device, uint32 pageSize)
+  {
+    AssertAndReturn(!m_initialized, "This dynamic geometry buffer is already initialized.");
+
+    m_device = device;
+    m_pageSize = pageSize;
+
+    Page* page = nullptr;
+    ReturnIfFailed(CreatePage(m_pageSize, page));
+    m_currentPage = page;
+    m_framePages.push_back(page);
+    m_offset = 0;
+
+    m_initialized = true;
+
+    return 0;
+  }
+
+  int DynamicGeometryBuffer::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    // The GPU should be idle here
+    for (Page* page : m_pages)
+    {
+      page->buffer->Unmap(0, nullptr);
+      page->buffer->Release();
+      delete page;
+    }
+    m_pages.clear();
+    m_freePages.clear();
+    m_framePages.clear();
+    m_retiredPages.clear();
+    m_currentPage = nullptr;
+    m_device = nullptr;
+
+    m_initialized = false;
+
+    return 0;
+  }
+
+  void DynamicGeometryBuffer::BeginFrame(uint64 completedFenceValue)
+  {
+    while (!m_retiredPages.empty() && m_retiredPages.front()->fenceValue <= completedFenceValue)
+    {
+      Page* page = m_retiredPages.front();
+      m_retiredPages.pop_front();
+
+      // Dedicated pages of big allocations are not kept around
+      if (page->size > m_pageSize)
+        ReleasePage(page);
+      else
+        m_freePages.push_back(page);
+    }
+
+    m_frameBytes = 0;
+  }
+
+  void DynamicGeometryBuffer::EndFrame(uint64 frameFenceValue)
+  {
+    // Keep writing into the current page if nothing was written this frame
+    if (m_frameBytes == 0)
+      return;
+
+    for (Page* page : m_framePages)
+    {
+      page->fenceValue = frameFenceValue;
+      m_retiredPages.push_back(page);
+    }
+    m_framePages.clear();
+    m_currentPage = nullptr;
+    m_offset = 0;
+  }
+
+  int DynamicGeometryBuffer::Allocate(uint32 size, uint32 alignment, DynamicAllocation& allocation)
+  {
+    assert(m_initialized && "Dynamic geometry buffer is not initialized!");
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+    uint32 alignedOffset = (m_offset + alignment - 1) & ~(alignment - 1);
+    if (m_currentPage == nullptr || alignedOffset + size > m_currentPage->size)
+    {
+      ReturnIfFailed(NextPage(size));
+      alignedOffset = 0;
+    }
+
+    allocation.cpuAddress = m_currentPage->cpuAddress + alignedOffset;
+    allocation.gpuAddress = m_currentPage->gpuAddress + alignedOffset;
+    allocation.size = size;
+
+    m_offset = alignedOffset + size;
+    m_frameBytes += size;
+
+    return 0;
+  }
+
+  int DynamicGeometryBuffer::WriteVertices(const void* vertices, uint32 vertexCount, uint32 stride, D3D12_VERTEX_BUFFER_VIEW& view)
+  {
+    DynamicAllocation allocation;
+    ReturnIfFailed(Allocate(vertexCount * stride, 16, allocation));
+    StreamCopy(allocation.cpuAddress, vertices, allocation.size);
+
+    view.BufferLocation = allocation.gpuAddress;
+    view.StrideInBytes = stride;
+    view.SizeInBytes = allocation.size;
+
+    return 0;
+  }
+
+  int DynamicGeometryBuffer::WriteIndices(const void* indices, uint32 indexCount, DXGI_FORMAT format, D3D12_INDEX_BUFFER_VIEW& view)
+  {
+    assert((format == DXGI_FORMAT_R16_UINT || format == DXGI_FORMAT_R32_UINT) && "Invalid index format!");
+
+    const uint32 indexSize = format == DXGI_FORMAT_R16_UINT ? 2 : 4;
+    DynamicAllocation allocation;
+    ReturnIfFailed(Allocate(indexCount * indexSize, 16, allocation));
+    StreamCopy(allocation.cpuAddress, indices, allocation.size);
+
+    view.BufferLocation = allocation.gpuAddress;
+    view.Format = format;
+    view.SizeInBytes = allocation.size;
+
+    return 0;
+  }
+
+  int DynamicGeometryBuffer::CreatePage(uint32 size, Page*& page)
+  {
+    D3D12_HEAP_PROPERTIES uploadHeapProps = {};
+    uploadHeapProps.Type = D3D12_HEAP_TYPE_UPLOAD; // write-combined
+    uploadHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    uploadHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    uploadHeapProps.CreationNodeMask = 1;
+    uploadHeapProps.VisibleNodeMask = 1;
+
+    const D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+    Page* newPage = new Page();
+    newPage->size = size;
+    if (FAILED(m_device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&newPage->buffer))))
+    {
+      delete newPage;
+      return -1;
+    }
+    newPage->buffer->SetName(L"Dynamic Geometry Page");
+
+    // Mapped for the whole lifetime of the page. We never read from it on the CPU.
+    const D3D12_RANGE readRange = { 0, 0 };
+    if (FAILED(newPage->buffer->Map(0, &readRange, reinterpret_cast<void**>(&newPage->cpuAddress))))
+    {
+      newPage->buffer->Release();
+      delete newPage;
+      return -1;
+    }
+    newPage->gpuAddress = newPage->buffer->GetGPUVirtualAddress();
+
+    m_pages.push_back(newPage);
+    page = newPage;
+
+    return 0;
+  }
+
+  void DynamicGeometryBuffer::ReleasePage(Page* page)
+  {
+    m_pages.erase(std::remove(m_pages.begin(), m_pages.end(), page), m_pages.end());
+    page->buffer->Unmap(0, nullptr);
+    page->buffer->Release();
+    delete page;
+  }
+
+  int DynamicGeometryBuffer::NextPage(uint32 minSize)
+  {
+    Page* page = nullptr;
+    if (minSize > m_pageSize)
+    {
+      // Dedicated overflow page
+      ReturnIfFailed(CreatePage(minSize, page));
+    }
+    else if (!m_freePages.empty())
+    {
+      page = m_freePages.back();
+      m_freePages.pop_back();
+    }
+    else
+    {
+      ReturnIfFailed(CreatePage(m_pageSize, page));
+    }
+
+    m_framePages.push_back(page);
+    m_currentPage = page;
+    m_offset = 0;
+
+    return 0;
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <d3d12.h>
+#include <deque>
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  // Transient memory for one frame, valid until the GPU finishes the frame it was allocated in
+  struct DynamicAllocation
+  {
+    uint8* cpuAddress = nullptr; // Write only, write-combined memory
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+    uint32 size = 0;
+  };
+
+  /*
+  * Streaming buffer for geometry that changes every frame (debug lines, UI, CPU animated meshes, etc.).
+  * Vertices are written straight into persistently mapped upload heap pages with a bump allocator, so no copy to a
+  * default heap is needed. Pages written in a frame are retired with that frame's fence value and reused once the GPU
+  * passed it, which gives one set of pages per frame in flight. When a page is full the allocator moves to a free page or
+  * creates an overflow page, allocations bigger than a page get a dedicated page which is released after use.
+  */
+  class DynamicGeometryBuffer
+  {
+  public:
+    static constexpr uint32 DefaultPageSize = 1024 * 1024;
+
+    DynamicGeometryBuffer() {}
+    ~DynamicGeometryBuffer();
+
+    int Init(ID3D12Device* device, uint32 pageSize = DefaultPageSize);
+    int UnInit();
+
+    // Recycles the pages of the frames the GPU has finished
+    void BeginFrame(uint64 completedFenceValue);
+    // Retires the pages written this frame, they are reused after the GPU passes frameFenceValue
+    void EndFrame(uint64 frameFenceValue);
+
+    int Allocate(uint32 size, uint32 alignment, DynamicAllocation& allocation);
+
+    // Streams the data with non-temporal stores and fills the views
+    int WriteVertices(const void* vertices, uint32 vertexCount, uint32 stride, D3D12_VERTEX_BUFFER_VIEW& view);
+    int WriteIndices(const void* indices, uint32 indexCount, DXGI_FORMAT format, D3D12_INDEX_BUFFER_VIEW& view);
+
+    inline uint32 GetPageCount() const { return (uint32)m_pages.size(); }
+    inline uint64 GetFrameBytes() const { return m_frameBytes; }
+
+  private:
+    struct Page
+    {
+      ID3D12Resource* buffer = nullptr;
+      uint8* cpuAddress = nullptr;
+      D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+      uint32 size = 0;
+      uint64 fenceValue = 0;
+    };
+
+    int CreatePage(uint32 size, Page*& page);
+    void ReleasePage(Page* page);
+    int NextPage(uint32 minSize);
+
+  private:
+    ID3D12Device* m_device = nullptr;
+    uint32 m_pageSize = DefaultPageSize;
+
+    std::vector<Page*> m_pages; // All pages, owning
+    std::vector<Page*> m_freePages;
+    std::vector<Page*> m_framePages; // Pages written in the current frame
+    std::deque<Page*> m_retiredPages; // In fence order
+
+    Page* m_currentPage = nullptr;
+    uint32 m_offset = 0;
+    uint64 m_frameBytes = 0;
+
+    bool m_initialized = false;
+  };
+}
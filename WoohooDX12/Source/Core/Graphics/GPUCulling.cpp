@@ -0,0 +1,206 @@
+#include "GPUCulling.h"
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    // Keep in step with the CPU passes below
+    const char* CullingShaderSource = R"(
+#define CULL_GROUP_SIZE 64
+#define SCAN_GROUP_SIZE 1024
+#define CULLED_OFFSET 0xFFFFFFFF
+
+cbuffer CullConstants : register(b0)
+{
+  float4 planes[6];
+  uint objectCount;
+  uint groupCount;
+};
+
+struct IndirectDrawCommand
+{
+  uint2 vertexBufferAddress;
+  uint vertexBufferSize;
+  uint vertexStride;
+  uint2 indexBufferAddress;
+  uint indexBufferSize;
+  uint indexFormat;
+  uint objectIndex;
+  uint indexCountPerInstance;
+  uint instanceCount;
+  uint startIndexLocation;
+  int baseVertexLocation;
+  uint startInstanceLocation;
+};
+
+StructuredBuffer<float4> objects : register(t0);
+StructuredBuffer<IndirectDrawCommand> commands : register(t1);
+RWStructuredBuffer<uint> localOffsets : register(u0);
+RWStructuredBuffer<uint> groupCounts : register(u1);
+RWStructuredBuffer<uint> groupOffsets : register(u2);
+RWStructuredBuffer<IndirectDrawCommand> output : register(u3);
+
+groupshared uint visibleFlags[CULL_GROUP_SIZE];
+groupshared uint partialSums[SCAN_GROUP_SIZE];
+
+[numthreads(CULL_GROUP_SIZE, 1, 1)]
+void CullMain(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID, uint3 dispatchId : SV_DispatchThreadID)
+{
+  const uint index = dispatchId.x;
+  bool visible = false;
+  if (index < objectCount)
+  {
+    const float4 sphere = objects[index];
+    visible = true;
+    [unroll]
+    for (uint plane = 0; plane < 6; ++plane)
+    {
+      precise float distance = planes[plane].x * sphere.x + planes[plane].w;
+      distance = planes[plane].y * sphere.y + distance;
+      distance = planes[plane].z * sphere.z + distance;
+      visible = visible && distance >= -sphere.w;
+    }
+  }
+  visibleFlags[threadId.x] = visible ? 1 : 0;
+  GroupMemoryBarrierWithGroupSync();
+
+  uint offset = 0;
+  for (uint thread = 0; thread < threadId.x; ++thread)
+    offset += visibleFlags[thread];
+
+  if (index < objectCount)
+    localOffsets[index] = visible ? offset : CULLED_OFFSET;
+  if (threadId.x == CULL_GROUP_SIZE - 1)
+    groupCounts[groupId.x] = offset + visibleFlags[threadId.x];
+}
+
+[numthreads(SCAN_GROUP_SIZE, 1, 1)]
+void ScanMain(uint3 threadId : SV_GroupThreadID)
+{
+  const uint chunkSize = (groupCount + SCAN_GROUP_SIZE - 1) / SCAN_GROUP_SIZE;
+  const uint begin = min(threadId.x * chunkSize, groupCount);
+  const uint end = min(begin + chunkSize, groupCount);
+
+  uint sum = 0;
+  for (uint group = begin; group < end; ++group)
+    sum += groupCounts[group];
+  partialSums[threadId.x] = sum;
+  GroupMemoryBarrierWithGroupSync();
+
+  if (threadId.x == 0)
+  {
+    uint total = 0;
+    for (uint thread = 0; thread < SCAN_GROUP_SIZE; ++thread)
+    {
+      const uint partialSum = partialSums[thread];
+      partialSums[thread] = total;
+      total += partialSum;
+    }
+    groupOffsets[groupCount] = total;
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  uint offset = partialSums[threadId.x];
+  for (uint chunkGroup = begin; chunkGroup < end; ++chunkGroup)
+  {
+    groupOffsets[chunkGroup] = offset;
+    offset += groupCounts[chunkGroup];
+  }
+}
+
+[numthreads(CULL_GROUP_SIZE, 1, 1)]
+void CompactMain(uint3 groupId : SV_GroupID, uint3 dispatchId : SV_DispatchThreadID)
+{
+  const uint index = dispatchId.x;
+  if (index >= objectCount)
+    return;
+
+  const uint localOffset = localOffsets[index];
+  if (localOffset != CULLED_OFFSET)
+    output[groupOffsets[groupId.x] + localOffset] = commands[index];
+}
+)";
+  }
+
+  GPUCullConstants GPUCulling::MakeConstants(const Frustum& frustum, uint32 objectCount)
+  {
+    GPUCullConstants constants;
+    for (uint32 i = 0; i < 6; ++i)
+      constants.planes[i] = frustum.planes[i];
+    constants.objectCount = objectCount;
+    constants.groupCount = GetGroupCount(objectCount);
+    return constants;
+  }
+
+  const char* GPUCulling::GetShaderSource()
+  {
+    return CullingShaderSource;
+  }
+
+  void GPUCulling::CullGroups(const GPUCullConstants& constants, const GPUCullObject* objects, uint32* localOffsets, uint32* groupCounts)
+  {
+    for (uint32 group = 0; group < constants.groupCount; ++group)
+    {
+      // Threads of the group in order, the running count is the offset of the next visible object
+      uint32 offset = 0;
+      for (uint32 thread = 0; thread < CullGroupSize; ++thread)
+      {
+        const uint32 index = group * CullGroupSize + thread;
+        if (index >= constants.objectCount)
+          break;
+
+        const GPUCullObject& sphere = objects[index];
+        bool visible = true;
+        for (const Vec4& plane : constants.planes)
+        {
+          float distance = plane.x * sphere.center[0] + plane.w;
+          distance = plane.y * sphere.center[1] + distance;
+          distance = plane.z * sphere.center[2] + distance;
+          visible = visible && distance >= -sphere.radius;
+        }
+
+        localOffsets[index] = visible ? offset : CulledOffset;
+        offset += visible ? 1 : 0;
+      }
+      groupCounts[group] = offset;
+    }
+  }
+
+  uint32 GPUCulling::ScanGroups(const GPUCullConstants& constants, const uint32* groupCounts, uint32* groupOffsets)
+  {
+    uint32 total = 0;
+    for (uint32 group = 0; group < constants.groupCount; ++group)
+    {
+      groupOffsets[group] = total;
+      total += groupCounts[group];
+    }
+    groupOffsets[constants.groupCount] = total;
+
+    return total;
+  }
+
+  void GPUCulling::Compact(const GPUCullConstants& constants, const IndirectDrawCommand* commands, const uint32* localOffsets, const uint32* groupOffsets,
+    IndirectDrawCommand* output)
+  {
+    for (uint32 index = 0; index < constants.objectCount; ++index)
+    {
+      const uint32 localOffset = localOffsets[index];
+      if (localOffset != CulledOffset)
+        output[groupOffsets[index / CullGroupSize] + localOffset] = commands[index];
+    }
+  }
+
+  uint32 GPUCulling::Cull(const Frustum& frustum, const GPUCullObject* objects, const IndirectDrawCommand* commands, uint32 objectCount, IndirectDrawCommand* output)
+  {
+    const GPUCullConstants constants = MakeConstants(frustum, objectCount);
+    m_localOffsets.resize(objectCount);
+    m_groupCounts.resize(constants.groupCount);
+    m_groupOffsets.resize(constants.groupCount + 1);
+
+    CullGroups(constants, objects, m_localOffsets.data(), m_groupCounts.data());
+    const uint32 drawCount = ScanGroups(constants, m_groupCounts.data(), m_groupOffsets.data());
+    Compact(constants, commands, m_localOffsets.data(), m_groupOffsets.data(), output);
+
+    return drawCount;
+  }
+}
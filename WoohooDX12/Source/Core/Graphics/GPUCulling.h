@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Scene/Culling/FrustumCulling.h"
+
+namespace WoohooDX12
+{
+  // Bounding sphere of an object in the GPU object buffer
+  struct GPUCullObject
+  {
+    float center[3];
+    float radius;
+  };
+
+  // One ExecuteIndirect command: vertex buffer view, index buffer view, the object index root constant and the indexed draw
+  // arguments. Same layout as the D3D12 structures so it does not depend on D3D.
+  struct IndirectDrawCommand
+  {
+    uint64 vertexBufferAddress = 0;
+    uint32 vertexBufferSize = 0;
+    uint32 vertexStride = 0;
+    uint64 indexBufferAddress = 0;
+    uint32 indexBufferSize = 0;
+    uint32 indexFormat = 0; // DXGI_FORMAT
+    uint32 objectIndex = 0; // Instance data of the object
+    uint32 indexCountPerInstance = 0;
+    uint32 instanceCount = 1;
+    uint32 startIndexLocation = 0;
+    int32 baseVertexLocation = 0;
+    uint32 startInstanceLocation = 0;
+  };
+  static_assert(sizeof(IndirectDrawCommand) == 56, "IndirectDrawCommand has to match the command signature");
+
+  // Root constants of the culling passes
+  struct GPUCullConstants
+  {
+    Vec4 planes[6];
+    uint32 objectCount = 0;
+    uint32 groupCount = 0;
+  };
+
+  /*
+  * Culling and compaction of the indirect draws, on the GPU and as a CPU reference of the same kernel.
+  * Three passes keep the output order independent of the thread scheduling:
+  *   Cull: every object is tested against the frustum planes, a group writes the offsets of its visible objects in
+  *         thread order and its visible count.
+  *   Scan: one group turns the counts into group offsets, the total is written after them and is the draw count.
+  *   Compact: the commands of the visible objects are copied to their group offset plus their offset in the group.
+  * The sphere test has the operation order of FrustumCuller::CullScalar and the shader marks it precise, so the results
+  * match bit for bit as long as the CPU side is compiled without contracting into FMA (GCC and Clang: -ffp-contract=off).
+  */
+  class GPUCulling
+  {
+  public:
+    static constexpr uint32 CullGroupSize = 64;
+    static constexpr uint32 ScanGroupSize = 1024;
+    static constexpr uint32 CulledOffset = 0xFFFFFFFF;
+
+    static inline uint32 GetGroupCount(uint32 objectCount) { return (objectCount + CullGroupSize - 1) / CullGroupSize; }
+    static GPUCullConstants MakeConstants(const Frustum& frustum, uint32 objectCount);
+    // HLSL of the three compute passes, entry points CullMain, ScanMain and CompactMain
+    static const char* GetShaderSource();
+
+    // The passes of the kernel, one call runs every group of the pass
+    static void CullGroups(const GPUCullConstants& constants, const GPUCullObject* objects, uint32* localOffsets, uint32* groupCounts);
+    // groupOffsets has groupCount + 1 entries, the last one is the total, returned too
+    static uint32 ScanGroups(const GPUCullConstants& constants, const uint32* groupCounts, uint32* groupOffsets);
+    static void Compact(const GPUCullConstants& constants, const IndirectDrawCommand* commands, const uint32* localOffsets, const uint32* groupOffsets,
+      IndirectDrawCommand* output);
+
+    // All passes with reused scratch buffers, output needs room for objectCount commands. Returns the draw count.
+    uint32 Cull(const Frustum& frustum, const GPUCullObject* objects, const IndirectDrawCommand* commands, uint32 objectCount, IndirectDrawCommand* output);
+
+    inline const std::vector<uint32>& GetLocalOffsets() const { return m_localOffsets; }
+    inline const std::vector<uint32>& GetGroupOffsets() const { return m_groupOffsets; }
+
+  private:
+    std::vector<uint32> m_localOffsets;
+    std::vector<uint32> m_groupCounts;
+    std::vector<uint32> m_groupOffsets;
+  };
+}
@@ -0,0 +1,405 @@
+#include "GPUDrivenPipeline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include "Material.h"
+#include "Utils.h"
+#include "VertexInputLayout.h"
+
+namespace WoohooDX12
+{
+  // The commands are read by the command signature as these structures
+  static_assert(offsetof(IndirectDrawCommand, indexBufferAddress) == sizeof(D3D12_VERTEX_BUFFER_VIEW), "Invalid indirect command layout!");
+  static_assert(offsetof(IndirectDrawCommand, objectIndex) == sizeof(D3D12_VERTEX_BUFFER_VIEW) + sizeof(D3D12_INDEX_BUFFER_VIEW), "Invalid indirect command layout!");
+  static_assert(sizeof(IndirectDrawCommand) - offsetof(IndirectDrawCommand, indexCountPerInstance) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), "Invalid indirect command layout!");
+
+  namespace
+  {
+    // Root parameters
+    enum ComputeParameter : uint32 { CullConstantsParameter, ObjectsParameter, CommandsParameter, LocalOffsetsParameter, GroupCountsParameter,
+      GroupOffsetsParameter, DrawCommandsParameter, ComputeParameterCount };
+    enum DrawParameter : uint32 { CameraParameter, ObjectIndexParameter, InstancesParameter, DrawParameterCount };
+
+    // The object index comes from the command, the world matrix and colour from the instance buffer
+    const char* DrawShaderSource = R"(
+cbuffer Camera : register(b0)
+{
+  row_major float4x4 projectionMatrix;
+  row_major float4x4 viewMatrix;
+};
+
+cbuffer Object : register(b1)
+{
+  uint objectIndex;
+};
+
+struct InstanceData
+{
+  float3 world0;
+  float3 world1;
+  float3 world2;
+  float3 world3;
+  float4 color;
+};
+
+StructuredBuffer<InstanceData> instances : register(t0);
+
+struct VertexInput
+{
+  float3 position : POSITION;
+  float3 color : COLOR;
+};
+
+struct PixelInput
+{
+  float4 position : SV_POSITION;
+  float4 color : COLOR;
+};
+
+PixelInput VSMain(VertexInput input)
+{
+  const InstanceData instance = instances[objectIndex];
+  const float3 worldPosition = input.position.x * instance.world0 + input.position.y * instance.world1 + input.position.z * instance.world2 + instance.world3;
+
+  PixelInput output;
+  output.position = mul(mul(float4(worldPosition, 1.0f), viewMatrix), projectionMatrix);
+  output.color = float4(input.color, 1.0f) * instance.color;
+  return output;
+}
+
+float4 PSMain(PixelInput input) : SV_TARGET
+{
+  return input.color;
+}
+)";
+
+    int CreateRootSignature(ID3D12Device* device, const D3D12_ROOT_PARAMETER1* parameters, uint32 parameterCount, D3D12_ROOT_SIGNATURE_FLAGS flags,
+      ID3D12RootSignature** rootSignature)
+    {
+      D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
+      rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+      rootSignatureDesc.Desc_1_1.Flags = flags;
+      rootSignatureDesc.Desc_1_1.NumParameters = parameterCount;
+      rootSignatureDesc.Desc_1_1.pParameters = parameters;
+
+      ID3DBlob* signature = nullptr;
+      ID3DBlob* error = nullptr;
+      if (FAILED(D3D12SerializeVersionedRootSignature(&rootSignatureDesc, &signature, &error)))
+      {
+        if (error != nullptr)
+        {
+          Log((const char*)error->GetBufferPointer(), LogType::LT_ERROR);
+          error->Release();
+        }
+        return -1;
+      }
+
+      const HRESULT result = device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(rootSignature));
+      signature->Release();
+      ReturnIfFailed(result);
+
+      return 0;
+    }
+
+    D3D12_ROOT_PARAMETER1 MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE type, uint32 shaderRegister, D3D12_SHADER_VISIBILITY visibility)
+    {
+      D3D12_ROOT_PARAMETER1 parameter = {};
+      parameter.ParameterType = type;
+      parameter.Descriptor.ShaderRegister = shaderRegister;
+      parameter.Descriptor.RegisterSpace = 0;
+      parameter.Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE;
+      parameter.ShaderVisibility = visibility;
+      return parameter;
+    }
+
+    D3D12_ROOT_PARAMETER1 MakeRootConstants(uint32 shaderRegister, uint32 valueCount, D3D12_SHADER_VISIBILITY visibility)
+    {
+      D3D12_ROOT_PARAMETER1 parameter = {};
+      parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+      parameter.Constants.ShaderRegister = shaderRegister;
+      parameter.Constants.RegisterSpace = 0;
+      parameter.Constants.Num32BitValues = valueCount;
+      parameter.ShaderVisibility = visibility;
+      return parameter;
+    }
+
+    D3D12_RESOURCE_BARRIER MakeTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+    {
+      D3D12_RESOURCE_BARRIER barrier = {};
+      barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+      barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+      barrier.Transition.pResource = resource;
+      barrier.Transition.StateBefore = before;
+      barrier.Transition.StateAfter = after;
+      barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+      return barrier;
+    }
+  }
+
+  GPUDrivenPipeline::~GPUDrivenPipeline()
+  {
+    // UnInit should be called externally
+    assert(!m_initialized && "GPU driven pipeline is not uninitialized!");
+  }
+
+  int GPUDrivenPipeline::Init(ID3D12Device* device, const VertexLayout& vertexLayout)
+  {
+    if (m_initialized)
+      return -1;
+
+    m_device = device;
+    m_initialized = true;
+
+    if (CreateRootSignatures() != 0 || CreatePipelineStates(vertexLayout) != 0 || CreateCommandSignature() != 0)
+    {
+      Log("Failed to create the GPU driven pipeline!", LogType::LT_ERROR);
+      UnInit();
+      return -1;
+    }
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    ReleaseBuffers();
+
+    ID3D12DeviceChild* objects[] = { m_commandSignature, m_drawPipelineState, m_compactPipelineState, m_scanPipelineState, m_cullPipelineState,
+      m_drawRootSignature, m_computeRootSignature };
+    for (ID3D12DeviceChild* object : objects)
+    {
+      if (object != nullptr)
+        object->Release();
+    }
+    m_commandSignature = nullptr;
+    m_drawPipelineState = nullptr;
+    m_compactPipelineState = nullptr;
+    m_scanPipelineState = nullptr;
+    m_cullPipelineState = nullptr;
+    m_drawRootSignature = nullptr;
+    m_computeRootSignature = nullptr;
+
+    m_device = nullptr;
+    m_initialized = false;
+    return 0;
+  }
+
+  int GPUDrivenPipeline::Record(ID3D12GraphicsCommandList* commandList, const GPUDrivenFrame& frame, const GPUCullConstants& constants)
+  {
+    if (constants.objectCount == 0)
+      return 0;
+
+    assert(constants.objectCount <= frame.capacity && "More objects than the frame has room for!");
+    assert(constants.groupCount <= D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION && "Too many objects for one dispatch!");
+    ReturnIfFailed(Reserve(constants.objectCount));
+
+    // Cull, scan and compact, every pass reads what the previous one wrote
+    commandList->SetComputeRootSignature(m_computeRootSignature);
+    commandList->SetComputeRoot32BitConstants(CullConstantsParameter, sizeof(GPUCullConstants) / sizeof(uint32), &constants, 0);
+    commandList->SetComputeRootShaderResourceView(ObjectsParameter, frame.objectsAddress);
+    commandList->SetComputeRootShaderResourceView(CommandsParameter, frame.commandsAddress);
+    commandList->SetComputeRootUnorderedAccessView(LocalOffsetsParameter, m_localOffsets->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(GroupCountsParameter, m_groupCounts->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(GroupOffsetsParameter, m_groupOffsets->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(DrawCommandsParameter, m_drawCommands->GetGPUVirtualAddress());
+
+    D3D12_RESOURCE_BARRIER uavBarrier = {};
+    uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    uavBarrier.UAV.pResource = nullptr;
+
+    commandList->SetPipelineState(m_cullPipelineState);
+    commandList->Dispatch(constants.groupCount, 1, 1);
+    commandList->ResourceBarrier(1, &uavBarrier);
+    commandList->SetPipelineState(m_scanPipelineState);
+    commandList->Dispatch(1, 1, 1);
+    commandList->ResourceBarrier(1, &uavBarrier);
+    commandList->SetPipelineState(m_compactPipelineState);
+    commandList->Dispatch(constants.groupCount, 1, 1);
+
+    // The commands and the draw count are read as indirect arguments
+    D3D12_RESOURCE_BARRIER toIndirect[] =
+    {
+      MakeTransition(m_drawCommands, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+      MakeTransition(m_groupOffsets, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT)
+    };
+    commandList->ResourceBarrier(_countof(toIndirect), toIndirect);
+
+    commandList->SetGraphicsRootSignature(m_drawRootSignature);
+    commandList->SetPipelineState(m_drawPipelineState);
+    commandList->SetGraphicsRootConstantBufferView(CameraParameter, frame.cameraAddress);
+    commandList->SetGraphicsRootShaderResourceView(InstancesParameter, frame.instancesAddress);
+    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList->ExecuteIndirect(m_commandSignature, constants.objectCount, m_drawCommands, 0, m_groupOffsets, constants.groupCount * sizeof(uint32));
+
+    D3D12_RESOURCE_BARRIER toUnorderedAccess[] =
+    {
+      MakeTransition(m_drawCommands, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+      MakeTransition(m_groupOffsets, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+    };
+    commandList->ResourceBarrier(_countof(toUnorderedAccess), toUnorderedAccess);
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::CreateRootSignatures()
+  {
+    D3D12_ROOT_PARAMETER1 computeParameters[ComputeParameterCount];
+    computeParameters[CullConstantsParameter] = MakeRootConstants(0, sizeof(GPUCullConstants) / sizeof(uint32), D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[ObjectsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[CommandsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_SRV, 1, D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[LocalOffsetsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_UAV, 0, D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[GroupCountsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_UAV, 1, D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[GroupOffsetsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_UAV, 2, D3D12_SHADER_VISIBILITY_ALL);
+    computeParameters[DrawCommandsParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_UAV, 3, D3D12_SHADER_VISIBILITY_ALL);
+    ReturnIfFailed(CreateRootSignature(m_device, computeParameters, ComputeParameterCount, D3D12_ROOT_SIGNATURE_FLAG_NONE, &m_computeRootSignature));
+    m_computeRootSignature->SetName(L"GPU Culling Root Signature");
+
+    D3D12_ROOT_PARAMETER1 drawParameters[DrawParameterCount];
+    drawParameters[CameraParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    drawParameters[ObjectIndexParameter] = MakeRootConstants(1, 1, D3D12_SHADER_VISIBILITY_VERTEX);
+    drawParameters[InstancesParameter] = MakeRootDescriptor(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    ReturnIfFailed(CreateRootSignature(m_device, drawParameters, DrawParameterCount, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT,
+      &m_drawRootSignature));
+    m_drawRootSignature->SetName(L"GPU Driven Draw Root Signature");
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::CreatePipelineStates(const VertexLayout& vertexLayout)
+  {
+    // Compute passes
+    const char* entryPoints[] = { "CullMain", "ScanMain", "CompactMain" };
+    ID3D12PipelineState** computePipelineStates[] = { &m_cullPipelineState, &m_scanPipelineState, &m_compactPipelineState };
+    for (uint32 i = 0; i < _countof(entryPoints); ++i)
+    {
+      ID3DBlob* computeShader = nullptr;
+      ReturnIfFailed(Material::CompileShaderSource(GPUCulling::GetShaderSource(), "GPUCulling", entryPoints[i], "cs_5_0", &computeShader));
+
+      D3D12_COMPUTE_PIPELINE_STATE_DESC computeDesc = {};
+      computeDesc.pRootSignature = m_computeRootSignature;
+      computeDesc.CS.pShaderBytecode = computeShader->GetBufferPointer();
+      computeDesc.CS.BytecodeLength = computeShader->GetBufferSize();
+      const HRESULT result = m_device->CreateComputePipelineState(&computeDesc, IID_PPV_ARGS(computePipelineStates[i]));
+      computeShader->Release();
+      ReturnIfFailed(result);
+    }
+
+    // Draw
+    ID3DBlob* vertexShader = nullptr;
+    ID3DBlob* pixelShader = nullptr;
+    ReturnIfFailed(Material::CompileShaderSource(DrawShaderSource, "GPUDrivenDraw", "VSMain", "vs_5_0", &vertexShader));
+    if (Material::CompileShaderSource(DrawShaderSource, "GPUDrivenDraw", "PSMain", "ps_5_0", &pixelShader) != 0)
+    {
+      vertexShader->Release();
+      return -1;
+    }
+
+    VertexInputLayout inputLayout;
+    inputLayout.Build(vertexLayout);
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+    psoDesc.InputLayout = inputLayout.GetDesc();
+    psoDesc.pRootSignature = m_drawRootSignature;
+    psoDesc.VS.pShaderBytecode = vertexShader->GetBufferPointer();
+    psoDesc.VS.BytecodeLength = vertexShader->GetBufferSize();
+    psoDesc.PS.pShaderBytecode = pixelShader->GetBufferPointer();
+    psoDesc.PS.BytecodeLength = pixelShader->GetBufferSize();
+    Material::FillPipelineState(psoDesc);
+
+    const HRESULT result = m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_drawPipelineState));
+    vertexShader->Release();
+    pixelShader->Release();
+    ReturnIfFailed(result);
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::CreateCommandSignature()
+  {
+    D3D12_INDIRECT_ARGUMENT_DESC arguments[4] = {};
+    arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+    arguments[0].VertexBuffer.Slot = 0;
+    arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+    arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+    arguments[2].Constant.RootParameterIndex = ObjectIndexParameter;
+    arguments[2].Constant.DestOffsetIn32BitValues = 0;
+    arguments[2].Constant.Num32BitValuesToSet = 1;
+    arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+    D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+    signatureDesc.ByteStride = sizeof(IndirectDrawCommand);
+    signatureDesc.NumArgumentDescs = _countof(arguments);
+    signatureDesc.pArgumentDescs = arguments;
+
+    ReturnIfFailed(m_device->CreateCommandSignature(&signatureDesc, m_drawRootSignature, IID_PPV_ARGS(&m_commandSignature)));
+    m_commandSignature->SetName(L"GPU Driven Command Signature");
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::Reserve(uint32 objectCount)
+  {
+    if (objectCount <= m_capacity)
+      return 0;
+
+    // Grows by half so a slowly growing scene does not recreate the buffers every frame
+    const uint32 capacity = std::max(objectCount, m_capacity + m_capacity / 2);
+    ReleaseBuffers();
+
+    const uint32 groupCount = GPUCulling::GetGroupCount(capacity);
+    ReturnIfFailed(CreateBuffer((uint64)capacity * sizeof(uint32), &m_localOffsets, L"GPU Culling Local Offsets"));
+    ReturnIfFailed(CreateBuffer((uint64)groupCount * sizeof(uint32), &m_groupCounts, L"GPU Culling Group Counts"));
+    ReturnIfFailed(CreateBuffer((uint64)(groupCount + 1) * sizeof(uint32), &m_groupOffsets, L"GPU Culling Group Offsets"));
+    ReturnIfFailed(CreateBuffer((uint64)capacity * sizeof(IndirectDrawCommand), &m_drawCommands, L"GPU Culling Draw Commands"));
+    m_capacity = capacity;
+
+    return 0;
+  }
+
+  int GPUDrivenPipeline::CreateBuffer(uint64 size, ID3D12Resource** buffer, const wchar_t* name)
+  {
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapProps.CreationNodeMask = 1;
+    heapProps.VisibleNodeMask = 1;
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Alignment = 0;
+    bufferDesc.Width = size;
+    bufferDesc.Height = 1;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDesc.SampleDesc.Count = 1;
+    bufferDesc.SampleDesc.Quality = 0;
+    bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+    ReturnIfFailed(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
+      IID_PPV_ARGS(buffer)));
+    (*buffer)->SetName(name);
+
+    return 0;
+  }
+
+  void GPUDrivenPipeline::ReleaseBuffers()
+  {
+    ID3D12Resource** buffers[] = { &m_localOffsets, &m_groupCounts, &m_groupOffsets, &m_drawCommands };
+    for (ID3D12Resource** buffer : buffers)
+    {
+      if (*buffer != nullptr)
+      {
+        (*buffer)->Release();
+        *buffer = nullptr;
+      }
+    }
+    m_capacity = 0;
+  }
+}
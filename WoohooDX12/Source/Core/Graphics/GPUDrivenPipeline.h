@@ -0,0 +1,75 @@
+#pragma once
+
+#include <d3d12.h>
+#include "Types.h"
+#include "GPUCulling.h"
+#include "InstanceBatcher.h"
+#include "Geometry/VertexQuantization.h"
+
+namespace WoohooDX12
+{
+  // Per frame inputs of the GPU-driven path, in upload heap memory of the frame
+  struct GPUDrivenFrame
+  {
+    GPUCullObject* objects = nullptr;
+    IndirectDrawCommand* commands = nullptr;
+    InstanceData* instances = nullptr; // Indexed by the object index of the commands
+    D3D12_GPU_VIRTUAL_ADDRESS objectsAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS commandsAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS instancesAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS cameraAddress = 0; // Projection and view matrices
+    uint8* cameraData = nullptr; // Written by the renderer
+    uint32 capacity = 0;
+    uint32 objectCount = 0;
+  };
+
+  /*
+  * GPU-driven drawing: a compute pass culls the objects and compacts their draw commands (see GPUCulling for the passes),
+  * then one ExecuteIndirect draws the survivors with the draw count written by the GPU. Every command sets its own vertex and
+  * index buffers and the object index root constant, the vertex shader reads the world matrix and colour of the object
+  * from the instance buffer.
+  * The culling buffers grow with the object count and stay in UNORDERED_ACCESS between frames.
+  */
+  class GPUDrivenPipeline
+  {
+  public:
+    GPUDrivenPipeline() {}
+    ~GPUDrivenPipeline();
+
+    // The draws read the vertices in the vertex layout
+    int Init(ID3D12Device* device, const VertexLayout& vertexLayout);
+    int UnInit();
+
+    // Records the culling passes and the indirect draws, the render target has to be bound on the command list
+    int Record(ID3D12GraphicsCommandList* commandList, const GPUDrivenFrame& frame, const GPUCullConstants& constants);
+
+  private:
+    int CreateRootSignatures();
+    int CreatePipelineStates(const VertexLayout& vertexLayout);
+    int CreateCommandSignature();
+    // The previous frame is finished, the old buffers are not in use
+    int Reserve(uint32 objectCount);
+    int CreateBuffer(uint64 size, ID3D12Resource** buffer, const wchar_t* name);
+    void ReleaseBuffers();
+
+  private:
+    ID3D12Device* m_device = nullptr;
+
+    ID3D12RootSignature* m_computeRootSignature = nullptr;
+    ID3D12RootSignature* m_drawRootSignature = nullptr;
+    ID3D12PipelineState* m_cullPipelineState = nullptr;
+    ID3D12PipelineState* m_scanPipelineState = nullptr;
+    ID3D12PipelineState* m_compactPipelineState = nullptr;
+    ID3D12PipelineState* m_drawPipelineState = nullptr;
+    ID3D12CommandSignature* m_commandSignature = nullptr;
+
+    // Written by the culling passes
+    ID3D12Resource* m_localOffsets = nullptr;
+    ID3D12Resource* m_groupCounts = nullptr;
+    ID3D12Resource* m_groupOffsets = nullptr; // The draw count follows the offsets
+    ID3D12Resource* m_drawCommands = nullptr;
+    uint32 m_capacity = 0;
+
+    bool m_initialized = false;
+  };
+}
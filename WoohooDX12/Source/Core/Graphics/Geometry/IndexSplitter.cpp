@@ -0,0 +1,160 @@
+#include "IndexSplitter.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace WoohooDX12
+{
+  bool IndexSplitter::Split(const uint32* indices, const MeshLOD* lods, uint32 lodCount, uint32 vertexCount, uint32 vertexSize, uint32 maxChunksPerLOD)
+  {
+    m_indices.clear();
+    m_chunks.clear();
+    m_lodChunkOffsets.assign(1, 0);
+    m_copiedVertices.clear();
+
+    const uint32 bucketCount = std::max(1u, (vertexCount + BucketSize - 1) / BucketSize);
+    for (uint32 lod = 0; lod < lodCount; ++lod)
+    {
+      const MeshLOD& level = lods[lod];
+      assert(level.indexCount % 3 == 0 && "Levels are triangle lists!");
+      const uint32 triangleCount = level.indexCount / 3;
+      const uint32* levelIndices = indices + level.indexOffset;
+
+      // Bucket of every triangle and the vertex range of every bucket
+      m_triangleBuckets.resize(triangleCount);
+      m_bucketMin.assign(bucketCount, 0xFFFFFFFF);
+      m_bucketMax.assign(bucketCount, 0);
+      m_wideTriangles.clear();
+      for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+      {
+        const uint32* corners = levelIndices + triangle * 3;
+        const uint32 triangleMin = std::min(corners[0], std::min(corners[1], corners[2]));
+        const uint32 triangleMax = std::max(corners[0], std::max(corners[1], corners[2]));
+        assert(triangleMax < vertexCount && "Index out of the vertices!");
+
+        const uint32 bucket = triangleMin / BucketSize;
+        if (triangleMax >= bucket * BucketSize + MaxVertexSpan)
+        {
+          m_triangleBuckets[triangle] = WideTriangle;
+          m_wideTriangles.push_back(level.indexOffset + triangle * 3);
+          continue;
+        }
+
+        m_triangleBuckets[triangle] = bucket;
+        m_bucketMin[bucket] = std::min(m_bucketMin[bucket], triangleMin);
+        m_bucketMax[bucket] = std::max(m_bucketMax[bucket], triangleMax);
+      }
+
+      // Neighbouring buckets share a chunk while their vertices fit in a window
+      m_bucketChunks.assign(bucketCount, 0);
+      const uint32 firstChunk = (uint32)m_chunks.size();
+      uint32 chunkMin = 0xFFFFFFFF;
+      uint32 chunkMax = 0;
+      for (uint32 bucket = 0; bucket < bucketCount; ++bucket)
+      {
+        if (m_bucketMin[bucket] > m_bucketMax[bucket])
+          continue;
+
+        if (m_chunks.size() == firstChunk || std::max(chunkMax, m_bucketMax[bucket]) - std::min(chunkMin, m_bucketMin[bucket]) >= MaxVertexSpan)
+        {
+          m_chunks.push_back(IndexChunk());
+          chunkMin = 0xFFFFFFFF;
+          chunkMax = 0;
+        }
+        chunkMin = std::min(chunkMin, m_bucketMin[bucket]);
+        chunkMax = std::max(chunkMax, m_bucketMax[bucket]);
+        m_chunks.back().baseVertex = chunkMin;
+        m_bucketChunks[bucket] = (uint32)m_chunks.size() - 1;
+      }
+
+      // The triangles of a chunk keep their draw order
+      for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+      {
+        if (m_triangleBuckets[triangle] != WideTriangle)
+          m_chunks[m_bucketChunks[m_triangleBuckets[triangle]]].indexCount += 3;
+      }
+
+      uint32 indexOffset = (uint32)m_indices.size();
+      m_chunkCursors.resize(m_chunks.size());
+      for (uint32 chunk = firstChunk; chunk < (uint32)m_chunks.size(); ++chunk)
+      {
+        m_chunks[chunk].indexOffset = indexOffset;
+        m_chunkCursors[chunk] = indexOffset;
+        indexOffset += m_chunks[chunk].indexCount;
+      }
+      m_indices.resize(indexOffset);
+
+      for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+      {
+        if (m_triangleBuckets[triangle] == WideTriangle)
+          continue;
+
+        const uint32 chunk = m_bucketChunks[m_triangleBuckets[triangle]];
+        for (uint32 corner = 0; corner < 3; ++corner)
+          m_indices[m_chunkCursors[chunk]++] = (uint16)(levelIndices[triangle * 3 + corner] - m_chunks[chunk].baseVertex);
+      }
+
+      // Drawn after the other triangles of the level
+      if (!m_wideTriangles.empty())
+        SplitWideTriangles(indices, vertexCount);
+
+      if (m_chunks.size() - firstChunk > maxChunksPerLOD)
+        return false;
+
+      m_lodChunkOffsets.push_back((uint32)m_chunks.size());
+    }
+
+    return (uint64)m_copiedVertices.size() * vertexSize < (uint64)m_indices.size() * sizeof(uint16);
+  }
+
+  void IndexSplitter::CloseChunk(uint32 baseVertex)
+  {
+    IndexChunk chunk;
+    chunk.indexOffset = (uint32)m_indices.size();
+    chunk.indexCount = (uint32)m_chunkIndices.size();
+    chunk.baseVertex = baseVertex;
+    m_chunks.push_back(chunk);
+
+    for (uint32 index : m_chunkIndices)
+      m_indices.push_back((uint16)(index - baseVertex));
+    m_chunkIndices.clear();
+  }
+
+  void IndexSplitter::SplitWideTriangles(const uint32* indices, uint32 vertexCount)
+  {
+    if (m_copyStamp.size() < vertexCount)
+    {
+      m_copyIndex.resize(vertexCount);
+      m_copyStamp.assign(vertexCount, 0);
+      m_stamp = 0;
+    }
+
+    // A chunk of copies, the stamp tells whether a source vertex is copied in the current one
+    uint32 baseVertex = vertexCount + (uint32)m_copiedVertices.size();
+    ++m_stamp;
+    for (uint32 first : m_wideTriangles)
+    {
+      // Room for three new copies
+      const uint32* triangle = indices + first;
+      if (vertexCount + (uint32)m_copiedVertices.size() - baseVertex > MaxVertexSpan - 3)
+      {
+        CloseChunk(baseVertex);
+        baseVertex = vertexCount + (uint32)m_copiedVertices.size();
+        ++m_stamp;
+      }
+
+      for (uint32 corner = 0; corner < 3; ++corner)
+      {
+        const uint32 vertex = triangle[corner];
+        if (m_copyStamp[vertex] != m_stamp)
+        {
+          m_copyStamp[vertex] = m_stamp;
+          m_copyIndex[vertex] = vertexCount + (uint32)m_copiedVertices.size();
+          m_copiedVertices.push_back(vertex);
+        }
+        m_chunkIndices.push_back(m_copyIndex[vertex]);
+      }
+    }
+    CloseChunk(baseVertex);
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "MeshLOD.h"
+
+namespace WoohooDX12
+{
+  // One draw of a level of detail, its indices are relative to the base vertex
+  struct IndexChunk
+  {
+    uint32 indexOffset = 0;
+    uint32 indexCount = 0;
+    uint32 baseVertex = 0;
+  };
+
+  /*
+  * Rewrites the 32-bit index buffer of a mesh into 16-bit chunks, each drawn with its own base vertex.
+  * The triangles of a level go to the bucket of their smallest vertex, buckets are a quarter of a 16-bit window so a triangle
+  * fits the window starting at its bucket unless it spans more than three quarters of it. Neighbouring buckets are drawn as one chunk
+  * while their vertices fit in a window, meshes under 65536 vertices are one chunk per level. The triangles of a chunk keep
+  * their order, after MeshOptimizer::OptimizeVertexFetch the vertices are in the order of their first use so the buckets
+  * mostly follow the draw order. Chunks reference the shared vertices, only the triangles that fit no bucket get copies of
+  * their vertices, appended after them.
+  * It does not depend on D3D.
+  */
+  class IndexSplitter
+  {
+  public:
+    static constexpr uint32 MaxVertexSpan = 65536; // Vertices a 16-bit index reaches from the base vertex
+    static constexpr uint32 BucketSize = MaxVertexSpan / 4;
+
+    // Returns false when a level needs more than maxChunksPerLOD chunks or the vertex copies take more memory than the 16-bit
+    // indices save, the mesh is then better drawn with 32-bit indices
+    bool Split(const uint32* indices, const MeshLOD* lods, uint32 lodCount, uint32 vertexCount, uint32 vertexSize, uint32 maxChunksPerLOD);
+
+    inline const std::vector<uint16>& GetIndices() const { return m_indices; }
+    inline const std::vector<IndexChunk>& GetChunks() const { return m_chunks; }
+    // Chunks of level i are [offsets[i], offsets[i + 1])
+    inline const std::vector<uint32>& GetLODChunkOffsets() const { return m_lodChunkOffsets; }
+    // Source vertex of every copy, the copies follow the vertexCount source vertices
+    inline const std::vector<uint32>& GetCopiedVertices() const { return m_copiedVertices; }
+
+  private:
+    static constexpr uint32 WideTriangle = 0xFFFFFFFF;
+
+    // Writes the triangles gathered for the current chunk relative to its base vertex
+    void CloseChunk(uint32 baseVertex);
+    // Chunks of copied vertices for the triangles of the level that fit no bucket
+    void SplitWideTriangles(const uint32* indices, uint32 vertexCount);
+
+  private:
+    std::vector<uint16> m_indices;
+    std::vector<IndexChunk> m_chunks;
+    std::vector<uint32> m_lodChunkOffsets;
+    std::vector<uint32> m_copiedVertices;
+
+    // Scratch
+    std::vector<uint32> m_triangleBuckets;
+    std::vector<uint32> m_bucketMin;
+    std::vector<uint32> m_bucketMax;
+    std::vector<uint32> m_bucketChunks;
+    std::vector<uint32> m_chunkCursors;
+    std::vector<uint32> m_chunkIndices;
+    std::vector<uint32> m_wideTriangles; // First index of the triangles that fit no bucket
+    std::vector<uint32> m_copyIndex;
+    std::vector<uint32> m_copyStamp;
+    uint32 m_stamp = 0;
+  };
+}
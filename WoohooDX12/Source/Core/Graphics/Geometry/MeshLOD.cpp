@@ -0,0 +1,38 @@
+#include "MeshLOD.h"
+
+namespace WoohooDX12
+{
+  float LODSelector::GetProjectionScale(const Mat4x4& projection, uint32 viewportHeight)
+  {
+    // _22 is the cotangent of half the vertical field of view
+    return projection._22 * (float)viewportHeight * 0.5f;
+  }
+
+  uint32 LODSelector::Select(const MeshLOD* lods, uint32 lodCount, uint32 currentLOD, float objectScale, float distance, float projectionScale,
+    float thresholdPixels, float hysteresis)
+  {
+    if (lodCount <= 1 || distance <= 0.0f)
+      return 0;
+
+    if (currentLOD >= lodCount)
+      currentLOD = lodCount - 1;
+
+    // Coarser: the new level has to be clearly under the threshold
+    const float coarserThreshold = thresholdPixels * (1.0f - hysteresis);
+    uint32 lod = currentLOD;
+    while (lod + 1 < lodCount && GetScreenError(lods[lod + 1], objectScale, distance, projectionScale) <= coarserThreshold)
+      ++lod;
+    if (lod != currentLOD)
+      return lod;
+
+    // Finer: only once the current level is clearly over the threshold, then as coarse as the threshold allows
+    const float finerThreshold = thresholdPixels * (1.0f + hysteresis);
+    if (GetScreenError(lods[currentLOD], objectScale, distance, projectionScale) <= finerThreshold)
+      return currentLOD;
+
+    while (lod > 0 && GetScreenError(lods[lod], objectScale, distance, projectionScale) > thresholdPixels)
+      --lod;
+
+    return lod;
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  // One level of detail, a range of the mesh's index buffer over the shared vertices
+  struct MeshLOD
+  {
+    static constexpr uint32 MaxCount = 8;
+
+    uint32 indexOffset = 0;
+    uint32 indexCount = 0;
+    float error = 0.0f; // Geometric error against the full detail level, in mesh units
+  };
+
+  /*
+  * Picks the level of detail of an object from the screen-space size of its simplification error.
+  * The coarsest level whose error projects under the threshold is selected. A level is only left when its error crosses
+  * the threshold by the hysteresis fraction, so an object standing near a switch distance does not flicker between levels.
+  */
+  class LODSelector
+  {
+  public:
+    // Pixels covered by one unit at a distance of one unit
+    static float GetProjectionScale(const Mat4x4& projection, uint32 viewportHeight);
+    // Error of the level in pixels, objectScale is the scale of the object's world matrix
+    static inline float GetScreenError(const MeshLOD& lod, float objectScale, float distance, float projectionScale)
+    {
+      return lod.error * objectScale * projectionScale / distance;
+    }
+
+    // distance is from the camera to the surface of the object's bounding sphere, at or below zero the full level is used.
+    // Errors have to grow with the level.
+    static uint32 Select(const MeshLOD* lods, uint32 lodCount, uint32 currentLOD, float objectScale, float distance, float projectionScale,
+      float thresholdPixels, float hysteresis);
+  };
+}
@@ -0,0 +1,349 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    inline const float* GetPosition(const float* positions, uint32 stride, uint32 vertex)
+    {
+      return reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(positions) + (size_t)vertex * stride);
+    }
+
+    // FIFO cache with time stamps: a vertex is in the cache when fewer than cacheSize vertices were transformed after it.
+    // Returns true on a miss.
+    inline bool TouchVertex(uint32* cacheTimes, uint32 vertex, uint32& timestamp, uint32 cacheSize)
+    {
+      if (timestamp - cacheTimes[vertex] <= cacheSize)
+        return false;
+
+      cacheTimes[vertex] = timestamp++;
+      return true;
+    }
+  }
+
+  void MeshOptimizer::OptimizeVertexCache(uint32* indices, uint32 indexCount, uint32 vertexCount)
+  {
+    assert(indexCount % 3 == 0 && "Index count is not a multiple of three!");
+    const uint32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+      return;
+
+    BuildAdjacency(indices, indexCount, vertexCount);
+    m_cacheTimes.assign(vertexCount, 0);
+    m_emitted.assign(triangleCount, 0);
+    m_deadEnds.clear();
+    m_reordered.resize(indexCount);
+
+    // Starts past the cache size so no vertex is in the cache
+    uint32 timestamp = CacheSize + 1;
+    uint32 cursor = 0;
+    uint32 outputCount = 0;
+    uint32 fan = SkipDeadEnd(cursor, vertexCount);
+    while (fan != InvalidVertex)
+    {
+      // Every free triangle around the fanning vertex, their vertices are the next candidates
+      m_candidates.clear();
+      for (uint32 t = m_triangleOffsets[fan]; t < m_triangleOffsets[fan + 1]; ++t)
+      {
+        const uint32 triangle = m_triangles[t];
+        if (m_emitted[triangle])
+          continue;
+
+        for (uint32 corner = 0; corner < 3; ++corner)
+        {
+          const uint32 vertex = indices[triangle * 3 + corner];
+          m_deadEnds.push_back(vertex);
+          m_candidates.push_back(vertex);
+          m_liveTriangles[vertex]--;
+          TouchVertex(m_cacheTimes.data(), vertex, timestamp, CacheSize);
+          m_reordered[outputCount++] = vertex;
+        }
+        m_emitted[triangle] = 1;
+      }
+
+      fan = GetNextVertex(timestamp, cursor, vertexCount);
+    }
+
+    assert(outputCount == indexCount && "Some triangles were not emitted!");
+    memcpy(indices, m_reordered.data(), indexCount * sizeof(uint32));
+  }
+
+  uint32 MeshOptimizer::GetNextVertex(uint32 timestamp, uint32& cursor, uint32 vertexCount)
+  {
+    // The oldest candidate that stays in the cache while its remaining triangles are emitted
+    uint32 best = InvalidVertex;
+    int32 bestPriority = -1;
+    for (uint32 vertex : m_candidates)
+    {
+      if (m_liveTriangles[vertex] == 0)
+        continue;
+
+      int32 priority = 0;
+      if (timestamp - m_cacheTimes[vertex] + 2 * m_liveTriangles[vertex] <= CacheSize)
+        priority = (int32)(timestamp - m_cacheTimes[vertex]);
+      if (priority > bestPriority)
+      {
+        best = vertex;
+        bestPriority = priority;
+      }
+    }
+
+    return best != InvalidVertex ? best : SkipDeadEnd(cursor, vertexCount);
+  }
+
+  uint32 MeshOptimizer::SkipDeadEnd(uint32& cursor, uint32 vertexCount)
+  {
+    // Recently used vertices first, they may still be in the cache
+    while (!m_deadEnds.empty())
+    {
+      const uint32 vertex = m_deadEnds.back();
+      m_deadEnds.pop_back();
+      if (m_liveTriangles[vertex] > 0)
+        return vertex;
+    }
+
+    for (; cursor < vertexCount; ++cursor)
+    {
+      if (m_liveTriangles[cursor] > 0)
+        return cursor;
+    }
+
+    return InvalidVertex;
+  }
+
+  void MeshOptimizer::BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount)
+  {
+    m_liveTriangles.assign(vertexCount, 0);
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_liveTriangles[indices[i]]++;
+
+    m_triangleOffsets.resize(vertexCount + 1);
+    m_triangleOffsets[0] = 0;
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+      m_triangleOffsets[vertex + 1] = m_triangleOffsets[vertex] + m_liveTriangles[vertex];
+
+    // Filled with the offsets as cursors, then moved back
+    m_triangles.resize(indexCount);
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_triangles[m_triangleOffsets[indices[i]]++] = i / 3;
+    for (uint32 vertex = vertexCount; vertex > 0; --vertex)
+      m_triangleOffsets[vertex] = m_triangleOffsets[vertex - 1];
+    m_triangleOffsets[0] = 0;
+  }
+
+  void MeshOptimizer::OptimizeOverdraw(uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount,
+    float threshold)
+  {
+    assert(indexCount % 3 == 0 && "Index count is not a multiple of three!");
+    const uint32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+      return;
+
+    // Hard boundaries: the cache order restarts where no vertex of a triangle is in the cache
+    m_cacheTimes.assign(vertexCount, 0);
+    uint32 timestamp = CacheSize + 1;
+    m_candidates.clear();
+    for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+    {
+      uint32 misses = 0;
+      for (uint32 corner = 0; corner < 3; ++corner)
+        misses += TouchVertex(m_cacheTimes.data(), indices[triangle * 3 + corner], timestamp, CacheSize) ? 1 : 0;
+      if (triangle == 0 || misses == 3)
+        m_candidates.push_back(triangle);
+    }
+    m_candidates.push_back(triangleCount);
+
+    // Soft boundaries: a hard cluster is cut once the part since the last cut is as cache efficient as the whole cluster
+    m_clusterStarts.clear();
+    for (uint32 c = 0; c + 1 < (uint32)m_candidates.size(); ++c)
+    {
+      const uint32 begin = m_candidates[c];
+      const uint32 end = m_candidates[c + 1];
+
+      // Moving the time stamp past the cache size empties the cache
+      timestamp += CacheSize + 1;
+      uint32 clusterMisses = 0;
+      for (uint32 triangle = begin; triangle < end; ++triangle)
+        for (uint32 corner = 0; corner < 3; ++corner)
+          clusterMisses += TouchVertex(m_cacheTimes.data(), indices[triangle * 3 + corner], timestamp, CacheSize) ? 1 : 0;
+      const float clusterRatio = (float)clusterMisses / (float)(end - begin);
+
+      timestamp += CacheSize + 1;
+      m_clusterStarts.push_back(begin);
+      uint32 start = begin;
+      uint32 misses = 0;
+      for (uint32 triangle = begin; triangle < end; ++triangle)
+      {
+        for (uint32 corner = 0; corner < 3; ++corner)
+          misses += TouchVertex(m_cacheTimes.data(), indices[triangle * 3 + corner], timestamp, CacheSize) ? 1 : 0;
+
+        if (triangle + 1 < end && (float)misses <= threshold * clusterRatio * (float)(triangle + 1 - start))
+        {
+          start = triangle + 1;
+          misses = 0;
+          timestamp += CacheSize + 1;
+          m_clusterStarts.push_back(start);
+        }
+      }
+    }
+
+    // Area weighted centroids and normals
+    const uint32 clusterCount = (uint32)m_clusterStarts.size();
+    m_clusterStarts.push_back(triangleCount);
+    m_clusterData.assign((size_t)clusterCount * 6, 0.0f);
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (uint32 cluster = 0; cluster < clusterCount; ++cluster)
+    {
+      float* centroid = &m_clusterData[cluster * 6];
+      float* normal = centroid + 3;
+      float clusterArea = 0.0f;
+      for (uint32 triangle = m_clusterStarts[cluster]; triangle < m_clusterStarts[cluster + 1]; ++triangle)
+      {
+        const float* p0 = GetPosition(positions, positionStride, indices[triangle * 3 + 0]);
+        const float* p1 = GetPosition(positions, positionStride, indices[triangle * 3 + 1]);
+        const float* p2 = GetPosition(positions, positionStride, indices[triangle * 3 + 2]);
+        const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        const float cross[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+        const float area = 0.5f * sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+          centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) * (area / 3.0f);
+          normal[axis] += cross[axis];
+        }
+        clusterArea += area;
+      }
+
+      for (uint32 axis = 0; axis < 3; ++axis)
+        meshCentroid[axis] += centroid[axis];
+      meshArea += clusterArea;
+      if (clusterArea > 0.0f)
+        for (uint32 axis = 0; axis < 3; ++axis)
+          centroid[axis] /= clusterArea;
+    }
+    for (uint32 axis = 0; axis < 3; ++axis)
+      meshCentroid[axis] = meshArea > 0.0 ? meshCentroid[axis] / meshArea : 0.0;
+
+    // Facing away from the center first
+    m_clusterKeys.resize(clusterCount);
+    for (uint32 cluster = 0; cluster < clusterCount; ++cluster)
+    {
+      const float* centroid = &m_clusterData[cluster * 6];
+      const float* normal = centroid + 3;
+      const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+      float key = 0.0f;
+      for (uint32 axis = 0; axis < 3 && length > 0.0f; ++axis)
+        key += (centroid[axis] - (float)meshCentroid[axis]) * normal[axis] / length;
+      m_clusterKeys[cluster] = key;
+    }
+
+    m_clusterOrder.resize(clusterCount);
+    std::iota(m_clusterOrder.begin(), m_clusterOrder.end(), 0);
+    std::stable_sort(m_clusterOrder.begin(), m_clusterOrder.end(), [this](uint32 a, uint32 b) { return m_clusterKeys[a] > m_clusterKeys[b]; });
+
+    m_reordered.resize(indexCount);
+    uint32 outputCount = 0;
+    for (uint32 cluster : m_clusterOrder)
+    {
+      const uint32 begin = m_clusterStarts[cluster] * 3;
+      const uint32 end = m_clusterStarts[cluster + 1] * 3;
+      memcpy(m_reordered.data() + outputCount, indices + begin, (end - begin) * sizeof(uint32));
+      outputCount += end - begin;
+    }
+    memcpy(indices, m_reordered.data(), indexCount * sizeof(uint32));
+  }
+
+  uint32 MeshOptimizer::OptimizeVertexFetch(uint32* indices, uint32 indexCount, uint32 vertexCount, std::vector<uint32>& remap)
+  {
+    remap.assign(vertexCount, InvalidVertex);
+    uint32 usedCount = 0;
+    for (uint32 i = 0; i < indexCount; ++i)
+    {
+      uint32& newIndex = remap[indices[i]];
+      if (newIndex == InvalidVertex)
+        newIndex = usedCount++;
+      indices[i] = newIndex;
+    }
+
+    return usedCount;
+  }
+
+  void MeshOptimizer::RemapVertices(void* destination, const void* source, uint32 vertexCount, uint32 vertexSize, const uint32* remap)
+  {
+    assert(destination != source && "Vertices can not be remapped in place!");
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+    {
+      if (remap[vertex] != InvalidVertex)
+        memcpy(static_cast<uint8*>(destination) + (size_t)remap[vertex] * vertexSize, static_cast<const uint8*>(source) + (size_t)vertex * vertexSize, vertexSize);
+    }
+  }
+
+  VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize)
+  {
+    VertexCacheStats stats;
+    if (indexCount == 0)
+      return stats;
+
+    std::vector<uint32> cacheTimes(vertexCount, 0);
+    std::vector<uint8> used(vertexCount, 0);
+    uint32 usedCount = 0;
+    uint32 timestamp = cacheSize + 1;
+    for (uint32 i = 0; i < indexCount; ++i)
+    {
+      stats.transformedCount += TouchVertex(cacheTimes.data(), indices[i], timestamp, cacheSize) ? 1 : 0;
+      usedCount += used[indices[i]] ? 0 : 1;
+      used[indices[i]] = 1;
+    }
+
+    stats.acmr = (float)stats.transformedCount / (float)(indexCount / 3);
+    stats.atvr = (float)stats.transformedCount / (float)usedCount;
+    return stats;
+  }
+
+  VertexFetchStats MeshOptimizer::AnalyzeVertexFetch(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 vertexSize)
+  {
+    constexpr uint32 LineCount = 16 * 1024 / CacheLineSize;
+
+    VertexFetchStats stats;
+    if (indexCount == 0)
+      return stats;
+
+    // Only the vertices missing the post-transform cache are fetched
+    std::vector<uint32> cacheTimes(vertexCount, 0);
+    std::vector<uint8> used(vertexCount, 0);
+    std::vector<uint64> lines(LineCount, ~0ull);
+    uint32 usedCount = 0;
+    uint32 timestamp = CacheSize + 1;
+    for (uint32 i = 0; i < indexCount; ++i)
+    {
+      const uint32 vertex = indices[i];
+      usedCount += used[vertex] ? 0 : 1;
+      used[vertex] = 1;
+      if (!TouchVertex(cacheTimes.data(), vertex, timestamp, CacheSize))
+        continue;
+
+      const uint64 first = (uint64)vertex * vertexSize / CacheLineSize;
+      const uint64 last = ((uint64)vertex * vertexSize + vertexSize - 1) / CacheLineSize;
+      for (uint64 line = first; line <= last; ++line)
+      {
+        uint64& slot = lines[line % LineCount];
+        if (slot != line)
+        {
+          slot = line;
+          stats.bytesFetched += CacheLineSize;
+        }
+      }
+    }
+
+    stats.overfetch = (float)stats.bytesFetched / (float)((uint64)usedCount * vertexSize);
+    return stats;
+  }
+}
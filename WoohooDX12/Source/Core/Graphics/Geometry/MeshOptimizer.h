@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  // Post-transform vertex cache efficiency of an index buffer, for a FIFO cache
+  struct VertexCacheStats
+  {
+    uint32 transformedCount = 0; // Cache misses
+    float acmr = 0.0f; // Average cache miss ratio, transformed vertices per triangle: 3 at worst, around 0.5 for regular grids
+    float atvr = 0.0f; // Average transformed vertex ratio, transformed vertices per used vertex: 1 at best
+  };
+
+  // Memory traffic of the vertex fetch, with the vertices read in cache lines
+  struct VertexFetchStats
+  {
+    uint32 bytesFetched = 0;
+    float overfetch = 0.0f; // Bytes fetched over the bytes of the used vertices: 1 at best
+  };
+
+  /*
+  * Import time reordering of the index and vertex buffers, in this order:
+  *   OptimizeVertexCache: triangles in the order of Tipsify (Sander, Nehab and Barczak), which fans around the vertices
+  *     kept in the cache and needs no cache simulation per candidate.
+  *   OptimizeOverdraw: the cache-ordered triangles are cut into clusters where the cache efficiency allows it, then the
+  *     clusters facing outward of the mesh are drawn first. View independent, a cluster that occludes others from many
+  *     directions tends to face away from the mesh center.
+  *   OptimizeVertexFetch: vertices in the order of their first use, so the fetches of consecutive triangles are close in
+  *     memory. Unused vertices are dropped.
+  * It does not depend on D3D, positions are three floats at any byte stride.
+  */
+  class MeshOptimizer
+  {
+  public:
+    static constexpr uint32 CacheSize = 16; // Post-transform cache entries the orders are made for and measured with
+    static constexpr uint32 CacheLineSize = 64;
+    static constexpr uint32 InvalidVertex = 0xFFFFFFFF;
+
+    // Reorders the triangles in place
+    void OptimizeVertexCache(uint32* indices, uint32 indexCount, uint32 vertexCount);
+    // Reorders the triangles in place. A cluster is cut once its cache miss ratio is within threshold of the cache-ordered
+    // one, 1 keeps the cache efficiency and higher values give more clusters to sort.
+    void OptimizeOverdraw(uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount,
+      float threshold = 1.05f);
+    // Rewrites the indices to the new vertex order and fills remap with the new index of every old vertex, InvalidVertex for
+    // the unused ones. Returns the used vertex count.
+    uint32 OptimizeVertexFetch(uint32* indices, uint32 indexCount, uint32 vertexCount, std::vector<uint32>& remap);
+    // destination needs room for the used vertex count
+    static void RemapVertices(void* destination, const void* source, uint32 vertexCount, uint32 vertexSize, const uint32* remap);
+
+    static VertexCacheStats AnalyzeVertexCache(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize = CacheSize);
+    // Direct mapped cache of 16KB
+    static VertexFetchStats AnalyzeVertexFetch(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 vertexSize);
+
+  private:
+    void BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount);
+    // Next vertex to fan around: a candidate still in the cache after its triangles are emitted, else a dead end, else the
+    // next vertex with triangles left. InvalidVertex when every triangle is emitted.
+    uint32 GetNextVertex(uint32 timestamp, uint32& cursor, uint32 vertexCount);
+    uint32 SkipDeadEnd(uint32& cursor, uint32 vertexCount);
+
+  private:
+    // Triangles around each vertex
+    std::vector<uint32> m_triangleOffsets;
+    std::vector<uint32> m_triangles;
+    std::vector<uint32> m_liveTriangles;
+
+    std::vector<uint32> m_cacheTimes;
+    std::vector<uint32> m_deadEnds;
+    std::vector<uint32> m_candidates;
+    std::vector<uint8> m_emitted;
+    std::vector<uint32> m_reordered;
+
+    // Overdraw clusters
+    std::vector<uint32> m_clusterStarts;
+    std::vector<float> m_clusterData; // Centroid and normal per cluster
+    std::vector<float> m_clusterKeys;
+    std::vector<uint32> m_clusterOrder;
+  };
+}
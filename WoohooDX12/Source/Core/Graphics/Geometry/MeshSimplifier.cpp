@@ -0,0 +1,601 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    // Border planes against the triangle quadrics, both are weighted by squared lengths
+    constexpr float BorderWeight = 10.0f;
+    // Smallest cosine between the normals of a triangle before and after a collapse
+    constexpr float MinNormalCosine = 1e-2f;
+
+    inline const float* GetStream(const float* stream, uint32 stride, uint32 vertex)
+    {
+      return reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(stream) + (size_t)vertex * stride);
+    }
+
+    inline uint32 UpperIndex(uint32 row, uint32 column, uint32 dimension)
+    {
+      return row * dimension - row * (row - 1) / 2 + (column - row);
+    }
+
+    inline void Cross(const float* a, const float* b, float* result)
+    {
+      result[0] = a[1] * b[2] - a[2] * b[1];
+      result[1] = a[2] * b[0] - a[0] * b[2];
+      result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline float Dot3(const float* a, const float* b)
+    {
+      return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal)
+    {
+      const float edge0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const float edge1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      Cross(edge0, edge1, normal);
+    }
+
+    inline uint32 HashPosition(const float* position)
+    {
+      uint32 bits[3];
+      memcpy(bits, position, sizeof(bits));
+      return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+  }
+
+  uint32 MeshSimplifier::Simplify(const SimplifyInput& input, uint32 targetIndexCount, const SimplifyOptions& options, uint32* destination,
+    float* resultError)
+  {
+    assert(input.indexCount % 3 == 0 && "Index count is not a multiple of 3!");
+    assert(input.attributeCount <= MaxAttributeCount && "Too many attributes!");
+
+    targetIndexCount = targetIndexCount / 3 * 3;
+    if (resultError != nullptr)
+      *resultError = 0.0f;
+
+    if (input.indexCount <= targetIndexCount)
+    {
+      memcpy(destination, input.indices, input.indexCount * sizeof(uint32));
+      return input.indexCount;
+    }
+
+    m_indices.assign(input.indices, input.indices + input.indexCount);
+    PrepareVertices(input, options);
+    ClassifyVertices(input);
+    ComputeQuadrics(input);
+
+    const uint32 vertexCount = input.vertexCount;
+    m_vertexErrors.resize(vertexCount);
+    for (uint32 v = 0; v < vertexCount; ++v)
+      m_vertexErrors[v] = EvaluateQuadric(m_quadrics[v], v);
+
+    const float maxError = options.maxError < FLT_MAX ? options.maxError * m_positionScale : FLT_MAX;
+    const float maxErrorSq = maxError < FLT_MAX ? maxError * maxError : FLT_MAX;
+    m_changed.assign(vertexCount, 1);
+    m_locked.resize(vertexCount);
+    m_remap.resize(vertexCount);
+    m_collapses.clear();
+
+    uint32 indexCount = input.indexCount;
+    float largestError = 0.0f;
+    while (indexCount > targetIndexCount)
+    {
+      const uint32* indices = m_indices.data();
+      BuildAdjacency(indices, indexCount, vertexCount);
+
+      // Cheapest valid direction of the edges around the vertices changed by the last pass, interior edges are seen from
+      // both of their triangles. The candidates of the other edges are still valid and sorted.
+      m_newCollapses.clear();
+      for (uint32 i = 0; i < indexCount; i += 3)
+      {
+        for (uint32 edge = 0; edge < 3; ++edge)
+        {
+          const uint32 a = indices[i + edge];
+          const uint32 b = indices[i + (edge + 1) % 3];
+          if (!m_changed[a] && !m_changed[b])
+            continue;
+          if (a > b && (m_kinds[a] == Manifold || m_kinds[b] == Manifold))
+            continue;
+
+          const float errorAB = IsCollapseValid(indices, a, b) ? GetCollapseError(a, b) : FLT_MAX;
+          const float errorBA = IsCollapseValid(indices, b, a) ? GetCollapseError(b, a) : FLT_MAX;
+          if (errorAB == FLT_MAX && errorBA == FLT_MAX)
+            continue;
+
+          m_newCollapses.push_back(errorAB <= errorBA ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA });
+        }
+      }
+
+      SortCollapses(m_newCollapses);
+      m_sortedCollapses.resize(m_collapses.size() + m_newCollapses.size());
+      std::merge(m_collapses.begin(), m_collapses.end(), m_newCollapses.begin(), m_newCollapses.end(), m_sortedCollapses.begin(),
+        [](const Collapse& lhs, const Collapse& rhs) { return lhs.error < rhs.error; });
+      m_collapses.swap(m_sortedCollapses);
+      if (m_collapses.empty())
+        break;
+
+      // A vertex takes part in one collapse per pass, the triangles around a moved vertex are frozen until the next pass
+      std::fill(m_changed.begin(), m_changed.end(), (uint8)0);
+      std::fill(m_locked.begin(), m_locked.end(), (uint8)0);
+      std::iota(m_remap.begin(), m_remap.end(), 0u);
+      const uint32 trianglesToRemove = (indexCount - targetIndexCount) / 3;
+      uint32 removedTriangles = 0;
+      for (const Collapse& collapse : m_collapses)
+      {
+        if (collapse.error > maxErrorSq)
+          break;
+        if (m_locked[collapse.from] || m_locked[collapse.to] || !IsCollapseValid(indices, collapse.from, collapse.to) ||
+          FlipsTriangle(indices, collapse.from, collapse.to))
+          continue;
+
+        removedTriangles += CountSharedTriangles(indices, collapse.from, collapse.to);
+        m_remap[collapse.from] = collapse.to;
+
+        Quadric& target = m_quadrics[collapse.to];
+        const Quadric& source = m_quadrics[collapse.from];
+        for (uint32 k = 0; k < sizeof(target.a) / sizeof(target.a[0]); ++k)
+          target.a[k] += source.a[k];
+        for (uint32 k = 0; k < MaxDimension; ++k)
+          target.b[k] += source.b[k];
+        target.c += source.c;
+        target.weight += source.weight;
+        m_vertexErrors[collapse.to] = EvaluateQuadric(target, collapse.to);
+
+        for (uint32 t = m_triangleOffsets[collapse.from]; t < m_triangleOffsets[collapse.from + 1]; ++t)
+        {
+          const uint32 triangle = m_triangles[t];
+          m_locked[indices[triangle * 3 + 0]] = 1;
+          m_locked[indices[triangle * 3 + 1]] = 1;
+          m_locked[indices[triangle * 3 + 2]] = 1;
+        }
+        m_changed[collapse.from] = 1;
+        m_changed[collapse.to] = 1;
+        largestError = std::max(largestError, collapse.error);
+
+        if (removedTriangles >= trianglesToRemove)
+          break;
+      }
+      if (removedTriangles == 0)
+        break;
+
+      // Collapsed triangles are dropped
+      uint32 writeCount = 0;
+      for (uint32 i = 0; i < indexCount; i += 3)
+      {
+        const uint32 a = m_remap[m_indices[i + 0]];
+        const uint32 b = m_remap[m_indices[i + 1]];
+        const uint32 c = m_remap[m_indices[i + 2]];
+        if (a == b || b == c || a == c)
+          continue;
+
+        m_indices[writeCount + 0] = a;
+        m_indices[writeCount + 1] = b;
+        m_indices[writeCount + 2] = c;
+        writeCount += 3;
+      }
+      indexCount = writeCount;
+
+      m_collapses.erase(std::remove_if(m_collapses.begin(), m_collapses.end(),
+        [this](const Collapse& collapse) { return m_changed[collapse.from] || m_changed[collapse.to]; }), m_collapses.end());
+    }
+
+    memcpy(destination, m_indices.data(), indexCount * sizeof(uint32));
+    if (resultError != nullptr)
+      *resultError = sqrtf(largestError) / m_positionScale;
+
+    return indexCount;
+  }
+
+  uint32 MeshSimplifier::BuildLODChain(const SimplifyInput& input, const LODChainOptions& options, std::vector<uint32>& lodIndices, std::vector<MeshLOD>& lods)
+  {
+    lodIndices.assign(input.indices, input.indices + input.indexCount);
+    lods.clear();
+    lods.push_back({ 0, input.indexCount, 0.0f });
+
+    const uint32 maxLODCount = std::min(options.maxLODCount, MeshLOD::MaxCount);
+    while ((uint32)lods.size() < maxLODCount)
+    {
+      const MeshLOD previous = lods.back();
+      const uint32 targetIndexCount = (uint32)(previous.indexCount * options.reduction) / 3 * 3;
+      if (targetIndexCount < options.minTriangleCount * 3)
+        break;
+
+      SimplifyInput levelInput = input;
+      levelInput.indices = lodIndices.data() + previous.indexOffset;
+      levelInput.indexCount = previous.indexCount;
+
+      m_levelIndices.resize(previous.indexCount);
+      float levelError = 0.0f;
+      const uint32 indexCount = Simplify(levelInput, targetIndexCount, options.simplify, m_levelIndices.data(), &levelError);
+
+      // Not worth a level when the collapses left are blocked
+      if (indexCount == 0 || indexCount > previous.indexCount - (previous.indexCount - targetIndexCount) / 2)
+        break;
+
+      lods.push_back({ (uint32)lodIndices.size(), indexCount, previous.error + levelError });
+      lodIndices.insert(lodIndices.end(), m_levelIndices.begin(), m_levelIndices.begin() + indexCount);
+    }
+
+    return (uint32)lods.size();
+  }
+
+  void MeshSimplifier::SortCollapses(std::vector<Collapse>& collapses)
+  {
+    // Errors are positive, their bits sort as integers. Three radix passes of 11 bits.
+    constexpr uint32 RadixBits = 11;
+    constexpr uint32 RadixSize = 1 << RadixBits;
+
+    m_sortedCollapses.resize(collapses.size());
+    Collapse* source = collapses.data();
+    Collapse* destination = m_sortedCollapses.data();
+    const uint32 count = (uint32)collapses.size();
+    for (uint32 shift = 0; shift < 32; shift += RadixBits)
+    {
+      uint32 histogram[RadixSize] = {};
+      for (uint32 i = 0; i < count; ++i)
+      {
+        uint32 key;
+        memcpy(&key, &source[i].error, sizeof(key));
+        histogram[(key >> shift) & (RadixSize - 1)]++;
+      }
+
+      uint32 offset = 0;
+      for (uint32 bucket = 0; bucket < RadixSize; ++bucket)
+      {
+        const uint32 bucketCount = histogram[bucket];
+        histogram[bucket] = offset;
+        offset += bucketCount;
+      }
+
+      for (uint32 i = 0; i < count; ++i)
+      {
+        uint32 key;
+        memcpy(&key, &source[i].error, sizeof(key));
+        destination[histogram[(key >> shift) & (RadixSize - 1)]++] = source[i];
+      }
+      std::swap(source, destination);
+    }
+
+    // Odd pass count, the result is in the scratch buffer
+    collapses.swap(m_sortedCollapses);
+  }
+
+  void MeshSimplifier::PrepareVertices(const SimplifyInput& input, const SimplifyOptions& options)
+  {
+    float minPosition[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxPosition[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32 v = 0; v < input.vertexCount; ++v)
+    {
+      const float* position = GetStream(input.positions, input.positionStride, v);
+      for (uint32 k = 0; k < 3; ++k)
+      {
+        minPosition[k] = std::min(minPosition[k], position[k]);
+        maxPosition[k] = std::max(maxPosition[k], position[k]);
+      }
+    }
+
+    const float extent = std::max(maxPosition[0] - minPosition[0], std::max(maxPosition[1] - minPosition[1], maxPosition[2] - minPosition[2]));
+    m_positionScale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    m_dimension = 3 + (input.attributes != nullptr ? input.attributeCount : 0);
+
+    m_vectors.resize((size_t)input.vertexCount * m_dimension);
+    for (uint32 v = 0; v < input.vertexCount; ++v)
+    {
+      float* vector = &m_vectors[(size_t)v * m_dimension];
+      const float* position = GetStream(input.positions, input.positionStride, v);
+      for (uint32 k = 0; k < 3; ++k)
+        vector[k] = (position[k] - minPosition[k]) * m_positionScale;
+
+      if (m_dimension > 3)
+      {
+        const float* attributes = GetStream(input.attributes, input.attributeStride, v);
+        for (uint32 k = 3; k < m_dimension; ++k)
+          vector[k] = attributes[k - 3] * options.attributeWeight;
+      }
+    }
+  }
+
+  void MeshSimplifier::ClassifyVertices(const SimplifyInput& input)
+  {
+    const uint32 vertexCount = input.vertexCount;
+
+    // Vertices with the same position, open addressing on the position bits
+    uint32 tableSize = 1;
+    while (tableSize < vertexCount * 2)
+      tableSize *= 2;
+    std::vector<uint32> table(tableSize, ~0u);
+    m_canonical.resize(vertexCount);
+    for (uint32 v = 0; v < vertexCount; ++v)
+    {
+      const float* position = GetStream(input.positions, input.positionStride, v);
+      uint32 slot = HashPosition(position) & (tableSize - 1);
+      while (table[slot] != ~0u && memcmp(GetStream(input.positions, input.positionStride, table[slot]), position, 3 * sizeof(float)) != 0)
+        slot = (slot + 1) & (tableSize - 1);
+
+      if (table[slot] == ~0u)
+        table[slot] = v;
+      m_canonical[v] = table[slot];
+    }
+
+    // Welded directed edges, a border edge has no opposite
+    m_edgeOffsets.assign(vertexCount + 1, 0);
+    for (uint32 i = 0; i < m_indices.size(); ++i)
+      m_edgeOffsets[m_canonical[m_indices[i]] + 1]++;
+    for (uint32 v = 0; v < vertexCount; ++v)
+      m_edgeOffsets[v + 1] += m_edgeOffsets[v];
+
+    m_edgeTargets.resize(m_indices.size());
+    std::vector<uint32> fill(m_edgeOffsets.begin(), m_edgeOffsets.end() - 1);
+    for (uint32 i = 0; i < m_indices.size(); i += 3)
+    {
+      for (uint32 edge = 0; edge < 3; ++edge)
+      {
+        const uint32 a = m_canonical[m_indices[i + edge]];
+        const uint32 b = m_canonical[m_indices[i + (edge + 1) % 3]];
+        m_edgeTargets[fill[a]++] = b;
+      }
+    }
+
+    // Wedges of a position and their referenced count
+    std::vector<uint8> referenced(vertexCount, 0);
+    for (uint32 index : m_indices)
+      referenced[index] = 1;
+    std::vector<uint32> wedgeCounts(vertexCount, 0);
+    for (uint32 v = 0; v < vertexCount; ++v)
+      wedgeCounts[m_canonical[v]] += referenced[v];
+
+    std::vector<uint8> border(vertexCount, 0);
+    std::vector<uint8> nonManifold(vertexCount, 0);
+    for (uint32 a = 0; a < vertexCount; ++a)
+    {
+      for (uint32 e = m_edgeOffsets[a]; e < m_edgeOffsets[a + 1]; ++e)
+      {
+        const uint32 b = m_edgeTargets[e];
+        if (a == b)
+          continue;
+
+        // Twice in the same direction, or more than two triangles on an edge
+        if (std::count(m_edgeTargets.begin() + m_edgeOffsets[a], m_edgeTargets.begin() + m_edgeOffsets[a + 1], b) > 1)
+          nonManifold[a] = nonManifold[b] = 1;
+        else if (!HasEdge(b, a))
+          border[a] = border[b] = 1;
+      }
+    }
+
+    m_kinds.resize(vertexCount);
+    for (uint32 v = 0; v < vertexCount; ++v)
+    {
+      const uint32 canonical = m_canonical[v];
+      if (wedgeCounts[canonical] > 1 || nonManifold[canonical])
+        m_kinds[v] = Locked;
+      else
+        m_kinds[v] = border[canonical] ? Border : Manifold;
+    }
+  }
+
+  void MeshSimplifier::ComputeQuadrics(const SimplifyInput& input)
+  {
+    const uint32 dimension = m_dimension;
+    Quadric zero;
+    memset(&zero, 0, sizeof(zero));
+    m_quadrics.assign(input.vertexCount, zero);
+
+    for (uint32 i = 0; i < m_indices.size(); i += 3)
+    {
+      const uint32 triangle[3] = { m_indices[i], m_indices[i + 1], m_indices[i + 2] };
+      const float* p[3] = { &m_vectors[(size_t)triangle[0] * dimension], &m_vectors[(size_t)triangle[1] * dimension],
+        &m_vectors[(size_t)triangle[2] * dimension] };
+
+      float normal[3];
+      TriangleNormal(p[0], p[1], p[2], normal);
+      const float normalLength = sqrtf(Dot3(normal, normal));
+      if (normalLength == 0.0f)
+        continue;
+
+      // Plane of the triangle in the position and attribute space: A = I - e1e1' - e2e2', b = (p.e1)e1 + (p.e2)e2 - p
+      float e1[MaxDimension];
+      float e2[MaxDimension];
+      float e1Length = 0.0f;
+      for (uint32 k = 0; k < dimension; ++k)
+      {
+        e1[k] = p[1][k] - p[0][k];
+        e1Length += e1[k] * e1[k];
+      }
+      e1Length = sqrtf(e1Length);
+      if (e1Length == 0.0f)
+        continue;
+
+      float e2Projection = 0.0f;
+      for (uint32 k = 0; k < dimension; ++k)
+      {
+        e1[k] /= e1Length;
+        e2[k] = p[2][k] - p[0][k];
+        e2Projection += e2[k] * e1[k];
+      }
+      float e2Length = 0.0f;
+      for (uint32 k = 0; k < dimension; ++k)
+      {
+        e2[k] -= e2Projection * e1[k];
+        e2Length += e2[k] * e2[k];
+      }
+      e2Length = sqrtf(e2Length);
+      if (e2Length == 0.0f)
+        continue;
+
+      float pe1 = 0.0f;
+      float pe2 = 0.0f;
+      float pp = 0.0f;
+      for (uint32 k = 0; k < dimension; ++k)
+      {
+        e2[k] /= e2Length;
+        pe1 += p[0][k] * e1[k];
+        pe2 += p[0][k] * e2[k];
+        pp += p[0][k] * p[0][k];
+      }
+
+      const float area = normalLength * 0.5f;
+      Quadric quadric;
+      uint32 entry = 0;
+      for (uint32 row = 0; row < dimension; ++row)
+      {
+        for (uint32 column = row; column < dimension; ++column)
+          quadric.a[entry++] = ((row == column ? 1.0f : 0.0f) - e1[row] * e1[column] - e2[row] * e2[column]) * area;
+        quadric.b[row] = (pe1 * e1[row] + pe2 * e2[row] - p[0][row]) * area;
+      }
+      quadric.c = (pp - pe1 * pe1 - pe2 * pe2) * area;
+      quadric.weight = area;
+
+      for (uint32 corner = 0; corner < 3; ++corner)
+      {
+        Quadric& target = m_quadrics[triangle[corner]];
+        for (uint32 k = 0; k < entry; ++k)
+          target.a[k] += quadric.a[k];
+        for (uint32 k = 0; k < dimension; ++k)
+          target.b[k] += quadric.b[k];
+        target.c += quadric.c;
+        target.weight += quadric.weight;
+      }
+
+      // Borders are held by a plane through the edge, perpendicular to the triangle
+      for (uint32 edge = 0; edge < 3; ++edge)
+      {
+        const uint32 a = triangle[edge];
+        const uint32 b = triangle[(edge + 1) % 3];
+        if (HasEdge(m_canonical[b], m_canonical[a]))
+          continue;
+
+        const float edgeVector[3] = { p[(edge + 1) % 3][0] - p[edge][0], p[(edge + 1) % 3][1] - p[edge][1], p[(edge + 1) % 3][2] - p[edge][2] };
+        float planeNormal[3];
+        Cross(edgeVector, normal, planeNormal);
+        const float planeLength = sqrtf(Dot3(planeNormal, planeNormal));
+        if (planeLength == 0.0f)
+          continue;
+
+        for (uint32 k = 0; k < 3; ++k)
+          planeNormal[k] /= planeLength;
+        const float distance = -Dot3(planeNormal, p[edge]);
+        const float weight = Dot3(edgeVector, edgeVector) * BorderWeight;
+
+        for (uint32 corner : { a, b })
+        {
+          Quadric& target = m_quadrics[corner];
+          for (uint32 row = 0; row < 3; ++row)
+          {
+            for (uint32 column = row; column < 3; ++column)
+              target.a[UpperIndex(row, column, dimension)] += planeNormal[row] * planeNormal[column] * weight;
+            target.b[row] += planeNormal[row] * distance * weight;
+          }
+          target.c += distance * distance * weight;
+          target.weight += weight;
+        }
+      }
+    }
+  }
+
+  void MeshSimplifier::BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount)
+  {
+    m_triangleOffsets.assign(vertexCount + 1, 0);
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_triangleOffsets[indices[i] + 1]++;
+    for (uint32 v = 0; v < vertexCount; ++v)
+      m_triangleOffsets[v + 1] += m_triangleOffsets[v];
+
+    m_triangles.resize(indexCount);
+    m_remap.assign(m_triangleOffsets.begin(), m_triangleOffsets.end() - 1); // Fill positions, reset before the collapses
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_triangles[m_remap[indices[i]]++] = i / 3;
+  }
+
+  bool MeshSimplifier::HasEdge(uint32 from, uint32 to) const
+  {
+    for (uint32 e = m_edgeOffsets[from]; e < m_edgeOffsets[from + 1]; ++e)
+    {
+      if (m_edgeTargets[e] == to)
+        return true;
+    }
+    return false;
+  }
+
+  uint32 MeshSimplifier::CountSharedTriangles(const uint32* indices, uint32 from, uint32 to) const
+  {
+    uint32 count = 0;
+    for (uint32 t = m_triangleOffsets[from]; t < m_triangleOffsets[from + 1]; ++t)
+    {
+      const uint32* triangle = indices + m_triangles[t] * 3;
+      count += (triangle[0] == to || triangle[1] == to || triangle[2] == to) ? 1 : 0;
+    }
+    return count;
+  }
+
+  bool MeshSimplifier::IsCollapseValid(const uint32* indices, uint32 from, uint32 to) const
+  {
+    switch (m_kinds[from])
+    {
+    case Manifold:
+      return true;
+    case Border:
+      return m_kinds[to] != Manifold && CountSharedTriangles(indices, from, to) == 1;
+    default:
+      return false;
+    }
+  }
+
+  bool MeshSimplifier::FlipsTriangle(const uint32* indices, uint32 from, uint32 to) const
+  {
+    const float* target = &m_vectors[(size_t)to * m_dimension];
+    for (uint32 t = m_triangleOffsets[from]; t < m_triangleOffsets[from + 1]; ++t)
+    {
+      const uint32* triangle = indices + m_triangles[t] * 3;
+      if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+        continue; // Removed by the collapse
+
+      const float* p[3];
+      const float* moved[3];
+      for (uint32 corner = 0; corner < 3; ++corner)
+      {
+        p[corner] = &m_vectors[(size_t)triangle[corner] * m_dimension];
+        moved[corner] = triangle[corner] == from ? target : p[corner];
+      }
+
+      float before[3];
+      float after[3];
+      TriangleNormal(p[0], p[1], p[2], before);
+      TriangleNormal(moved[0], moved[1], moved[2], after);
+      if (Dot3(before, after) <= MinNormalCosine * sqrtf(Dot3(before, before) * Dot3(after, after)))
+        return true;
+    }
+    return false;
+  }
+
+  float MeshSimplifier::EvaluateQuadric(const Quadric& quadric, uint32 vertex) const
+  {
+    const float* v = &m_vectors[(size_t)vertex * m_dimension];
+    float error = quadric.c;
+    uint32 entry = 0;
+    for (uint32 row = 0; row < m_dimension; ++row)
+    {
+      float rowSum = quadric.b[row] * 2.0f + quadric.a[entry++] * v[row];
+      for (uint32 column = row + 1; column < m_dimension; ++column)
+        rowSum += quadric.a[entry++] * 2.0f * v[column];
+      error += rowSum * v[row];
+    }
+    return error;
+  }
+
+  float MeshSimplifier::GetCollapseError(uint32 from, uint32 to) const
+  {
+    // Merged quadric at the kept vertex, the part of the kept vertex does not change until it is collapsed into
+    const float error = EvaluateQuadric(m_quadrics[from], to) + m_vertexErrors[to];
+    const float weight = m_quadrics[from].weight + m_quadrics[to].weight;
+    return weight > 0.0f ? std::max(error, 0.0f) / weight : 0.0f;
+  }
+}
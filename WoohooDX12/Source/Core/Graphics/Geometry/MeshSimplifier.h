@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+#include "Types.h"
+#include "MeshLOD.h"
+
+namespace WoohooDX12
+{
+  // Geometry streams of the simplifier. Positions are three floats, attributes (colours, normals, etc.) attributeCount floats.
+  // Strides are in bytes, attributes can be null.
+  struct SimplifyInput
+  {
+    const float* positions = nullptr;
+    uint32 positionStride = 0;
+    const float* attributes = nullptr;
+    uint32 attributeStride = 0;
+    uint32 attributeCount = 0;
+    uint32 vertexCount = 0;
+
+    const uint32* indices = nullptr;
+    uint32 indexCount = 0;
+  };
+
+  struct SimplifyOptions
+  {
+    // Weight of a unit attribute difference against a position difference of the whole mesh extent
+    float attributeWeight = 0.25f;
+    // Collapses over this error, in mesh units, are not made
+    float maxError = FLT_MAX;
+  };
+
+  struct LODChainOptions
+  {
+    uint32 maxLODCount = 5; // With the full detail level, at most MeshLOD::MaxCount
+    float reduction = 0.5f; // Target index count of a level against the previous one
+    uint32 minTriangleCount = 32;
+    SimplifyOptions simplify;
+  };
+
+  /*
+  * Quadric error metric simplification (Garland and Heckbert) with the attributes in the quadrics, so the collapses
+  * that change colours are as expensive as the ones that change the shape.
+  * Edges collapse onto one of their vertices, the result indexes the input vertices and every level of detail of a mesh
+  * shares its vertex buffer. Collapses are made in passes: the candidates are sorted by error, the cheapest ones are
+  * applied as long as they do not touch a vertex already changed in the pass, which keeps the flip test valid.
+  * Borders only collapse along themselves and are held by perpendicular planes. Vertices sharing a position with other
+  * vertices (attribute seams) and non-manifold vertices do not move.
+  */
+  class MeshSimplifier
+  {
+  public:
+    static constexpr uint32 MaxAttributeCount = 3;
+
+    // Writes the simplified triangles to destination, which needs room for input.indexCount indices. Returns the index count,
+    // which can stay over the target when the collapses left are over the error limit or invalid. resultError is the largest
+    // error of the collapses made, in mesh units.
+    uint32 Simplify(const SimplifyInput& input, uint32 targetIndexCount, const SimplifyOptions& options, uint32* destination,
+      float* resultError = nullptr);
+
+    // Level 0 is the input, every next level is simplified from the previous one and its error adds up. The indices of all the
+    // levels are written to lodIndices one after the other. Returns the level count.
+    uint32 BuildLODChain(const SimplifyInput& input, const LODChainOptions& options, std::vector<uint32>& lodIndices, std::vector<MeshLOD>& lods);
+
+  private:
+    static constexpr uint32 MaxDimension = 3 + MaxAttributeCount;
+
+    // Symmetric matrix as its upper triangle, the error of v is (v'Av + 2b'v + c) / weight
+    struct Quadric
+    {
+      float a[MaxDimension * (MaxDimension + 1) / 2];
+      float b[MaxDimension];
+      float c;
+      float weight;
+    };
+
+    enum VertexKind : uint8
+    {
+      Manifold, // Collapses into any neighbour
+      Border, // Collapses along a border edge
+      Locked // Does not collapse
+    };
+
+    struct Collapse
+    {
+      uint32 from;
+      uint32 to;
+      float error;
+    };
+
+    void PrepareVertices(const SimplifyInput& input, const SimplifyOptions& options);
+    void ClassifyVertices(const SimplifyInput& input);
+    void ComputeQuadrics(const SimplifyInput& input);
+    void BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount);
+    // By error, stable
+    void SortCollapses(std::vector<Collapse>& collapses);
+
+    // Welded edge of the input
+    bool HasEdge(uint32 from, uint32 to) const;
+    // Triangles around from that also use to
+    uint32 CountSharedTriangles(const uint32* indices, uint32 from, uint32 to) const;
+    bool IsCollapseValid(const uint32* indices, uint32 from, uint32 to) const;
+    bool FlipsTriangle(const uint32* indices, uint32 from, uint32 to) const;
+    // v'Av + 2b'v + c at the vertex, before the division by the weight
+    float EvaluateQuadric(const Quadric& quadric, uint32 vertex) const;
+    float GetCollapseError(uint32 from, uint32 to) const;
+
+  private:
+    uint32 m_dimension = 3;
+    float m_positionScale = 1.0f; // Positions are moved to the unit box of the mesh
+
+    std::vector<float> m_vectors; // Position and weighted attributes per vertex
+    std::vector<uint32> m_canonical; // First vertex with the same position
+    std::vector<VertexKind> m_kinds;
+    std::vector<uint32> m_edgeOffsets; // Directed edges of the welded input per vertex
+    std::vector<uint32> m_edgeTargets;
+    std::vector<Quadric> m_quadrics;
+    std::vector<float> m_vertexErrors; // Quadric of each vertex at the vertex
+
+    // Triangles around each vertex
+    std::vector<uint32> m_triangleOffsets;
+    std::vector<uint32> m_triangles;
+
+    std::vector<Collapse> m_collapses; // Sorted candidates
+    std::vector<Collapse> m_newCollapses;
+    std::vector<Collapse> m_sortedCollapses;
+    std::vector<uint8> m_changed; // Quadric or edges changed by the pass, their candidates are evaluated again
+    std::vector<uint8> m_locked; // Around the collapses of the pass
+    std::vector<uint32> m_remap;
+    std::vector<uint32> m_indices;
+    std::vector<uint32> m_levelIndices;
+  };
+}
@@ -0,0 +1,400 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    inline const float* GetPosition(const float* positions, uint32 stride, uint32 vertex)
+    {
+      return reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(positions) + (size_t)vertex * stride);
+    }
+
+    inline float Dot3(const float* a, const float* b)
+    {
+      return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Unnormalized, cross(p1 - p0, p2 - p0) faces the viewer for the renderer's front faces
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal)
+    {
+      const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+      normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+      normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    }
+
+    // Returns the length before the normalization, zero vectors stay zero
+    inline float Normalize3(float* vector)
+    {
+      const float length = sqrtf(Dot3(vector, vector));
+      if (length > 0.0f)
+      {
+        vector[0] /= length;
+        vector[1] /= length;
+        vector[2] /= length;
+      }
+      return length;
+    }
+
+    // 10 bits per axis interleaved
+    inline uint32 SpreadBits(uint32 value)
+    {
+      value &= 0x3FF;
+      value = (value | (value << 16)) & 0x30000FF;
+      value = (value | (value << 8)) & 0x300F00F;
+      value = (value | (value << 4)) & 0x30C30C3;
+      value = (value | (value << 2)) & 0x9249249;
+      return value;
+    }
+  }
+
+  uint32 MeshletBuilder::Build(const float* positions, uint32 positionStride, uint32 vertexCount, const uint32* indices, uint32 indexCount,
+    const MeshletOptions& options, MeshletData& result)
+  {
+    assert(options.maxVertices >= 3 && options.maxVertices <= MaxVertexLimit && "Meshlet vertex limit is out of range!");
+    assert(options.maxTriangles >= 1 && options.maxTriangles <= MaxTriangleLimit && "Meshlet triangle limit is out of range!");
+    assert(indexCount % 3 == 0 && "Index count is not a multiple of three!");
+
+    result.meshlets.clear();
+    result.bounds.clear();
+    result.vertices.clear();
+    result.triangles.clear();
+
+    const uint32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+      return 0;
+
+    BuildAdjacency(indices, indexCount, vertexCount);
+    ComputeTriangleData(positions, positionStride, indices, triangleCount, options.maxTriangles);
+    m_emitted.assign(triangleCount, 0);
+    m_localIndices.assign(vertexCount, NotInMeshlet);
+
+    // A free triangle further than this from a meshlet starts a new one. Further jumps fill disconnected pieces better but
+    // spread the meshlets and widen their cones.
+    const float maxJumpSq = 16.0f * m_meshletRadius * m_meshletRadius;
+
+    Meshlet meshlet;
+    uint32 cursor = 0; // Next free triangle in Morton order
+    for (uint32 emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+      const uint32* meshletVertices = result.vertices.data() + meshlet.vertexOffset;
+      uint32 triangle = meshlet.triangleCount > 0 ? FindNeighbour(indices, options, meshletVertices, meshlet.vertexCount) : InvalidTriangle;
+      if (triangle == InvalidTriangle)
+      {
+        while (m_emitted[m_mortonOrder[cursor]])
+          ++cursor;
+        triangle = m_mortonOrder[cursor];
+
+        if (meshlet.triangleCount > 0)
+        {
+          const float* center = &m_centers[triangle * 3];
+          const float offset[3] = { center[0] - m_meshletCenter[0], center[1] - m_meshletCenter[1], center[2] - m_meshletCenter[2] };
+          if (meshlet.vertexCount + CountNewVertices(indices, triangle) > options.maxVertices || Dot3(offset, offset) > maxJumpSq)
+            FinishMeshlet(result, meshlet, positions, positionStride);
+        }
+      }
+
+      AddTriangle(indices, triangle, result, meshlet);
+      if (meshlet.triangleCount == options.maxTriangles)
+        FinishMeshlet(result, meshlet, positions, positionStride);
+    }
+
+    if (meshlet.triangleCount > 0)
+      FinishMeshlet(result, meshlet, positions, positionStride);
+
+    return result.GetMeshletCount();
+  }
+
+  void MeshletBuilder::BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount)
+  {
+    m_liveTriangles.assign(vertexCount, 0);
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_liveTriangles[indices[i]]++;
+
+    m_triangleOffsets.resize(vertexCount + 1);
+    m_triangleOffsets[0] = 0;
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+      m_triangleOffsets[vertex + 1] = m_triangleOffsets[vertex] + m_liveTriangles[vertex];
+
+    // Filled with the offsets as cursors, then moved back
+    m_triangles.resize(indexCount);
+    for (uint32 i = 0; i < indexCount; ++i)
+      m_triangles[m_triangleOffsets[indices[i]]++] = i / 3;
+    for (uint32 vertex = vertexCount; vertex > 0; --vertex)
+      m_triangleOffsets[vertex] = m_triangleOffsets[vertex - 1];
+    m_triangleOffsets[0] = 0;
+  }
+
+  void MeshletBuilder::ComputeTriangleData(const float* positions, uint32 positionStride, const uint32* indices, uint32 triangleCount, uint32 maxTriangles)
+  {
+    m_centers.resize(triangleCount * 3);
+    m_normals.resize(triangleCount * 3);
+
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    double area = 0.0;
+    for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+    {
+      const float* p0 = GetPosition(positions, positionStride, indices[triangle * 3 + 0]);
+      const float* p1 = GetPosition(positions, positionStride, indices[triangle * 3 + 1]);
+      const float* p2 = GetPosition(positions, positionStride, indices[triangle * 3 + 2]);
+
+      float* center = &m_centers[triangle * 3];
+      float* normal = &m_normals[triangle * 3];
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        center[axis] = (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+        minimum[axis] = std::min(minimum[axis], center[axis]);
+        maximum[axis] = std::max(maximum[axis], center[axis]);
+      }
+
+      TriangleNormal(p0, p1, p2, normal);
+      area += 0.5 * Normalize3(normal);
+    }
+
+    // Radius of a disk of the average triangle area times the triangle limit, the distances of the candidates are against it
+    const float averageArea = (float)(area / triangleCount);
+    m_meshletRadius = sqrtf(averageArea * (float)maxTriangles / 3.14159265f);
+    if (!(m_meshletRadius > 0.0f))
+      m_meshletRadius = 1.0f;
+
+    m_mortonCodes.resize(triangleCount);
+    for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+    {
+      uint32 code = 0;
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        const float extent = maximum[axis] - minimum[axis];
+        const float unit = extent > 0.0f ? (m_centers[triangle * 3 + axis] - minimum[axis]) / extent : 0.0f;
+        code |= SpreadBits((uint32)(unit * 1023.0f)) << axis;
+      }
+      m_mortonCodes[triangle] = code;
+    }
+
+    m_mortonOrder.resize(triangleCount);
+    for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+      m_mortonOrder[triangle] = triangle;
+    std::stable_sort(m_mortonOrder.begin(), m_mortonOrder.end(), [this](uint32 a, uint32 b) { return m_mortonCodes[a] < m_mortonCodes[b]; });
+  }
+
+  uint32 MeshletBuilder::FindNeighbour(const uint32* indices, const MeshletOptions& options, const uint32* meshletVertices, uint32 meshletVertexCount) const
+  {
+    float axis[3] = { m_meshletNormal[0], m_meshletNormal[1], m_meshletNormal[2] };
+    Normalize3(axis);
+
+    uint32 best = InvalidTriangle;
+    uint32 bestNewVertices = 3;
+    float bestCost = FLT_MAX;
+    for (uint32 i = 0; i < meshletVertexCount; ++i)
+    {
+      const uint32 vertex = meshletVertices[i];
+      if (m_liveTriangles[vertex] == 0)
+        continue;
+
+      for (uint32 t = m_triangleOffsets[vertex]; t < m_triangleOffsets[vertex + 1]; ++t)
+      {
+        const uint32 triangle = m_triangles[t];
+        if (m_emitted[triangle])
+          continue;
+
+        // Fewest new vertices first, then the closest triangle with the normal nearest to the meshlet's
+        const uint32 newVertices = CountNewVertices(indices, triangle);
+        if (newVertices > bestNewVertices || meshletVertexCount + newVertices > options.maxVertices)
+          continue;
+
+        const float* center = &m_centers[triangle * 3];
+        const float offset[3] = { center[0] - m_meshletCenter[0], center[1] - m_meshletCenter[1], center[2] - m_meshletCenter[2] };
+        const float distance = sqrtf(Dot3(offset, offset)) / m_meshletRadius;
+        const float cost = distance + options.coneWeight * (1.0f - Dot3(&m_normals[triangle * 3], axis));
+        if (newVertices < bestNewVertices || cost < bestCost)
+        {
+          best = triangle;
+          bestNewVertices = newVertices;
+          bestCost = cost;
+        }
+      }
+    }
+
+    return best;
+  }
+
+  uint32 MeshletBuilder::CountNewVertices(const uint32* indices, uint32 triangle) const
+  {
+    return (m_localIndices[indices[triangle * 3 + 0]] == NotInMeshlet ? 1 : 0) + (m_localIndices[indices[triangle * 3 + 1]] == NotInMeshlet ? 1 : 0) +
+      (m_localIndices[indices[triangle * 3 + 2]] == NotInMeshlet ? 1 : 0);
+  }
+
+  void MeshletBuilder::AddTriangle(const uint32* indices, uint32 triangle, MeshletData& result, Meshlet& meshlet)
+  {
+    for (uint32 corner = 0; corner < 3; ++corner)
+    {
+      const uint32 vertex = indices[triangle * 3 + corner];
+      if (m_localIndices[vertex] == NotInMeshlet)
+      {
+        m_localIndices[vertex] = (uint16)meshlet.vertexCount++;
+        result.vertices.push_back(vertex);
+      }
+      result.triangles.push_back((uint8)m_localIndices[vertex]);
+      m_liveTriangles[vertex]--;
+    }
+    m_emitted[triangle] = 1;
+
+    // Running average of the triangle centers, sum of the unit normals
+    const float weight = 1.0f / (float)(meshlet.triangleCount + 1);
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+      m_meshletCenter[axis] += (m_centers[triangle * 3 + axis] - m_meshletCenter[axis]) * weight;
+      m_meshletNormal[axis] += m_normals[triangle * 3 + axis];
+    }
+    meshlet.triangleCount++;
+  }
+
+  void MeshletBuilder::FinishMeshlet(MeshletData& result, Meshlet& meshlet, const float* positions, uint32 positionStride)
+  {
+    for (uint32 i = 0; i < meshlet.vertexCount; ++i)
+      m_localIndices[result.vertices[meshlet.vertexOffset + i]] = NotInMeshlet;
+
+    result.meshlets.push_back(meshlet);
+    result.bounds.push_back(ComputeBounds(result, result.GetMeshletCount() - 1, positions, positionStride));
+
+    meshlet = Meshlet();
+    meshlet.vertexOffset = (uint32)result.vertices.size();
+    meshlet.triangleOffset = (uint32)result.triangles.size();
+    m_meshletCenter[0] = m_meshletCenter[1] = m_meshletCenter[2] = 0.0f;
+    m_meshletNormal[0] = m_meshletNormal[1] = m_meshletNormal[2] = 0.0f;
+  }
+
+  MeshletBounds MeshletBuilder::ComputeBounds(const MeshletData& data, uint32 meshletIndex, const float* positions, uint32 positionStride)
+  {
+    const Meshlet& meshlet = data.meshlets[meshletIndex];
+    const uint32* vertices = data.vertices.data() + meshlet.vertexOffset;
+    const uint8* triangles = data.triangles.data() + meshlet.triangleOffset;
+
+    // Sphere centered on the box of the vertices, like the mesh bounds
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32 i = 0; i < meshlet.vertexCount; ++i)
+    {
+      const float* position = GetPosition(positions, positionStride, vertices[i]);
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        minimum[axis] = std::min(minimum[axis], position[axis]);
+        maximum[axis] = std::max(maximum[axis], position[axis]);
+      }
+    }
+
+    MeshletBounds bounds;
+    float radiusSq = 0.0f;
+    for (uint32 axis = 0; axis < 3; ++axis)
+      bounds.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+    for (uint32 i = 0; i < meshlet.vertexCount; ++i)
+    {
+      const float* position = GetPosition(positions, positionStride, vertices[i]);
+      const float offset[3] = { position[0] - bounds.center[0], position[1] - bounds.center[1], position[2] - bounds.center[2] };
+      radiusSq = std::max(radiusSq, Dot3(offset, offset));
+    }
+    bounds.radius = sqrtf(radiusSq);
+
+    // Cone axis is the average normal, its angle reaches the normal furthest from it
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32 triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+    {
+      float normal[3];
+      TriangleNormal(GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 0]]),
+        GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 1]]),
+        GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 2]]), normal);
+      Normalize3(normal);
+      axis[0] += normal[0];
+      axis[1] += normal[1];
+      axis[2] += normal[2];
+    }
+
+    float minDot = 1.0f;
+    const bool hasAxis = Normalize3(axis) > 0.0f;
+    for (uint32 triangle = 0; hasAxis && triangle < meshlet.triangleCount; ++triangle)
+    {
+      float normal[3];
+      TriangleNormal(GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 0]]),
+        GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 1]]),
+        GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 2]]), normal);
+      if (Normalize3(normal) > 0.0f)
+        minDot = std::min(minDot, Dot3(normal, axis));
+    }
+
+    bounds.coneAxis[0] = axis[0];
+    bounds.coneAxis[1] = axis[1];
+    bounds.coneAxis[2] = axis[2];
+
+    // Normals over 90 degrees apart, some triangle faces any point
+    if (!hasAxis || minDot <= 0.0f)
+    {
+      bounds.coneApex[0] = bounds.center[0];
+      bounds.coneApex[1] = bounds.center[1];
+      bounds.coneApex[2] = bounds.center[2];
+      bounds.coneCutoff = 1.0f;
+      return bounds;
+    }
+
+    // The apex is moved back along the axis until it is behind the plane of every triangle, a point in the cone's
+    // back-facing region seen from the apex is then behind all the planes
+    float maxT = 0.0f;
+    for (uint32 triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+    {
+      const float* p0 = GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 0]]);
+      float normal[3];
+      TriangleNormal(p0, GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 1]]),
+        GetPosition(positions, positionStride, vertices[triangles[triangle * 3 + 2]]), normal);
+      if (Normalize3(normal) == 0.0f)
+        continue;
+
+      const float toCenter[3] = { bounds.center[0] - p0[0], bounds.center[1] - p0[1], bounds.center[2] - p0[2] };
+      maxT = std::max(maxT, Dot3(toCenter, normal) / Dot3(axis, normal));
+    }
+
+    bounds.coneApex[0] = bounds.center[0] - axis[0] * maxT;
+    bounds.coneApex[1] = bounds.center[1] - axis[1] * maxT;
+    bounds.coneApex[2] = bounds.center[2] - axis[2] * maxT;
+    bounds.coneCutoff = sqrtf(std::max(0.0f, 1.0f - minDot * minDot));
+    return bounds;
+  }
+
+  MeshletStats MeshletBuilder::GetStats(const MeshletData& data, const MeshletOptions& options)
+  {
+    MeshletStats stats;
+    stats.meshletCount = data.GetMeshletCount();
+    if (stats.meshletCount == 0)
+      return stats;
+
+    uint64 vertexSum = 0;
+    uint32 cullable = 0;
+    for (uint32 i = 0; i < stats.meshletCount; ++i)
+    {
+      vertexSum += data.meshlets[i].vertexCount;
+      stats.triangleCount += data.meshlets[i].triangleCount;
+      cullable += data.bounds[i].coneCutoff < 1.0f ? 1 : 0;
+    }
+
+    uint32 vertexCount = 0;
+    for (uint32 vertex : data.vertices)
+      vertexCount = std::max(vertexCount, vertex + 1);
+    std::vector<uint8> referenced(vertexCount, 0);
+    uint32 uniqueCount = 0;
+    for (uint32 vertex : data.vertices)
+    {
+      uniqueCount += referenced[vertex] ? 0 : 1;
+      referenced[vertex] = 1;
+    }
+
+    stats.vertexFill = (float)vertexSum / ((float)stats.meshletCount * options.maxVertices);
+    stats.triangleFill = (float)stats.triangleCount / ((float)stats.meshletCount * options.maxTriangles);
+    stats.vertexDuplication = (float)vertexSum / (float)uniqueCount;
+    stats.cullableFraction = (float)cullable / (float)stats.meshletCount;
+    return stats;
+  }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  // A cluster of triangles, ranges of the vertex and triangle arrays of its MeshletData
+  struct Meshlet
+  {
+    uint32 vertexOffset = 0;
+    uint32 triangleOffset = 0; // In bytes, three local indices per triangle
+    uint32 vertexCount = 0;
+    uint32 triangleCount = 0;
+  };
+
+  // Mesh space culling data of a meshlet. The cone holds the normals of the triangles, the meshlet faces away from every
+  // point p with dot(normalize(coneApex - p), coneAxis) >= coneCutoff. A cutoff of 1 never culls.
+  struct MeshletBounds
+  {
+    float center[3];
+    float radius;
+    float coneApex[3];
+    float coneAxis[3];
+    float coneCutoff; // Sine of the cone's half angle
+  };
+
+  struct MeshletData
+  {
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<uint32> vertices; // Vertex indices of the mesh, per meshlet
+    std::vector<uint8> triangles; // Indices in the meshlet's vertices
+
+    inline uint32 GetMeshletCount() const { return (uint32)meshlets.size(); }
+  };
+
+  struct MeshletOptions
+  {
+    uint32 maxVertices = 64; // At most 256, local indices are 8 bits
+    uint32 maxTriangles = 124; // At most 512
+    // Against the spatial distance, higher values give tighter cones and less filled meshlets
+    float coneWeight = 0.25f;
+  };
+
+  struct MeshletStats
+  {
+    uint32 meshletCount = 0;
+    uint32 triangleCount = 0;
+    float vertexFill = 0.0f; // Average vertex count over the maximum
+    float triangleFill = 0.0f;
+    float vertexDuplication = 0.0f; // Meshlet vertices over the referenced mesh vertices
+    float cullableFraction = 0.0f; // Meshlets with a cone that can cull
+  };
+
+  /*
+  * Splits a triangle list into meshlets with 8-bit local indices, for cluster culling and mesh shaders.
+  * A meshlet grows from a seed triangle over its neighbours, preferring triangles that add the fewest new vertices, then the ones
+  * close to the meshlet that keep its normals together. When no neighbour fits the meshlet takes the next free triangle in Morton
+  * order of the triangle centers, so disconnected pieces still fill meshlets with close triangles.
+  * It does not depend on D3D, positions are three floats at any byte stride.
+  */
+  class MeshletBuilder
+  {
+  public:
+    static constexpr uint32 MaxVertexLimit = 256;
+    static constexpr uint32 MaxTriangleLimit = 512;
+
+    // Replaces the content of result, returns the meshlet count
+    uint32 Build(const float* positions, uint32 positionStride, uint32 vertexCount, const uint32* indices, uint32 indexCount,
+      const MeshletOptions& options, MeshletData& result);
+
+    static MeshletBounds ComputeBounds(const MeshletData& data, uint32 meshletIndex, const float* positions, uint32 positionStride);
+    static MeshletStats GetStats(const MeshletData& data, const MeshletOptions& options);
+
+  private:
+    static constexpr uint16 NotInMeshlet = 0xFFFF;
+    static constexpr uint32 InvalidTriangle = 0xFFFFFFFF;
+
+    void BuildAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount);
+    void ComputeTriangleData(const float* positions, uint32 positionStride, const uint32* indices, uint32 triangleCount, uint32 maxTriangles);
+    // Best free neighbour of the current meshlet that fits, InvalidTriangle if there is none
+    uint32 FindNeighbour(const uint32* indices, const MeshletOptions& options, const uint32* meshletVertices, uint32 meshletVertexCount) const;
+    uint32 CountNewVertices(const uint32* indices, uint32 triangle) const;
+    void AddTriangle(const uint32* indices, uint32 triangle, MeshletData& result, Meshlet& meshlet);
+    void FinishMeshlet(MeshletData& result, Meshlet& meshlet, const float* positions, uint32 positionStride);
+
+  private:
+    // Triangles around each vertex
+    std::vector<uint32> m_triangleOffsets;
+    std::vector<uint32> m_triangles;
+    std::vector<uint32> m_liveTriangles; // Free triangles around each vertex
+
+    std::vector<float> m_centers; // Three floats per triangle
+    std::vector<float> m_normals; // Three floats per triangle, zero for degenerate triangles
+    std::vector<uint32> m_mortonOrder; // Triangles sorted by the Morton code of their center
+    std::vector<uint8> m_emitted;
+    std::vector<uint32> m_mortonCodes;
+
+    std::vector<uint16> m_localIndices; // Per mesh vertex, in the current meshlet
+    float m_meshletCenter[3] = {};
+    float m_meshletNormal[3] = {};
+    float m_meshletRadius = 1.0f; // Expected radius of a full meshlet
+  };
+}
@@ -0,0 +1,60 @@
+#include "PositionStream.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    constexpr uint32 Unassigned = 0xFFFFFFFF;
+
+    inline const float* GetPosition(const float* positions, uint32 stride, uint32 vertex)
+    {
+      return reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(positions) + (size_t)vertex * stride);
+    }
+
+    inline uint32 HashPosition(const float* position)
+    {
+      uint32 bits[3];
+      memcpy(bits, position, sizeof(bits));
+      return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+  }
+
+  uint32 PositionStreamBuilder::Build(const float* positions, uint32 positionStride, uint32 vertexCount, const uint32* indices, uint32 indexCount)
+  {
+    uint32 tableSize = 1;
+    while (tableSize < vertexCount * 2)
+      tableSize *= 2;
+    m_table.assign(tableSize, Unassigned);
+    m_vertexPositions.assign(vertexCount, Unassigned);
+    m_sourceVertices.clear();
+    m_indices.resize(indexCount);
+
+    for (uint32 i = 0; i < indexCount; ++i)
+    {
+      const uint32 vertex = indices[i];
+      assert(vertex < vertexCount && "Index out of the vertices!");
+      if (m_vertexPositions[vertex] == Unassigned)
+      {
+        // First use of the vertex, its position may already be numbered through another vertex
+        const float* position = GetPosition(positions, positionStride, vertex);
+        uint32 slot = HashPosition(position) & (tableSize - 1);
+        while (m_table[slot] != Unassigned &&
+          memcmp(GetPosition(positions, positionStride, m_sourceVertices[m_table[slot]]), position, 3 * sizeof(float)) != 0)
+          slot = (slot + 1) & (tableSize - 1);
+
+        if (m_table[slot] == Unassigned)
+        {
+          m_table[slot] = (uint32)m_sourceVertices.size();
+          m_sourceVertices.push_back(vertex);
+        }
+        m_vertexPositions[vertex] = m_table[slot];
+      }
+      m_indices[i] = m_vertexPositions[vertex];
+    }
+
+    return (uint32)m_sourceVertices.size();
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Position-only geometry for the passes that only write depth, depth prepasses and shadow maps, so they do not fetch the
+  * attributes they never read.
+  * Vertices split for their other attributes (colour seams, flat shading) are welded back when their positions are bitwise
+  * equal, the welded positions have their own index buffer with the triangles at the same places so the levels of detail
+  * keep their ranges. Positions are numbered in the order of their first use, the fetches follow the triangles like after
+  * MeshOptimizer::OptimizeVertexFetch, and the vertices no triangle uses are dropped.
+  * It does not depend on D3D, positions are three floats at any byte stride.
+  */
+  class PositionStreamBuilder
+  {
+  public:
+    // Returns the position count
+    uint32 Build(const float* positions, uint32 positionStride, uint32 vertexCount, const uint32* indices, uint32 indexCount);
+
+    // Indices of the positions, as many as the source indices
+    inline const std::vector<uint32>& GetIndices() const { return m_indices; }
+    // Source vertex of every position
+    inline const std::vector<uint32>& GetSourceVertices() const { return m_sourceVertices; }
+
+  private:
+    std::vector<uint32> m_indices;
+    std::vector<uint32> m_sourceVertices;
+
+    // Scratch
+    std::vector<uint32> m_table; // Open addressing on the position bits, holds position numbers
+    std::vector<uint32> m_vertexPositions; // Position of every source vertex once it is seen
+  };
+}
@@ -0,0 +1,149 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    constexpr uint32 MortonBits = 10; // Per axis
+
+    // Spreads the low 10 bits two bits apart
+    inline uint32 SpreadBits(uint32 value)
+    {
+      value &= 0x3FF;
+      value = (value | (value << 16)) & 0x030000FF;
+      value = (value | (value << 8)) & 0x0300F00F;
+      value = (value | (value << 4)) & 0x030C30C3;
+      value = (value | (value << 2)) & 0x09249249;
+      return value;
+    }
+
+    inline float GetCenter(const StaticBatchSource& source, uint32 axis)
+    {
+      return (source.boundsMin[axis] + source.boundsMax[axis]) * 0.5f;
+    }
+  }
+
+  void StaticBatcher::Build(const StaticBatchSource* sources, uint32 sourceCount, const StaticBatchOptions& options)
+  {
+    m_batches.clear();
+    m_pieces.clear();
+    m_indices.clear();
+    m_sourcePieces.assign(sourceCount, InvalidPiece);
+    if (sourceCount == 0)
+      return;
+
+    // Morton codes of the centers in the box around them
+    float sceneMin[3] = { GetCenter(sources[0], 0), GetCenter(sources[0], 1), GetCenter(sources[0], 2) };
+    float sceneMax[3] = { sceneMin[0], sceneMin[1], sceneMin[2] };
+    for (uint32 source = 1; source < sourceCount; ++source)
+    {
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        sceneMin[axis] = std::min(sceneMin[axis], GetCenter(sources[source], axis));
+        sceneMax[axis] = std::max(sceneMax[axis], GetCenter(sources[source], axis));
+      }
+    }
+
+    // Cubic cells, a level is mostly flat and its height would take as many bits as its width otherwise
+    const float sceneExtent = std::max(sceneMax[0] - sceneMin[0], std::max(sceneMax[1] - sceneMin[1], sceneMax[2] - sceneMin[2]));
+    const float scale = sceneExtent > 0.0f ? (float)((1 << MortonBits) - 1) / sceneExtent : 0.0f;
+
+    m_order.resize(sourceCount);
+    for (uint32 source = 0; source < sourceCount; ++source)
+    {
+      uint32 morton = 0;
+      for (uint32 axis = 0; axis < 3; ++axis)
+        morton |= SpreadBits((uint32)((GetCenter(sources[source], axis) - sceneMin[axis]) * scale + 0.5f)) << axis;
+
+      m_order[source] = { ((uint64)sources[source].material << (3 * MortonBits)) | morton, source };
+    }
+    std::sort(m_order.begin(), m_order.end());
+
+    uint32 first = 0;
+    while (first < sourceCount)
+      first = BuildBatch(sources, first, options);
+  }
+
+  uint32 StaticBatcher::BuildBatch(const StaticBatchSource* sources, uint32 first, const StaticBatchOptions& options)
+  {
+    StaticBatch batch;
+    batch.material = sources[m_order[first].second].material;
+    batch.firstPiece = (uint32)m_pieces.size();
+    batch.indexOffset = (uint32)m_indices.size();
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+      batch.boundsMin[axis] = sources[m_order[first].second].boundsMin[axis];
+      batch.boundsMax[axis] = sources[m_order[first].second].boundsMax[axis];
+    }
+
+    uint32 next = first;
+    for (; next < (uint32)m_order.size(); ++next)
+    {
+      const uint32 source = m_order[next].second;
+      const StaticBatchSource& batchSource = sources[source];
+      if (batchSource.material != batch.material || batch.vertexCount + batchSource.vertexCount > options.maxVertices)
+        break;
+
+      float boundsMin[3];
+      float boundsMax[3];
+      bool fits = true;
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        boundsMin[axis] = std::min(batch.boundsMin[axis], batchSource.boundsMin[axis]);
+        boundsMax[axis] = std::max(batch.boundsMax[axis], batchSource.boundsMax[axis]);
+        fits = fits && boundsMax[axis] - boundsMin[axis] <= options.maxExtent;
+      }
+      if (!fits && next > first)
+        break;
+
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        batch.boundsMin[axis] = boundsMin[axis];
+        batch.boundsMax[axis] = boundsMax[axis];
+      }
+
+      StaticBatchPiece piece;
+      piece.source = source;
+      piece.vertexOffset = batch.vertexCount;
+      piece.indexOffset = batch.indexCount;
+      piece.indexCount = batchSource.indexCount;
+      m_pieces.push_back(piece);
+
+      for (uint32 i = 0; i < batchSource.indexCount; ++i)
+      {
+        assert(batchSource.indices[i] < batchSource.vertexCount && "Index out of the vertices!");
+        m_indices.push_back(batch.vertexCount + batchSource.indices[i]);
+      }
+      batch.vertexCount += batchSource.vertexCount;
+      batch.indexCount += batchSource.indexCount;
+    }
+
+    // Too few sources to be worth a copy, the next one gets another chance to start a batch
+    batch.pieceCount = (uint32)m_pieces.size() - batch.firstPiece;
+    if (batch.pieceCount < std::max(options.minSources, 1u))
+    {
+      m_pieces.resize(batch.firstPiece);
+      m_indices.resize(batch.indexOffset);
+      return first + 1;
+    }
+
+    float radiusSquared = 0.0f;
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+      batch.center[axis] = (batch.boundsMin[axis] + batch.boundsMax[axis]) * 0.5f;
+      const float halfExtent = (batch.boundsMax[axis] - batch.boundsMin[axis]) * 0.5f;
+      radiusSquared += halfExtent * halfExtent;
+    }
+    batch.radius = sqrtf(radiusSquared);
+
+    for (uint32 piece = batch.firstPiece; piece < batch.firstPiece + batch.pieceCount; ++piece)
+      m_sourcePieces[m_pieces[piece].source] = piece;
+    m_batches.push_back(batch);
+
+    return next;
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "Types.h"
+#include "IndexSplitter.h"
+
+namespace WoohooDX12
+{
+  // A static mesh placed in the world, only its full detail level is batched
+  struct StaticBatchSource
+  {
+    float boundsMin[3]; // World space box
+    float boundsMax[3];
+    uint32 material = 0;
+    uint32 vertexCount = 0;
+    const uint32* indices = nullptr;
+    uint32 indexCount = 0;
+  };
+
+  // Where a source landed in its batch
+  struct StaticBatchPiece
+  {
+    uint32 source = 0;
+    uint32 vertexOffset = 0; // The vertices of the source are copied here, in their order
+    uint32 indexOffset = 0; // Relative to the batch, as in the batch's index buffer
+    uint32 indexCount = 0;
+  };
+
+  struct StaticBatch
+  {
+    uint32 material = 0;
+    uint32 firstPiece = 0;
+    uint32 pieceCount = 0;
+    uint32 vertexCount = 0;
+    uint32 indexOffset = 0; // In the indices of the batcher
+    uint32 indexCount = 0;
+    float boundsMin[3];
+    float boundsMax[3];
+    float center[3]; // Sphere around the box
+    float radius;
+  };
+
+  struct StaticBatchOptions
+  {
+    uint32 maxVertices = 65536; // A batch is one draw with 16-bit indices
+    float maxExtent = 32.0f; // Largest side of a batch's box, larger batches are drawn more often than they are seen
+    uint32 minSources = 2; // Smaller batches leave their sources alone
+  };
+
+  /*
+  * Merges the static meshes of a scene sharing a material into batches, built once at load.
+  * Sources are sorted by material then along a Morton curve through the centers of their boxes, and consecutive ones are packed
+  * while the batch stays under the vertex and extent budgets, so a batch holds neighbouring sources and its bounds cull well.
+  * The batch indices are the source indices offset to where the source vertices go, the caller copies the vertices in world
+  * space. Every source keeps its index range, hiding a piece draws the ranges around it.
+  * Sources that fit no batch have no piece, they are drawn on their own. It does not depend on D3D.
+  */
+  class StaticBatcher
+  {
+  public:
+    static constexpr uint32 InvalidPiece = 0xFFFFFFFF;
+
+    void Build(const StaticBatchSource* sources, uint32 sourceCount, const StaticBatchOptions& options);
+
+    inline const std::vector<StaticBatch>& GetBatches() const { return m_batches; }
+    // Pieces of batch b are [firstPiece, firstPiece + pieceCount), in the order of their indices
+    inline const std::vector<StaticBatchPiece>& GetPieces() const { return m_pieces; }
+    inline const std::vector<uint32>& GetIndices() const { return m_indices; }
+    // InvalidPiece for the sources left out
+    inline uint32 GetSourcePiece(uint32 source) const { return m_sourcePieces[source]; }
+
+    // Draw ranges of the visible pieces of a batch, neighbouring pieces share a range. ranges needs room for half the pieces
+    // rounded up, returns the range count.
+    template<typename IsPieceVisible>
+    static uint32 GetVisibleRanges(const StaticBatch& batch, IsPieceVisible isPieceVisible, const StaticBatchPiece* pieces, IndexChunk* ranges)
+    {
+      uint32 rangeCount = 0;
+      bool open = false;
+      for (uint32 piece = batch.firstPiece; piece < batch.firstPiece + batch.pieceCount; ++piece)
+      {
+        if (!isPieceVisible(piece))
+        {
+          open = false;
+          continue;
+        }
+
+        if (open)
+        {
+          ranges[rangeCount - 1].indexCount += pieces[piece].indexCount;
+          continue;
+        }
+
+        ranges[rangeCount++] = { pieces[piece].indexOffset, pieces[piece].indexCount, 0 };
+        open = true;
+      }
+
+      return rangeCount;
+    }
+
+  private:
+    // Packs the sorted sources from first on into one batch, returns the first sorted source left
+    uint32 BuildBatch(const StaticBatchSource* sources, uint32 first, const StaticBatchOptions& options);
+
+  private:
+    std::vector<StaticBatch> m_batches;
+    std::vector<StaticBatchPiece> m_pieces;
+    std::vector<uint32> m_indices;
+    std::vector<uint32> m_sourcePieces;
+
+    // Scratch
+    std::vector<std::pair<uint64, uint32>> m_order; // Material and Morton code of every source
+  };
+}
@@ -0,0 +1,466 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    constexpr float DegreesPerRadian = 57.2957795f;
+
+    inline const float* GetAttribute(const VertexSource& source, VertexAttribute attribute, uint32 vertex)
+    {
+      const uint32 index = (uint32)attribute;
+      return reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(source.attributes[index]) + (size_t)vertex * source.strides[index]);
+    }
+
+    inline float Saturate(float value)
+    {
+      return std::min(std::max(value, 0.0f), 1.0f);
+    }
+
+    inline float Normalize(float* vector, uint32 count)
+    {
+      float lengthSq = 0.0f;
+      for (uint32 i = 0; i < count; ++i)
+        lengthSq += vector[i] * vector[i];
+
+      const float length = sqrtf(lengthSq);
+      if (length > 0.0f)
+      {
+        for (uint32 i = 0; i < count; ++i)
+          vector[i] /= length;
+      }
+      return length;
+    }
+
+    // Accurate for small angles too, unlike the arc cosine of the dot product
+    inline float GetAngleDegrees(const float* a, const float* b)
+    {
+      const float cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+      const float sine = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+      return atan2f(sine, a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) * DegreesPerRadian;
+    }
+
+    // Codes decode to code * step + base, the closest of the four codes around the exact position wins
+    void QuantizeOctahedral(const float* direction, float step, float base, int32 minCode, int32 maxCode, int32* codes)
+    {
+      float unit[3] = { direction[0], direction[1], direction[2] };
+      if (Normalize(unit, 3) == 0.0f)
+        unit[2] = 1.0f;
+
+      float x;
+      float y;
+      VertexQuantizer::EncodeOctahedral(unit, x, y);
+      const int32 baseX = (int32)floorf((x - base) / step);
+      const int32 baseY = (int32)floorf((y - base) / step);
+
+      float bestDot = -FLT_MAX;
+      for (uint32 i = 0; i < 4; ++i)
+      {
+        const int32 codeX = std::min(std::max(baseX + (int32)(i & 1), minCode), maxCode);
+        const int32 codeY = std::min(std::max(baseY + (int32)(i >> 1), minCode), maxCode);
+
+        float decoded[3];
+        VertexQuantizer::DecodeOctahedral(codeX * step + base, codeY * step + base, decoded);
+        const float dot = decoded[0] * unit[0] + decoded[1] * unit[1] + decoded[2] * unit[2];
+        if (dot > bestDot)
+        {
+          bestDot = dot;
+          codes[0] = codeX;
+          codes[1] = codeY;
+        }
+      }
+    }
+
+    inline float DecodeSnorm16(int16 code)
+    {
+      return std::max(code / 32767.0f, -1.0f);
+    }
+  }
+
+  VertexLayout VertexLayout::Make(uint32 attributes, uint32 compactAttributes)
+  {
+    VertexLayout layout;
+    layout.attributes = attributes;
+    layout.compactAttributes = compactAttributes & attributes;
+    for (uint32 i = 0; i < (uint32)VertexAttribute::Count; ++i)
+    {
+      const VertexAttribute attribute = (VertexAttribute)i;
+      if (!layout.Has(attribute))
+        continue;
+
+      layout.offsets[i] = layout.stride;
+      layout.stride += GetSize(attribute, layout.IsCompact(attribute));
+    }
+    return layout;
+  }
+
+  uint32 VertexLayout::GetSize(VertexAttribute attribute, bool compact)
+  {
+    switch (attribute)
+    {
+    case VertexAttribute::Position: return compact ? 8 : 12;
+    case VertexAttribute::Normal: return compact ? 4 : 12;
+    case VertexAttribute::Tangent: return compact ? 4 : 16;
+    case VertexAttribute::UV: return compact ? 4 : 8;
+    case VertexAttribute::Color: return compact ? 4 : 12;
+    default: return 0;
+    }
+  }
+
+  PositionQuantization VertexQuantizer::ComputePositionQuantization(const float* positions, uint32 positionStride, uint32 vertexCount)
+  {
+    PositionQuantization quantization;
+    if (vertexCount == 0)
+      return quantization;
+
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+    {
+      const float* position = reinterpret_cast<const float*>(reinterpret_cast<const uint8*>(positions) + (size_t)vertex * positionStride);
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        minimum[axis] = std::min(minimum[axis], position[axis]);
+        maximum[axis] = std::max(maximum[axis], position[axis]);
+      }
+    }
+
+    const float extent = std::max({ maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2] });
+    quantization.offset[0] = minimum[0];
+    quantization.offset[1] = minimum[1];
+    quantization.offset[2] = minimum[2];
+    quantization.scale = extent > 0.0f ? extent : 1.0f;
+    return quantization;
+  }
+
+  void VertexQuantizer::Encode(const VertexSource& source, const VertexLayout& layout, const PositionQuantization& quantization, void* destination)
+  {
+    uint8* vertices = static_cast<uint8*>(destination);
+    for (uint32 vertex = 0; vertex < source.vertexCount; ++vertex)
+    {
+      uint8* output = vertices + (size_t)vertex * layout.stride;
+
+      if (layout.Has(VertexAttribute::Position))
+      {
+        const float* position = GetAttribute(source, VertexAttribute::Position, vertex);
+        uint8* target = output + layout.offsets[(uint32)VertexAttribute::Position];
+        if (layout.IsCompact(VertexAttribute::Position))
+        {
+          uint16 codes[4] = {};
+          for (uint32 axis = 0; axis < 3; ++axis)
+            codes[axis] = (uint16)lrintf(Saturate((position[axis] - quantization.offset[axis]) / quantization.scale) * 65535.0f);
+          memcpy(target, codes, sizeof(codes));
+        }
+        else
+        {
+          memcpy(target, position, 3 * sizeof(float));
+        }
+      }
+
+      if (layout.Has(VertexAttribute::Normal))
+      {
+        const float* normal = GetAttribute(source, VertexAttribute::Normal, vertex);
+        uint8* target = output + layout.offsets[(uint32)VertexAttribute::Normal];
+        if (layout.IsCompact(VertexAttribute::Normal))
+        {
+          int32 codes[2];
+          QuantizeOctahedral(normal, 1.0f / 32767.0f, 0.0f, -32767, 32767, codes);
+          const int16 packed[2] = { (int16)codes[0], (int16)codes[1] };
+          memcpy(target, packed, sizeof(packed));
+        }
+        else
+        {
+          memcpy(target, normal, 3 * sizeof(float));
+        }
+      }
+
+      if (layout.Has(VertexAttribute::Tangent))
+      {
+        const float* tangent = GetAttribute(source, VertexAttribute::Tangent, vertex);
+        uint8* target = output + layout.offsets[(uint32)VertexAttribute::Tangent];
+        if (layout.IsCompact(VertexAttribute::Tangent))
+        {
+          // R10G10B10A2: x and y of the square, blue unused, alpha 0 or 3 so it decodes to 0 or 1
+          int32 codes[2];
+          QuantizeOctahedral(tangent, 2.0f / 1023.0f, -1.0f, 0, 1023, codes);
+          const uint32 packed = (uint32)codes[0] | ((uint32)codes[1] << 10) | ((tangent[3] < 0.0f ? 0u : 3u) << 30);
+          memcpy(target, &packed, sizeof(packed));
+        }
+        else
+        {
+          memcpy(target, tangent, 4 * sizeof(float));
+        }
+      }
+
+      if (layout.Has(VertexAttribute::UV))
+      {
+        const float* uv = GetAttribute(source, VertexAttribute::UV, vertex);
+        uint8* target = output + layout.offsets[(uint32)VertexAttribute::UV];
+        if (layout.IsCompact(VertexAttribute::UV))
+        {
+          const uint16 packed[2] = { FloatToHalf(uv[0]), FloatToHalf(uv[1]) };
+          memcpy(target, packed, sizeof(packed));
+        }
+        else
+        {
+          memcpy(target, uv, 2 * sizeof(float));
+        }
+      }
+
+      if (layout.Has(VertexAttribute::Color))
+      {
+        const float* color = GetAttribute(source, VertexAttribute::Color, vertex);
+        uint8* target = output + layout.offsets[(uint32)VertexAttribute::Color];
+        if (layout.IsCompact(VertexAttribute::Color))
+        {
+          const uint8 packed[4] = { (uint8)lrintf(Saturate(color[0]) * 255.0f), (uint8)lrintf(Saturate(color[1]) * 255.0f),
+            (uint8)lrintf(Saturate(color[2]) * 255.0f), 255 };
+          memcpy(target, packed, sizeof(packed));
+        }
+        else
+        {
+          memcpy(target, color, 3 * sizeof(float));
+        }
+      }
+    }
+  }
+
+  void VertexQuantizer::Decode(const void* vertices, const VertexLayout& layout, const PositionQuantization& quantization, uint32 vertex, DecodedVertex& result)
+  {
+    const uint8* input = static_cast<const uint8*>(vertices) + (size_t)vertex * layout.stride;
+
+    if (layout.Has(VertexAttribute::Position))
+    {
+      const uint8* source = input + layout.offsets[(uint32)VertexAttribute::Position];
+      if (layout.IsCompact(VertexAttribute::Position))
+      {
+        uint16 codes[4];
+        memcpy(codes, source, sizeof(codes));
+        for (uint32 axis = 0; axis < 3; ++axis)
+          result.position[axis] = quantization.offset[axis] + quantization.scale * (codes[axis] / 65535.0f);
+      }
+      else
+      {
+        memcpy(result.position, source, 3 * sizeof(float));
+      }
+    }
+
+    if (layout.Has(VertexAttribute::Normal))
+    {
+      const uint8* source = input + layout.offsets[(uint32)VertexAttribute::Normal];
+      if (layout.IsCompact(VertexAttribute::Normal))
+      {
+        int16 codes[2];
+        memcpy(codes, source, sizeof(codes));
+        DecodeOctahedral(DecodeSnorm16(codes[0]), DecodeSnorm16(codes[1]), result.normal);
+      }
+      else
+      {
+        memcpy(result.normal, source, 3 * sizeof(float));
+      }
+    }
+
+    if (layout.Has(VertexAttribute::Tangent))
+    {
+      const uint8* source = input + layout.offsets[(uint32)VertexAttribute::Tangent];
+      if (layout.IsCompact(VertexAttribute::Tangent))
+      {
+        uint32 packed;
+        memcpy(&packed, source, sizeof(packed));
+        DecodeOctahedral((packed & 1023) / 1023.0f * 2.0f - 1.0f, ((packed >> 10) & 1023) / 1023.0f * 2.0f - 1.0f, result.tangent);
+        result.tangent[3] = (packed >> 30) / 3.0f * 2.0f - 1.0f;
+      }
+      else
+      {
+        memcpy(result.tangent, source, 4 * sizeof(float));
+      }
+    }
+
+    if (layout.Has(VertexAttribute::UV))
+    {
+      const uint8* source = input + layout.offsets[(uint32)VertexAttribute::UV];
+      if (layout.IsCompact(VertexAttribute::UV))
+      {
+        uint16 codes[2];
+        memcpy(codes, source, sizeof(codes));
+        result.uv[0] = HalfToFloat(codes[0]);
+        result.uv[1] = HalfToFloat(codes[1]);
+      }
+      else
+      {
+        memcpy(result.uv, source, 2 * sizeof(float));
+      }
+    }
+
+    if (layout.Has(VertexAttribute::Color))
+    {
+      const uint8* source = input + layout.offsets[(uint32)VertexAttribute::Color];
+      if (layout.IsCompact(VertexAttribute::Color))
+      {
+        for (uint32 channel = 0; channel < 3; ++channel)
+          result.color[channel] = source[channel] / 255.0f;
+      }
+      else
+      {
+        memcpy(result.color, source, 3 * sizeof(float));
+      }
+    }
+  }
+
+  VertexQuantizationError VertexQuantizer::MeasureError(const VertexSource& source, const void* vertices, const VertexLayout& layout,
+    const PositionQuantization& quantization)
+  {
+    VertexQuantizationError error;
+    for (uint32 vertex = 0; vertex < source.vertexCount; ++vertex)
+    {
+      DecodedVertex decoded;
+      Decode(vertices, layout, quantization, vertex, decoded);
+
+      if (layout.Has(VertexAttribute::Position))
+      {
+        const float* position = GetAttribute(source, VertexAttribute::Position, vertex);
+        const float delta[3] = { decoded.position[0] - position[0], decoded.position[1] - position[1], decoded.position[2] - position[2] };
+        error.position = std::max(error.position, sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]));
+      }
+
+      if (layout.Has(VertexAttribute::Normal))
+      {
+        float normal[3];
+        memcpy(normal, GetAttribute(source, VertexAttribute::Normal, vertex), sizeof(normal));
+        if (Normalize(normal, 3) > 0.0f)
+          error.normalDegrees = std::max(error.normalDegrees, GetAngleDegrees(normal, decoded.normal));
+      }
+
+      if (layout.Has(VertexAttribute::Tangent))
+      {
+        const float* source4 = GetAttribute(source, VertexAttribute::Tangent, vertex);
+        float tangent[3] = { source4[0], source4[1], source4[2] };
+        if (Normalize(tangent, 3) > 0.0f)
+          error.tangentDegrees = std::max(error.tangentDegrees, GetAngleDegrees(tangent, decoded.tangent));
+        if ((source4[3] < 0.0f) != (decoded.tangent[3] < 0.0f))
+          error.handednessErrors++;
+      }
+
+      if (layout.Has(VertexAttribute::UV))
+      {
+        const float* uv = GetAttribute(source, VertexAttribute::UV, vertex);
+        error.uv = std::max({ error.uv, fabsf(decoded.uv[0] - uv[0]), fabsf(decoded.uv[1] - uv[1]) });
+      }
+
+      if (layout.Has(VertexAttribute::Color))
+      {
+        const float* color = GetAttribute(source, VertexAttribute::Color, vertex);
+        for (uint32 channel = 0; channel < 3; ++channel)
+          error.color = std::max(error.color, fabsf(decoded.color[channel] - color[channel]));
+      }
+    }
+    return error;
+  }
+
+  void VertexQuantizer::FoldDequantization(const PositionQuantization& quantization, const Mat4x4& world, Mat4x4& result)
+  {
+    // Scale then translation, so the rows of the world matrix are scaled and the offset moves the origin
+    for (uint32 column = 0; column < 4; ++column)
+    {
+      const float translation = quantization.offset[0] * world.m[0][column] + quantization.offset[1] * world.m[1][column] +
+        quantization.offset[2] * world.m[2][column] + world.m[3][column];
+      result.m[0][column] = quantization.scale * world.m[0][column];
+      result.m[1][column] = quantization.scale * world.m[1][column];
+      result.m[2][column] = quantization.scale * world.m[2][column];
+      result.m[3][column] = translation;
+    }
+  }
+
+  void VertexQuantizer::EncodeOctahedral(const float* direction, float& x, float& y)
+  {
+    const float length = fabsf(direction[0]) + fabsf(direction[1]) + fabsf(direction[2]);
+    x = direction[0] / length;
+    y = direction[1] / length;
+
+    // The lower half is folded over the diagonals
+    if (direction[2] < 0.0f)
+    {
+      const float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      const float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+      x = foldedX;
+      y = foldedY;
+    }
+  }
+
+  void VertexQuantizer::DecodeOctahedral(float x, float y, float* direction)
+  {
+    direction[2] = 1.0f - fabsf(x) - fabsf(y);
+    if (direction[2] < 0.0f)
+    {
+      direction[0] = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      direction[1] = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    else
+    {
+      direction[0] = x;
+      direction[1] = y;
+    }
+    Normalize(direction, 3);
+  }
+
+  uint16 VertexQuantizer::FloatToHalf(float value)
+  {
+    uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32 sign = (bits >> 16) & 0x8000;
+    const uint32 magnitude = bits & 0x7FFFFFFF;
+
+    // Infinity and NaN, NaN stays quiet
+    if (magnitude >= 0x7F800000)
+      return (uint16)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+
+    // Rounds to infinity from 65520
+    if (magnitude >= 0x477FF000)
+      return (uint16)(sign | 0x7C00);
+
+    // Below the smallest normal half the value is a count of 2^-24, rounded to nearest even by the default rounding mode
+    if (magnitude < 0x38800000)
+    {
+      float absolute;
+      memcpy(&absolute, &magnitude, sizeof(absolute));
+      return (uint16)(sign | (uint32)lrintf(absolute * 16777216.0f));
+    }
+
+    // Exponent bias from 127 to 15, the dropped 13 bits are rounded to nearest even
+    const uint32 rebiased = magnitude - 0x38000000;
+    return (uint16)(sign | ((rebiased + 0x0FFF + ((rebiased >> 13) & 1)) >> 13));
+  }
+
+  float VertexQuantizer::HalfToFloat(uint16 value)
+  {
+    const uint32 sign = (uint32)(value & 0x8000) << 16;
+    const uint32 exponent = (value >> 10) & 0x1F;
+    const uint32 mantissa = value & 0x3FF;
+
+    uint32 bits;
+    if (exponent == 0)
+    {
+      const float absolute = mantissa / 16777216.0f;
+      memcpy(&bits, &absolute, sizeof(bits));
+      bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+      bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+      bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+}
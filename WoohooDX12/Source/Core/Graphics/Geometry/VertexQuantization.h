@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  enum class VertexAttribute : uint8
+  {
+    Position, // 3 floats. Compact: 16-bit unorm within the bounds, padded to 8 bytes
+    Normal, // 3 floats. Compact: octahedral in 16-bit snorm, 4 bytes
+    Tangent, // 4 floats, the handedness in w. Compact: octahedral in 10-bit unorm, the handedness in the 2-bit alpha, 4 bytes
+    UV, // 2 floats. Compact: half floats, 4 bytes
+    Color, // 3 floats. Compact: RGBA8 unorm, 4 bytes
+    Count
+  };
+
+  // Attributes of a vertex stream and which of them are compact, they are interleaved in the attribute order
+  struct VertexLayout
+  {
+    uint32 attributes = 0; // Bit per attribute
+    uint32 compactAttributes = 0;
+    uint32 offsets[(uint32)VertexAttribute::Count] = {};
+    uint32 stride = 0;
+
+    static VertexLayout Make(uint32 attributes, uint32 compactAttributes);
+    static uint32 GetSize(VertexAttribute attribute, bool compact);
+    static inline uint32 GetBit(VertexAttribute attribute) { return 1u << (uint32)attribute; }
+
+    inline bool Has(VertexAttribute attribute) const { return (attributes & GetBit(attribute)) != 0; }
+    inline bool IsCompact(VertexAttribute attribute) const { return (compactAttributes & GetBit(attribute)) != 0; }
+  };
+
+  // Local position = offset + scale * stored position. The scale is the same on every axis so the dequantization folded into
+  // a world matrix keeps its angles, and the normals transformed with it stay normal.
+  struct PositionQuantization
+  {
+    float offset[3] = { 0.0f, 0.0f, 0.0f };
+    float scale = 1.0f;
+  };
+
+  // Full precision attributes with their byte strides, null for the attributes the layout does not have
+  struct VertexSource
+  {
+    const float* attributes[(uint32)VertexAttribute::Count] = {};
+    uint32 strides[(uint32)VertexAttribute::Count] = {};
+    uint32 vertexCount = 0;
+  };
+
+  // A vertex as the vertex shader sees it after decoding
+  struct DecodedVertex
+  {
+    float position[3] = {};
+    float normal[3] = {};
+    float tangent[4] = {};
+    float uv[2] = {};
+    float color[3] = {};
+  };
+
+  // Largest errors of the decoded vertices against the source
+  struct VertexQuantizationError
+  {
+    float position = 0.0f; // Distance
+    float normalDegrees = 0.0f;
+    float tangentDegrees = 0.0f;
+    uint32 handednessErrors = 0;
+    float uv = 0.0f;
+    float color = 0.0f;
+  };
+
+  /*
+  * Encodes vertices in a vertex layout and decodes them back like the input assembler and the vertex shader do.
+  * Compact positions are stored in [0, 1] of the bounds, the input assembler expands them to floats and the vertex shader
+  * dequantizes them with the world matrix the quantization is folded into, see FoldDequantization.
+  * Octahedral encoding maps the unit sphere on the octahedron then unfolds it on a square, the codes are chosen among the
+  * four closest ones for the smallest angle.
+  */
+  class VertexQuantizer
+  {
+  public:
+    // Bounds of the positions with a cubic extent
+    static PositionQuantization ComputePositionQuantization(const float* positions, uint32 positionStride, uint32 vertexCount);
+    // Destination needs layout.stride * vertexCount bytes
+    static void Encode(const VertexSource& source, const VertexLayout& layout, const PositionQuantization& quantization, void* destination);
+    static void Decode(const void* vertices, const VertexLayout& layout, const PositionQuantization& quantization, uint32 vertex, DecodedVertex& result);
+    static VertexQuantizationError MeasureError(const VertexSource& source, const void* vertices, const VertexLayout& layout,
+      const PositionQuantization& quantization);
+
+    // result = dequantization * world, for the row vector convention
+    static void FoldDequantization(const PositionQuantization& quantization, const Mat4x4& world, Mat4x4& result);
+
+    // Unit vector to and from the octahedral square in [-1, 1]
+    static void EncodeOctahedral(const float* direction, float& x, float& y);
+    static void DecodeOctahedral(float x, float y, float* direction);
+
+    // Round to nearest even, overflow goes to infinity
+    static uint16 FloatToHalf(float value);
+    static float HalfToFloat(uint16 value);
+  };
+}
@@ -0,0 +1,69 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+
+namespace WoohooDX12
+{
+  void InstanceBatcher::PackInstance(const Mat4x4& world, const Vec4& color, InstanceData& instance)
+  {
+    // The last column of an affine matrix is (0, 0, 0, 1)
+    for (uint32 row = 0; row < 4; ++row)
+    {
+      instance.world[row][0] = world.m[row][0];
+      instance.world[row][1] = world.m[row][1];
+      instance.world[row][2] = world.m[row][2];
+    }
+    instance.color[0] = color.x;
+    instance.color[1] = color.y;
+    instance.color[2] = color.z;
+    instance.color[3] = color.w;
+  }
+
+  void InstanceBatcher::SortDraws(DrawItem* draws, uint32 drawCount)
+  {
+    std::sort(draws, draws + drawCount, [](const DrawItem& a, const DrawItem& b)
+      {
+        return a.sortKey != b.sortKey ? a.sortKey < b.sortKey : a.object < b.object;
+      });
+  }
+
+  void InstanceBatcher::Build(DrawItem* draws, uint32 drawCount)
+  {
+    Clear();
+    SortDraws(draws, drawCount);
+
+    m_instances.resize(drawCount);
+    for (uint32 i = 0; i < drawCount; ++i)
+    {
+      const DrawItem& draw = draws[i];
+      if (draw.positionQuantization != nullptr)
+      {
+        Mat4x4 world;
+        VertexQuantizer::FoldDequantization(*draw.positionQuantization, *draw.modelMatrix, world);
+        PackInstance(world, draw.color, m_instances[i]);
+      }
+      else
+      {
+        PackInstance(*draw.modelMatrix, draw.color, m_instances[i]);
+      }
+
+      const DrawRun* last = m_runs.empty() ? nullptr : &m_runs.back();
+      if (last == nullptr || last->mesh != draw.mesh || last->material != draw.material || last->lod != draw.lod)
+      {
+        DrawRun run;
+        run.mesh = draw.mesh;
+        run.material = draw.material;
+        run.lod = draw.lod;
+        run.firstInstance = i;
+        m_runs.push_back(run);
+      }
+      m_runs.back().instanceCount++;
+    }
+  }
+
+  void InstanceBatcher::Clear()
+  {
+    m_runs.clear();
+    m_instances.clear();
+  }
+}
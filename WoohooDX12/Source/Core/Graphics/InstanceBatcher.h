@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Geometry/VertexQuantization.h"
+
+namespace WoohooDX12
+{
+  class Mesh;
+  class Material;
+
+  struct DrawItem
+  {
+    Mesh* mesh = nullptr;
+    Material* material = nullptr;
+    const Mat4x4* modelMatrix = nullptr;
+    Vec4 color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    uint64 sortKey = 0; // Material, then mesh, then level of detail
+    uint32 object = 0; // Keeps the order of equal keys stable
+    uint32 lod = 0; // Level of detail of the mesh
+    const PositionQuantization* positionQuantization = nullptr; // Of the mesh, folded into the world matrix of the instance
+  };
+
+  // Per instance vertex stream, 64 bytes
+  struct InstanceData
+  {
+    float world[4][3]; // Rows of the world matrix without the last column, row vector convention
+    float color[4];
+  };
+
+  // Draws sharing a mesh, its level of detail and a material (so a pipeline), one instanced draw
+  struct DrawRun
+  {
+    Mesh* mesh = nullptr;
+    Material* material = nullptr;
+    uint32 lod = 0;
+    uint32 firstInstance = 0; // Range in the instance data
+    uint32 instanceCount = 0;
+  };
+
+  /*
+  * Automatic instancing of the draw list. Draws are sorted by material, mesh and level of detail, every run of draws with the
+  * same ones becomes one instanced draw and their transforms and colours are packed in draw order into one instance array.
+  * It does not depend on D3D, the renderer uploads the instance data and issues the draws.
+  */
+  class InstanceBatcher
+  {
+  public:
+    InstanceBatcher() {}
+
+    // The level of detail takes the low 3 bits (MeshLOD::MaxCount), mesh indices have to stay under 2^29
+    static inline uint64 MakeSortKey(uint32 materialIndex, uint32 meshIndex, uint32 lod = 0)
+    {
+      return ((uint64)materialIndex << 32) | ((uint64)meshIndex << 3) | lod;
+    }
+    static void PackInstance(const Mat4x4& world, const Vec4& color, InstanceData& instance);
+
+    // Material, then mesh, then level of detail, equal keys keep the object order
+    static void SortDraws(DrawItem* draws, uint32 drawCount);
+    // Sorts the draws in place
+    void Build(DrawItem* draws, uint32 drawCount);
+    void Clear();
+
+    inline const std::vector<DrawRun>& GetRuns() const { return m_runs; }
+    inline const InstanceData* GetInstances() const { return m_instances.data(); }
+    inline uint32 GetInstanceCount() const { return (uint32)m_instances.size(); }
+
+  private:
+    std::vector<DrawRun> m_runs;
+    std::vector<InstanceData> m_instances;
+  };
+}
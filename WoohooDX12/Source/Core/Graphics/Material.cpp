@@ -1,20 +1,97 @@
 #include "Material.h"
 
-#include <fstream>
+#include <cstring>
 #include <d3dcompiler.h>
 #include "Maths.h"
 #include "Utils.h"
+#include "VertexInputLayout.h"
 
 namespace WoohooDX12
 {
-  Material::Material()
+  namespace
   {
-    m_uboVS.projectionMatrix = DirectX::XMMatrixPerspectiveLH(1.0f, 1.0f, 0.1f, 1000.0f);
+    // Camera, world matrix and colour of the draw from the uniform buffer, in the layout of Material::UboVS
+    const char* ShaderSource = R"(
+cbuffer Uniforms : register(b0)
+{
+  row_major float4x4 projectionMatrix;
+  row_major float4x4 viewMatrix;
+  row_major float4x4 modelMatrix;
+  float4 color;
+};
+
+struct VertexInput
+{
+  float3 position : POSITION;
+  float3 color : COLOR0;
+};
+
+struct PixelInput
+{
+  float4 position : SV_POSITION;
+  float4 color : COLOR;
+};
 
-    const Vec3 camPos = Vec3(0.0f, 0.0f, 2.0f);
-    m_uboVS.viewMatrix = DirectX::XMMatrixLookAtLH(XMLoadFloat3(&camPos), XMLoadFloat3(&ZeroVector), XMLoadFloat3(&UpVector));
+PixelInput VSMain(VertexInput input)
+{
+  PixelInput output;
+  output.position = mul(mul(mul(float4(input.position, 1.0f), modelMatrix), viewMatrix), projectionMatrix);
+  output.color = float4(input.color, 1.0f) * color;
+  return output;
+}
+
+float4 PSMain(PixelInput input) : SV_TARGET
+{
+  return input.color;
+}
+)";
 
-    MakeIdentity(m_uboVS.modelMatrix);
+    // Camera from the uniform buffer, the world matrix and the colour of the instance from slot 1
+    const char* InstancedShaderSource = R"(
+cbuffer Uniforms : register(b0)
+{
+  row_major float4x4 projectionMatrix;
+  row_major float4x4 viewMatrix;
+  row_major float4x4 modelMatrix;
+  float4 color;
+};
+
+struct VertexInput
+{
+  float3 position : POSITION;
+  float3 color : COLOR0;
+  float3 world0 : WORLD0;
+  float3 world1 : WORLD1;
+  float3 world2 : WORLD2;
+  float3 world3 : WORLD3;
+  float4 instanceColor : COLOR1;
+};
+
+struct PixelInput
+{
+  float4 position : SV_POSITION;
+  float4 color : COLOR;
+};
+
+PixelInput VSMain(VertexInput input)
+{
+  const float3 worldPosition = input.position.x * input.world0 + input.position.y * input.world1 + input.position.z * input.world2 + input.world3;
+
+  PixelInput output;
+  output.position = mul(mul(float4(worldPosition, 1.0f), viewMatrix), projectionMatrix);
+  output.color = float4(input.color, 1.0f) * input.instanceColor * color;
+  return output;
+}
+
+float4 PSMain(PixelInput input) : SV_TARGET
+{
+  return input.color;
+}
+)";
+  }
+
+  Material::Material()
+  {
   }
 
   Material::~Material()
@@ -23,7 +100,7 @@ namespace WoohooDX12
     assert(!m_initialized && "Material is not uninitialized!");
   }
 
-  int Material::Init(ID3D12Device* device, ID3D12CommandAllocator* commandAllocator)
+  int Material::Init(ID3D12Device* device, const VertexLayout& vertexLayout)
   {
     AssertAndReturn(!m_initialized, "This material is already initialized.");
 
@@ -40,20 +117,13 @@ namespace WoohooDX12
         featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
       }
 
-      D3D12_DESCRIPTOR_RANGE1 ranges[1];
-      ranges[0].BaseShaderRegister = 0;
-      ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-      ranges[0].NumDescriptors = 1;
-      ranges[0].RegisterSpace = 0;
-      ranges[0].OffsetInDescriptorsFromTableStart = 0;
-      ranges[0].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
-
+      // The uniforms of a draw are a slice of the dynamic buffer, bound without a descriptor
       D3D12_ROOT_PARAMETER1 rootParameters[1];
-      rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-      rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-
-      rootParameters[0].DescriptorTable.NumDescriptorRanges = 1;
-      rootParameters[0].DescriptorTable.pDescriptorRanges = ranges;
+      rootParameters[UniformsParameter].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+      rootParameters[UniformsParameter].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+      rootParameters[UniformsParameter].Descriptor.ShaderRegister = 0;
+      rootParameters[UniformsParameter].Descriptor.RegisterSpace = 0;
+      rootParameters[UniformsParameter].Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
 
       D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
       rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
@@ -93,65 +163,12 @@ namespace WoohooDX12
       ID3DBlob* pixelShader = nullptr;
       ReturnIfFailed(CompileShaders(&vertexShader, &pixelShader));
 
-      // Create the UBO
-
-      D3D12_HEAP_PROPERTIES heapProps = {};
-      heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-      heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-      heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-      heapProps.CreationNodeMask = 1;
-      heapProps.VisibleNodeMask = 1;
-
-      D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-      heapDesc.NumDescriptors = 1;
-      heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-      heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-      ReturnIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_uniformBufferHeap)));
-
-      D3D12_RESOURCE_DESC uboResourceDesc = {};
-      uboResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-      uboResourceDesc.Alignment = 0;
-      uboResourceDesc.Width = (sizeof(m_uboVS) + 255) & ~255;
-      uboResourceDesc.Height = 1;
-      uboResourceDesc.DepthOrArraySize = 1;
-      uboResourceDesc.MipLevels = 1;
-      uboResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-      uboResourceDesc.SampleDesc.Count = 1;
-      uboResourceDesc.SampleDesc.Quality = 0;
-      uboResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-      uboResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-      ReturnIfFailed(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &uboResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_uniformBuffer)));
-      m_uniformBufferHeap->SetName(L"Constant Buffer Upload Resource Heap");
-
-      D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-      cbvDesc.BufferLocation = m_uniformBuffer->GetGPUVirtualAddress();
-      cbvDesc.SizeInBytes = (sizeof(m_uboVS) + 255) & ~255; // CB size is required to be 256-byte aligned
-
-      D3D12_CPU_DESCRIPTOR_HANDLE cbvHandle(m_uniformBufferHeap->GetCPUDescriptorHandleForHeapStart());
-      cbvHandle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) * 0;
-
-      device->CreateConstantBufferView(&cbvDesc, cbvHandle);
-
-      // We do not intend to read from this resource on the CPU. (End is less than or equal to begin)
-      D3D12_RANGE readRange = {};
-      readRange.Begin = 0;
-      readRange.End = 0;
-
-      ReturnIfFailed(m_uniformBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_mappedUniformBuffer)));
-      memcpy(m_mappedUniformBuffer, &m_uboVS, sizeof(m_uboVS));
-      m_uniformBuffer->Unmap(0, &readRange);
-
       // Describe and create the graphics pipeline state object (PSO)
-      D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-      {
-          {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-          {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-      };
+      VertexInputLayout inputLayout;
+      inputLayout.Build(vertexLayout);
 
       D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-      psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+      psoDesc.InputLayout = inputLayout.GetDesc();
       psoDesc.pRootSignature = m_rootSignature;
 
       D3D12_SHADER_BYTECODE vsBytecode = {};
@@ -166,48 +183,7 @@ namespace WoohooDX12
       psoDesc.VS = vsBytecode;
       psoDesc.PS = psBytecode;
 
-      D3D12_RASTERIZER_DESC rasterDesc = {};
-      rasterDesc.FillMode = D3D12_FILL_MODE_SOLID;
-      rasterDesc.CullMode = D3D12_CULL_MODE_NONE;
-      rasterDesc.FrontCounterClockwise = FALSE;
-      rasterDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
-      rasterDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
-      rasterDesc.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
-      rasterDesc.DepthClipEnable = TRUE;
-      rasterDesc.MultisampleEnable = FALSE;
-      rasterDesc.AntialiasedLineEnable = FALSE;
-      rasterDesc.ForcedSampleCount = 0;
-      rasterDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
-
-      psoDesc.RasterizerState = rasterDesc;
-
-      D3D12_BLEND_DESC blendDesc;
-      blendDesc.AlphaToCoverageEnable = FALSE;
-      blendDesc.IndependentBlendEnable = FALSE;
-      const D3D12_RENDER_TARGET_BLEND_DESC defaultRenderTargetBlendDesc =
-      {
-        FALSE,
-        FALSE,
-        D3D12_BLEND_ONE,
-        D3D12_BLEND_ZERO,
-        D3D12_BLEND_OP_ADD,
-        D3D12_BLEND_ONE,
-        D3D12_BLEND_ZERO,
-        D3D12_BLEND_OP_ADD,
-        D3D12_LOGIC_OP_NOOP,
-        D3D12_COLOR_WRITE_ENABLE_ALL,
-      };
-      for (uint32 i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
-        blendDesc.RenderTarget[i] = defaultRenderTargetBlendDesc;
-
-      psoDesc.BlendState = blendDesc;
-      psoDesc.DepthStencilState.DepthEnable = FALSE;
-      psoDesc.DepthStencilState.StencilEnable = FALSE;
-      psoDesc.SampleMask = UINT_MAX;
-      psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-      psoDesc.NumRenderTargets = 1;
-      psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-      psoDesc.SampleDesc.Count = 1;
+      FillPipelineState(psoDesc);
       try
       {
         ReturnIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
@@ -228,19 +204,92 @@ namespace WoohooDX12
         pixelShader->Release();
         pixelShader = nullptr;
       }
-    }
 
-    // Create the command list.
-    ReturnIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator, m_pipelineState, IID_PPV_ARGS(&m_commandList)));
-    m_commandList->SetName(L"Main Material Command List");
+      // Instanced variant of the pipeline, the rows of the world matrix and the colour are per instance data
+      ReturnIfFailed(CompileInstancedShaders(&vertexShader, &pixelShader));
+
+      D3D12_INPUT_ELEMENT_DESC instanceElementDescs[] =
+      {
+          {"WORLD", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+          {"WORLD", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+          {"WORLD", 2, DXGI_FORMAT_R32G32B32_FLOAT, 1, 24, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+          {"WORLD", 3, DXGI_FORMAT_R32G32B32_FLOAT, 1, 36, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+          {"COLOR", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1}
+      };
+
+      VertexInputLayout instancedInputLayout;
+      instancedInputLayout.Build(vertexLayout);
+      instancedInputLayout.Append(instanceElementDescs, _countof(instanceElementDescs));
+
+      psoDesc.InputLayout = instancedInputLayout.GetDesc();
+      psoDesc.VS.pShaderBytecode = vertexShader->GetBufferPointer();
+      psoDesc.VS.BytecodeLength = vertexShader->GetBufferSize();
+      psoDesc.PS.pShaderBytecode = pixelShader->GetBufferPointer();
+      psoDesc.PS.BytecodeLength = pixelShader->GetBufferSize();
+
+      const HRESULT instancedResult = device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_instancedPipelineState));
+
+      vertexShader->Release();
+      vertexShader = nullptr;
+      pixelShader->Release();
+      pixelShader = nullptr;
 
-    ReturnIfFailed(m_commandList->Close());
-    ReturnIfFailed(commandAllocator->Reset());
-    ReturnIfFailed(m_commandList->Reset(commandAllocator, m_pipelineState));
+      if (FAILED(instancedResult))
+      {
+        Log("Failed to create the instanced Graphics Pipeline!", LogType::LT_ERROR);
+        return -1;
+      }
+    }
 
     return 0;
   }
 
+  void Material::FillPipelineState(D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+  {
+    D3D12_RASTERIZER_DESC rasterDesc = {};
+    rasterDesc.FillMode = D3D12_FILL_MODE_SOLID;
+    rasterDesc.CullMode = D3D12_CULL_MODE_NONE;
+    rasterDesc.FrontCounterClockwise = FALSE;
+    rasterDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
+    rasterDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
+    rasterDesc.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
+    rasterDesc.DepthClipEnable = TRUE;
+    rasterDesc.MultisampleEnable = FALSE;
+    rasterDesc.AntialiasedLineEnable = FALSE;
+    rasterDesc.ForcedSampleCount = 0;
+    rasterDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+
+    desc.RasterizerState = rasterDesc;
+
+    D3D12_BLEND_DESC blendDesc;
+    blendDesc.AlphaToCoverageEnable = FALSE;
+    blendDesc.IndependentBlendEnable = FALSE;
+    const D3D12_RENDER_TARGET_BLEND_DESC defaultRenderTargetBlendDesc =
+    {
+      FALSE,
+      FALSE,
+      D3D12_BLEND_ONE,
+      D3D12_BLEND_ZERO,
+      D3D12_BLEND_OP_ADD,
+      D3D12_BLEND_ONE,
+      D3D12_BLEND_ZERO,
+      D3D12_BLEND_OP_ADD,
+      D3D12_LOGIC_OP_NOOP,
+      D3D12_COLOR_WRITE_ENABLE_ALL,
+    };
+    for (uint32 i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+      blendDesc.RenderTarget[i] = defaultRenderTargetBlendDesc;
+
+    desc.BlendState = blendDesc;
+    desc.DepthStencilState.DepthEnable = FALSE;
+    desc.DepthStencilState.StencilEnable = FALSE;
+    desc.SampleMask = UINT_MAX;
+    desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    desc.NumRenderTargets = 1;
+    desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+  }
+
   int Material::UnInit()
   {
     if (!m_initialized)
@@ -252,94 +301,76 @@ namespace WoohooDX12
       m_pipelineState = nullptr;
     }
 
+    if (m_instancedPipelineState)
+    {
+      m_instancedPipelineState->Release();
+      m_instancedPipelineState = nullptr;
+    }
+
     if (m_rootSignature)
     {
       m_rootSignature->Release();
       m_rootSignature = nullptr;
     }
 
-    if (m_uniformBuffer)
-    {
-      m_uniformBuffer->Release();
-      m_uniformBuffer = nullptr;
-    }
+    return 0;
+  }
 
-    if (m_uniformBufferHeap)
+  int Material::CompileShaders(ID3DBlob** vertexShader, ID3DBlob** pixelShader)
+  {
+    ReturnIfFailed(CompileShaderSource(ShaderSource, "Shader", "VSMain", "vs_5_0", vertexShader));
+    if (CompileShaderSource(ShaderSource, "Shader", "PSMain", "ps_5_0", pixelShader) != 0)
     {
-      m_uniformBufferHeap->Release();
-      m_uniformBufferHeap = nullptr;
+      (*vertexShader)->Release();
+      *vertexShader = nullptr;
+      return -1;
     }
 
     return 0;
   }
 
-  int Material::CompileShaders(ID3DBlob** vertexShader, ID3DBlob** pixelShader)
+  int Material::CompileShaderSource(const char* source, const char* name, const char* entryPoint, const char* target, ID3DBlob** shader)
   {
-    Log("Compiling shaders...", LogType::LT_INFO);
-
-    ID3DBlob* errors = nullptr;
-
 #ifdef DX12_DEBUG_LAYER
-    // Enable better shader debugging with the graphics debugging tools.
     uint32 compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #else
     uint32 compileFlags = 0;
 #endif
 
-    WString vertCompiledPath = GetShaderPath() + L"triangle.vert.dxbc";
-    WString fragCompiledPath = GetShaderPath() + L"triangle.frag.dxbc";
-
-    WString vertPath = GetShaderPath() + L"triangle.vert.hlsl";
-    WString fragPath = GetShaderPath() + L"triangle.frag.hlsl";
+    ID3DBlob* errors = nullptr;
+    const HRESULT compileResult = D3DCompile(source, strlen(source), name, nullptr, nullptr, entryPoint, target, compileFlags, 0, shader, &errors);
+    if (SUCCEEDED(compileResult))
+      return 0;
 
-    HRESULT compileResult = D3DCompileFromFile(vertPath.c_str(), nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, vertexShader, &errors);
-    if (!SUCCEEDED(compileResult))
+    if (errors != nullptr)
     {
-      if (errors == nullptr)
-        return -1;
-
-      const char* errStr = (const char*)errors->GetBufferPointer();
-      Log(errStr, LogType::LT_ERROR);
+      Log((const char*)errors->GetBufferPointer(), LogType::LT_ERROR);
       errors->Release();
-      errors = nullptr;
-      return -1;
     }
-    compileResult = D3DCompileFromFile(fragPath.c_str(), nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, pixelShader, &errors);
-    if (!SUCCEEDED(compileResult))
-    {
-      if (errors == nullptr)
-        return -1;
+    return -1;
+  }
 
-      const char* errStr = (const char*)errors->GetBufferPointer();
-      Log(errStr, LogType::LT_ERROR);
-      errors->Release();
-      errors = nullptr;
+  int Material::CompileInstancedShaders(ID3DBlob** vertexShader, ID3DBlob** pixelShader)
+  {
+    ReturnIfFailed(CompileShaderSource(InstancedShaderSource, "InstancedShader", "VSMain", "vs_5_0", vertexShader));
+    if (CompileShaderSource(InstancedShaderSource, "InstancedShader", "PSMain", "ps_5_0", pixelShader) != 0)
+    {
+      (*vertexShader)->Release();
+      *vertexShader = nullptr;
       return -1;
     }
 
-    std::ofstream vsOut(vertCompiledPath, std::ios::out | std::ios::binary);
-    std::ofstream fsOut(fragCompiledPath, std::ios::out | std::ios::binary);
-
-    vsOut.write((const char*)(*vertexShader)->GetBufferPointer(), (*vertexShader)->GetBufferSize());
-    fsOut.write((const char*)(*pixelShader)->GetBufferPointer(), (*pixelShader)->GetBufferSize());
-
-    Log("Done: Compiling shaders.", LogType::LT_INFO);
-
     return 0;
   }
 
-  int Material::Update()
+  void Material::WriteUniforms(const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera, void* destination)
   {
-    m_uboVS.modelMatrix *= DirectX::XMMatrixRotationAxis(DirectX::XMLoadFloat3(&UpVector), DirectX::XMConvertToRadians(1.0f));
-
-    D3D12_RANGE readRange = {};
-    readRange.Begin = 0;
-    readRange.End = 0;
-
-    ReturnIfFailed(m_uniformBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_mappedUniformBuffer)));
-    memcpy(m_mappedUniformBuffer, &m_uboVS, sizeof(m_uboVS));
-    m_uniformBuffer->Unmap(0, &readRange);
-
-    return 0;
+    // Written whole, the destination is write-combined memory
+    UboVS uniforms;
+    uniforms.projectionMatrix = camera.GetProjectionMatrix();
+    uniforms.viewMatrix = camera.GetViewMatrix();
+    uniforms.modelMatrix = modelMatrix;
+    uniforms.color = color;
+    memcpy(destination, &uniforms, sizeof(uniforms));
   }
 }
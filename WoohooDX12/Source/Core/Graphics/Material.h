@@ -4,6 +4,8 @@
 #include <dxgi1_3.h>
 #include <dxgi1_4.h>
 #include "Types.h"
+#include "Scene/Camera.h"
+#include "Geometry/VertexQuantization.h"
 
 namespace WoohooDX12
 {
@@ -16,33 +18,41 @@ namespace WoohooDX12
     Material();
     virtual ~Material();
 
-    int Init(ID3D12Device* device, ID3D12CommandAllocator* commandAllocator);
+    // The pipelines read the vertices in the vertex layout
+    int Init(ID3D12Device* device, const VertexLayout& vertexLayout);
     int UnInit();
 
-    int Update();
+    // Fills the constants of one draw, destination is in the layout of the uniform buffer of the shaders
+    static void WriteUniforms(const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera, void* destination);
+
+    // Rasterizer, blend, depth and render target state shared by the pipelines drawing to the back buffer
+    static void FillPipelineState(D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+    // Compiles built in HLSL, the errors are logged
+    static int CompileShaderSource(const char* source, const char* name, const char* entryPoint, const char* target, ID3DBlob** shader);
 
   private:
+    // The shaders are built in, they read the world matrix and colour of the draw from the uniforms
     int CompileShaders(ID3DBlob** vertexShader, ID3DBlob** pixelShader);
+    // The instanced shaders are built in, they read the world matrix and colour from the instance stream
+    int CompileInstancedShaders(ID3DBlob** vertexShader, ID3DBlob** pixelShader);
 
   private:
-    // Uniform data
+    // Uniform data, streamed for every draw and bound as a root constant buffer view
 
     struct UboVS
     {
       // TODO Use MVP matrix
-      Mat projectionMatrix;
-      Mat viewMatrix;
-      Mat modelMatrix;
+      Mat4x4 projectionMatrix;
+      Mat4x4 viewMatrix;
+      Mat4x4 modelMatrix;
+      Vec4 color; // Multiplies the vertex colours, the instanced pipeline multiplies the instance colour too
     };
-    UboVS m_uboVS;
 
-    ID3D12Resource* m_uniformBuffer = nullptr;
-    ID3D12DescriptorHeap* m_uniformBufferHeap = nullptr;
-    UINT8* m_mappedUniformBuffer = nullptr;
+    static constexpr uint32 UniformsParameter = 0;
 
     ID3D12RootSignature* m_rootSignature = nullptr;
     ID3D12PipelineState* m_pipelineState = nullptr;
-    ID3D12GraphicsCommandList* m_commandList = nullptr;
+    ID3D12PipelineState* m_instancedPipelineState = nullptr; // Same state, the input layout has the instance stream in slot 1
 
     bool m_initialized = false;
   };
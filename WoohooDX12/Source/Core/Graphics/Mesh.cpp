@@ -1,7 +1,12 @@
 #include "Mesh.h"
 
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <utility>
 #include "Utils.h"
-#include "d3dx12.h"
+#include "Geometry/MeshOptimizer.h"
+#include "Geometry/MeshSimplifier.h"
 
 namespace WoohooDX12
 {
@@ -11,160 +16,150 @@ namespace WoohooDX12
     assert(!m_initialized && "Mesh is not uninitialized!");
   }
 
-  int Mesh::Init(ID3D12Device* device, ID3D12GraphicsCommandList* commandList)
+  Mesh::Mesh(Mesh&& other) noexcept
   {
-    AssertAndReturn(!m_initialized, "This mesh is already initialized.");
+    *this = std::move(other);
+  }
 
-    // Create vertex buffer
-    {
-      const uint32 vertexBufferSize = sizeof(m_vertexBufferData);
-
-      // Upload heap buffer to upload vertex data to gpu mem
-      D3D12_HEAP_PROPERTIES uploadheapProps = {};
-      uploadheapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-      uploadheapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-      uploadheapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-      uploadheapProps.CreationNodeMask = 1;
-      uploadheapProps.VisibleNodeMask = 1;
-
-      D3D12_RESOURCE_DESC vertexBufferResourceDesc = {};
-      vertexBufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-      vertexBufferResourceDesc.Alignment = 0;
-      vertexBufferResourceDesc.Width = vertexBufferSize;
-      vertexBufferResourceDesc.Height = 1;
-      vertexBufferResourceDesc.DepthOrArraySize = 1;
-      vertexBufferResourceDesc.MipLevels = 1;
-      vertexBufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-      vertexBufferResourceDesc.SampleDesc.Count = 1;
-      vertexBufferResourceDesc.SampleDesc.Quality = 0;
-      vertexBufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-      vertexBufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-      ReturnIfFailed(device->CreateCommittedResource(&uploadheapProps, D3D12_HEAP_FLAG_NONE, &vertexBufferResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_uploadVertexBuffer)));
-
-      // default heap holds vertex buffer
-      D3D12_HEAP_PROPERTIES defaultheapProps = {};
-      defaultheapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-      defaultheapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-      defaultheapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-      defaultheapProps.CreationNodeMask = 1;
-      defaultheapProps.VisibleNodeMask = 1;
-
-      ReturnIfFailed(device->CreateCommittedResource(&defaultheapProps, D3D12_HEAP_FLAG_NONE, &vertexBufferResourceDesc,
-        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, nullptr, IID_PPV_ARGS(&m_vertexBuffer)));
-
-      // Initialize the vertex buffer view.
-      m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-      m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-      m_vertexBufferView.SizeInBytes = vertexBufferSize;
-
-      D3D12_SUBRESOURCE_DATA vertexData = {};
-      vertexData.pData = m_vertexBufferData;
-      vertexData.RowPitch = sizeof(m_vertexBufferData);
-      vertexData.SlicePitch = 0;
-
-      // upload vertex data to gpu memory
-      const CD3DX12_RESOURCE_BARRIER firstBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
-        D3D12_RESOURCE_STATE_COPY_DEST);
-      const CD3DX12_RESOURCE_BARRIER secondBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST,
-        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-
-      commandList->ResourceBarrier(1, &firstBarrier);
-      UpdateSubresources(commandList, m_vertexBuffer, m_uploadVertexBuffer, 0, 0, 1, &vertexData);
-      commandList->ResourceBarrier(1, &secondBarrier);
-    }
+  Mesh& Mesh::operator=(Mesh&& other) noexcept
+  {
+    assert(!m_initialized && "Mesh is not uninitialized!");
+    if (this == &other)
+      return *this;
+
+    m_vertexBufferData = std::move(other.m_vertexBufferData);
+    m_indexBufferData = std::move(other.m_indexBufferData);
+    m_lods = std::move(other.m_lods);
+    m_positionQuantization = other.m_positionQuantization;
+    m_drawChunks = std::move(other.m_drawChunks);
+    m_lodChunkOffsets = std::move(other.m_lodChunkOffsets);
+    m_maxDrawChunkCount = other.m_maxDrawChunkCount;
+    m_positionStreamEnabled = other.m_positionStreamEnabled;
+    m_positionDrawChunks = std::move(other.m_positionDrawChunks);
+    m_positionLODChunkOffsets = std::move(other.m_positionLODChunkOffsets);
+
+    m_uploadVertexBuffer = other.m_uploadVertexBuffer;
+    m_vertexBuffer = other.m_vertexBuffer;
+    m_uploadIndexBuffer = other.m_uploadIndexBuffer;
+    m_indexBuffer = other.m_indexBuffer;
+    m_uploadPositionBuffer = other.m_uploadPositionBuffer;
+    m_positionBuffer = other.m_positionBuffer;
+    m_uploadPositionIndexBuffer = other.m_uploadPositionIndexBuffer;
+    m_positionIndexBuffer = other.m_positionIndexBuffer;
+    m_vertexBufferView = other.m_vertexBufferView;
+    m_indexBufferView = other.m_indexBufferView;
+    m_positionBufferView = other.m_positionBufferView;
+    m_positionIndexBufferView = other.m_positionIndexBufferView;
+    m_initialized = other.m_initialized;
+
+    other.m_uploadVertexBuffer = nullptr;
+    other.m_vertexBuffer = nullptr;
+    other.m_uploadIndexBuffer = nullptr;
+    other.m_indexBuffer = nullptr;
+    other.m_uploadPositionBuffer = nullptr;
+    other.m_positionBuffer = nullptr;
+    other.m_uploadPositionIndexBuffer = nullptr;
+    other.m_positionIndexBuffer = nullptr;
+    other.m_initialized = false;
+
+    return *this;
+  }
 
-    // Create index buffer
-    {
-      const uint32 indexBufferSize = sizeof(m_indexBufferData);
-
-      D3D12_HEAP_PROPERTIES uploadHeapProps = {};
-      uploadHeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-      uploadHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-      uploadHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-      uploadHeapProps.CreationNodeMask = 1;
-      uploadHeapProps.VisibleNodeMask = 1;
-
-      D3D12_RESOURCE_DESC indexBufferResourceDesc = {};
-      indexBufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-      indexBufferResourceDesc.Alignment = 0;
-      indexBufferResourceDesc.Width = indexBufferSize;
-      indexBufferResourceDesc.Height = 1;
-      indexBufferResourceDesc.DepthOrArraySize = 1;
-      indexBufferResourceDesc.MipLevels = 1;
-      indexBufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-      indexBufferResourceDesc.SampleDesc.Count = 1;
-      indexBufferResourceDesc.SampleDesc.Quality = 0;
-      indexBufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-      indexBufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-      ReturnIfFailed(device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &indexBufferResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_uploadIndexBuffer)));
-
-      D3D12_HEAP_PROPERTIES defaultHeapProps = {};
-      defaultHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-      defaultHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-      defaultHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-      defaultHeapProps.CreationNodeMask = 1;
-      defaultHeapProps.VisibleNodeMask = 1;
-
-      ReturnIfFailed(device->CreateCommittedResource(&defaultHeapProps, D3D12_HEAP_FLAG_NONE, &indexBufferResourceDesc,
-        D3D12_RESOURCE_STATE_INDEX_BUFFER, nullptr, IID_PPV_ARGS(&m_indexBuffer)));
-
-      // Initialize the index buffer view.
-      m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-      m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
-      m_indexBufferView.SizeInBytes = indexBufferSize;
-
-      D3D12_SUBRESOURCE_DATA indexData = {};
-      indexData.pData = m_indexBufferData;
-      indexData.RowPitch = sizeof(m_indexBufferData);
-      indexData.SlicePitch = 0;
-
-      // upload index data to gpu memory
-      const CD3DX12_RESOURCE_BARRIER firstBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER,
-        D3D12_RESOURCE_STATE_COPY_DEST);
-      const CD3DX12_RESOURCE_BARRIER secondBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer, D3D12_RESOURCE_STATE_COPY_DEST,
-        D3D12_RESOURCE_STATE_INDEX_BUFFER);
-
-      commandList->ResourceBarrier(1, &firstBarrier);
-      UpdateSubresources(commandList, m_indexBuffer, m_uploadIndexBuffer, 0, 0, 1, &indexData);
-      commandList->ResourceBarrier(1, &secondBarrier);
-    }
+  void Mesh::CopyGeometry(const Mesh& other)
+  {
+    m_vertexBufferData = other.m_vertexBufferData;
+    m_indexBufferData = other.m_indexBufferData;
+    m_lods = other.m_lods;
+    m_positionStreamEnabled = other.m_positionStreamEnabled;
+  }
+
+  void Mesh::SetGeometry(const Vertex* vertices, uint32 vertexCount, const uint32* indices, uint32 indexCount)
+  {
+    assert(indexCount % 3 == 0 && "Index count is not a multiple of three!");
+    m_vertexBufferData.assign(vertices, vertices + vertexCount);
+    m_indexBufferData.assign(indices, indices + indexCount);
+    m_lods.assign(1, MeshLOD{ 0, indexCount, 0.0f });
+  }
 
-    return 0;
+  uint32 Mesh::GenerateLODs(const LODChainOptions& options)
+  {
+    // Colours are simplified with the positions, so flat coloured regions go first
+    SimplifyInput input;
+    input.positions = m_vertexBufferData[0].position;
+    input.positionStride = sizeof(Vertex);
+    input.attributes = m_vertexBufferData[0].color;
+    input.attributeStride = sizeof(Vertex);
+    input.attributeCount = 3;
+    input.vertexCount = GetVertexCount();
+    input.indices = m_indexBufferData.data();
+    input.indexCount = GetIndexCount();
+
+    std::vector<uint32> lodIndices;
+    std::vector<MeshLOD> lods;
+    MeshSimplifier simplifier;
+    simplifier.BuildLODChain(input, options, lodIndices, lods);
+
+    m_indexBufferData = std::move(lodIndices);
+    m_lods = std::move(lods);
+    return GetLODCount();
   }
 
-  int Mesh::UnInit()
+  void Mesh::SetVertexColor(uint32 index, const Vec3& color)
   {
-    if (!m_initialized)
-      return 0;
+    assert(index < GetVertexCount() && "Vertex index is out of range!");
+    m_vertexBufferData[index].color[0] = color.x;
+    m_vertexBufferData[index].color[1] = color.y;
+    m_vertexBufferData[index].color[2] = color.z;
+  }
 
-    if (m_uploadVertexBuffer)
-    {
-      m_uploadVertexBuffer->Release();
-      m_uploadVertexBuffer = nullptr;
-    }
+  void Mesh::OptimizeGeometry()
+  {
+    if (m_indexBufferData.empty())
+      return;
 
-    if (m_uploadIndexBuffer)
+    MeshOptimizer optimizer;
+    for (const MeshLOD& lod : m_lods)
     {
-      m_uploadIndexBuffer->Release();
-      m_uploadIndexBuffer = nullptr;
+      uint32* indices = m_indexBufferData.data() + lod.indexOffset;
+      optimizer.OptimizeVertexCache(indices, lod.indexCount, GetVertexCount());
+      optimizer.OptimizeOverdraw(indices, lod.indexCount, m_vertexBufferData[0].position, sizeof(Vertex), GetVertexCount());
     }
 
-    if (m_vertexBuffer)
+    // The levels share the vertices, the full detail level comes first so it decides their order
+    std::vector<uint32> remap;
+    const uint32 usedCount = optimizer.OptimizeVertexFetch(m_indexBufferData.data(), (uint32)m_indexBufferData.size(), GetVertexCount(), remap);
+    std::vector<Vertex> vertices(usedCount);
+    MeshOptimizer::RemapVertices(vertices.data(), m_vertexBufferData.data(), GetVertexCount(), sizeof(Vertex), remap.data());
+    m_vertexBufferData = std::move(vertices);
+  }
+
+  void Mesh::GetBoundingBox(Vec3& minPosition, Vec3& maxPosition) const
+  {
+    minPosition = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    maxPosition = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (const Vertex& vertex : m_vertexBufferData)
     {
-      m_vertexBuffer->Release();
-      m_vertexBuffer = nullptr;
+      minPosition = Vec3(fminf(minPosition.x, vertex.position[0]), fminf(minPosition.y, vertex.position[1]), fminf(minPosition.z, vertex.position[2]));
+      maxPosition = Vec3(fmaxf(maxPosition.x, vertex.position[0]), fmaxf(maxPosition.y, vertex.position[1]), fmaxf(maxPosition.z, vertex.position[2]));
     }
+  }
 
-    if (m_indexBuffer)
+  void Mesh::GetBoundingSphere(Vec3& center, float& radius) const
+  {
+    // Centered on the box of the vertices, not minimal but cheap and stable
+    Vec3 minPosition;
+    Vec3 maxPosition;
+    GetBoundingBox(minPosition, maxPosition);
+    center = Vec3((minPosition.x + maxPosition.x) * 0.5f, (minPosition.y + maxPosition.y) * 0.5f, (minPosition.z + maxPosition.z) * 0.5f);
+
+    float radiusSq = 0.0f;
+    for (const Vertex& vertex : m_vertexBufferData)
     {
-      m_indexBuffer->Release();
-      m_indexBuffer = nullptr;
+      const float dx = vertex.position[0] - center.x;
+      const float dy = vertex.position[1] - center.y;
+      const float dz = vertex.position[2] - center.z;
+      radiusSq = fmaxf(radiusSq, dx * dx + dy * dy + dz * dz);
     }
-
-    return 0;
+    radius = sqrtf(radiusSq);
   }
 }
@@ -3,8 +3,12 @@
 #include <d3d12.h>
 #include <dxgi1_3.h>
 #include <dxgi1_4.h>
+#include <vector>
 #include "Types.h"
 #include "Material.h"
+#include "Geometry/IndexSplitter.h"
+#include "Geometry/MeshLOD.h"
+#include "Geometry/VertexQuantization.h"
 
 namespace WoohooDX12
 {
@@ -14,6 +18,8 @@ namespace WoohooDX12
     float color[3];
   };
 
+  struct LODChainOptions;
+
   class Mesh
   {
     friend class Renderer;
@@ -22,21 +28,101 @@ namespace WoohooDX12
     // mesh layout
     // vertex buffers
 
+    // Draws per level with 16-bit indices at most, past it the mesh keeps 32-bit indices
+    static constexpr uint32 MaxShortIndexChunks = 16;
+
     Mesh() {}
     virtual ~Mesh();
 
-    int Init(ID3D12Device* device, ID3D12GraphicsCommandList* commandList);
+    // Pools move meshes around, the GPU buffers move with them and the source is left uninitialized
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // The GPU copy is encoded in the vertex layout, which has the position and the colour. The indices are 16-bit, in chunks
+    // with their own base vertex when the mesh has more vertices than a 16-bit index reaches.
+    int Init(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const VertexLayout& vertexLayout);
     int UnInit();
+    inline bool IsInitialized() const { return m_initialized; }
+
+    // Local space bounding sphere of the vertices
+    void GetBoundingSphere(Vec3& center, float& radius) const;
+    void GetBoundingBox(Vec3& minPosition, Vec3& maxPosition) const;
+
+    // Copies the CPU geometry only, the copy has to be initialized on its own
+    void CopyGeometry(const Mesh& other);
+    // Changes the CPU copy, the mesh has to be uploaded again to see it on the GPU
+    void SetVertexColor(uint32 index, const Vec3& color);
+    // Replaces the CPU copy with a single level of detail
+    void SetGeometry(const Vertex* vertices, uint32 vertexCount, const uint32* indices, uint32 indexCount);
+    // Simplifies the full detail level of the CPU copy into a chain of levels after it in the index buffer, returns the level count
+    uint32 GenerateLODs(const LODChainOptions& options);
+    // Reorders the triangles of every level for the vertex cache then for overdraw, and the vertices in the order of their
+    // first use. Unused vertices are dropped. Run at import, after the levels of detail are generated.
+    void OptimizeGeometry();
+
+    // CPU copy of the geometry, the indices of the full detail level come first
+    inline const Vertex* GetVertices() const { return m_vertexBufferData.data(); }
+    inline uint32 GetVertexCount() const { return (uint32)m_vertexBufferData.size(); }
+    inline const uint32* GetIndices() const { return m_indexBufferData.data(); }
+    inline uint32 GetIndexCount() const { return m_lods[0].indexCount; }
+
+    inline uint32 GetLODCount() const { return (uint32)m_lods.size(); }
+    inline const MeshLOD& GetLOD(uint32 lod) const { return m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1]; }
+
+    // Of the GPU copy, to fold into the world matrix the mesh is drawn with
+    inline const PositionQuantization& GetPositionQuantization() const { return m_positionQuantization; }
+    // Draws of a level in the GPU index buffer, set by Init
+    inline const IndexChunk* GetDrawChunks(uint32 lod, uint32& count) const { return GetChunks(m_drawChunks, m_lodChunkOffsets, lod, count); }
+    inline uint32 GetMaxDrawChunkCount() const { return m_maxDrawChunkCount; }
+
+    // Builds a position-only stream on Init for the passes that only write depth, see PositionStreamBuilder. It costs the
+    // positions a second time, and an index buffer when the welded positions are worth one.
+    inline void SetPositionStream(bool enabled) { m_positionStreamEnabled = enabled; }
+    inline bool HasPositionStream() const { return m_positionBuffer != nullptr; }
+    // Bound alone with an input layout of the position layout, the draws are like the ones of the full vertices
+    inline const D3D12_VERTEX_BUFFER_VIEW& GetPositionBufferView() const { return m_positionBufferView; }
+    inline const D3D12_INDEX_BUFFER_VIEW& GetPositionIndexBufferView() const { return m_positionIndexBufferView; }
+    inline const IndexChunk* GetPositionDrawChunks(uint32 lod, uint32& count) const
+    {
+      return GetChunks(m_positionDrawChunks, m_positionLODChunkOffsets, lod, count);
+    }
+    // Position of the vertex layout alone, with the same quantization
+    static inline VertexLayout GetPositionLayout(const VertexLayout& vertexLayout)
+    {
+      const uint32 position = VertexLayout::GetBit(VertexAttribute::Position);
+      return VertexLayout::Make(position, vertexLayout.compactAttributes & position);
+    }
 
   private:
-    Vertex m_vertexBufferData[3] =
+    int CreatePositionStream(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const VertexLayout& vertexLayout,
+      const std::vector<Vertex>& vertices);
+    // Default heap buffer filled through an upload heap buffer
+    static int CreateBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const void* data, uint32 size,
+      D3D12_RESOURCE_STATES state, ID3D12Resource** uploadBuffer, ID3D12Resource** buffer);
+    inline const IndexChunk* GetChunks(const std::vector<IndexChunk>& chunks, const std::vector<uint32>& lodChunkOffsets, uint32 lod,
+      uint32& count) const
+    {
+      lod = lod < m_lods.size() ? lod : (uint32)m_lods.size() - 1;
+      count = lodChunkOffsets.empty() ? 0 : lodChunkOffsets[lod + 1] - lodChunkOffsets[lod];
+      return chunks.data() + (lodChunkOffsets.empty() ? 0 : lodChunkOffsets[lod]);
+    }
+
+  private:
+    std::vector<Vertex> m_vertexBufferData =
     {
       {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
       {{0.5f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
       {{-0.5f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}
     };
 
-    uint32 m_indexBufferData[3] = { 0, 1, 2 };
+    std::vector<uint32> m_indexBufferData = { 0, 1, 2 };
+    std::vector<MeshLOD> m_lods = { { 0, 3, 0.0f } }; // Always holds the full detail level
+    PositionQuantization m_positionQuantization;
+    std::vector<IndexChunk> m_drawChunks;
+    std::vector<uint32> m_lodChunkOffsets; // Chunks of level i are [offsets[i], offsets[i + 1])
+    uint32 m_maxDrawChunkCount = 0;
 
     ID3D12Resource* m_uploadVertexBuffer = nullptr;
     ID3D12Resource* m_vertexBuffer = nullptr; // On Video memory
@@ -46,6 +132,17 @@ namespace WoohooDX12
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
 
+    // Position-only stream
+    bool m_positionStreamEnabled = false;
+    ID3D12Resource* m_uploadPositionBuffer = nullptr;
+    ID3D12Resource* m_positionBuffer = nullptr;
+    ID3D12Resource* m_uploadPositionIndexBuffer = nullptr;
+    ID3D12Resource* m_positionIndexBuffer = nullptr; // Only for welded positions, the index buffer of the mesh is shared otherwise
+    D3D12_VERTEX_BUFFER_VIEW m_positionBufferView = {};
+    D3D12_INDEX_BUFFER_VIEW m_positionIndexBufferView = {};
+    std::vector<IndexChunk> m_positionDrawChunks;
+    std::vector<uint32> m_positionLODChunkOffsets;
+
     bool m_initialized = false;
 
     // TODO later: let mesh hold its type
@@ -0,0 +1,260 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include "Utils.h"
+#include "Geometry/PositionStream.h"
+#include "d3dx12.h"
+
+// GPU side of the meshes, Mesh.cpp keeps the CPU geometry so it builds without the Windows SDK
+
+namespace WoohooDX12
+{
+  int Mesh::Init(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const VertexLayout& vertexLayout)
+  {
+    AssertAndReturn(!m_initialized, "This mesh is already initialized.");
+    assert((vertexLayout.attributes & ~(VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Color))) == 0 &&
+      "The vertices only have a position and a colour!");
+
+    // 16-bit indices halve the index memory and fetch, unless the mesh would be cut into too many draws or need more vertex
+    // copies than they save
+    IndexSplitter splitter;
+    const bool shortIndices = splitter.Split(m_indexBufferData.data(), m_lods.data(), GetLODCount(), GetVertexCount(), vertexLayout.stride,
+      MaxShortIndexChunks);
+    if (shortIndices)
+    {
+      m_drawChunks = splitter.GetChunks();
+      m_lodChunkOffsets = splitter.GetLODChunkOffsets();
+    }
+    else
+    {
+      m_drawChunks.clear();
+      m_lodChunkOffsets.assign(1, 0);
+      for (const MeshLOD& level : m_lods)
+      {
+        m_drawChunks.push_back({ level.indexOffset, level.indexCount, 0 });
+        m_lodChunkOffsets.push_back((uint32)m_drawChunks.size());
+      }
+    }
+
+    m_maxDrawChunkCount = 0;
+    for (uint32 lod = 0; lod < GetLODCount(); ++lod)
+      m_maxDrawChunkCount = std::max(m_maxDrawChunkCount, m_lodChunkOffsets[lod + 1] - m_lodChunkOffsets[lod]);
+
+    // Triangles that fit no 16-bit window draw copies of their vertices, appended after them
+    std::vector<Vertex> copiedVertices;
+    const std::vector<Vertex>* vertices = &m_vertexBufferData;
+    if (shortIndices && !splitter.GetCopiedVertices().empty())
+    {
+      copiedVertices = m_vertexBufferData;
+      for (uint32 vertex : splitter.GetCopiedVertices())
+        copiedVertices.push_back(m_vertexBufferData[vertex]);
+      vertices = &copiedVertices;
+    }
+    const uint32 vertexCount = (uint32)vertices->size();
+
+    // Compact positions are relative to the bounds of the mesh
+    m_positionQuantization = vertexLayout.IsCompact(VertexAttribute::Position) ?
+      VertexQuantizer::ComputePositionQuantization(m_vertexBufferData[0].position, sizeof(Vertex), GetVertexCount()) : PositionQuantization();
+
+    // Create vertex buffer
+    {
+      VertexSource source;
+      source.attributes[(uint32)VertexAttribute::Position] = (*vertices)[0].position;
+      source.strides[(uint32)VertexAttribute::Position] = sizeof(Vertex);
+      source.attributes[(uint32)VertexAttribute::Color] = (*vertices)[0].color;
+      source.strides[(uint32)VertexAttribute::Color] = sizeof(Vertex);
+      source.vertexCount = vertexCount;
+
+      std::vector<uint8> encodedVertices((size_t)vertexLayout.stride * vertexCount);
+      VertexQuantizer::Encode(source, vertexLayout, m_positionQuantization, encodedVertices.data());
+      const uint32 vertexBufferSize = (uint32)encodedVertices.size();
+
+      ReturnIfFailed(CreateBuffer(device, commandList, encodedVertices.data(), vertexBufferSize, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+        &m_uploadVertexBuffer, &m_vertexBuffer));
+
+      // Initialize the vertex buffer view.
+      m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+      m_vertexBufferView.StrideInBytes = vertexLayout.stride;
+      m_vertexBufferView.SizeInBytes = vertexBufferSize;
+    }
+
+    // Create index buffer
+    {
+      const void* indices = shortIndices ? (const void*)splitter.GetIndices().data() : (const void*)m_indexBufferData.data();
+      const uint32 indexBufferSize = shortIndices ? (uint32)(splitter.GetIndices().size() * sizeof(uint16)) :
+        (uint32)(m_indexBufferData.size() * sizeof(uint32));
+
+      ReturnIfFailed(CreateBuffer(device, commandList, indices, indexBufferSize, D3D12_RESOURCE_STATE_INDEX_BUFFER, &m_uploadIndexBuffer, &m_indexBuffer));
+
+      // Initialize the index buffer view.
+      m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+      m_indexBufferView.Format = shortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+      m_indexBufferView.SizeInBytes = indexBufferSize;
+    }
+
+    if (m_positionStreamEnabled)
+      ReturnIfFailed(CreatePositionStream(device, commandList, vertexLayout, *vertices));
+
+    m_initialized = true;
+    return 0;
+  }
+
+  int Mesh::CreatePositionStream(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const VertexLayout& vertexLayout,
+    const std::vector<Vertex>& vertices)
+  {
+    const VertexLayout positionLayout = GetPositionLayout(vertexLayout);
+
+    // Welded positions only pay for their index buffer when they drop enough vertices
+    PositionStreamBuilder builder;
+    const uint32 positionCount = builder.Build(m_vertexBufferData[0].position, sizeof(Vertex), GetVertexCount(), m_indexBufferData.data(),
+      (uint32)m_indexBufferData.size());
+    IndexSplitter splitter;
+    const bool welded = (uint64)(GetVertexCount() - positionCount) * positionLayout.stride > m_indexBufferData.size() * sizeof(uint16) &&
+      splitter.Split(builder.GetIndices().data(), m_lods.data(), GetLODCount(), positionCount, positionLayout.stride, MaxShortIndexChunks);
+
+    // Positions of the draw vertices otherwise, drawn with the index buffer of the mesh
+    std::vector<Vertex> weldedVertices;
+    const std::vector<Vertex>* positions = &vertices;
+    if (welded)
+    {
+      weldedVertices.resize(positionCount + splitter.GetCopiedVertices().size());
+      for (uint32 i = 0; i < positionCount; ++i)
+        weldedVertices[i] = m_vertexBufferData[builder.GetSourceVertices()[i]];
+      for (uint32 i = 0; i < (uint32)splitter.GetCopiedVertices().size(); ++i)
+        weldedVertices[positionCount + i] = weldedVertices[splitter.GetCopiedVertices()[i]];
+      positions = &weldedVertices;
+    }
+
+    VertexSource source;
+    source.attributes[(uint32)VertexAttribute::Position] = (*positions)[0].position;
+    source.strides[(uint32)VertexAttribute::Position] = sizeof(Vertex);
+    source.vertexCount = (uint32)positions->size();
+
+    std::vector<uint8> encodedPositions((size_t)positionLayout.stride * source.vertexCount);
+    VertexQuantizer::Encode(source, positionLayout, m_positionQuantization, encodedPositions.data());
+    ReturnIfFailed(CreateBuffer(device, commandList, encodedPositions.data(), (uint32)encodedPositions.size(),
+      D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, &m_uploadPositionBuffer, &m_positionBuffer));
+
+    m_positionBufferView.BufferLocation = m_positionBuffer->GetGPUVirtualAddress();
+    m_positionBufferView.StrideInBytes = positionLayout.stride;
+    m_positionBufferView.SizeInBytes = (uint32)encodedPositions.size();
+
+    if (!welded)
+    {
+      m_positionIndexBufferView = m_indexBufferView;
+      m_positionDrawChunks = m_drawChunks;
+      m_positionLODChunkOffsets = m_lodChunkOffsets;
+      return 0;
+    }
+
+    const uint32 indexBufferSize = (uint32)(splitter.GetIndices().size() * sizeof(uint16));
+    ReturnIfFailed(CreateBuffer(device, commandList, splitter.GetIndices().data(), indexBufferSize, D3D12_RESOURCE_STATE_INDEX_BUFFER,
+      &m_uploadPositionIndexBuffer, &m_positionIndexBuffer));
+
+    m_positionIndexBufferView.BufferLocation = m_positionIndexBuffer->GetGPUVirtualAddress();
+    m_positionIndexBufferView.Format = DXGI_FORMAT_R16_UINT;
+    m_positionIndexBufferView.SizeInBytes = indexBufferSize;
+    m_positionDrawChunks = splitter.GetChunks();
+    m_positionLODChunkOffsets = splitter.GetLODChunkOffsets();
+    return 0;
+  }
+
+  int Mesh::CreateBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, const void* data, uint32 size, D3D12_RESOURCE_STATES state,
+    ID3D12Resource** uploadBuffer, ID3D12Resource** buffer)
+  {
+    // Upload heap buffer to upload the data to gpu mem
+    D3D12_HEAP_PROPERTIES uploadHeapProps = {};
+    uploadHeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+    uploadHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    uploadHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    uploadHeapProps.CreationNodeMask = 1;
+    uploadHeapProps.VisibleNodeMask = 1;
+
+    D3D12_RESOURCE_DESC bufferResourceDesc = {};
+    bufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferResourceDesc.Alignment = 0;
+    bufferResourceDesc.Width = size;
+    bufferResourceDesc.Height = 1;
+    bufferResourceDesc.DepthOrArraySize = 1;
+    bufferResourceDesc.MipLevels = 1;
+    bufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufferResourceDesc.SampleDesc.Count = 1;
+    bufferResourceDesc.SampleDesc.Quality = 0;
+    bufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    ReturnIfFailed(device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &bufferResourceDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(uploadBuffer)));
+
+    // default heap holds the buffer
+    D3D12_HEAP_PROPERTIES defaultHeapProps = {};
+    defaultHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+    defaultHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    defaultHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    defaultHeapProps.CreationNodeMask = 1;
+    defaultHeapProps.VisibleNodeMask = 1;
+
+    ReturnIfFailed(device->CreateCommittedResource(&defaultHeapProps, D3D12_HEAP_FLAG_NONE, &bufferResourceDesc,
+      state, nullptr, IID_PPV_ARGS(buffer)));
+
+    D3D12_SUBRESOURCE_DATA subresourceData = {};
+    subresourceData.pData = data;
+    subresourceData.RowPitch = size;
+    subresourceData.SlicePitch = 0;
+
+    // upload the data to gpu memory
+    const CD3DX12_RESOURCE_BARRIER firstBarrier = CD3DX12_RESOURCE_BARRIER::Transition(*buffer, state, D3D12_RESOURCE_STATE_COPY_DEST);
+    const CD3DX12_RESOURCE_BARRIER secondBarrier = CD3DX12_RESOURCE_BARRIER::Transition(*buffer, D3D12_RESOURCE_STATE_COPY_DEST, state);
+
+    commandList->ResourceBarrier(1, &firstBarrier);
+    UpdateSubresources(commandList, *buffer, *uploadBuffer, 0, 0, 1, &subresourceData);
+    commandList->ResourceBarrier(1, &secondBarrier);
+
+    return 0;
+  }
+
+  int Mesh::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    if (m_uploadVertexBuffer)
+    {
+      m_uploadVertexBuffer->Release();
+      m_uploadVertexBuffer = nullptr;
+    }
+
+    if (m_uploadIndexBuffer)
+    {
+      m_uploadIndexBuffer->Release();
+      m_uploadIndexBuffer = nullptr;
+    }
+
+    if (m_vertexBuffer)
+    {
+      m_vertexBuffer->Release();
+      m_vertexBuffer = nullptr;
+    }
+
+    if (m_indexBuffer)
+    {
+      m_indexBuffer->Release();
+      m_indexBuffer = nullptr;
+    }
+
+    // The position index buffer is only created for welded positions
+    ID3D12Resource** positionBuffers[] = { &m_uploadPositionBuffer, &m_positionBuffer, &m_uploadPositionIndexBuffer, &m_positionIndexBuffer };
+    for (ID3D12Resource** buffer : positionBuffers)
+    {
+      if (*buffer)
+      {
+        (*buffer)->Release();
+        *buffer = nullptr;
+      }
+    }
+
+    m_initialized = false;
+    return 0;
+  }
+}
@@ -0,0 +1,179 @@
+#include "ReadbackRing.h"
+
+#include <cassert>
+#include "Utils.h"
+#include "d3dx12.h"
+
+namespace WoohooDX12
+{
+  ReadbackRing::~ReadbackRing()
+  {
+    // UnInit should be called externally
+    assert(!m_initialized && "Readback ring is not uninitialized!");
+  }
+
+  int ReadbackRing::Init(ID3D12Device* device, uint32 width, uint32 height, uint32 slotCount)
+  {
+    AssertAndReturn(!m_initialized, "This readback ring is already initialized.");
+
+    m_width = width;
+    m_height = height;
+
+    // Row pitch of the copy has to be aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+    D3D12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1);
+    uint64 totalBytes = 0;
+    device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &m_footprint, nullptr, nullptr, &totalBytes);
+
+    D3D12_HEAP_PROPERTIES readbackHeapProps = {};
+    readbackHeapProps.Type = D3D12_HEAP_TYPE_READBACK;
+    readbackHeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    readbackHeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    readbackHeapProps.CreationNodeMask = 1;
+    readbackHeapProps.VisibleNodeMask = 1;
+
+    const D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalBytes);
+
+    m_slots.resize(slotCount);
+    for (uint32 i = 0; i < slotCount; ++i)
+    {
+      Slot& slot = m_slots[i];
+      ReturnIfFailed(device->CreateCommittedResource(&readbackHeapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&slot.buffer)));
+      slot.buffer->SetName(L"Readback Buffer");
+
+      ReturnIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&slot.commandAllocator)));
+      ReturnIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, slot.commandAllocator, nullptr, IID_PPV_ARGS(&slot.commandList)));
+      slot.commandList->SetName(L"Readback Command List");
+      ReturnIfFailed(slot.commandList->Close());
+    }
+    m_tracker.Reset(slotCount);
+    m_skippedCount = 0;
+
+    m_initialized = true;
+
+    return 0;
+  }
+
+  int ReadbackRing::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    // Flush should be called before, copies in flight are discarded
+    for (Slot& slot : m_slots)
+    {
+      if (slot.commandList)
+      {
+        slot.commandList->Release();
+        slot.commandList = nullptr;
+      }
+
+      if (slot.commandAllocator)
+      {
+        slot.commandAllocator->Release();
+        slot.commandAllocator = nullptr;
+      }
+
+      if (slot.buffer)
+      {
+        slot.buffer->Release();
+        slot.buffer = nullptr;
+      }
+    }
+    m_slots.clear();
+    m_tracker.Reset(0);
+
+    m_initialized = false;
+
+    return 0;
+  }
+
+  int ReadbackRing::Capture(ID3D12CommandQueue* queue, ID3D12Fence* fence, uint64& fenceValue, ID3D12Resource* texture,
+    D3D12_RESOURCE_STATES textureState, uint64 frameIndex)
+  {
+    const uint32 slotIndex = m_tracker.AcquireSlot();
+    if (slotIndex == ReadbackTracker::InvalidSlot)
+    {
+      // Never stall the frame for a capture
+      m_skippedCount++;
+      return 1;
+    }
+
+    Slot& slot = m_slots[slotIndex];
+    slot.frameIndex = frameIndex;
+
+    // The allocator of this slot is not in use, the tracker retired its previous copy
+    ReturnIfFailed(slot.commandAllocator->Reset());
+    ReturnIfFailed(slot.commandList->Reset(slot.commandAllocator, nullptr));
+
+    const CD3DX12_RESOURCE_BARRIER toCopySource = CD3DX12_RESOURCE_BARRIER::Transition(texture, textureState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    const CD3DX12_RESOURCE_BARRIER toPreviousState = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE, textureState);
+
+    const CD3DX12_TEXTURE_COPY_LOCATION destination(slot.buffer, m_footprint);
+    const CD3DX12_TEXTURE_COPY_LOCATION source(texture, 0);
+
+    slot.commandList->ResourceBarrier(1, &toCopySource);
+    slot.commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    slot.commandList->ResourceBarrier(1, &toPreviousState);
+    ReturnIfFailed(slot.commandList->Close());
+
+    ID3D12CommandList* ppCommandLists[] = { slot.commandList };
+    queue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+    ReturnIfFailed(queue->Signal(fence, fenceValue));
+    m_tracker.Submit(slotIndex, fenceValue);
+    fenceValue++;
+
+    return 0;
+  }
+
+  int ReadbackRing::Poll(ID3D12Fence* fence, FrameEncoder& encoder)
+  {
+    int result = 0;
+    m_tracker.Retire(fence->GetCompletedValue(), [&](uint32 slotIndex)
+      {
+        if (CopyToFrame(m_slots[slotIndex], encoder) != 0)
+          result = -1;
+      });
+
+    return result;
+  }
+
+  int ReadbackRing::Flush(ID3D12Fence* fence, HANDLE fenceEvent, FrameEncoder& encoder)
+  {
+    if (m_tracker.GetPendingCount() == 0)
+      return 0;
+
+    const uint64 lastFenceValue = m_tracker.GetNewestFenceValue();
+    if (fence->GetCompletedValue() < lastFenceValue)
+    {
+      ReturnIfFailed(fence->SetEventOnCompletion(lastFenceValue, fenceEvent));
+      WaitForSingleObject(fenceEvent, INFINITE);
+    }
+
+    return Poll(fence, encoder);
+  }
+
+  int ReadbackRing::CopyToFrame(Slot& slot, FrameEncoder& encoder)
+  {
+    CapturedFrame frame = encoder.AcquireFrame(m_width, m_height);
+    frame.frameIndex = slot.frameIndex;
+
+    const D3D12_RANGE readRange = { 0, (SIZE_T)m_footprint.Footprint.RowPitch * m_height };
+    const D3D12_RANGE writeRange = { 0, 0 };
+
+    uint8* mappedData = nullptr;
+    ReturnIfFailed(slot.buffer->Map(0, &readRange, reinterpret_cast<void**>(&mappedData)));
+
+    // Remove the row pitch padding
+    const size_t rowSize = (size_t)m_width * 4;
+    for (uint32 y = 0; y < m_height; ++y)
+      memcpy(frame.pixels.data() + rowSize * y, mappedData + (size_t)m_footprint.Footprint.RowPitch * y, rowSize);
+
+    slot.buffer->Unmap(0, &writeRange);
+
+    encoder.Submit(std::move(frame));
+
+    return 0;
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+#include "Types.h"
+#include "Capture/FrameEncoder.h"
+#include "Capture/ReadbackTracker.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Ring of fence tracked READBACK buffers used to copy textures (usually the back buffer) to the CPU without stalling.
+  * Capture() records the copy on the slot's own command list and signals the fence, Poll() hands the copies the GPU
+  * already finished to the frame encoder. When every slot is still in flight the capture is skipped instead of waiting.
+  */
+  class ReadbackRing
+  {
+  public:
+    ReadbackRing() {}
+    ~ReadbackRing();
+
+    int Init(ID3D12Device* device, uint32 width, uint32 height, uint32 slotCount = 3);
+    int UnInit();
+
+    // Returns 0 if the copy is queued, 1 if the capture is skipped because the ring is full
+    int Capture(ID3D12CommandQueue* queue, ID3D12Fence* fence, uint64& fenceValue, ID3D12Resource* texture,
+      D3D12_RESOURCE_STATES textureState, uint64 frameIndex);
+    int Poll(ID3D12Fence* fence, FrameEncoder& encoder);
+    // Waits for the copies in flight and hands them to the encoder
+    int Flush(ID3D12Fence* fence, HANDLE fenceEvent, FrameEncoder& encoder);
+
+    inline bool IsInitialized() const { return m_initialized; }
+    inline uint64 GetSkippedCount() const { return m_skippedCount; }
+
+  private:
+    struct Slot
+    {
+      ID3D12Resource* buffer = nullptr;
+      ID3D12CommandAllocator* commandAllocator = nullptr;
+      ID3D12GraphicsCommandList* commandList = nullptr;
+      uint64 frameIndex = 0;
+    };
+
+    int CopyToFrame(Slot& slot, FrameEncoder& encoder);
+
+  private:
+    std::vector<Slot> m_slots;
+    ReadbackTracker m_tracker;
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint = {};
+    uint32 m_width = 0;
+    uint32 m_height = 0;
+    uint64 m_skippedCount = 0;
+
+    bool m_initialized = false;
+  };
+}
@@ -1,6 +1,7 @@
 #include "Renderer.h"
 
 #include <cassert>
+#include <cstring>
 #include "Maths.h"
 #include "Utils.h"
 
@@ -37,11 +38,32 @@ namespace WoohooDX12
     return 0;
   }
 
-  int Renderer::UnInit(std::vector<std::shared_ptr<Material>>& materials)
+  int Renderer::SetVertexLayout(const VertexLayout& layout)
+  {
+    // The pipelines are created with the layout
+    if (m_initialized)
+      return -1;
+
+    const uint32 attributes = VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Color);
+    if (layout.attributes != attributes)
+    {
+      Log("The vertex layout needs the position and the colour only!", LogType::LT_ERROR);
+      return -1;
+    }
+
+    m_vertexLayout = layout;
+    return 0;
+  }
+
+  int Renderer::UnInit()
   {
     if (!m_initialized)
       return 0;
 
+    StopCapture();
+    m_gpuDriven.UnInit();
+    m_dynamicGeometry.UnInit();
+
     if (m_swapchain != nullptr)
     {
       m_swapchain->SetFullscreenState(false, nullptr);
@@ -49,7 +71,7 @@ namespace WoohooDX12
       m_swapchain = nullptr;
     }
 
-    DestroyCommands(materials);
+    DestroyCommands();
 
     DestroyFrameBuffer();
 
@@ -64,6 +86,8 @@ namespace WoohooDX12
 
   int Renderer::Resize(uint32 width, uint32 height)
   {
+    assert(!m_recordingFrame && "The back buffers are resized between frames!");
+
     m_width = width;
     m_height = height;
 
@@ -85,22 +109,172 @@ namespace WoohooDX12
     ReturnIfFailed(SetupSwapchain(width, height));
     ReturnIfFailed(InitFrameBuffer());
 
+    // Readback buffers are sized for the back buffer, a Y4M capture continues in a new file at the new size
+    if (m_capturing)
+    {
+      ReturnIfFailed(m_readbackRing.Poll(m_fence, m_frameEncoder));
+      ReturnIfFailed(m_readbackRing.UnInit());
+      ReturnIfFailed(m_readbackRing.Init(m_device, m_width, m_height));
+    }
+
     return 0;
   }
 
-  int Renderer::Render(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+  int Renderer::BeginFrame()
   {
-    // Update Uniforms
-    material->Update();
+    assert(!m_recordingFrame && "The previous frame is not presented!");
 
-    // Record all the commands we need to render the scene into the command
-    // list.
-    SetupCommands(mesh, material);
+    // Command list allocators can only be reset when the associated
+    // command lists have finished execution on the GPU.
+    if (m_fence->GetCompletedValue() < m_frameFenceValue)
+    {
+      ReturnIfFailed(m_fence->SetEventOnCompletion(m_frameFenceValue, m_fenceEvent));
+      WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
+
+    m_dynamicGeometry.BeginFrame(m_fence->GetCompletedValue());
+
+    ReturnIfFailed(m_commandAllocator->Reset());
+    ReturnIfFailed(m_frameCommandList->Reset(m_commandAllocator, nullptr));
+    m_boundRootSignature = nullptr;
+    m_boundPipelineState = nullptr;
+    m_recordingFrame = true;
+
+    // Cleared once, every draw of the frame goes on top
+    BeginRenderTarget(m_frameCommandList);
+    m_frameCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    return 0;
+  }
+
+  int Renderer::Render(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera, uint32 lod)
+  {
+    // The world matrix dequantizes the positions
+    Mat4x4 world;
+    VertexQuantizer::FoldDequantization(mesh->m_positionQuantization, modelMatrix, world);
+
+    return SetupCommands(mesh, material, world, color, camera, nullptr, 1, lod);
+  }
+
+  int Renderer::RenderInstanced(Mesh* mesh, Material* material, const InstanceData* instances, uint32 instanceCount, const Camera& camera, uint32 lod)
+  {
+    // World matrices and colours are in the instances, the uniforms only carry the camera
+    Mat4x4 identity;
+    MakeIdentity(identity);
+    const Vec4 white(1.0f, 1.0f, 1.0f, 1.0f);
 
-    // Execute the command list.
-    ID3D12CommandList* ppCommandLists[] = { material->m_commandList };
+    D3D12_VERTEX_BUFFER_VIEW instanceView;
+    ReturnIfFailed(m_dynamicGeometry.WriteVertices(instances, instanceCount, sizeof(InstanceData), instanceView));
+
+    return SetupCommands(mesh, material, identity, white, camera, &instanceView, instanceCount, lod);
+  }
+
+  int Renderer::RenderRanges(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Camera& camera, const IndexChunk* ranges, uint32 rangeCount)
+  {
+    // The colours of the pieces are in their vertices
+    Mat4x4 world;
+    VertexQuantizer::FoldDequantization(mesh->m_positionQuantization, modelMatrix, world);
+    const Vec4 white(1.0f, 1.0f, 1.0f, 1.0f);
+
+    return SetupCommands(mesh, material, world, white, camera, nullptr, 1, 0, ranges, rangeCount);
+  }
+
+  int Renderer::AllocateIndirectFrame(uint32 objectCount, GPUDrivenFrame& frame)
+  {
+    frame = GPUDrivenFrame();
+    if (objectCount == 0)
+      return 0;
+
+    // Structured buffers only need the element alignment, the constant buffer needs 256 bytes
+    DynamicAllocation objects;
+    DynamicAllocation commands;
+    DynamicAllocation instances;
+    DynamicAllocation camera;
+    ReturnIfFailed(m_dynamicGeometry.Allocate(objectCount * (uint32)sizeof(GPUCullObject), 16, objects));
+    ReturnIfFailed(m_dynamicGeometry.Allocate(objectCount * (uint32)sizeof(IndirectDrawCommand), 16, commands));
+    ReturnIfFailed(m_dynamicGeometry.Allocate(objectCount * (uint32)sizeof(InstanceData), 16, instances));
+    ReturnIfFailed(m_dynamicGeometry.Allocate(2 * sizeof(Mat4x4), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, camera));
+
+    frame.objects = reinterpret_cast<GPUCullObject*>(objects.cpuAddress);
+    frame.commands = reinterpret_cast<IndirectDrawCommand*>(commands.cpuAddress);
+    frame.instances = reinterpret_cast<InstanceData*>(instances.cpuAddress);
+    frame.objectsAddress = objects.gpuAddress;
+    frame.commandsAddress = commands.gpuAddress;
+    frame.instancesAddress = instances.gpuAddress;
+    frame.cameraAddress = camera.gpuAddress;
+    frame.cameraData = camera.cpuAddress;
+    frame.capacity = objectCount;
+
+    return 0;
+  }
+
+  void Renderer::FillIndirectCommand(const Mesh& mesh, const IndexChunk& chunk, uint32 objectIndex, IndirectDrawCommand& command)
+  {
+    command.vertexBufferAddress = mesh.m_vertexBufferView.BufferLocation;
+    command.vertexBufferSize = mesh.m_vertexBufferView.SizeInBytes;
+    command.vertexStride = mesh.m_vertexBufferView.StrideInBytes;
+    command.indexBufferAddress = mesh.m_indexBufferView.BufferLocation;
+    command.indexBufferSize = mesh.m_indexBufferView.SizeInBytes;
+    command.indexFormat = (uint32)mesh.m_indexBufferView.Format;
+    command.objectIndex = objectIndex;
+    command.indexCountPerInstance = chunk.indexCount;
+    command.instanceCount = 1;
+    command.startIndexLocation = chunk.indexOffset;
+    command.baseVertexLocation = (int32)chunk.baseVertex;
+    command.startInstanceLocation = 0;
+  }
+
+  int Renderer::RenderIndirect(const GPUDrivenFrame& frame, const Frustum& frustum, const Camera& camera)
+  {
+    // Same layout as the camera constant buffer of the draw shader
+    if (frame.cameraData != nullptr)
+    {
+      const Mat4x4 cameraMatrices[] = { camera.GetProjectionMatrix(), camera.GetViewMatrix() };
+      memcpy(frame.cameraData, cameraMatrices, sizeof(cameraMatrices));
+    }
+
+    assert(m_recordingFrame && "Draws are recorded between BeginFrame and PresentBackbuffer!");
+    const int result = m_gpuDriven.Record(m_frameCommandList, frame, GPUCulling::MakeConstants(frustum, frame.objectCount));
+
+    // The passes set their own root signatures and pipelines
+    m_boundRootSignature = nullptr;
+    m_boundPipelineState = nullptr;
+
+    return result;
+  }
+
+  int Renderer::UploadMeshes(Mesh* const* meshes, uint32 count)
+  {
+    if (count == 0)
+      return 0;
+
+    // The allocator can only be reset once the previous upload is finished on the GPU
+    if (m_fence->GetCompletedValue() < m_uploadFenceValue)
+    {
+      ReturnIfFailed(m_fence->SetEventOnCompletion(m_uploadFenceValue, m_fenceEvent));
+      WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
+
+    ReturnIfFailed(m_uploadAllocator->Reset());
+    ReturnIfFailed(m_uploadCommandList->Reset(m_uploadAllocator, nullptr));
+
+    int result = 0;
+    for (uint32 i = 0; i < count && result == 0; ++i)
+    {
+      result = meshes[i]->Init(m_device, m_uploadCommandList, m_vertexLayout);
+    }
+
+    // Closed even on failure, so the list can be reset by the next upload
+    ReturnIfFailed(m_uploadCommandList->Close());
+    ReturnIfFailed(result);
+
+    ID3D12CommandList* ppCommandLists[] = { m_uploadCommandList };
     m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
+    m_uploadFenceValue = m_fenceValue;
+    ReturnIfFailed(m_commandQueue->Signal(m_fence, m_uploadFenceValue));
+    m_fenceValue++;
+
     return 0;
   }
 
@@ -111,9 +285,58 @@ namespace WoohooDX12
     return 0;
   }
 
+  int Renderer::StartCapture(const String& outputPath, CaptureFormat format, CaptureOverflowPolicy policy)
+  {
+    if (!m_initialized || m_capturing)
+      return -1;
+
+    ReturnIfFailed(m_frameEncoder.Start(outputPath, format, policy));
+    ReturnIfFailed(m_readbackRing.Init(m_device, m_width, m_height));
+    m_capturing = true;
+
+    Log("Capturing frames to " + outputPath, LogType::LT_INFO);
+
+    return 0;
+  }
+
+  int Renderer::StopCapture()
+  {
+    if (!m_capturing)
+      return 0;
+
+    m_readbackRing.Flush(m_fence, m_fenceEvent, m_frameEncoder);
+    m_readbackRing.UnInit();
+    m_frameEncoder.Stop();
+    m_capturing = false;
+
+    Log("Capture stopped. Encoded: " + std::to_string(m_frameEncoder.GetEncodedCount()) +
+      ", dropped by encoder: " + std::to_string(m_frameEncoder.GetDroppedCount()) +
+      ", skipped by readback: " + std::to_string(m_readbackRing.GetSkippedCount()), LogType::LT_INFO);
+
+    return 0;
+  }
+
   int Renderer::PresentBackbuffer()
   {
+    // The draws of the frame are submitted at once, the list is closed even when a draw failed
+    if (m_recordingFrame)
+    {
+      EndRenderTarget(m_frameCommandList);
+      m_recordingFrame = false;
+      ReturnIfFailed(m_frameCommandList->Close());
+
+      ID3D12CommandList* ppCommandLists[] = { m_frameCommandList };
+      m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    }
+
+    if (m_capturing)
+    {
+      m_readbackRing.Capture(m_commandQueue, m_fence, m_fenceValue, m_renderTargets[m_frameIndex],
+        D3D12_RESOURCE_STATE_PRESENT, m_presentedFrameCount);
+    }
+
     m_swapchain->Present(1, 0);
+    m_presentedFrameCount++;
 
     // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
 
@@ -122,6 +345,9 @@ namespace WoohooDX12
     m_commandQueue->Signal(m_fence, fence);
     m_fenceValue++;
 
+    m_frameFenceValue = fence;
+    m_dynamicGeometry.EndFrame(fence);
+
     // Wait until the previous frame is finished.
     if (m_fence->GetCompletedValue() < fence)
     {
@@ -131,6 +357,9 @@ namespace WoohooDX12
 
     m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
 
+    if (m_capturing)
+      m_readbackRing.Poll(m_fence, m_frameEncoder);
+
     return 0;
   }
 
@@ -197,24 +426,38 @@ namespace WoohooDX12
     // Create command allocator
     ReturnIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
 
+    // Create frame command list, closed until the first frame
+    ReturnIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator, nullptr, IID_PPV_ARGS(&m_frameCommandList)));
+    m_frameCommandList->SetName(L"Frame Command List");
+    ReturnIfFailed(m_frameCommandList->Close());
+
+    // Create upload command list, closed until the first upload
+    ReturnIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_uploadAllocator)));
+    ReturnIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_uploadAllocator, nullptr, IID_PPV_ARGS(&m_uploadCommandList)));
+    m_uploadCommandList->SetName(L"Upload Command List");
+    ReturnIfFailed(m_uploadCommandList->Close());
+
     // Sync
     ReturnIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
 
     // Create swapchain
     ReturnIfFailed(Resize(m_width, m_height));
 
+    ReturnIfFailed(m_dynamicGeometry.Init(m_device));
+    ReturnIfFailed(m_gpuDriven.Init(m_device, m_vertexLayout));
+
     Log("API has been initialized.", LogType::LT_INFO);
 
     return 0;
   }
 
-  int Renderer::InitResources(std::vector<std::shared_ptr<Material>>& materials)
+  int Renderer::InitResources(HandlePool<Material>& materials)
   {
     Log("Initializing API resources...", LogType::LT_INFO);
 
-    for (std::shared_ptr<Material> material : materials)
+    for (Material& material : materials)
     {
-      ReturnIfFailed(material->Init(m_device, m_commandAllocator));
+      ReturnIfFailed(material.Init(m_device, m_vertexLayout));
     }
 
     // Create synchronization objects and wait until assets have been uploaded to the GPU.
@@ -251,28 +494,51 @@ namespace WoohooDX12
     return 0;
   }
 
-  int Renderer::SetupCommands(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+  int Renderer::SetupCommands(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera,
+    const D3D12_VERTEX_BUFFER_VIEW* instanceView, uint32 instanceCount, uint32 lod, const IndexChunk* ranges, uint32 rangeCount)
   {
-    // Command list allocators can only be reset when the associated
-    // command lists have finished execution on the GPU; apps should use
-    // fences to determine GPU execution progress.
-    ReturnIfFailed(m_commandAllocator->Reset());
+    assert(m_recordingFrame && "Draws are recorded between BeginFrame and PresentBackbuffer!");
 
-    // However, when ExecuteCommandList() is called on a particular command
-    // list, that command list can then be reset at any time and must be before
-    // re-recording.
-    ReturnIfFailed(material->m_commandList->Reset(m_commandAllocator, material->m_pipelineState));
+    // The GPU reads the uniforms when it executes the frame, so every draw writes its own
+    DynamicAllocation uniforms;
+    ReturnIfFailed(m_dynamicGeometry.Allocate(sizeof(Material::UboVS), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, uniforms));
+    Material::WriteUniforms(modelMatrix, color, camera, uniforms.cpuAddress);
 
     // Set necessary state.
-    material->m_commandList->SetGraphicsRootSignature(material->m_rootSignature);
-    material->m_commandList->RSSetViewports(1, &m_viewport);
-    material->m_commandList->RSSetScissorRects(1, &m_surfaceSize);
+    if (m_boundRootSignature != material->m_rootSignature)
+    {
+      m_frameCommandList->SetGraphicsRootSignature(material->m_rootSignature);
+      m_boundRootSignature = material->m_rootSignature;
+    }
 
-    ID3D12DescriptorHeap* pDescriptorHeaps[] = { material->m_uniformBufferHeap };
-    material->m_commandList->SetDescriptorHeaps(_countof(pDescriptorHeaps), pDescriptorHeaps);
+    ID3D12PipelineState* pipelineState = instanceView != nullptr ? material->m_instancedPipelineState : material->m_pipelineState;
+    if (m_boundPipelineState != pipelineState)
+    {
+      m_frameCommandList->SetPipelineState(pipelineState);
+      m_boundPipelineState = pipelineState;
+    }
+
+    m_frameCommandList->SetGraphicsRootConstantBufferView(Material::UniformsParameter, uniforms.gpuAddress);
+
+    // Record commands.
+    m_frameCommandList->IASetVertexBuffers(0, 1, &mesh->m_vertexBufferView);
+    if (instanceView != nullptr)
+      m_frameCommandList->IASetVertexBuffers(1, 1, instanceView);
+    m_frameCommandList->IASetIndexBuffer(&mesh->m_indexBufferView);
 
-    D3D12_GPU_DESCRIPTOR_HANDLE srvHandle(material->m_uniformBufferHeap->GetGPUDescriptorHandleForHeapStart());
-    material->m_commandList->SetGraphicsRootDescriptorTable(0, srvHandle);
+    // Levels of detail are ranges of the same index buffer, drawn in one or more chunks
+    uint32 chunkCount = rangeCount;
+    const IndexChunk* chunks = ranges != nullptr ? ranges : mesh->GetDrawChunks(lod, chunkCount);
+    for (uint32 i = 0; i < chunkCount; ++i)
+      m_frameCommandList->DrawIndexedInstanced(chunks[i].indexCount, instanceCount, chunks[i].indexOffset, (int32)chunks[i].baseVertex, 0);
+
+    return 0;
+  }
+
+  void Renderer::BeginRenderTarget(ID3D12GraphicsCommandList* commandList)
+  {
+    commandList->RSSetViewports(1, &m_viewport);
+    commandList->RSSetScissorRects(1, &m_surfaceSize);
 
     // Indicate that the back buffer will be used as a render target.
     D3D12_RESOURCE_BARRIER renderTargetBarrier = {};
@@ -283,21 +549,18 @@ namespace WoohooDX12
     renderTargetBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
     renderTargetBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 
-    material->m_commandList->ResourceBarrier(1, &renderTargetBarrier);
+    commandList->ResourceBarrier(1, &renderTargetBarrier);
 
     D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
     rtvHandle.ptr = rtvHandle.ptr + (m_frameIndex * m_rtvDescriptorSize);
-    material->m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+    commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 
-    // Record commands.
     const float clearColor[] = { 0.2f, 0.2f, 0.2f, 1.0f };
-    material->m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    material->m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    material->m_commandList->IASetVertexBuffers(0, 1, &mesh->m_vertexBufferView);
-    material->m_commandList->IASetIndexBuffer(&mesh->m_indexBufferView);
-
-    material->m_commandList->DrawIndexedInstanced(3, 1, 0, 0, 0);
+    commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+  }
 
+  void Renderer::EndRenderTarget(ID3D12GraphicsCommandList* commandList)
+  {
     // Indicate that the back buffer will now be used to present.
     D3D12_RESOURCE_BARRIER presentBarrier;
     presentBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -307,11 +570,7 @@ namespace WoohooDX12
     presentBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
     presentBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 
-    material->m_commandList->ResourceBarrier(1, &presentBarrier);
-
-    ReturnIfFailed(material->m_commandList->Close());
-
-    return 0;
+    commandList->ResourceBarrier(1, &presentBarrier);
   }
 
   int Renderer::InitFrameBuffer()
@@ -394,28 +653,22 @@ namespace WoohooDX12
     return 0;
   }
 
-  int Renderer::DestroyCommands(std::vector<std::shared_ptr<Material>>& materials)
+  int Renderer::DestroyCommands()
   {
-    for (std::shared_ptr<Material> material : materials)
+    // Wait for GPU to finish work
+    const uint64 fence = m_fenceValue;
+    ReturnIfFailed(m_commandQueue->Signal(m_fence, fence));
+    m_fenceValue++;
+    if (m_fence->GetCompletedValue() < fence)
     {
-      material->m_commandList->Reset(m_commandAllocator, material->m_pipelineState);
-      material->m_commandList->ClearState(material->m_pipelineState);
-      ReturnIfFailed(material->m_commandList->Close());
-      ID3D12CommandList* ppCommandLists[] = { material->m_commandList };
-      m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-      // Wait for GPU to finish work
-      const uint64 fence = m_fenceValue;
-      ReturnIfFailed(m_commandQueue->Signal(m_fence, fence));
-      m_fenceValue++;
-      if (m_fence->GetCompletedValue() < fence)
-      {
-        ReturnIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-        WaitForSingleObject(m_fenceEvent, INFINITE);
-      }
+      ReturnIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
+      WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
 
-      material->m_commandList->Release();
-      material->m_commandList = nullptr;
+    if (m_frameCommandList)
+    {
+      m_frameCommandList->Release();
+      m_frameCommandList = nullptr;
     }
 
     return 0;
@@ -461,6 +714,18 @@ namespace WoohooDX12
       m_fence = nullptr;
     }
 
+    if (m_uploadCommandList)
+    {
+      m_uploadCommandList->Release();
+      m_uploadCommandList = nullptr;
+    }
+
+    if (m_uploadAllocator)
+    {
+      m_uploadAllocator->Release();
+      m_uploadAllocator = nullptr;
+    }
+
     if (m_commandAllocator)
     {
       ReturnIfFailed(m_commandAllocator->Reset());
@@ -9,6 +9,12 @@
 #include "../App/MainWindow.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "Memory/HandlePool.h"
+#include "ReadbackRing.h"
+#include "DynamicGeometryBuffer.h"
+#include "InstanceBatcher.h"
+#include "GPUDrivenPipeline.h"
+#include "Capture/FrameEncoder.h"
 
 namespace WoohooDX12
 {
@@ -21,26 +27,60 @@ namespace WoohooDX12
     Renderer();
     ~Renderer();
 
+    // Copies every presented frame to the CPU and encodes it on a worker thread
+    int StartCapture(const String& outputPath, CaptureFormat format, CaptureOverflowPolicy policy);
+    int StopCapture();
+    inline bool IsCapturing() const { return m_capturing; }
+
+    // Per frame streaming memory for geometry that changes every frame
+    inline DynamicGeometryBuffer& GetDynamicGeometry() { return m_dynamicGeometry; }
+
+    // Format the meshes are uploaded in and the pipelines read, with the position and the colour. Set before Init.
+    int SetVertexLayout(const VertexLayout& layout);
+    inline const VertexLayout& GetVertexLayout() const { return m_vertexLayout; }
+
   protected:
 
     int Init(uint32 width, uint32 height, HWND hwnd);
-    int UnInit(std::vector<std::shared_ptr<Material>>& materials);
+    int UnInit();
     int Resize(uint32 width, uint32 height);
 
-    int Render(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+    // Opens the command list of the frame once the GPU finished the previous one, the back buffer is cleared once here
+    int BeginFrame();
+    // lod is the level of detail of the mesh to draw, past the last level the coarsest one is drawn
+    int Render(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera, uint32 lod = 0);
+    // One draw of the mesh per instance, the instance data is streamed through the dynamic geometry buffer
+    int RenderInstanced(Mesh* mesh, Material* material, const InstanceData* instances, uint32 instanceCount, const Camera& camera, uint32 lod = 0);
+    // One draw per range of the GPU index buffer of the mesh, for the pieces of a static batch
+    int RenderRanges(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Camera& camera, const IndexChunk* ranges, uint32 rangeCount);
+    // Streams room for the objects, commands and instances of the GPU-driven path, filled by the caller before RenderIndirect
+    int AllocateIndirectFrame(uint32 objectCount, GPUDrivenFrame& frame);
+    // One command per draw chunk of the level, the index format of the mesh goes with it
+    static void FillIndirectCommand(const Mesh& mesh, const IndexChunk& chunk, uint32 objectIndex, IndirectDrawCommand& command);
+    // Culls the objects of the frame on the GPU and draws the visible ones with one ExecuteIndirect
+    int RenderIndirect(const GPUDrivenFrame& frame, const Frustum& frustum, const Camera& camera);
     int RenderImGui();
     int PresentBackbuffer();
 
+    // Records the GPU uploads of the meshes on the upload command list and submits them before the next draws
+    int UploadMeshes(Mesh* const* meshes, uint32 count);
+
     int InitAPI();
-    int InitResources(std::vector<std::shared_ptr<Material>>& materials);
-    int SetupCommands(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+    int InitResources(HandlePool<Material>& materials);
+    // Records a draw on the frame command list, its uniforms are streamed so every draw keeps its own. Draws with the instanced
+    // pipeline of the material when there is an instance stream. The chunks of the level are drawn unless ranges are given.
+    int SetupCommands(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera,
+      const D3D12_VERTEX_BUFFER_VIEW* instanceView = nullptr, uint32 instanceCount = 1, uint32 lod = 0, const IndexChunk* ranges = nullptr, uint32 rangeCount = 0);
+    // Transitions the back buffer to render target, binds and clears it
+    void BeginRenderTarget(ID3D12GraphicsCommandList* commandList);
+    void EndRenderTarget(ID3D12GraphicsCommandList* commandList);
     int InitFrameBuffer();
 
     int SetupSwapchain(uint32 width, uint32 height);
 
     int DestroyAPI();
     int DestroyResources();
-    int DestroyCommands(std::vector<std::shared_ptr<Material>>& materials);
+    int DestroyCommands();
     int DestroyFrameBuffer();
 
   private:
@@ -63,6 +103,21 @@ namespace WoohooDX12
     ID3D12CommandQueue* m_commandQueue = nullptr;
     ID3D12CommandAllocator* m_commandAllocator = nullptr;
 
+    // Every draw of a frame is recorded here and submitted once before present
+    ID3D12GraphicsCommandList* m_frameCommandList = nullptr;
+    uint64 m_frameFenceValue = 0; // Signaled when the last submitted frame is complete, the allocator is reset after it
+    bool m_recordingFrame = false;
+    ID3D12RootSignature* m_boundRootSignature = nullptr; // State of the frame command list, set again only when it changes
+    ID3D12PipelineState* m_boundPipelineState = nullptr;
+
+    // Mesh uploads, independent from the frame command list so they can be submitted at any point of a frame
+    ID3D12CommandAllocator* m_uploadAllocator = nullptr;
+    ID3D12GraphicsCommandList* m_uploadCommandList = nullptr;
+    uint64 m_uploadFenceValue = 0; // Signaled when the last submitted upload is complete
+
+    // GPU-driven path, not tied to a material
+    GPUDrivenPipeline m_gpuDriven;
+
     // Current Frame
     uint32 m_currentBuffer = 0;
     ID3D12DescriptorHeap* m_rtvHeap = nullptr;
@@ -82,5 +137,14 @@ namespace WoohooDX12
     HANDLE m_fenceEvent;
     ID3D12Fence* m_fence = nullptr;
     uint64 m_fenceValue;
+
+    DynamicGeometryBuffer m_dynamicGeometry;
+    VertexLayout m_vertexLayout = VertexLayout::Make(VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Color), 0);
+
+    // Capture
+    ReadbackRing m_readbackRing;
+    FrameEncoder m_frameEncoder;
+    bool m_capturing = false;
+    uint64 m_presentedFrameCount = 0;
   };
 }
@@ -1,20 +1,40 @@
 #include "SceneRenderer.h"
 
+#include <algorithm>
+#include <chrono>
+#include "Memory/FrameArena.h"
+#include "Memory/MemoryTracker.h"
+
 namespace WoohooDX12
 {
   SceneRenderer::SceneRenderer()
   {
     m_scene = std::make_shared<Scene>();
-    m_defaultMaterial = std::make_shared<Material>();
+    m_defaultMaterial = m_materials.Create();
   }
 
   SceneRenderer::~SceneRenderer()
   {
     assert(!m_initialized && "Scene Renderer is uninitialized!");
 
-    m_renderJobs.clear();
+    m_renderObjects.clear();
     m_scene = nullptr;
-    m_defaultMaterial = nullptr;
+    m_materials.Clear();
+  }
+
+  int SceneRenderer::SetScene(std::shared_ptr<Scene> scene)
+  {
+    if (!m_initialized)
+    {
+      m_scene = scene;
+      return 0;
+    }
+
+    ReleaseRenderObjects();
+    m_scene = scene;
+    ReturnIfFailed(BuildRenderObjects());
+
+    return 0;
   }
 
   int SceneRenderer::Init(std::shared_ptr<Renderer> renderer, uint32 width, uint32 height, HWND hwnd)
@@ -24,27 +44,13 @@ namespace WoohooDX12
 
     m_renderer = renderer;
     ReturnIfFailed(m_renderer->Init(width, height, hwnd));
-    std::vector<std::shared_ptr<Material>> materials = { m_defaultMaterial };
-    ReturnIfFailed(m_renderer->InitResources(materials));
-
-    // Create render job datas
-    m_renderJobs[m_defaultMaterial] = std::vector<std::shared_ptr<Mesh>>();
-
-    // Init meshes
-    for (std::shared_ptr<Entity> ntt : m_scene->m_entities)
-    {
-      std::shared_ptr<Material> mat = GetMaterialForEntityType(ntt->GetType());
-
-      ReturnIfFailed(ntt->m_mesh->Init(m_renderer->m_device, mat->m_commandList));
-      // Execute upload commands
-      ReturnIfFailed(mat->m_commandList->Close());
-      ID3D12CommandList* ppCommandLists[] = { mat->m_commandList };
-      m_renderer->m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-      m_renderJobs[mat].push_back(ntt->m_mesh);
-    }
+    ReturnIfFailed(m_renderer->InitResources(m_materials));
+    m_occlusionBuffer.Init(width / OcclusionBufferDivider, height / OcclusionBufferDivider);
+    m_viewportHeight = height;
 
     m_initialized = true;
+    ReturnIfFailed(BuildRenderObjects());
+
     return 0;
   }
 
@@ -53,19 +59,12 @@ namespace WoohooDX12
     if (!m_initialized)
       return 0;
 
-    for (auto renderJob : m_renderJobs)
-    {
-      for (std::shared_ptr<Mesh> mesh : renderJob.second)
-      {
-        mesh->UnInit();
-      }
-      renderJob.second.clear();
-      renderJob.first->UnInit();
-    }
-    m_renderJobs.clear();
+    ReleaseRenderObjects();
+
+    for (Material& material : m_materials)
+      material.UnInit();
 
-    std::vector<std::shared_ptr<Material>> materials = { m_defaultMaterial };
-    m_renderer->UnInit(materials);
+    m_renderer->UnInit();
 
     m_initialized = false;
     return 0;
@@ -74,6 +73,8 @@ namespace WoohooDX12
   int SceneRenderer::Resize(uint32 width, uint32 height)
   {
     m_renderer->Resize(width, height);
+    m_occlusionBuffer.Init(width / OcclusionBufferDivider, height / OcclusionBufferDivider);
+    m_viewportHeight = height;
 
     return 0;
   }
@@ -83,19 +84,718 @@ namespace WoohooDX12
     if (!m_initialized)
       return -1;
 
-    for (auto meshesWithSameMaterial : m_renderJobs)
+    ReturnIfFailed(ApplySceneChanges());
+
+    const Camera& camera = m_scene->m_camera;
+    if (m_gpuDriven)
+      return RenderGPUDriven(camera);
+
+    m_frustumCuller.Cull(Frustum::FromViewProjection(camera.GetViewProjectionMatrix()), m_bounds, m_scene->m_jobSystem.get());
+
+    // Flatten the visible objects into a transient draw list, no ref counting or heap allocation per draw
+    const uint32 visibleCount = m_frustumCuller.GetVisibleCount();
+    const uint32* visibleIndices = m_frustumCuller.GetVisibleIndices();
+
+    m_testPVS = m_pvsCulling && UpdatePVS(camera);
+    m_testPortals = m_portalCulling && UpdatePortals(camera);
+    const bool testOcclusion = m_occlusionCulling && RenderOccluders(camera);
+
+    FrameVector<DrawItem> drawList;
+    drawList.reserve(visibleCount);
+
+    const float projectionScale = LODSelector::GetProjectionScale(camera.GetProjectionMatrix(), m_viewportHeight);
+    m_triangleCount = 0;
+    for (uint32 i = 0; i < visibleCount; ++i)
+    {
+      const uint32 index = visibleIndices[i];
+      const RenderObject& object = m_renderObjects[index];
+      if (IsHiddenByVisibility(index))
+        continue;
+
+      // Occluders are always drawn, the others are tested with the box of their bounding sphere
+      if (testOcclusion && !object.occluder)
+      {
+        const float radius = m_bounds.radius[index];
+        AABB box;
+        box.min = Vec3(m_bounds.centerX[index] - radius, m_bounds.centerY[index] - radius, m_bounds.centerZ[index] - radius);
+        box.max = Vec3(m_bounds.centerX[index] + radius, m_bounds.centerY[index] + radius, m_bounds.centerZ[index] + radius);
+        if (!m_occlusionBuffer.TestAABB(box, camera.GetViewProjectionMatrix()))
+          continue;
+      }
+
+      Mesh* mesh = m_scene->m_meshes.Get(object.mesh);
+      const uint32 lod = SelectLOD(index, camera.GetPosition(), projectionScale);
+      m_triangleCount += mesh->GetLOD(lod).indexCount / 3;
+      drawList.push_back({ mesh, m_materials.Get(object.material), &m_scene->m_transforms.GetWorldMatrix(object.transform),
+        object.color, InstanceBatcher::MakeSortKey(object.material.index, object.mesh.index, lod), index, lod, &mesh->GetPositionQuantization() });
+    }
+
+    uint32 batchDrawCount = 0;
+    ReturnIfFailed(RenderStaticBatches(camera, testOcclusion, batchDrawCount));
+
+    // Render objects are unordered, keep the draws of a material and a mesh together
+    if (!m_instancing)
+    {
+      InstanceBatcher::SortDraws(drawList.data(), (uint32)drawList.size());
+      for (const DrawItem& draw : drawList)
+        ReturnIfFailed(m_renderer->Render(draw.mesh, draw.material, *draw.modelMatrix, draw.color, camera, draw.lod));
+
+      m_drawCallCount = (uint32)drawList.size() + batchDrawCount;
+      return 0;
+    }
+
+    m_instanceBatcher.Build(drawList.data(), (uint32)drawList.size());
+    const InstanceData* instances = m_instanceBatcher.GetInstances();
+    for (const DrawRun& run : m_instanceBatcher.GetRuns())
+      ReturnIfFailed(m_renderer->RenderInstanced(run.mesh, run.material, instances + run.firstInstance, run.instanceCount, camera, run.lod));
+
+    m_drawCallCount = (uint32)m_instanceBatcher.GetRuns().size() + batchDrawCount;
+    return 0;
+  }
+
+  int SceneRenderer::RenderGPUDriven(const Camera& camera)
+  {
+    m_testPVS = m_pvsCulling && UpdatePVS(camera);
+    m_testPortals = m_portalCulling && UpdatePortals(camera);
+
+    // Meshes split for 16-bit indices draw a command per chunk, each culled as its own object
+    uint32 capacity = 0;
+    for (const RenderObject& object : m_renderObjects)
+      capacity += m_scene->m_meshes.Get(object.mesh)->GetMaxDrawChunkCount();
+    const std::vector<StaticBatch>& batches = m_staticBatcher.GetBatches();
+    for (uint32 batch = 0; batch < (uint32)m_batchMeshes.size(); ++batch)
+      capacity += (batches[batch].pieceCount + 1) / 2;
+
+    GPUDrivenFrame frame;
+    ReturnIfFailed(m_renderer->AllocateIndirectFrame(capacity, frame));
+
+    // Upload memory is write-combined, every element is written once and in order
+    const float projectionScale = LODSelector::GetProjectionScale(camera.GetProjectionMatrix(), m_viewportHeight);
+    uint32 objectCount = 0;
+    m_triangleCount = 0;
+    for (uint32 index = 0; index < (uint32)m_renderObjects.size(); ++index)
+    {
+      if (IsHiddenByVisibility(index))
+        continue;
+
+      const RenderObject& object = m_renderObjects[index];
+      const GPUCullObject sphere = { { m_bounds.centerX[index], m_bounds.centerY[index], m_bounds.centerZ[index] }, m_bounds.radius[index] };
+      const Mesh& mesh = *m_scene->m_meshes.Get(object.mesh);
+      const uint32 lod = SelectLOD(index, camera.GetPosition(), projectionScale);
+      m_triangleCount += mesh.GetLOD(lod).indexCount / 3;
+      Mat4x4 world;
+      VertexQuantizer::FoldDequantization(mesh.GetPositionQuantization(), m_scene->m_transforms.GetWorldMatrix(object.transform), world);
+      InstanceData instance;
+      InstanceBatcher::PackInstance(world, object.color, instance);
+
+      uint32 chunkCount = 0;
+      const IndexChunk* chunks = mesh.GetDrawChunks(lod, chunkCount);
+      for (uint32 chunk = 0; chunk < chunkCount; ++chunk)
+      {
+        IndirectDrawCommand command;
+        Renderer::FillIndirectCommand(mesh, chunks[chunk], objectCount, command);
+
+        frame.objects[objectCount] = sphere;
+        frame.commands[objectCount] = command;
+        frame.instances[objectCount] = instance;
+        ++objectCount;
+      }
+    }
+
+    // A command per range of visible pieces, culled with the bounds of their batch
+    Mat4x4 identity;
+    MakeIdentity(identity);
+    for (uint32 batch = 0; batch < (uint32)m_batchMeshes.size(); ++batch)
+    {
+      const uint32 rangeCount = GetBatchRanges(batch, m_batchRanges.data());
+      if (rangeCount == 0)
+        continue;
+
+      const StaticBatch& bounds = batches[batch];
+      const GPUCullObject sphere = { { bounds.center[0], bounds.center[1], bounds.center[2] }, bounds.radius };
+      const Mesh& mesh = m_batchMeshes[batch];
+      Mat4x4 world;
+      VertexQuantizer::FoldDequantization(mesh.GetPositionQuantization(), identity, world);
+      InstanceData instance;
+      InstanceBatcher::PackInstance(world, Vec4(1.0f, 1.0f, 1.0f, 1.0f), instance);
+
+      for (uint32 range = 0; range < rangeCount; ++range)
+      {
+        IndirectDrawCommand command;
+        Renderer::FillIndirectCommand(mesh, m_batchRanges[range], objectCount, command);
+        m_triangleCount += m_batchRanges[range].indexCount / 3;
+
+        frame.objects[objectCount] = sphere;
+        frame.commands[objectCount] = command;
+        frame.instances[objectCount] = instance;
+        ++objectCount;
+      }
+    }
+    frame.objectCount = objectCount;
+
+    ReturnIfFailed(m_renderer->RenderIndirect(frame, Frustum::FromViewProjection(camera.GetViewProjectionMatrix()), camera));
+
+    // The draw count is only known on the GPU, the whole frame is one submission
+    m_drawCallCount = objectCount > 0 ? 1 : 0;
+    return 0;
+  }
+
+  int SceneRenderer::BuildRenderObjects()
+  {
+    m_scene->m_world.Each<EntityTypeComponent, MeshComponent, TransformComponent>([this](Entity entity, EntityTypeComponent&, MeshComponent&, TransformComponent&)
+      {
+        AddRenderObject(entity);
+      });
+    ReturnIfFailed(BuildStaticBatches());
+
+    // The journal is covered by the full build
+    m_scene->ClearChanges();
+
+    return UploadPendingMeshes();
+  }
+
+  void SceneRenderer::ReleaseRenderObjects()
+  {
+    for (const RenderObject& object : m_renderObjects)
+      ReleaseMesh(object.mesh);
+
+    m_renderObjects.clear();
+    m_entityToObject.clear();
+    m_meshUsers.clear();
+    m_pendingUploads.clear();
+    m_bounds.Resize(0);
+    ReleaseStaticBatches();
+  }
+
+  int SceneRenderer::ApplySceneChanges()
+  {
+    const auto start = std::chrono::steady_clock::now();
+
+    const SceneJournal& journal = m_scene->GetJournal();
+    const SceneChange* changes = journal.GetChanges();
+    const uint32 changeCount = journal.GetChangeCount();
+    for (uint32 i = 0; i < changeCount; ++i)
+    {
+      const SceneChange& change = changes[i];
+      if (change.type == SceneChangeType::EntityRemoved)
+      {
+        if (UnbatchEntity(change.entity))
+          continue;
+
+        const uint32 index = FindRenderObject(change.entity);
+        if (index != InvalidObject)
+          RemoveRenderObject(index);
+        continue;
+      }
+
+      // Removed later in the frame, its removal comes after this change
+      if (!m_scene->m_world.IsAlive(change.entity))
+        continue;
+
+      if (change.type == SceneChangeType::EntityAdded)
+      {
+        AddRenderObject(change.entity);
+        continue;
+      }
+
+      // Batches are only built at load, a batched entity that changes is drawn on its own from then on
+      if (UnbatchEntity(change.entity))
+      {
+        AddRenderObject(change.entity);
+        continue;
+      }
+
+      const uint32 index = FindRenderObject(change.entity);
+      if (index == InvalidObject)
+        continue;
+
+      switch (change.type)
+      {
+      case SceneChangeType::MeshChanged:
+        RefreshRenderObject(index, true);
+        break;
+      case SceneChangeType::MaterialChanged:
+        RefreshRenderObject(index, false);
+        break;
+      case SceneChangeType::TransformChanged:
+        UpdateBounds(index);
+        break;
+      default:
+        break;
+      }
+    }
+
+    // Released meshes are not referenced by any render object anymore
+    m_scene->ClearChanges();
+    const int result = UploadPendingMeshes();
+
+    m_syncStats.changeCount = changeCount;
+    m_syncStats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+  }
+
+  int SceneRenderer::UploadPendingMeshes()
+  {
+    // A mesh can be queued more than once if it is released and used again in the same frame
+    std::sort(m_pendingUploads.begin(), m_pendingUploads.end(), [](MeshHandle a, MeshHandle b) { return a.index < b.index; });
+
+    m_uploadMeshes.clear();
+    for (uint32 i = 0; i < (uint32)m_pendingUploads.size(); ++i)
+    {
+      const MeshHandle meshHandle = m_pendingUploads[i];
+      if (i > 0 && m_pendingUploads[i - 1] == meshHandle)
+        continue;
+
+      // Not used anymore by the time of the upload
+      Mesh* mesh = m_scene->m_meshes.Get(meshHandle);
+      if (mesh != nullptr && m_meshUsers[meshHandle.index] > 0 && !mesh->IsInitialized())
+        m_uploadMeshes.push_back(mesh);
+    }
+    m_pendingUploads.clear();
+    m_syncStats.uploadCount = (uint32)m_uploadMeshes.size();
+
+    WOH_MEMORY_SCOPE(MemoryTag::Assets);
+    return m_renderer->UploadMeshes(m_uploadMeshes.data(), (uint32)m_uploadMeshes.size());
+  }
+
+  void SceneRenderer::AddRenderObject(Entity entity)
+  {
+    const EntityWorld& world = m_scene->m_world;
+    const TransformComponent* transform = m_scene->m_world.Get<TransformComponent>(entity);
+    if (!world.Has<EntityTypeComponent>(entity) || !world.Has<MeshComponent>(entity) || transform == nullptr || FindRenderObject(entity) != InvalidObject)
+      return;
+
+    const uint32 index = (uint32)m_renderObjects.size();
+    if (entity.index >= m_entityToObject.size())
+      m_entityToObject.resize(entity.index + 1, InvalidObject);
+    m_entityToObject[entity.index] = index;
+
+    RenderObject object;
+    object.entity = entity;
+    object.transform = transform->transform;
+    object.occluder = world.Has<OccluderComponent>(entity);
+    if (const PVSObjectComponent* pvsObject = m_scene->m_world.Get<PVSObjectComponent>(entity))
+      object.pvsObject = pvsObject->object;
+    m_renderObjects.push_back(object);
+    m_bounds.Resize(index + 1);
+
+    RefreshRenderObject(index, true);
+  }
+
+  void SceneRenderer::RemoveRenderObject(uint32 index)
+  {
+    ReleaseMesh(m_renderObjects[index].mesh);
+    m_entityToObject[m_renderObjects[index].entity.index] = InvalidObject;
+
+    const uint32 lastIndex = (uint32)m_renderObjects.size() - 1;
+    if (index != lastIndex)
+    {
+      m_renderObjects[index] = m_renderObjects[lastIndex];
+      m_entityToObject[m_renderObjects[index].entity.index] = index;
+    }
+    m_renderObjects.pop_back();
+    m_bounds.Remove(index);
+  }
+
+  void SceneRenderer::RefreshRenderObject(uint32 index, bool meshChanged)
+  {
+    RenderObject& object = m_renderObjects[index];
+    object.material = GetMaterialForEntityType(m_scene->m_world.Get<EntityTypeComponent>(object.entity)->type);
+    const ColorComponent* color = m_scene->m_world.Get<ColorComponent>(object.entity);
+    object.color = color != nullptr ? color->color : Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+    if (meshChanged)
     {
-      std::shared_ptr<Material> mat = meshesWithSameMaterial.first;
-      for (std::shared_ptr<Mesh> mesh : meshesWithSameMaterial.second)
+      const MeshHandle meshHandle = m_scene->m_world.Get<MeshComponent>(object.entity)->mesh;
+      Mesh* mesh = m_scene->m_meshes.Get(meshHandle);
+      if (object.mesh != meshHandle)
+      {
+        AcquireMesh(meshHandle);
+        if (!object.mesh.IsNull())
+          ReleaseMesh(object.mesh);
+        object.mesh = meshHandle;
+      }
+      else
       {
-        m_renderer->Render(mesh, mat);
+        // Edited in place, the data on the GPU is stale
+        mesh->UnInit();
+        m_pendingUploads.push_back(meshHandle);
       }
+      mesh->GetBoundingSphere(object.localCenter, object.localRadius);
+      object.lod = 0;
+    }
+
+    UpdateBounds(index);
+  }
+
+  void SceneRenderer::AcquireMesh(MeshHandle meshHandle)
+  {
+    if (meshHandle.index >= m_meshUsers.size())
+      m_meshUsers.resize(meshHandle.index + 1, 0);
+
+    // Meshes are uploaded once, however many objects use them
+    if (m_meshUsers[meshHandle.index]++ == 0)
+      m_pendingUploads.push_back(meshHandle);
+  }
+
+  void SceneRenderer::ReleaseMesh(MeshHandle meshHandle)
+  {
+    // The previous frame is finished, the GPU buffers are not in use
+    if (--m_meshUsers[meshHandle.index] == 0)
+      m_scene->m_meshes.Get(meshHandle)->UnInit();
+  }
+
+  uint32 SceneRenderer::GetResidentMeshCount() const
+  {
+    uint32 count = 0;
+    for (const Mesh& mesh : m_scene->m_meshes)
+      count += mesh.IsInitialized() ? 1 : 0;
+
+    return count;
+  }
+
+  uint32 SceneRenderer::FindRenderObject(Entity entity) const
+  {
+    if (entity.index >= m_entityToObject.size())
+      return InvalidObject;
+
+    const uint32 index = m_entityToObject[entity.index];
+    return index != InvalidObject && m_renderObjects[index].entity == entity ? index : InvalidObject;
+  }
+
+  void SceneRenderer::UpdateBounds(uint32 index)
+  {
+    const RenderObject& object = m_renderObjects[index];
+
+    // Radius is scaled by the largest axis scale of the world matrix
+    const Mat world = DirectX::XMLoadFloat4x4(&m_scene->m_transforms.GetWorldMatrix(object.transform));
+    Vec3 center;
+    DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&object.localCenter), world));
+    const float scale = sqrtf(std::max({ DirectX::XMVectorGetX(DirectX::XMVector3Dot(world.r[0], world.r[0])),
+      DirectX::XMVectorGetX(DirectX::XMVector3Dot(world.r[1], world.r[1])), DirectX::XMVectorGetX(DirectX::XMVector3Dot(world.r[2], world.r[2])) }));
+
+    m_bounds.Set(index, center, object.localRadius * scale);
+    UpdatePortalCell(index);
+  }
+
+  int SceneRenderer::BuildStaticBatches()
+  {
+    // Portal culling tests every object against the cells it is in, a batch would span cells
+    if (!m_staticBatching || m_scene->m_portalGraph != nullptr)
+      return 0;
+
+    // Static objects are the ones no rotator turns. Meshes with levels of detail keep their selection.
+    std::vector<uint32> objects;
+    std::vector<StaticBatchSource> sources;
+    for (uint32 index = 0; index < (uint32)m_renderObjects.size(); ++index)
+    {
+      const RenderObject& object = m_renderObjects[index];
+      const Mesh& mesh = *m_scene->m_meshes.Get(object.mesh);
+      if (object.occluder || m_scene->m_world.Has<RotatorComponent>(object.entity) || mesh.GetVertexCount() > MaxStaticBatchSourceVertices ||
+        mesh.GetLODCount() > 1)
+        continue;
+
+      // World box of the corners of the local box
+      StaticBatchSource source;
+      Vec3 localMin;
+      Vec3 localMax;
+      mesh.GetBoundingBox(localMin, localMax);
+      const Mat world = DirectX::XMLoadFloat4x4(&m_scene->m_transforms.GetWorldMatrix(object.transform));
+      for (uint32 corner = 0; corner < 8; ++corner)
+      {
+        const Vec3 local((corner & 1) ? localMax.x : localMin.x, (corner & 2) ? localMax.y : localMin.y, (corner & 4) ? localMax.z : localMin.z);
+        Vec3 position;
+        DirectX::XMStoreFloat3(&position, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&local), world));
+        const float coordinates[3] = { position.x, position.y, position.z };
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+          source.boundsMin[axis] = corner == 0 ? coordinates[axis] : std::min(source.boundsMin[axis], coordinates[axis]);
+          source.boundsMax[axis] = corner == 0 ? coordinates[axis] : std::max(source.boundsMax[axis], coordinates[axis]);
+        }
+      }
+      source.material = object.material.index;
+      source.vertexCount = mesh.GetVertexCount();
+      source.indices = mesh.GetIndices();
+      source.indexCount = mesh.GetIndexCount();
+      sources.push_back(source);
+      objects.push_back(index);
+    }
+
+    m_staticBatcher.Build(sources.data(), (uint32)sources.size(), StaticBatchOptions());
+    const std::vector<StaticBatch>& batches = m_staticBatcher.GetBatches();
+    const std::vector<StaticBatchPiece>& pieces = m_staticBatcher.GetPieces();
+    const uint32 batchCount = (uint32)batches.size();
+    if (batchCount == 0)
+      return 0;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Assets);
+    m_batchMeshes.resize(batchCount);
+    m_batchMaterials.resize(batchCount);
+    m_batchBounds.Resize(batchCount);
+    m_batchedObjects.resize(pieces.size());
+
+    // Vertices in world space with the colour of their object, the batches are drawn with an identity world matrix
+    std::vector<Vertex> vertices;
+    uint32 maxPieceCount = 0;
+    for (uint32 batch = 0; batch < batchCount; ++batch)
+    {
+      const StaticBatch& staticBatch = batches[batch];
+      vertices.resize(staticBatch.vertexCount);
+      for (uint32 piece = staticBatch.firstPiece; piece < staticBatch.firstPiece + staticBatch.pieceCount; ++piece)
+      {
+        const RenderObject& object = m_renderObjects[objects[pieces[piece].source]];
+        const Mesh& mesh = *m_scene->m_meshes.Get(object.mesh);
+        const Mat world = DirectX::XMLoadFloat4x4(&m_scene->m_transforms.GetWorldMatrix(object.transform));
+        const Vertex* sourceVertices = mesh.GetVertices();
+        for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+        {
+          const Vertex& sourceVertex = sourceVertices[vertex];
+          Vertex& batchVertex = vertices[pieces[piece].vertexOffset + vertex];
+          const Vec3 local(sourceVertex.position[0], sourceVertex.position[1], sourceVertex.position[2]);
+          Vec3 position;
+          DirectX::XMStoreFloat3(&position, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&local), world));
+          batchVertex.position[0] = position.x;
+          batchVertex.position[1] = position.y;
+          batchVertex.position[2] = position.z;
+          batchVertex.color[0] = sourceVertex.color[0] * object.color.x;
+          batchVertex.color[1] = sourceVertex.color[1] * object.color.y;
+          batchVertex.color[2] = sourceVertex.color[2] * object.color.z;
+        }
+
+        BatchedObject& batchedObject = m_batchedObjects[piece];
+        batchedObject.entity = object.entity;
+        batchedObject.pvsObject = object.pvsObject;
+        batchedObject.hidden = false;
+        if (object.entity.index >= m_entityToPiece.size())
+          m_entityToPiece.resize(object.entity.index + 1, StaticBatcher::InvalidPiece);
+        m_entityToPiece[object.entity.index] = piece;
+      }
+
+      m_batchMeshes[batch].SetGeometry(vertices.data(), staticBatch.vertexCount, m_staticBatcher.GetIndices().data() + staticBatch.indexOffset,
+        staticBatch.indexCount);
+      m_batchMaterials[batch] = m_renderObjects[objects[pieces[staticBatch.firstPiece].source]].material;
+      m_batchBounds.Set(batch, Vec3(staticBatch.center[0], staticBatch.center[1], staticBatch.center[2]), staticBatch.radius);
+      maxPieceCount = std::max(maxPieceCount, staticBatch.pieceCount);
+    }
+    m_batchRanges.resize((maxPieceCount + 1) / 2);
+
+    // From the last one down, removal swaps the last object into the hole
+    for (uint32 i = (uint32)objects.size(); i-- > 0;)
+    {
+      if (m_staticBatcher.GetSourcePiece(i) != StaticBatcher::InvalidPiece)
+        RemoveRenderObject(objects[i]);
+    }
+
+    std::vector<Mesh*> uploads(batchCount);
+    for (uint32 batch = 0; batch < batchCount; ++batch)
+      uploads[batch] = &m_batchMeshes[batch];
+
+    return m_renderer->UploadMeshes(uploads.data(), batchCount);
+  }
+
+  void SceneRenderer::ReleaseStaticBatches()
+  {
+    for (Mesh& mesh : m_batchMeshes)
+      mesh.UnInit();
+
+    m_batchMeshes.clear();
+    m_batchMaterials.clear();
+    m_batchedObjects.clear();
+    m_entityToPiece.clear();
+    m_batchRanges.clear();
+    m_batchBounds.Resize(0);
+  }
+
+  bool SceneRenderer::UnbatchEntity(Entity entity)
+  {
+    if (entity.index >= m_entityToPiece.size())
+      return false;
+
+    const uint32 piece = m_entityToPiece[entity.index];
+    if (piece == StaticBatcher::InvalidPiece || !(m_batchedObjects[piece].entity == entity))
+      return false;
+
+    m_batchedObjects[piece].hidden = true;
+    m_entityToPiece[entity.index] = StaticBatcher::InvalidPiece;
+    return true;
+  }
+
+  uint32 SceneRenderer::GetBatchRanges(uint32 batch, IndexChunk* ranges) const
+  {
+    const uint32 rangeCount = StaticBatcher::GetVisibleRanges(m_staticBatcher.GetBatches()[batch], [this](uint32 piece) { return IsPieceVisible(piece); },
+      m_staticBatcher.GetPieces().data(), ranges);
+
+    // Under 65536 vertices a batch is one chunk of its mesh with the triangles in the batcher's order, only the base vertex and
+    // the offset of the chunk may differ
+    uint32 chunkCount = 0;
+    const IndexChunk* chunk = m_batchMeshes[batch].GetDrawChunks(0, chunkCount);
+    assert(chunkCount == 1 && "A static batch is one draw!");
+    for (uint32 range = 0; range < rangeCount; ++range)
+    {
+      ranges[range].indexOffset += chunk->indexOffset;
+      ranges[range].baseVertex = chunk->baseVertex;
+    }
+
+    return rangeCount;
+  }
+
+  int SceneRenderer::RenderStaticBatches(const Camera& camera, bool testOcclusion, uint32& drawCount)
+  {
+    drawCount = 0;
+    if (m_batchMeshes.empty())
+      return 0;
+
+    m_batchCuller.Cull(Frustum::FromViewProjection(camera.GetViewProjectionMatrix()), m_batchBounds, m_scene->m_jobSystem.get());
+    const std::vector<StaticBatch>& batches = m_staticBatcher.GetBatches();
+
+    Mat4x4 identity;
+    MakeIdentity(identity);
+    for (uint32 i = 0; i < m_batchCuller.GetVisibleCount(); ++i)
+    {
+      const uint32 batch = m_batchCuller.GetVisibleIndices()[i];
+      if (testOcclusion)
+      {
+        AABB box;
+        box.min = Vec3(batches[batch].boundsMin[0], batches[batch].boundsMin[1], batches[batch].boundsMin[2]);
+        box.max = Vec3(batches[batch].boundsMax[0], batches[batch].boundsMax[1], batches[batch].boundsMax[2]);
+        if (!m_occlusionBuffer.TestAABB(box, camera.GetViewProjectionMatrix()))
+          continue;
+      }
+
+      const uint32 rangeCount = GetBatchRanges(batch, m_batchRanges.data());
+      if (rangeCount == 0)
+        continue;
+
+      ReturnIfFailed(m_renderer->RenderRanges(&m_batchMeshes[batch], m_materials.Get(m_batchMaterials[batch]), identity, camera, m_batchRanges.data(),
+        rangeCount));
+      for (uint32 range = 0; range < rangeCount; ++range)
+        m_triangleCount += m_batchRanges[range].indexCount / 3;
+      drawCount += rangeCount;
     }
 
     return 0;
   }
 
-  std::shared_ptr<Material> SceneRenderer::GetMaterialForEntityType(EntityType type)
+  uint32 SceneRenderer::SelectLOD(uint32 index, const Vec3& cameraPosition, float projectionScale)
+  {
+    RenderObject& object = m_renderObjects[index];
+    const Mesh& mesh = *m_scene->m_meshes.Get(object.mesh);
+    if (!m_lodSelection || mesh.GetLODCount() <= 1 || object.localRadius <= 0.0f)
+    {
+      object.lod = 0;
+      return 0;
+    }
+
+    // Errors are in mesh units, the world bounds carry the scale of the object
+    const float radius = m_bounds.radius[index];
+    const float dx = m_bounds.centerX[index] - cameraPosition.x;
+    const float dy = m_bounds.centerY[index] - cameraPosition.y;
+    const float dz = m_bounds.centerZ[index] - cameraPosition.z;
+    const float distance = sqrtf(dx * dx + dy * dy + dz * dz) - radius;
+
+    object.lod = LODSelector::Select(&mesh.GetLOD(0), mesh.GetLODCount(), object.lod, radius / object.localRadius, distance, projectionScale,
+      m_lodThresholdPixels, m_lodHysteresis);
+    return object.lod;
+  }
+
+  bool SceneRenderer::UpdatePVS(const Camera& camera)
+  {
+    const PotentiallyVisibleSet* pvs = m_scene->m_pvs.get();
+    if (pvs == nullptr)
+    {
+      m_pvs = nullptr;
+      return false;
+    }
+
+    // The objects may have been tagged after they were added
+    if (pvs != m_pvs)
+    {
+      m_pvs = pvs;
+      m_pvsCell = PotentiallyVisibleSet::InvalidCell;
+      m_pvsObjectCount = pvs->GetObjectCount();
+      m_pvsBits.resize(pvs->GetWordCount());
+      for (RenderObject& object : m_renderObjects)
+      {
+        const PVSObjectComponent* pvsObject = m_scene->m_world.Get<PVSObjectComponent>(object.entity);
+        object.pvsObject = pvsObject ? pvsObject->object : PotentiallyVisibleSet::InvalidObject;
+      }
+      for (BatchedObject& object : m_batchedObjects)
+      {
+        const PVSObjectComponent* pvsObject = object.hidden ? nullptr : m_scene->m_world.Get<PVSObjectComponent>(object.entity);
+        object.pvsObject = pvsObject ? pvsObject->object : PotentiallyVisibleSet::InvalidObject;
+      }
+    }
+
+    const uint32 cell = pvs->GetCellAt(camera.GetPosition());
+    if (cell != m_pvsCell)
+    {
+      m_pvsCell = cell;
+      pvs->Decompress(cell, m_pvsBits.data());
+    }
+
+    return pvs->HasVisibility(cell);
+  }
+
+  bool SceneRenderer::UpdatePortals(const Camera& camera)
+  {
+    const PortalGraph* graph = m_scene->m_portalGraph.get();
+    if (graph != m_portalGraph)
+    {
+      m_portalGraph = graph;
+      for (uint32 i = 0; i < (uint32)m_renderObjects.size(); ++i)
+        UpdatePortalCell(i);
+    }
+
+    if (graph == nullptr)
+      return false;
+
+    return m_portalCuller.Cull(*graph, Frustum::FromViewProjection(camera.GetViewProjectionMatrix()), camera.GetPosition());
+  }
+
+  void SceneRenderer::UpdatePortalCell(uint32 index)
+  {
+    if (m_portalGraph == nullptr)
+    {
+      m_renderObjects[index].portalCell = PortalGraph::InvalidCell;
+      return;
+    }
+
+    const float radius = m_bounds.radius[index];
+    AABB box;
+    box.min = Vec3(m_bounds.centerX[index] - radius, m_bounds.centerY[index] - radius, m_bounds.centerZ[index] - radius);
+    box.max = Vec3(m_bounds.centerX[index] + radius, m_bounds.centerY[index] + radius, m_bounds.centerZ[index] + radius);
+    m_renderObjects[index].portalCell = m_portalGraph->FindCell(box);
+  }
+
+  bool SceneRenderer::RenderOccluders(const Camera& camera)
+  {
+    m_occlusionBuffer.Clear();
+
+    const Mat viewProjection = DirectX::XMLoadFloat4x4(&camera.GetViewProjectionMatrix());
+    const uint32 visibleCount = m_frustumCuller.GetVisibleCount();
+    const uint32* visibleIndices = m_frustumCuller.GetVisibleIndices();
+
+    for (uint32 i = 0; i < visibleCount; ++i)
+    {
+      const RenderObject& object = m_renderObjects[visibleIndices[i]];
+      if (!object.occluder || IsHiddenByVisibility(visibleIndices[i]))
+        continue;
+
+      const Mesh* mesh = m_scene->m_meshes.Get(object.mesh);
+      Mat4x4 modelViewProjection;
+      DirectX::XMStoreFloat4x4(&modelViewProjection, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&m_scene->m_transforms.GetWorldMatrix(object.transform)), viewProjection));
+      m_occlusionBuffer.RenderTriangles(mesh->GetVertices()->position, sizeof(Vertex), mesh->GetIndices(), mesh->GetIndexCount() / 3, modelViewProjection);
+    }
+
+    if (m_occlusionBuffer.GetTriangleCount() == 0)
+      return false;
+
+    m_occlusionBuffer.Rasterize(m_scene->m_jobSystem.get());
+    return true;
+  }
+
+  MaterialHandle SceneRenderer::GetMaterialForEntityType(EntityType type)
   {
     if (type == EntityType::Primitive)
     {
@@ -104,7 +804,7 @@ namespace WoohooDX12
     else
     {
       assert(false && "Unkown entity type!");
-      return nullptr;
+      return MaterialHandle();
     }
   }
 }
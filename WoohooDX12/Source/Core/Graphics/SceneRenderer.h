@@ -1,10 +1,14 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 #include "Scene/Scene.h"
 #include "Renderer.h"
 #include "Utils.h"
+#include "Memory/HandlePool.h"
+#include "Scene/Culling/FrustumCulling.h"
+#include "Scene/Culling/OcclusionCulling.h"
+#include "Scene/Visibility/PortalCuller.h"
+#include "Geometry/StaticBatcher.h"
 
 namespace WoohooDX12
 {
@@ -19,22 +23,195 @@ namespace WoohooDX12
     SceneRenderer();
     ~SceneRenderer();
 
-    inline int SetScene(std::shared_ptr<Scene> scene) { ReturnIfFailed(UnInit()); m_scene = scene; return 0; }
+    // Only the render objects are rebuilt, the renderer and the materials stay initialized
+    int SetScene(std::shared_ptr<Scene> scene);
     int Init(std::shared_ptr<Renderer> renderer, uint32 width, uint32 height32, HWND hwnd);
     int UnInit();
     int Resize(uint32 width, uint32 height);
 
     int Render();
 
+    inline void SetOcclusionCulling(bool enabled) { m_occlusionCulling = enabled; }
+    inline void SetPVSCulling(bool enabled) { m_pvsCulling = enabled; }
+    inline void SetPortalCulling(bool enabled) { m_portalCulling = enabled; }
+    // Without instancing every object is a draw
+    inline void SetInstancing(bool enabled) { m_instancing = enabled; }
+    // Frustum culling and draw submission on the GPU, the occlusion buffer is not used
+    inline void SetGPUDriven(bool enabled) { m_gpuDriven = enabled; }
+    // Meshes with levels of detail are drawn at the coarsest level whose error stays under the threshold on screen
+    inline void SetLODSelection(bool enabled) { m_lodSelection = enabled; }
+    inline void SetLODThreshold(float pixels) { m_lodThresholdPixels = pixels; }
+    // Fraction of the threshold an error has to cross before the level changes
+    inline void SetLODHysteresis(float hysteresis) { m_lodHysteresis = hysteresis; }
+    // Small static meshes are merged per material at load, see StaticBatcher. Applied when the render objects are built, the
+    // batches are drawn with the colours of their objects.
+    inline void SetStaticBatching(bool enabled) { m_staticBatching = enabled; }
+    inline uint32 GetDrawCallCount() const { return m_drawCallCount; }
+    // Triangles of the submitted draws, before the GPU culling of the GPU-driven path
+    inline uint32 GetTriangleCount() const { return m_triangleCount; }
+    inline const PortalCullStats& GetPortalCullStats() const { return m_portalCuller.GetStats(); }
+
+    // Cost of applying the scene journal in the last frame
+    struct SyncStats
+    {
+      uint32 changeCount = 0;
+      uint32 uploadCount = 0;
+      float milliseconds = 0.0f;
+
+      inline float GetMicrosecondsPerChange() const { return changeCount > 0 ? milliseconds * 1000.0f / changeCount : 0.0f; }
+    };
+    inline const SyncStats& GetSyncStats() const { return m_syncStats; }
+    // Batched objects are not render objects
+    inline uint32 GetRenderObjectCount() const { return (uint32)m_renderObjects.size(); }
+    inline uint32 GetStaticBatchCount() const { return (uint32)m_batchMeshes.size(); }
+    // Meshes with GPU buffers, objects sharing a mesh share its buffers
+    uint32 GetResidentMeshCount() const;
+
+  private:
+    struct RenderObject
+    {
+      Entity entity;
+      MeshHandle mesh;
+      MaterialHandle material;
+      TransformHandle transform;
+      Vec4 color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+      Vec3 localCenter = ZeroVector; // Bounding sphere of the mesh
+      float localRadius = 0.0f;
+      bool occluder = false;
+      uint32 pvsObject = PotentiallyVisibleSet::InvalidObject; // Not baked, always potentially visible
+      uint32 portalCell = PortalGraph::InvalidCell; // Cell containing the bounds, objects outside of the cells are not portal culled
+      uint32 lod = 0; // Level of detail of the last frame the object was drawn
+    };
+
+    // An object merged into a static batch
+    struct BatchedObject
+    {
+      Entity entity;
+      uint32 pvsObject = PotentiallyVisibleSet::InvalidObject;
+      bool hidden = false; // Removed or changed since the batch was built
+    };
+
   private:
-    std::shared_ptr<Material> GetMaterialForEntityType(EntityType type);
+    static constexpr uint32 InvalidObject = 0xFFFFFFFF;
+    // Meshes up to this many vertices are props worth batching
+    static constexpr uint32 MaxStaticBatchSourceVertices = 1024;
+
+    MaterialHandle GetMaterialForEntityType(EntityType type);
+
+    // Render objects of the scene
+    int BuildRenderObjects();
+    void ReleaseRenderObjects();
+    int ApplySceneChanges();
+    int UploadPendingMeshes();
+
+    void AddRenderObject(Entity entity);
+    void RemoveRenderObject(uint32 index);
+    void RefreshRenderObject(uint32 index, bool meshChanged);
+    uint32 FindRenderObject(Entity entity) const;
+    void UpdateBounds(uint32 index);
+
+    // Moves the small static render objects into batches, they are not render objects anymore
+    int BuildStaticBatches();
+    void ReleaseStaticBatches();
+    // Hides the piece of a batched entity, returns false if the entity is not batched
+    bool UnbatchEntity(Entity entity);
+    inline bool IsPieceVisible(uint32 piece) const
+    {
+      const BatchedObject& object = m_batchedObjects[piece];
+      return !object.hidden && !(m_testPVS && object.pvsObject < m_pvsObjectCount && !PotentiallyVisibleSet::IsVisible(m_pvsBits.data(), object.pvsObject));
+    }
+    // Draw ranges of the visible pieces of a batch in its mesh's index buffer, returns the range count
+    uint32 GetBatchRanges(uint32 batch, IndexChunk* ranges) const;
+    // Draws the ranges of the visible pieces of the batches in the frustum
+    int RenderStaticBatches(const Camera& camera, bool testOcclusion, uint32& drawCount);
+
+    // GPU buffers of a mesh live while a render object uses it
+    void AcquireMesh(MeshHandle mesh);
+    void ReleaseMesh(MeshHandle mesh);
+    // Decompresses the visibility of the camera's cell when it changes, returns false if nothing is hidden
+    bool UpdatePVS(const Camera& camera);
+    // Walks the portal graph from the camera's cell, returns false if nothing is hidden
+    bool UpdatePortals(const Camera& camera);
+    void UpdatePortalCell(uint32 index);
+    // Baked and portal visibility of the frame, tested after the frustum
+    inline bool IsHiddenByVisibility(uint32 index) const
+    {
+      const RenderObject& object = m_renderObjects[index];
+      if (m_testPVS && object.pvsObject < m_pvsObjectCount && !PotentiallyVisibleSet::IsVisible(m_pvsBits.data(), object.pvsObject))
+        return true;
+
+      return m_testPortals && !m_portalCuller.IsSphereVisible(object.portalCell, Vec3(m_bounds.centerX[index], m_bounds.centerY[index], m_bounds.centerZ[index]),
+        m_bounds.radius[index]);
+    }
+    // Picks the level of detail of the object for the frame from its distance to the camera
+    uint32 SelectLOD(uint32 index, const Vec3& cameraPosition, float projectionScale);
+    // Rasterizes the visible occluders, returns false if there is none
+    bool RenderOccluders(const Camera& camera);
+    // Streams every object left by the baked and portal visibility to the GPU-driven path
+    int RenderGPUDriven(const Camera& camera);
 
   private:
     std::shared_ptr<Renderer> m_renderer = nullptr;
     std::shared_ptr<Scene> m_scene = nullptr;
     bool m_initialized = false;
 
-    std::shared_ptr<Material> m_defaultMaterial = nullptr;
-    std::unordered_map<std::shared_ptr<Material>, std::vector<std::shared_ptr<Mesh>>> m_renderJobs;
+    HandlePool<Material> m_materials;
+    MaterialHandle m_defaultMaterial;
+    // Meshes are owned by the scene, render objects only hold their handles.
+    // Unordered, removal swaps the last object into the hole. Draws are sorted by material after culling.
+    std::vector<RenderObject> m_renderObjects;
+    std::vector<uint32> m_entityToObject; // Indexed by entity index
+    std::vector<uint32> m_meshUsers; // Render objects using a mesh, indexed by mesh handle index
+    std::vector<MeshHandle> m_pendingUploads; // Uploaded at the end of the sync
+    std::vector<Mesh*> m_uploadMeshes;
+    SyncStats m_syncStats;
+
+    // World space bounds of the render objects, same order
+    BoundingSphereArray m_bounds;
+    FrustumCuller m_frustumCuller;
+
+    // Low resolution, a quarter of the screen on each axis
+    static constexpr uint32 OcclusionBufferDivider = 4;
+    MaskedOcclusionBuffer m_occlusionBuffer;
+    bool m_occlusionCulling = true;
+
+    // Visibility of the camera's cell in the scene's potentially visible set
+    const PotentiallyVisibleSet* m_pvs = nullptr;
+    uint32 m_pvsCell = PotentiallyVisibleSet::InvalidCell;
+    uint32 m_pvsObjectCount = 0;
+    std::vector<uint32> m_pvsBits;
+    bool m_pvsCulling = true;
+    bool m_testPVS = false;
+
+    // Cells of the scene's portal graph seen from the camera
+    const PortalGraph* m_portalGraph = nullptr;
+    PortalCuller m_portalCuller;
+    bool m_portalCulling = true;
+    bool m_testPortals = false;
+
+    // Draws sharing a mesh and a material are one instanced draw
+    InstanceBatcher m_instanceBatcher;
+    bool m_instancing = true;
+    uint32 m_drawCallCount = 0;
+    uint32 m_triangleCount = 0;
+
+    bool m_gpuDriven = false;
+
+    // Static batches, their meshes are built from the scene's meshes and owned here. Batch i is m_batchMeshes[i].
+    StaticBatcher m_staticBatcher;
+    std::vector<Mesh> m_batchMeshes;
+    std::vector<MaterialHandle> m_batchMaterials;
+    std::vector<BatchedObject> m_batchedObjects; // Per piece of the batcher
+    std::vector<uint32> m_entityToPiece; // Indexed by entity index
+    BoundingSphereArray m_batchBounds;
+    FrustumCuller m_batchCuller;
+    std::vector<IndexChunk> m_batchRanges; // Room for the ranges of the largest batch
+    bool m_staticBatching = false;
+
+    // Screen-space error of the levels of detail
+    uint32 m_viewportHeight = 0;
+    float m_lodThresholdPixels = 1.0f;
+    float m_lodHysteresis = 0.25f;
+    bool m_lodSelection = true;
   };
 }
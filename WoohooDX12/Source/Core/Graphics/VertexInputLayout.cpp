@@ -0,0 +1,51 @@
+#include "VertexInputLayout.h"
+
+#include <cassert>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    const char* SemanticNames[(uint32)VertexAttribute::Count] = { "POSITION", "NORMAL", "TANGENT", "TEXCOORD", "COLOR" };
+  }
+
+  void VertexInputLayout::Build(const VertexLayout& layout)
+  {
+    m_elementCount = 0;
+    for (uint32 i = 0; i < (uint32)VertexAttribute::Count; ++i)
+    {
+      const VertexAttribute attribute = (VertexAttribute)i;
+      if (!layout.Has(attribute))
+        continue;
+
+      D3D12_INPUT_ELEMENT_DESC& element = m_elements[m_elementCount++];
+      element.SemanticName = SemanticNames[i];
+      element.SemanticIndex = 0;
+      element.Format = GetFormat(attribute, layout.IsCompact(attribute));
+      element.InputSlot = 0;
+      element.AlignedByteOffset = layout.offsets[i];
+      element.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+      element.InstanceDataStepRate = 0;
+    }
+  }
+
+  void VertexInputLayout::Append(const D3D12_INPUT_ELEMENT_DESC* elements, uint32 count)
+  {
+    assert(m_elementCount + count <= MaxElementCount && "Too many input elements!");
+    for (uint32 i = 0; i < count; ++i)
+      m_elements[m_elementCount++] = elements[i];
+  }
+
+  DXGI_FORMAT VertexInputLayout::GetFormat(VertexAttribute attribute, bool compact)
+  {
+    switch (attribute)
+    {
+    case VertexAttribute::Position: return compact ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+    case VertexAttribute::Normal: return compact ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+    case VertexAttribute::Tangent: return compact ? DXGI_FORMAT_R10G10B10A2_UNORM : DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case VertexAttribute::UV: return compact ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT;
+    case VertexAttribute::Color: return compact ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+    default: return DXGI_FORMAT_UNKNOWN;
+    }
+  }
+}
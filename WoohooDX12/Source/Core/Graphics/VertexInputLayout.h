@@ -0,0 +1,31 @@
+#pragma once
+
+#include <d3d12.h>
+#include "Types.h"
+#include "Geometry/VertexQuantization.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Input layout generated from a vertex layout, so the pipelines read the meshes in the format they are uploaded in.
+  * The vertex attributes are in slot 0 with the semantics POSITION, NORMAL, TANGENT, TEXCOORD and COLOR. The input assembler
+  * expands the compact formats to floats: positions to [0, 1] of the bounds (the world matrix dequantizes them, see
+  * VertexQuantizer::FoldDequantization), colours and UVs to their values, normals and tangents to the octahedral square.
+  */
+  class VertexInputLayout
+  {
+  public:
+    static constexpr uint32 MaxElementCount = 16;
+
+    void Build(const VertexLayout& layout);
+    // Elements of the other slots, after the vertex attributes
+    void Append(const D3D12_INPUT_ELEMENT_DESC* elements, uint32 count);
+
+    static DXGI_FORMAT GetFormat(VertexAttribute attribute, bool compact);
+    inline D3D12_INPUT_LAYOUT_DESC GetDesc() const { return { m_elements, m_elementCount }; }
+
+  private:
+    D3D12_INPUT_ELEMENT_DESC m_elements[MaxElementCount] = {};
+    uint32 m_elementCount = 0;
+  };
+}
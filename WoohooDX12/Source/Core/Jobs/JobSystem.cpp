@@ -0,0 +1,111 @@
+#include "JobSystem.h"
+
+namespace WoohooDX12
+{
+  JobSystem::JobSystem(uint32 workerCount)
+  {
+    if (workerCount == 0)
+    {
+      const uint32 hardwareThreads = std::thread::hardware_concurrency();
+      workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    m_workers.reserve(workerCount);
+    for (uint32 i = 0; i < workerCount; ++i)
+      m_workers.emplace_back(&JobSystem::WorkerMain, this);
+  }
+
+  JobSystem::~JobSystem()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (std::thread& worker : m_workers)
+      worker.join();
+    m_workers.clear();
+  }
+
+  void JobSystem::Submit(JobFunction function, void* data, uint32 begin, uint32 end, JobCounter* counter)
+  {
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+
+    if (counter)
+      counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back(job);
+    }
+    m_jobAvailable.notify_one();
+  }
+
+  void JobSystem::Wait(JobCounter& counter)
+  {
+    while (counter.pending.load(std::memory_order_acquire) > 0)
+    {
+      if (TryRunJob())
+        continue;
+
+      // Nothing to help with, sleep until a job finishes somewhere
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_jobFinished.wait(lock, [&] { return counter.pending.load(std::memory_order_acquire) == 0 || !m_queue.empty(); });
+    }
+  }
+
+  void JobSystem::WorkerMain()
+  {
+    while (true)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobAvailable.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+        if (m_quit && m_queue.empty())
+          return;
+
+        job = m_queue.front();
+        m_queue.pop_front();
+      }
+
+      Run(job);
+    }
+  }
+
+  bool JobSystem::TryRunJob()
+  {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_queue.empty())
+        return false;
+
+      job = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    Run(job);
+    return true;
+  }
+
+  void JobSystem::Run(const Job& job)
+  {
+    job.function(job.data, job.begin, job.end);
+
+    if (job.counter)
+    {
+      job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+
+      // Take the lock so a waiter can not miss the notification between its check and its wait
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobFinished.notify_all();
+    }
+  }
+}
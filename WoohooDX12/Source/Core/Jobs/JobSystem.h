@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  // Number of jobs still running, a job decrements it when it finishes
+  struct JobCounter
+  {
+    std::atomic<uint32> pending = 0;
+  };
+
+  // Jobs are plain function pointers over a range, so submitting work does not allocate per job
+  typedef void (*JobFunction)(void* data, uint32 begin, uint32 end);
+
+  /*
+  * Fixed pool of worker threads pulling from a shared queue.
+  * Wait() executes queued jobs on the calling thread until the counter reaches zero, so waiting threads help instead of sleeping.
+  */
+  class JobSystem
+  {
+  public:
+    // 0 workers means one per hardware thread except the calling one
+    explicit JobSystem(uint32 workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void Submit(JobFunction function, void* data, uint32 begin, uint32 end, JobCounter* counter);
+    void Wait(JobCounter& counter);
+
+    // Calls func(begin, end) over [0, count) split into batches and waits for all of them
+    template<typename Func>
+    void ParallelFor(uint32 count, uint32 batchSize, Func&& func);
+
+    inline uint32 GetWorkerCount() const { return (uint32)m_workers.size(); }
+
+  private:
+    struct Job
+    {
+      JobFunction function = nullptr;
+      void* data = nullptr;
+      uint32 begin = 0;
+      uint32 end = 0;
+      JobCounter* counter = nullptr;
+    };
+
+    void WorkerMain();
+    bool TryRunJob();
+    void Run(const Job& job);
+
+  private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_jobFinished;
+    std::deque<Job> m_queue;
+    bool m_quit = false;
+  };
+
+  template<typename Func>
+  void JobSystem::ParallelFor(uint32 count, uint32 batchSize, Func&& func)
+  {
+    if (count == 0)
+      return;
+
+    if (batchSize == 0)
+      batchSize = 1;
+
+    typedef typename std::remove_reference<Func>::type FuncType;
+    JobFunction trampoline = [](void* data, uint32 begin, uint32 end) { (*static_cast<FuncType*>(data))(begin, end); };
+
+    JobCounter counter;
+    for (uint32 begin = 0; begin < count; begin += batchSize)
+    {
+      const uint32 end = begin + batchSize < count ? begin + batchSize : count;
+      Submit(trampoline, (void*)&func, begin, end, &counter);
+    }
+    Wait(counter);
+  }
+}
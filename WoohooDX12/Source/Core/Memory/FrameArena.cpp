@@ -0,0 +1,125 @@
+#include "FrameArena.h"
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+namespace WoohooDX12
+{
+  static constexpr size_t PageAlignment = 64; // cache line
+
+  // Registry of the per-thread arenas so they can all be reset at the end of the frame
+  static std::mutex g_threadArenasMutex;
+  static std::vector<FrameArena*> g_threadArenas;
+
+  namespace
+  {
+    struct ThreadArenaHolder
+    {
+      ThreadArenaHolder()
+      {
+        std::lock_guard<std::mutex> lock(g_threadArenasMutex);
+        g_threadArenas.push_back(&arena);
+      }
+
+      ~ThreadArenaHolder()
+      {
+        std::lock_guard<std::mutex> lock(g_threadArenasMutex);
+        g_threadArenas.erase(std::remove(g_threadArenas.begin(), g_threadArenas.end(), &arena), g_threadArenas.end());
+      }
+
+      FrameArena arena;
+    };
+  }
+
+  FrameArena::FrameArena(size_t pageSize)
+    : m_pageSize(pageSize)
+  {
+    AddPage(m_pageSize);
+  }
+
+  FrameArena::~FrameArena()
+  {
+    FreePages();
+  }
+
+  void* FrameArena::Allocate(size_t size, size_t alignment)
+  {
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+    while (true)
+    {
+      Page& page = m_pages[m_currentPage];
+      const size_t alignedOffset = (m_offset + alignment - 1) & ~(alignment - 1);
+      if (alignedOffset + size <= page.size)
+      {
+        m_usedBytes += (alignedOffset + size) - m_offset;
+        m_peakBytes = std::max(m_peakBytes, m_usedBytes);
+        m_offset = alignedOffset + size;
+        return page.memory + alignedOffset;
+      }
+
+      // Move to the next page, or chain a new one if this frame needs more memory than ever before
+      m_currentPage++;
+      m_offset = 0;
+      if (m_currentPage == m_pages.size())
+        AddPage(size + alignment);
+    }
+  }
+
+  void FrameArena::Reset()
+  {
+    // Merge the overflow pages into a single page, so the next frame does not need to chain pages
+    if (m_pages.size() > 1)
+    {
+      const size_t capacity = GetCapacity();
+      FreePages();
+      AddPage(capacity);
+    }
+
+    m_currentPage = 0;
+    m_offset = 0;
+    m_usedBytes = 0;
+  }
+
+  size_t FrameArena::GetCapacity() const
+  {
+    size_t capacity = 0;
+    for (const Page& page : m_pages)
+      capacity += page.size;
+
+    return capacity;
+  }
+
+  FrameArena& FrameArena::GetThreadArena()
+  {
+    thread_local ThreadArenaHolder holder;
+    return holder.arena;
+  }
+
+  void FrameArena::ResetThreadArenas()
+  {
+    std::lock_guard<std::mutex> lock(g_threadArenasMutex);
+    for (FrameArena* arena : g_threadArenas)
+      arena->Reset();
+  }
+
+  void FrameArena::AddPage(size_t minSize)
+  {
+    Page page;
+    page.size = std::max(minSize, m_pageSize);
+    page.memory = static_cast<uint8*>(::operator new(page.size, std::align_val_t(PageAlignment)));
+    m_pages.push_back(page);
+  }
+
+  void FrameArena::FreePages()
+  {
+    for (Page& page : m_pages)
+    {
+      ::operator delete(page.memory, std::align_val_t(PageAlignment));
+      page.memory = nullptr;
+    }
+    m_pages.clear();
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Bump allocator for transient frame data (draw lists, visibility lists, sort buffers, etc.).
+  * Memory is never freed per allocation, the whole arena is reset at the end of the frame.
+  * When a frame overflows the first page, extra pages are chained and on the next reset they are merged
+  * into a single page big enough for the peak usage, so steady state frames touch exactly one page.
+  */
+  class FrameArena
+  {
+  public:
+    static constexpr size_t DefaultPageSize = 256 * 1024;
+
+    explicit FrameArena(size_t pageSize = DefaultPageSize);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void Reset();
+
+    template<typename T>
+    inline T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+    inline size_t GetUsedBytes() const { return m_usedBytes; }
+    inline size_t GetPeakBytes() const { return m_peakBytes; }
+    size_t GetCapacity() const;
+
+    // Arena owned by the calling thread. Created on first use and reset with ResetThreadArenas().
+    static FrameArena& GetThreadArena();
+    // Should be called once per frame, when no other thread is allocating from its arena.
+    static void ResetThreadArenas();
+
+  private:
+    struct Page
+    {
+      uint8* memory = nullptr;
+      size_t size = 0;
+    };
+
+    void AddPage(size_t minSize);
+    void FreePages();
+
+  private:
+    std::vector<Page> m_pages;
+    size_t m_pageSize = DefaultPageSize;
+    size_t m_currentPage = 0;
+    size_t m_offset = 0;
+
+    size_t m_usedBytes = 0;
+    size_t m_peakBytes = 0;
+  };
+
+  // STL compatible allocator that allocates from a FrameArena. Deallocation is a no-op.
+  template<typename T>
+  class FrameAllocator
+  {
+  public:
+    typedef T value_type;
+
+    FrameAllocator() : m_arena(&FrameArena::GetThreadArena()) {}
+    explicit FrameAllocator(FrameArena& arena) : m_arena(&arena) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : m_arena(other.m_arena) {}
+
+    inline T* allocate(size_t count) { return m_arena->AllocateArray<T>(count); }
+    inline void deallocate(T*, size_t) {}
+
+    template<typename U>
+    inline bool operator==(const FrameAllocator<U>& other) const { return m_arena == other.m_arena; }
+    template<typename U>
+    inline bool operator!=(const FrameAllocator<U>& other) const { return m_arena != other.m_arena; }
+
+  private:
+    template<typename U>
+    friend class FrameAllocator;
+
+    FrameArena* m_arena = nullptr;
+  };
+
+  template<typename T>
+  using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
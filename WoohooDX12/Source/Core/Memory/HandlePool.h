@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Types.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Generational handle to an object living in a HandlePool<T>.
+  * A handle becomes stale when its object is destroyed, the slot generation is bumped so the old handle does not resolve
+  * to a new object that reuses the same slot.
+  */
+  template<typename T>
+  struct Handle
+  {
+    static constexpr uint32 InvalidIndex = 0xFFFFFFFF;
+
+    uint32 index = InvalidIndex;
+    uint32 generation = 0;
+
+    inline bool IsNull() const { return index == InvalidIndex; }
+    inline bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+    inline bool operator!=(const Handle& other) const { return !(*this == other); }
+  };
+
+  /*
+  * Dense pool of objects addressed by generational handles.
+  * - Objects are stored contiguously, so iterating the pool walks live objects in memory order.
+  * - Create and Destroy are O(1). Destroy moves the last object into the hole, so raw pointers returned by Get()
+  *   are only valid until the next Create/Destroy call. Keep handles, not pointers.
+  */
+  template<typename T>
+  class HandlePool
+  {
+  public:
+    typedef typename std::vector<T>::iterator Iterator;
+    typedef typename std::vector<T>::const_iterator ConstIterator;
+
+    HandlePool() {}
+    ~HandlePool() { Clear(); }
+
+    template<typename... Args>
+    Handle<T> Create(Args&&... args)
+    {
+      uint32 slotIndex = m_freeSlot;
+      if (slotIndex != Handle<T>::InvalidIndex)
+      {
+        m_freeSlot = m_slots[slotIndex].denseIndex;
+      }
+      else
+      {
+        slotIndex = (uint32)m_slots.size();
+        m_slots.push_back(Slot());
+      }
+
+      Slot& slot = m_slots[slotIndex];
+      slot.denseIndex = (uint32)m_dense.size();
+      m_dense.emplace_back(std::forward<Args>(args)...);
+      m_denseToSlot.push_back(slotIndex);
+
+      Handle<T> handle;
+      handle.index = slotIndex;
+      handle.generation = slot.generation;
+      return handle;
+    }
+
+    bool Destroy(Handle<T> handle)
+    {
+      if (!IsValid(handle))
+        return false;
+
+      Slot& slot = m_slots[handle.index];
+      const uint32 denseIndex = slot.denseIndex;
+      const uint32 lastIndex = (uint32)m_dense.size() - 1;
+
+      // Swap-remove to keep the storage dense
+      if (denseIndex != lastIndex)
+      {
+        m_dense[denseIndex] = std::move(m_dense[lastIndex]);
+        m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+        m_slots[m_denseToSlot[denseIndex]].denseIndex = denseIndex;
+      }
+      m_dense.pop_back();
+      m_denseToSlot.pop_back();
+
+      // Invalidate the outstanding handles and push the slot to the free list
+      slot.generation++;
+      slot.denseIndex = m_freeSlot;
+      m_freeSlot = handle.index;
+
+      return true;
+    }
+
+    inline bool IsValid(Handle<T> handle) const
+    {
+      return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+    }
+
+    // Returns nullptr for stale or null handles
+    inline T* Get(Handle<T> handle) { return IsValid(handle) ? &m_dense[m_slots[handle.index].denseIndex] : nullptr; }
+    inline const T* Get(Handle<T> handle) const { return IsValid(handle) ? &m_dense[m_slots[handle.index].denseIndex] : nullptr; }
+
+    // Handle of the object at the given position of the dense storage
+    inline Handle<T> GetHandleAt(uint32 denseIndex) const
+    {
+      assert(denseIndex < m_dense.size() && "Dense index is out of range!");
+      Handle<T> handle;
+      handle.index = m_denseToSlot[denseIndex];
+      handle.generation = m_slots[handle.index].generation;
+      return handle;
+    }
+
+    inline T* GetData() { return m_dense.data(); }
+    inline const T* GetData() const { return m_dense.data(); }
+    inline uint32 Size() const { return (uint32)m_dense.size(); }
+    inline bool IsEmpty() const { return m_dense.empty(); }
+
+    void Reserve(uint32 count)
+    {
+      m_dense.reserve(count);
+      m_denseToSlot.reserve(count);
+      m_slots.reserve(count);
+    }
+
+    void Clear()
+    {
+      // Bump every generation so no handle survives a clear
+      m_freeSlot = Handle<T>::InvalidIndex;
+      for (uint32 i = 0; i < (uint32)m_slots.size(); ++i)
+      {
+        m_slots[i].generation++;
+        m_slots[i].denseIndex = m_freeSlot;
+        m_freeSlot = i;
+      }
+      m_dense.clear();
+      m_denseToSlot.clear();
+    }
+
+    inline Iterator begin() { return m_dense.begin(); }
+    inline Iterator end() { return m_dense.end(); }
+    inline ConstIterator begin() const { return m_dense.begin(); }
+    inline ConstIterator end() const { return m_dense.end(); }
+
+  private:
+    struct Slot
+    {
+      uint32 denseIndex = Handle<T>::InvalidIndex; // Next free slot when the slot is not used
+      uint32 generation = 1; // Starts at 1 so a zero initialized handle never resolves
+    };
+
+  private:
+    std::vector<T> m_dense;
+    std::vector<uint32> m_denseToSlot;
+    std::vector<Slot> m_slots;
+    uint32 m_freeSlot = Handle<T>::InvalidIndex;
+  };
+}
+
+namespace std
+{
+  template<typename T>
+  struct hash<WoohooDX12::Handle<T>>
+  {
+    size_t operator()(const WoohooDX12::Handle<T>& handle) const
+    {
+      return std::hash<uint64>()(((uint64)handle.generation << 32) | handle.index);
+    }
+  };
+}
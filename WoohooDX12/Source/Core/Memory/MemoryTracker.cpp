@@ -0,0 +1,223 @@
+#include "MemoryTracker.h"
+
+#ifdef WOH_MEMORY_TRACKING
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "Utils.h"
+
+namespace WoohooDX12
+{
+  static constexpr uint32 TagCount = (uint32)MemoryTag::Count;
+
+  // Constant initialized, so they are valid for the allocations made during static initialization too
+  static std::atomic<uint64> g_currentBytes[TagCount] = {};
+  static std::atomic<uint64> g_peakBytes[TagCount] = {};
+  static std::atomic<uint64> g_totalAllocations[TagCount] = {};
+  static std::atomic<uint64> g_frameAllocations[TagCount] = {};
+  static std::atomic<uint64> g_frameBytes[TagCount] = {};
+  static std::atomic<bool> g_assertNoFrameAllocations = false;
+  static std::atomic<uint64> g_endedFrameCount = 0;
+  static std::atomic<uint64> g_steadyStateFrame = UINT64_MAX; // First frame checked by SetAssertNoFrameAllocationsAfter
+  static std::atomic<uint64> g_steadyStateViolations = 0;
+
+  static thread_local MemoryTag g_threadTag = MemoryTag::Untagged;
+
+  static constexpr const char* tagNames[TagCount] =
+  {
+    "Untagged",
+    "Scene",
+    "Render",
+    "Assets",
+    "UI"
+  };
+
+  const char* MemoryTracker::GetTagName(MemoryTag tag)
+  {
+    return tagNames[(uint32)tag];
+  }
+
+  MemoryTag MemoryTracker::GetThreadTag()
+  {
+    return g_threadTag;
+  }
+
+  void MemoryTracker::SetThreadTag(MemoryTag tag)
+  {
+    g_threadTag = tag;
+  }
+
+  void MemoryTracker::BeginFrame()
+  {
+    for (uint32 i = 0; i < TagCount; ++i)
+    {
+      g_frameAllocations[i].store(0, std::memory_order_relaxed);
+      g_frameBytes[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void MemoryTracker::EndFrame()
+  {
+    const uint64 frame = g_endedFrameCount.fetch_add(1, std::memory_order_relaxed);
+    if (!g_assertNoFrameAllocations.load(std::memory_order_relaxed) && frame < g_steadyStateFrame.load(std::memory_order_relaxed))
+      return;
+
+    const uint64 frameAllocations = GetFrameAllocationCount();
+    if (frameAllocations > 0)
+    {
+      g_steadyStateViolations.fetch_add(1, std::memory_order_relaxed);
+      Log("Heap allocation in a steady state frame! Count: " + std::to_string(frameAllocations), LogType::LT_ERROR);
+      Report();
+      assert(false && "Heap allocation in a steady state frame!");
+    }
+  }
+
+  void MemoryTracker::SetAssertNoFrameAllocations(bool enabled)
+  {
+    g_assertNoFrameAllocations.store(enabled, std::memory_order_relaxed);
+  }
+
+  void MemoryTracker::SetAssertNoFrameAllocationsAfter(uint32 warmupFrames)
+  {
+    g_steadyStateFrame.store(g_endedFrameCount.load(std::memory_order_relaxed) + warmupFrames, std::memory_order_relaxed);
+  }
+
+  uint64 MemoryTracker::GetSteadyStateViolationCount()
+  {
+    return g_steadyStateViolations.load(std::memory_order_relaxed);
+  }
+
+  MemoryTagStats MemoryTracker::GetStats(MemoryTag tag)
+  {
+    const uint32 i = (uint32)tag;
+
+    MemoryTagStats stats;
+    stats.currentBytes = g_currentBytes[i].load(std::memory_order_relaxed);
+    stats.peakBytes = g_peakBytes[i].load(std::memory_order_relaxed);
+    stats.totalAllocations = g_totalAllocations[i].load(std::memory_order_relaxed);
+    stats.frameAllocations = g_frameAllocations[i].load(std::memory_order_relaxed);
+    stats.frameBytes = g_frameBytes[i].load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  uint64 MemoryTracker::GetFrameAllocationCount()
+  {
+    uint64 count = 0;
+    for (uint32 i = 0; i < TagCount; ++i)
+      count += g_frameAllocations[i].load(std::memory_order_relaxed);
+
+    return count;
+  }
+
+  void MemoryTracker::Report()
+  {
+    Log("Memory report (current / peak / allocations / frame allocations / frame bytes):", LogType::LT_INFO);
+    for (uint32 i = 0; i < TagCount; ++i)
+    {
+      const MemoryTagStats stats = GetStats((MemoryTag)i);
+
+      char line[256];
+      snprintf(line, sizeof(line), "  %-10s %12llu B / %12llu B / %10llu / %8llu / %10llu B", tagNames[i],
+        (unsigned long long)stats.currentBytes, (unsigned long long)stats.peakBytes, (unsigned long long)stats.totalAllocations,
+        (unsigned long long)stats.frameAllocations, (unsigned long long)stats.frameBytes);
+      Log(line, LogType::LT_INFO);
+    }
+  }
+
+  void MemoryTracker::OnAllocate(uint64 size, MemoryTag tag)
+  {
+    const uint32 i = (uint32)tag;
+
+    const uint64 current = g_currentBytes[i].fetch_add(size, std::memory_order_relaxed) + size;
+    uint64 peak = g_peakBytes[i].load(std::memory_order_relaxed);
+    while (current > peak && !g_peakBytes[i].compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+
+    g_totalAllocations[i].fetch_add(1, std::memory_order_relaxed);
+    g_frameAllocations[i].fetch_add(1, std::memory_order_relaxed);
+    g_frameBytes[i].fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void MemoryTracker::OnFree(uint64 size, MemoryTag tag)
+  {
+    g_currentBytes[(uint32)tag].fetch_sub(size, std::memory_order_relaxed);
+  }
+
+  // Every tracked block is prefixed by a header so frees are accounted to the tag they were allocated with
+  struct AllocationHeader
+  {
+    void* rawMemory;
+    uint64 size;
+    MemoryTag tag;
+  };
+
+  static void* TrackedAllocate(size_t size, size_t alignment) noexcept
+  {
+    if (alignment < alignof(std::max_align_t))
+      alignment = alignof(std::max_align_t);
+
+    void* rawMemory = malloc(size + alignment + sizeof(AllocationHeader));
+    if (rawMemory == nullptr)
+      return nullptr;
+
+    const uintptr_t userAddress = ((uintptr_t)rawMemory + sizeof(AllocationHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(userAddress) - 1;
+    header->rawMemory = rawMemory;
+    header->size = size;
+    header->tag = g_threadTag;
+
+    MemoryTracker::OnAllocate(size, header->tag);
+
+    return reinterpret_cast<void*>(userAddress);
+  }
+
+  static void TrackedFree(void* memory) noexcept
+  {
+    if (memory == nullptr)
+      return;
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+    MemoryTracker::OnFree(header->size, header->tag);
+    free(header->rawMemory);
+  }
+
+  static void* TrackedAllocateOrThrow(size_t size, size_t alignment)
+  {
+    void* memory = TrackedAllocate(size, alignment);
+    if (memory == nullptr)
+      throw std::bad_alloc();
+
+    return memory;
+  }
+}
+
+// Global allocation functions
+void* operator new(size_t size) { return WoohooDX12::TrackedAllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return WoohooDX12::TrackedAllocateOrThrow(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return WoohooDX12::TrackedAllocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return WoohooDX12::TrackedAllocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return WoohooDX12::TrackedAllocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return WoohooDX12::TrackedAllocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return WoohooDX12::TrackedAllocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return WoohooDX12::TrackedAllocate(size, (size_t)alignment); }
+
+void operator delete(void* memory) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { WoohooDX12::TrackedFree(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { WoohooDX12::TrackedFree(memory); }
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Types.h"
+
+/*
+* Tagged heap allocation tracker.
+* When WOH_MEMORY_TRACKING is defined the global operator new/delete are replaced and every allocation is accounted
+* to the tag of the innermost WOH_MEMORY_SCOPE on the calling thread. When it is not defined the macros below are
+* empty and nothing is replaced, so the tracker costs nothing.
+*/
+
+namespace WoohooDX12
+{
+  enum class MemoryTag : uint8
+  {
+    Untagged = 0,
+    Scene,
+    Render,
+    Assets,
+    UI,
+    Count
+  };
+
+  struct MemoryTagStats
+  {
+    uint64 currentBytes = 0;
+    uint64 peakBytes = 0;
+    uint64 totalAllocations = 0;
+    uint64 frameAllocations = 0;
+    uint64 frameBytes = 0;
+  };
+
+  class MemoryTracker
+  {
+  public:
+    static const char* GetTagName(MemoryTag tag);
+
+    static MemoryTag GetThreadTag();
+    static void SetThreadTag(MemoryTag tag);
+
+    // Per-frame counters are reset by BeginFrame and checked by EndFrame
+    static void BeginFrame();
+    static void EndFrame();
+
+    // When enabled, EndFrame asserts if any heap allocation happened during the frame (steady state frames)
+    static void SetAssertNoFrameAllocations(bool enabled);
+    // Same assert once this many more frames ended, the first frames fill the pools and caches the next ones reuse
+    static void SetAssertNoFrameAllocationsAfter(uint32 warmupFrames);
+    // Frames that allocated while the assert was enabled, they are counted before asserting
+    static uint64 GetSteadyStateViolationCount();
+
+    static MemoryTagStats GetStats(MemoryTag tag);
+    static uint64 GetFrameAllocationCount();
+    static void Report();
+
+    static void OnAllocate(uint64 size, MemoryTag tag);
+    static void OnFree(uint64 size, MemoryTag tag);
+  };
+
+  class MemoryTagScope
+  {
+  public:
+    explicit MemoryTagScope(MemoryTag tag) : m_previousTag(MemoryTracker::GetThreadTag()) { MemoryTracker::SetThreadTag(tag); }
+    ~MemoryTagScope() { MemoryTracker::SetThreadTag(m_previousTag); }
+
+  private:
+    MemoryTag m_previousTag;
+  };
+}
+
+#ifdef WOH_MEMORY_TRACKING
+#define WOH_MEMORY_CONCAT_IMPL(a, b) a##b
+#define WOH_MEMORY_CONCAT(a, b) WOH_MEMORY_CONCAT_IMPL(a, b)
+#define WOH_MEMORY_SCOPE(tag) WoohooDX12::MemoryTagScope WOH_MEMORY_CONCAT(memoryTagScope, __LINE__)(tag)
+#define WOH_MEMORY_BEGIN_FRAME() WoohooDX12::MemoryTracker::BeginFrame()
+#define WOH_MEMORY_END_FRAME() WoohooDX12::MemoryTracker::EndFrame()
+#define WOH_MEMORY_REPORT() WoohooDX12::MemoryTracker::Report()
+#define WOH_MEMORY_STEADY_STATE_AFTER(frames) WoohooDX12::MemoryTracker::SetAssertNoFrameAllocationsAfter(frames)
+#else
+#define WOH_MEMORY_SCOPE(tag)
+#define WOH_MEMORY_BEGIN_FRAME()
+#define WOH_MEMORY_END_FRAME()
+#define WOH_MEMORY_REPORT()
+#define WOH_MEMORY_STEADY_STATE_AFTER(frames)
+#endif
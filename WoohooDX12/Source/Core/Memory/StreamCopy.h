@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WOH_STREAM_COPY_SSE2 1
+#endif
+
+namespace WoohooDX12
+{
+  // Below this the fence after the stores costs more than the cache they save, see Tools/StreamCopyBenchmark.cpp
+  static constexpr size_t StreamCopyMinSize = 2048;
+
+  /*
+  * Copy into write-combined memory (upload heaps) with non-temporal stores.
+  * Non-temporal stores bypass the cache and fill whole write-combining lines, so the CPU does not read the destination
+  * and the source data does not evict the cache. Falls back to memcpy for small copies and on platforms without SSE2.
+  */
+  inline void StreamCopy(void* destination, const void* source, size_t size)
+  {
+#if WOH_STREAM_COPY_SSE2
+    if (size < StreamCopyMinSize)
+    {
+      memcpy(destination, source, size);
+      return;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(destination);
+    const uint8_t* src = static_cast<const uint8_t*>(source);
+
+    // Head until the destination is 16 byte aligned
+    const size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+
+    // 64 bytes per iteration, a full write-combining line
+    size_t blocks = size / 64;
+    while (blocks--)
+    {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+      const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+      dst += 64;
+      src += 64;
+    }
+    size &= 63;
+
+    size_t vectors = size / 16;
+    while (vectors--)
+    {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+      dst += 16;
+      src += 16;
+    }
+    size &= 15;
+
+    if (size > 0)
+      memcpy(dst, src, size);
+
+    // Non-temporal stores are weakly ordered, make them visible before the GPU is signaled
+    _mm_sfence();
+#else
+    memcpy(destination, source, size);
+#endif
+  }
+}
@@ -0,0 +1,34 @@
+#include "Camera.h"
+
+namespace WoohooDX12
+{
+  Camera::Camera()
+  {
+    SetPerspective(1.0f, 1.0f, 0.1f, 1000.0f);
+    SetLookAt(Vec3(0.0f, 0.0f, 2.0f), ZeroVector);
+  }
+
+  void Camera::SetLookAt(const Vec3& position, const Vec3& target, const Vec3& up)
+  {
+    m_position = position;
+    DirectX::XMStoreFloat4x4(&m_viewMatrix, DirectX::XMMatrixLookAtLH(DirectX::XMLoadFloat3(&position), DirectX::XMLoadFloat3(&target), DirectX::XMLoadFloat3(&up)));
+    UpdateViewProjection();
+  }
+
+  void Camera::SetPerspective(float viewWidth, float viewHeight, float nearZ, float farZ)
+  {
+    DirectX::XMStoreFloat4x4(&m_projectionMatrix, DirectX::XMMatrixPerspectiveLH(viewWidth, viewHeight, nearZ, farZ));
+    UpdateViewProjection();
+  }
+
+  void Camera::SetPerspectiveFov(float fovY, float aspectRatio, float nearZ, float farZ)
+  {
+    DirectX::XMStoreFloat4x4(&m_projectionMatrix, DirectX::XMMatrixPerspectiveFovLH(fovY, aspectRatio, nearZ, farZ));
+    UpdateViewProjection();
+  }
+
+  void Camera::UpdateViewProjection()
+  {
+    DirectX::XMStoreFloat4x4(&m_viewProjectionMatrix, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&m_viewMatrix), DirectX::XMLoadFloat4x4(&m_projectionMatrix)));
+  }
+}
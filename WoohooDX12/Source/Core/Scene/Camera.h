@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Types.h"
+#include "Maths.h"
+
+namespace WoohooDX12
+{
+  // View and projection of the scene, the view projection matrix is kept up to date for culling
+  class Camera
+  {
+  public:
+    Camera();
+
+    void SetLookAt(const Vec3& position, const Vec3& target, const Vec3& up = UpVector);
+    void SetPerspective(float viewWidth, float viewHeight, float nearZ, float farZ);
+    void SetPerspectiveFov(float fovY, float aspectRatio, float nearZ, float farZ);
+
+    inline const Vec3& GetPosition() const { return m_position; }
+    inline const Mat4x4& GetViewMatrix() const { return m_viewMatrix; }
+    inline const Mat4x4& GetProjectionMatrix() const { return m_projectionMatrix; }
+    inline const Mat4x4& GetViewProjectionMatrix() const { return m_viewProjectionMatrix; }
+
+  private:
+    void UpdateViewProjection();
+
+  private:
+    Vec3 m_position = ZeroVector;
+    Mat4x4 m_viewMatrix;
+    Mat4x4 m_projectionMatrix;
+    Mat4x4 m_viewProjectionMatrix;
+  };
+}
@@ -0,0 +1,68 @@
+#include "ClusterCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include "OcclusionCulling.h"
+
+namespace WoohooDX12
+{
+  uint32 ClusterCuller::Cull(const MeshletData& data, const Mat4x4& world, const Frustum& frustum, const Vec3& cameraPosition,
+    const MaskedOcclusionBuffer* occlusion, const Mat4x4& viewProjection)
+  {
+    m_visibleClusters.clear();
+    m_stats = ClusterCullStats();
+    m_stats.clusterCount = data.GetMeshletCount();
+
+    // Cones are tested in mesh space, spheres in world space
+    const Mat worldMatrix = DirectX::XMLoadFloat4x4(&world);
+    const float scale = sqrtf(std::max({ DirectX::XMVectorGetX(DirectX::XMVector3Dot(worldMatrix.r[0], worldMatrix.r[0])),
+      DirectX::XMVectorGetX(DirectX::XMVector3Dot(worldMatrix.r[1], worldMatrix.r[1])),
+      DirectX::XMVectorGetX(DirectX::XMVector3Dot(worldMatrix.r[2], worldMatrix.r[2])) }));
+    Vec3 localCamera;
+    DirectX::XMStoreFloat3(&localCamera, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&cameraPosition),
+      DirectX::XMMatrixInverse(nullptr, worldMatrix)));
+
+    for (uint32 i = 0; i < m_stats.clusterCount; ++i)
+    {
+      const MeshletBounds& bounds = data.bounds[i];
+      const uint32 triangleCount = data.meshlets[i].triangleCount;
+      m_stats.triangleCount += triangleCount;
+
+      Vec3 center;
+      DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMVectorSet(bounds.center[0], bounds.center[1], bounds.center[2], 1.0f), worldMatrix));
+      const float radius = bounds.radius * scale;
+
+      bool inside = true;
+      for (const Vec4& plane : frustum.planes)
+        inside = inside && plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w >= -radius;
+      if (!inside)
+      {
+        m_stats.frustumCulled++;
+        continue;
+      }
+
+      if (IsBackfacing(bounds, localCamera))
+      {
+        m_stats.backfaceCulled++;
+        continue;
+      }
+
+      if (occlusion != nullptr)
+      {
+        AABB box;
+        box.min = Vec3(center.x - radius, center.y - radius, center.z - radius);
+        box.max = Vec3(center.x + radius, center.y + radius, center.z + radius);
+        if (!occlusion->TestAABB(box, viewProjection))
+        {
+          m_stats.occlusionCulled++;
+          continue;
+        }
+      }
+
+      m_visibleClusters.push_back(i);
+      m_stats.visibleTriangleCount += triangleCount;
+    }
+
+    return GetVisibleCount();
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "Types.h"
+#include "Scene/Culling/FrustumCulling.h"
+#include "Graphics/Geometry/Meshlet.h"
+
+namespace WoohooDX12
+{
+  class MaskedOcclusionBuffer;
+
+  struct ClusterCullStats
+  {
+    uint32 clusterCount = 0;
+    uint32 frustumCulled = 0;
+    uint32 backfaceCulled = 0;
+    uint32 occlusionCulled = 0;
+    uint32 triangleCount = 0;
+    uint32 visibleTriangleCount = 0;
+  };
+
+  /*
+  * CPU reference of meshlet culling, the order a cluster culling shader would follow: the bounding sphere against the frustum,
+  * the normal cone against the camera position, then the box of the sphere against the occlusion buffer.
+  * The world matrix may rotate, translate and scale uniformly, a non-uniform scale bends the normal cones.
+  */
+  class ClusterCuller
+  {
+  public:
+    // Camera position is in the space of the bounds
+    static inline bool IsBackfacing(const MeshletBounds& bounds, const Vec3& cameraPosition)
+    {
+      const float view[3] = { bounds.coneApex[0] - cameraPosition.x, bounds.coneApex[1] - cameraPosition.y, bounds.coneApex[2] - cameraPosition.z };
+      const float dot = view[0] * bounds.coneAxis[0] + view[1] * bounds.coneAxis[1] + view[2] * bounds.coneAxis[2];
+      return dot >= bounds.coneCutoff * sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+    }
+
+    // Returns the visible count, occlusion can be null. Buffers are reused between calls.
+    uint32 Cull(const MeshletData& data, const Mat4x4& world, const Frustum& frustum, const Vec3& cameraPosition,
+      const MaskedOcclusionBuffer* occlusion, const Mat4x4& viewProjection);
+
+    inline const uint32* GetVisibleClusters() const { return m_visibleClusters.data(); }
+    inline uint32 GetVisibleCount() const { return (uint32)m_visibleClusters.size(); }
+    inline const ClusterCullStats& GetStats() const { return m_stats; }
+
+  private:
+    std::vector<uint32> m_visibleClusters;
+    ClusterCullStats m_stats;
+  };
+}
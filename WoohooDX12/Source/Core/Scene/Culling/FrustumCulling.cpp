@@ -0,0 +1,209 @@
+#include "FrustumCulling.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "Jobs/JobSystem.h"
+
+namespace WoohooDX12
+{
+  Frustum Frustum::FromViewProjection(const Mat4x4& m)
+  {
+    // Gribb/Hartmann, clip = p * M so the planes are combinations of the matrix columns
+    Frustum frustum;
+    frustum.planes[0] = Vec4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+    frustum.planes[1] = Vec4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+    frustum.planes[2] = Vec4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+    frustum.planes[3] = Vec4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+    frustum.planes[4] = Vec4(m._13, m._23, m._33, m._43);
+    frustum.planes[5] = Vec4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+
+    for (Vec4& plane : frustum.planes)
+    {
+      const float invLength = 1.0f / sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+      plane.x *= invLength;
+      plane.y *= invLength;
+      plane.z *= invLength;
+      plane.w *= invLength;
+    }
+
+    return frustum;
+  }
+
+  void BoundingSphereArray::Resize(uint32 count)
+  {
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    radius.resize(count);
+  }
+
+  void BoundingSphereArray::Remove(uint32 index)
+  {
+    assert(index < Size() && "Sphere index is out of range!");
+    centerX[index] = centerX.back();
+    centerY[index] = centerY.back();
+    centerZ[index] = centerZ.back();
+    radius[index] = radius.back();
+    Resize(Size() - 1);
+  }
+
+  uint32 FrustumCuller::CullScalar(const Frustum& frustum, const BoundingSphereArray& spheres, uint32 begin, uint32 end, uint32* visibleIndices)
+  {
+    uint32 visibleCount = 0;
+    for (uint32 i = begin; i < end; ++i)
+    {
+      bool visible = true;
+      for (const Vec4& plane : frustum.planes)
+      {
+        // Same operation order as the vector paths so the results match exactly
+        float distance = plane.x * spheres.centerX[i] + plane.w;
+        distance = plane.y * spheres.centerY[i] + distance;
+        distance = plane.z * spheres.centerZ[i] + distance;
+        visible = visible && distance >= -spheres.radius[i];
+      }
+
+      visibleIndices[visibleCount] = i;
+      visibleCount += visible ? 1 : 0;
+    }
+
+    return visibleCount;
+  }
+
+  uint32 FrustumCuller::CullRange(const Frustum& frustum, const BoundingSphereArray& spheres, uint32 begin, uint32 end, uint32* visibleIndices)
+  {
+    const float* x = spheres.centerX.data();
+    const float* y = spheres.centerY.data();
+    const float* z = spheres.centerZ.data();
+    const float* r = spheres.radius.data();
+
+    uint32 visibleCount = 0;
+    uint32 i = begin;
+
+#if WOH_CULLING_AVX2
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (uint32 p = 0; p < 6; ++p)
+    {
+      planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+      planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+      planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+      planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+
+    for (; i + 8 <= end; i += 8)
+    {
+      const __m256 cx = _mm256_loadu_ps(x + i);
+      const __m256 cy = _mm256_loadu_ps(y + i);
+      const __m256 cz = _mm256_loadu_ps(z + i);
+      const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (uint32 p = 0; p < 6; ++p)
+      {
+        __m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[p], cx), planeW[p]);
+        distance = _mm256_add_ps(_mm256_mul_ps(planeY[p], cy), distance);
+        distance = _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), distance);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+      }
+
+      // Branchless compaction, every lane is written and only the visible ones advance the cursor
+      const uint32 mask = (uint32)_mm256_movemask_ps(inside);
+      for (uint32 lane = 0; lane < 8; ++lane)
+      {
+        visibleIndices[visibleCount] = i + lane;
+        visibleCount += (mask >> lane) & 1;
+      }
+    }
+#elif WOH_CULLING_SSE2
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (uint32 p = 0; p < 6; ++p)
+    {
+      planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+      planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+      planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+      planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    for (; i + 4 <= end; i += 4)
+    {
+      const __m128 cx = _mm_loadu_ps(x + i);
+      const __m128 cy = _mm_loadu_ps(y + i);
+      const __m128 cz = _mm_loadu_ps(z + i);
+      const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (uint32 p = 0; p < 6; ++p)
+      {
+        __m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], cx), planeW[p]);
+        distance = _mm_add_ps(_mm_mul_ps(planeY[p], cy), distance);
+        distance = _mm_add_ps(_mm_mul_ps(planeZ[p], cz), distance);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+      }
+
+      const uint32 mask = (uint32)_mm_movemask_ps(inside);
+      for (uint32 lane = 0; lane < 4; ++lane)
+      {
+        visibleIndices[visibleCount] = i + lane;
+        visibleCount += (mask >> lane) & 1;
+      }
+    }
+#elif WOH_CULLING_NEON
+    for (; i + 4 <= end; i += 4)
+    {
+      const float32x4_t cx = vld1q_f32(x + i);
+      const float32x4_t cy = vld1q_f32(y + i);
+      const float32x4_t cz = vld1q_f32(z + i);
+      const float32x4_t negRadius = vnegq_f32(vld1q_f32(r + i));
+
+      uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+      for (uint32 p = 0; p < 6; ++p)
+      {
+        float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(frustum.planes[p].w), cx, frustum.planes[p].x);
+        distance = vmlaq_n_f32(distance, cy, frustum.planes[p].y);
+        distance = vmlaq_n_f32(distance, cz, frustum.planes[p].z);
+        inside = vandq_u32(inside, vcgeq_f32(distance, negRadius));
+      }
+
+      uint32 lanes[4];
+      vst1q_u32(lanes, inside);
+      for (uint32 lane = 0; lane < 4; ++lane)
+      {
+        visibleIndices[visibleCount] = i + lane;
+        visibleCount += lanes[lane] & 1;
+      }
+    }
+#endif
+
+    // Tail and platforms without SIMD
+    return visibleCount + CullScalar(frustum, spheres, i, end, visibleIndices + visibleCount);
+  }
+
+  void FrustumCuller::Cull(const Frustum& frustum, const BoundingSphereArray& spheres, JobSystem* jobSystem)
+  {
+    const uint32 count = spheres.Size();
+    if (m_visibleIndices.size() < count)
+      m_visibleIndices.resize(count);
+
+    if (jobSystem == nullptr || count <= ObjectsPerJob)
+    {
+      m_visibleCount = CullRange(frustum, spheres, 0, count, m_visibleIndices.data());
+      return;
+    }
+
+    // Every job writes to the slice of its own range, the slices are packed afterwards
+    const uint32 jobCount = (count + ObjectsPerJob - 1) / ObjectsPerJob;
+    m_jobVisibleCounts.resize(jobCount);
+
+    jobSystem->ParallelFor(count, ObjectsPerJob, [&](uint32 begin, uint32 end)
+      {
+        m_jobVisibleCounts[begin / ObjectsPerJob] = CullRange(frustum, spheres, begin, end, m_visibleIndices.data() + begin);
+      });
+
+    m_visibleCount = m_jobVisibleCounts[0];
+    for (uint32 job = 1; job < jobCount; ++job)
+    {
+      memmove(m_visibleIndices.data() + m_visibleCount, m_visibleIndices.data() + job * ObjectsPerJob, m_jobVisibleCounts[job] * sizeof(uint32));
+      m_visibleCount += m_jobVisibleCounts[job];
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WOH_CULLING_AVX2 1
+#elif defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WOH_CULLING_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define WOH_CULLING_NEON 1
+#endif
+
+namespace WoohooDX12
+{
+  class JobSystem;
+
+  // Planes point inside, a point p is inside a plane when dot(normal, p) + d >= 0
+  struct Frustum
+  {
+    Vec4 planes[6]; // Left, right, bottom, top, near, far
+
+    // Extracts the planes of a D3D (0..1 depth) view projection matrix, row vector convention
+    static Frustum FromViewProjection(const Mat4x4& viewProjection);
+  };
+
+  // World space bounding spheres as SoA, one array per component so a SIMD register holds several objects
+  struct BoundingSphereArray
+  {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    void Resize(uint32 count);
+    void Remove(uint32 index); // Moves the last sphere into the hole
+    inline uint32 Size() const { return (uint32)radius.size(); }
+    inline void Set(uint32 index, const Vec3& center, float sphereRadius)
+    {
+      centerX[index] = center.x;
+      centerY[index] = center.y;
+      centerZ[index] = center.z;
+      radius[index] = sphereRadius;
+    }
+  };
+
+  /*
+  * Tests bounding spheres against a frustum and writes the indices of the visible ones, in increasing order.
+  * The vector path tests 8 (AVX2) or 4 (SSE2/NEON) spheres per instruction and compacts the result without branches,
+  * the scalar path is the reference it has to match.
+  */
+  class FrustumCuller
+  {
+  public:
+    static constexpr uint32 ObjectsPerJob = 4096;
+
+    // Both return the visible count, visibleIndices needs room for end - begin indices
+    static uint32 CullScalar(const Frustum& frustum, const BoundingSphereArray& spheres, uint32 begin, uint32 end, uint32* visibleIndices);
+    static uint32 CullRange(const Frustum& frustum, const BoundingSphereArray& spheres, uint32 begin, uint32 end, uint32* visibleIndices);
+
+    // Culls the whole array, split over the job system when there is one. Buffers are reused between frames.
+    void Cull(const Frustum& frustum, const BoundingSphereArray& spheres, JobSystem* jobSystem);
+
+    inline const uint32* GetVisibleIndices() const { return m_visibleIndices.data(); }
+    inline uint32 GetVisibleCount() const { return m_visibleCount; }
+
+  private:
+    std::vector<uint32> m_visibleIndices;
+    std::vector<uint32> m_jobVisibleCounts;
+    uint32 m_visibleCount = 0;
+  };
+}
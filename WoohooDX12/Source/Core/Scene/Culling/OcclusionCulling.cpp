@@ -0,0 +1,376 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "Jobs/JobSystem.h"
+
+namespace WoohooDX12
+{
+  static constexpr float FarDepth = 1.0f;
+  static constexpr uint32 FullRow = 0xFFFFFFFF;
+
+  static inline Vec4 TransformPoint(const float* p, const Mat4x4& m)
+  {
+    return Vec4(p[0] * m._11 + p[1] * m._21 + p[2] * m._31 + m._41,
+      p[0] * m._12 + p[1] * m._22 + p[2] * m._32 + m._42,
+      p[0] * m._13 + p[1] * m._23 + p[2] * m._33 + m._43,
+      p[0] * m._14 + p[1] * m._24 + p[2] * m._34 + m._44);
+  }
+
+  void MaskedOcclusionBuffer::Init(uint32 width, uint32 height)
+  {
+    m_tilesX = (width + TileWidth - 1) / TileWidth;
+    m_tilesY = (height + TileHeight - 1) / TileHeight;
+    m_coarseX = (m_tilesX + CoarseTileSize - 1) / CoarseTileSize;
+    m_coarseY = (m_tilesY + CoarseTileSize - 1) / CoarseTileSize;
+
+    m_tiles.resize(m_tilesX * m_tilesY);
+    m_coarseDepths.resize(m_coarseX * m_coarseY);
+    Clear();
+  }
+
+  void MaskedOcclusionBuffer::Clear()
+  {
+    for (Tile& tile : m_tiles)
+    {
+      for (uint32 row = 0; row < TileHeight; ++row)
+        tile.mask[row] = 0;
+      tile.layerDepth = 0.0f;
+      tile.tileDepth = FarDepth;
+    }
+
+    std::fill(m_coarseDepths.begin(), m_coarseDepths.end(), FarDepth);
+    m_triangles.clear();
+  }
+
+  void MaskedOcclusionBuffer::RenderTriangles(const float* positions, uint32 stride, const uint32* indices, uint32 triangleCount, const Mat4x4& modelViewProjection)
+  {
+    const uint8* bytes = reinterpret_cast<const uint8*>(positions);
+
+    for (uint32 i = 0; i < triangleCount; ++i)
+    {
+      Vec4 clip[3];
+      for (uint32 v = 0; v < 3; ++v)
+        clip[v] = TransformPoint(reinterpret_cast<const float*>(bytes + (size_t)indices[i * 3 + v] * stride), modelViewProjection);
+
+      const bool inside0 = clip[0].z >= 0.0f;
+      const bool inside1 = clip[1].z >= 0.0f;
+      const bool inside2 = clip[2].z >= 0.0f;
+      if (inside0 && inside1 && inside2)
+      {
+        AddTriangle(clip);
+        continue;
+      }
+      if (!inside0 && !inside1 && !inside2)
+        continue;
+
+      // Clip against the near plane (z >= 0 in D3D clip space), gives a triangle or a quad
+      Vec4 polygon[4];
+      uint32 vertexCount = 0;
+      for (uint32 v = 0; v < 3; ++v)
+      {
+        const Vec4& a = clip[v];
+        const Vec4& b = clip[(v + 1) % 3];
+        if (a.z >= 0.0f)
+          polygon[vertexCount++] = a;
+        if ((a.z >= 0.0f) != (b.z >= 0.0f))
+        {
+          const float t = a.z / (a.z - b.z);
+          polygon[vertexCount++] = Vec4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t);
+        }
+      }
+
+      AddTriangle(polygon);
+      if (vertexCount == 4)
+      {
+        const Vec4 second[3] = { polygon[0], polygon[2], polygon[3] };
+        AddTriangle(second);
+      }
+    }
+  }
+
+  void MaskedOcclusionBuffer::AddTriangle(const Vec4* clipPositions)
+  {
+    const float width = (float)GetWidth();
+    const float height = (float)GetHeight();
+
+    ScreenTriangle triangle;
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float depths[3];
+    for (uint32 v = 0; v < 3; ++v)
+    {
+      const Vec4& p = clipPositions[v];
+      if (p.w <= 0.0f)
+        return;
+
+      const float invW = 1.0f / p.w;
+      triangle.x[v] = (p.x * invW * 0.5f + 0.5f) * width;
+      triangle.y[v] = (0.5f - p.y * invW * 0.5f) * height;
+      depths[v] = p.z * invW;
+
+      minX = std::min(minX, triangle.x[v]);
+      minY = std::min(minY, triangle.y[v]);
+      maxX = std::max(maxX, triangle.x[v]);
+      maxY = std::max(maxY, triangle.y[v]);
+    }
+
+    // Off screen or degenerate
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+      return;
+
+    const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+    if (fabsf(area) < 1e-6f)
+      return;
+
+    // Counter clockwise in screen space so every edge function is positive inside
+    if (area < 0.0f)
+    {
+      std::swap(triangle.x[1], triangle.x[2]);
+      std::swap(triangle.y[1], triangle.y[2]);
+      std::swap(depths[1], depths[2]);
+    }
+
+    // NDC depth is affine in screen space
+    const float dx1 = triangle.x[1] - triangle.x[0], dy1 = triangle.y[1] - triangle.y[0], dz1 = depths[1] - depths[0];
+    const float dx2 = triangle.x[2] - triangle.x[0], dy2 = triangle.y[2] - triangle.y[0], dz2 = depths[2] - depths[0];
+    const float invArea = 1.0f / (dx1 * dy2 - dx2 * dy1);
+    triangle.depthA = (dz1 * dy2 - dz2 * dy1) * invArea;
+    triangle.depthB = (dx1 * dz2 - dx2 * dz1) * invArea;
+    triangle.depthC = depths[0] - triangle.depthA * triangle.x[0] - triangle.depthB * triangle.y[0];
+    triangle.maxDepth = std::max(depths[0], std::max(depths[1], depths[2]));
+
+    triangle.minX = std::max(0, (int32)floorf(minX));
+    triangle.minY = std::max(0, (int32)floorf(minY));
+    triangle.maxX = std::min((int32)width - 1, (int32)ceilf(maxX));
+    triangle.maxY = std::min((int32)height - 1, (int32)ceilf(maxY));
+
+    m_triangles.push_back(triangle);
+  }
+
+  void MaskedOcclusionBuffer::Rasterize(JobSystem* jobSystem)
+  {
+    // Jobs own whole coarse rows, so they also own the coarse level of their tiles
+    if (jobSystem == nullptr)
+    {
+      RasterizeTileRows(0, m_tilesY);
+      UpdateCoarseLevel(0, m_coarseY);
+    }
+    else
+    {
+      jobSystem->ParallelFor(m_coarseY, 1, [this](uint32 begin, uint32 end)
+        {
+          RasterizeTileRows(begin * CoarseTileSize, std::min(end * CoarseTileSize, m_tilesY));
+          UpdateCoarseLevel(begin, end);
+        });
+    }
+
+    m_triangles.clear();
+  }
+
+  void MaskedOcclusionBuffer::RasterizeTileRows(uint32 firstRow, uint32 lastRow)
+  {
+    const int32 bandMinY = (int32)(firstRow * TileHeight);
+    const int32 bandMaxY = (int32)(lastRow * TileHeight) - 1;
+
+    for (const ScreenTriangle& triangle : m_triangles)
+    {
+      if (triangle.maxY < bandMinY || triangle.minY > bandMaxY)
+        continue;
+
+      const uint32 tileMinX = (uint32)triangle.minX / TileWidth;
+      const uint32 tileMaxX = (uint32)triangle.maxX / TileWidth;
+      const uint32 tileMinY = std::max((uint32)triangle.minY / TileHeight, firstRow);
+      const uint32 tileMaxY = std::min((uint32)triangle.maxY / TileHeight, lastRow - 1);
+
+      for (uint32 tileY = tileMinY; tileY <= tileMaxY; ++tileY)
+      {
+        for (uint32 tileX = tileMinX; tileX <= tileMaxX; ++tileX)
+          RasterizeTile(triangle, tileX, tileY);
+      }
+    }
+  }
+
+  void MaskedOcclusionBuffer::RasterizeTile(const ScreenTriangle& triangle, uint32 tileX, uint32 tileY)
+  {
+    Tile& tile = m_tiles[tileY * m_tilesX + tileX];
+
+    const float originX = (float)(tileX * TileWidth);
+    const float originY = (float)(tileY * TileHeight);
+
+    // Farthest depth of the triangle inside the tile, the plane is affine so the max is on a tile corner
+    const float cornerDepth0 = triangle.depthA * originX + triangle.depthB * originY + triangle.depthC;
+    const float stepX = triangle.depthA * (float)TileWidth;
+    const float stepY = triangle.depthB * (float)TileHeight;
+    const float cornerMax = cornerDepth0 + std::max(stepX, 0.0f) + std::max(stepY, 0.0f);
+    const float depth = std::min(triangle.maxDepth, cornerMax);
+
+    // Can not hide anything the tile does not already hide
+    if (depth >= tile.tileDepth)
+      return;
+
+    // Edge functions relative to the first vertex of each edge, evaluated at the pixel centers. Strictly inside only,
+    // covering less than the triangle is what keeps the result conservative.
+    float edgeA[3], edgeB[3], edgeRow[3];
+    for (uint32 e = 0; e < 3; ++e)
+    {
+      const uint32 next = (e + 1) % 3;
+      edgeA[e] = triangle.y[e] - triangle.y[next];
+      edgeB[e] = triangle.x[next] - triangle.x[e];
+      edgeRow[e] = edgeA[e] * (originX + 0.5f - triangle.x[e]) + edgeB[e] * (originY + 0.5f - triangle.y[e]);
+    }
+
+    uint32 coverage[TileHeight];
+    uint32 anyCoverage = 0;
+
+#if WOH_OCCLUSION_SSE2
+    const __m128 laneOffsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    __m128 a[3], step[3];
+    for (uint32 e = 0; e < 3; ++e)
+    {
+      a[e] = _mm_set1_ps(edgeA[e]);
+      step[e] = _mm_set1_ps(edgeA[e] * 4.0f);
+    }
+
+    for (uint32 row = 0; row < TileHeight; ++row)
+    {
+      __m128 value[3];
+      for (uint32 e = 0; e < 3; ++e)
+        value[e] = _mm_add_ps(_mm_set1_ps(edgeRow[e] + edgeB[e] * (float)row), _mm_mul_ps(a[e], laneOffsets));
+
+      uint32 rowMask = 0;
+      for (uint32 block = 0; block < TileWidth / 4; ++block)
+      {
+        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(value[0], _mm_setzero_ps()), _mm_cmpgt_ps(value[1], _mm_setzero_ps())), _mm_cmpgt_ps(value[2], _mm_setzero_ps()));
+        rowMask |= (uint32)_mm_movemask_ps(inside) << (block * 4);
+
+        for (uint32 e = 0; e < 3; ++e)
+          value[e] = _mm_add_ps(value[e], step[e]);
+      }
+
+      coverage[row] = rowMask;
+      anyCoverage |= rowMask;
+    }
+#else
+    for (uint32 row = 0; row < TileHeight; ++row)
+    {
+      uint32 rowMask = 0;
+      for (uint32 column = 0; column < TileWidth; ++column)
+      {
+        bool inside = true;
+        for (uint32 e = 0; e < 3; ++e)
+          inside = inside && edgeRow[e] + edgeB[e] * (float)row + edgeA[e] * (float)column > 0.0f;
+        rowMask |= (inside ? 1u : 0u) << column;
+      }
+
+      coverage[row] = rowMask;
+      anyCoverage |= rowMask;
+    }
+#endif
+
+    if (anyCoverage == 0)
+      return;
+
+    // Merge into the working layer, it becomes the tile depth once it covers the whole tile
+    uint32 fullRows = FullRow;
+    for (uint32 row = 0; row < TileHeight; ++row)
+    {
+      tile.mask[row] |= coverage[row];
+      fullRows &= tile.mask[row];
+    }
+    tile.layerDepth = std::max(tile.layerDepth, depth);
+
+    if (fullRows == FullRow)
+    {
+      tile.tileDepth = tile.layerDepth;
+      tile.layerDepth = 0.0f;
+      for (uint32 row = 0; row < TileHeight; ++row)
+        tile.mask[row] = 0;
+    }
+  }
+
+  void MaskedOcclusionBuffer::UpdateCoarseLevel(uint32 firstRow, uint32 lastRow)
+  {
+    for (uint32 coarseY = firstRow; coarseY < lastRow; ++coarseY)
+    {
+      for (uint32 coarseX = 0; coarseX < m_coarseX; ++coarseX)
+      {
+        float depth = 0.0f;
+        const uint32 tileMaxY = std::min((coarseY + 1) * CoarseTileSize, m_tilesY);
+        const uint32 tileMaxX = std::min((coarseX + 1) * CoarseTileSize, m_tilesX);
+        for (uint32 tileY = coarseY * CoarseTileSize; tileY < tileMaxY; ++tileY)
+        {
+          for (uint32 tileX = coarseX * CoarseTileSize; tileX < tileMaxX; ++tileX)
+            depth = std::max(depth, m_tiles[tileY * m_tilesX + tileX].tileDepth);
+        }
+        m_coarseDepths[coarseY * m_coarseX + coarseX] = depth;
+      }
+    }
+  }
+
+  bool MaskedOcclusionBuffer::TestAABB(const AABB& box, const Mat4x4& viewProjection) const
+  {
+    const float width = (float)GetWidth();
+    const float height = (float)GetHeight();
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float minDepth = FLT_MAX;
+    for (uint32 corner = 0; corner < 8; ++corner)
+    {
+      const float p[3] = { corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z };
+      const Vec4 clip = TransformPoint(p, viewProjection);
+
+      // Crosses the near plane, treat as visible
+      if (clip.z < 0.0f || clip.w <= 0.0f)
+        return true;
+
+      const float invW = 1.0f / clip.w;
+      const float x = (clip.x * invW * 0.5f + 0.5f) * width;
+      const float y = (0.5f - clip.y * invW * 0.5f) * height;
+      minX = std::min(minX, x);
+      minY = std::min(minY, y);
+      maxX = std::max(maxX, x);
+      maxY = std::max(maxY, y);
+      minDepth = std::min(minDepth, clip.z * invW);
+    }
+
+    // Outside the screen, frustum culling decides about it
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+      return true;
+
+    const uint32 tileMinX = (uint32)std::max(0.0f, minX) / TileWidth;
+    const uint32 tileMinY = (uint32)std::max(0.0f, minY) / TileHeight;
+    const uint32 tileMaxX = (uint32)std::min(width - 1.0f, maxX) / TileWidth;
+    const uint32 tileMaxY = (uint32)std::min(height - 1.0f, maxY) / TileHeight;
+
+    // Coarse cells first, a cell whose farthest depth is in front of the box hides all its tiles at once
+    for (uint32 coarseY = tileMinY / CoarseTileSize; coarseY <= tileMaxY / CoarseTileSize; ++coarseY)
+    {
+      for (uint32 coarseX = tileMinX / CoarseTileSize; coarseX <= tileMaxX / CoarseTileSize; ++coarseX)
+      {
+        if (minDepth >= m_coarseDepths[coarseY * m_coarseX + coarseX])
+          continue;
+
+        const uint32 y0 = std::max(tileMinY, coarseY * CoarseTileSize);
+        const uint32 y1 = std::min(tileMaxY, coarseY * CoarseTileSize + CoarseTileSize - 1);
+        const uint32 x0 = std::max(tileMinX, coarseX * CoarseTileSize);
+        const uint32 x1 = std::min(tileMaxX, coarseX * CoarseTileSize + CoarseTileSize - 1);
+        for (uint32 tileY = y0; tileY <= y1; ++tileY)
+        {
+          for (uint32 tileX = x0; tileX <= x1; ++tileX)
+          {
+            if (minDepth < m_tiles[tileY * m_tilesX + tileX].tileDepth)
+              return true;
+          }
+        }
+      }
+    }
+
+    return false;
+  }
+
+  float MaskedOcclusionBuffer::GetTileDepth(uint32 x, uint32 y) const
+  {
+    return m_tiles[(y / TileHeight) * m_tilesX + x / TileWidth].tileDepth;
+  }
+}
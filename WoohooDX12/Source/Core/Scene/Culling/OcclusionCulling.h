@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Scene/Spatial/AABBTree.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WOH_OCCLUSION_SSE2 1
+#endif
+
+namespace WoohooDX12
+{
+  class JobSystem;
+
+  /*
+  * CPU occlusion culling with a low resolution masked depth buffer.
+  * The screen is split into 32x8 pixel tiles. A tile does not store per pixel depth, it keeps a coverage mask of the
+  * pixels of its working layer with the farthest depth of that layer, and the farthest depth of the whole tile.
+  * When the working layer covers the tile it becomes the tile depth, so the tile depth only moves closer.
+  * Occluder triangles are transformed and binned by RenderTriangles() and rasterized by Rasterize(), split over bands
+  * of tile rows. Occludees are tested with their world box against the tile depths and a coarser level of 4x4 tiles.
+  * Depth is D3D NDC depth (0 near, 1 far), everything is conservative: a visible object is never reported occluded.
+  */
+  class MaskedOcclusionBuffer
+  {
+  public:
+    static constexpr uint32 TileWidth = 32;
+    static constexpr uint32 TileHeight = 8;
+    static constexpr uint32 CoarseTileSize = 4; // Tiles per coarse cell on each axis
+
+    MaskedOcclusionBuffer() {}
+
+    // Rounded up to whole tiles
+    void Init(uint32 width, uint32 height);
+    void Clear();
+
+    // Positions are 3 floats at the given stride. Triangles crossing the near plane are clipped.
+    void RenderTriangles(const float* positions, uint32 stride, const uint32* indices, uint32 triangleCount, const Mat4x4& modelViewProjection);
+    void Rasterize(JobSystem* jobSystem);
+
+    // Returns false if the box is hidden behind the rasterized occluders
+    bool TestAABB(const AABB& box, const Mat4x4& viewProjection) const;
+
+    inline uint32 GetWidth() const { return m_tilesX * TileWidth; }
+    inline uint32 GetHeight() const { return m_tilesY * TileHeight; }
+    inline uint32 GetTriangleCount() const { return (uint32)m_triangles.size(); }
+    // Depth of the tile under the pixel, for debugging views
+    float GetTileDepth(uint32 x, uint32 y) const;
+
+  private:
+    struct Tile
+    {
+      uint32 mask[TileHeight]; // One row of 32 pixels per entry
+      float layerDepth; // Farthest depth of the working layer
+      float tileDepth; // Farthest depth of the whole tile
+    };
+
+    struct ScreenTriangle
+    {
+      float x[3];
+      float y[3];
+      float depthA; // Depth plane, depth = depthA * x + depthB * y + depthC
+      float depthB;
+      float depthC;
+      float maxDepth;
+      int32 minX;
+      int32 minY;
+      int32 maxX;
+      int32 maxY;
+    };
+
+    void AddTriangle(const Vec4* clipPositions);
+    void RasterizeTileRows(uint32 firstRow, uint32 lastRow);
+    void RasterizeTile(const ScreenTriangle& triangle, uint32 tileX, uint32 tileY);
+    void UpdateCoarseLevel(uint32 firstRow, uint32 lastRow);
+
+  private:
+    uint32 m_tilesX = 0;
+    uint32 m_tilesY = 0;
+    uint32 m_coarseX = 0;
+    uint32 m_coarseY = 0;
+    std::vector<Tile> m_tiles;
+    std::vector<float> m_coarseDepths; // Farthest tile depth of each coarse cell
+    std::vector<ScreenTriangle> m_triangles;
+  };
+}
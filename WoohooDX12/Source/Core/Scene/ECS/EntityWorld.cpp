@@ -0,0 +1,296 @@
+#include "EntityWorld.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace WoohooDX12
+{
+  static constexpr size_t ChunkAlignment = 64; // cache line
+
+  static std::mutex g_componentRegistryMutex;
+  static std::vector<ComponentTypeInfo> g_componentTypes;
+
+  uint32 ComponentRegistry::Register(uint32 size, uint32 alignment)
+  {
+    std::lock_guard<std::mutex> lock(g_componentRegistryMutex);
+    assert(g_componentTypes.size() < MaxComponentTypes && "Too many component types!");
+
+    // Never reallocates, so Get() can read without locking while another thread registers a type
+    g_componentTypes.reserve(MaxComponentTypes);
+
+    ComponentTypeInfo info;
+    info.size = size;
+    info.alignment = alignment;
+    g_componentTypes.push_back(info);
+
+    return (uint32)g_componentTypes.size() - 1;
+  }
+
+  const ComponentTypeInfo& ComponentRegistry::Get(uint32 componentId)
+  {
+    // Registered infos are never modified, and the vector is only appended before the id is handed out
+    return g_componentTypes[componentId];
+  }
+
+  Archetype::Archetype(ComponentMask mask)
+    : m_mask(mask)
+  {
+    for (uint32 i = 0; i < MaxComponentTypes; ++i)
+    {
+      m_componentOffsets[i] = 0;
+      m_addEdges[i] = nullptr;
+      m_removeEdges[i] = nullptr;
+    }
+
+    // Row size and worst case alignment padding of the component arrays
+    uint32 rowSize = sizeof(Entity);
+    uint32 padding = 0;
+    for (uint32 id = 0; id < MaxComponentTypes; ++id)
+    {
+      if (!Has(id))
+        continue;
+
+      const ComponentTypeInfo& info = ComponentRegistry::Get(id);
+      rowSize += info.size;
+      padding += info.alignment;
+    }
+    assert(rowSize + padding <= ChunkSize && "Archetype row does not fit into a chunk!");
+    m_chunkCapacity = (ChunkSize - padding) / rowSize;
+
+    // Entity array first, then one array per component
+    uint32 offset = sizeof(Entity) * m_chunkCapacity;
+    for (uint32 id = 0; id < MaxComponentTypes; ++id)
+    {
+      if (!Has(id))
+        continue;
+
+      const ComponentTypeInfo& info = ComponentRegistry::Get(id);
+      offset = (offset + info.alignment - 1) & ~(info.alignment - 1);
+      m_componentOffsets[id] = offset;
+      offset += info.size * m_chunkCapacity;
+    }
+  }
+
+  Archetype::~Archetype()
+  {
+    for (uint8* chunk : m_chunks)
+      ::operator delete(chunk, std::align_val_t(ChunkAlignment));
+    m_chunks.clear();
+  }
+
+  uint32 Archetype::PushRow(Entity entity, uint32& chunkIndex)
+  {
+    if (m_entityCount == m_chunks.size() * m_chunkCapacity)
+      m_chunks.push_back(static_cast<uint8*>(::operator new(ChunkSize, std::align_val_t(ChunkAlignment))));
+
+    chunkIndex = m_entityCount / m_chunkCapacity;
+    const uint32 row = m_entityCount % m_chunkCapacity;
+    reinterpret_cast<Entity*>(m_chunks[chunkIndex])[row] = entity;
+    m_entityCount++;
+
+    return row;
+  }
+
+  Entity Archetype::RemoveRow(uint32 chunkIndex, uint32 row)
+  {
+    const uint32 lastIndex = m_entityCount - 1;
+    const uint32 lastChunk = lastIndex / m_chunkCapacity;
+    const uint32 lastRow = lastIndex % m_chunkCapacity;
+
+    Entity moved;
+    if (chunkIndex != lastChunk || row != lastRow)
+    {
+      // Move the last row into the hole
+      uint8* destination = m_chunks[chunkIndex];
+      uint8* source = m_chunks[lastChunk];
+
+      moved = reinterpret_cast<Entity*>(source)[lastRow];
+      reinterpret_cast<Entity*>(destination)[row] = moved;
+
+      for (uint32 id = 0; id < MaxComponentTypes; ++id)
+      {
+        if (!Has(id))
+          continue;
+
+        const uint32 size = ComponentRegistry::Get(id).size;
+        memcpy(destination + m_componentOffsets[id] + (size_t)row * size, source + m_componentOffsets[id] + (size_t)lastRow * size, size);
+      }
+    }
+
+    m_entityCount--;
+
+    // Release the last chunk when it becomes empty
+    if (m_entityCount == lastChunk * m_chunkCapacity)
+    {
+      ::operator delete(m_chunks.back(), std::align_val_t(ChunkAlignment));
+      m_chunks.pop_back();
+    }
+
+    return moved;
+  }
+
+  EntityWorld::EntityWorld()
+  {
+    m_emptyArchetype = GetOrCreateArchetype(0);
+  }
+
+  EntityWorld::~EntityWorld()
+  {
+    for (Archetype* archetype : m_archetypes)
+      delete archetype;
+    m_archetypes.clear();
+  }
+
+  Entity EntityWorld::Create()
+  {
+    return AllocateEntity(m_emptyArchetype);
+  }
+
+  bool EntityWorld::Destroy(Entity entity)
+  {
+    if (!IsAlive(entity))
+      return false;
+
+    EntityRecord& record = m_records[entity.index];
+    RemoveFromArchetype(record);
+
+    record.archetype = nullptr;
+    record.generation++;
+    record.nextFree = m_freeRecord;
+    m_freeRecord = entity.index;
+    m_entityCount--;
+
+    return true;
+  }
+
+  void EntityWorld::Clear()
+  {
+    // Keep the archetypes, queries will find them empty
+    for (Archetype* archetype : m_archetypes)
+    {
+      for (uint8* chunk : archetype->m_chunks)
+        ::operator delete(chunk, std::align_val_t(ChunkAlignment));
+      archetype->m_chunks.clear();
+      archetype->m_entityCount = 0;
+    }
+
+    m_freeRecord = Entity::InvalidIndex;
+    for (uint32 i = 0; i < (uint32)m_records.size(); ++i)
+    {
+      EntityRecord& record = m_records[i];
+      if (record.archetype != nullptr)
+        record.generation++;
+      record.archetype = nullptr;
+      record.nextFree = m_freeRecord;
+      m_freeRecord = i;
+    }
+    m_entityCount = 0;
+  }
+
+  void EntityWorld::GetChunks(ComponentMask mask, std::vector<ChunkView>& chunks)
+  {
+    EachChunk(mask, [&chunks](ChunkView& chunk) { chunks.push_back(chunk); });
+  }
+
+  Entity EntityWorld::AllocateEntity(Archetype* archetype)
+  {
+    uint32 index = m_freeRecord;
+    if (index != Entity::InvalidIndex)
+    {
+      m_freeRecord = m_records[index].nextFree;
+    }
+    else
+    {
+      index = (uint32)m_records.size();
+      m_records.push_back(EntityRecord());
+    }
+
+    EntityRecord& record = m_records[index];
+    record.nextFree = Entity::InvalidIndex;
+
+    Entity entity;
+    entity.index = index;
+    entity.generation = record.generation;
+
+    record.archetype = archetype;
+    record.row = archetype->PushRow(entity, record.chunkIndex);
+    m_entityCount++;
+
+    return entity;
+  }
+
+  Archetype* EntityWorld::GetOrCreateArchetype(ComponentMask mask)
+  {
+    for (Archetype* archetype : m_archetypes)
+    {
+      if (archetype->GetMask() == mask)
+        return archetype;
+    }
+
+    Archetype* archetype = new Archetype(mask);
+    m_archetypes.push_back(archetype);
+    return archetype;
+  }
+
+  Archetype* EntityWorld::GetAddTarget(Archetype* archetype, uint32 componentId)
+  {
+    if (archetype->m_addEdges[componentId] == nullptr)
+    {
+      Archetype* target = GetOrCreateArchetype(archetype->GetMask() | (ComponentMask(1) << componentId));
+      archetype->m_addEdges[componentId] = target;
+      target->m_removeEdges[componentId] = archetype;
+    }
+
+    return archetype->m_addEdges[componentId];
+  }
+
+  Archetype* EntityWorld::GetRemoveTarget(Archetype* archetype, uint32 componentId)
+  {
+    if (archetype->m_removeEdges[componentId] == nullptr)
+    {
+      Archetype* target = GetOrCreateArchetype(archetype->GetMask() & ~(ComponentMask(1) << componentId));
+      archetype->m_removeEdges[componentId] = target;
+      target->m_addEdges[componentId] = archetype;
+    }
+
+    return archetype->m_removeEdges[componentId];
+  }
+
+  void EntityWorld::MoveEntity(Entity entity, Archetype* target)
+  {
+    EntityRecord& record = m_records[entity.index];
+    Archetype* source = record.archetype;
+
+    uint32 chunkIndex = 0;
+    const uint32 row = target->PushRow(entity, chunkIndex);
+
+    // Copy the components both archetypes have
+    const ComponentMask shared = source->GetMask() & target->GetMask();
+    for (uint32 id = 0; id < MaxComponentTypes; ++id)
+    {
+      if (!((shared >> id) & 1))
+        continue;
+
+      const uint32 size = ComponentRegistry::Get(id).size;
+      memcpy(target->GetComponentArray(target->m_chunks[chunkIndex], id) + (size_t)row * size, GetComponentPointer(record, id), size);
+    }
+
+    RemoveFromArchetype(record);
+
+    record.archetype = target;
+    record.chunkIndex = chunkIndex;
+    record.row = row;
+  }
+
+  void EntityWorld::RemoveFromArchetype(EntityRecord& record)
+  {
+    const Entity moved = record.archetype->RemoveRow(record.chunkIndex, record.row);
+    if (!moved.IsNull())
+    {
+      EntityRecord& movedRecord = m_records[moved.index];
+      movedRecord.chunkIndex = record.chunkIndex;
+      movedRecord.row = record.row;
+    }
+  }
+}
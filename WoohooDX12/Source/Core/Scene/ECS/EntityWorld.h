@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cassert>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "Types.h"
+
+/*
+* Archetype based entity component store.
+* Entities with the same set of components share an archetype. An archetype stores its entities in fixed size chunks,
+* each chunk holds one tightly packed array per component (SoA), so a query walks contiguous arrays chunk by chunk.
+* Components must be trivially copyable, they are moved between archetypes with memcpy on structural changes.
+*/
+
+namespace WoohooDX12
+{
+  typedef uint64 ComponentMask;
+  constexpr uint32 MaxComponentTypes = 64;
+
+  struct Entity
+  {
+    static constexpr uint32 InvalidIndex = 0xFFFFFFFF;
+
+    uint32 index = InvalidIndex;
+    uint32 generation = 0;
+
+    inline bool IsNull() const { return index == InvalidIndex; }
+    inline bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    inline bool operator!=(const Entity& other) const { return !(*this == other); }
+  };
+
+  struct ComponentTypeInfo
+  {
+    uint32 size = 0;
+    uint32 alignment = 0;
+  };
+
+  class ComponentRegistry
+  {
+  public:
+    static uint32 Register(uint32 size, uint32 alignment);
+    static const ComponentTypeInfo& Get(uint32 componentId);
+  };
+
+  // Ids are assigned on first use, in the order the component types are first seen
+  template<typename T>
+  inline uint32 GetComponentId()
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable!");
+    static const uint32 id = ComponentRegistry::Register((uint32)sizeof(T), (uint32)alignof(T));
+    return id;
+  }
+
+  template<typename... Ts>
+  inline ComponentMask GetComponentMask()
+  {
+    return (ComponentMask(0) | ... | (ComponentMask(1) << GetComponentId<Ts>()));
+  }
+
+  class Archetype;
+
+  // Entities of one chunk, used to split queries into ranges (e.g. for parallel systems)
+  struct ChunkView
+  {
+    Archetype* archetype = nullptr;
+    uint8* data = nullptr;
+    uint32 count = 0;
+
+    inline const Entity* GetEntities() const { return reinterpret_cast<const Entity*>(data); }
+
+    template<typename T>
+    inline T* Get() const;
+  };
+
+  class Archetype
+  {
+    friend class EntityWorld;
+
+  public:
+    static constexpr uint32 ChunkSize = 16 * 1024;
+
+    Archetype(ComponentMask mask);
+    ~Archetype();
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    inline ComponentMask GetMask() const { return m_mask; }
+    inline bool Has(uint32 componentId) const { return (m_mask >> componentId) & 1; }
+    inline uint32 GetEntityCount() const { return m_entityCount; }
+    inline uint32 GetChunkCount() const { return (uint32)m_chunks.size(); }
+    inline uint32 GetChunkCapacity() const { return m_chunkCapacity; }
+
+    inline ChunkView GetChunk(uint32 chunkIndex)
+    {
+      ChunkView view;
+      view.archetype = this;
+      view.data = m_chunks[chunkIndex];
+      view.count = chunkIndex + 1 < m_chunks.size() ? m_chunkCapacity : m_entityCount - chunkIndex * m_chunkCapacity;
+      return view;
+    }
+
+    inline uint8* GetComponentArray(uint8* chunk, uint32 componentId) const
+    {
+      assert(Has(componentId) && "Archetype does not have the component!");
+      return chunk + m_componentOffsets[componentId];
+    }
+
+  private:
+    // Appends a row, component data is uninitialized
+    uint32 PushRow(Entity entity, uint32& chunkIndex);
+    // Swap-removes a row. Returns the entity moved into the row, or a null entity if the last row is removed.
+    Entity RemoveRow(uint32 chunkIndex, uint32 row);
+
+  private:
+    ComponentMask m_mask = 0;
+    uint32 m_componentOffsets[MaxComponentTypes]; // Offset of the component array in a chunk
+    uint32 m_chunkCapacity = 0;
+    uint32 m_entityCount = 0;
+    std::vector<uint8*> m_chunks;
+
+    // Archetype reached by adding/removing a component, cached structural change edges
+    Archetype* m_addEdges[MaxComponentTypes];
+    Archetype* m_removeEdges[MaxComponentTypes];
+  };
+
+  template<typename T>
+  inline T* ChunkView::Get() const
+  {
+    return reinterpret_cast<T*>(archetype->GetComponentArray(data, GetComponentId<T>()));
+  }
+
+  class EntityWorld
+  {
+  public:
+    EntityWorld();
+    ~EntityWorld();
+
+    EntityWorld(const EntityWorld&) = delete;
+    EntityWorld& operator=(const EntityWorld&) = delete;
+
+    Entity Create();
+    // Creates the entity directly in its final archetype
+    template<typename... Ts>
+    Entity Create(const Ts&... components);
+    bool Destroy(Entity entity);
+    void Clear();
+
+    inline bool IsAlive(Entity entity) const
+    {
+      return entity.index < m_records.size() && m_records[entity.index].generation == entity.generation;
+    }
+
+    template<typename T>
+    inline bool Has(Entity entity) const { return IsAlive(entity) && m_records[entity.index].archetype->Has(GetComponentId<T>()); }
+
+    // Returns nullptr if the entity is dead or does not have the component
+    template<typename T>
+    T* Get(Entity entity);
+
+    // Structural changes move the entity to another archetype
+    template<typename T>
+    T& Add(Entity entity, const T& component = T());
+    template<typename T>
+    bool Remove(Entity entity);
+
+    // Calls func(Entity, Ts&...) for every entity that has all the components
+    template<typename... Ts, typename Func>
+    void Each(Func&& func);
+
+    // Calls func(ChunkView&) for every chunk that has all the components in the mask
+    template<typename Func>
+    void EachChunk(ComponentMask mask, Func&& func);
+    // Collects the chunks matching the mask, so they can be distributed over threads
+    void GetChunks(ComponentMask mask, std::vector<ChunkView>& chunks);
+
+    inline uint32 GetEntityCount() const { return m_entityCount; }
+    inline uint32 GetArchetypeCount() const { return (uint32)m_archetypes.size(); }
+
+  private:
+    struct EntityRecord
+    {
+      Archetype* archetype = nullptr;
+      uint32 chunkIndex = 0;
+      uint32 row = 0;
+      uint32 generation = 1; // Starts at 1 so a zero initialized entity never resolves
+      uint32 nextFree = Entity::InvalidIndex;
+    };
+
+    Entity AllocateEntity(Archetype* archetype);
+    Archetype* GetOrCreateArchetype(ComponentMask mask);
+    Archetype* GetAddTarget(Archetype* archetype, uint32 componentId);
+    Archetype* GetRemoveTarget(Archetype* archetype, uint32 componentId);
+    void MoveEntity(Entity entity, Archetype* target);
+    void RemoveFromArchetype(EntityRecord& record);
+    inline uint8* GetComponentPointer(const EntityRecord& record, uint32 componentId) const
+    {
+      const ComponentTypeInfo& info = ComponentRegistry::Get(componentId);
+      return record.archetype->GetComponentArray(record.archetype->m_chunks[record.chunkIndex], componentId) + (size_t)record.row * info.size;
+    }
+
+  private:
+    std::vector<Archetype*> m_archetypes;
+    Archetype* m_emptyArchetype = nullptr;
+
+    std::vector<EntityRecord> m_records;
+    uint32 m_freeRecord = Entity::InvalidIndex;
+    uint32 m_entityCount = 0;
+  };
+
+  template<typename... Ts>
+  Entity EntityWorld::Create(const Ts&... components)
+  {
+    Archetype* archetype = GetOrCreateArchetype(GetComponentMask<Ts...>());
+    Entity entity = AllocateEntity(archetype);
+
+    const EntityRecord& record = m_records[entity.index];
+    ((*reinterpret_cast<Ts*>(GetComponentPointer(record, GetComponentId<Ts>())) = components), ...);
+
+    return entity;
+  }
+
+  template<typename T>
+  T* EntityWorld::Get(Entity entity)
+  {
+    const uint32 componentId = GetComponentId<T>();
+    if (!IsAlive(entity) || !m_records[entity.index].archetype->Has(componentId))
+      return nullptr;
+
+    return reinterpret_cast<T*>(GetComponentPointer(m_records[entity.index], componentId));
+  }
+
+  template<typename T>
+  T& EntityWorld::Add(Entity entity, const T& component)
+  {
+    assert(IsAlive(entity) && "Entity is not alive!");
+
+    const uint32 componentId = GetComponentId<T>();
+    EntityRecord& record = m_records[entity.index];
+    if (!record.archetype->Has(componentId))
+      MoveEntity(entity, GetAddTarget(record.archetype, componentId));
+
+    T* data = reinterpret_cast<T*>(GetComponentPointer(m_records[entity.index], componentId));
+    *data = component;
+    return *data;
+  }
+
+  template<typename T>
+  bool EntityWorld::Remove(Entity entity)
+  {
+    const uint32 componentId = GetComponentId<T>();
+    if (!IsAlive(entity) || !m_records[entity.index].archetype->Has(componentId))
+      return false;
+
+    MoveEntity(entity, GetRemoveTarget(m_records[entity.index].archetype, componentId));
+    return true;
+  }
+
+  template<typename... Ts, typename Func>
+  void EntityWorld::Each(Func&& func)
+  {
+    EachChunk(GetComponentMask<Ts...>(), [&func](ChunkView& chunk)
+      {
+        const Entity* entities = chunk.GetEntities();
+        auto arrays = std::make_tuple(chunk.Get<Ts>()...);
+        for (uint32 i = 0; i < chunk.count; ++i)
+          func(entities[i], std::get<Ts*>(arrays)[i]...);
+      });
+  }
+
+  template<typename Func>
+  void EntityWorld::EachChunk(ComponentMask mask, Func&& func)
+  {
+    for (Archetype* archetype : m_archetypes)
+    {
+      if ((archetype->GetMask() & mask) != mask || archetype->GetEntityCount() == 0)
+        continue;
+
+      for (uint32 i = 0; i < archetype->GetChunkCount(); ++i)
+      {
+        ChunkView chunk = archetype->GetChunk(i);
+        func(chunk);
+      }
+    }
+  }
+}
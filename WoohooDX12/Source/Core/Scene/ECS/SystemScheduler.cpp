@@ -0,0 +1,136 @@
+#include "SystemScheduler.h"
+
+namespace WoohooDX12
+{
+  uint32 SystemScheduler::AddSystem(const SystemDesc& desc)
+  {
+    std::unique_ptr<SystemState> state = std::make_unique<SystemState>();
+    state->desc = desc;
+    state->scheduler = this;
+    state->index = (uint32)m_systems.size();
+    m_systems.push_back(std::move(state));
+
+    return (uint32)m_systems.size() - 1;
+  }
+
+  void SystemScheduler::SetEnabled(uint32 systemIndex, bool enabled)
+  {
+    m_systems[systemIndex]->enabled = enabled;
+  }
+
+  void SystemScheduler::Run(EntityWorld& world, float deltaTime)
+  {
+    m_deltaTime = deltaTime;
+
+    if (m_jobSystem == nullptr)
+    {
+      for (std::unique_ptr<SystemState>& system : m_systems)
+      {
+        if (!system->enabled)
+          continue;
+
+        world.EachChunk(system->desc.reads | system->desc.writes, [&](ChunkView& chunk) { system->desc.update(chunk, deltaTime); });
+      }
+      return;
+    }
+
+    BuildGraph(world);
+
+    // Every enabled system is pending until Complete() is called for it
+    for (uint32 i = 0; i < (uint32)m_systems.size(); ++i)
+    {
+      if (m_systems[i]->enabled)
+        m_frameCounter.pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for (uint32 i = 0; i < (uint32)m_systems.size(); ++i)
+    {
+      if (m_systems[i]->enabled && m_systems[i]->dependencyCount == 0)
+        Schedule(i);
+    }
+
+    m_jobSystem->Wait(m_frameCounter);
+  }
+
+  void SystemScheduler::BuildGraph(EntityWorld& world)
+  {
+    for (uint32 i = 0; i < (uint32)m_systems.size(); ++i)
+    {
+      SystemState& system = *m_systems[i];
+      system.chunks.clear();
+      system.dependents.clear();
+      system.dependencyCount = 0;
+      if (!system.enabled)
+        continue;
+
+      world.GetChunks(system.desc.reads | system.desc.writes, system.chunks);
+
+      // Registration order decides the direction of the edge between two conflicting systems
+      const ComponentMask accessed = system.desc.reads | system.desc.writes;
+      for (uint32 j = 0; j < i; ++j)
+      {
+        SystemState& earlier = *m_systems[j];
+        if (!earlier.enabled)
+          continue;
+
+        const ComponentMask earlierAccessed = earlier.desc.reads | earlier.desc.writes;
+        if ((earlier.desc.writes & accessed) != 0 || (system.desc.writes & earlierAccessed) != 0)
+        {
+          earlier.dependents.push_back(i);
+          system.dependencyCount++;
+        }
+      }
+    }
+
+    for (std::unique_ptr<SystemState>& system : m_systems)
+      system->remainingDependencies.store(system->dependencyCount, std::memory_order_relaxed);
+  }
+
+  void SystemScheduler::Schedule(uint32 systemIndex)
+  {
+    SystemState& system = *m_systems[systemIndex];
+    const uint32 chunkCount = (uint32)system.chunks.size();
+    if (chunkCount == 0)
+    {
+      Complete(systemIndex);
+      return;
+    }
+
+    const uint32 chunksPerJob = system.desc.chunksPerJob > 0 ? system.desc.chunksPerJob : 1;
+    const uint32 jobCount = (chunkCount + chunksPerJob - 1) / chunksPerJob;
+    system.remainingJobs.store(jobCount, std::memory_order_relaxed);
+
+    // Jobs also count on the frame counter, so the waiting thread is woken up when they finish
+    for (uint32 job = 0; job < jobCount; ++job)
+    {
+      const uint32 begin = job * chunksPerJob;
+      const uint32 end = begin + chunksPerJob < chunkCount ? begin + chunksPerJob : chunkCount;
+      m_jobSystem->Submit(&SystemScheduler::RunJob, &system, begin, end, &m_frameCounter);
+    }
+  }
+
+  void SystemScheduler::Complete(uint32 systemIndex)
+  {
+    SystemState& system = *m_systems[systemIndex];
+    for (uint32 dependent : system.dependents)
+    {
+      if (m_systems[dependent]->remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Schedule(dependent);
+    }
+
+    m_frameCounter.pending.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  void SystemScheduler::RunJob(void* data, uint32 begin, uint32 end)
+  {
+    SystemState& system = *static_cast<SystemState*>(data);
+    SystemScheduler& scheduler = *system.scheduler;
+
+    for (uint32 i = begin; i < end; ++i)
+      system.desc.update(system.chunks[i], scheduler.m_deltaTime);
+
+    // Last job of the system releases its dependents
+    if (system.remainingJobs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      scheduler.Complete(system.index);
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "EntityWorld.h"
+#include "Jobs/JobSystem.h"
+
+namespace WoohooDX12
+{
+  // Called for every chunk matching the system's components, possibly on several threads at once
+  typedef std::function<void(ChunkView& chunk, float deltaTime)> SystemChunkFunction;
+
+  struct SystemDesc
+  {
+    const char* name = "";
+    ComponentMask reads = 0;
+    ComponentMask writes = 0; // Includes the components whose data is written through a handle, like the transform hierarchy
+    SystemChunkFunction update;
+    uint32 chunksPerJob = 4; // Granularity of the split of large queries
+  };
+
+  /*
+  * Runs the ECS systems of a frame.
+  * Systems declare the components they read and write. Every frame the scheduler builds the dependency graph: a system
+  * depends on every earlier registered system it conflicts with (one writes what the other reads or writes). Systems
+  * without pending dependencies run concurrently, each one split into jobs over ranges of its chunks.
+  * Structural changes (create/destroy/add/remove) are not allowed while Run() is executing.
+  */
+  class SystemScheduler
+  {
+  public:
+    SystemScheduler() {}
+
+    SystemScheduler(const SystemScheduler&) = delete;
+    SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+    uint32 AddSystem(const SystemDesc& desc);
+    void SetEnabled(uint32 systemIndex, bool enabled);
+
+    // Runs on the calling thread in registration order when there is no job system
+    void Run(EntityWorld& world, float deltaTime);
+    inline void SetJobSystem(std::shared_ptr<JobSystem> jobSystem) { m_jobSystem = jobSystem; }
+
+    inline uint32 GetSystemCount() const { return (uint32)m_systems.size(); }
+
+  private:
+    struct SystemState
+    {
+      SystemDesc desc;
+      SystemScheduler* scheduler = nullptr;
+      uint32 index = 0;
+      bool enabled = true;
+
+      // Per frame
+      std::vector<ChunkView> chunks;
+      std::vector<uint32> dependents;
+      uint32 dependencyCount = 0;
+      std::atomic<uint32> remainingDependencies = 0;
+      std::atomic<uint32> remainingJobs = 0;
+    };
+
+    void BuildGraph(EntityWorld& world);
+    void Schedule(uint32 systemIndex);
+    void Complete(uint32 systemIndex);
+    static void RunJob(void* data, uint32 begin, uint32 end);
+
+  private:
+    std::vector<std::unique_ptr<SystemState>> m_systems;
+    std::shared_ptr<JobSystem> m_jobSystem = nullptr;
+
+    // Per frame
+    JobCounter m_frameCounter;
+    float m_deltaTime = 0.0f;
+  };
+}
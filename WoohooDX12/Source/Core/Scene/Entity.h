@@ -1,6 +1,6 @@
 #pragma once
 
-// entity class creates and holds the mesh
+// entities are ids in the scene's EntityWorld, their data are components
 // different type of entities will be there:
 // - terrain (an entity responsible for whole terrain)
 // - grass (an entity responsible for whole grasses)
@@ -8,8 +8,12 @@
 // - sphere
 // - etc.
 
-#include  <memory>
 #include "Mesh.h"
+#include "Maths.h"
+#include "Memory/HandlePool.h"
+#include "ECS/EntityWorld.h"
+#include "TransformHierarchy.h"
+#include "Spatial/AABBTree.h"
 
 namespace WoohooDX12
 {
@@ -19,19 +23,86 @@ namespace WoohooDX12
     // TODO grass, terrain, etc.
   };
 
-  class Entity
+  typedef Handle<Mesh> MeshHandle;
+  typedef Handle<Material> MaterialHandle;
+
+  // Immutable definition shared by its instances, per instance changes copy the shared data (see Scene::EditMesh)
+  struct Prefab
+  {
+    MeshHandle mesh;
+    EntityType type = EntityType::Primitive;
+    AABB localBounds; // Bounds of the mesh
+  };
+
+  typedef Handle<Prefab> PrefabHandle;
+
+  // Components
+
+  struct EntityTypeComponent
+  {
+    EntityType type = EntityType::Primitive;
+  };
+
+  struct MeshComponent
+  {
+    MeshHandle mesh;
+  };
+
+  // Prefab the entity is instantiated from, its mesh and type may be overridden
+  struct PrefabComponent
+  {
+    PrefabHandle prefab;
+  };
+
+  // Node of the entity in the scene's transform hierarchy
+  struct TransformComponent
+  {
+    TransformHandle transform;
+  };
+
+  // Bounds of the entity's mesh and its proxy in the scene's spatial tree
+  struct BoundsComponent
+  {
+    AABB localBounds;
+    AABB worldBounds;
+    int32 proxy = DynamicAABBTree::NullNode;
+  };
+
+  // Multiplies the vertex colours of the entity's mesh, drawn as per instance data
+  struct ColorComponent
+  {
+    Vec4 color = Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+  };
+
+  // Tag, the entity's mesh is rasterized into the occlusion buffer and hides the objects behind it
+  struct OccluderComponent
   {
-    friend class SceneRenderer;
+    uint8 unused = 0;
+  };
 
-  public:
-    virtual ~Entity() { m_mesh = nullptr; }
+  // Bit of the static entity in the scene's potentially visible set, see Scene::AddToPVSBaker()
+  struct PVSObjectComponent
+  {
+    uint32 object = 0xFFFFFFFF;
+  };
 
-    inline virtual const EntityType GetType() { return EntityType::Primitive; }
+  // Tag, the entity's world bounds are a cell of the scene's portal graph, see Scene::BuildPortalGraph()
+  struct PortalCellComponent
+  {
+    uint8 unused = 0;
+  };
 
-  protected:
-    Entity() {}
+  // Tag, the entity's world bounds are a doorway between the two portal cells it overlaps
+  struct PortalComponent
+  {
+    uint8 unused = 0;
+  };
 
-  protected:
-    std::shared_ptr<Mesh> m_mesh = nullptr;
+  // Spins the entity around an axis
+  struct RotatorComponent
+  {
+    Vec3 axis = UpVector;
+    float radiansPerSecond = 0.0f;
+    float angle = 0.0f;
   };
 }
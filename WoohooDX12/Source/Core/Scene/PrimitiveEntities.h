@@ -4,11 +4,50 @@
 
 namespace WoohooDX12
 {
-  class TriangleEntity : public Entity
+  // Entity types are sets of components
+
+  // The instance references the prefab's mesh, it does not own a copy
+  inline Entity CreatePrefabEntity(EntityWorld& world, PrefabHandle prefabHandle, const Prefab& prefab, TransformHierarchy& transforms)
+  {
+    EntityTypeComponent type;
+    type.type = prefab.type;
+
+    MeshComponent mesh;
+    mesh.mesh = prefab.mesh;
+
+    BoundsComponent bounds;
+    bounds.localBounds = prefab.localBounds;
+
+    TransformComponent transform;
+    transform.transform = transforms.Create();
+
+    PrefabComponent instance;
+    instance.prefab = prefabHandle;
+
+    return world.Create(type, mesh, transform, bounds, instance);
+  }
+
+  // TODO Create triangle mesh when types of meshes are implmented
+  inline Entity CreateTriangleEntity(EntityWorld& world, PrefabHandle prefabHandle, const Prefab& prefab, TransformHierarchy& transforms)
   {
-  public:
-    // TODO Create triangle mesh when types of meshes are implmented
-    TriangleEntity() { m_mesh = std::make_shared<Mesh>(); }
-    virtual ~TriangleEntity() {}
-  };
+    EntityTypeComponent type;
+    type.type = prefab.type;
+
+    MeshComponent mesh;
+    mesh.mesh = prefab.mesh;
+
+    BoundsComponent bounds;
+    bounds.localBounds = prefab.localBounds;
+
+    TransformComponent transform;
+    transform.transform = transforms.Create();
+
+    PrefabComponent instance;
+    instance.prefab = prefabHandle;
+
+    RotatorComponent rotator;
+    rotator.radiansPerSecond = DirectX::XMConvertToRadians(60.0f);
+
+    return world.Create(type, mesh, transform, bounds, instance, rotator);
+  }
 }
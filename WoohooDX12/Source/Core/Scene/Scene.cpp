@@ -1,16 +1,320 @@
 #include "Scene.h"
+
+#include <cmath>
 #include "Utils.h"
 #include "PrimitiveEntities.h"
+#include "Memory/MemoryTracker.h"
+#include "Visibility/PVSBaker.h"
 
 namespace WoohooDX12
 {
+  Scene::Scene()
+  {
+    SystemDesc rotate;
+    rotate.name = "Rotate";
+    // The local rotations are written through the transform handles, systems reading the world matrices wait for it
+    rotate.writes = GetComponentMask<RotatorComponent, TransformComponent>();
+    rotate.update = [this](ChunkView& chunk, float deltaTime)
+      {
+        RotatorComponent* rotators = chunk.Get<RotatorComponent>();
+        const TransformComponent* transforms = chunk.Get<TransformComponent>();
+        for (uint32 i = 0; i < chunk.count; ++i)
+        {
+          RotatorComponent& rotator = rotators[i];
+          rotator.angle = fmodf(rotator.angle + rotator.radiansPerSecond * deltaTime, DirectX::XM_2PI);
+
+          Vec4 rotation;
+          DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&rotator.axis), rotator.angle));
+          m_transforms.SetLocalRotation(transforms[i].transform, rotation);
+        }
+      };
+    m_systems.AddSystem(rotate);
+
+    m_trianglePrefab = CreatePrefab(CreateMesh(), EntityType::Primitive);
+  }
+
   Scene::~Scene()
   {
-    m_entities.clear();
+    m_world.Clear();
+    m_journal.Clear();
+    m_releasedMeshes.clear();
+    m_prefabs.Clear();
+    m_meshes.Clear();
+    m_meshReferences.clear();
+    m_transforms.Clear();
+    m_spatialTree.Clear();
+  }
+
+  Entity Scene::AddTriangle()
+  {
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    const Prefab* prefab = m_prefabs.Get(m_trianglePrefab);
+    AcquireMesh(prefab->mesh);
+
+    const Entity entity = CreateTriangleEntity(m_world, m_trianglePrefab, *prefab, m_transforms);
+    m_journal.Record(SceneChangeType::EntityAdded, entity);
+    return entity;
+  }
+
+  Entity Scene::Instantiate(PrefabHandle prefabHandle)
+  {
+    const Prefab* prefab = m_prefabs.Get(prefabHandle);
+    if (prefab == nullptr)
+      return Entity();
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    AcquireMesh(prefab->mesh);
+
+    const Entity entity = CreatePrefabEntity(m_world, prefabHandle, *prefab, m_transforms);
+    m_journal.Record(SceneChangeType::EntityAdded, entity);
+    return entity;
+  }
+
+  bool Scene::RemoveEntity(Entity entity)
+  {
+    if (!m_world.IsAlive(entity))
+      return false;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    if (const MeshComponent* mesh = m_world.Get<MeshComponent>(entity))
+      ReleaseMesh(mesh->mesh);
+    if (const TransformComponent* transform = m_world.Get<TransformComponent>(entity))
+      m_transforms.Destroy(transform->transform);
+    if (const BoundsComponent* bounds = m_world.Get<BoundsComponent>(entity); bounds && bounds->proxy != DynamicAABBTree::NullNode)
+      m_spatialTree.DestroyProxy(bounds->proxy);
+
+    m_world.Destroy(entity);
+    m_journal.Record(SceneChangeType::EntityRemoved, entity);
+    return true;
+  }
+
+  MeshHandle Scene::CreateMesh()
+  {
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    const MeshHandle mesh = m_meshes.Create();
+    if (mesh.index >= m_meshReferences.size())
+      m_meshReferences.resize(mesh.index + 1, 0);
+    m_meshReferences[mesh.index] = 0;
+
+    return mesh;
+  }
+
+  bool Scene::SetMesh(Entity entity, MeshHandle mesh)
+  {
+    MeshComponent* meshComponent = m_world.Get<MeshComponent>(entity);
+    if (meshComponent == nullptr || !m_meshes.IsValid(mesh) || meshComponent->mesh == mesh)
+      return false;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    AcquireMesh(mesh);
+    ReleaseMesh(meshComponent->mesh);
+    meshComponent->mesh = mesh;
+
+    if (BoundsComponent* bounds = m_world.Get<BoundsComponent>(entity))
+    {
+      m_meshes.Get(mesh)->GetBoundingBox(bounds->localBounds.min, bounds->localBounds.max);
+
+      // Touch the transform so the world bounds are recomputed on the next Update()
+      if (const TransformComponent* transform = m_world.Get<TransformComponent>(entity))
+        m_transforms.SetLocalPosition(transform->transform, m_transforms.GetLocalPosition(transform->transform));
+    }
+
+    m_journal.Record(SceneChangeType::MeshChanged, entity);
+    return true;
+  }
+
+  Mesh* Scene::EditMesh(Entity entity)
+  {
+    const MeshComponent* meshComponent = m_world.Get<MeshComponent>(entity);
+    if (meshComponent == nullptr)
+      return nullptr;
+
+    if (m_meshReferences[meshComponent->mesh.index] > 1)
+    {
+      // Shared with other instances or a prefab
+      const MeshHandle copy = CreateMesh();
+      m_meshes.Get(copy)->CopyGeometry(*m_meshes.Get(meshComponent->mesh));
+      SetMesh(entity, copy);
+    }
+    else
+    {
+      // Same mesh, the renderer uploads it again
+      m_journal.Record(SceneChangeType::MeshChanged, entity);
+    }
+
+    return m_meshes.Get(meshComponent->mesh);
+  }
+
+  bool Scene::SetEntityType(Entity entity, EntityType type)
+  {
+    EntityTypeComponent* typeComponent = m_world.Get<EntityTypeComponent>(entity);
+    if (typeComponent == nullptr || typeComponent->type == type)
+      return false;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    typeComponent->type = type;
+    m_journal.Record(SceneChangeType::MaterialChanged, entity);
+    return true;
+  }
+
+  bool Scene::SetColor(Entity entity, const Vec4& color)
+  {
+    if (!m_world.IsAlive(entity))
+      return false;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    ColorComponent component;
+    component.color = color;
+    m_world.Add<ColorComponent>(entity, component);
+    m_journal.Record(SceneChangeType::MaterialChanged, entity);
+    return true;
+  }
+
+  PrefabHandle Scene::CreatePrefab(MeshHandle mesh, EntityType type)
+  {
+    if (!m_meshes.IsValid(mesh))
+      return PrefabHandle();
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    AcquireMesh(mesh);
+
+    Prefab prefab;
+    prefab.mesh = mesh;
+    prefab.type = type;
+    m_meshes.Get(mesh)->GetBoundingBox(prefab.localBounds.min, prefab.localBounds.max);
+
+    return m_prefabs.Create(prefab);
+  }
+
+  bool Scene::DestroyPrefab(PrefabHandle prefabHandle)
+  {
+    const Prefab* prefab = m_prefabs.Get(prefabHandle);
+    if (prefab == nullptr)
+      return false;
+
+    ReleaseMesh(prefab->mesh);
+    return m_prefabs.Destroy(prefabHandle);
+  }
+
+  void Scene::AcquireMesh(MeshHandle mesh)
+  {
+    assert(m_meshes.IsValid(mesh) && "Mesh is not valid!");
+    m_meshReferences[mesh.index]++;
+  }
+
+  void Scene::ReleaseMesh(MeshHandle mesh)
+  {
+    assert(m_meshReferences[mesh.index] > 0 && "Mesh is not referenced!");
+    if (--m_meshReferences[mesh.index] == 0)
+      m_releasedMeshes.push_back(mesh);
+  }
+
+  void Scene::ClearChanges()
+  {
+    m_journal.Clear();
+
+    // Released meshes may be referenced again before the journal is consumed
+    for (MeshHandle mesh : m_releasedMeshes)
+    {
+      if (m_meshes.IsValid(mesh) && m_meshReferences[mesh.index] == 0)
+        m_meshes.Destroy(mesh);
+    }
+    m_releasedMeshes.clear();
+  }
+
+  void Scene::Update(float deltaTime)
+  {
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    m_systems.Run(m_world, deltaTime);
+    m_transforms.Update(m_jobSystem.get());
+    UpdateSpatialTree();
+
+    // Journal the moved entities, their world matrices are valid from here on
+    m_world.Each<TransformComponent>([this](Entity entity, TransformComponent& transform)
+      {
+        if (m_transforms.HasWorldChanged(transform.transform))
+          m_journal.Record(SceneChangeType::TransformChanged, entity);
+      });
+  }
+
+  void Scene::AddToPVSBaker(PVSBaker& baker)
+  {
+    // Tagging moves the entities to another archetype, collect them first
+    std::vector<Entity> entities;
+    m_world.Each<MeshComponent, TransformComponent, BoundsComponent>([this, &entities](Entity entity, MeshComponent&, TransformComponent&, BoundsComponent&)
+      {
+        if (!m_world.Has<RotatorComponent>(entity))
+          entities.push_back(entity);
+      });
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    for (Entity entity : entities)
+    {
+      const Mesh* mesh = m_meshes.Get(m_world.Get<MeshComponent>(entity)->mesh);
+      const TransformHandle transform = m_world.Get<TransformComponent>(entity)->transform;
+      if (mesh != nullptr && m_world.Has<OccluderComponent>(entity))
+        baker.AddOccluder(mesh->GetVertices()->position, sizeof(Vertex), mesh->GetIndices(), mesh->GetIndexCount() / 3, m_transforms.GetWorldMatrix(transform));
+
+      PVSObjectComponent object;
+      object.object = baker.AddObject(m_world.Get<BoundsComponent>(entity)->worldBounds);
+      m_world.Add<PVSObjectComponent>(entity, object);
+    }
+  }
+
+  std::shared_ptr<PortalGraph> Scene::BuildPortalGraph()
+  {
+    std::vector<AABB> cells;
+    std::vector<AABB> portals;
+    m_world.Each<PortalCellComponent, BoundsComponent>([&cells](Entity, PortalCellComponent&, BoundsComponent& bounds) { cells.push_back(bounds.worldBounds); });
+    m_world.Each<PortalComponent, BoundsComponent>([&portals](Entity, PortalComponent&, BoundsComponent& bounds) { portals.push_back(bounds.worldBounds); });
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+    std::shared_ptr<PortalGraph> graph = std::make_shared<PortalGraph>();
+    const uint32 skippedCount = graph->BuildFromBoxes(cells.data(), (uint32)cells.size(), portals.data(), (uint32)portals.size());
+    if (skippedCount > 0)
+      Log(std::to_string(skippedCount) + " portals do not connect two cells, they are skipped", LogType::LT_WARNING);
+
+    return graph;
+  }
+
+  void Scene::UpdateSpatialTree()
+  {
+    m_world.Each<TransformComponent, BoundsComponent>([this](Entity entity, TransformComponent& transform, BoundsComponent& bounds)
+      {
+        if (bounds.proxy != DynamicAABBTree::NullNode && !m_transforms.HasWorldChanged(transform.transform))
+          return;
+
+        // World box of the transformed local box, the extents go through the absolute value of the matrix
+        const Mat4x4& m = m_transforms.GetWorldMatrix(transform.transform);
+        const AABB& local = bounds.localBounds;
+        const Vec3 c = Vec3((local.min.x + local.max.x) * 0.5f, (local.min.y + local.max.y) * 0.5f, (local.min.z + local.max.z) * 0.5f);
+        const Vec3 e = Vec3((local.max.x - local.min.x) * 0.5f, (local.max.y - local.min.y) * 0.5f, (local.max.z - local.min.z) * 0.5f);
+
+        const Vec3 center = Vec3(c.x * m._11 + c.y * m._21 + c.z * m._31 + m._41, c.x * m._12 + c.y * m._22 + c.z * m._32 + m._42, c.x * m._13 + c.y * m._23 + c.z * m._33 + m._43);
+        const Vec3 extents = Vec3(e.x * fabsf(m._11) + e.y * fabsf(m._21) + e.z * fabsf(m._31),
+          e.x * fabsf(m._12) + e.y * fabsf(m._22) + e.z * fabsf(m._32),
+          e.x * fabsf(m._13) + e.y * fabsf(m._23) + e.z * fabsf(m._33));
+
+        AABB world;
+        world.min = Vec3(center.x - extents.x, center.y - extents.y, center.z - extents.z);
+        world.max = Vec3(center.x + extents.x, center.y + extents.y, center.z + extents.z);
+
+        if (bounds.proxy == DynamicAABBTree::NullNode)
+        {
+          bounds.proxy = m_spatialTree.CreateProxy(world, entity.index);
+        }
+        else
+        {
+          const Vec3 displacement = Vec3(world.min.x - bounds.worldBounds.min.x, world.min.y - bounds.worldBounds.min.y, world.min.z - bounds.worldBounds.min.z);
+          m_spatialTree.MoveProxy(bounds.proxy, world, displacement);
+        }
+        bounds.worldBounds = world;
+      });
   }
 
-  void Scene::AddTriangle()
+  void Scene::SetJobSystem(std::shared_ptr<JobSystem> jobSystem)
   {
-    m_entities.push_back(std::make_shared<TriangleEntity>());
+    m_jobSystem = jobSystem;
+    m_systems.SetJobSystem(jobSystem);
   }
 }
@@ -1,25 +1,106 @@
 #pragma once
 
-#include <memory>
-#include <vector>
 #include "Entity.h"
+#include "Memory/HandlePool.h"
+#include "ECS/SystemScheduler.h"
+#include "Camera.h"
+#include "SceneJournal.h"
+#include "Visibility/PotentiallyVisibleSet.h"
+#include "Visibility/PortalGraph.h"
 
 // Scene class holds the entities in a scene
 
 namespace WoohooDX12
 {
+  class PVSBaker;
+
   class Scene
   {
     friend class SceneRenderer;
 
   public:
-    Scene() {}
+    Scene();
     ~Scene();
 
-    void AddTriangle();
+    Entity AddTriangle();
+    Entity Instantiate(PrefabHandle prefab);
+    // Releases the entity's reference to its mesh, see ReleaseMesh()
+    bool RemoveEntity(Entity entity);
+
+    // Meshes are shared by reference, the entities and prefabs using a mesh hold a reference to it.
+    // A mesh is destroyed when its last reference is released and the journal is consumed, the renderer may still
+    // hold its GPU buffers until then. A new mesh has no reference.
+    MeshHandle CreateMesh();
+    bool SetMesh(Entity entity, MeshHandle mesh);
+    // Mesh of the entity for writing. A shared mesh is copied first so the other users are not affected (copy on write).
+    // The pointer is valid until the next mesh is created or destroyed.
+    Mesh* EditMesh(Entity entity);
+    bool SetEntityType(Entity entity, EntityType type);
+    bool SetColor(Entity entity, const Vec4& color);
+
+    // Prefabs are immutable, instances override their mesh or type individually
+    PrefabHandle CreatePrefab(MeshHandle mesh, EntityType type);
+    // The instances keep their references to the prefab's mesh
+    bool DestroyPrefab(PrefabHandle prefab);
+    inline const Prefab* GetPrefab(PrefabHandle prefab) const { return m_prefabs.Get(prefab); }
+    inline PrefabHandle GetTrianglePrefab() const { return m_trianglePrefab; }
+
+    inline uint32 GetMeshCount() const { return m_meshes.Size(); }
+    inline uint32 GetPrefabCount() const { return m_prefabs.Size(); }
+
+    // Adds the static entities (the ones without a rotator) to the baker as objects and tags them with their object index,
+    // the static occluders are baked as occluders. Bounds should be up to date, call it after Update().
+    void AddToPVSBaker(PVSBaker& baker);
+    // Baked visibility of the tagged entities, the renderer skips the ones hidden from the camera's cell
+    inline void SetPotentiallyVisibleSet(std::shared_ptr<const PotentiallyVisibleSet> pvs) { m_pvs = pvs; }
+    inline const PotentiallyVisibleSet* GetPotentiallyVisibleSet() const { return m_pvs.get(); }
+
+    // Builds cells and portals from the entities tagged with PortalCellComponent and PortalComponent, using their world
+    // bounds. Bounds should be up to date, call it after Update(). The graph is not attached.
+    std::shared_ptr<PortalGraph> BuildPortalGraph();
+    // Optional, the renderer culls the objects inside the cells with it
+    inline void SetPortalGraph(std::shared_ptr<const PortalGraph> graph) { m_portalGraph = graph; }
+    inline const PortalGraph* GetPortalGraph() const { return m_portalGraph.get(); }
+
+    // Runs the registered systems of the frame
+    void Update(float deltaTime);
+
+    void SetJobSystem(std::shared_ptr<JobSystem> jobSystem);
+    inline JobSystem* GetJobSystem() const { return m_jobSystem.get(); }
+
+    // Changes since the last ClearChanges(), consumed by the scene renderer every frame
+    inline const SceneJournal& GetJournal() const { return m_journal; }
+    // Should be called by the consumer after the changes are applied, destroys the released meshes
+    void ClearChanges();
+
+    inline EntityWorld& GetWorld() { return m_world; }
+    inline SystemScheduler& GetSystemScheduler() { return m_systems; }
+    inline TransformHierarchy& GetTransforms() { return m_transforms; }
+    inline Camera& GetCamera() { return m_camera; }
+    // Fat world bounds of the entities, the user data of a proxy is the entity index
+    inline const DynamicAABBTree& GetSpatialTree() const { return m_spatialTree; }
 
   private:
-    // simple meshes
-    std::vector<std::shared_ptr<Entity>> m_entities;
+    void UpdateSpatialTree();
+
+    void AcquireMesh(MeshHandle mesh);
+    void ReleaseMesh(MeshHandle mesh);
+
+  private:
+    EntityWorld m_world;
+    HandlePool<Mesh> m_meshes;
+    std::vector<uint32> m_meshReferences; // Indexed by mesh handle index
+    HandlePool<Prefab> m_prefabs;
+    PrefabHandle m_trianglePrefab;
+    TransformHierarchy m_transforms;
+    Camera m_camera;
+    DynamicAABBTree m_spatialTree;
+    SystemScheduler m_systems;
+    std::shared_ptr<JobSystem> m_jobSystem = nullptr;
+    std::shared_ptr<const PotentiallyVisibleSet> m_pvs = nullptr;
+    std::shared_ptr<const PortalGraph> m_portalGraph = nullptr;
+
+    SceneJournal m_journal;
+    std::vector<MeshHandle> m_releasedMeshes; // Unreferenced, destroyed on ClearChanges()
   };
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "ECS/EntityWorld.h"
+
+namespace WoohooDX12
+{
+  enum class SceneChangeType : uint8
+  {
+    EntityAdded,
+    EntityRemoved,
+    MeshChanged,
+    MaterialChanged, // Entity type or colour changed, the material is picked by the type
+    TransformChanged, // World matrix recomputed by the last Scene::Update()
+    Count
+  };
+
+  struct SceneChange
+  {
+    SceneChangeType type = SceneChangeType::EntityAdded;
+    Entity entity;
+  };
+
+  /*
+  * Ordered list of the changes made to a scene since it was last consumed.
+  * Consumers replay the changes to patch their own structures instead of rebuilding them from the whole scene.
+  * Changes only carry the entity, consumers read the current components. An entity may be dead by the time its
+  * change is replayed (added and removed in the same frame), consumers should check it is still alive.
+  */
+  class SceneJournal
+  {
+  public:
+    inline void Record(SceneChangeType type, Entity entity)
+    {
+      m_changes.push_back({ type, entity });
+      m_counts[(uint32)type]++;
+    }
+
+    inline void Clear()
+    {
+      m_changes.clear();
+      for (uint32& count : m_counts)
+        count = 0;
+    }
+
+    inline const SceneChange* GetChanges() const { return m_changes.data(); }
+    inline uint32 GetChangeCount() const { return (uint32)m_changes.size(); }
+    inline uint32 GetChangeCount(SceneChangeType type) const { return m_counts[(uint32)type]; }
+
+  private:
+    std::vector<SceneChange> m_changes; // Capacity is kept between frames
+    uint32 m_counts[(uint32)SceneChangeType::Count] = {};
+  };
+}
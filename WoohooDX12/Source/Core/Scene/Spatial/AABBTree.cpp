@@ -0,0 +1,337 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  DynamicAABBTree::DynamicAABBTree(float fatMargin, float displacementMultiplier)
+    : m_fatMargin(fatMargin), m_displacementMultiplier(displacementMultiplier)
+  {
+  }
+
+  int32 DynamicAABBTree::AllocateNode()
+  {
+    if (m_freeNode == NullNode)
+    {
+      m_nodes.push_back(TreeNode());
+      m_nodes.back().parent = m_freeNode;
+      m_freeNode = (int32)m_nodes.size() - 1;
+    }
+
+    const int32 node = m_freeNode;
+    m_freeNode = m_nodes[node].parent;
+
+    m_nodes[node] = TreeNode();
+    m_nodes[node].height = 0;
+    return node;
+  }
+
+  void DynamicAABBTree::FreeNode(int32 node)
+  {
+    m_nodes[node].parent = m_freeNode;
+    m_nodes[node].height = -1;
+    m_freeNode = node;
+  }
+
+  int32 DynamicAABBTree::CreateProxy(const AABB& aabb, uint32 userData)
+  {
+    const int32 proxyId = AllocateNode();
+
+    TreeNode& node = m_nodes[proxyId];
+    node.aabb.min = Vec3(aabb.min.x - m_fatMargin, aabb.min.y - m_fatMargin, aabb.min.z - m_fatMargin);
+    node.aabb.max = Vec3(aabb.max.x + m_fatMargin, aabb.max.y + m_fatMargin, aabb.max.z + m_fatMargin);
+    node.userData = userData;
+
+    InsertLeaf(proxyId);
+    m_leafCount++;
+
+    return proxyId;
+  }
+
+  void DynamicAABBTree::DestroyProxy(int32 proxyId)
+  {
+    assert(proxyId >= 0 && proxyId < (int32)m_nodes.size() && m_nodes[proxyId].IsLeaf() && m_nodes[proxyId].height == 0 && "Invalid proxy!");
+
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+    m_leafCount--;
+  }
+
+  bool DynamicAABBTree::MoveProxy(int32 proxyId, const AABB& aabb, const Vec3& displacement)
+  {
+    assert(proxyId >= 0 && proxyId < (int32)m_nodes.size() && m_nodes[proxyId].IsLeaf() && "Invalid proxy!");
+
+    // Still inside the fat box, nothing to do
+    if (m_nodes[proxyId].aabb.Contains(aabb))
+      return false;
+
+    RemoveLeaf(proxyId);
+
+    // Fatten, and stretch along the displacement to predict the next frames
+    AABB fat;
+    fat.min = Vec3(aabb.min.x - m_fatMargin, aabb.min.y - m_fatMargin, aabb.min.z - m_fatMargin);
+    fat.max = Vec3(aabb.max.x + m_fatMargin, aabb.max.y + m_fatMargin, aabb.max.z + m_fatMargin);
+
+    const Vec3 d = Vec3(displacement.x * m_displacementMultiplier, displacement.y * m_displacementMultiplier, displacement.z * m_displacementMultiplier);
+    if (d.x < 0.0f) fat.min.x += d.x; else fat.max.x += d.x;
+    if (d.y < 0.0f) fat.min.y += d.y; else fat.max.y += d.y;
+    if (d.z < 0.0f) fat.min.z += d.z; else fat.max.z += d.z;
+
+    m_nodes[proxyId].aabb = fat;
+    InsertLeaf(proxyId);
+
+    return true;
+  }
+
+  void DynamicAABBTree::Clear()
+  {
+    m_nodes.clear();
+    m_root = NullNode;
+    m_freeNode = NullNode;
+    m_leafCount = 0;
+  }
+
+  int32 DynamicAABBTree::FindBestSibling(const AABB& leafAABB) const
+  {
+    // Descend while the cost of pushing the leaf down is lower than pairing it with the current node.
+    // Cost is the surface area added to the tree (SAH): the new parent plus the enlargement of every ancestor.
+    int32 index = m_root;
+    while (!m_nodes[index].IsLeaf())
+    {
+      const TreeNode& node = m_nodes[index];
+      const float area = node.aabb.GetHalfArea();
+      const float combinedArea = AABB::Union(node.aabb, leafAABB).GetHalfArea();
+
+      // Cost of creating a new parent for this node and the leaf
+      const float cost = 2.0f * combinedArea;
+      // Minimum cost of pushing the leaf further down, every ancestor below grows by at least this much
+      const float inheritanceCost = 2.0f * (combinedArea - area);
+
+      auto descendCost = [&](int32 child)
+        {
+          const AABB combined = AABB::Union(leafAABB, m_nodes[child].aabb);
+          if (m_nodes[child].IsLeaf())
+            return combined.GetHalfArea() + inheritanceCost;
+          return combined.GetHalfArea() - m_nodes[child].aabb.GetHalfArea() + inheritanceCost;
+        };
+
+      const float cost1 = descendCost(node.child1);
+      const float cost2 = descendCost(node.child2);
+
+      if (cost < cost1 && cost < cost2)
+        break;
+
+      index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    return index;
+  }
+
+  void DynamicAABBTree::InsertLeaf(int32 leaf)
+  {
+    if (m_root == NullNode)
+    {
+      m_root = leaf;
+      m_nodes[leaf].parent = NullNode;
+      return;
+    }
+
+    const AABB leafAABB = m_nodes[leaf].aabb;
+    const int32 sibling = FindBestSibling(leafAABB);
+
+    // New parent takes the place of the sibling
+    const int32 oldParent = m_nodes[sibling].parent;
+    const int32 newParent = AllocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].aabb = AABB::Union(leafAABB, m_nodes[sibling].aabb);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent != NullNode)
+    {
+      if (m_nodes[oldParent].child1 == sibling)
+        m_nodes[oldParent].child1 = newParent;
+      else
+        m_nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+      m_root = newParent;
+    }
+
+    // Refit the ancestors, rotating where the heights are out of balance
+    int32 index = m_nodes[leaf].parent;
+    while (index != NullNode)
+    {
+      index = Balance(index);
+
+      TreeNode& node = m_nodes[index];
+      node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+      node.aabb = AABB::Union(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+
+      index = node.parent;
+    }
+  }
+
+  void DynamicAABBTree::RemoveLeaf(int32 leaf)
+  {
+    if (leaf == m_root)
+    {
+      m_root = NullNode;
+      return;
+    }
+
+    // The sibling takes the place of the parent
+    const int32 parent = m_nodes[leaf].parent;
+    const int32 grandParent = m_nodes[parent].parent;
+    const int32 sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if (grandParent != NullNode)
+    {
+      if (m_nodes[grandParent].child1 == parent)
+        m_nodes[grandParent].child1 = sibling;
+      else
+        m_nodes[grandParent].child2 = sibling;
+      m_nodes[sibling].parent = grandParent;
+      FreeNode(parent);
+
+      int32 index = grandParent;
+      while (index != NullNode)
+      {
+        index = Balance(index);
+
+        TreeNode& node = m_nodes[index];
+        node.aabb = AABB::Union(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+        node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+
+        index = node.parent;
+      }
+    }
+    else
+    {
+      m_root = sibling;
+      m_nodes[sibling].parent = NullNode;
+      FreeNode(parent);
+    }
+  }
+
+  int32 DynamicAABBTree::Balance(int32 indexA)
+  {
+    // A has children B and C. If one of them is two levels taller than the other, it is rotated up to replace A and
+    // A takes its shorter child. Returns the index of the new subtree root.
+    TreeNode& a = m_nodes[indexA];
+    if (a.IsLeaf() || a.height < 2)
+      return indexA;
+
+    const int32 indexB = a.child1;
+    const int32 indexC = a.child2;
+    const int32 balance = m_nodes[indexC].height - m_nodes[indexB].height;
+
+    auto rotate = [&](int32 indexUp, int32 indexStay, bool upIsChild2)
+      {
+        // indexUp (C) replaces A, A takes the shorter child of C
+        TreeNode& up = m_nodes[indexUp];
+        const int32 indexF = up.child1;
+        const int32 indexG = up.child2;
+
+        up.child1 = indexA;
+        up.parent = a.parent;
+        a.parent = indexUp;
+
+        if (up.parent != NullNode)
+        {
+          if (m_nodes[up.parent].child1 == indexA)
+            m_nodes[up.parent].child1 = indexUp;
+          else
+            m_nodes[up.parent].child2 = indexUp;
+        }
+        else
+        {
+          m_root = indexUp;
+        }
+
+        const int32 tall = m_nodes[indexF].height > m_nodes[indexG].height ? indexF : indexG;
+        const int32 shorter = tall == indexF ? indexG : indexF;
+
+        up.child2 = tall;
+        if (upIsChild2)
+          a.child2 = shorter;
+        else
+          a.child1 = shorter;
+        m_nodes[shorter].parent = indexA;
+
+        a.aabb = AABB::Union(m_nodes[indexStay].aabb, m_nodes[shorter].aabb);
+        up.aabb = AABB::Union(a.aabb, m_nodes[tall].aabb);
+        a.height = 1 + std::max(m_nodes[indexStay].height, m_nodes[shorter].height);
+        up.height = 1 + std::max(a.height, m_nodes[tall].height);
+
+        return indexUp;
+      };
+
+    if (balance > 1)
+      return rotate(indexC, indexB, true);
+    if (balance < -1)
+      return rotate(indexB, indexC, false);
+
+    return indexA;
+  }
+
+  float DynamicAABBTree::GetAreaRatio() const
+  {
+    if (m_root == NullNode)
+      return 0.0f;
+
+    float totalArea = 0.0f;
+    for (const TreeNode& node : m_nodes)
+    {
+      if (node.height >= 0)
+        totalArea += node.aabb.GetHalfArea();
+    }
+
+    const float rootArea = m_nodes[m_root].aabb.GetHalfArea();
+    return rootArea > 0.0f ? totalArea / rootArea : 0.0f;
+  }
+
+  void DynamicAABBTree::Validate() const
+  {
+#ifdef WOH_DEBUG
+    if (m_root != NullNode)
+    {
+      assert(m_nodes[m_root].parent == NullNode && "Root has a parent!");
+      ValidateNode(m_root);
+    }
+
+    uint32 freeCount = 0;
+    for (int32 node = m_freeNode; node != NullNode; node = m_nodes[node].parent)
+      freeCount++;
+
+    const uint32 usedCount = m_leafCount > 0 ? 2 * m_leafCount - 1 : 0;
+    assert(usedCount + freeCount == m_nodes.size() && "Leaked tree nodes!");
+#endif
+  }
+
+  void DynamicAABBTree::ValidateNode(int32 index) const
+  {
+    const TreeNode& node = m_nodes[index];
+    if (node.IsLeaf())
+    {
+      assert(node.height == 0 && "Leaf height must be 0!");
+      return;
+    }
+
+    const TreeNode& child1 = m_nodes[node.child1];
+    const TreeNode& child2 = m_nodes[node.child2];
+    assert(child1.parent == index && child2.parent == index && "Broken parent link!");
+    assert(node.height == 1 + std::max(child1.height, child2.height) && "Wrong node height!");
+    assert(node.aabb.Contains(child1.aabb) && node.aabb.Contains(child2.aabb) && "Node does not contain its children!");
+    (void)child1;
+    (void)child2;
+
+    ValidateNode(node.child1);
+    ValidateNode(node.child2);
+  }
+}
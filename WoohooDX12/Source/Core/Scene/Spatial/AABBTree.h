@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include "Types.h"
+#include "Scene/Culling/FrustumCulling.h"
+
+namespace WoohooDX12
+{
+  struct AABB
+  {
+    Vec3 min = Vec3(0.0f, 0.0f, 0.0f);
+    Vec3 max = Vec3(0.0f, 0.0f, 0.0f);
+
+    inline bool Overlaps(const AABB& other) const
+    {
+      return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    inline bool Contains(const AABB& other) const
+    {
+      return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    // Half of the surface area, enough to compare SAH costs
+    inline float GetHalfArea() const
+    {
+      const float dx = max.x - min.x;
+      const float dy = max.y - min.y;
+      const float dz = max.z - min.z;
+      return dx * dy + dy * dz + dz * dx;
+    }
+
+    static inline AABB Union(const AABB& a, const AABB& b)
+    {
+      AABB result;
+      result.min = Vec3(a.min.x < b.min.x ? a.min.x : b.min.x, a.min.y < b.min.y ? a.min.y : b.min.y, a.min.z < b.min.z ? a.min.z : b.min.z);
+      result.max = Vec3(a.max.x > b.max.x ? a.max.x : b.max.x, a.max.y > b.max.y ? a.max.y : b.max.y, a.max.z > b.max.z ? a.max.z : b.max.z);
+      return result;
+    }
+  };
+
+  /*
+  * Dynamic bounding volume tree over AABBs.
+  * Leaves store fattened AABBs, so an object that moves a little does not touch the tree. Leaves are inserted next to the
+  * sibling with the lowest surface area cost and the tree is kept balanced with rotations on the way up.
+  * Queries walk the tree with a fixed size stack and call back for every overlapping leaf, returning false from the
+  * callback stops the query.
+  */
+  class DynamicAABBTree
+  {
+  public:
+    static constexpr int32 NullNode = -1;
+
+    explicit DynamicAABBTree(float fatMargin = 0.1f, float displacementMultiplier = 2.0f);
+
+    int32 CreateProxy(const AABB& aabb, uint32 userData);
+    void DestroyProxy(int32 proxyId);
+    // Returns true if the proxy was reinserted. Displacement of the frame enlarges the fat AABB along the motion.
+    bool MoveProxy(int32 proxyId, const AABB& aabb, const Vec3& displacement);
+    void Clear();
+
+    inline uint32 GetUserData(int32 proxyId) const { return m_nodes[proxyId].userData; }
+    inline const AABB& GetFatAABB(int32 proxyId) const { return m_nodes[proxyId].aabb; }
+
+    // Callbacks are bool(int32 proxyId)
+    template<typename Func>
+    void QueryAABB(const AABB& aabb, Func&& callback) const;
+    template<typename Func>
+    void QuerySphere(const Vec3& center, float radius, Func&& callback) const;
+    template<typename Func>
+    void QueryFrustum(const Frustum& frustum, Func&& callback) const;
+    // Callback is float(int32 proxyId, float maxT), it returns the new max distance, 0 stops and a negative value ignores the proxy
+    template<typename Func>
+    void RayCast(const Vec3& origin, const Vec3& direction, float maxT, Func&& callback) const;
+
+    inline uint32 GetProxyCount() const { return m_leafCount; }
+    int32 GetHeight() const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+    // Sum of the node areas over the root area, lower is better
+    float GetAreaRatio() const;
+    void Validate() const;
+
+  private:
+    static constexpr uint32 MaxStackSize = 256;
+
+    struct TreeNode
+    {
+      AABB aabb;
+      uint32 userData = 0;
+      int32 parent = NullNode; // Next free node when the node is not used
+      int32 child1 = NullNode;
+      int32 child2 = NullNode;
+      int32 height = -1; // Leaf is 0, free node is -1
+
+      inline bool IsLeaf() const { return child1 == NullNode; }
+    };
+
+    int32 AllocateNode();
+    void FreeNode(int32 node);
+    void InsertLeaf(int32 leaf);
+    void RemoveLeaf(int32 leaf);
+    int32 FindBestSibling(const AABB& leafAABB) const;
+    int32 Balance(int32 node);
+    void ValidateNode(int32 node) const;
+
+    template<typename Overlap, typename Func>
+    void Query(Overlap&& overlap, Func&& callback) const;
+
+  private:
+    std::vector<TreeNode> m_nodes;
+    int32 m_root = NullNode;
+    int32 m_freeNode = NullNode;
+    uint32 m_leafCount = 0;
+
+    float m_fatMargin = 0.1f;
+    float m_displacementMultiplier = 2.0f;
+  };
+
+  template<typename Overlap, typename Func>
+  void DynamicAABBTree::Query(Overlap&& overlap, Func&& callback) const
+  {
+    if (m_root == NullNode)
+      return;
+
+    // Balanced trees stay far below the stack size, it would take billions of proxies to overflow it
+    int32 stack[MaxStackSize];
+    uint32 stackSize = 0;
+    stack[stackSize++] = m_root;
+
+    while (stackSize > 0)
+    {
+      const TreeNode& node = m_nodes[stack[--stackSize]];
+      if (!overlap(node.aabb))
+        continue;
+
+      if (node.IsLeaf())
+      {
+        if (!callback((int32)(&node - m_nodes.data())))
+          return;
+      }
+      else
+      {
+        assert(stackSize + 2 <= MaxStackSize && "AABB tree query stack overflow!");
+        stack[stackSize++] = node.child1;
+        stack[stackSize++] = node.child2;
+      }
+    }
+  }
+
+  template<typename Func>
+  void DynamicAABBTree::QueryAABB(const AABB& aabb, Func&& callback) const
+  {
+    Query([&aabb](const AABB& nodeAABB) { return nodeAABB.Overlaps(aabb); }, callback);
+  }
+
+  template<typename Func>
+  void DynamicAABBTree::QuerySphere(const Vec3& center, float radius, Func&& callback) const
+  {
+    const float radiusSq = radius * radius;
+    Query([&center, radiusSq](const AABB& nodeAABB)
+      {
+        // Distance from the center to the closest point of the box
+        const float dx = center.x < nodeAABB.min.x ? nodeAABB.min.x - center.x : (center.x > nodeAABB.max.x ? center.x - nodeAABB.max.x : 0.0f);
+        const float dy = center.y < nodeAABB.min.y ? nodeAABB.min.y - center.y : (center.y > nodeAABB.max.y ? center.y - nodeAABB.max.y : 0.0f);
+        const float dz = center.z < nodeAABB.min.z ? nodeAABB.min.z - center.z : (center.z > nodeAABB.max.z ? center.z - nodeAABB.max.z : 0.0f);
+        return dx * dx + dy * dy + dz * dz <= radiusSq;
+      }, callback);
+  }
+
+  template<typename Func>
+  void DynamicAABBTree::QueryFrustum(const Frustum& frustum, Func&& callback) const
+  {
+    Query([&frustum](const AABB& nodeAABB)
+      {
+        // The box is outside if its most positive corner along the plane normal is behind the plane
+        for (const Vec4& plane : frustum.planes)
+        {
+          const float x = plane.x >= 0.0f ? nodeAABB.max.x : nodeAABB.min.x;
+          const float y = plane.y >= 0.0f ? nodeAABB.max.y : nodeAABB.min.y;
+          const float z = plane.z >= 0.0f ? nodeAABB.max.z : nodeAABB.min.z;
+          if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+            return false;
+        }
+        return true;
+      }, callback);
+  }
+
+  template<typename Func>
+  void DynamicAABBTree::RayCast(const Vec3& origin, const Vec3& direction, float maxT, Func&& callback) const
+  {
+    const Vec3 invDirection = Vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    // Slab test against the current max distance, the callback can shorten the ray
+    Query([&](const AABB& nodeAABB)
+      {
+        float tMin = 0.0f;
+        float tMax = maxT;
+        const float origins[3] = { origin.x, origin.y, origin.z };
+        const float invDirections[3] = { invDirection.x, invDirection.y, invDirection.z };
+        const float mins[3] = { nodeAABB.min.x, nodeAABB.min.y, nodeAABB.min.z };
+        const float maxs[3] = { nodeAABB.max.x, nodeAABB.max.y, nodeAABB.max.z };
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+          float t1 = (mins[axis] - origins[axis]) * invDirections[axis];
+          float t2 = (maxs[axis] - origins[axis]) * invDirections[axis];
+          if (t1 > t2)
+          {
+            const float t = t1;
+            t1 = t2;
+            t2 = t;
+          }
+          // NaN (ray parallel to the slab and starting on its boundary) keeps the previous bounds
+          tMin = t1 > tMin ? t1 : tMin;
+          tMax = t2 < tMax ? t2 : tMax;
+          if (tMin > tMax)
+            return false;
+        }
+        return true;
+      },
+      [&](int32 proxyId)
+      {
+        const float value = callback(proxyId, maxT);
+        if (value == 0.0f)
+          return false;
+        if (value > 0.0f)
+          maxT = value;
+        return true;
+      });
+  }
+}
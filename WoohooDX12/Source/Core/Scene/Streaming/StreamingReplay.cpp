@@ -0,0 +1,49 @@
+#include "StreamingReplay.h"
+
+#include <vector>
+
+namespace WoohooDX12
+{
+  StreamingStats ReplayCameraPath(WorldPartition& partition, const Vec3* cameraPath, uint32 frameCount, const StreamingReplaySettings& settings)
+  {
+    struct PendingLoad
+    {
+      uint32 cell = 0;
+      uint32 completionFrame = 0;
+    };
+    std::vector<PendingLoad> pendingLoads;
+
+    for (uint32 frame = 0; frame < frameCount; ++frame)
+    {
+      // Loads finished since the last frame, like a streamer polling its jobs before the policy runs
+      for (uint32 i = 0; i < (uint32)pendingLoads.size();)
+      {
+        if (pendingLoads[i].completionFrame <= frame)
+        {
+          partition.OnCellLoaded(pendingLoads[i].cell);
+          pendingLoads[i] = pendingLoads.back();
+          pendingLoads.pop_back();
+        }
+        else
+        {
+          ++i;
+        }
+      }
+
+      const Vec3& position = cameraPath[frame];
+      const Vec3& previousPosition = cameraPath[frame > 0 ? frame - 1 : 0];
+      const Vec3 velocity = Vec3((position.x - previousPosition.x) / settings.deltaTime, (position.y - previousPosition.y) / settings.deltaTime,
+        (position.z - previousPosition.z) / settings.deltaTime);
+      partition.Update(position, velocity);
+
+      for (uint32 cell : partition.GetLoadRequests())
+      {
+        const uint64 memorySize = partition.GetCellManifest(cell).memorySize;
+        const uint32 transferFrames = settings.loadBytesPerFrame > 0 ? (uint32)((memorySize + settings.loadBytesPerFrame - 1) / settings.loadBytesPerFrame) : 0;
+        pendingLoads.push_back({ cell, frame + settings.loadLatencyFrames + transferFrames });
+      }
+    }
+
+    return partition.GetStats();
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "WorldPartition.h"
+
+namespace WoohooDX12
+{
+  struct StreamingReplaySettings
+  {
+    float deltaTime = 1.0f / 60.0f;
+    uint32 loadLatencyFrames = 4; // Fixed cost of a load
+    uint64 loadBytesPerFrame = 8ull * 1024 * 1024; // Bandwidth of a single load, added on top of the fixed latency
+  };
+
+  /*
+  * Replays a camera path against the streaming policy without a scene or a GPU. Loads complete after a simulated latency,
+  * the returned stats give the peak memory and the late loads of the path.
+  * The partition should be initialized with its manifests, its stats accumulate over the replay.
+  */
+  StreamingStats ReplayCameraPath(WorldPartition& partition, const Vec3* cameraPath, uint32 frameCount, const StreamingReplaySettings& settings);
+}
@@ -0,0 +1,240 @@
+#include "WorldPartition.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  void WorldPartition::Init(const WorldPartitionSettings& settings, const Vec3& origin, uint32 cellCountX, uint32 cellCountZ)
+  {
+    assert(settings.unloadRadius >= settings.loadRadius && "Unload radius should not be smaller than the load radius!");
+
+    Clear();
+    m_settings = settings;
+    m_origin = origin;
+    m_cellCountX = cellCountX;
+    m_cellCountZ = cellCountZ;
+    m_cells.resize((size_t)cellCountX * cellCountZ);
+  }
+
+  void WorldPartition::Clear()
+  {
+    m_cells.clear();
+    m_residentCells.clear();
+    m_candidates.clear();
+    m_loadRequests.clear();
+    m_unloadRequests.clear();
+    m_cellCountX = 0;
+    m_cellCountZ = 0;
+    m_stats = StreamingStats();
+  }
+
+  void WorldPartition::SetCellManifest(uint32 cell, CellManifest&& manifest)
+  {
+    assert(m_cells[cell].state == CellState::Unloaded && "The manifest of a resident cell can not change!");
+    m_cells[cell].manifest = std::move(manifest);
+  }
+
+  void WorldPartition::Update(const Vec3& cameraPosition, const Vec3& cameraVelocity)
+  {
+    m_loadRequests.clear();
+    m_unloadRequests.clear();
+    if (m_cells.empty())
+      return;
+
+    // Capped so a fast camera does not promote cells it can not reach before the nearer ones
+    float lookAheadX = cameraVelocity.x * m_settings.velocityLookAhead;
+    float lookAheadZ = cameraVelocity.z * m_settings.velocityLookAhead;
+    const float lookAheadLength = sqrtf(lookAheadX * lookAheadX + lookAheadZ * lookAheadZ);
+    if (lookAheadLength > m_settings.loadRadius)
+    {
+      lookAheadX *= m_settings.loadRadius / lookAheadLength;
+      lookAheadZ *= m_settings.loadRadius / lookAheadLength;
+    }
+    m_cameraPosition = cameraPosition;
+    m_predictedPosition = Vec3(cameraPosition.x + lookAheadX, cameraPosition.y, cameraPosition.z + lookAheadZ);
+
+    // Loaded cells are kept until they are past the unload radius. Loading cells finish first.
+    for (uint32 i = 0; i < (uint32)m_residentCells.size();)
+    {
+      Cell& cell = m_cells[m_residentCells[i]];
+      UpdateDistance(m_residentCells[i]);
+      if (cell.state == CellState::Loaded && cell.distance > m_settings.unloadRadius)
+        Unload(i);
+      else
+        ++i;
+    }
+
+    // Unloaded cells in load radius, highest priority first
+    m_candidates.clear();
+    uint32 minX, minZ, maxX, maxZ;
+    const float radius = m_settings.loadRadius;
+    if (GetCellRange(cameraPosition.x - radius, cameraPosition.z - radius, cameraPosition.x + radius, cameraPosition.z + radius, minX, minZ, maxX, maxZ))
+    {
+      for (uint32 z = minZ; z <= maxZ; ++z)
+      {
+        for (uint32 x = minX; x <= maxX; ++x)
+        {
+          const uint32 index = GetCellIndex(x, z);
+          Cell& cell = m_cells[index];
+          if (cell.state != CellState::Unloaded)
+            continue;
+
+          UpdateDistance(index);
+          if (cell.distance <= radius)
+            m_candidates.push_back(index);
+        }
+      }
+    }
+    std::sort(m_candidates.begin(), m_candidates.end(), [this](uint32 a, uint32 b) { return m_cells[a].priority < m_cells[b].priority; });
+
+    for (uint32 index : m_candidates)
+    {
+      if (m_stats.loadingCellCount >= m_settings.maxConcurrentLoads)
+        break;
+
+      Cell& cell = m_cells[index];
+      const uint64 memorySize = cell.manifest.memorySize;
+
+      // Make room by evicting the lowest priority loaded cells, only the ones clearly behind the candidate so two cells
+      // of about the same priority do not evict each other every frame
+      while (m_stats.residentMemory + memorySize > m_settings.memoryBudget)
+      {
+        uint32 lowest = InvalidCell;
+        float lowestPriority = cell.priority + m_settings.cellSize;
+        for (uint32 i = 0; i < (uint32)m_residentCells.size(); ++i)
+        {
+          const Cell& resident = m_cells[m_residentCells[i]];
+          if (resident.state == CellState::Loaded && resident.priority > lowestPriority)
+          {
+            lowest = i;
+            lowestPriority = resident.priority;
+          }
+        }
+
+        if (lowest == InvalidCell)
+          break;
+
+        Unload(lowest);
+        m_stats.evictionCount++;
+      }
+
+      // Farther candidates do not get to skip the queue
+      if (m_stats.residentMemory + memorySize > m_settings.memoryBudget)
+        break;
+
+      cell.state = CellState::Loading;
+      m_residentCells.push_back(index);
+      m_loadRequests.push_back(index);
+      m_stats.residentMemory += memorySize;
+      m_stats.loadingCellCount++;
+      m_stats.loadCount++;
+    }
+    m_stats.peakMemory = std::max(m_stats.peakMemory, m_stats.residentMemory);
+
+    // Cells around the camera that should have been loaded by now
+    const float requiredRadius = m_settings.requiredRadius;
+    if (GetCellRange(cameraPosition.x - requiredRadius, cameraPosition.z - requiredRadius, cameraPosition.x + requiredRadius, cameraPosition.z + requiredRadius,
+      minX, minZ, maxX, maxZ))
+    {
+      for (uint32 z = minZ; z <= maxZ; ++z)
+      {
+        for (uint32 x = minX; x <= maxX; ++x)
+        {
+          const uint32 index = GetCellIndex(x, z);
+          Cell& cell = m_cells[index];
+          if (cell.state == CellState::Loaded)
+            continue;
+
+          const Vec3 center = GetCellCenter(index);
+          const float dx = center.x - cameraPosition.x;
+          const float dz = center.z - cameraPosition.z;
+          if (dx * dx + dz * dz > requiredRadius * requiredRadius)
+            continue;
+
+          m_stats.lateCellFrames++;
+          if (!cell.late)
+          {
+            cell.late = true;
+            m_stats.lateLoadCount++;
+          }
+        }
+      }
+    }
+  }
+
+  void WorldPartition::OnCellLoaded(uint32 cell)
+  {
+    assert(m_cells[cell].state == CellState::Loading && "Cell is not loading!");
+    m_cells[cell].state = CellState::Loaded;
+    m_cells[cell].late = false;
+    m_stats.loadingCellCount--;
+    m_stats.loadedCellCount++;
+  }
+
+  uint32 WorldPartition::GetCellAt(const Vec3& position) const
+  {
+    const float x = floorf((position.x - m_origin.x) / m_settings.cellSize);
+    const float z = floorf((position.z - m_origin.z) / m_settings.cellSize);
+    if (x < 0.0f || z < 0.0f || x >= (float)m_cellCountX || z >= (float)m_cellCountZ)
+      return InvalidCell;
+
+    return GetCellIndex((uint32)x, (uint32)z);
+  }
+
+  Vec3 WorldPartition::GetCellCenter(uint32 cell) const
+  {
+    const uint32 x = cell % m_cellCountX;
+    const uint32 z = cell / m_cellCountX;
+    return Vec3(m_origin.x + (x + 0.5f) * m_settings.cellSize, m_origin.y, m_origin.z + (z + 0.5f) * m_settings.cellSize);
+  }
+
+  void WorldPartition::UpdateDistance(uint32 index)
+  {
+    Cell& cell = m_cells[index];
+    const Vec3 center = GetCellCenter(index);
+
+    const float dx = center.x - m_cameraPosition.x;
+    const float dz = center.z - m_cameraPosition.z;
+    cell.distance = sqrtf(dx * dx + dz * dz);
+
+    const float predictedX = center.x - m_predictedPosition.x;
+    const float predictedZ = center.z - m_predictedPosition.z;
+    // Offset by the required radius so the cells around the camera still load before the ones ahead
+    cell.priority = std::min(cell.distance, sqrtf(predictedX * predictedX + predictedZ * predictedZ) + m_settings.requiredRadius);
+  }
+
+  bool WorldPartition::GetCellRange(float minWorldX, float minWorldZ, float maxWorldX, float maxWorldZ, uint32& minX, uint32& minZ, uint32& maxX, uint32& maxZ) const
+  {
+    const float cellMinX = floorf((minWorldX - m_origin.x) / m_settings.cellSize);
+    const float cellMinZ = floorf((minWorldZ - m_origin.z) / m_settings.cellSize);
+    const float cellMaxX = floorf((maxWorldX - m_origin.x) / m_settings.cellSize);
+    const float cellMaxZ = floorf((maxWorldZ - m_origin.z) / m_settings.cellSize);
+    if (cellMaxX < 0.0f || cellMaxZ < 0.0f || cellMinX >= (float)m_cellCountX || cellMinZ >= (float)m_cellCountZ)
+      return false;
+
+    minX = (uint32)std::max(cellMinX, 0.0f);
+    minZ = (uint32)std::max(cellMinZ, 0.0f);
+    maxX = (uint32)std::min(cellMaxX, (float)(m_cellCountX - 1));
+    maxZ = (uint32)std::min(cellMaxZ, (float)(m_cellCountZ - 1));
+    return true;
+  }
+
+  void WorldPartition::Unload(uint32 residentIndex)
+  {
+    const uint32 index = m_residentCells[residentIndex];
+    Cell& cell = m_cells[index];
+    assert(cell.state == CellState::Loaded && "Only loaded cells can be unloaded!");
+
+    cell.state = CellState::Unloaded;
+    cell.late = false;
+    m_stats.residentMemory -= cell.manifest.memorySize;
+    m_stats.loadedCellCount--;
+    m_stats.unloadCount++;
+    m_unloadRequests.push_back(index);
+
+    m_residentCells[residentIndex] = m_residentCells.back();
+    m_residentCells.pop_back();
+  }
+}
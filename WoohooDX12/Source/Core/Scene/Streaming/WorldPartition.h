@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Maths.h"
+#include "Memory/HandlePool.h"
+
+namespace WoohooDX12
+{
+  // Only the handle, the prefab and its mesh are not needed to run the policy
+  struct Prefab;
+  typedef Handle<Prefab> PrefabHandle;
+
+  struct WorldPartitionSettings
+  {
+    float cellSize = 64.0f;
+    float loadRadius = 192.0f; // Cells closer than this to the camera are loaded
+    float unloadRadius = 256.0f; // Loaded cells farther than this are unloaded, the gap is the hysteresis
+    float requiredRadius = 64.0f; // A cell closer than this to the camera should already be loaded, otherwise it loads late
+    float velocityLookAhead = 2.0f; // Seconds, cells around the predicted camera position load first (capped to the load radius)
+    uint64 memoryBudget = 256ull * 1024 * 1024; // Bytes of the loaded and loading cells
+    uint32 maxConcurrentLoads = 4;
+  };
+
+  // Placement of a prefab in a cell
+  struct CellInstance
+  {
+    PrefabHandle prefab;
+    Vec3 position = ZeroVector;
+    Vec4 rotation = Vec4(0.0f, 0.0f, 0.0f, 1.0f); // Quaternion
+    Vec3 scale = Vec3(1.0f, 1.0f, 1.0f);
+  };
+
+  // Assets of a cell, known before the cell is loaded
+  struct CellManifest
+  {
+    std::vector<CellInstance> instances;
+    uint64 memorySize = 0; // Bytes resident while the cell is loaded
+  };
+
+  enum class CellState : uint8
+  {
+    Unloaded,
+    Loading,
+    Loaded
+  };
+
+  struct StreamingStats
+  {
+    uint64 residentMemory = 0; // Loaded and loading cells
+    uint64 peakMemory = 0;
+    uint32 loadedCellCount = 0;
+    uint32 loadingCellCount = 0;
+    uint32 loadCount = 0;
+    uint32 unloadCount = 0;
+    uint32 evictionCount = 0; // Unloads forced by the memory budget
+    uint32 lateLoadCount = 0; // Cells the camera reached before they were loaded
+    uint32 lateCellFrames = 0; // Sum over frames of the required cells that were not loaded
+  };
+
+  /*
+  * Streaming policy of a world divided into a grid of cells on the XZ plane.
+  * Update() decides which cells to load and unload, the owner does the actual work and reports finished loads with
+  * OnCellLoaded(). Which cells are loaded only depends on the camera position, the velocity only changes the order: a cell's
+  * priority is its distance to the nearer of the camera and the predicted camera position, so the cells the camera is heading
+  * to load before the ones beside or behind it. Loads are limited by the memory budget, a loaded cell with a clearly lower
+  * priority than the candidate is evicted to make room. It has no dependency on the scene, so the policy can be replayed
+  * headless (see StreamingReplay.h).
+  */
+  class WorldPartition
+  {
+  public:
+    static constexpr uint32 InvalidCell = 0xFFFFFFFF;
+
+    WorldPartition() {}
+
+    WorldPartition(const WorldPartition&) = delete;
+    WorldPartition& operator=(const WorldPartition&) = delete;
+
+    void Init(const WorldPartitionSettings& settings, const Vec3& origin, uint32 cellCountX, uint32 cellCountZ);
+    void Clear();
+
+    void SetCellManifest(uint32 cell, CellManifest&& manifest);
+
+    // Fills the load and unload requests of the frame, unloaded cells are Unloaded on return
+    void Update(const Vec3& cameraPosition, const Vec3& cameraVelocity);
+    // Loading cells only become Loaded when the owner reports them
+    void OnCellLoaded(uint32 cell);
+
+    inline const std::vector<uint32>& GetLoadRequests() const { return m_loadRequests; }
+    inline const std::vector<uint32>& GetUnloadRequests() const { return m_unloadRequests; }
+
+    inline uint32 GetCellIndex(uint32 x, uint32 z) const { return z * m_cellCountX + x; }
+    uint32 GetCellAt(const Vec3& position) const; // InvalidCell if outside of the grid
+    Vec3 GetCellCenter(uint32 cell) const;
+    inline uint32 GetCellCount() const { return (uint32)m_cells.size(); }
+    inline CellState GetCellState(uint32 cell) const { return m_cells[cell].state; }
+    inline const CellManifest& GetCellManifest(uint32 cell) const { return m_cells[cell].manifest; }
+    inline const WorldPartitionSettings& GetSettings() const { return m_settings; }
+    inline const StreamingStats& GetStats() const { return m_stats; }
+
+  private:
+    struct Cell
+    {
+      CellManifest manifest;
+      CellState state = CellState::Unloaded;
+      bool late = false; // Required while not loaded, counted once
+      // Valid for the resident cells and the candidates of the frame
+      float distance = 0.0f; // To the camera
+      float priority = 0.0f; // Lower loads first
+    };
+
+    // Distances are measured from the cell centers, on the XZ plane
+    void UpdateDistance(uint32 cell);
+    // Cells overlapping the world space box on the XZ plane, returns false if the box is outside of the grid
+    bool GetCellRange(float minWorldX, float minWorldZ, float maxWorldX, float maxWorldZ, uint32& minX, uint32& minZ, uint32& maxX, uint32& maxZ) const;
+    void Unload(uint32 residentIndex);
+
+  private:
+    WorldPartitionSettings m_settings;
+    Vec3 m_origin = ZeroVector;
+    uint32 m_cellCountX = 0;
+    uint32 m_cellCountZ = 0;
+    std::vector<Cell> m_cells;
+
+    std::vector<uint32> m_residentCells; // Loaded and loading
+    std::vector<uint32> m_candidates; // Scratch
+    std::vector<uint32> m_loadRequests;
+    std::vector<uint32> m_unloadRequests;
+
+    Vec3 m_cameraPosition = ZeroVector;
+    Vec3 m_predictedPosition = ZeroVector;
+
+    StreamingStats m_stats;
+  };
+}
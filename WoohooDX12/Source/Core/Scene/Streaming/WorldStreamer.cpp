@@ -0,0 +1,133 @@
+#include "WorldStreamer.h"
+
+#include <cassert>
+#include "Scene/Scene.h"
+#include "Memory/MemoryTracker.h"
+
+namespace WoohooDX12
+{
+  WorldStreamer::~WorldStreamer()
+  {
+    assert(!m_initialized && "World streamer is not uninitialized!");
+  }
+
+  int WorldStreamer::Init(std::shared_ptr<Scene> scene, const WorldPartitionSettings& settings, const Vec3& origin, uint32 cellCountX, uint32 cellCountZ)
+  {
+    if (m_initialized || scene == nullptr)
+      return -1;
+
+    m_scene = scene;
+    m_partition.Init(settings, origin, cellCountX, cellCountZ);
+    m_cellEntities.resize(m_partition.GetCellCount());
+    m_loadSlots = std::vector<LoadSlot>(settings.maxConcurrentLoads);
+    for (LoadSlot& slot : m_loadSlots)
+      slot.streamer = this;
+
+    m_hasLastCameraPosition = false;
+    m_initialized = true;
+    return 0;
+  }
+
+  int WorldStreamer::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    JobSystem* jobSystem = m_scene->GetJobSystem();
+    for (LoadSlot& slot : m_loadSlots)
+    {
+      if (slot.cell != WorldPartition::InvalidCell && jobSystem != nullptr)
+        jobSystem->Wait(slot.counter);
+    }
+    m_loadSlots.clear();
+
+    for (uint32 cell = 0; cell < (uint32)m_cellEntities.size(); ++cell)
+      RemoveCell(cell);
+    m_cellEntities.clear();
+    m_partition.Clear();
+    m_scene = nullptr;
+
+    m_initialized = false;
+    return 0;
+  }
+
+  void WorldStreamer::Update(float deltaTime)
+  {
+    if (!m_initialized)
+      return;
+
+    WOH_MEMORY_SCOPE(MemoryTag::Scene);
+
+    // Finished loads, before the policy so their cells count as loaded
+    for (LoadSlot& slot : m_loadSlots)
+    {
+      if (slot.cell == WorldPartition::InvalidCell || slot.counter.pending.load(std::memory_order_acquire) > 0)
+        continue;
+
+      InstantiateCell(slot.cell);
+      m_partition.OnCellLoaded(slot.cell);
+      slot.cell = WorldPartition::InvalidCell;
+    }
+
+    const Vec3 position = m_scene->GetCamera().GetPosition();
+    Vec3 velocity = ZeroVector;
+    if (m_hasLastCameraPosition && deltaTime > 0.0f)
+      velocity = Vec3((position.x - m_lastCameraPosition.x) / deltaTime, (position.y - m_lastCameraPosition.y) / deltaTime, (position.z - m_lastCameraPosition.z) / deltaTime);
+    m_lastCameraPosition = position;
+    m_hasLastCameraPosition = true;
+
+    m_partition.Update(position, velocity);
+
+    for (uint32 cell : m_partition.GetUnloadRequests())
+      RemoveCell(cell);
+
+    // The partition never has more loads in flight than there are slots
+    JobSystem* jobSystem = m_scene->GetJobSystem();
+    uint32 slotIndex = 0;
+    for (uint32 cell : m_partition.GetLoadRequests())
+    {
+      while (m_loadSlots[slotIndex].cell != WorldPartition::InvalidCell)
+        slotIndex++;
+
+      LoadSlot& slot = m_loadSlots[slotIndex];
+      slot.cell = cell;
+      if (jobSystem != nullptr)
+        jobSystem->Submit(&WorldStreamer::LoadJob, &slot, 0, 1, &slot.counter);
+      else
+        LoadJob(&slot, 0, 1); // Completed on the next update, like an asynchronous load
+    }
+  }
+
+  void WorldStreamer::LoadJob(void* data, uint32 begin, uint32 end)
+  {
+    const LoadSlot* slot = static_cast<const LoadSlot*>(data);
+    const WorldStreamer* streamer = slot->streamer;
+    if (streamer->m_loadFunction != nullptr)
+      streamer->m_loadFunction(slot->cell, streamer->m_partition.GetCellManifest(slot->cell), streamer->m_loadUserData);
+  }
+
+  void WorldStreamer::InstantiateCell(uint32 cell)
+  {
+    TransformHierarchy& transforms = m_scene->GetTransforms();
+    std::vector<Entity>& entities = m_cellEntities[cell];
+    for (const CellInstance& instance : m_partition.GetCellManifest(cell).instances)
+    {
+      const Entity entity = m_scene->Instantiate(instance.prefab);
+      const TransformComponent* transform = m_scene->GetWorld().Get<TransformComponent>(entity);
+      if (transform == nullptr)
+        continue;
+
+      transforms.SetLocalPosition(transform->transform, instance.position);
+      transforms.SetLocalRotation(transform->transform, instance.rotation);
+      transforms.SetLocalScale(transform->transform, instance.scale);
+      entities.push_back(entity);
+    }
+  }
+
+  void WorldStreamer::RemoveCell(uint32 cell)
+  {
+    for (Entity entity : m_cellEntities[cell])
+      m_scene->RemoveEntity(entity);
+    m_cellEntities[cell].clear();
+  }
+}
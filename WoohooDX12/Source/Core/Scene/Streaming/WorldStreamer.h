@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "WorldPartition.h"
+#include "Jobs/JobSystem.h"
+#include "Scene/ECS/EntityWorld.h"
+
+namespace WoohooDX12
+{
+  class Scene;
+
+  /*
+  * Streams the cells of a world partition in and out of a scene around the scene camera.
+  * Cell loads run on the scene's job system, the entities of a cell are instantiated on the calling thread once its load
+  * finishes, so the scene is only touched in Update(). The scene renderer picks the changes up through the scene journal.
+  */
+  class WorldStreamer
+  {
+  public:
+    // Runs on a worker thread to bring the assets of the cell in (file reads, decompression). Must not touch the scene.
+    typedef void (*CellLoadFunction)(uint32 cell, const CellManifest& manifest, void* userData);
+
+    WorldStreamer() {}
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    // The manifests are set on the partition after Init()
+    int Init(std::shared_ptr<Scene> scene, const WorldPartitionSettings& settings, const Vec3& origin, uint32 cellCountX, uint32 cellCountZ);
+    // Waits for the running loads and removes the streamed entities
+    int UnInit();
+
+    inline void SetCellLoadFunction(CellLoadFunction function, void* userData) { m_loadFunction = function; m_loadUserData = userData; }
+    inline WorldPartition& GetPartition() { return m_partition; }
+
+    // Call before Scene::Update(), so the new entities get their world transforms in the same frame
+    void Update(float deltaTime);
+
+  private:
+    struct LoadSlot
+    {
+      WorldStreamer* streamer = nullptr;
+      uint32 cell = WorldPartition::InvalidCell;
+      JobCounter counter;
+    };
+
+    static void LoadJob(void* data, uint32 begin, uint32 end);
+    void InstantiateCell(uint32 cell);
+    void RemoveCell(uint32 cell);
+
+  private:
+    std::shared_ptr<Scene> m_scene = nullptr;
+    WorldPartition m_partition;
+    std::vector<std::vector<Entity>> m_cellEntities;
+    std::vector<LoadSlot> m_loadSlots; // One per concurrent load
+
+    CellLoadFunction m_loadFunction = nullptr;
+    void* m_loadUserData = nullptr;
+
+    Vec3 m_lastCameraPosition = ZeroVector;
+    bool m_hasLastCameraPosition = false;
+    bool m_initialized = false;
+  };
+}
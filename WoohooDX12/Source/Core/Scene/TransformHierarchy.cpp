@@ -0,0 +1,286 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <type_traits>
+#include "Maths.h"
+#include "Jobs/JobSystem.h"
+
+namespace WoohooDX12
+{
+  TransformHandle TransformHierarchy::Create(TransformHandle parent)
+  {
+    uint32 slotIndex = m_freeSlot;
+    if (slotIndex != InvalidIndex)
+    {
+      m_freeSlot = m_slots[slotIndex].denseIndex;
+    }
+    else
+    {
+      slotIndex = (uint32)m_slots.size();
+      m_slots.push_back(Slot());
+    }
+
+    // Appended at the end, the node is moved to its level by the next re-sort
+    const uint32 denseIndex = (uint32)m_positions.size();
+    m_slots[slotIndex].denseIndex = denseIndex;
+
+    Mat4x4 identity;
+    MakeIdentity(identity);
+
+    m_positions.push_back(ZeroVector);
+    m_rotations.push_back(Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    m_scales.push_back(Vec3(1.0f, 1.0f, 1.0f));
+    m_worldMatrices.push_back(identity);
+    m_parents.push_back(IsValid(parent) ? GetDenseIndex(parent) : InvalidIndex);
+    m_denseToSlot.push_back(slotIndex);
+    m_dirty.push_back(1);
+    m_changed.push_back(0);
+    m_alive.push_back(1);
+
+    m_orderDirty = true;
+    m_anyDirty.store(true, std::memory_order_relaxed);
+
+    TransformHandle handle;
+    handle.index = slotIndex;
+    handle.generation = m_slots[slotIndex].generation;
+    return handle;
+  }
+
+  bool TransformHierarchy::Destroy(TransformHandle node)
+  {
+    if (!IsValid(node))
+      return false;
+
+    // The node data is compacted away by the re-sort, only the handle is released here
+    Slot& slot = m_slots[node.index];
+    m_alive[slot.denseIndex] = 0;
+    m_denseToSlot[slot.denseIndex] = InvalidIndex;
+
+    slot.generation++;
+    slot.denseIndex = m_freeSlot;
+    m_freeSlot = node.index;
+
+    m_orderDirty = true;
+    return true;
+  }
+
+  void TransformHierarchy::SetParent(TransformHandle node, TransformHandle parent)
+  {
+    const uint32 denseIndex = GetDenseIndex(node);
+    const uint32 parentIndex = IsValid(parent) ? GetDenseIndex(parent) : InvalidIndex;
+
+#ifdef WOH_DEBUG
+    for (uint32 ancestor = parentIndex; ancestor != InvalidIndex; ancestor = m_parents[ancestor])
+      assert(ancestor != denseIndex && "Transform can not be parented to its own subtree!");
+#endif
+
+    m_parents[denseIndex] = parentIndex;
+    MarkDirty(denseIndex);
+    m_orderDirty = true;
+  }
+
+  void TransformHierarchy::Clear()
+  {
+    m_freeSlot = InvalidIndex;
+    for (uint32 i = 0; i < (uint32)m_slots.size(); ++i)
+    {
+      m_slots[i].generation++;
+      m_slots[i].denseIndex = m_freeSlot;
+      m_freeSlot = i;
+    }
+
+    m_positions.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_worldMatrices.clear();
+    m_parents.clear();
+    m_denseToSlot.clear();
+    m_dirty.clear();
+    m_changed.clear();
+    m_alive.clear();
+    m_levelOffsets.clear();
+    m_orderDirty = false;
+    m_anyDirty.store(false, std::memory_order_relaxed);
+    m_anyChanged = false;
+  }
+
+  void TransformHierarchy::SetLocalPosition(TransformHandle node, const Vec3& position)
+  {
+    const uint32 denseIndex = GetDenseIndex(node);
+    m_positions[denseIndex] = position;
+    MarkDirty(denseIndex);
+  }
+
+  void TransformHierarchy::SetLocalRotation(TransformHandle node, const Vec4& rotation)
+  {
+    const uint32 denseIndex = GetDenseIndex(node);
+    m_rotations[denseIndex] = rotation;
+    MarkDirty(denseIndex);
+  }
+
+  void TransformHierarchy::SetLocalScale(TransformHandle node, const Vec3& scale)
+  {
+    const uint32 denseIndex = GetDenseIndex(node);
+    m_scales[denseIndex] = scale;
+    MarkDirty(denseIndex);
+  }
+
+  void TransformHierarchy::MarkDirty(uint32 denseIndex)
+  {
+    m_dirty[denseIndex] = 1;
+    if (!m_anyDirty.load(std::memory_order_relaxed))
+      m_anyDirty.store(true, std::memory_order_relaxed);
+  }
+
+  void TransformHierarchy::Update(JobSystem* jobSystem)
+  {
+    if (m_orderDirty)
+      RebuildOrder();
+
+    // Nothing to recompute and the changed flags of the last update are already clear
+    const bool anyDirty = m_anyDirty.exchange(false, std::memory_order_relaxed);
+    if (!anyDirty && !m_anyChanged)
+      return;
+
+    for (uint32 level = 0; level + 1 < (uint32)m_levelOffsets.size(); ++level)
+    {
+      const uint32 begin = m_levelOffsets[level];
+      const uint32 end = m_levelOffsets[level + 1];
+
+      if (jobSystem == nullptr || end - begin <= ParallelBatchSize)
+        UpdateRange(begin, end);
+      else
+        jobSystem->ParallelFor(end - begin, ParallelBatchSize, [this, begin](uint32 first, uint32 last) { UpdateRange(begin + first, begin + last); });
+    }
+
+    m_anyChanged = anyDirty;
+  }
+
+  void TransformHierarchy::UpdateRange(uint32 begin, uint32 end)
+  {
+    const DirectX::XMVECTOR origin = DirectX::XMVectorZero();
+
+    for (uint32 i = begin; i < end; ++i)
+    {
+      // Parents are on the previous level, their flags are final
+      const uint32 parent = m_parents[i];
+      const uint8 changed = m_dirty[i] | (parent != InvalidIndex ? m_changed[parent] : 0);
+      m_changed[i] = changed;
+      m_dirty[i] = 0;
+
+      if (!changed)
+        continue;
+
+      Mat world = DirectX::XMMatrixAffineTransformation(DirectX::XMLoadFloat3(&m_scales[i]), origin,
+        DirectX::XMLoadFloat4(&m_rotations[i]), DirectX::XMLoadFloat3(&m_positions[i]));
+      if (parent != InvalidIndex)
+        world = DirectX::XMMatrixMultiply(world, DirectX::XMLoadFloat4x4(&m_worldMatrices[parent]));
+
+      DirectX::XMStoreFloat4x4(&m_worldMatrices[i], world);
+    }
+  }
+
+  void TransformHierarchy::RebuildOrder()
+  {
+    const uint32 count = (uint32)m_positions.size();
+
+    // Resolve depths top-down along each unresolved chain, a node under a destroyed ancestor is destroyed too
+    m_depths.assign(count, InvalidIndex);
+    uint32 maxDepth = 0;
+    for (uint32 i = 0; i < count; ++i)
+    {
+      if (m_depths[i] != InvalidIndex)
+        continue;
+
+      m_chain.clear();
+      for (uint32 node = i; ; node = m_parents[node])
+      {
+        m_chain.push_back(node);
+        if (m_parents[node] == InvalidIndex || m_depths[m_parents[node]] != InvalidIndex)
+          break;
+      }
+
+      for (uint32 j = (uint32)m_chain.size(); j-- > 0;)
+      {
+        const uint32 node = m_chain[j];
+        const uint32 parent = m_parents[node];
+        if (parent == InvalidIndex)
+        {
+          m_depths[node] = 0;
+          continue;
+        }
+
+        m_depths[node] = m_depths[parent] + 1;
+        if (!m_alive[parent])
+          m_alive[node] = 0;
+      }
+    }
+
+    // Release the slots of the descendants destroyed with their ancestor
+    for (uint32 i = 0; i < count; ++i)
+    {
+      if (m_alive[i])
+      {
+        maxDepth = std::max(maxDepth, m_depths[i]);
+      }
+      else if (m_denseToSlot[i] != InvalidIndex)
+      {
+        Slot& slot = m_slots[m_denseToSlot[i]];
+        slot.generation++;
+        slot.denseIndex = m_freeSlot;
+        m_freeSlot = m_denseToSlot[i];
+        m_denseToSlot[i] = InvalidIndex;
+      }
+    }
+
+    // Counting sort by depth, stable so the order inside a level is kept
+    m_levelOffsets.assign(maxDepth + 2, 0);
+    for (uint32 i = 0; i < count; ++i)
+    {
+      if (m_alive[i])
+        m_levelOffsets[m_depths[i] + 1]++;
+    }
+    for (uint32 level = 1; level < (uint32)m_levelOffsets.size(); ++level)
+      m_levelOffsets[level] += m_levelOffsets[level - 1];
+
+    m_chain.assign(m_levelOffsets.begin(), m_levelOffsets.end() - 1); // Insertion cursor per level
+    m_newIndices.assign(count, InvalidIndex);
+    for (uint32 i = 0; i < count; ++i)
+    {
+      if (m_alive[i])
+        m_newIndices[i] = m_chain[m_depths[i]]++;
+    }
+
+    const uint32 newCount = m_levelOffsets.back();
+    auto permute = [&](auto& values)
+      {
+        typename std::remove_reference<decltype(values)>::type sorted(newCount);
+        for (uint32 i = 0; i < count; ++i)
+        {
+          if (m_newIndices[i] != InvalidIndex)
+            sorted[m_newIndices[i]] = values[i];
+        }
+        values.swap(sorted);
+      };
+
+    permute(m_positions);
+    permute(m_rotations);
+    permute(m_scales);
+    permute(m_worldMatrices);
+    permute(m_parents);
+    permute(m_denseToSlot);
+    permute(m_dirty);
+    permute(m_changed);
+    m_alive.assign(newCount, 1);
+
+    for (uint32 i = 0; i < newCount; ++i)
+    {
+      if (m_parents[i] != InvalidIndex)
+        m_parents[i] = m_newIndices[m_parents[i]];
+
+      m_slots[m_denseToSlot[i]].denseIndex = i;
+    }
+
+    m_orderDirty = false;
+  }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <vector>
+#include "Types.h"
+#include "Memory/HandlePool.h"
+
+namespace WoohooDX12
+{
+  class JobSystem;
+
+  struct TransformNode;
+  typedef Handle<TransformNode> TransformHandle;
+
+  /*
+  * Transform hierarchy stored as SoA arrays sorted by depth, roots first.
+  * Setting a local transform only marks the node dirty, Update() walks the levels in order so a parent is always
+  * resolved before its children, and recomputes the world matrices of the dirty nodes and of their subtrees.
+  * The nodes of one level are independent, large levels are split over the job system.
+  * Structural changes (create, destroy, reparent) re-sort the arrays on the next Update().
+  */
+  class TransformHierarchy
+  {
+  public:
+    TransformHierarchy() {}
+
+    TransformHierarchy(const TransformHierarchy&) = delete;
+    TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+    TransformHandle Create(TransformHandle parent = TransformHandle());
+    // Children of the node are destroyed with it on the next Update()
+    bool Destroy(TransformHandle node);
+    void SetParent(TransformHandle node, TransformHandle parent);
+    void Clear();
+
+    inline bool IsValid(TransformHandle node) const
+    {
+      return node.index < m_slots.size() && m_slots[node.index].generation == node.generation;
+    }
+
+    // Setters may be called concurrently for different nodes
+    void SetLocalPosition(TransformHandle node, const Vec3& position);
+    void SetLocalRotation(TransformHandle node, const Vec4& rotation); // Quaternion
+    void SetLocalScale(TransformHandle node, const Vec3& scale);
+
+    inline const Vec3& GetLocalPosition(TransformHandle node) const { return m_positions[GetDenseIndex(node)]; }
+    inline const Vec4& GetLocalRotation(TransformHandle node) const { return m_rotations[GetDenseIndex(node)]; }
+    inline const Vec3& GetLocalScale(TransformHandle node) const { return m_scales[GetDenseIndex(node)]; }
+
+    // Valid after Update()
+    inline const Mat4x4& GetWorldMatrix(TransformHandle node) const { return m_worldMatrices[GetDenseIndex(node)]; }
+    // True if the world matrix was recomputed by the last Update()
+    inline bool HasWorldChanged(TransformHandle node) const { return m_changed[GetDenseIndex(node)] != 0; }
+
+    void Update(JobSystem* jobSystem);
+
+    inline uint32 GetCount() const { return (uint32)m_positions.size(); }
+    inline uint32 GetDepthCount() const { return m_levelOffsets.empty() ? 0 : (uint32)m_levelOffsets.size() - 1; }
+
+  private:
+    static constexpr uint32 InvalidIndex = 0xFFFFFFFF;
+    static constexpr uint32 ParallelBatchSize = 512; // Levels smaller than this are updated on the calling thread
+
+    struct Slot
+    {
+      uint32 denseIndex = InvalidIndex; // Next free slot when the slot is not used
+      uint32 generation = 1;
+    };
+
+    inline uint32 GetDenseIndex(TransformHandle node) const
+    {
+      assert(IsValid(node) && "Transform handle is not valid!");
+      return m_slots[node.index].denseIndex;
+    }
+
+    void MarkDirty(uint32 denseIndex);
+    void RebuildOrder();
+    void UpdateRange(uint32 begin, uint32 end);
+
+  private:
+    std::vector<Slot> m_slots;
+    uint32 m_freeSlot = InvalidIndex;
+
+    // SoA node data, indexed by dense index
+    std::vector<Vec3> m_positions;
+    std::vector<Vec4> m_rotations;
+    std::vector<Vec3> m_scales;
+    std::vector<Mat4x4> m_worldMatrices;
+    std::vector<uint32> m_parents; // Dense index of the parent, InvalidIndex for roots
+    std::vector<uint32> m_denseToSlot;
+    std::vector<uint8> m_dirty;
+    std::vector<uint8> m_changed;
+    std::vector<uint8> m_alive;
+
+    // Nodes of depth d are in [m_levelOffsets[d], m_levelOffsets[d + 1])
+    std::vector<uint32> m_levelOffsets;
+    bool m_orderDirty = false;
+    std::atomic<bool> m_anyDirty = false;
+    bool m_anyChanged = false;
+
+    // Scratch for re-sorting
+    std::vector<uint32> m_depths;
+    std::vector<uint32> m_newIndices;
+    std::vector<uint32> m_chain;
+  };
+}
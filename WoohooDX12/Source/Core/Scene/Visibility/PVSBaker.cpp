@@ -0,0 +1,443 @@
+#include "PVSBaker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include "Jobs/JobSystem.h"
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+
+    inline float GetMilliseconds(Clock::time_point begin)
+    {
+      return std::chrono::duration<float, std::milli>(Clock::now() - begin).count();
+    }
+
+    // Small and fast, one per cell so the result does not depend on the scheduling
+    struct Random
+    {
+      uint64 state;
+
+      explicit Random(uint64 seed) : state(seed * 6364136223846793005ull + 1442695040888963407ull) { Next(); }
+
+      inline uint32 Next()
+      {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const uint32 xorShifted = (uint32)(((state >> 18) ^ state) >> 27);
+        const uint32 rotation = (uint32)(state >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+      }
+
+      // [0, 1)
+      inline float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+      inline Vec3 NextPoint(const AABB& box)
+      {
+        return Vec3(box.min.x + (box.max.x - box.min.x) * NextFloat(), box.min.y + (box.max.y - box.min.y) * NextFloat(),
+          box.min.z + (box.max.z - box.min.z) * NextFloat());
+      }
+    };
+
+    inline Vec3 Sub(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+    inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vec3 Cross(const Vec3& a, const Vec3& b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+    // Separating axis test of a triangle against a box at the origin (Akenine-Möller)
+    bool TriangleOverlapsBox(const Vec3& v0, const Vec3& v1, const Vec3& v2, const Vec3& halfSize)
+    {
+      const Vec3 edges[3] = { Sub(v1, v0), Sub(v2, v1), Sub(v0, v2) };
+      const Vec3 axes[3] = { Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f), Vec3(0.0f, 0.0f, 1.0f) };
+
+      // Cross products of the edges and the box axes
+      for (const Vec3& edge : edges)
+      {
+        for (const Vec3& boxAxis : axes)
+        {
+          const Vec3 axis = Cross(boxAxis, edge);
+          const float p0 = Dot(v0, axis);
+          const float p1 = Dot(v1, axis);
+          const float p2 = Dot(v2, axis);
+          const float radius = halfSize.x * fabsf(axis.x) + halfSize.y * fabsf(axis.y) + halfSize.z * fabsf(axis.z);
+          if (std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius)
+            return false;
+        }
+      }
+
+      // Box faces, the triangle's bounds against the box
+      if (std::min(v0.x, std::min(v1.x, v2.x)) > halfSize.x || std::max(v0.x, std::max(v1.x, v2.x)) < -halfSize.x)
+        return false;
+      if (std::min(v0.y, std::min(v1.y, v2.y)) > halfSize.y || std::max(v0.y, std::max(v1.y, v2.y)) < -halfSize.y)
+        return false;
+      if (std::min(v0.z, std::min(v1.z, v2.z)) > halfSize.z || std::max(v0.z, std::max(v1.z, v2.z)) < -halfSize.z)
+        return false;
+
+      // Triangle plane
+      const Vec3 normal = Cross(edges[0], edges[1]);
+      const float distance = Dot(normal, v0);
+      const float radius = halfSize.x * fabsf(normal.x) + halfSize.y * fabsf(normal.y) + halfSize.z * fabsf(normal.z);
+      return fabsf(distance) <= radius;
+    }
+
+    inline AABB Expand(const AABB& box, float amount)
+    {
+      AABB result;
+      result.min = Vec3(box.min.x - amount, box.min.y - amount, box.min.z - amount);
+      result.max = Vec3(box.max.x + amount, box.max.y + amount, box.max.z + amount);
+      return result;
+    }
+  }
+
+  void PVSBaker::Clear()
+  {
+    m_triangles.clear();
+    m_objects.clear();
+    m_voxels.clear();
+    m_cellBits.clear();
+    m_cellEmpty.clear();
+    m_stats = PVSBakeStats();
+  }
+
+  void PVSBaker::AddOccluder(const float* positions, uint32 stride, const uint32* indices, uint32 triangleCount, const Mat4x4& world)
+  {
+    const uint8* bytes = reinterpret_cast<const uint8*>(positions);
+
+    m_triangles.reserve(m_triangles.size() + (size_t)triangleCount * 9);
+    for (uint32 i = 0; i < triangleCount * 3; ++i)
+    {
+      const float* p = reinterpret_cast<const float*>(bytes + (size_t)indices[i] * stride);
+      m_triangles.push_back(p[0] * world._11 + p[1] * world._21 + p[2] * world._31 + world._41);
+      m_triangles.push_back(p[0] * world._12 + p[1] * world._22 + p[2] * world._32 + world._42);
+      m_triangles.push_back(p[0] * world._13 + p[1] * world._23 + p[2] * world._33 + world._43);
+    }
+  }
+
+  uint32 PVSBaker::AddObject(const AABB& worldBounds)
+  {
+    m_objects.push_back(worldBounds);
+    return (uint32)m_objects.size() - 1;
+  }
+
+  int PVSBaker::Bake(const PVSBakeSettings& settings, JobSystem* jobSystem, PotentiallyVisibleSet& result, ProgressFunction progress, void* progressData)
+  {
+    assert(settings.voxelSize > 0.0f && settings.viewCellSize >= settings.voxelSize && "Invalid bake settings!");
+
+    result.Clear();
+    if (m_objects.empty())
+      return -1;
+
+    m_settings = settings;
+    m_stats = PVSBakeStats();
+
+    // Scene bounds with an empty border, rounded up to whole view cells
+    AABB bounds = m_objects[0];
+    for (const AABB& object : m_objects)
+      bounds = AABB::Union(bounds, object);
+    for (size_t i = 0; i < m_triangles.size(); i += 3)
+    {
+      bounds.min = Vec3(std::min(bounds.min.x, m_triangles[i]), std::min(bounds.min.y, m_triangles[i + 1]), std::min(bounds.min.z, m_triangles[i + 2]));
+      bounds.max = Vec3(std::max(bounds.max.x, m_triangles[i]), std::max(bounds.max.y, m_triangles[i + 1]), std::max(bounds.max.z, m_triangles[i + 2]));
+    }
+    bounds = Expand(bounds, settings.voxelSize);
+
+    m_cellsX = std::max(1u, (uint32)ceilf((bounds.max.x - bounds.min.x) / settings.viewCellSize));
+    m_cellsY = std::max(1u, (uint32)ceilf((bounds.max.y - bounds.min.y) / settings.viewCellSize));
+    m_cellsZ = std::max(1u, (uint32)ceilf((bounds.max.z - bounds.min.z) / settings.viewCellSize));
+    bounds.max = Vec3(bounds.min.x + m_cellsX * settings.viewCellSize, bounds.min.y + m_cellsY * settings.viewCellSize, bounds.min.z + m_cellsZ * settings.viewCellSize);
+    m_bounds = bounds;
+
+    m_voxelsX = (uint32)ceilf((bounds.max.x - bounds.min.x) / settings.voxelSize);
+    m_voxelsY = (uint32)ceilf((bounds.max.y - bounds.min.y) / settings.voxelSize);
+    m_voxelsZ = (uint32)ceilf((bounds.max.z - bounds.min.z) / settings.voxelSize);
+
+    Clock::time_point begin = Clock::now();
+    Voxelize(jobSystem);
+    m_stats.voxelizeMilliseconds = GetMilliseconds(begin);
+
+    // Visibility of the cells
+    begin = Clock::now();
+    const uint32 cellCount = m_cellsX * m_cellsY * m_cellsZ;
+    m_wordCount = (GetObjectCount() + 31) / 32;
+    m_cellBits.assign((size_t)cellCount * m_wordCount, 0);
+    m_cellEmpty.assign(cellCount, 0);
+    m_stats.viewCellCount = cellCount;
+    m_rayCount = 0;
+
+    std::atomic<uint32> doneCount = 0;
+    std::mutex progressMutex;
+    auto bakeCells = [&](uint32 first, uint32 last)
+      {
+        for (uint32 cell = first; cell < last; ++cell)
+        {
+          BakeCell(cell);
+
+          const uint32 done = ++doneCount;
+          if (progress)
+          {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progress(done, cellCount, progressData);
+          }
+        }
+      };
+
+    if (jobSystem)
+      jobSystem->ParallelFor(cellCount, 4, bakeCells);
+    else
+      bakeCells(0, cellCount);
+
+    // Merged into a copy so a cell does not see through its neighbours' neighbours
+    if (settings.mergeNeighbours)
+    {
+      std::vector<uint32> merged = m_cellBits;
+      for (uint32 z = 0; z < m_cellsZ; ++z)
+      {
+        for (uint32 y = 0; y < m_cellsY; ++y)
+        {
+          for (uint32 x = 0; x < m_cellsX; ++x)
+          {
+            const uint32 cell = (z * m_cellsY + y) * m_cellsX + x;
+            if (m_cellEmpty[cell])
+              continue;
+
+            const int32 offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+            for (const int32* offset : offsets)
+            {
+              const int32 nx = (int32)x + offset[0];
+              const int32 ny = (int32)y + offset[1];
+              const int32 nz = (int32)z + offset[2];
+              if (nx < 0 || ny < 0 || nz < 0 || nx >= (int32)m_cellsX || ny >= (int32)m_cellsY || nz >= (int32)m_cellsZ)
+                continue;
+
+              // Empty neighbours see everything, they are not a sample of this cell
+              const uint32 neighbour = (nz * m_cellsY + ny) * m_cellsX + nx;
+              if (m_cellEmpty[neighbour])
+                continue;
+
+              uint32* target = merged.data() + (size_t)cell * m_wordCount;
+              const uint32* source = m_cellBits.data() + (size_t)neighbour * m_wordCount;
+              for (uint32 i = 0; i < m_wordCount; ++i)
+                target[i] |= source[i];
+            }
+          }
+        }
+      }
+      m_cellBits.swap(merged);
+    }
+    m_stats.visibilityMilliseconds = GetMilliseconds(begin);
+    m_stats.rayCount = m_rayCount;
+
+    begin = Clock::now();
+    result.Init(bounds, settings.viewCellSize, m_cellsX, m_cellsY, m_cellsZ, GetObjectCount());
+    for (uint32 cell = 0; cell < cellCount; ++cell)
+    {
+      if (m_cellEmpty[cell])
+      {
+        m_stats.emptyViewCellCount++;
+        continue;
+      }
+
+      const uint32* bits = m_cellBits.data() + (size_t)cell * m_wordCount;
+      result.SetCellVisibility(cell, bits);
+      for (uint32 i = 0; i < m_wordCount; ++i)
+        m_stats.visiblePairCount += std::bitset<32>(bits[i]).count();
+    }
+    m_stats.compressMilliseconds = GetMilliseconds(begin);
+    m_stats.uncompressedSize = (uint64)cellCount * m_wordCount * sizeof(uint32);
+    m_stats.compressedSize = result.GetCompressedSize();
+
+    m_cellBits.clear();
+    m_cellBits.shrink_to_fit();
+    return 0;
+  }
+
+  void PVSBaker::Voxelize(JobSystem* jobSystem)
+  {
+    m_voxels.assign((size_t)m_voxelsX * m_voxelsY * m_voxelsZ, 0);
+    m_stats.voxelCount = (uint32)m_voxels.size();
+
+    const float voxelSize = m_settings.voxelSize;
+    const Vec3 halfSize(voxelSize * 0.5f, voxelSize * 0.5f, voxelSize * 0.5f);
+    const uint32 triangleCount = GetOccluderTriangleCount();
+
+    // Slabs of voxel layers are independent, every job goes over the triangles crossing its slab
+    auto voxelizeSlab = [&](uint32 firstZ, uint32 lastZ)
+      {
+        for (uint32 t = 0; t < triangleCount; ++t)
+        {
+          const float* p = m_triangles.data() + (size_t)t * 9;
+          const Vec3 v0(p[0], p[1], p[2]);
+          const Vec3 v1(p[3], p[4], p[5]);
+          const Vec3 v2(p[6], p[7], p[8]);
+
+          auto toVoxel = [&](float value, float origin, uint32 count)
+            {
+              return (uint32)std::min(std::max((value - origin) / voxelSize, 0.0f), (float)(count - 1));
+            };
+
+          const uint32 minZ = std::max(toVoxel(std::min(v0.z, std::min(v1.z, v2.z)), m_bounds.min.z, m_voxelsZ), firstZ);
+          const uint32 maxZ = std::min(toVoxel(std::max(v0.z, std::max(v1.z, v2.z)), m_bounds.min.z, m_voxelsZ), lastZ - 1);
+          if (minZ > maxZ)
+            continue;
+
+          const uint32 minX = toVoxel(std::min(v0.x, std::min(v1.x, v2.x)), m_bounds.min.x, m_voxelsX);
+          const uint32 maxX = toVoxel(std::max(v0.x, std::max(v1.x, v2.x)), m_bounds.min.x, m_voxelsX);
+          const uint32 minY = toVoxel(std::min(v0.y, std::min(v1.y, v2.y)), m_bounds.min.y, m_voxelsY);
+          const uint32 maxY = toVoxel(std::max(v0.y, std::max(v1.y, v2.y)), m_bounds.min.y, m_voxelsY);
+
+          for (uint32 z = minZ; z <= maxZ; ++z)
+          {
+            for (uint32 y = minY; y <= maxY; ++y)
+            {
+              for (uint32 x = minX; x <= maxX; ++x)
+              {
+                const uint32 index = GetVoxelIndex(x, y, z);
+                if (m_voxels[index])
+                  continue;
+
+                const Vec3 center(m_bounds.min.x + (x + 0.5f) * voxelSize, m_bounds.min.y + (y + 0.5f) * voxelSize, m_bounds.min.z + (z + 0.5f) * voxelSize);
+                if (TriangleOverlapsBox(Sub(v0, center), Sub(v1, center), Sub(v2, center), halfSize))
+                  m_voxels[index] = 1;
+              }
+            }
+          }
+        }
+      };
+
+    if (jobSystem)
+      jobSystem->ParallelFor(m_voxelsZ, 4, voxelizeSlab);
+    else
+      voxelizeSlab(0, m_voxelsZ);
+
+    for (uint8 voxel : m_voxels)
+      m_stats.solidVoxelCount += voxel;
+  }
+
+  void PVSBaker::BakeCell(uint32 cell)
+  {
+    const uint32 cellX = cell % m_cellsX;
+    const uint32 cellY = (cell / m_cellsX) % m_cellsY;
+    const uint32 cellZ = cell / (m_cellsX * m_cellsY);
+    const float cellSize = m_settings.viewCellSize;
+
+    AABB cellBox;
+    cellBox.min = Vec3(m_bounds.min.x + cellX * cellSize, m_bounds.min.y + cellY * cellSize, m_bounds.min.z + cellZ * cellSize);
+    cellBox.max = Vec3(cellBox.min.x + cellSize, cellBox.min.y + cellSize, cellBox.min.z + cellSize);
+
+    Random random(((uint64)m_settings.seed << 32) ^ cell);
+
+    // Ray origins in the empty voxels of the cell, a camera can not be inside a wall
+    Vec3 origins[PVSBakeSettings::MaxViewSamplesPerCell];
+    const uint32 maxOrigins = std::min(m_settings.viewSamplesPerCell, PVSBakeSettings::MaxViewSamplesPerCell);
+    uint32 originCount = 0;
+    for (uint32 attempt = 0; attempt < maxOrigins * 4 && originCount < maxOrigins; ++attempt)
+    {
+      const Vec3 point = random.NextPoint(cellBox);
+      const uint32 x = std::min((uint32)((point.x - m_bounds.min.x) / m_settings.voxelSize), m_voxelsX - 1);
+      const uint32 y = std::min((uint32)((point.y - m_bounds.min.y) / m_settings.voxelSize), m_voxelsY - 1);
+      const uint32 z = std::min((uint32)((point.z - m_bounds.min.z) / m_settings.voxelSize), m_voxelsZ - 1);
+      if (!IsSolid(GetVoxelIndex(x, y, z)))
+        origins[originCount++] = point;
+    }
+
+    uint32* bits = m_cellBits.data() + (size_t)cell * m_wordCount;
+    if (originCount == 0)
+    {
+      m_cellEmpty[cell] = 1;
+      std::fill(bits, bits + m_wordCount, 0xFFFFFFFF);
+      return;
+    }
+
+    // Voxels stick out of the surfaces by up to one voxel, the targets grow by as much so they are not hidden behind them
+    const AABB nearBox = Expand(cellBox, m_settings.voxelSize);
+    uint64 rayCount = 0;
+    for (uint32 object = 0; object < GetObjectCount(); ++object)
+    {
+      const AABB target = Expand(m_objects[object], m_settings.voxelSize);
+      bool visible = target.Overlaps(nearBox);
+      for (uint32 ray = 0; ray < m_settings.raysPerObject && !visible; ++ray)
+      {
+        rayCount++;
+        visible = IsUnblocked(origins[ray % originCount], random.NextPoint(target), target);
+      }
+
+      if (visible)
+        bits[object >> 5] |= 1u << (object & 31);
+    }
+
+    m_rayCount += rayCount;
+  }
+
+  bool PVSBaker::IsUnblocked(const Vec3& origin, const Vec3& target, const AABB& box) const
+  {
+    const float direction[3] = { target.x - origin.x, target.y - origin.y, target.z - origin.z };
+    const float start[3] = { origin.x, origin.y, origin.z };
+    const float boxMin[3] = { box.min.x, box.min.y, box.min.z };
+    const float boxMax[3] = { box.max.x, box.max.y, box.max.z };
+    const float gridMin[3] = { m_bounds.min.x, m_bounds.min.y, m_bounds.min.z };
+    const uint32 gridSize[3] = { m_voxelsX, m_voxelsY, m_voxelsZ };
+    const float voxelSize = m_settings.voxelSize;
+
+    // Where the segment enters the box, the target is inside so it is before the end
+    float enter = 0.0f;
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+      if (fabsf(direction[axis]) < 1e-12f)
+        continue;
+
+      const float t0 = (boxMin[axis] - start[axis]) / direction[axis];
+      const float t1 = (boxMax[axis] - start[axis]) / direction[axis];
+      enter = std::max(enter, std::min(t0, t1));
+    }
+
+    // Voxel traversal (Amanatides & Woo) until the box is reached
+    int32 voxel[3];
+    int32 step[3];
+    float next[3];
+    float delta[3];
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+      voxel[axis] = std::min((int32)((start[axis] - gridMin[axis]) / voxelSize), (int32)gridSize[axis] - 1);
+      if (direction[axis] > 0.0f)
+      {
+        step[axis] = 1;
+        delta[axis] = voxelSize / direction[axis];
+        next[axis] = (gridMin[axis] + (voxel[axis] + 1) * voxelSize - start[axis]) / direction[axis];
+      }
+      else if (direction[axis] < 0.0f)
+      {
+        step[axis] = -1;
+        delta[axis] = -voxelSize / direction[axis];
+        next[axis] = (gridMin[axis] + voxel[axis] * voxelSize - start[axis]) / direction[axis];
+      }
+      else
+      {
+        step[axis] = 0;
+        delta[axis] = FLT_MAX;
+        next[axis] = FLT_MAX;
+      }
+    }
+
+    float t = 0.0f;
+    while (t < enter)
+    {
+      if (IsSolid(GetVoxelIndex(voxel[0], voxel[1], voxel[2])))
+        return false;
+
+      const uint32 axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+      t = next[axis];
+      voxel[axis] += step[axis];
+      if (voxel[axis] < 0 || voxel[axis] >= (int32)gridSize[axis])
+        return true; // Left the grid, the box is outside of it
+      next[axis] += delta[axis];
+    }
+
+    return true;
+  }
+}
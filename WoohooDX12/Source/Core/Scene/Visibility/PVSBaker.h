@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "Types.h"
+#include "Maths.h"
+#include "Scene/Spatial/AABBTree.h"
+#include "PotentiallyVisibleSet.h"
+
+namespace WoohooDX12
+{
+  class JobSystem;
+
+  struct PVSBakeSettings
+  {
+    static constexpr uint32 MaxViewSamplesPerCell = 256;
+
+    float viewCellSize = 4.0f;
+    float voxelSize = 0.5f; // Resolution of the occluders, gaps narrower than two voxels may be closed
+    uint32 viewSamplesPerCell = 32; // Ray origins, spread over the empty space of the cell
+    uint32 raysPerObject = 64; // Per cell and object, stops at the first unblocked ray
+    bool mergeNeighbours = true; // A cell also sees what its 6 neighbours see, hides sampling misses at cell borders
+    uint32 seed = 1;
+  };
+
+  struct PVSBakeStats
+  {
+    uint32 voxelCount = 0;
+    uint32 solidVoxelCount = 0;
+    uint32 viewCellCount = 0;
+    uint32 emptyViewCellCount = 0; // Completely inside solid geometry, they see everything
+    uint64 rayCount = 0;
+    uint64 visiblePairCount = 0;
+    float voxelizeMilliseconds = 0.0f;
+    float visibilityMilliseconds = 0.0f;
+    float compressMilliseconds = 0.0f;
+    uint64 uncompressedSize = 0;
+    uint64 compressedSize = 0;
+  };
+
+  /*
+  * Offline baker of a PotentiallyVisibleSet for a static scene.
+  * The occluder triangles are voxelized into a shell of solid voxels that a ray marching from voxel to voxel can not cross.
+  * For every view cell, rays from points in the empty space of the cell to points in each object's box are marched
+  * through the voxels, an object is visible if one of them reaches the box.
+  * A ray only has to reach the object's box, not its surface, so objects do not hide behind their own voxels.
+  * Sampling can miss thin gaps, it is made conservative where it is cheap: objects overlapping a cell are always visible
+  * from it and cells can merge their neighbours' visibility. Cells are baked in parallel, each cell has its own random
+  * sequence so the result does not depend on the thread count.
+  */
+  class PVSBaker
+  {
+  public:
+    // Called from the worker threads one at a time, after each cell
+    typedef void (*ProgressFunction)(uint32 doneCount, uint32 totalCount, void* userData);
+
+    PVSBaker() {}
+
+    PVSBaker(const PVSBaker&) = delete;
+    PVSBaker& operator=(const PVSBaker&) = delete;
+
+    void Clear();
+
+    // Positions are 3 floats at the given stride, transformed by the world matrix (row vector convention)
+    void AddOccluder(const float* positions, uint32 stride, const uint32* indices, uint32 triangleCount, const Mat4x4& world);
+    // Returns the object index in the baked set
+    uint32 AddObject(const AABB& worldBounds);
+
+    int Bake(const PVSBakeSettings& settings, JobSystem* jobSystem, PotentiallyVisibleSet& result, ProgressFunction progress = nullptr, void* progressData = nullptr);
+
+    inline uint32 GetObjectCount() const { return (uint32)m_objects.size(); }
+    inline uint32 GetOccluderTriangleCount() const { return (uint32)m_triangles.size() / 9; }
+    inline const PVSBakeStats& GetStats() const { return m_stats; }
+
+  private:
+    void Voxelize(JobSystem* jobSystem);
+    void BakeCell(uint32 cell);
+    // Returns true if the segment from origin towards target reaches the box before a solid voxel
+    bool IsUnblocked(const Vec3& origin, const Vec3& target, const AABB& box) const;
+
+    inline uint32 GetVoxelIndex(uint32 x, uint32 y, uint32 z) const { return (z * m_voxelsY + y) * m_voxelsX + x; }
+    inline bool IsSolid(uint32 index) const { return m_voxels[index] != 0; }
+
+  private:
+    std::vector<float> m_triangles; // World space, 9 floats per triangle
+    std::vector<AABB> m_objects;
+
+    PVSBakeSettings m_settings;
+    AABB m_bounds;
+    uint32 m_voxelsX = 0;
+    uint32 m_voxelsY = 0;
+    uint32 m_voxelsZ = 0;
+    std::vector<uint8> m_voxels; // 0 empty, 1 solid
+    uint32 m_cellsX = 0;
+    uint32 m_cellsY = 0;
+    uint32 m_cellsZ = 0;
+    uint32 m_wordCount = 0;
+    std::vector<uint32> m_cellBits; // m_wordCount words per view cell
+    std::vector<uint8> m_cellEmpty; // No ray origin in the cell
+
+    std::atomic<uint64> m_rayCount = 0;
+    PVSBakeStats m_stats;
+  };
+}
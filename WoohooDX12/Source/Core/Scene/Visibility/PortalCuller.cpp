@@ -0,0 +1,220 @@
+#include "PortalCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  namespace
+  {
+    static constexpr uint32 NoPortal = 0xFFFFFFFF;
+    // A portal clipped by every plane of a frustum
+    static constexpr uint32 MaxClipVertices = PortalGraph::MaxPortalVertices + PortalCuller::MaxPlanes;
+
+    inline float GetDistance(const Vec4& plane, const Vec3& point)
+    {
+      return plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w;
+    }
+
+    // Sutherland-Hodgman, keeps the part in front of the plane
+    uint32 ClipPolygon(const Vec3* input, uint32 count, const Vec4& plane, Vec3* output)
+    {
+      uint32 outputCount = 0;
+      for (uint32 i = 0; i < count; ++i)
+      {
+        const Vec3& a = input[i];
+        const Vec3& b = input[(i + 1) % count];
+        const float distanceA = GetDistance(plane, a);
+        const float distanceB = GetDistance(plane, b);
+
+        if (distanceA >= 0.0f)
+          output[outputCount++] = a;
+        if ((distanceA >= 0.0f) != (distanceB >= 0.0f))
+        {
+          const float t = distanceA / (distanceA - distanceB);
+          output[outputCount++] = Vec3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+        }
+      }
+      return outputCount;
+    }
+  }
+
+  bool PortalCuller::Cull(const PortalGraph& graph, const Frustum& viewFrustum, const Vec3& eye)
+  {
+    m_stats = PortalCullStats();
+    m_visibleCells.clear();
+    m_frustums.clear();
+    m_stack.clear();
+
+    const uint32 cellCount = graph.GetCellCount();
+    if (m_cellStamps.size() != cellCount)
+    {
+      m_cellStamps.assign(cellCount, 0);
+      m_cellFrustumCounts.assign(cellCount, 0);
+      m_cellFrustums.resize((size_t)cellCount * MaxFrustumsPerCell);
+    }
+
+    // Stamps save clearing the cells every frame
+    if (++m_stamp == 0)
+    {
+      std::fill(m_cellStamps.begin(), m_cellStamps.end(), 0);
+      m_stamp = 1;
+    }
+
+    const uint32 startCell = graph.FindCell(eye);
+    if (startCell == PortalGraph::InvalidCell)
+      return false;
+
+    PortalFrustum view;
+    std::copy(viewFrustum.planes, viewFrustum.planes + 6, view.planes);
+    view.planeCount = 6;
+    m_frustums.push_back(view);
+
+    // Portals closer to the eye than the near plane are cut by it, the camera is standing in them
+    const float nearDistance = -GetDistance(viewFrustum.planes[4], eye);
+    const Vec4& farPlane = viewFrustum.planes[5];
+
+    m_stack.push_back({ startCell, 0, NoPortal });
+    while (!m_stack.empty())
+    {
+      const Visit visit = m_stack.back();
+      m_stack.pop_back();
+
+      if (++m_stats.visitCount > m_maxVisits)
+      {
+        m_stats.gaveUp = true;
+        return false;
+      }
+      MarkVisible(visit.cell, visit.frustum);
+
+      const uint32* portals = graph.GetCellPortals(visit.cell);
+      const uint32 portalCount = graph.GetCell(visit.cell).portalCount;
+      for (uint32 i = 0; i < portalCount; ++i)
+      {
+        if (portals[i] == visit.fromPortal)
+          continue;
+
+        m_stats.portalTestCount++;
+        const PortalGraph::Portal& portal = graph.GetPortal(portals[i]);
+        const bool forward = portal.cells[0] == visit.cell;
+        const uint32 nextCell = forward ? portal.cells[1] : portal.cells[0];
+
+        // Plane facing the next cell, the eye has to be behind it to look through
+        const float side = forward ? 1.0f : -1.0f;
+        const Vec4 portalPlane = Vec4(portal.plane.x * side, portal.plane.y * side, portal.plane.z * side, portal.plane.w * side);
+        const float eyeDistance = GetDistance(portalPlane, eye);
+        if (eyeDistance > nearDistance)
+          continue;
+
+        if (eyeDistance >= -nearDistance)
+        {
+          m_stack.push_back({ nextCell, visit.frustum, portals[i] });
+          continue;
+        }
+
+        // What is left of the portal in the frustum it is seen through
+        Vec3 polygon[MaxClipVertices];
+        Vec3 clipped[MaxClipVertices];
+        uint32 vertexCount = portal.vertexCount;
+        std::copy(portal.vertices, portal.vertices + vertexCount, polygon);
+
+        const PortalFrustum& parent = m_frustums[visit.frustum];
+        for (uint32 p = 0; p < parent.planeCount && vertexCount >= 3; ++p)
+        {
+          vertexCount = ClipPolygon(polygon, vertexCount, parent.planes[p], clipped);
+          std::copy(clipped, clipped + vertexCount, polygon);
+        }
+
+        if (vertexCount < 3)
+          continue;
+
+        // Too many edges for a frustum, the cell behind is seen through the parent frustum
+        if (vertexCount + 2 > MaxPlanes)
+        {
+          m_stack.push_back({ nextCell, visit.frustum, portals[i] });
+          continue;
+        }
+
+        Vec3 center = ZeroVector;
+        for (uint32 v = 0; v < vertexCount; ++v)
+          center = Vec3(center.x + polygon[v].x / vertexCount, center.y + polygon[v].y / vertexCount, center.z + polygon[v].z / vertexCount);
+
+        PortalFrustum narrowed;
+        for (uint32 v = 0; v < vertexCount; ++v)
+        {
+          const Vec3 a = Vec3(polygon[v].x - eye.x, polygon[v].y - eye.y, polygon[v].z - eye.z);
+          const Vec3& next = polygon[(v + 1) % vertexCount];
+          const Vec3 b = Vec3(next.x - eye.x, next.y - eye.y, next.z - eye.z);
+          Vec3 normal = Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+          const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+          if (length < 1e-6f)
+            continue;
+
+          normal = Vec3(normal.x / length, normal.y / length, normal.z / length);
+          Vec4 plane = Vec4(normal.x, normal.y, normal.z, -(normal.x * eye.x + normal.y * eye.y + normal.z * eye.z));
+          if (GetDistance(plane, center) < 0.0f)
+            plane = Vec4(-plane.x, -plane.y, -plane.z, -plane.w);
+          narrowed.planes[narrowed.planeCount++] = plane;
+        }
+        narrowed.planes[narrowed.planeCount++] = portalPlane;
+        narrowed.planes[narrowed.planeCount++] = farPlane;
+
+        m_frustums.push_back(narrowed);
+        m_stack.push_back({ nextCell, (uint32)m_frustums.size() - 1, portals[i] });
+      }
+    }
+
+    m_stats.visibleCellCount = (uint32)m_visibleCells.size();
+    return true;
+  }
+
+  bool PortalCuller::IsSphereVisible(uint32 cell, const Vec3& center, float radius) const
+  {
+    if (cell >= m_cellStamps.size())
+      return true;
+    if (!IsCellVisible(cell))
+      return false;
+
+    const uint8 frustumCount = m_cellFrustumCounts[cell];
+    if (frustumCount == UnboundedCell)
+      return true;
+
+    for (uint32 i = 0; i < frustumCount; ++i)
+    {
+      if (IsSphereInside(m_frustums[m_cellFrustums[(size_t)cell * MaxFrustumsPerCell + i]], center, radius))
+        return true;
+    }
+
+    return false;
+  }
+
+  void PortalCuller::MarkVisible(uint32 cell, uint32 frustum)
+  {
+    if (m_cellStamps[cell] != m_stamp)
+    {
+      m_cellStamps[cell] = m_stamp;
+      m_cellFrustumCounts[cell] = 0;
+      m_visibleCells.push_back(cell);
+    }
+
+    uint8& frustumCount = m_cellFrustumCounts[cell];
+    if (frustumCount == UnboundedCell)
+      return;
+
+    if (frustumCount == MaxFrustumsPerCell)
+      frustumCount = UnboundedCell;
+    else
+      m_cellFrustums[(size_t)cell * MaxFrustumsPerCell + frustumCount++] = frustum;
+  }
+
+  bool PortalCuller::IsSphereInside(const PortalFrustum& frustum, const Vec3& center, float radius)
+  {
+    for (uint32 i = 0; i < frustum.planeCount; ++i)
+    {
+      if (GetDistance(frustum.planes[i], center) < -radius)
+        return false;
+    }
+
+    return true;
+  }
+}
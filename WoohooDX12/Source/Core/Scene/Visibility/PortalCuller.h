@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Scene/Culling/FrustumCulling.h"
+#include "PortalGraph.h"
+
+namespace WoohooDX12
+{
+  struct PortalCullStats
+  {
+    uint32 visitCount = 0; // Cells entered, a cell seen through several portals counts more than once
+    uint32 visibleCellCount = 0;
+    uint32 portalTestCount = 0;
+    bool gaveUp = false; // Visit budget exceeded
+  };
+
+  /*
+  * Cell and portal visibility from the camera.
+  * Starts in the camera's cell with the view frustum. Every portal of a visible cell is clipped against the frustum the cell
+  * is seen through, what is left of the portal makes a narrower frustum (planes through the eye and the polygon edges,
+  * plus the portal plane) for the cell behind it. The walk uses an explicit stack, it does not recurse.
+  * A cell keeps the frustums it was seen through, objects in the cell are tested against them.
+  * Everything is conservative: when the camera is outside of the graph, stands on a portal, or the walk gets too large,
+  * the result does not cull more than the view frustum.
+  */
+  class PortalCuller
+  {
+  public:
+    static constexpr uint32 MaxPlanes = 32;
+    static constexpr uint32 MaxFrustumsPerCell = 4; // More and the cell is tested with the view frustum only
+    static constexpr uint32 DefaultMaxVisits = 4096;
+
+    PortalCuller() {}
+
+    // Returns false if the camera is outside of the graph or the walk gave up, the result should not be used then
+    bool Cull(const PortalGraph& graph, const Frustum& viewFrustum, const Vec3& eye);
+
+    inline bool IsCellVisible(uint32 cell) const { return m_cellStamps[cell] == m_stamp; }
+    // Objects outside of the graph are not tested
+    bool IsSphereVisible(uint32 cell, const Vec3& center, float radius) const;
+
+    inline const std::vector<uint32>& GetVisibleCells() const { return m_visibleCells; }
+    inline const PortalCullStats& GetStats() const { return m_stats; }
+    inline void SetMaxVisits(uint32 maxVisits) { m_maxVisits = maxVisits; }
+
+  private:
+    static constexpr uint8 UnboundedCell = 0xFF;
+
+    struct PortalFrustum
+    {
+      Vec4 planes[MaxPlanes];
+      uint32 planeCount = 0;
+    };
+
+    struct Visit
+    {
+      uint32 cell;
+      uint32 frustum; // Index in m_frustums
+      uint32 fromPortal;
+    };
+
+    void MarkVisible(uint32 cell, uint32 frustum);
+    static bool IsSphereInside(const PortalFrustum& frustum, const Vec3& center, float radius);
+
+  private:
+    std::vector<PortalFrustum> m_frustums;
+    std::vector<Visit> m_stack;
+    std::vector<uint32> m_visibleCells;
+
+    // Per cell, valid when the stamp is the current one
+    std::vector<uint32> m_cellStamps;
+    std::vector<uint8> m_cellFrustumCounts;
+    std::vector<uint32> m_cellFrustums; // MaxFrustumsPerCell per cell
+    uint32 m_stamp = 0;
+
+    uint32 m_maxVisits = DefaultMaxVisits;
+    PortalCullStats m_stats;
+  };
+}
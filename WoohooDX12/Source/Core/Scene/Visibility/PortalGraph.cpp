@@ -0,0 +1,179 @@
+#include "PortalGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace WoohooDX12
+{
+  uint32 PortalGraph::AddCell(const AABB& bounds)
+  {
+    Cell cell;
+    cell.bounds = bounds;
+    m_cells.push_back(cell);
+    return (uint32)m_cells.size() - 1;
+  }
+
+  uint32 PortalGraph::AddPortal(uint32 cellA, uint32 cellB, const Vec3* vertices, uint32 vertexCount)
+  {
+    assert(cellA < m_cells.size() && cellB < m_cells.size() && cellA != cellB && "Invalid portal cells!");
+    assert(vertexCount >= 3 && vertexCount <= MaxPortalVertices && "Invalid portal polygon!");
+
+    Portal portal;
+    portal.cells[0] = cellA;
+    portal.cells[1] = cellB;
+    portal.vertexCount = vertexCount;
+    std::copy(vertices, vertices + vertexCount, portal.vertices);
+
+    // Newell's normal, robust for slightly non planar polygons
+    Vec3 normal = ZeroVector;
+    Vec3 center = ZeroVector;
+    for (uint32 i = 0; i < vertexCount; ++i)
+    {
+      const Vec3& a = vertices[i];
+      const Vec3& b = vertices[(i + 1) % vertexCount];
+      normal.x += (a.y - b.y) * (a.z + b.z);
+      normal.y += (a.z - b.z) * (a.x + b.x);
+      normal.z += (a.x - b.x) * (a.y + b.y);
+      center = Vec3(center.x + a.x / vertexCount, center.y + a.y / vertexCount, center.z + a.z / vertexCount);
+    }
+    const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    normal = Vec3(normal.x / length, normal.y / length, normal.z / length);
+
+    // Facing the second cell
+    const AABB& bounds = m_cells[cellB].bounds;
+    const Vec3 cellCenter = Vec3((bounds.min.x + bounds.max.x) * 0.5f, (bounds.min.y + bounds.max.y) * 0.5f, (bounds.min.z + bounds.max.z) * 0.5f);
+    if (normal.x * (cellCenter.x - center.x) + normal.y * (cellCenter.y - center.y) + normal.z * (cellCenter.z - center.z) < 0.0f)
+      normal = Vec3(-normal.x, -normal.y, -normal.z);
+    portal.plane = Vec4(normal.x, normal.y, normal.z, -(normal.x * center.x + normal.y * center.y + normal.z * center.z));
+
+    m_portals.push_back(portal);
+    return (uint32)m_portals.size() - 1;
+  }
+
+  void PortalGraph::Build()
+  {
+    // Portal lists of the cells, counted first so they are one array
+    for (Cell& cell : m_cells)
+      cell.portalCount = 0;
+    for (const Portal& portal : m_portals)
+    {
+      m_cells[portal.cells[0]].portalCount++;
+      m_cells[portal.cells[1]].portalCount++;
+    }
+
+    uint32 first = 0;
+    for (Cell& cell : m_cells)
+    {
+      cell.firstPortal = first;
+      first += cell.portalCount;
+      cell.portalCount = 0;
+    }
+
+    m_cellPortals.resize(first);
+    for (uint32 i = 0; i < (uint32)m_portals.size(); ++i)
+    {
+      for (uint32 cell : m_portals[i].cells)
+        m_cellPortals[m_cells[cell].firstPortal + m_cells[cell].portalCount++] = i;
+    }
+
+    m_cellTree.Clear();
+    for (uint32 i = 0; i < (uint32)m_cells.size(); ++i)
+      m_cellTree.CreateProxy(m_cells[i].bounds, i);
+  }
+
+  void PortalGraph::Clear()
+  {
+    m_cells.clear();
+    m_portals.clear();
+    m_cellPortals.clear();
+    m_cellTree.Clear();
+  }
+
+  uint32 PortalGraph::BuildFromBoxes(const AABB* cellBoxes, uint32 cellCount, const AABB* portalBoxes, uint32 portalCount)
+  {
+    Clear();
+    for (uint32 i = 0; i < cellCount; ++i)
+      AddCell(cellBoxes[i]);
+    Build();
+
+    uint32 skippedCount = 0;
+    for (uint32 i = 0; i < portalCount; ++i)
+    {
+      const AABB& box = portalBoxes[i];
+
+      uint32 cells[2];
+      uint32 overlapCount = 0;
+      m_cellTree.QueryAABB(box, [&](int32 proxy)
+        {
+          if (overlapCount < 2)
+            cells[overlapCount] = m_cellTree.GetUserData(proxy);
+          overlapCount++;
+          return overlapCount <= 2;
+        });
+
+      if (overlapCount != 2)
+      {
+        skippedCount++;
+        continue;
+      }
+
+      // Rectangle through the middle of the box, across its thinnest axis
+      const float size[3] = { box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z };
+      const uint32 axis = size[0] <= size[1] ? (size[0] <= size[2] ? 0 : 2) : (size[1] <= size[2] ? 1 : 2);
+      const float middle = axis == 0 ? (box.min.x + box.max.x) * 0.5f : axis == 1 ? (box.min.y + box.max.y) * 0.5f : (box.min.z + box.max.z) * 0.5f;
+
+      Vec3 vertices[4];
+      if (axis == 0)
+      {
+        vertices[0] = Vec3(middle, box.min.y, box.min.z);
+        vertices[1] = Vec3(middle, box.max.y, box.min.z);
+        vertices[2] = Vec3(middle, box.max.y, box.max.z);
+        vertices[3] = Vec3(middle, box.min.y, box.max.z);
+      }
+      else if (axis == 1)
+      {
+        vertices[0] = Vec3(box.min.x, middle, box.min.z);
+        vertices[1] = Vec3(box.max.x, middle, box.min.z);
+        vertices[2] = Vec3(box.max.x, middle, box.max.z);
+        vertices[3] = Vec3(box.min.x, middle, box.max.z);
+      }
+      else
+      {
+        vertices[0] = Vec3(box.min.x, box.min.y, middle);
+        vertices[1] = Vec3(box.max.x, box.min.y, middle);
+        vertices[2] = Vec3(box.max.x, box.max.y, middle);
+        vertices[3] = Vec3(box.min.x, box.max.y, middle);
+      }
+
+      AddPortal(cells[0], cells[1], vertices, 4);
+    }
+
+    Build();
+    return skippedCount;
+  }
+
+  uint32 PortalGraph::FindCell(const Vec3& point) const
+  {
+    AABB box;
+    box.min = point;
+    box.max = point;
+    return FindCell(box);
+  }
+
+  uint32 PortalGraph::FindCell(const AABB& box) const
+  {
+    uint32 result = InvalidCell;
+    m_cellTree.QueryAABB(box, [&](int32 proxy)
+      {
+        const uint32 cell = m_cellTree.GetUserData(proxy);
+        if (!m_cells[cell].bounds.Contains(box))
+          return true;
+
+        result = cell;
+        return false;
+      });
+
+    return result;
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+#include "Maths.h"
+#include "Scene/Spatial/AABBTree.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Cells and portals of an indoor scene. Cells are convex volumes (boxes), portals are convex planar polygons connecting
+  * two cells, like doors and windows. The graph is static, PortalCuller walks it every frame.
+  * Cells are found with an AABB tree, so looking up the cell of an object does not depend on the cell count.
+  */
+  class PortalGraph
+  {
+  public:
+    static constexpr uint32 InvalidCell = 0xFFFFFFFF;
+    static constexpr uint32 MaxPortalVertices = 8;
+
+    struct Cell
+    {
+      AABB bounds;
+      uint32 firstPortal = 0; // Range in the cell portal list
+      uint32 portalCount = 0;
+    };
+
+    struct Portal
+    {
+      uint32 cells[2] = { InvalidCell, InvalidCell };
+      Vec3 vertices[MaxPortalVertices];
+      uint32 vertexCount = 0;
+      Vec4 plane = Vec4(0.0f, 0.0f, 0.0f, 0.0f); // Normal points into cells[1]
+    };
+
+    PortalGraph() {}
+
+    PortalGraph(const PortalGraph&) = delete;
+    PortalGraph& operator=(const PortalGraph&) = delete;
+
+    uint32 AddCell(const AABB& bounds);
+    // Vertices of a convex polygon in order, the winding does not matter
+    uint32 AddPortal(uint32 cellA, uint32 cellB, const Vec3* vertices, uint32 vertexCount);
+    // Builds the cell portal lists and the lookup tree, call it after the cells and portals are added
+    void Build();
+    void Clear();
+
+    // Generator for tagged box geometry: every portal box connects the two cells it overlaps, its polygon is the cross
+    // section of the box on its thinnest axis. Returns the number of portal boxes that did not overlap exactly two cells,
+    // they are skipped.
+    uint32 BuildFromBoxes(const AABB* cellBoxes, uint32 cellCount, const AABB* portalBoxes, uint32 portalCount);
+
+    uint32 FindCell(const Vec3& point) const;
+    // Cell containing the whole box, InvalidCell if it is outside of every cell or crosses cells
+    uint32 FindCell(const AABB& box) const;
+
+    inline uint32 GetCellCount() const { return (uint32)m_cells.size(); }
+    inline uint32 GetPortalCount() const { return (uint32)m_portals.size(); }
+    inline const Cell& GetCell(uint32 cell) const { return m_cells[cell]; }
+    inline const Portal& GetPortal(uint32 portal) const { return m_portals[portal]; }
+    inline const uint32* GetCellPortals(uint32 cell) const { return m_cellPortals.data() + m_cells[cell].firstPortal; }
+
+  private:
+    std::vector<Cell> m_cells;
+    std::vector<Portal> m_portals;
+    std::vector<uint32> m_cellPortals;
+    DynamicAABBTree m_cellTree = DynamicAABBTree(0.0f, 0.0f);
+  };
+}
@@ -0,0 +1,201 @@
+#include "PotentiallyVisibleSet.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+
+namespace WoohooDX12
+{
+  static constexpr uint32 FileMagic = 0x53565057; // "WPVS"
+  static constexpr uint32 FileVersion = 1;
+  static constexpr uint32 MaxFillCount = 0x7FFF;
+  static constexpr uint32 MaxLiteralCount = 0xFFFF;
+
+  static inline bool IsFillWord(uint32 word)
+  {
+    return word == 0 || word == 0xFFFFFFFF;
+  }
+
+  // FNV-1a over the words
+  static uint64 HashWords(const uint32* words, size_t count)
+  {
+    uint64 hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; ++i)
+    {
+      hash ^= words[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  void PotentiallyVisibleSet::Init(const AABB& bounds, float cellSize, uint32 cellCountX, uint32 cellCountY, uint32 cellCountZ, uint32 objectCount)
+  {
+    Clear();
+    m_bounds = bounds;
+    m_cellSize = cellSize;
+    m_cellCountX = cellCountX;
+    m_cellCountY = cellCountY;
+    m_cellCountZ = cellCountZ;
+    m_objectCount = objectCount;
+    m_cellSets.resize((size_t)cellCountX * cellCountY * cellCountZ, InvalidSet);
+  }
+
+  void PotentiallyVisibleSet::Clear()
+  {
+    m_cellCountX = 0;
+    m_cellCountY = 0;
+    m_cellCountZ = 0;
+    m_objectCount = 0;
+    m_setCount = 0;
+    m_cellSets.clear();
+    m_data.clear();
+    m_setLookup.clear();
+  }
+
+  void PotentiallyVisibleSet::SetCellVisibility(uint32 cell, const uint32* visibleBits)
+  {
+    assert(cell < m_cellSets.size() && "Invalid cell!");
+
+    m_scratch.clear();
+    Compress(visibleBits, GetWordCount(), m_scratch);
+
+    const uint64 hash = HashWords(m_scratch.data(), m_scratch.size());
+    auto range = m_setLookup.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      const uint32 offset = it->second;
+      if (offset + m_scratch.size() <= m_data.size() && std::equal(m_scratch.begin(), m_scratch.end(), m_data.begin() + offset))
+      {
+        m_cellSets[cell] = offset;
+        return;
+      }
+    }
+
+    const uint32 offset = (uint32)m_data.size();
+    m_data.insert(m_data.end(), m_scratch.begin(), m_scratch.end());
+    m_setLookup.emplace(hash, offset);
+    m_cellSets[cell] = offset;
+    m_setCount++;
+  }
+
+  void PotentiallyVisibleSet::Compress(const uint32* words, uint32 wordCount, std::vector<uint32>& output)
+  {
+    uint32 i = 0;
+    while (i < wordCount)
+    {
+      // Fill run of the same all zero or all one word, possibly empty
+      const uint32 fillBit = words[i] == 0xFFFFFFFF ? 1 : 0;
+      uint32 fillCount = 0;
+      while (i < wordCount && fillCount < MaxFillCount && IsFillWord(words[i]) && (words[i] & 1) == fillBit)
+      {
+        fillCount++;
+        i++;
+      }
+
+      // A single fill word is cheaper as a literal than as a new run
+      const uint32 literalBegin = i;
+      while (i < wordCount && i - literalBegin < MaxLiteralCount && (!IsFillWord(words[i]) || (i + 1 < wordCount && words[i + 1] != words[i])))
+        i++;
+
+      output.push_back((fillCount << 17) | ((i - literalBegin) << 1) | fillBit);
+      output.insert(output.end(), words + literalBegin, words + i);
+    }
+  }
+
+  bool PotentiallyVisibleSet::Decompress(uint32 cell, uint32* visibleBits) const
+  {
+    const uint32 wordCount = GetWordCount();
+    if (!HasVisibility(cell))
+    {
+      std::fill(visibleBits, visibleBits + wordCount, 0xFFFFFFFF);
+      return false;
+    }
+
+    const uint32* run = m_data.data() + m_cellSets[cell];
+    uint32 written = 0;
+    while (written < wordCount)
+    {
+      const uint32 fillCount = run[0] >> 17;
+      const uint32 literalCount = (run[0] >> 1) & MaxLiteralCount;
+      const uint32 fillWord = (run[0] & 1) ? 0xFFFFFFFF : 0;
+
+      std::fill(visibleBits + written, visibleBits + written + fillCount, fillWord);
+      written += fillCount;
+      std::copy(run + 1, run + 1 + literalCount, visibleBits + written);
+      written += literalCount;
+      run += 1 + literalCount;
+    }
+
+    return true;
+  }
+
+  uint32 PotentiallyVisibleSet::GetCellAt(const Vec3& position) const
+  {
+    const float x = floorf((position.x - m_bounds.min.x) / m_cellSize);
+    const float y = floorf((position.y - m_bounds.min.y) / m_cellSize);
+    const float z = floorf((position.z - m_bounds.min.z) / m_cellSize);
+    if (x < 0.0f || y < 0.0f || z < 0.0f || x >= (float)m_cellCountX || y >= (float)m_cellCountY || z >= (float)m_cellCountZ)
+      return InvalidCell;
+
+    return ((uint32)z * m_cellCountY + (uint32)y) * m_cellCountX + (uint32)x;
+  }
+
+  int PotentiallyVisibleSet::Save(const String& path) const
+  {
+    std::ofstream stream(path, std::ios::out | std::ios::binary);
+    if (!stream)
+      return -1;
+
+    const uint32 header[] = { FileMagic, FileVersion, m_cellCountX, m_cellCountY, m_cellCountZ, m_objectCount, m_setCount, (uint32)m_data.size() };
+    const float bounds[] = { m_bounds.min.x, m_bounds.min.y, m_bounds.min.z, m_bounds.max.x, m_bounds.max.y, m_bounds.max.z, m_cellSize };
+    stream.write((const char*)header, sizeof(header));
+    stream.write((const char*)bounds, sizeof(bounds));
+    stream.write((const char*)m_cellSets.data(), m_cellSets.size() * sizeof(uint32));
+    stream.write((const char*)m_data.data(), m_data.size() * sizeof(uint32));
+
+    return stream ? 0 : -1;
+  }
+
+  int PotentiallyVisibleSet::Load(const String& path)
+  {
+    Clear();
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream)
+      return -1;
+
+    uint32 header[8];
+    float bounds[7];
+    stream.read((char*)header, sizeof(header));
+    stream.read((char*)bounds, sizeof(bounds));
+    if (!stream || header[0] != FileMagic || header[1] != FileVersion)
+      return -1;
+
+    AABB box;
+    box.min = Vec3(bounds[0], bounds[1], bounds[2]);
+    box.max = Vec3(bounds[3], bounds[4], bounds[5]);
+    Init(box, bounds[6], header[2], header[3], header[4], header[5]);
+    m_setCount = header[6];
+    m_data.resize(header[7]);
+
+    stream.read((char*)m_cellSets.data(), m_cellSets.size() * sizeof(uint32));
+    stream.read((char*)m_data.data(), m_data.size() * sizeof(uint32));
+    if (!stream)
+    {
+      Clear();
+      return -1;
+    }
+
+    for (uint32 offset : m_cellSets)
+    {
+      if (offset != InvalidSet && offset >= m_data.size())
+      {
+        Clear();
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+#include "Maths.h"
+#include "Scene/Spatial/AABBTree.h"
+
+namespace WoohooDX12
+{
+  /*
+  * Baked cell to object visibility of a static scene (see PVSBaker.h).
+  * The scene bounds are split into a grid of view cells, each cell has a bitset of the objects that may be visible from
+  * anywhere inside it. Bitsets are stored run length compressed, cells with the same bitset share it.
+  * A cell without a bitset (in solid geometry or outside of the baked bounds) sees everything.
+  * At runtime the bitset of the camera's cell is decompressed once when the camera enters the cell, then each object
+  * is a single bit test.
+  */
+  class PotentiallyVisibleSet
+  {
+  public:
+    static constexpr uint32 InvalidCell = 0xFFFFFFFF;
+    static constexpr uint32 InvalidObject = 0xFFFFFFFF;
+
+    PotentiallyVisibleSet() {}
+
+    void Init(const AABB& bounds, float cellSize, uint32 cellCountX, uint32 cellCountY, uint32 cellCountZ, uint32 objectCount);
+    void Clear();
+
+    // One bit per object, GetWordCount() words. Identical bitsets are stored once.
+    void SetCellVisibility(uint32 cell, const uint32* visibleBits);
+
+    int Save(const String& path) const;
+    int Load(const String& path);
+
+    uint32 GetCellAt(const Vec3& position) const; // InvalidCell if outside of the bounds
+    inline bool HasVisibility(uint32 cell) const { return cell < m_cellSets.size() && m_cellSets[cell] != InvalidSet; }
+    // Writes GetWordCount() words, returns false and sets every bit if the cell has no bitset
+    bool Decompress(uint32 cell, uint32* visibleBits) const;
+    static inline bool IsVisible(const uint32* visibleBits, uint32 object) { return (visibleBits[object >> 5] & (1u << (object & 31))) != 0; }
+
+    inline uint32 GetCellCount() const { return (uint32)m_cellSets.size(); }
+    inline uint32 GetObjectCount() const { return m_objectCount; }
+    inline uint32 GetWordCount() const { return (m_objectCount + 31) / 32; }
+    inline uint32 GetSetCount() const { return m_setCount; }
+    inline const AABB& GetBounds() const { return m_bounds; }
+    inline float GetCellSize() const { return m_cellSize; }
+    // Compressed bitsets, without the cell table
+    inline uint64 GetCompressedSize() const { return m_data.size() * sizeof(uint32); }
+
+  private:
+    static constexpr uint32 InvalidSet = 0xFFFFFFFF;
+
+    // A bitset is a list of runs: a header word (fill word count << 17 | literal word count << 1 | fill bit), then the literals
+    static void Compress(const uint32* words, uint32 wordCount, std::vector<uint32>& output);
+
+  private:
+    AABB m_bounds;
+    float m_cellSize = 1.0f;
+    uint32 m_cellCountX = 0;
+    uint32 m_cellCountY = 0;
+    uint32 m_cellCountZ = 0;
+    uint32 m_objectCount = 0;
+    uint32 m_setCount = 0;
+
+    std::vector<uint32> m_cellSets; // Offset of the cell's bitset in m_data
+    std::vector<uint32> m_data;
+    std::unordered_multimap<uint64, uint32> m_setLookup; // Hash of a compressed bitset to its offset, only while setting
+    std::vector<uint32> m_scratch;
+  };
+}
@@ -5,7 +5,9 @@
 #include <memory>
 
 typedef unsigned int uint32;
+typedef int int32;
 typedef unsigned short uint16;
+typedef short int16;
 typedef unsigned long long uint64;
 typedef unsigned char uint8;
 
@@ -1,5 +1,8 @@
 #include "WohCore.h"
 #include "Utils.h"
+#include "Defines.h"
+#include "Memory/FrameArena.h"
+#include "Memory/MemoryTracker.h"
 #include "imgui.h"
 #include "backends/imgui_impl_win32.h"
 #include "backends/imgui_impl_dx12.h"
@@ -27,9 +30,19 @@ namespace WoohooDX12
 
     ReturnIfFailed(m_sceneRenderer->SetScene(scene));
 
-    ReturnIfFailed(m_sceneRenderer->Init(m_renderer, width, height, hwnd));
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Render);
+      ReturnIfFailed(m_sceneRenderer->Init(m_renderer, width, height, hwnd));
+    }
+
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::UI);
+      ReturnIfFailed(InitImGui(hwnd));
+    }
 
-    ReturnIfFailed(InitImGui(hwnd));
+#if WOH_ASSERT_STEADY_STATE
+    WOH_MEMORY_STEADY_STATE_AFTER(WOH_STEADY_STATE_WARMUP_FRAMES);
+#endif
 
     m_initialized = true;
 
@@ -38,13 +51,38 @@ namespace WoohooDX12
 
   int WohCore::Render()
   {
-    m_sceneRenderer->Render();
-    RenderImGui();
-    m_renderer->PresentBackbuffer();
+    WOH_MEMORY_BEGIN_FRAME();
+
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Render);
+      m_renderer->BeginFrame();
+      m_sceneRenderer->Render();
+    }
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::UI);
+      RenderImGui();
+    }
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Render);
+      m_renderer->PresentBackbuffer();
+    }
+
+    // Transient frame data is not valid after this point
+    FrameArena::ResetThreadArenas();
+
+    WOH_MEMORY_END_FRAME();
 
     return 0;
   }
 
+  int WohCore::ToggleCapture()
+  {
+    if (m_renderer->IsCapturing())
+      return m_renderer->StopCapture();
+
+    return m_renderer->StartCapture("Captures", CaptureFormat::PNG, CaptureOverflowPolicy::Drop);
+  }
+
   int WohCore::InitImGui(HWND hwnd)
   {
     IMGUI_CHECKVERSION();
@@ -18,6 +18,9 @@ namespace WoohooDX12
 
     int Render();
 
+    // Starts or stops capturing the presented frames to disk
+    int ToggleCapture();
+
   private:
     int InitImGui(HWND hwnd);
     int RenderImGui();
@@ -1 +1,11 @@
 #pragma once
+
+// 1 asserts on any heap allocation of a frame once the warm-up frames are rendered, needs WOH_MEMORY_TRACKING
+#ifndef WOH_ASSERT_STEADY_STATE
+#define WOH_ASSERT_STEADY_STATE 0
+#endif
+
+// Frames rendered before the steady state, the first ones grow the pools, arenas and ImGui buffers
+#ifndef WOH_STEADY_STATE_WARMUP_FRAMES
+#define WOH_STEADY_STATE_WARMUP_FRAMES 120
+#endif
@@ -1,6 +1,7 @@
 #include <windows.h>
 #include <memory>
 #include "App/App.h"
+#include "Memory/MemoryTracker.h"
 
 #if WOH_DEBUG
 #define _CRTDBG_MAP_ALLOC
@@ -26,6 +27,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
     }
   }
 
+  // Anything still reported as current here is leaked or owned by statics
+  WOH_MEMORY_REPORT();
+
 #if WOH_DEBUG
   _CrtDumpMemoryLeaks();
 #endif
@@ -0,0 +1,232 @@
+// Insert, update and query times of the dynamic AABB tree against a linear scan, see Core/Scene/Spatial/AABBTree.h
+//
+// Usage:
+//   AABBTreeBenchmark [--proxies <count>] [--moving <percent>] [--frames <count>] [--queries <count>] [--seed <value>]
+// Without --proxies the world is run with 100k and 1M boxes of 0.2 to 4 m in a 4 km square. Every frame a share of the boxes
+// moves like walking characters, then box, sphere and frustum queries of the size of gameplay and camera queries run on the
+// tree and on a linear scan of the boxes. The tree must return the proxies whose fat box overlaps, and every box that really
+// overlaps must be among them.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Scene/Camera.h"
+#include "Scene/Spatial/AABBTree.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 proxyCount = 0; // 0 runs every default count
+    float movingPercent = 10.0f;
+    uint32 frameCount = 10;
+    uint32 queryCount = 200;
+    uint32 seed = 1;
+  };
+
+  static constexpr float WorldExtent = 4000.0f;
+
+  AABB MakeBox(const Vec3& center, float halfSize)
+  {
+    AABB box;
+    box.min = Vec3(center.x - halfSize, center.y - halfSize, center.z - halfSize);
+    box.max = Vec3(center.x + halfSize, center.y + halfSize, center.z + halfSize);
+    return box;
+  }
+
+  struct QueryTimes
+  {
+    double tree = 0.0;
+    double scan = 0.0;
+    uint64 results = 0;
+  };
+
+  // The tree returns fat boxes, the scan returns the exact ones, the scan results must all be in the tree results
+  template<typename TreeQuery, typename Overlaps>
+  bool TimeQuery(const DynamicAABBTree& tree, const std::vector<AABB>& boxes, const std::vector<int32>& proxies, TreeQuery&& treeQuery,
+    Overlaps&& overlaps, QueryTimes& times, std::vector<uint32>& treeResults, std::vector<uint32>& scanResults)
+  {
+    treeResults.clear();
+    auto start = ToolClock::now();
+    treeQuery([&](int32 proxy) { treeResults.push_back(tree.GetUserData(proxy)); return true; });
+    times.tree += GetMilliseconds(start);
+
+    scanResults.clear();
+    start = ToolClock::now();
+    for (uint32 box = 0; box < (uint32)boxes.size(); ++box)
+    {
+      if (overlaps(boxes[box]))
+        scanResults.push_back(box);
+    }
+    times.scan += GetMilliseconds(start);
+    times.results += treeResults.size();
+
+    std::sort(treeResults.begin(), treeResults.end());
+    for (uint32 box : scanResults)
+    {
+      if (!std::binary_search(treeResults.begin(), treeResults.end(), box))
+      {
+        printf("FAILED: box %u overlaps the query but the tree did not return it\n", box);
+        return false;
+      }
+    }
+
+    for (uint32 box : treeResults)
+    {
+      if (!overlaps(tree.GetFatAABB(proxies[box])))
+      {
+        printf("FAILED: the tree returned box %u whose fat box does not overlap the query\n", box);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool RunWorld(uint32 proxyCount, const BenchmarkOptions& options)
+  {
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<float> coordinate(-WorldExtent * 0.5f, WorldExtent * 0.5f);
+    std::uniform_real_distribution<float> height(0.0f, 50.0f);
+    std::uniform_real_distribution<float> halfSize(0.1f, 2.0f);
+    std::uniform_real_distribution<float> step(-0.1f, 0.1f); // 6 m/s at 60 frames per second
+
+    std::vector<AABB> boxes(proxyCount);
+    std::vector<int32> proxies(proxyCount);
+    for (uint32 box = 0; box < proxyCount; ++box)
+      boxes[box] = MakeBox(Vec3(coordinate(random), height(random), coordinate(random)), halfSize(random));
+
+    DynamicAABBTree tree;
+    auto start = ToolClock::now();
+    for (uint32 box = 0; box < proxyCount; ++box)
+      proxies[box] = tree.CreateProxy(boxes[box], box);
+    const double insertMilliseconds = GetMilliseconds(start);
+
+    const uint32 movingCount = (uint32)(proxyCount * options.movingPercent / 100.0f);
+    double moveMilliseconds = 0.0;
+    uint32 reinsertCount = 0;
+    QueryTimes boxQueries;
+    QueryTimes sphereQueries;
+    QueryTimes frustumQueries;
+    std::vector<uint32> treeResults;
+    std::vector<uint32> scanResults;
+    bool passed = true;
+    for (uint32 frame = 0; frame < options.frameCount && passed; ++frame)
+    {
+      // The same boxes move every frame, the first ones
+      start = ToolClock::now();
+      for (uint32 box = 0; box < movingCount; ++box)
+      {
+        const Vec3 displacement(step(random), 0.0f, step(random));
+        AABB& moved = boxes[box];
+        moved.min = Vec3(moved.min.x + displacement.x, moved.min.y, moved.min.z + displacement.z);
+        moved.max = Vec3(moved.max.x + displacement.x, moved.max.y, moved.max.z + displacement.z);
+        reinsertCount += tree.MoveProxy(proxies[box], moved, displacement) ? 1 : 0;
+      }
+      moveMilliseconds += GetMilliseconds(start);
+
+      for (uint32 query = 0; query < options.queryCount && passed; ++query)
+      {
+        const Vec3 center(coordinate(random), height(random), coordinate(random));
+
+        // A trigger volume of 20 m
+        const AABB box = MakeBox(center, 10.0f);
+        passed = TimeQuery(tree, boxes, proxies, [&](auto&& callback) { tree.QueryAABB(box, callback); },
+          [&](const AABB& other) { return other.Overlaps(box); }, boxQueries, treeResults, scanResults) && passed;
+
+        // An explosion radius of 30 m
+        const float radius = 30.0f;
+        passed = TimeQuery(tree, boxes, proxies, [&](auto&& callback) { tree.QuerySphere(center, radius, callback); },
+          [&](const AABB& other)
+          {
+            const float dx = std::max(std::max(other.min.x - center.x, center.x - other.max.x), 0.0f);
+            const float dy = std::max(std::max(other.min.y - center.y, center.y - other.max.y), 0.0f);
+            const float dz = std::max(std::max(other.min.z - center.z, center.z - other.max.z), 0.0f);
+            return dx * dx + dy * dy + dz * dz <= radius * radius;
+          }, sphereQueries, treeResults, scanResults) && passed;
+      }
+
+      // A camera view of 300 m, once per frame
+      Camera camera;
+      camera.SetPerspectiveFov(1.0f, 16.0f / 9.0f, 0.1f, 300.0f);
+      const Vec3 position(coordinate(random), 2.0f, coordinate(random));
+      camera.SetLookAt(position, Vec3(position.x + 1.0f, 2.0f, position.z + step(random) * 10.0f));
+      const Frustum frustum = Frustum::FromViewProjection(camera.GetViewProjectionMatrix());
+      passed = TimeQuery(tree, boxes, proxies, [&](auto&& callback) { tree.QueryFrustum(frustum, callback); },
+        [&](const AABB& other)
+        {
+          for (const Vec4& plane : frustum.planes)
+          {
+            const float x = plane.x >= 0.0f ? other.max.x : other.min.x;
+            const float y = plane.y >= 0.0f ? other.max.y : other.min.y;
+            const float z = plane.z >= 0.0f ? other.max.z : other.min.z;
+            if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+              return false;
+          }
+          return true;
+        }, frustumQueries, treeResults, scanResults) && passed;
+    }
+
+    tree.Validate();
+
+    const double frames = options.frameCount;
+    const double queries = frames * options.queryCount;
+    printf("%u boxes, height %d, area ratio %.1f\n", proxyCount, tree.GetHeight(), tree.GetAreaRatio());
+    printf("  insert:  %8.1f ms, %6.0f ns per box\n", insertMilliseconds, insertMilliseconds * 1e6 / proxyCount);
+    printf("  move:    %8.3f ms/frame for %u boxes, %.1f%% reinserted\n", moveMilliseconds / frames, movingCount,
+      movingCount > 0 ? 100.0 * reinsertCount / ((double)movingCount * frames) : 0.0);
+    printf("  %-8s %12s %12s %10s %10s\n", "query", "tree us", "scan us", "speedup", "results");
+    printf("  %-8s %12.2f %12.2f %10.0f %10.1f\n", "box", boxQueries.tree * 1000.0 / queries, boxQueries.scan * 1000.0 / queries,
+      boxQueries.scan / boxQueries.tree, boxQueries.results / queries);
+    printf("  %-8s %12.2f %12.2f %10.0f %10.1f\n", "sphere", sphereQueries.tree * 1000.0 / queries, sphereQueries.scan * 1000.0 / queries,
+      sphereQueries.scan / sphereQueries.tree, sphereQueries.results / queries);
+    printf("  %-8s %12.2f %12.2f %10.0f %10.1f\n", "frustum", frustumQueries.tree * 1000.0 / frames, frustumQueries.scan * 1000.0 / frames,
+      frustumQueries.scan / frustumQueries.tree, frustumQueries.results / frames);
+
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--proxies", options.proxyCount);
+    commandLine.Add("--moving", options.movingPercent);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--queries", options.queryCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.frameCount > 0 && options.movingPercent >= 0.0f && options.movingPercent <= 100.0f;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--proxies n] [--moving percent] [--frames n] [--queries n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  bool passed = true;
+  if (options.proxyCount > 0)
+    passed = RunWorld(options.proxyCount, options);
+  else
+  {
+    for (uint32 proxyCount : { 100000u, 1000000u })
+      passed = RunWorld(proxyCount, options) && passed;
+  }
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
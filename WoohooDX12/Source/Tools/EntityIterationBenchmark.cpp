@@ -0,0 +1,223 @@
+// Iteration of the archetype entity store against a vector of shared pointers to entity objects, see Core/Scene/ECS/EntityWorld.h
+//
+// Usage:
+//   EntityIterationBenchmark [--entities <count>] [--moving <percent>] [--frames <count>] [--seed <value>]
+// The entities are split like a level: every one has a position and bounds, a share of them moves and some also carry a
+// light or a tag. The object path is the scene before the entity store, polymorphic entities held by shared pointers with a
+// virtual update, made between other allocations and shuffled like after a few loads. Two systems are timed, the movement of the
+// moving entities and a read of the bounds of all of them, through Each and through the chunks. The results of both paths
+// are compared.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Scene/ECS/EntityWorld.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 entityCount = 1000000;
+    float movingPercent = 30.0f;
+    uint32 frameCount = 10;
+    uint32 seed = 1;
+  };
+
+  static constexpr float DeltaTime = 1.0f / 60.0f;
+
+  struct Position { float x, y, z; };
+  struct Velocity { float x, y, z; };
+  struct Bounds { float radius; };
+  struct Light { float color[3]; float range; };
+  struct Tag { uint32 value; };
+
+  // The object layout before the entity store, the data a system needs is spread over objects on the heap
+  class SceneObject
+  {
+  public:
+    virtual ~SceneObject() {}
+    virtual void Update(float) {}
+    inline const Position& GetPosition() const { return m_position; }
+    inline float GetRadius() const { return m_radius; }
+
+  protected:
+    std::shared_ptr<void> m_mesh;
+    Position m_position = {};
+    float m_radius = 1.0f;
+    uint32 m_flags = 0;
+  };
+
+  class MovingObject : public SceneObject
+  {
+  public:
+    MovingObject(const Position& position, const Velocity& velocity) { m_position = position; m_velocity = velocity; }
+    void Update(float deltaTime) override
+    {
+      m_position.x += m_velocity.x * deltaTime;
+      m_position.y += m_velocity.y * deltaTime;
+      m_position.z += m_velocity.z * deltaTime;
+    }
+
+  private:
+    Velocity m_velocity;
+  };
+
+  class StaticObject : public SceneObject
+  {
+  public:
+    explicit StaticObject(const Position& position) { m_position = position; }
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--entities", options.entityCount);
+    commandLine.Add("--moving", options.movingPercent);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.entityCount > 0 && options.frameCount > 0 && options.movingPercent >= 0.0f && options.movingPercent <= 100.0f;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--entities n] [--moving percent] [--frames n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(options.seed);
+  std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+
+  EntityWorld world;
+  std::vector<std::shared_ptr<SceneObject>> objects;
+  std::vector<std::unique_ptr<uint8[]>> otherAllocations;
+  objects.reserve(options.entityCount);
+  for (uint32 i = 0; i < options.entityCount; ++i)
+  {
+    const Position position = { coordinate(random), coordinate(random), coordinate(random) };
+    const bool moving = random() % 10000 < (uint32)(options.movingPercent * 100.0f);
+    const uint32 extra = random() % 10;
+    if (moving)
+    {
+      const Velocity velocity = { coordinate(random) * 0.01f, 0.0f, coordinate(random) * 0.01f };
+      objects.push_back(std::make_shared<MovingObject>(position, velocity));
+      if (extra == 0)
+        world.Create(position, velocity, Bounds{ 1.0f }, Light{ { 1.0f, 1.0f, 1.0f }, 10.0f });
+      else
+        world.Create(position, velocity, Bounds{ 1.0f });
+    }
+    else
+    {
+      objects.push_back(std::make_shared<StaticObject>(position));
+      if (extra == 0)
+        world.Create(position, Bounds{ 1.0f }, Tag{ i });
+      else
+        world.Create(position, Bounds{ 1.0f });
+    }
+
+    if (i % 4 == 0)
+      otherAllocations.push_back(std::make_unique<uint8[]>(32 + random() % 200));
+  }
+  otherAllocations.clear();
+  std::shuffle(objects.begin(), objects.end(), random);
+
+  printf("%u entities, %.0f%% moving, %u archetypes, %u frames\n", world.GetEntityCount(), options.movingPercent, world.GetArchetypeCount(),
+    options.frameCount);
+
+  double objectMove = 0.0;
+  double objectRead = 0.0;
+  double eachMove = 0.0;
+  double eachRead = 0.0;
+  double chunkMove = 0.0;
+  double chunkRead = 0.0;
+  double objectSum = 0.0;
+  double eachSum = 0.0;
+  double chunkSum = 0.0;
+  for (uint32 frame = 0; frame < options.frameCount; ++frame)
+  {
+    auto start = ToolClock::now();
+    for (const std::shared_ptr<SceneObject>& object : objects)
+      object->Update(DeltaTime);
+    objectMove += GetMilliseconds(start);
+
+    start = ToolClock::now();
+    for (const std::shared_ptr<SceneObject>& object : objects)
+      objectSum += object->GetPosition().x * object->GetRadius();
+    objectRead += GetMilliseconds(start);
+
+    // Each and the chunks move every other frame so both run the same number of updates
+    if (frame % 2 == 0)
+    {
+      start = ToolClock::now();
+      world.Each<Position, Velocity>([](Entity, Position& position, Velocity& velocity)
+      {
+        position.x += velocity.x * DeltaTime;
+        position.y += velocity.y * DeltaTime;
+        position.z += velocity.z * DeltaTime;
+      });
+      eachMove += GetMilliseconds(start);
+    }
+    else
+    {
+      start = ToolClock::now();
+      world.EachChunk(GetComponentMask<Position, Velocity>(), [](ChunkView& chunk)
+      {
+        Position* positions = chunk.Get<Position>();
+        const Velocity* velocities = chunk.Get<Velocity>();
+        for (uint32 i = 0; i < chunk.count; ++i)
+        {
+          positions[i].x += velocities[i].x * DeltaTime;
+          positions[i].y += velocities[i].y * DeltaTime;
+          positions[i].z += velocities[i].z * DeltaTime;
+        }
+      });
+      chunkMove += GetMilliseconds(start);
+    }
+
+    start = ToolClock::now();
+    world.Each<Position, Bounds>([&](Entity, Position& position, Bounds& bounds) { eachSum += position.x * bounds.radius; });
+    eachRead += GetMilliseconds(start);
+
+    start = ToolClock::now();
+    world.EachChunk(GetComponentMask<Position, Bounds>(), [&](ChunkView& chunk)
+    {
+      const Position* positions = chunk.Get<Position>();
+      const Bounds* bounds = chunk.Get<Bounds>();
+      for (uint32 i = 0; i < chunk.count; ++i)
+        chunkSum += positions[i].x * bounds[i].radius;
+    });
+    chunkRead += GetMilliseconds(start);
+  }
+
+  // The moves of the two stores only differ by the rounding of the order of the sums
+  bool passed = true;
+  const double tolerance = 1e-6 * options.entityCount * options.frameCount * 1000.0;
+  if (fabs(objectSum - eachSum) > tolerance || fabs(objectSum - chunkSum) > tolerance)
+  {
+    printf("FAILED: the stores read different positions, %f, %f and %f\n", objectSum, eachSum, chunkSum);
+    passed = false;
+  }
+
+  const double frames = options.frameCount;
+  const double halfFrames = options.frameCount / 2.0;
+  printf("%16s %12s %12s\n", "", "move ms", "read ms");
+  printf("%16s %12.3f %12.3f\n", "shared_ptr", objectMove / frames, objectRead / frames);
+  printf("%16s %12.3f %12.3f\n", "Each", eachMove / std::ceil(halfFrames), eachRead / frames);
+  if (options.frameCount > 1)
+    printf("%16s %12.3f %12.3f\n", "EachChunk", chunkMove / std::floor(halfFrames), chunkRead / frames);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,215 @@
+// CPU time and heap allocations of the transient draw list of a frame, see Core/Memory/FrameArena.h
+//
+// Usage:
+//   FrameArenaBenchmark [--draws <count>] [--materials <count>] [--frames <count>]
+// Without --draws the scene is run at 10k, 25k, 50k and 100k draws. Three ways to gather the draws of a frame are timed, the D3D
+// calls are not made:
+//   shared_ptr: the path before the arena, the render jobs map copied entry by entry and the shared pointers passed by value.
+//   heap list:  a draw list of raw pointers in a std::vector made every frame.
+//   arena list: the same draw list in the frame arena, reset at the end of the frame.
+// The heap allocations of a frame are counted by replacing the global operator new.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
+#include "Memory/FrameArena.h"
+#include "ToolSupport.h"
+
+static std::atomic<uint64_t> g_allocationCount = 0;
+
+void* operator new(size_t size)
+{
+  g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* memory = malloc(size))
+    return memory;
+
+  throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 drawCount = 0; // 0 runs every default count
+    uint32 materialCount = 16;
+    uint32 frameCount = 50;
+  };
+
+  struct Mesh
+  {
+    uint32 indexCount;
+  };
+
+  struct Material
+  {
+    uint32 pipeline;
+  };
+
+  struct DrawItem
+  {
+    Mesh* mesh;
+    Material* material;
+  };
+
+  typedef std::map<std::shared_ptr<Material>, std::vector<std::shared_ptr<Mesh>>> RenderJobs;
+
+  // Stands for Renderer::Render, kept out of line like the real one so the draws are not folded away
+  __attribute__((noinline)) uint64 SubmitShared(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+  {
+    return mesh->indexCount + material->pipeline;
+  }
+
+  __attribute__((noinline)) uint64 Submit(Mesh* mesh, Material* material)
+  {
+    return mesh->indexCount + material->pipeline;
+  }
+
+  uint64 RenderSharedPointers(const RenderJobs& renderJobs)
+  {
+    uint64 checksum = 0;
+    for (auto meshesWithSameMaterial : renderJobs)
+    {
+      std::shared_ptr<Material> mat = meshesWithSameMaterial.first;
+      for (std::shared_ptr<Mesh> mesh : meshesWithSameMaterial.second)
+        checksum += SubmitShared(mesh, mat);
+    }
+
+    return checksum;
+  }
+
+  template<typename DrawList>
+  uint64 RenderDrawList(const RenderJobs& renderJobs, uint32 drawCount, DrawList& drawList)
+  {
+    drawList.reserve(drawCount);
+    for (const auto& meshesWithSameMaterial : renderJobs)
+    {
+      Material* mat = meshesWithSameMaterial.first.get();
+      for (const std::shared_ptr<Mesh>& mesh : meshesWithSameMaterial.second)
+        drawList.push_back({ mesh.get(), mat });
+    }
+
+    uint64 checksum = 0;
+    for (const DrawItem& draw : drawList)
+      checksum += Submit(draw.mesh, draw.material);
+
+    return checksum;
+  }
+
+  struct PathResult
+  {
+    double milliseconds = 0.0;
+    double allocations = 0.0; // Per frame
+    uint64 checksum = 0;
+  };
+
+  template<typename RenderFrame>
+  PathResult TimePath(uint32 frameCount, RenderFrame renderFrame)
+  {
+    // One frame to grow the arena page to the peak of the frame
+    renderFrame();
+
+    PathResult result;
+    const uint64_t allocations = g_allocationCount.load(std::memory_order_relaxed);
+    const auto start = ToolClock::now();
+    for (uint32 frame = 0; frame < frameCount; ++frame)
+      result.checksum += renderFrame();
+    result.milliseconds = GetMilliseconds(start) / frameCount;
+    result.allocations = (double)(g_allocationCount.load(std::memory_order_relaxed) - allocations) / frameCount;
+    return result;
+  }
+
+  bool RunScene(uint32 drawCount, const BenchmarkOptions& options)
+  {
+    // Draws spread over the materials, a few hundred meshes shared between them
+    std::vector<std::shared_ptr<Mesh>> meshes;
+    for (uint32 mesh = 0; mesh < 300; ++mesh)
+      meshes.push_back(std::make_shared<Mesh>(Mesh{ 36 + mesh * 3 }));
+
+    RenderJobs renderJobs;
+    std::vector<std::shared_ptr<Material>> materials;
+    for (uint32 material = 0; material < options.materialCount; ++material)
+      materials.push_back(std::make_shared<Material>(Material{ material }));
+    for (uint32 draw = 0; draw < drawCount; ++draw)
+      renderJobs[materials[draw % options.materialCount]].push_back(meshes[(draw * 7) % meshes.size()]);
+
+    FrameArena& arena = FrameArena::GetThreadArena();
+    const PathResult shared = TimePath(options.frameCount, [&]() { return RenderSharedPointers(renderJobs); });
+    const PathResult heap = TimePath(options.frameCount, [&]()
+    {
+      std::vector<DrawItem> drawList;
+      return RenderDrawList(renderJobs, drawCount, drawList);
+    });
+    const PathResult arenaList = TimePath(options.frameCount, [&]()
+    {
+      uint64 checksum = 0;
+      {
+        FrameVector<DrawItem> drawList;
+        checksum = RenderDrawList(renderJobs, drawCount, drawList);
+      }
+      FrameArena::ResetThreadArenas();
+      return checksum;
+    });
+
+    printf("%8u %12.3f %12.3f %12.3f %10.1f %10.1f %10.1f %10.1f\n", drawCount, shared.milliseconds, heap.milliseconds, arenaList.milliseconds,
+      shared.allocations, heap.allocations, arenaList.allocations, (double)arena.GetCapacity() / 1024.0);
+
+    if (shared.checksum != heap.checksum || shared.checksum != arenaList.checksum)
+    {
+      printf("FAILED: the paths did not submit the same draws\n");
+      return false;
+    }
+
+    if (arenaList.allocations != 0.0)
+    {
+      printf("FAILED: the arena path allocated from the heap after its first frame\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--draws", options.drawCount);
+    commandLine.Add("--materials", options.materialCount);
+    commandLine.Add("--frames", options.frameCount);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.materialCount > 0 && options.frameCount > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--draws n] [--materials n] [--frames n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%u materials, %u frames, ms/frame and heap allocations/frame\n", options.materialCount, options.frameCount);
+  printf("%8s %12s %12s %12s %10s %10s %10s %10s\n", "draws", "shared_ptr", "heap list", "arena list", "allocs", "allocs", "allocs",
+    "arena KiB");
+
+  bool passed = true;
+  if (options.drawCount > 0)
+    passed = RunScene(options.drawCount, options);
+  else
+  {
+    for (uint32 drawCount : { 10000u, 25000u, 50000u, 100000u })
+      passed = RunScene(drawCount, options) && passed;
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
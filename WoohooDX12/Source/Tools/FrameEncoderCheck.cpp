@@ -0,0 +1,224 @@
+// Encodes synthetic frames with the capture encoder and reads the files back, see Core/Capture/FrameEncoder.h
+//
+// Usage:
+//   FrameEncoderCheck [--output <directory>]
+// The capture is resized twice like a window during a Y4M capture, every size must land in its own sequence with a valid
+// header. Solid colours check the conversion to YUV.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Capture/FrameEncoder.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    String outputPath = "FrameEncoderCheck";
+  };
+
+  // Frames of one size in a row
+  struct FrameRun
+  {
+    uint32 width;
+    uint32 height;
+    uint32 frameCount;
+  };
+
+  size_t GetY4MFrameSize(uint32 width, uint32 height)
+  {
+    const size_t chromaSize = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    return (size_t)width * height + chromaSize * 2;
+  }
+
+  bool ReadFile(const String& path, std::vector<uint8>& data)
+  {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream)
+      return false;
+
+    data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  // Header of the size, then the frames back to back
+  bool CheckSequence(const String& path, const FrameRun& run)
+  {
+    std::vector<uint8> data;
+    if (!ReadFile(path, data))
+    {
+      printf("FAILED: %s is missing\n", path.c_str());
+      return false;
+    }
+
+    const std::string expectedHeader = "YUV4MPEG2 W" + std::to_string(run.width) + " H" + std::to_string(run.height) + " ";
+    if (data.size() < expectedHeader.size() || memcmp(data.data(), expectedHeader.data(), expectedHeader.size()) != 0)
+    {
+      printf("FAILED: %s does not start with the header of %ux%u\n", path.c_str(), run.width, run.height);
+      return false;
+    }
+
+    size_t offset = 0;
+    while (offset < data.size() && data[offset] != '\n')
+      offset++;
+    offset++;
+
+    const size_t frameSize = GetY4MFrameSize(run.width, run.height);
+    for (uint32 frame = 0; frame < run.frameCount; ++frame)
+    {
+      if (offset + 6 + frameSize > data.size() || memcmp(data.data() + offset, "FRAME\n", 6) != 0)
+      {
+        printf("FAILED: frame %u of %s is not where a %ux%u frame should be\n", frame, path.c_str(), run.width, run.height);
+        return false;
+      }
+      offset += 6 + frameSize;
+    }
+
+    if (offset != data.size())
+    {
+      printf("FAILED: %s has %zu bytes after its %u frames\n", path.c_str(), data.size() - offset, run.frameCount);
+      return false;
+    }
+
+    printf("%s: %ux%u, %u frames\n", std::filesystem::path(path).filename().string().c_str(), run.width, run.height, run.frameCount);
+    return true;
+  }
+
+  // Each run is a size the back buffer was resized to
+  bool CheckResizedCapture(const String& outputPath)
+  {
+    const FrameRun runs[] = { { 301, 200, 5 }, { 160, 90, 4 }, { 301, 200, 3 } };
+
+    FrameEncoder encoder;
+    if (encoder.Start(outputPath, CaptureFormat::Y4M, CaptureOverflowPolicy::Block) != 0)
+    {
+      printf("FAILED: could not start the capture in %s\n", outputPath.c_str());
+      return false;
+    }
+
+    uint64 frameIndex = 0;
+    for (const FrameRun& run : runs)
+    {
+      for (uint32 i = 0; i < run.frameCount; ++i)
+      {
+        CapturedFrame frame = encoder.AcquireFrame(run.width, run.height);
+        frame.frameIndex = frameIndex++;
+        for (size_t byte = 0; byte < frame.pixels.size(); ++byte)
+          frame.pixels[byte] = (uint8)(byte * 7 + frameIndex);
+        encoder.Submit(std::move(frame));
+      }
+    }
+    encoder.Stop();
+
+    if (encoder.GetEncodedCount() != frameIndex)
+    {
+      printf("FAILED: %llu of %llu frames encoded\n", (unsigned long long)encoder.GetEncodedCount(), (unsigned long long)frameIndex);
+      return false;
+    }
+
+    bool passed = true;
+    for (uint32 run = 0; run < (uint32)(sizeof(runs) / sizeof(runs[0])); ++run)
+      passed = CheckSequence(FrameEncoder::MakeSequencePath(outputPath, run), runs[run]) && passed;
+
+    if (std::filesystem::exists(FrameEncoder::MakeSequencePath(outputPath, 3)))
+    {
+      printf("FAILED: more sequences than sizes\n");
+      passed = false;
+    }
+
+    return passed;
+  }
+
+  // BT.601 full range of solid colours
+  bool CheckColors()
+  {
+    struct ColorCase
+    {
+      uint8 rgb[3];
+      uint8 yuv[3];
+    };
+    const ColorCase cases[] =
+    {
+      { { 0, 0, 0 }, { 0, 128, 128 } },
+      { { 255, 255, 255 }, { 255, 128, 128 } },
+      { { 255, 0, 0 }, { 77, 85, 255 } },
+      { { 0, 255, 0 }, { 149, 43, 21 } },
+      { { 0, 0, 255 }, { 29, 255, 107 } }
+    };
+
+    bool passed = true;
+    std::vector<uint8> scratch;
+    for (const ColorCase& color : cases)
+    {
+      CapturedFrame frame;
+      frame.width = 3;
+      frame.height = 3;
+      frame.pixels.resize(frame.width * frame.height * 4);
+      for (uint32 pixel = 0; pixel < frame.width * frame.height; ++pixel)
+      {
+        memcpy(frame.pixels.data() + pixel * 4, color.rgb, 3);
+        frame.pixels[pixel * 4 + 3] = 255;
+      }
+
+      std::ostringstream stream;
+      FrameEncoder::WriteY4MFrame(stream, frame, scratch);
+      const std::string data = stream.str();
+
+      // Y plane of 9 bytes, U and V planes of 4 bytes after the frame marker
+      const uint8 y = (uint8)data[6];
+      const uint8 u = (uint8)data[6 + 9];
+      const uint8 v = (uint8)data[6 + 9 + 4];
+      if (y != color.yuv[0] || u != color.yuv[1] || v != color.yuv[2])
+      {
+        printf("FAILED: RGB %u %u %u gives YUV %u %u %u instead of %u %u %u\n", color.rgb[0], color.rgb[1], color.rgb[2], y, u, v,
+          color.yuv[0], color.yuv[1], color.yuv[2]);
+        passed = false;
+      }
+    }
+
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--output", options.outputPath);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return !options.outputPath.empty();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--output directory]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Sequences of an earlier run would pass for the ones of this run
+  std::error_code error;
+  for (uint32 sequence = 0; sequence <= 3; ++sequence)
+    std::filesystem::remove(FrameEncoder::MakeSequencePath(options.outputPath, sequence), error);
+
+  bool passed = CheckResizedCapture(options.outputPath);
+  passed = CheckColors() && passed;
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+// Checks the vector frustum culling against the scalar reference and measures its throughput, see Core/Scene/Culling/FrustumCulling.h
+// Configure the tools with WOH_TOOLS_AVX2 for the AVX2 path, the SSE2 path is the default on x64.
+//
+// Usage:
+//   FrustumCullingCheck [--objects <count>] [--cameras <count>] [--workers <count>] [--seed <value>]
+// Random spheres around cameras looking in random directions, plus spheres placed on the planes of the frustum, are culled by
+// the scalar reference, by CullRange over ranges that do not start or end on a vector boundary, and by the culler with and
+// without the job system. Every visible list must match the reference. The throughput of the three paths is then measured.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Jobs/JobSystem.h"
+#include "Scene/Camera.h"
+#include "Scene/Culling/FrustumCulling.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    uint32 objectCount = 1000000;
+    uint32 cameraCount = 8;
+    uint32 workerCount = 0; // 0 is one per hardware thread except the calling one
+    uint32 seed = 1;
+  };
+
+  static constexpr float WorldExtent = 1000.0f;
+
+  const char* GetVectorPath()
+  {
+#if defined(WOH_CULLING_AVX2)
+    return "AVX2";
+#elif defined(WOH_CULLING_SSE2)
+    return "SSE2";
+#elif defined(WOH_CULLING_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+  }
+
+  Camera MakeCamera(std::mt19937& random)
+  {
+    std::uniform_real_distribution<float> coordinate(-WorldExtent * 0.5f, WorldExtent * 0.5f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+    Camera camera;
+    camera.SetPerspectiveFov(1.0f, 16.0f / 9.0f, 0.1f, 400.0f);
+    const Vec3 position(coordinate(random), coordinate(random) * 0.1f, coordinate(random));
+    camera.SetLookAt(position, Vec3(position.x + direction(random), position.y + direction(random) * 0.3f, position.z + direction(random)));
+    return camera;
+  }
+
+  // Spheres on a plane, inside by less than their radius or just outside, where a mistake in the comparison shows
+  void AddPlaneSpheres(const Frustum& frustum, const Vec3& cameraPosition, BoundingSphereArray& spheres, std::mt19937& random)
+  {
+    std::uniform_real_distribution<float> coordinate(-WorldExtent * 0.5f, WorldExtent * 0.5f);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+    const uint32 first = spheres.Size();
+    spheres.Resize(first + 6 * 64);
+    for (uint32 plane = 0; plane < 6; ++plane)
+    {
+      const Vec4& p = frustum.planes[plane];
+      for (uint32 i = 0; i < 64; ++i)
+      {
+        // Project a random point near the camera on the plane, then push it by up to twice its radius
+        Vec3 point(cameraPosition.x + coordinate(random) * 0.1f, cameraPosition.y + coordinate(random) * 0.1f, cameraPosition.z + coordinate(random) * 0.1f);
+        const float distance = p.x * point.x + p.y * point.y + p.z * point.z + p.w;
+        const float radius = 1.0f;
+        const float push = offset(random) * radius;
+        point = Vec3(point.x - p.x * (distance - push), point.y - p.y * (distance - push), point.z - p.z * (distance - push));
+        spheres.Set(first + plane * 64 + i, point, radius);
+      }
+    }
+  }
+
+  bool CompareLists(const char* name, const uint32* indices, uint32 count, const uint32* reference, uint32 referenceCount)
+  {
+    if (count != referenceCount || memcmp(indices, reference, count * sizeof(uint32)) != 0)
+    {
+      printf("FAILED: %s found %u visible spheres, the reference %u\n", name, count, referenceCount);
+      return false;
+    }
+
+    return true;
+  }
+
+  bool CheckCamera(const Camera& camera, const BoundingSphereArray& spheres, JobSystem& jobSystem, FrustumCuller& culler, std::mt19937& random)
+  {
+    const Frustum frustum = Frustum::FromViewProjection(camera.GetViewProjectionMatrix());
+    BoundingSphereArray cameraSpheres = spheres;
+    AddPlaneSpheres(frustum, camera.GetPosition(), cameraSpheres, random);
+    const uint32 count = cameraSpheres.Size();
+
+    std::vector<uint32> reference(count);
+    const uint32 referenceCount = FrustumCuller::CullScalar(frustum, cameraSpheres, 0, count, reference.data());
+
+    bool passed = true;
+    culler.Cull(frustum, cameraSpheres, nullptr);
+    passed = CompareLists("Cull", culler.GetVisibleIndices(), culler.GetVisibleCount(), reference.data(), referenceCount) && passed;
+    culler.Cull(frustum, cameraSpheres, &jobSystem);
+    passed = CompareLists("Cull with jobs", culler.GetVisibleIndices(), culler.GetVisibleCount(), reference.data(), referenceCount) && passed;
+
+    // Ranges of every length up to a few vectors from every start in a vector
+    std::vector<uint32> rangeReference(64);
+    std::vector<uint32> range(64);
+    const uint32 planeSpheres = count - 6 * 64;
+    for (uint32 begin = planeSpheres; begin < planeSpheres + 9; ++begin)
+    {
+      for (uint32 length = 0; length <= 40 && begin + length <= count; ++length)
+      {
+        const uint32 rangeReferenceCount = FrustumCuller::CullScalar(frustum, cameraSpheres, begin, begin + length, rangeReference.data());
+        const uint32 rangeCount = FrustumCuller::CullRange(frustum, cameraSpheres, begin, begin + length, range.data());
+        passed = CompareLists("CullRange", range.data(), rangeCount, rangeReference.data(), rangeReferenceCount) && passed;
+      }
+    }
+
+    return passed;
+  }
+
+  // Cameras look at a known point, so the sphere there must be visible and the one behind the camera must not
+  bool CheckKnownSpheres()
+  {
+    Camera camera;
+    camera.SetPerspectiveFov(1.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+    camera.SetLookAt(Vec3(0.0f, 0.0f, -10.0f), ZeroVector);
+    const Frustum frustum = Frustum::FromViewProjection(camera.GetViewProjectionMatrix());
+
+    BoundingSphereArray spheres;
+    spheres.Resize(5);
+    spheres.Set(0, ZeroVector, 0.1f); // In front
+    spheres.Set(1, Vec3(0.0f, 0.0f, -20.0f), 0.1f); // Behind
+    spheres.Set(2, Vec3(0.0f, 0.0f, 600.0f), 0.1f); // Past the far plane
+    spheres.Set(3, Vec3(0.0f, 0.0f, -20.0f), 15.0f); // Behind but reaching the near plane
+    spheres.Set(4, Vec3(1000.0f, 0.0f, 10.0f), 1.0f); // Far to the side
+
+    uint32 visible[5];
+    const uint32 visibleCount = FrustumCuller::CullRange(frustum, spheres, 0, 5, visible);
+    if (visibleCount != 2 || visible[0] != 0 || visible[1] != 3)
+    {
+      printf("FAILED: the spheres in front of the camera are not the visible ones\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--objects", options.objectCount);
+    commandLine.Add("--cameras", options.cameraCount);
+    commandLine.Add("--workers", options.workerCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.objectCount > 0 && options.cameraCount > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--objects n] [--cameras n] [--workers n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(options.seed);
+  std::uniform_real_distribution<float> coordinate(-WorldExtent * 0.5f, WorldExtent * 0.5f);
+  std::uniform_real_distribution<float> radius(0.1f, 8.0f);
+  BoundingSphereArray spheres;
+  spheres.Resize(options.objectCount);
+  for (uint32 i = 0; i < options.objectCount; ++i)
+    spheres.Set(i, Vec3(coordinate(random), coordinate(random) * 0.1f, coordinate(random)), radius(random));
+
+  JobSystem jobSystem(options.workerCount);
+  FrustumCuller culler;
+  printf("%u spheres, %u cameras, %s vector path, %u workers\n", options.objectCount, options.cameraCount, GetVectorPath(), jobSystem.GetWorkerCount());
+
+  bool passed = CheckKnownSpheres();
+  std::vector<Camera> cameras;
+  for (uint32 camera = 0; camera < options.cameraCount; ++camera)
+  {
+    cameras.push_back(MakeCamera(random));
+    passed = CheckCamera(cameras.back(), spheres, jobSystem, culler, random) && passed;
+  }
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  // Throughput over every camera, a few passes each
+  static constexpr uint32 PassCount = 5;
+  std::vector<uint32> visible(options.objectCount);
+  double scalar = 0.0;
+  double vector = 0.0;
+  double jobs = 0.0;
+  uint64 visibleCount = 0;
+  for (const Camera& camera : cameras)
+  {
+    const Frustum frustum = Frustum::FromViewProjection(camera.GetViewProjectionMatrix());
+    for (uint32 pass = 0; pass < PassCount; ++pass)
+    {
+      auto start = ToolClock::now();
+      visibleCount += FrustumCuller::CullScalar(frustum, spheres, 0, options.objectCount, visible.data());
+      scalar += GetMilliseconds(start);
+
+      start = ToolClock::now();
+      culler.Cull(frustum, spheres, nullptr);
+      vector += GetMilliseconds(start);
+
+      start = ToolClock::now();
+      culler.Cull(frustum, spheres, &jobSystem);
+      jobs += GetMilliseconds(start);
+    }
+  }
+
+  const double objects = (double)options.objectCount * options.cameraCount * PassCount;
+  printf("%.1f%% visible on average\n", 100.0 * visibleCount / objects);
+  printf("%10s %14s\n", "path", "objects/ms");
+  printf("%10s %14.0f\n", "scalar", objects / scalar);
+  printf("%10s %14.0f\n", GetVectorPath(), objects / vector);
+  printf("%10s %14.0f\n", "with jobs", objects / jobs);
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+// Checks the reference of the GPU culling kernel against the CPU frustum culler, see Core/Graphics/GPUCulling.h
+// Floating point contraction is off in its build, the results have to match the shader bit for bit.
+//
+// Usage:
+//   GPUCullingCheck [--objects <count>] [--frustums <count>] [--seed <value>]
+// For every random frustum the visible set of the three kernel passes has to be the visible set of FrustumCuller, in the same
+// order, and every compacted command has to be the command of its object. Object counts that are not a multiple of the group
+// sizes are checked too.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/GPUCulling.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    uint32 objectCount = 1000000;
+    uint32 frustumCount = 20;
+    uint32 seed = 1;
+  };
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--objects", options.objectCount);
+    commandLine.Add("--frustums", options.frustumCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.objectCount > 0 && options.frustumCount > 0;
+  }
+
+  Frustum MakeRandomFrustum(std::mt19937& random)
+  {
+    std::uniform_real_distribution<float> position(-400.0f, 400.0f);
+    std::uniform_real_distribution<float> fov(0.5f, 1.5f);
+
+    const DirectX::XMVECTOR eye = DirectX::XMVectorSet(position(random), position(random) * 0.25f, position(random), 1.0f);
+    const DirectX::XMVECTOR target = DirectX::XMVectorSet(position(random), position(random) * 0.25f, position(random), 1.0f);
+    const Mat view = DirectX::XMMatrixLookAtLH(eye, target, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const Mat projection = DirectX::XMMatrixPerspectiveFovLH(fov(random), 16.0f / 9.0f, 0.1f, 300.0f);
+
+    Mat4x4 viewProjection;
+    DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+    return Frustum::FromViewProjection(viewProjection);
+  }
+
+  // Returns false on the first difference
+  bool CheckFrustum(const Frustum& frustum, const BoundingSphereArray& spheres, const std::vector<GPUCullObject>& objects,
+    const std::vector<IndirectDrawCommand>& commands, uint32 objectCount, GPUCulling& culling, std::vector<uint32>& visibleIndices,
+    std::vector<IndirectDrawCommand>& output, uint32& visibleCount)
+  {
+    const uint32 scalarCount = FrustumCuller::CullScalar(frustum, spheres, 0, objectCount, visibleIndices.data());
+    std::vector<uint32> vectorIndices(objectCount);
+    const uint32 vectorCount = FrustumCuller::CullRange(frustum, spheres, 0, objectCount, vectorIndices.data());
+    const uint32 drawCount = culling.Cull(frustum, objects.data(), commands.data(), objectCount, output.data());
+
+    visibleCount = drawCount;
+    if (drawCount != scalarCount || drawCount != vectorCount)
+    {
+      printf("  visible count differs: kernel %u, scalar %u, vector %u\n", drawCount, scalarCount, vectorCount);
+      return false;
+    }
+
+    for (uint32 i = 0; i < drawCount; ++i)
+    {
+      const uint32 index = visibleIndices[i];
+      if (vectorIndices[i] != index || output[i].objectIndex != index || memcmp(&output[i], &commands[index], sizeof(IndirectDrawCommand)) != 0)
+      {
+        printf("  draw %u differs: scalar object %u, vector object %u, kernel object %u\n", i, index, vectorIndices[i], output[i].objectIndex);
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--objects n] [--frustums n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Objects in a box around the cameras, some of them straddle the planes
+  std::mt19937 random(options.seed);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 8.0f);
+
+  BoundingSphereArray spheres;
+  spheres.Resize(options.objectCount);
+  std::vector<GPUCullObject> objects(options.objectCount);
+  std::vector<IndirectDrawCommand> commands(options.objectCount);
+  for (uint32 i = 0; i < options.objectCount; ++i)
+  {
+    const Vec3 center(position(random), position(random) * 0.25f, position(random));
+    const float sphereRadius = radius(random);
+    spheres.Set(i, center, sphereRadius);
+    objects[i] = { { center.x, center.y, center.z }, sphereRadius };
+
+    // Fake views and draw arguments, enough to tell the commands apart
+    IndirectDrawCommand& command = commands[i];
+    command.vertexBufferAddress = 0x10000ull + (uint64)(i % 97) * 4096;
+    command.vertexBufferSize = 4096;
+    command.vertexStride = 24;
+    command.indexBufferAddress = 0x80000000ull + (uint64)(i % 97) * 2048;
+    command.indexBufferSize = 2048;
+    command.indexFormat = 42; // DXGI_FORMAT_R32_UINT
+    command.objectIndex = i;
+    command.indexCountPerInstance = 3 + (i % 97) * 3;
+  }
+
+  GPUCulling culling;
+  std::vector<uint32> visibleIndices(options.objectCount);
+  std::vector<IndirectDrawCommand> output(options.objectCount);
+
+  printf("%u objects, %u frustums, group size %u\n", options.objectCount, options.frustumCount, GPUCulling::CullGroupSize);
+
+  // Partial groups and a scan over less than one chunk per thread
+  const uint32 partialCounts[] = { 1, GPUCulling::CullGroupSize - 1, GPUCulling::CullGroupSize + 1, GPUCulling::CullGroupSize * GPUCulling::ScanGroupSize + 13 };
+  for (uint32 count : partialCounts)
+  {
+    if (count > options.objectCount)
+      continue;
+
+    for (uint32 i = 0; i < options.frustumCount; ++i)
+    {
+      uint32 visibleCount = 0;
+      if (!CheckFrustum(MakeRandomFrustum(random), spheres, objects, commands, count, culling, visibleIndices, output, visibleCount))
+      {
+        printf("FAILED with %u objects\n", count);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Full count, timed
+  double kernelSeconds = 0.0;
+  double scalarSeconds = 0.0;
+  uint64 totalVisible = 0;
+  for (uint32 i = 0; i < options.frustumCount; ++i)
+  {
+    const Frustum frustum = MakeRandomFrustum(random);
+    uint32 visibleCount = 0;
+    if (!CheckFrustum(frustum, spheres, objects, commands, options.objectCount, culling, visibleIndices, output, visibleCount))
+    {
+      printf("FAILED with %u objects\n", options.objectCount);
+      return EXIT_FAILURE;
+    }
+    totalVisible += visibleCount;
+
+    auto start = ToolClock::now();
+    culling.Cull(frustum, objects.data(), commands.data(), options.objectCount, output.data());
+    kernelSeconds += GetSeconds(start);
+
+    start = ToolClock::now();
+    FrustumCuller::CullScalar(frustum, spheres, 0, options.objectCount, visibleIndices.data());
+    scalarSeconds += GetSeconds(start);
+  }
+
+  printf("  identical visible sets and commands, %.1f visible objects per frustum\n", (double)totalVisible / options.frustumCount);
+  printf("  kernel reference %.2f ms, scalar culler %.2f ms per frustum\n", kernelSeconds * 1000.0 / options.frustumCount,
+    scalarSeconds * 1000.0 / options.frustumCount);
+  printf("  GPU input %.1f MiB of spheres and %.1f MiB of commands\n", options.objectCount * (double)sizeof(GPUCullObject) / (1024.0 * 1024.0),
+    options.objectCount * (double)sizeof(IndirectDrawCommand) / (1024.0 * 1024.0));
+  printf("OK\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+// Lookup and iteration of handle pools against a vector of shared pointers, see Core/Memory/HandlePool.h
+//
+// Usage:
+//   HandlePoolBenchmark [--objects <count>] [--churn <percent>] [--frames <count>] [--seed <value>]
+// The objects are the size of a mesh record, the shared pointers are made one by one between other allocations like the ones
+// the scene held before the pools. Every frame destroys and creates a share of the objects, then times the lookup of every
+// object in a random order, like the draw list resolving its handles, and the iteration of all of them. The handles are checked
+// against a reference copy after every frame and the stale handles must not resolve.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Memory/HandlePool.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 objectCount = 100000;
+    float churnPercent = 2.0f;
+    uint32 frameCount = 20;
+    uint32 seed = 1;
+  };
+
+  // Roughly the CPU side of a mesh: bounds, counts and a few GPU pointers
+  struct Object
+  {
+    uint32 id = 0;
+    uint32 indexCount = 0;
+    float bounds[6] = {};
+    uint64 resources[4] = {};
+  };
+
+  struct Timing
+  {
+    double lookupMilliseconds = 0.0;
+    double iterateMilliseconds = 0.0;
+    uint64 checksum = 0;
+  };
+
+  Object MakeObject(uint32 id)
+  {
+    Object object;
+    object.id = id;
+    object.indexCount = 36 + id % 1000;
+    return object;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--objects", options.objectCount);
+    commandLine.Add("--churn", options.churnPercent);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.objectCount > 0 && options.frameCount > 0 && options.churnPercent >= 0.0f && options.churnPercent <= 100.0f;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--objects n] [--churn percent] [--frames n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(options.seed);
+
+  // Same objects in both, the shared pointers are spread over the heap by the allocations in between
+  HandlePool<Object> pool;
+  std::vector<Handle<Object>> handles; // Position i holds object ids[i]
+  std::vector<std::shared_ptr<Object>> sharedObjects;
+  std::vector<std::unique_ptr<uint8[]>> otherAllocations;
+  std::vector<uint32> ids;
+  uint32 nextId = 0;
+  for (uint32 i = 0; i < options.objectCount; ++i)
+  {
+    handles.push_back(pool.Create(MakeObject(nextId)));
+    sharedObjects.push_back(std::make_shared<Object>(MakeObject(nextId)));
+    otherAllocations.push_back(std::make_unique<uint8[]>(16 + random() % 256));
+    ids.push_back(nextId++);
+  }
+  otherAllocations.clear();
+
+  const uint32 churnCount = (uint32)(options.objectCount * options.churnPercent / 100.0f);
+  printf("%u objects of %u bytes, %u destroyed and created per frame, %u frames\n", options.objectCount, (uint32)sizeof(Object), churnCount,
+    options.frameCount);
+
+  Timing poolTiming;
+  Timing sharedTiming;
+  std::vector<uint32> lookupOrder(options.objectCount);
+  std::vector<Handle<Object>> staleHandles;
+  bool passed = true;
+  for (uint32 frame = 0; frame < options.frameCount; ++frame)
+  {
+    for (uint32 i = 0; i < churnCount; ++i)
+    {
+      const uint32 position = random() % (uint32)handles.size();
+      staleHandles.push_back(handles[position]);
+      pool.Destroy(handles[position]);
+      handles[position] = pool.Create(MakeObject(nextId));
+      sharedObjects[position] = std::make_shared<Object>(MakeObject(nextId));
+      ids[position] = nextId++;
+    }
+
+    for (uint32 i = 0; i < options.objectCount; ++i)
+      lookupOrder[i] = i;
+    std::shuffle(lookupOrder.begin(), lookupOrder.end(), random);
+
+    auto start = ToolClock::now();
+    for (uint32 position : lookupOrder)
+    {
+      const Object* object = pool.Get(handles[position]);
+      poolTiming.checksum += object->indexCount + object->id;
+    }
+    poolTiming.lookupMilliseconds += GetMilliseconds(start);
+
+    start = ToolClock::now();
+    for (uint32 position : lookupOrder)
+    {
+      const Object* object = sharedObjects[position].get();
+      sharedTiming.checksum += object->indexCount + object->id;
+    }
+    sharedTiming.lookupMilliseconds += GetMilliseconds(start);
+
+    start = ToolClock::now();
+    for (const Object& object : pool)
+      poolTiming.checksum += object.indexCount + object.id;
+    poolTiming.iterateMilliseconds += GetMilliseconds(start);
+
+    start = ToolClock::now();
+    for (const std::shared_ptr<Object>& object : sharedObjects)
+      sharedTiming.checksum += object->indexCount + object->id;
+    sharedTiming.iterateMilliseconds += GetMilliseconds(start);
+
+    for (uint32 position = 0; position < options.objectCount && passed; ++position)
+    {
+      const Object* object = pool.Get(handles[position]);
+      if (object == nullptr || object->id != ids[position])
+      {
+        printf("FAILED: frame %u, the handle at %u does not resolve to object %u\n", frame, position, ids[position]);
+        passed = false;
+      }
+    }
+  }
+
+  for (const Handle<Object>& handle : staleHandles)
+  {
+    if (pool.Get(handle) != nullptr)
+    {
+      printf("FAILED: a destroyed object's handle still resolves\n");
+      passed = false;
+      break;
+    }
+  }
+
+  if (pool.Size() != options.objectCount)
+  {
+    printf("FAILED: %u objects in the pool instead of %u\n", pool.Size(), options.objectCount);
+    passed = false;
+  }
+
+  if (poolTiming.checksum != sharedTiming.checksum)
+  {
+    printf("FAILED: the pool and the shared pointers did not read the same objects\n");
+    passed = false;
+  }
+
+  const double frames = options.frameCount;
+  printf("%14s %12s %12s\n", "", "lookup ms", "iterate ms");
+  printf("%14s %12.3f %12.3f\n", "handle pool", poolTiming.lookupMilliseconds / frames, poolTiming.iterateMilliseconds / frames);
+  printf("%14s %12.3f %12.3f\n", "shared_ptr", sharedTiming.lookupMilliseconds / frames, sharedTiming.iterateMilliseconds / frames);
+  printf("Lookup %.2fx, iteration %.2fx faster with the pool\n", sharedTiming.lookupMilliseconds / poolTiming.lookupMilliseconds,
+    sharedTiming.iterateMilliseconds / poolTiming.iterateMilliseconds);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
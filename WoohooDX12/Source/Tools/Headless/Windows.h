@@ -0,0 +1,24 @@
+#pragma once
+
+// Stand-in for the Windows SDK header of the same name, for the headless tools only, see Tools/HeadlessRenderer.h
+// Declares the types the engine headers name, nothing can be called through them.
+
+#include <cstdint>
+
+typedef int BOOL;
+typedef long LONG;
+typedef long HRESULT;
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+typedef float FLOAT;
+typedef void* HANDLE;
+typedef struct HWND__* HWND;
+
+#define TRUE 1
+#define FALSE 0
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+
+#ifndef _countof
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#endif
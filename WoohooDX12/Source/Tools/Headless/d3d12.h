@@ -0,0 +1,34 @@
+#pragma once
+
+// Stand-in for the Windows SDK header of the same name, for the headless tools only, see Tools/HeadlessRenderer.h
+// The interfaces are incomplete types and the structures only have the members the engine headers use.
+
+#include "Windows.h"
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+
+enum D3D12_RESOURCE_STATES { D3D12_RESOURCE_STATE_COMMON = 0 };
+enum DXGI_FORMAT { DXGI_FORMAT_UNKNOWN = 0 };
+
+struct D3D12_VIEWPORT { FLOAT TopLeftX, TopLeftY, Width, Height, MinDepth, MaxDepth; };
+struct D3D12_RECT { LONG left, top, right, bottom; };
+struct D3D12_VERTEX_BUFFER_VIEW { D3D12_GPU_VIRTUAL_ADDRESS BufferLocation; UINT SizeInBytes; UINT StrideInBytes; };
+struct D3D12_INDEX_BUFFER_VIEW { D3D12_GPU_VIRTUAL_ADDRESS BufferLocation; UINT SizeInBytes; DXGI_FORMAT Format; };
+struct D3D12_SUBRESOURCE_FOOTPRINT { DXGI_FORMAT Format; UINT Width, Height, Depth, RowPitch; };
+struct D3D12_PLACED_SUBRESOURCE_FOOTPRINT { UINT64 Offset; D3D12_SUBRESOURCE_FOOTPRINT Footprint; };
+struct D3D12_GRAPHICS_PIPELINE_STATE_DESC;
+
+struct ID3D10Blob;
+typedef ID3D10Blob ID3DBlob;
+struct ID3D12Device;
+struct ID3D12Resource;
+struct ID3D12CommandQueue;
+struct ID3D12CommandAllocator;
+struct ID3D12GraphicsCommandList;
+struct ID3D12DescriptorHeap;
+struct ID3D12RootSignature;
+struct ID3D12PipelineState;
+struct ID3D12CommandSignature;
+struct ID3D12Fence;
+struct ID3D12Debug1;
+struct ID3D12DebugDevice;
@@ -0,0 +1,7 @@
+#pragma once
+
+// Stand-in for the Windows SDK header of the same name, for the headless tools only, see Tools/HeadlessRenderer.h
+
+#include "d3d12.h"
+
+struct IDXGIAdapter1;
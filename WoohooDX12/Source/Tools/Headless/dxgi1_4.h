@@ -0,0 +1,8 @@
+#pragma once
+
+// Stand-in for the Windows SDK header of the same name, for the headless tools only, see Tools/HeadlessRenderer.h
+
+#include "dxgi1_3.h"
+
+struct IDXGIFactory4;
+struct IDXGISwapChain3;
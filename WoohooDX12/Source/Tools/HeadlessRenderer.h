@@ -0,0 +1,112 @@
+#pragma once
+
+// Renderer without a device for the tools running the scene renderer, see Core/Graphics/Renderer.h
+// The tools build with the stand-ins of Tools/Headless in place of the Windows SDK headers. CMakeLists.txt leaves the sources
+// calling D3D12 out of their build: the entry points the scene renderer uses are defined here and only count the draws and the uploads.
+// Include it in one translation unit of the tool.
+
+#include "Graphics/Renderer.h"
+
+namespace WoohooDX12
+{
+  struct HeadlessRendererCounters
+  {
+    uint32 drawCount = 0;
+    uint32 uploadCount = 0;
+    uint32 residentMeshCount = 0; // Uploaded and not uninitialized yet
+    uint64 uploadedBytes = 0;
+    uint64 committedBytes = 0; // Of the uploads, see GetCommittedBytes()
+  };
+
+  inline HeadlessRendererCounters g_headlessRenderer;
+
+  // Committed resources are placed on 64 KiB
+  static constexpr uint64 CommittedResourceAlignment = 64 * 1024;
+
+  inline uint32 GetTotalIndexCount(const Mesh& mesh)
+  {
+    const MeshLOD& last = mesh.GetLOD(mesh.GetLODCount() - 1);
+    return last.indexOffset + last.indexCount;
+  }
+
+  // Vertices in the layout and 16-bit indices when the vertices fit, like Mesh::Init without the copies of the split
+  inline uint64 GetUploadBytes(const Mesh& mesh, const VertexLayout& layout)
+  {
+    const uint64 indexSize = mesh.GetVertexCount() <= 0x10000 ? sizeof(uint16) : sizeof(uint32);
+    return (uint64)layout.stride * mesh.GetVertexCount() + indexSize * GetTotalIndexCount(mesh);
+  }
+
+  // Vertex and index buffers in the default heap, and the upload buffers the mesh keeps until UnInit
+  inline uint64 GetCommittedBytes(const Mesh& mesh, const VertexLayout& layout)
+  {
+    const uint64 indexSize = mesh.GetVertexCount() <= 0x10000 ? sizeof(uint16) : sizeof(uint32);
+    const auto align = [](uint64 size) { return (size + CommittedResourceAlignment - 1) / CommittedResourceAlignment * CommittedResourceAlignment; };
+    return 2 * (align((uint64)layout.stride * mesh.GetVertexCount()) + align(indexSize * GetTotalIndexCount(mesh)));
+  }
+
+  Renderer::Renderer() {}
+  Renderer::~Renderer() {}
+  int Renderer::Init(uint32 width, uint32 height, HWND hwnd) { return 0; }
+  int Renderer::InitResources(HandlePool<Material>& materials) { return 0; }
+  int Renderer::UnInit() { return 0; }
+  int Renderer::Resize(uint32 width, uint32 height) { return 0; }
+
+  int Renderer::Render(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Vec4& color, const Camera& camera, uint32 lod)
+  {
+    assert(mesh->IsInitialized() && "Drawn mesh is not uploaded!");
+    g_headlessRenderer.drawCount++;
+    return 0;
+  }
+
+  int Renderer::RenderInstanced(Mesh* mesh, Material* material, const InstanceData* instances, uint32 instanceCount, const Camera& camera, uint32 lod)
+  {
+    assert(mesh->IsInitialized() && "Drawn mesh is not uploaded!");
+    g_headlessRenderer.drawCount += instanceCount;
+    return 0;
+  }
+
+  int Renderer::RenderRanges(Mesh* mesh, Material* material, const Mat4x4& modelMatrix, const Camera& camera, const IndexChunk* ranges, uint32 rangeCount)
+  {
+    assert(mesh->IsInitialized() && "Drawn mesh is not uploaded!");
+    g_headlessRenderer.drawCount += rangeCount;
+    return 0;
+  }
+
+  // The GPU-driven path is not available without a device
+  int Renderer::AllocateIndirectFrame(uint32 objectCount, GPUDrivenFrame& frame) { return -1; }
+  void Renderer::FillIndirectCommand(const Mesh& mesh, const IndexChunk& chunk, uint32 objectIndex, IndirectDrawCommand& command) {}
+  int Renderer::RenderIndirect(const GPUDrivenFrame& frame, const Frustum& frustum, const Camera& camera) { return -1; }
+
+  // Only marks the meshes as uploaded
+  int Renderer::UploadMeshes(Mesh* const* meshes, uint32 count)
+  {
+    for (uint32 i = 0; i < count; ++i)
+    {
+      assert(!meshes[i]->IsInitialized() && "Uploaded mesh is already initialized!");
+      meshes[i]->m_initialized = true;
+      g_headlessRenderer.uploadedBytes += GetUploadBytes(*meshes[i], m_vertexLayout);
+      g_headlessRenderer.committedBytes += GetCommittedBytes(*meshes[i], m_vertexLayout);
+    }
+    g_headlessRenderer.uploadCount += count;
+    g_headlessRenderer.residentMeshCount += count;
+    return 0;
+  }
+
+  // Device side of the meshes and the renderer members, nothing was created
+  int Mesh::UnInit()
+  {
+    if (!m_initialized)
+      return 0;
+
+    g_headlessRenderer.residentMeshCount--;
+    m_initialized = false;
+    return 0;
+  }
+
+  Material::Material() {}
+  Material::~Material() {}
+  int Material::UnInit() { return 0; }
+  ReadbackRing::~ReadbackRing() {}
+  DynamicGeometryBuffer::~DynamicGeometryBuffer() {}
+  GPUDrivenPipeline::~GPUDrivenPipeline() {}
+}
@@ -0,0 +1,478 @@
+// 16-bit index buffers over a corpus of meshes, see Core/Graphics/Geometry/IndexSplitter.h
+//
+// Usage:
+//   IndexFormatBenchmark [--seed <value>] [<file.obj> ...]
+// The corpus is generated like the meshes of a scene: small props, medium meshes with chains of levels of detail, terrain
+// tiles at the 65536 vertex limit, a terrain and a cave past it, and a shuffled scan that is not optimized. Wavefront OBJ files
+// given on the command line are added, only their positions and faces are read. Every mesh goes through the import of
+// Mesh: levels of detail where asked, the vertex cache, overdraw and vertex fetch orders, then the split into 16-bit chunks.
+// The chunks are decoded back and checked to draw the triangles of every level. The index memory of the 32-bit and 16-bit
+// buffers, the vertex copies of the split, the draw count and the index bytes fetched by a frame drawing the full detail of
+// every instance are reported.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/IndexSplitter.h"
+#include "Graphics/Geometry/MeshOptimizer.h"
+#include "Graphics/Geometry/MeshSimplifier.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  constexpr uint32 VertexSize = 24; // Position and colour of the application's vertices
+  constexpr uint32 MaxChunksPerLOD = 16; // Mesh::MaxShortIndexChunks
+
+  struct BenchmarkOptions
+  {
+    uint32 seed = 1;
+    std::vector<std::string> files;
+  };
+
+  struct BenchmarkMesh
+  {
+    std::string name;
+    std::vector<float> positions; // Three floats per vertex
+    std::vector<uint32> indices;
+    std::vector<MeshLOD> lods;
+    uint32 instanceCount = 1; // Draws of the full detail level in a frame
+
+    inline uint32 GetVertexCount() const { return (uint32)positions.size() / 3; }
+  };
+
+  struct CorpusTotals
+  {
+    uint64 indexBytes32 = 0;
+    uint64 indexBytes16 = 0;
+    uint64 copiedVertexBytes = 0;
+    uint64 frameBytes32 = 0;
+    uint64 frameBytes16 = 0;
+    uint32 draws32 = 0;
+    uint32 draws16 = 0;
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--seed", options.seed);
+    commandLine.AddPositional(options.files);
+    return commandLine.Parse(argc, argv);
+  }
+
+  // Grid of segments x segments quads, wrapped on both axes for the torus
+  void BuildGridIndices(uint32 segments, bool wrap, std::vector<uint32>& indices)
+  {
+    const uint32 columns = wrap ? segments : segments + 1;
+    indices.clear();
+    indices.reserve((size_t)segments * segments * 6);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const uint32 x1 = wrap ? (x + 1) % segments : x + 1;
+        const uint32 y1 = wrap ? (y + 1) % segments : y + 1;
+        const uint32 v00 = y * columns + x;
+        const uint32 v10 = y * columns + x1;
+        const uint32 v01 = y1 * columns + x;
+        const uint32 v11 = y1 * columns + x1;
+        indices.insert(indices.end(), { v00, v01, v10, v10, v01, v11 });
+      }
+    }
+  }
+
+  void BuildTorus(uint32 segments, BenchmarkMesh& mesh)
+  {
+    mesh.positions.resize((size_t)segments * segments * 3);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float minor = 0.3f + 0.03f * sinf(u * 7.0f) * sinf(v * 5.0f);
+
+        float* position = &mesh.positions[((size_t)y * segments + x) * 3];
+        position[0] = (1.0f + minor * cosf(v)) * cosf(u);
+        position[1] = minor * sinf(v);
+        position[2] = (1.0f + minor * cosf(v)) * sinf(u);
+      }
+    }
+    BuildGridIndices(segments, true, mesh.indices);
+  }
+
+  void BuildHeightField(uint32 segments, BenchmarkMesh& mesh)
+  {
+    const uint32 columns = segments + 1;
+    mesh.positions.resize((size_t)columns * columns * 3);
+    for (uint32 y = 0; y < columns; ++y)
+    {
+      for (uint32 x = 0; x < columns; ++x)
+      {
+        const float u = (float)x / segments;
+        const float v = (float)y / segments;
+
+        float* position = &mesh.positions[((size_t)y * columns + x) * 3];
+        position[0] = u * 2.0f - 1.0f;
+        position[1] = 0.1f * sinf(u * 9.0f) * cosf(v * 7.0f) + 0.02f * sinf(u * 41.0f + v * 37.0f);
+        position[2] = v * 2.0f - 1.0f;
+      }
+    }
+    BuildGridIndices(segments, false, mesh.indices);
+  }
+
+  // Every subdivision splits the triangles in four, midpoints are shared through a sorted edge list
+  void BuildIcosphere(uint32 triangleCount, BenchmarkMesh& mesh)
+  {
+    const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+    mesh.positions = { -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, 0, 0, -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, t, 0, -1, t, 0, 1, -t, 0, -1, -t, 0, 1 };
+    mesh.indices = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+      3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+
+    while (mesh.indices.size() / 3 * 4 <= triangleCount)
+    {
+      std::vector<uint64> edges;
+      for (size_t i = 0; i < mesh.indices.size(); ++i)
+      {
+        const uint32 a = mesh.indices[i];
+        const uint32 b = mesh.indices[i % 3 == 2 ? i - 2 : i + 1];
+        edges.push_back(((uint64)std::min(a, b) << 32) | std::max(a, b));
+      }
+      std::sort(edges.begin(), edges.end());
+      edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+      const uint32 firstMidpoint = mesh.GetVertexCount();
+      for (uint64 edge : edges)
+      {
+        const uint32 a = (uint32)(edge >> 32);
+        const uint32 b = (uint32)edge;
+        for (uint32 axis = 0; axis < 3; ++axis)
+          mesh.positions.push_back((mesh.positions[a * 3 + axis] + mesh.positions[b * 3 + axis]) * 0.5f);
+      }
+
+      auto midpoint = [&](uint32 a, uint32 b)
+      {
+        const uint64 key = ((uint64)std::min(a, b) << 32) | std::max(a, b);
+        return firstMidpoint + (uint32)(std::lower_bound(edges.begin(), edges.end(), key) - edges.begin());
+      };
+
+      std::vector<uint32> subdivided;
+      subdivided.reserve(mesh.indices.size() * 4);
+      for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      {
+        const uint32 a = mesh.indices[i];
+        const uint32 b = mesh.indices[i + 1];
+        const uint32 c = mesh.indices[i + 2];
+        const uint32 ab = midpoint(a, b);
+        const uint32 bc = midpoint(b, c);
+        const uint32 ca = midpoint(c, a);
+        subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+      }
+      mesh.indices.swap(subdivided);
+    }
+
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+    {
+      float* position = &mesh.positions[vertex * 3];
+      const float length = sqrtf(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+      position[0] /= length;
+      position[1] /= length;
+      position[2] /= length;
+    }
+  }
+
+  // Overlapping spheres, as the parts of a building
+  void BuildSphereCluster(uint32 triangleCount, uint32 seed, BenchmarkMesh& mesh)
+  {
+    constexpr uint32 SphereCount = 24;
+    BenchmarkMesh sphere;
+    BuildIcosphere(triangleCount / SphereCount, sphere);
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> radius(0.3f, 0.7f);
+    for (uint32 s = 0; s < SphereCount; ++s)
+    {
+      const uint32 base = mesh.GetVertexCount();
+      const float center[3] = { offset(random), offset(random), offset(random) };
+      const float r = radius(random);
+      for (uint32 vertex = 0; vertex < sphere.GetVertexCount(); ++vertex)
+        for (uint32 axis = 0; axis < 3; ++axis)
+          mesh.positions.push_back(center[axis] + sphere.positions[vertex * 3 + axis] * r);
+      for (uint32 index : sphere.indices)
+        mesh.indices.push_back(base + index);
+    }
+  }
+
+  // Triangles and vertices in random order, the winding is kept
+  void Shuffle(BenchmarkMesh& mesh, uint32 seed)
+  {
+    std::mt19937 random(seed);
+    const uint32 triangleCount = (uint32)mesh.indices.size() / 3;
+    std::vector<uint32> order(triangleCount);
+    for (uint32 i = 0; i < triangleCount; ++i)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::vector<uint32> vertexOrder(mesh.GetVertexCount());
+    for (uint32 i = 0; i < mesh.GetVertexCount(); ++i)
+      vertexOrder[i] = i;
+    std::shuffle(vertexOrder.begin(), vertexOrder.end(), random);
+
+    std::vector<uint32> indices(mesh.indices.size());
+    for (uint32 i = 0; i < triangleCount; ++i)
+      for (uint32 corner = 0; corner < 3; ++corner)
+        indices[i * 3 + corner] = vertexOrder[mesh.indices[order[i] * 3 + corner]];
+
+    std::vector<float> positions(mesh.positions.size());
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+      memcpy(&positions[vertexOrder[vertex] * 3], &mesh.positions[vertex * 3], 3 * sizeof(float));
+
+    mesh.indices.swap(indices);
+    mesh.positions.swap(positions);
+  }
+
+  bool LoadObj(const std::string& path, BenchmarkMesh& mesh)
+  {
+    std::ifstream file(path);
+    if (!file)
+      return false;
+
+    mesh.name = path;
+    std::string line;
+    std::vector<uint32> face;
+    while (std::getline(file, line))
+    {
+      std::istringstream stream(line);
+      std::string type;
+      stream >> type;
+      if (type == "v")
+      {
+        float position[3] = {};
+        stream >> position[0] >> position[1] >> position[2];
+        mesh.positions.insert(mesh.positions.end(), position, position + 3);
+      }
+      else if (type == "f")
+      {
+        // v, v/vt, v//vn or v/vt/vn, negative indices count from the end, polygons are fanned
+        face.clear();
+        std::string corner;
+        while (stream >> corner)
+        {
+          const int32 index = atoi(corner.c_str());
+          face.push_back(index < 0 ? (uint32)((int32)mesh.GetVertexCount() + index) : (uint32)(index - 1));
+        }
+        for (size_t i = 2; i < face.size(); ++i)
+          mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+      }
+    }
+
+    for (uint32 index : mesh.indices)
+    {
+      if (index >= mesh.GetVertexCount())
+        return false;
+    }
+    return !mesh.indices.empty();
+  }
+
+  // Like Mesh::GenerateLODs then Mesh::OptimizeGeometry, lodCount 1 keeps the full detail level only
+  void Import(BenchmarkMesh& mesh, uint32 lodCount, bool optimize)
+  {
+    mesh.lods = { { 0, (uint32)mesh.indices.size(), 0.0f } };
+    if (lodCount > 1)
+    {
+      SimplifyInput input;
+      input.positions = mesh.positions.data();
+      input.positionStride = 3 * sizeof(float);
+      input.vertexCount = mesh.GetVertexCount();
+      input.indices = mesh.indices.data();
+      input.indexCount = (uint32)mesh.indices.size();
+
+      LODChainOptions options;
+      options.maxLODCount = lodCount;
+      std::vector<uint32> indices;
+      MeshSimplifier simplifier;
+      simplifier.BuildLODChain(input, options, indices, mesh.lods);
+      mesh.indices.swap(indices);
+    }
+
+    if (!optimize)
+      return;
+
+    MeshOptimizer optimizer;
+    for (const MeshLOD& lod : mesh.lods)
+    {
+      uint32* indices = mesh.indices.data() + lod.indexOffset;
+      optimizer.OptimizeVertexCache(indices, lod.indexCount, mesh.GetVertexCount());
+      optimizer.OptimizeOverdraw(indices, lod.indexCount, mesh.positions.data(), 3 * sizeof(float), mesh.GetVertexCount());
+    }
+
+    std::vector<uint32> remap;
+    const uint32 usedCount = optimizer.OptimizeVertexFetch(mesh.indices.data(), (uint32)mesh.indices.size(), mesh.GetVertexCount(), remap);
+    std::vector<float> positions((size_t)usedCount * 3);
+    MeshOptimizer::RemapVertices(positions.data(), mesh.positions.data(), mesh.GetVertexCount(), 3 * sizeof(float), remap.data());
+    mesh.positions.swap(positions);
+  }
+
+  // Triangles with their first corner on the smallest index, so the same triangle compares equal
+  std::vector<std::array<uint32, 3>> GetTriangles(const uint32* indices, uint32 indexCount)
+  {
+    std::vector<std::array<uint32, 3>> triangles(indexCount / 3);
+    for (uint32 i = 0; i < indexCount / 3; ++i)
+    {
+      std::array<uint32, 3> triangle = { indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2] };
+      while (triangle[0] != std::min(triangle[0], std::min(triangle[1], triangle[2])))
+        std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+      triangles[i] = triangle;
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+  }
+
+  // Decodes the chunks of every level back to source vertices
+  bool CheckChunks(const BenchmarkMesh& mesh, const IndexSplitter& splitter)
+  {
+    const std::vector<uint16>& shortIndices = splitter.GetIndices();
+    const std::vector<uint32>& copies = splitter.GetCopiedVertices();
+    const uint32 vertexCount = mesh.GetVertexCount();
+    for (uint32 lod = 0; lod < (uint32)mesh.lods.size(); ++lod)
+    {
+      std::vector<uint32> decoded;
+      for (uint32 c = splitter.GetLODChunkOffsets()[lod]; c < splitter.GetLODChunkOffsets()[lod + 1]; ++c)
+      {
+        const IndexChunk& chunk = splitter.GetChunks()[c];
+        for (uint32 i = chunk.indexOffset; i < chunk.indexOffset + chunk.indexCount; ++i)
+        {
+          const uint32 vertex = chunk.baseVertex + shortIndices[i];
+          if (vertex >= vertexCount + (uint32)copies.size())
+            return false;
+          decoded.push_back(vertex < vertexCount ? vertex : copies[vertex - vertexCount]);
+        }
+      }
+
+      const MeshLOD& level = mesh.lods[lod];
+      if (GetTriangles(decoded.data(), (uint32)decoded.size()) != GetTriangles(mesh.indices.data() + level.indexOffset, level.indexCount))
+        return false;
+    }
+    return true;
+  }
+
+  bool Measure(const BenchmarkMesh& mesh, IndexSplitter& splitter, CorpusTotals& totals)
+  {
+    const auto start = ToolClock::now();
+    const bool shortIndices = splitter.Split(mesh.indices.data(), mesh.lods.data(), (uint32)mesh.lods.size(), mesh.GetVertexCount(), VertexSize,
+      MaxChunksPerLOD);
+    const double seconds = GetSeconds(start);
+
+    const uint64 bytes32 = mesh.indices.size() * sizeof(uint32);
+    const uint64 bytes16 = shortIndices ? splitter.GetIndices().size() * sizeof(uint16) : bytes32;
+    const uint64 copiedBytes = shortIndices ? (uint64)splitter.GetCopiedVertices().size() * VertexSize : 0;
+    const uint32 draws16 = shortIndices ? splitter.GetLODChunkOffsets()[1] : 1;
+    const uint64 frame32 = (uint64)mesh.lods[0].indexCount * sizeof(uint32) * mesh.instanceCount;
+    const uint64 frame16 = (uint64)mesh.lods[0].indexCount * (shortIndices ? sizeof(uint16) : sizeof(uint32)) * mesh.instanceCount;
+
+    totals.indexBytes32 += bytes32;
+    totals.indexBytes16 += bytes16;
+    totals.copiedVertexBytes += copiedBytes;
+    totals.frameBytes32 += frame32;
+    totals.frameBytes16 += frame16;
+    totals.draws32 += mesh.instanceCount;
+    totals.draws16 += draws16 * mesh.instanceCount;
+
+    printf("%-30s %8u %8u %4u  %s", mesh.name.c_str(), mesh.GetVertexCount(), mesh.lods[0].indexCount / 3, (uint32)mesh.lods.size(),
+      shortIndices ? "16-bit" : "32-bit");
+    printf("  %3u draws %6u copies  %8.1f KB -> %8.1f KB  %6.1f ms\n", draws16, shortIndices ? (uint32)splitter.GetCopiedVertices().size() : 0,
+      bytes32 / 1024.0, (bytes16 + copiedBytes) / 1024.0, seconds * 1000.0);
+
+    if (shortIndices && !CheckChunks(mesh, splitter))
+    {
+      printf("  the chunks do not draw the triangles of the levels\n");
+      return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--seed n] [file.obj ...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchmarkMesh> corpus(10);
+  BuildIcosphere(80, corpus[0]);
+  corpus[0] = { "rock", corpus[0].positions, corpus[0].indices, {}, 400 };
+  Import(corpus[0], 1, true);
+  BuildIcosphere(320, corpus[1]);
+  corpus[1] = { "pebble cluster", corpus[1].positions, corpus[1].indices, {}, 400 };
+  Import(corpus[1], 1, true);
+  BuildTorus(16, corpus[2]);
+  corpus[2] = { "barrel", corpus[2].positions, corpus[2].indices, {}, 200 };
+  Import(corpus[2], 1, true);
+  BuildIcosphere(20480, corpus[3]);
+  corpus[3] = { "statue", corpus[3].positions, corpus[3].indices, {}, 20 };
+  Import(corpus[3], 4, true);
+  BuildTorus(128, corpus[4]);
+  corpus[4] = { "character", corpus[4].positions, corpus[4].indices, {}, 10 };
+  Import(corpus[4], 5, true);
+  BuildSphereCluster(80000, options.seed, corpus[5]);
+  corpus[5] = { "building", corpus[5].positions, corpus[5].indices, {}, 4 };
+  Import(corpus[5], 3, true);
+  BuildHeightField(255, corpus[6]);
+  corpus[6] = { "terrain tile, 65536 vertices", corpus[6].positions, corpus[6].indices, {}, 16 };
+  Import(corpus[6], 1, true);
+  BuildHeightField(511, corpus[7]);
+  corpus[7] = { "terrain", corpus[7].positions, corpus[7].indices, {}, 1 };
+  Import(corpus[7], 3, true);
+  BuildTorus(400, corpus[8]);
+  corpus[8] = { "cave", corpus[8].positions, corpus[8].indices, {}, 1 };
+  Import(corpus[8], 1, true);
+  // Past the vertex limit and not optimized, the windows do not follow the triangles
+  BuildTorus(300, corpus[9]);
+  Shuffle(corpus[9], options.seed);
+  corpus[9] = { "scan, not optimized", corpus[9].positions, corpus[9].indices, {}, 1 };
+  Import(corpus[9], 1, false);
+
+  for (const std::string& file : options.files)
+  {
+    BenchmarkMesh mesh;
+    if (!LoadObj(file, mesh))
+    {
+      printf("Can not load %s\n", file.c_str());
+      return EXIT_FAILURE;
+    }
+    Import(mesh, 1, true);
+    corpus.push_back(std::move(mesh));
+  }
+
+  printf("%-30s %8s %8s %4s  format  draws of full detail, vertex copies, index memory with the copies\n", "mesh", "vertices", "tris", "lods");
+  IndexSplitter splitter;
+  CorpusTotals totals;
+  bool passed = true;
+  for (const BenchmarkMesh& mesh : corpus)
+    passed = Measure(mesh, splitter, totals) && passed;
+
+  const uint64 memory16 = totals.indexBytes16 + totals.copiedVertexBytes;
+  printf("\nindex memory: %.1f KB with 32-bit indices, %.1f KB with 16-bit indices and %.1f KB of vertex copies, %.1f%% saved\n",
+    totals.indexBytes32 / 1024.0, totals.indexBytes16 / 1024.0, totals.copiedVertexBytes / 1024.0, 100.0 * (1.0 - (double)memory16 / totals.indexBytes32));
+  printf("index fetch of a frame: %.1f KB -> %.1f KB, %.1f%% saved, %u -> %u draws\n", totals.frameBytes32 / 1024.0, totals.frameBytes16 / 1024.0,
+    100.0 * (1.0 - (double)totals.frameBytes16 / totals.frameBytes32), totals.draws32, totals.draws16);
+
+  if (!passed)
+    return EXIT_FAILURE;
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
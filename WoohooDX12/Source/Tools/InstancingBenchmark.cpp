@@ -0,0 +1,163 @@
+// CPU side of automatic instancing, see Core/Graphics/InstanceBatcher.h
+//
+// Usage:
+//   InstancingBenchmark [--objects <count>] [--meshes <count>] [--materials <count>] [--frames <count>]
+// Compares the per object path (sorted draws, the uniforms of every draw written to a constant buffer) with the instanced
+// path (sorted draws, runs packed into one instance stream). The D3D calls are not made, the draw call counts are
+// reported next to the CPU time of preparing them.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/InstanceBatcher.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 objectCount = 100000;
+    uint32 meshCount = 100;
+    uint32 materialCount = 1;
+    uint32 frameCount = 20;
+  };
+
+  // Same layout as the uniform buffer of a material, one per draw on the per object path
+  struct Uniforms
+  {
+    Mat projectionMatrix;
+    Mat viewMatrix;
+    Mat modelMatrix;
+    Vec4 color;
+  };
+  static constexpr uint32 UniformStride = (sizeof(Uniforms) + 255) & ~255;
+
+  struct Object
+  {
+    uint32 mesh = 0;
+    uint32 material = 0;
+    Mat4x4 world;
+    Vec4 color;
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--objects", options.objectCount);
+    commandLine.Add("--meshes", options.meshCount);
+    commandLine.Add("--materials", options.materialCount);
+    commandLine.Add("--frames", options.frameCount);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.objectCount > 0 && options.meshCount > 0 && options.materialCount > 0 && options.frameCount > 0;
+  }
+
+  // Objects are stored in creation order, which does not follow the meshes
+  void BuildDrawList(const std::vector<Object>& objects, const std::vector<Mesh*>& meshes, const std::vector<Material*>& materials,
+    std::vector<DrawItem>& drawList)
+  {
+    drawList.clear();
+    for (uint32 i = 0; i < (uint32)objects.size(); ++i)
+    {
+      const Object& object = objects[i];
+      drawList.push_back({ meshes[object.mesh], materials[object.material], &object.world, object.color,
+        InstanceBatcher::MakeSortKey(object.material, object.mesh), i });
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--objects n] [--meshes n] [--materials n] [--frames n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Object> objects(options.objectCount);
+  for (Object& object : objects)
+  {
+    object.mesh = random() % options.meshCount;
+    object.material = random() % options.materialCount;
+    DirectX::XMStoreFloat4x4(&object.world, DirectX::XMMatrixTranslation(position(random), position(random), position(random)));
+    object.color = Vec4(unit(random), unit(random), unit(random), 1.0f);
+  }
+
+  // Only their addresses are used, they stand in for the meshes and materials of the scene
+  std::vector<uint64> slots(options.meshCount + options.materialCount);
+  std::vector<Mesh*> meshes(options.meshCount);
+  std::vector<Material*> materials(options.materialCount);
+  for (uint32 i = 0; i < options.meshCount; ++i)
+    meshes[i] = reinterpret_cast<Mesh*>(&slots[i]);
+  for (uint32 i = 0; i < options.materialCount; ++i)
+    materials[i] = reinterpret_cast<Material*>(&slots[options.meshCount + i]);
+
+  Mat4x4 view;
+  Mat4x4 projection;
+  MakeIdentity(view);
+  MakeIdentity(projection);
+
+  std::vector<DrawItem> drawList;
+  drawList.reserve(options.objectCount);
+  std::vector<uint8> uploadMemory((size_t)options.objectCount * UniformStride);
+  InstanceBatcher batcher;
+
+  printf("%u objects, %u meshes, %u materials, %u frames\n", options.objectCount, options.meshCount, options.materialCount, options.frameCount);
+
+  // Per object: one uniform update and one draw per object
+  double perObjectSeconds = 0.0;
+  uint32 perObjectDrawCount = 0;
+  for (uint32 frame = 0; frame < options.frameCount; ++frame)
+  {
+    const auto start = ToolClock::now();
+    BuildDrawList(objects, meshes, materials, drawList);
+    InstanceBatcher::SortDraws(drawList.data(), (uint32)drawList.size());
+
+    Uniforms uniforms;
+    uniforms.viewMatrix = DirectX::XMLoadFloat4x4(&view);
+    uniforms.projectionMatrix = DirectX::XMLoadFloat4x4(&projection);
+    for (uint32 i = 0; i < (uint32)drawList.size(); ++i)
+    {
+      uniforms.modelMatrix = DirectX::XMLoadFloat4x4(drawList[i].modelMatrix);
+      uniforms.color = drawList[i].color;
+      memcpy(uploadMemory.data() + (size_t)i * UniformStride, &uniforms, sizeof(uniforms));
+    }
+    perObjectDrawCount = (uint32)drawList.size();
+    perObjectSeconds += GetSeconds(start);
+  }
+
+  // Instanced: one instance stream, one draw per run
+  double instancedSeconds = 0.0;
+  uint32 instancedDrawCount = 0;
+  for (uint32 frame = 0; frame < options.frameCount; ++frame)
+  {
+    const auto start = ToolClock::now();
+    BuildDrawList(objects, meshes, materials, drawList);
+    batcher.Build(drawList.data(), (uint32)drawList.size());
+
+    for (const DrawRun& run : batcher.GetRuns())
+      memcpy(uploadMemory.data() + (size_t)run.firstInstance * sizeof(InstanceData), batcher.GetInstances() + run.firstInstance, run.instanceCount * sizeof(InstanceData));
+    instancedDrawCount = (uint32)batcher.GetRuns().size();
+    instancedSeconds += GetSeconds(start);
+  }
+
+  const double perObjectMilliseconds = perObjectSeconds * 1000.0 / options.frameCount;
+  const double instancedMilliseconds = instancedSeconds * 1000.0 / options.frameCount;
+  printf("  per object: %7u draws, %8.2f ms/frame, %8.1f KiB uploaded\n", perObjectDrawCount, perObjectMilliseconds,
+    perObjectDrawCount * (double)UniformStride / 1024.0);
+  printf("  instanced:  %7u draws, %8.2f ms/frame, %8.1f KiB uploaded\n", instancedDrawCount, instancedMilliseconds,
+    options.objectCount * (double)sizeof(InstanceData) / 1024.0);
+  printf("  %.0fx fewer draws, CPU preparation %.2fx faster\n", (double)perObjectDrawCount / instancedDrawCount, perObjectMilliseconds / instancedMilliseconds);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+// Simplification speed and level of detail reduction, see Core/Graphics/Geometry/MeshSimplifier.h and MeshLOD.h
+//
+// Usage:
+//   LODBenchmark [--triangles <count>] [--objects <count>] [--threshold <pixels>] [--seed <value>]
+// Simplifies a closed mesh (a bumpy torus) and an open one (a height field with a border) of the given triangle count to a
+// half, a tenth and a hundredth, and builds their level of detail chains. Then a field of objects is drawn from a 1080p
+// camera with and without the level selection, and the camera is moved back and forth to count the level switches with
+// and without hysteresis.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/MeshSimplifier.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 triangleCount = 1000000;
+    uint32 objectCount = 5000;
+    float thresholdPixels = 1.0f;
+    uint32 seed = 1;
+  };
+
+  // Same layout as the vertices of the meshes
+  struct BenchmarkVertex
+  {
+    float position[3];
+    float color[3];
+  };
+
+  struct BenchmarkMesh
+  {
+    const char* name = "";
+    std::vector<BenchmarkVertex> vertices;
+    std::vector<uint32> indices;
+
+    SimplifyInput GetInput() const
+    {
+      SimplifyInput input;
+      input.positions = vertices[0].position;
+      input.positionStride = sizeof(BenchmarkVertex);
+      input.attributes = vertices[0].color;
+      input.attributeStride = sizeof(BenchmarkVertex);
+      input.attributeCount = 3;
+      input.vertexCount = (uint32)vertices.size();
+      input.indices = indices.data();
+      input.indexCount = (uint32)indices.size();
+      return input;
+    }
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--triangles", options.triangleCount);
+    commandLine.Add("--objects", options.objectCount);
+    commandLine.Add("--threshold", options.thresholdPixels);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.triangleCount >= 8 && options.objectCount > 0 && options.thresholdPixels > 0.0f;
+  }
+
+  // Grid of segments x segments quads, wrapped on both axes for the torus
+  void BuildGridIndices(uint32 segments, bool wrap, std::vector<uint32>& indices)
+  {
+    const uint32 columns = wrap ? segments : segments + 1;
+    indices.clear();
+    indices.reserve((size_t)segments * segments * 6);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const uint32 x1 = wrap ? (x + 1) % segments : x + 1;
+        const uint32 y1 = wrap ? (y + 1) % segments : y + 1;
+        const uint32 v00 = y * columns + x;
+        const uint32 v10 = y * columns + x1;
+        const uint32 v01 = y1 * columns + x;
+        const uint32 v11 = y1 * columns + x1;
+        indices.insert(indices.end(), { v00, v01, v10, v10, v01, v11 });
+      }
+    }
+  }
+
+  void BuildTorus(uint32 segments, BenchmarkMesh& mesh)
+  {
+    mesh.name = "torus";
+    mesh.vertices.resize((size_t)segments * segments);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float bumps = 0.03f * sinf(u * 7.0f) * sinf(v * 5.0f);
+        const float minor = 0.3f + bumps;
+
+        BenchmarkVertex& vertex = mesh.vertices[(size_t)y * segments + x];
+        vertex.position[0] = (1.0f + minor * cosf(v)) * cosf(u);
+        vertex.position[1] = minor * sinf(v);
+        vertex.position[2] = (1.0f + minor * cosf(v)) * sinf(u);
+        vertex.color[0] = 0.5f + 0.5f * sinf(u * 3.0f);
+        vertex.color[1] = 0.5f + 0.5f * cosf(v * 2.0f);
+        vertex.color[2] = 0.5f;
+      }
+    }
+    BuildGridIndices(segments, true, mesh.indices);
+  }
+
+  void BuildHeightField(uint32 segments, BenchmarkMesh& mesh)
+  {
+    mesh.name = "height field";
+    const uint32 columns = segments + 1;
+    mesh.vertices.resize((size_t)columns * columns);
+    for (uint32 y = 0; y < columns; ++y)
+    {
+      for (uint32 x = 0; x < columns; ++x)
+      {
+        const float u = (float)x / segments;
+        const float v = (float)y / segments;
+        const float height = 0.1f * sinf(u * 9.0f) * cosf(v * 7.0f) + 0.02f * sinf(u * 41.0f + v * 37.0f);
+
+        BenchmarkVertex& vertex = mesh.vertices[(size_t)y * columns + x];
+        vertex.position[0] = u * 2.0f - 1.0f;
+        vertex.position[1] = height;
+        vertex.position[2] = v * 2.0f - 1.0f;
+        vertex.color[0] = height * 4.0f + 0.5f;
+        vertex.color[1] = 0.6f;
+        vertex.color[2] = 0.3f;
+      }
+    }
+    BuildGridIndices(segments, false, mesh.indices);
+  }
+
+  void BenchmarkSimplification(const BenchmarkMesh& mesh)
+  {
+    const SimplifyInput input = mesh.GetInput();
+    const uint32 triangleCount = input.indexCount / 3;
+    printf("%s: %u triangles, %u vertices\n", mesh.name, triangleCount, input.vertexCount);
+
+    MeshSimplifier simplifier;
+    std::vector<uint32> destination(input.indexCount);
+    const float ratios[] = { 0.5f, 0.1f, 0.01f };
+    for (float ratio : ratios)
+    {
+      const auto start = ToolClock::now();
+      float error = 0.0f;
+      const uint32 indexCount = simplifier.Simplify(input, (uint32)(input.indexCount * ratio), SimplifyOptions(), destination.data(), &error);
+      const double seconds = GetSeconds(start);
+      printf("  to %5.1f%%: %8u triangles, error %.5f, %7.1f ms, %5.2f M triangles/s\n", ratio * 100.0f, indexCount / 3, error, seconds * 1000.0,
+        triangleCount / seconds / 1e6);
+    }
+
+    std::vector<uint32> lodIndices;
+    std::vector<MeshLOD> lods;
+    const auto start = ToolClock::now();
+    simplifier.BuildLODChain(input, LODChainOptions(), lodIndices, lods);
+    printf("  chain of %u levels in %.1f ms:", (uint32)lods.size(), GetSeconds(start) * 1000.0);
+    for (const MeshLOD& lod : lods)
+      printf(" %u (%.4f)", lod.indexCount / 3, lod.error);
+    printf("\n");
+  }
+
+  struct SceneObject
+  {
+    Vec3 position;
+    float scale;
+    uint32 lod;
+  };
+
+  // Triangles of the field from the camera, selecting the levels when lods has more than one level
+  uint64 DrawField(std::vector<SceneObject>& objects, const MeshLOD* lods, uint32 lodCount, const Vec3& camera, float localRadius,
+    float projectionScale, float thresholdPixels, float hysteresis, uint32& switchCount, uint32* histogram)
+  {
+    uint64 triangleCount = 0;
+    for (SceneObject& object : objects)
+    {
+      const float dx = object.position.x - camera.x;
+      const float dy = object.position.y - camera.y;
+      const float dz = object.position.z - camera.z;
+      const float distance = sqrtf(dx * dx + dy * dy + dz * dz) - localRadius * object.scale;
+
+      const uint32 lod = LODSelector::Select(lods, lodCount, object.lod, object.scale, distance, projectionScale, thresholdPixels, hysteresis);
+      switchCount += lod != object.lod ? 1 : 0;
+      object.lod = lod;
+      triangleCount += lods[lod].indexCount / 3;
+      if (histogram != nullptr)
+        histogram[lod]++;
+    }
+    return triangleCount;
+  }
+
+  void BenchmarkScene(const BenchmarkOptions& options)
+  {
+    // A 20k triangle prop with its chain
+    BenchmarkMesh prop;
+    BuildTorus(100, prop);
+    MeshSimplifier simplifier;
+    std::vector<uint32> lodIndices;
+    std::vector<MeshLOD> lods;
+    simplifier.BuildLODChain(prop.GetInput(), LODChainOptions(), lodIndices, lods);
+    const float localRadius = 1.33f;
+
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 3.0f);
+    std::vector<SceneObject> objects(options.objectCount);
+    for (SceneObject& object : objects)
+      object = { Vec3(position(random), 0.0f, position(random)), scale(random), 0 };
+
+    Mat4x4 projection;
+    DirectX::XMStoreFloat4x4(&projection, DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4 * 1.33f, 16.0f / 9.0f, 0.1f, 2000.0f));
+    const float projectionScale = LODSelector::GetProjectionScale(projection, 1080);
+
+    uint32 switchCount = 0;
+    uint32 histogram[MeshLOD::MaxCount] = {};
+    const Vec3 camera(0.0f, 2.0f, 0.0f);
+    const uint64 fullCount = DrawField(objects, lods.data(), 1, camera, localRadius, projectionScale, options.thresholdPixels, 0.0f, switchCount, nullptr);
+    for (SceneObject& object : objects)
+      object.lod = 0;
+    const uint64 lodCount = DrawField(objects, lods.data(), (uint32)lods.size(), camera, localRadius, projectionScale, options.thresholdPixels, 0.25f,
+      switchCount, histogram);
+
+    printf("scene: %u objects of %u triangles, 1080p, %.1f pixel threshold\n", options.objectCount, lods[0].indexCount / 3, options.thresholdPixels);
+    printf("  full detail %llu triangles, with levels %llu triangles, %.1fx fewer\n", (unsigned long long)fullCount, (unsigned long long)lodCount,
+      (double)fullCount / lodCount);
+    printf("  objects per level:");
+    for (uint32 i = 0; i < (uint32)lods.size(); ++i)
+      printf(" %u", histogram[i]);
+    printf("\n");
+
+    // Small steps back and forth, the objects near a switch distance cross it every frame
+    const float hysteresisValues[] = { 0.0f, 0.25f };
+    for (float hysteresis : hysteresisValues)
+    {
+      for (SceneObject& object : objects)
+        object.lod = 0;
+      uint32 warmup = 0;
+      DrawField(objects, lods.data(), (uint32)lods.size(), camera, localRadius, projectionScale, options.thresholdPixels, hysteresis, warmup, nullptr);
+
+      switchCount = 0;
+      for (uint32 frame = 0; frame < 120; ++frame)
+      {
+        const Vec3 moved(camera.x + ((frame & 1) ? 0.5f : -0.5f), camera.y, camera.z);
+        DrawField(objects, lods.data(), (uint32)lods.size(), moved, localRadius, projectionScale, options.thresholdPixels, hysteresis, switchCount, nullptr);
+      }
+      printf("  hysteresis %.2f: %u level switches in 120 frames of a 1 m camera shake\n", hysteresis, switchCount);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--triangles n] [--objects n] [--threshold pixels] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Two triangles per grid quad
+  const uint32 segments = (uint32)sqrtf(options.triangleCount * 0.5f);
+  BenchmarkMesh torus;
+  BuildTorus(segments, torus);
+  BenchmarkSimplification(torus);
+
+  BenchmarkMesh heightField;
+  BuildHeightField(segments, heightField);
+  BenchmarkSimplification(heightField);
+
+  BenchmarkScene(options);
+
+  return EXIT_SUCCESS;
+}
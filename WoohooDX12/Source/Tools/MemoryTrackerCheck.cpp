@@ -0,0 +1,183 @@
+// Runs frames shaped like the ones of WohCore against the steady state allocation assert, see Core/Memory/MemoryTracker.h
+// It builds with the tracker and without asserts, so the allocating frames are counted instead of stopping the check.
+//
+// Usage:
+//   MemoryTrackerCheck [--warmup <frames>]
+// The frames grow their draw lists in the frame arena during the warm-up, the steady frames after it must not allocate from the heap.
+// A frame that does must be reported, and the tags must account the allocations to their scopes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "Memory/FrameArena.h"
+#include "Memory/MemoryTracker.h"
+#include "ToolSupport.h"
+
+#ifndef WOH_MEMORY_TRACKING
+#error MemoryTrackerCheck needs WOH_MEMORY_TRACKING
+#endif
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    uint32 warmupFrames = 8;
+  };
+
+  struct DrawItem
+  {
+    uint32 mesh;
+    uint32 material;
+    float depth;
+  };
+
+  // Kept out of the function, the compiler may remove an allocation freed where it is made
+  std::unique_ptr<DrawItem> g_escapedItem;
+
+  // Draw list of the frame in the frame arena, bigger every warm-up frame until the arena page covers the peak
+  void RenderFrame(uint32 drawCount)
+  {
+    WOH_MEMORY_BEGIN_FRAME();
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Render);
+      std::vector<DrawItem, FrameAllocator<DrawItem>> drawList;
+      for (uint32 draw = 0; draw < drawCount; ++draw)
+        drawList.push_back({ draw % 50, draw % 7, (float)draw });
+    }
+    FrameArena::ResetThreadArenas();
+    WOH_MEMORY_END_FRAME();
+  }
+
+  bool CheckWarmup(uint32 warmupFrames)
+  {
+    const uint64 violations = MemoryTracker::GetSteadyStateViolationCount();
+    WOH_MEMORY_STEADY_STATE_AFTER(warmupFrames);
+
+    // Past the first arena page from the first frame, the last warm-up frame is the biggest one
+    for (uint32 frame = 0; frame < warmupFrames; ++frame)
+      RenderFrame(20000 + frame * 5000);
+
+    if (MemoryTracker::GetSteadyStateViolationCount() != violations)
+    {
+      printf("FAILED: warm-up frames were checked\n");
+      return false;
+    }
+
+    for (uint32 frame = 0; frame < 100; ++frame)
+      RenderFrame(20000 + (frame % warmupFrames) * 5000);
+
+    if (MemoryTracker::GetSteadyStateViolationCount() != violations)
+    {
+      printf("FAILED: %llu steady state frames allocated from the heap\n",
+        (unsigned long long)(MemoryTracker::GetSteadyStateViolationCount() - violations));
+      return false;
+    }
+
+    printf("%u warm-up frames, 100 steady state frames without heap allocation\n", warmupFrames);
+    return true;
+  }
+
+  bool CheckAllocatingFrame()
+  {
+    const uint64 violations = MemoryTracker::GetSteadyStateViolationCount();
+
+    WOH_MEMORY_BEGIN_FRAME();
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Scene);
+      g_escapedItem = std::make_unique<DrawItem>();
+    }
+    WOH_MEMORY_END_FRAME();
+    g_escapedItem.reset();
+
+    if (MemoryTracker::GetSteadyStateViolationCount() != violations + 1)
+    {
+      printf("FAILED: a steady state frame allocated from the heap without being reported\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  // The tracker is global, this one runs first so its frames are not checked
+  bool CheckTags()
+  {
+    const MemoryTagStats sceneBefore = MemoryTracker::GetStats(MemoryTag::Scene);
+    const MemoryTagStats uiBefore = MemoryTracker::GetStats(MemoryTag::UI);
+
+    std::vector<uint8>* kept = nullptr;
+    WOH_MEMORY_BEGIN_FRAME();
+    {
+      WOH_MEMORY_SCOPE(MemoryTag::Scene);
+      kept = new std::vector<uint8>(1000);
+      {
+        WOH_MEMORY_SCOPE(MemoryTag::UI);
+        std::vector<uint8> transient(300);
+      }
+    }
+    WOH_MEMORY_END_FRAME();
+
+    const MemoryTagStats scene = MemoryTracker::GetStats(MemoryTag::Scene);
+    const MemoryTagStats ui = MemoryTracker::GetStats(MemoryTag::UI);
+    bool passed = true;
+    if (scene.totalAllocations - sceneBefore.totalAllocations != 2 || scene.currentBytes - sceneBefore.currentBytes != sizeof(*kept) + 1000)
+    {
+      printf("FAILED: the scene scope accounts %llu allocations and %llu bytes\n",
+        (unsigned long long)(scene.totalAllocations - sceneBefore.totalAllocations), (unsigned long long)(scene.currentBytes - sceneBefore.currentBytes));
+      passed = false;
+    }
+
+    if (ui.totalAllocations - uiBefore.totalAllocations != 1 || ui.currentBytes != uiBefore.currentBytes || ui.frameBytes != 300)
+    {
+      printf("FAILED: the nested scope is not accounted to its own tag\n");
+      passed = false;
+    }
+
+    if (MemoryTracker::GetFrameAllocationCount() != 3)
+    {
+      printf("FAILED: %llu frame allocations instead of 3\n", (unsigned long long)MemoryTracker::GetFrameAllocationCount());
+      passed = false;
+    }
+
+    delete kept;
+    if (MemoryTracker::GetStats(MemoryTag::Scene).currentBytes != sceneBefore.currentBytes)
+    {
+      printf("FAILED: the free is not accounted to the tag of the allocation\n");
+      passed = false;
+    }
+
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--warmup", options.warmupFrames);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.warmupFrames > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--warmup frames]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  bool passed = CheckTags();
+  passed = CheckWarmup(options.warmupFrames) && passed;
+  passed = CheckAllocatingFrame() && passed;
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,527 @@
+// Vertex cache, overdraw and vertex fetch optimization over a corpus of meshes, see Core/Graphics/Geometry/MeshOptimizer.h
+//
+// Usage:
+//   MeshOptimizerBenchmark [--triangles <count>] [--seed <value>] [<file.obj> ...]
+// The corpus is generated: a torus and a cluster of overlapping spheres with their triangles and vertices shuffled, as
+// meshes arrive from tools that do not care, a height field in row order, a subdivided icosahedron in subdivision order and
+// a simplified level of detail of the torus. Wavefront OBJ files given on the command line are added, only their positions and
+// faces are read. Every mesh goes through the three passes like a mesh at import, the triangles are checked to be the same,
+// and ACMR and ATVR for a 16 entry FIFO cache, the overdraw of a software rasterizer from 14 directions and the vertex fetch
+// overfetch of 24 byte vertices are reported before and after.
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/MeshOptimizer.h"
+#include "Graphics/Geometry/MeshSimplifier.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  constexpr uint32 VertexSize = 24; // Position and colour of the application's vertices
+  constexpr uint32 OverdrawResolution = 256;
+
+  struct BenchmarkOptions
+  {
+    uint32 triangleCount = 500000;
+    uint32 seed = 1;
+    std::vector<std::string> files;
+  };
+
+  struct BenchmarkMesh
+  {
+    std::string name;
+    std::vector<float> positions; // Three floats per vertex
+    std::vector<uint32> indices;
+
+    inline uint32 GetVertexCount() const { return (uint32)positions.size() / 3; }
+  };
+
+  struct MeshMetrics
+  {
+    VertexCacheStats cache;
+    VertexFetchStats fetch;
+    float overdraw = 0.0f;
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--triangles", options.triangleCount);
+    commandLine.Add("--seed", options.seed);
+    commandLine.AddPositional(options.files);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.triangleCount >= 1000;
+  }
+
+  // Grid of segments x segments quads, wrapped on both axes for the torus
+  void BuildGridIndices(uint32 segments, bool wrap, std::vector<uint32>& indices)
+  {
+    const uint32 columns = wrap ? segments : segments + 1;
+    indices.clear();
+    indices.reserve((size_t)segments * segments * 6);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const uint32 x1 = wrap ? (x + 1) % segments : x + 1;
+        const uint32 y1 = wrap ? (y + 1) % segments : y + 1;
+        const uint32 v00 = y * columns + x;
+        const uint32 v10 = y * columns + x1;
+        const uint32 v01 = y1 * columns + x;
+        const uint32 v11 = y1 * columns + x1;
+        indices.insert(indices.end(), { v00, v01, v10, v10, v01, v11 });
+      }
+    }
+  }
+
+  void BuildTorus(uint32 segments, BenchmarkMesh& mesh)
+  {
+    mesh.name = "torus";
+    mesh.positions.resize((size_t)segments * segments * 3);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float minor = 0.3f + 0.03f * sinf(u * 7.0f) * sinf(v * 5.0f);
+
+        float* position = &mesh.positions[((size_t)y * segments + x) * 3];
+        position[0] = (1.0f + minor * cosf(v)) * cosf(u);
+        position[1] = minor * sinf(v);
+        position[2] = (1.0f + minor * cosf(v)) * sinf(u);
+      }
+    }
+    BuildGridIndices(segments, true, mesh.indices);
+  }
+
+  void BuildHeightField(uint32 segments, BenchmarkMesh& mesh)
+  {
+    mesh.name = "height field";
+    const uint32 columns = segments + 1;
+    mesh.positions.resize((size_t)columns * columns * 3);
+    for (uint32 y = 0; y < columns; ++y)
+    {
+      for (uint32 x = 0; x < columns; ++x)
+      {
+        const float u = (float)x / segments;
+        const float v = (float)y / segments;
+
+        float* position = &mesh.positions[((size_t)y * columns + x) * 3];
+        position[0] = u * 2.0f - 1.0f;
+        position[1] = 0.1f * sinf(u * 9.0f) * cosf(v * 7.0f) + 0.02f * sinf(u * 41.0f + v * 37.0f);
+        position[2] = v * 2.0f - 1.0f;
+      }
+    }
+    BuildGridIndices(segments, false, mesh.indices);
+  }
+
+  // Every subdivision splits the triangles in four in place, midpoints are shared through an edge map
+  void BuildIcosphere(uint32 triangleCount, BenchmarkMesh& mesh)
+  {
+    mesh.name = "icosphere";
+    const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+    mesh.positions = { -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, 0, 0, -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, t, 0, -1, t, 0, 1, -t, 0, -1, -t, 0, 1 };
+    mesh.indices = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+      3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+
+    while (mesh.indices.size() / 3 * 4 <= triangleCount)
+    {
+      std::vector<uint64> edgeKeys;
+      std::vector<uint32> edgeVertices;
+      std::vector<uint32> subdivided;
+      subdivided.reserve(mesh.indices.size() * 4);
+
+      auto midpoint = [&](uint32 a, uint32 b)
+      {
+        const uint64 key = ((uint64)std::min(a, b) << 32) | std::max(a, b);
+        const auto it = std::lower_bound(edgeKeys.begin(), edgeKeys.end(), key);
+        return edgeVertices[it - edgeKeys.begin()];
+      };
+
+      // Midpoints first, sorted by edge so they can be found again
+      std::vector<std::pair<uint64, uint32>> edges;
+      for (size_t i = 0; i < mesh.indices.size(); ++i)
+      {
+        const uint32 a = mesh.indices[i];
+        const uint32 b = mesh.indices[i % 3 == 2 ? i - 2 : i + 1];
+        edges.push_back({ ((uint64)std::min(a, b) << 32) | std::max(a, b), 0 });
+      }
+      std::sort(edges.begin(), edges.end());
+      edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+      for (const auto& edge : edges)
+      {
+        const uint32 a = (uint32)(edge.first >> 32);
+        const uint32 b = (uint32)edge.first;
+        edgeKeys.push_back(edge.first);
+        edgeVertices.push_back(mesh.GetVertexCount());
+        for (uint32 axis = 0; axis < 3; ++axis)
+          mesh.positions.push_back((mesh.positions[a * 3 + axis] + mesh.positions[b * 3 + axis]) * 0.5f);
+      }
+
+      for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      {
+        const uint32 a = mesh.indices[i];
+        const uint32 b = mesh.indices[i + 1];
+        const uint32 c = mesh.indices[i + 2];
+        const uint32 ab = midpoint(a, b);
+        const uint32 bc = midpoint(b, c);
+        const uint32 ca = midpoint(c, a);
+        subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+      }
+      mesh.indices.swap(subdivided);
+    }
+
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+    {
+      float* position = &mesh.positions[vertex * 3];
+      const float length = sqrtf(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+      position[0] /= length;
+      position[1] /= length;
+      position[2] /= length;
+    }
+  }
+
+  // Overlapping spheres of several layers of depth
+  void BuildSphereCluster(uint32 triangleCount, uint32 seed, BenchmarkMesh& mesh)
+  {
+    constexpr uint32 SphereCount = 24;
+    BenchmarkMesh sphere;
+    BuildIcosphere(triangleCount / SphereCount, sphere);
+
+    mesh.name = "sphere cluster";
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> radius(0.3f, 0.7f);
+    for (uint32 s = 0; s < SphereCount; ++s)
+    {
+      const uint32 base = mesh.GetVertexCount();
+      const float center[3] = { offset(random), offset(random), offset(random) };
+      const float r = radius(random);
+      for (uint32 vertex = 0; vertex < sphere.GetVertexCount(); ++vertex)
+        for (uint32 axis = 0; axis < 3; ++axis)
+          mesh.positions.push_back(center[axis] + sphere.positions[vertex * 3 + axis] * r);
+      for (uint32 index : sphere.indices)
+        mesh.indices.push_back(base + index);
+    }
+  }
+
+  // Triangles and vertices in random order, the winding is kept
+  void Shuffle(BenchmarkMesh& mesh, uint32 seed)
+  {
+    std::mt19937 random(seed);
+    const uint32 triangleCount = (uint32)mesh.indices.size() / 3;
+    std::vector<uint32> order(triangleCount);
+    for (uint32 i = 0; i < triangleCount; ++i)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::vector<uint32> vertexOrder(mesh.GetVertexCount());
+    for (uint32 i = 0; i < mesh.GetVertexCount(); ++i)
+      vertexOrder[i] = i;
+    std::shuffle(vertexOrder.begin(), vertexOrder.end(), random);
+
+    std::vector<uint32> indices(mesh.indices.size());
+    for (uint32 i = 0; i < triangleCount; ++i)
+      for (uint32 corner = 0; corner < 3; ++corner)
+        indices[i * 3 + corner] = vertexOrder[mesh.indices[order[i] * 3 + corner]];
+
+    std::vector<float> positions(mesh.positions.size());
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+      memcpy(&positions[vertexOrder[vertex] * 3], &mesh.positions[vertex * 3], 3 * sizeof(float));
+
+    mesh.indices.swap(indices);
+    mesh.positions.swap(positions);
+  }
+
+  bool LoadObj(const std::string& path, BenchmarkMesh& mesh)
+  {
+    std::ifstream file(path);
+    if (!file)
+      return false;
+
+    mesh.name = path;
+    std::string line;
+    std::vector<uint32> face;
+    while (std::getline(file, line))
+    {
+      std::istringstream stream(line);
+      std::string type;
+      stream >> type;
+      if (type == "v")
+      {
+        float position[3] = {};
+        stream >> position[0] >> position[1] >> position[2];
+        mesh.positions.insert(mesh.positions.end(), position, position + 3);
+      }
+      else if (type == "f")
+      {
+        // v, v/vt, v//vn or v/vt/vn, negative indices count from the end, polygons are fanned
+        face.clear();
+        std::string corner;
+        while (stream >> corner)
+        {
+          const int32 index = atoi(corner.c_str());
+          face.push_back(index < 0 ? (uint32)((int32)mesh.GetVertexCount() + index) : (uint32)(index - 1));
+        }
+        for (size_t i = 2; i < face.size(); ++i)
+          mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+      }
+    }
+
+    for (uint32 index : mesh.indices)
+    {
+      if (index >= mesh.GetVertexCount())
+        return false;
+    }
+    return !mesh.indices.empty();
+  }
+
+  // Depth tested pixel writes over covered pixels, back faces culled, orthographic views from the faces and corners of a cube
+  float MeasureOverdraw(const BenchmarkMesh& mesh)
+  {
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+    {
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        minimum[axis] = std::min(minimum[axis], mesh.positions[vertex * 3 + axis]);
+        maximum[axis] = std::max(maximum[axis], mesh.positions[vertex * 3 + axis]);
+      }
+    }
+    const Vec center = DirectX::XMVectorSet((minimum[0] + maximum[0]) * 0.5f, (minimum[1] + maximum[1]) * 0.5f, (minimum[2] + maximum[2]) * 0.5f, 1.0f);
+    const float extent = sqrtf((maximum[0] - minimum[0]) * (maximum[0] - minimum[0]) + (maximum[1] - minimum[1]) * (maximum[1] - minimum[1]) +
+      (maximum[2] - minimum[2]) * (maximum[2] - minimum[2])) * 0.5f;
+
+    std::vector<float> depth(OverdrawResolution * OverdrawResolution);
+    std::vector<float> screen(mesh.positions.size());
+    uint64 writes = 0;
+    uint64 covered = 0;
+    for (uint32 view = 0; view < 14; ++view)
+    {
+      // Faces then corners of a cube
+      float direction[3];
+      if (view < 6)
+      {
+        direction[0] = view / 2 == 0 ? 1.0f : 0.0f;
+        direction[1] = view / 2 == 1 ? 1.0f : 0.0f;
+        direction[2] = view / 2 == 2 ? 1.0f : 0.0f;
+        if (view & 1)
+          direction[view / 2] = -1.0f;
+      }
+      else
+      {
+        direction[0] = (view & 1) ? 1.0f : -1.0f;
+        direction[1] = (view & 2) ? 1.0f : -1.0f;
+        direction[2] = (view & 4) ? 1.0f : -1.0f;
+      }
+
+      const Vec forward = DirectX::XMVector3Normalize(DirectX::XMVectorSet(direction[0], direction[1], direction[2], 0.0f));
+      const Vec up = fabsf(DirectX::XMVectorGetY(forward)) > 0.9f ? DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+      const Mat viewMatrix = DirectX::XMMatrixLookToLH(DirectX::XMVectorSubtract(center, DirectX::XMVectorScale(forward, extent * 2.0f)), forward, up);
+
+      // Pixels and depth, x to the right and y down
+      const float scale = OverdrawResolution * 0.5f / extent;
+      for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+      {
+        Vec3 position;
+        DirectX::XMStoreFloat3(&position, DirectX::XMVector3Transform(DirectX::XMVectorSet(mesh.positions[vertex * 3], mesh.positions[vertex * 3 + 1],
+          mesh.positions[vertex * 3 + 2], 1.0f), viewMatrix));
+        screen[vertex * 3 + 0] = position.x * scale + OverdrawResolution * 0.5f;
+        screen[vertex * 3 + 1] = OverdrawResolution * 0.5f - position.y * scale;
+        screen[vertex * 3 + 2] = position.z;
+      }
+
+      std::fill(depth.begin(), depth.end(), FLT_MAX);
+      for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      {
+        const float* a = &screen[mesh.indices[i] * 3];
+        const float* b = &screen[mesh.indices[i + 1] * 3];
+        const float* c = &screen[mesh.indices[i + 2] * 3];
+
+        // Clockwise on the screen is front facing, with y down it is a positive area
+        const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+        if (area <= 0.0f)
+          continue;
+
+        const int32 minX = std::max(0, (int32)floorf(std::min({ a[0], b[0], c[0] })));
+        const int32 maxX = std::min((int32)OverdrawResolution - 1, (int32)ceilf(std::max({ a[0], b[0], c[0] })));
+        const int32 minY = std::max(0, (int32)floorf(std::min({ a[1], b[1], c[1] })));
+        const int32 maxY = std::min((int32)OverdrawResolution - 1, (int32)ceilf(std::max({ a[1], b[1], c[1] })));
+        for (int32 y = minY; y <= maxY; ++y)
+        {
+          for (int32 x = minX; x <= maxX; ++x)
+          {
+            const float px = x + 0.5f;
+            const float py = y + 0.5f;
+            const float w0 = (c[0] - b[0]) * (py - b[1]) - (c[1] - b[1]) * (px - b[0]);
+            const float w1 = (a[0] - c[0]) * (py - c[1]) - (a[1] - c[1]) * (px - c[0]);
+            const float w2 = (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+              continue;
+
+            const float z = (w0 * a[2] + w1 * b[2] + w2 * c[2]) / area;
+            float& stored = depth[y * OverdrawResolution + x];
+            if (z < stored)
+            {
+              stored = z;
+              ++writes;
+            }
+          }
+        }
+      }
+
+      for (float value : depth)
+        covered += value < FLT_MAX ? 1 : 0;
+    }
+
+    return covered > 0 ? (float)((double)writes / (double)covered) : 0.0f;
+  }
+
+  MeshMetrics Measure(const BenchmarkMesh& mesh)
+  {
+    MeshMetrics metrics;
+    metrics.cache = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), (uint32)mesh.indices.size(), mesh.GetVertexCount());
+    metrics.fetch = MeshOptimizer::AnalyzeVertexFetch(mesh.indices.data(), (uint32)mesh.indices.size(), mesh.GetVertexCount(), VertexSize);
+    metrics.overdraw = MeasureOverdraw(mesh);
+    return metrics;
+  }
+
+  // Rotated so the smallest position comes first, compared by position so the vertex order does not matter
+  std::vector<std::array<float, 9>> GetTriangles(const BenchmarkMesh& mesh)
+  {
+    std::vector<std::array<float, 9>> triangles(mesh.indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+      std::array<float, 9> corners;
+      for (uint32 corner = 0; corner < 3; ++corner)
+        memcpy(&corners[corner * 3], &mesh.positions[mesh.indices[t * 3 + corner] * 3], 3 * sizeof(float));
+
+      std::array<float, 9>& triangle = triangles[t];
+      triangle = corners;
+      for (uint32 rotation = 1; rotation < 3; ++rotation)
+      {
+        std::array<float, 9> rotated;
+        for (uint32 corner = 0; corner < 3; ++corner)
+          memcpy(&rotated[corner * 3], &corners[((corner + rotation) % 3) * 3], 3 * sizeof(float));
+        triangle = std::min(triangle, rotated);
+      }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+  }
+
+  bool Optimize(BenchmarkMesh& mesh, MeshOptimizer& optimizer)
+  {
+    const MeshMetrics before = Measure(mesh);
+    const std::vector<std::array<float, 9>> triangles = GetTriangles(mesh);
+    const uint32 indexCount = (uint32)mesh.indices.size();
+    const uint32 vertexCount = mesh.GetVertexCount();
+
+    auto start = ToolClock::now();
+    optimizer.OptimizeVertexCache(mesh.indices.data(), indexCount, vertexCount);
+    const double cacheSeconds = GetSeconds(start);
+    const MeshMetrics afterCache = Measure(mesh);
+
+    start = ToolClock::now();
+    optimizer.OptimizeOverdraw(mesh.indices.data(), indexCount, mesh.positions.data(), 3 * sizeof(float), vertexCount);
+    const double overdrawSeconds = GetSeconds(start);
+
+    start = ToolClock::now();
+    std::vector<uint32> remap;
+    const uint32 usedCount = optimizer.OptimizeVertexFetch(mesh.indices.data(), indexCount, vertexCount, remap);
+    std::vector<float> positions((size_t)usedCount * 3);
+    MeshOptimizer::RemapVertices(positions.data(), mesh.positions.data(), vertexCount, 3 * sizeof(float), remap.data());
+    mesh.positions.swap(positions);
+    const double fetchSeconds = GetSeconds(start);
+    const MeshMetrics after = Measure(mesh);
+
+    printf("%s: %u triangles, %u vertices\n", mesh.name.c_str(), indexCount / 3, vertexCount);
+    printf("  %-16s ACMR %.3f  ATVR %.3f  overdraw %.3f  overfetch %.2f\n", "input", before.cache.acmr, before.cache.atvr, before.overdraw, before.fetch.overfetch);
+    printf("  %-16s ACMR %.3f  ATVR %.3f  overdraw %.3f  overfetch %.2f  %7.1f ms\n", "vertex cache", afterCache.cache.acmr, afterCache.cache.atvr,
+      afterCache.overdraw, afterCache.fetch.overfetch, cacheSeconds * 1000.0);
+    printf("  %-16s ACMR %.3f  ATVR %.3f  overdraw %.3f  overfetch %.2f  %7.1f ms + %.1f ms\n", "overdraw, fetch", after.cache.acmr, after.cache.atvr,
+      after.overdraw, after.fetch.overfetch, overdrawSeconds * 1000.0, fetchSeconds * 1000.0);
+
+    if (GetTriangles(mesh) != triangles)
+    {
+      printf("  the optimized triangles are not the input triangles\n");
+      return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--triangles n] [--seed n] [file.obj ...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchmarkMesh> corpus(5);
+  const uint32 segments = (uint32)sqrtf(options.triangleCount * 0.5f);
+  BuildTorus(segments, corpus[0]);
+  Shuffle(corpus[0], options.seed);
+  corpus[0].name = "torus, shuffled";
+
+  BuildSphereCluster(options.triangleCount, options.seed, corpus[1]);
+  Shuffle(corpus[1], options.seed);
+  corpus[1].name = "sphere cluster, shuffled";
+
+  BuildHeightField(segments, corpus[2]);
+  corpus[2].name = "height field, rows";
+  BuildIcosphere(options.triangleCount, corpus[3]);
+  corpus[3].name = "icosphere, subdivision order";
+
+  // The collapses leave the triangles of a level of detail in the order of the input with holes
+  BenchmarkMesh torus;
+  BuildTorus(segments, torus);
+  SimplifyInput input;
+  input.positions = torus.positions.data();
+  input.positionStride = 3 * sizeof(float);
+  input.vertexCount = torus.GetVertexCount();
+  input.indices = torus.indices.data();
+  input.indexCount = (uint32)torus.indices.size();
+  MeshSimplifier simplifier;
+  corpus[4].name = "torus, simplified to 25%";
+  corpus[4].positions = torus.positions;
+  corpus[4].indices.resize(torus.indices.size());
+  corpus[4].indices.resize(simplifier.Simplify(input, input.indexCount / 12 * 3, SimplifyOptions(), corpus[4].indices.data()));
+
+  for (const std::string& file : options.files)
+  {
+    BenchmarkMesh mesh;
+    if (!LoadObj(file, mesh))
+    {
+      printf("Can not load %s\n", file.c_str());
+      return EXIT_FAILURE;
+    }
+    corpus.push_back(std::move(mesh));
+  }
+
+  MeshOptimizer optimizer;
+  bool passed = true;
+  for (BenchmarkMesh& mesh : corpus)
+    passed = Optimize(mesh, optimizer) && passed;
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
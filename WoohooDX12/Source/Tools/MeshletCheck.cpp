@@ -0,0 +1,434 @@
+// Checks the meshlet builder and the CPU cluster culling reference, see Core/Graphics/Geometry/Meshlet.h and
+// Core/Scene/Culling/ClusterCulling.h
+//
+// Usage:
+//   MeshletCheck [--triangles <count>] [--views <count>] [--seed <value>]
+// Builds 64 vertex / 124 triangle meshlets for a closed mesh (a bumpy torus), an open one (a height field) and a soup of
+// disconnected triangles. Every input triangle has to be in exactly one meshlet with its winding, the local indices and the
+// limits have to hold, the spheres have to contain their vertices and the cones their normals. Fill rates are reported.
+// Then the meshlets are culled from random views: every triangle of a cluster culled by the frustum or the cone has to be
+// outside the frustum or back-facing, and the culled triangles are compared with a per triangle test. A wall in front of the
+// camera adds occlusion culling to the last pass.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/Meshlet.h"
+#include "Scene/Culling/ClusterCulling.h"
+#include "Scene/Culling/OcclusionCulling.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    uint32 triangleCount = 1000000;
+    uint32 viewCount = 50;
+    uint32 seed = 1;
+  };
+
+  struct CheckMesh
+  {
+    const char* name = "";
+    std::vector<float> positions; // Three floats per vertex
+    std::vector<uint32> indices;
+
+    inline uint32 GetVertexCount() const { return (uint32)positions.size() / 3; }
+    inline const float* GetPosition(uint32 vertex) const { return &positions[vertex * 3]; }
+  };
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--triangles", options.triangleCount);
+    commandLine.Add("--views", options.viewCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.triangleCount >= 8 && options.viewCount > 0;
+  }
+
+  // Grid of segments x segments quads, wrapped on both axes for the torus
+  void BuildGridIndices(uint32 segments, bool wrap, std::vector<uint32>& indices)
+  {
+    const uint32 columns = wrap ? segments : segments + 1;
+    indices.clear();
+    indices.reserve((size_t)segments * segments * 6);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const uint32 x1 = wrap ? (x + 1) % segments : x + 1;
+        const uint32 y1 = wrap ? (y + 1) % segments : y + 1;
+        const uint32 v00 = y * columns + x;
+        const uint32 v10 = y * columns + x1;
+        const uint32 v01 = y1 * columns + x;
+        const uint32 v11 = y1 * columns + x1;
+        indices.insert(indices.end(), { v00, v01, v10, v10, v01, v11 });
+      }
+    }
+  }
+
+  void BuildTorus(uint32 segments, CheckMesh& mesh)
+  {
+    mesh.name = "torus";
+    mesh.positions.resize((size_t)segments * segments * 3);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float minor = 0.3f + 0.03f * sinf(u * 7.0f) * sinf(v * 5.0f);
+
+        float* position = &mesh.positions[((size_t)y * segments + x) * 3];
+        position[0] = (1.0f + minor * cosf(v)) * cosf(u);
+        position[1] = minor * sinf(v);
+        position[2] = (1.0f + minor * cosf(v)) * sinf(u);
+      }
+    }
+    BuildGridIndices(segments, true, mesh.indices);
+  }
+
+  void BuildHeightField(uint32 segments, CheckMesh& mesh)
+  {
+    mesh.name = "height field";
+    const uint32 columns = segments + 1;
+    mesh.positions.resize((size_t)columns * columns * 3);
+    for (uint32 y = 0; y < columns; ++y)
+    {
+      for (uint32 x = 0; x < columns; ++x)
+      {
+        const float u = (float)x / segments;
+        const float v = (float)y / segments;
+
+        float* position = &mesh.positions[((size_t)y * columns + x) * 3];
+        position[0] = u * 2.0f - 1.0f;
+        position[1] = 0.1f * sinf(u * 9.0f) * cosf(v * 7.0f) + 0.02f * sinf(u * 41.0f + v * 37.0f);
+        position[2] = v * 2.0f - 1.0f;
+      }
+    }
+    BuildGridIndices(segments, false, mesh.indices);
+  }
+
+  // Small triangles scattered in a box, no vertex is shared
+  void BuildSoup(uint32 triangleCount, uint32 seed, CheckMesh& mesh)
+  {
+    mesh.name = "triangle soup";
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.01f, 0.01f);
+
+    mesh.positions.resize((size_t)triangleCount * 9);
+    mesh.indices.resize((size_t)triangleCount * 3);
+    for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+    {
+      const float center[3] = { position(random), position(random), position(random) };
+      for (uint32 corner = 0; corner < 3; ++corner)
+      {
+        float* vertex = &mesh.positions[((size_t)triangle * 3 + corner) * 3];
+        vertex[0] = center[0] + offset(random);
+        vertex[1] = center[1] + offset(random);
+        vertex[2] = center[2] + offset(random);
+        mesh.indices[triangle * 3 + corner] = triangle * 3 + corner;
+      }
+    }
+  }
+
+  void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal)
+  {
+    const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+  }
+
+  // Rotated so the smallest index comes first, the winding is kept
+  std::array<uint32, 3> MakeTriangleKey(uint32 a, uint32 b, uint32 c)
+  {
+    if (b < a && b < c)
+      return { b, c, a };
+    if (c < a && c < b)
+      return { c, a, b };
+    return { a, b, c };
+  }
+
+  bool CheckMeshlets(const CheckMesh& mesh, const MeshletData& data, const MeshletOptions& options)
+  {
+    std::vector<std::array<uint32, 3>> input;
+    std::vector<std::array<uint32, 3>> output;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      input.push_back(MakeTriangleKey(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]));
+
+    for (uint32 m = 0; m < data.GetMeshletCount(); ++m)
+    {
+      const Meshlet& meshlet = data.meshlets[m];
+      const MeshletBounds& bounds = data.bounds[m];
+      if (meshlet.vertexCount > options.maxVertices || meshlet.triangleCount > options.maxTriangles || meshlet.triangleCount == 0)
+      {
+        printf("  meshlet %u is over the limits: %u vertices, %u triangles\n", m, meshlet.vertexCount, meshlet.triangleCount);
+        return false;
+      }
+
+      const uint32* vertices = data.vertices.data() + meshlet.vertexOffset;
+      for (uint32 i = 0; i < meshlet.vertexCount; ++i)
+      {
+        const float* position = mesh.GetPosition(vertices[i]);
+        const float dx = position[0] - bounds.center[0];
+        const float dy = position[1] - bounds.center[1];
+        const float dz = position[2] - bounds.center[2];
+        if (sqrtf(dx * dx + dy * dy + dz * dz) > bounds.radius * 1.0001f + 1e-6f)
+        {
+          printf("  meshlet %u: vertex %u is outside of the sphere\n", m, vertices[i]);
+          return false;
+        }
+      }
+
+      const float coneCosine = sqrtf(std::max(0.0f, 1.0f - bounds.coneCutoff * bounds.coneCutoff));
+      for (uint32 t = 0; t < meshlet.triangleCount; ++t)
+      {
+        const uint8* local = data.triangles.data() + meshlet.triangleOffset + t * 3;
+        if (local[0] >= meshlet.vertexCount || local[1] >= meshlet.vertexCount || local[2] >= meshlet.vertexCount)
+        {
+          printf("  meshlet %u: local index out of range\n", m);
+          return false;
+        }
+        output.push_back(MakeTriangleKey(vertices[local[0]], vertices[local[1]], vertices[local[2]]));
+
+        float normal[3];
+        TriangleNormal(mesh.GetPosition(vertices[local[0]]), mesh.GetPosition(vertices[local[1]]), mesh.GetPosition(vertices[local[2]]), normal);
+        const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const float dot = normal[0] * bounds.coneAxis[0] + normal[1] * bounds.coneAxis[1] + normal[2] * bounds.coneAxis[2];
+        if (bounds.coneCutoff < 1.0f && length > 0.0f && dot < (coneCosine - 1e-4f) * length)
+        {
+          printf("  meshlet %u: normal of triangle %u is outside of the cone\n", m, t);
+          return false;
+        }
+      }
+    }
+
+    std::sort(input.begin(), input.end());
+    std::sort(output.begin(), output.end());
+    if (input != output)
+    {
+      printf("  the meshlet triangles are not the input triangles\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  Mat4x4 MakeViewProjection(const Vec3& eye, const Vec3& target)
+  {
+    const Mat view = DirectX::XMMatrixLookAtLH(DirectX::XMLoadFloat3(&eye), DirectX::XMLoadFloat3(&target), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const Mat projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 16.0f / 9.0f, 0.05f, 100.0f);
+    Mat4x4 viewProjection;
+    DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+    return viewProjection;
+  }
+
+  inline float PlaneDistance(const Vec4& plane, const float* position)
+  {
+    return plane.x * position[0] + plane.y * position[1] + plane.z * position[2] + plane.w;
+  }
+
+  bool IsTriangleOutside(const Frustum& frustum, const float* p0, const float* p1, const float* p2)
+  {
+    for (const Vec4& plane : frustum.planes)
+    {
+      if (PlaneDistance(plane, p0) < 0.0f && PlaneDistance(plane, p1) < 0.0f && PlaneDistance(plane, p2) < 0.0f)
+        return true;
+    }
+    return false;
+  }
+
+  bool IsSphereOutside(const Frustum& frustum, const MeshletBounds& bounds)
+  {
+    for (const Vec4& plane : frustum.planes)
+    {
+      if (PlaneDistance(plane, bounds.center) < -bounds.radius)
+        return true;
+    }
+    return false;
+  }
+
+  bool IsTriangleBackfacing(const Vec3& camera, const float* p0, const float* p1, const float* p2)
+  {
+    float normal[3];
+    TriangleNormal(p0, p1, p2, normal);
+    const float toCamera[3] = { camera.x - p0[0], camera.y - p0[1], camera.z - p0[2] };
+    return normal[0] * toCamera[0] + normal[1] * toCamera[1] + normal[2] * toCamera[2] <= 0.0f;
+  }
+
+  // Returns false when a culled cluster holds a triangle the per triangle test keeps
+  bool CheckCulling(const CheckMesh& mesh, const MeshletData& data, const CheckOptions& options)
+  {
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<float> angle(0.0f, DirectX::XM_2PI);
+    std::uniform_real_distribution<float> height(-1.0f, 1.5f);
+    std::uniform_real_distribution<float> distance(1.6f, 4.0f);
+    std::uniform_real_distribution<float> aim(-0.6f, 0.6f);
+
+    // The wall hides the left half of the screen of the occlusion views
+    MaskedOcclusionBuffer occlusion;
+    occlusion.Init(480, 270);
+
+    Mat4x4 identity;
+    MakeIdentity(identity);
+    ClusterCuller culler;
+    std::vector<uint8> visibleClusters(data.GetMeshletCount());
+
+    for (uint32 pass = 0; pass < 2; ++pass)
+    {
+      const bool withOcclusion = pass == 1;
+      uint64 triangleCount = 0;
+      uint64 clusterFrustum = 0;
+      uint64 clusterBackface = 0;
+      uint64 clusterOcclusion = 0;
+      uint64 triangleFrustum = 0;
+      uint64 triangleBackface = 0;
+      double cullSeconds = 0.0;
+
+      for (uint32 view = 0; view < options.viewCount; ++view)
+      {
+        const float a = angle(random);
+        const float d = distance(random);
+        const Vec3 eye(cosf(a) * d, height(random), sinf(a) * d);
+        const Vec3 target(aim(random), aim(random) * 0.3f, aim(random));
+        const Mat4x4 viewProjection = MakeViewProjection(eye, target);
+        const Frustum frustum = Frustum::FromViewProjection(viewProjection);
+
+        if (withOcclusion)
+        {
+          // Quad halfway to the target, covering the left of the view
+          const Mat invView = DirectX::XMMatrixInverse(nullptr, DirectX::XMMatrixLookAtLH(DirectX::XMLoadFloat3(&eye), DirectX::XMLoadFloat3(&target),
+            DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+          const float z = d * 0.4f;
+          float wall[4][3];
+          const float corners[4][2] = { { -10.0f, -10.0f }, { -10.0f, 10.0f }, { 0.0f, 10.0f }, { 0.0f, -10.0f } };
+          for (uint32 c = 0; c < 4; ++c)
+          {
+            Vec3 world;
+            DirectX::XMStoreFloat3(&world, DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(corners[c][0], corners[c][1], z, 1.0f), invView));
+            wall[c][0] = world.x;
+            wall[c][1] = world.y;
+            wall[c][2] = world.z;
+          }
+          const uint32 wallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+          occlusion.Clear();
+          occlusion.RenderTriangles(wall[0], sizeof(wall[0]), wallIndices, 2, viewProjection);
+          occlusion.Rasterize(nullptr);
+        }
+
+        const auto start = ToolClock::now();
+        culler.Cull(data, identity, frustum, eye, withOcclusion ? &occlusion : nullptr, viewProjection);
+        cullSeconds += GetSeconds(start);
+
+        const ClusterCullStats& stats = culler.GetStats();
+        std::fill(visibleClusters.begin(), visibleClusters.end(), 0);
+        for (uint32 i = 0; i < culler.GetVisibleCount(); ++i)
+          visibleClusters[culler.GetVisibleClusters()[i]] = 1;
+
+        // Every triangle of a frustum or cone culled cluster has to be culled by the per triangle tests
+        for (uint32 m = 0; m < data.GetMeshletCount(); ++m)
+        {
+          const Meshlet& meshlet = data.meshlets[m];
+          const uint32* vertices = data.vertices.data() + meshlet.vertexOffset;
+          const uint8* triangles = data.triangles.data() + meshlet.triangleOffset;
+          const bool frustumCulled = IsSphereOutside(frustum, data.bounds[m]);
+          const bool backfaceCulled = !frustumCulled && ClusterCuller::IsBackfacing(data.bounds[m], eye);
+          if (visibleClusters[m] == (frustumCulled || backfaceCulled) && (!withOcclusion || visibleClusters[m]))
+          {
+            printf("  view %u: meshlet %u does not have the visibility of the reference\n", view, m);
+            return false;
+          }
+
+          for (uint32 t = 0; t < meshlet.triangleCount; ++t)
+          {
+            const float* p0 = mesh.GetPosition(vertices[triangles[t * 3 + 0]]);
+            const float* p1 = mesh.GetPosition(vertices[triangles[t * 3 + 1]]);
+            const float* p2 = mesh.GetPosition(vertices[triangles[t * 3 + 2]]);
+            const bool outside = IsTriangleOutside(frustum, p0, p1, p2);
+            const bool backfacing = IsTriangleBackfacing(eye, p0, p1, p2);
+            triangleFrustum += outside ? 1 : 0;
+            triangleBackface += !outside && backfacing ? 1 : 0;
+
+            if ((frustumCulled && !outside) || (backfaceCulled && !backfacing))
+            {
+              printf("  view %u: meshlet %u is culled but its triangle %u is %s\n", view, m, t, frustumCulled ? "in the frustum" : "front-facing");
+              return false;
+            }
+          }
+        }
+
+        triangleCount += stats.triangleCount;
+        clusterFrustum += stats.frustumCulled;
+        clusterBackface += stats.backfaceCulled;
+        clusterOcclusion += stats.occlusionCulled;
+      }
+
+      const double clusterCount = (double)data.GetMeshletCount() * options.viewCount;
+      printf("  %s%u views: clusters culled by frustum %.1f%%, by cone %.1f%%, by occlusion %.1f%%, %.3f ms per view\n",
+        withOcclusion ? "with a wall, " : "", options.viewCount, clusterFrustum * 100.0 / clusterCount, clusterBackface * 100.0 / clusterCount,
+        clusterOcclusion * 100.0 / clusterCount, cullSeconds * 1000.0 / options.viewCount);
+      if (!withOcclusion)
+      {
+        const double meshletTriangles = (double)triangleCount;
+        printf("  per triangle: outside %.1f%%, back-facing %.1f%%, the cones find %.0f%% of the back faces\n", triangleFrustum * 100.0 / meshletTriangles,
+          triangleBackface * 100.0 / meshletTriangles, triangleBackface > 0 ? clusterBackface * 100.0 / (clusterCount * triangleBackface / meshletTriangles) : 0.0);
+      }
+    }
+
+    return true;
+  }
+
+  bool RunChecks(const CheckMesh& mesh, const CheckOptions& options)
+  {
+    printf("%s: %u triangles, %u vertices\n", mesh.name, (uint32)mesh.indices.size() / 3, mesh.GetVertexCount());
+
+    MeshletOptions meshletOptions;
+    MeshletBuilder builder;
+    MeshletData data;
+    const auto start = ToolClock::now();
+    builder.Build(mesh.positions.data(), 3 * sizeof(float), mesh.GetVertexCount(), mesh.indices.data(), (uint32)mesh.indices.size(), meshletOptions, data);
+    const double seconds = GetSeconds(start);
+
+    const MeshletStats stats = MeshletBuilder::GetStats(data, meshletOptions);
+    printf("  %u meshlets in %.1f ms, fill: vertices %.1f%%, triangles %.1f%%, vertex duplication %.2fx, cones that cull %.1f%%\n",
+      stats.meshletCount, seconds * 1000.0, stats.vertexFill * 100.0f, stats.triangleFill * 100.0f, stats.vertexDuplication, stats.cullableFraction * 100.0f);
+
+    return CheckMeshlets(mesh, data, meshletOptions) && CheckCulling(mesh, data, options);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--triangles n] [--views n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Two triangles per grid quad
+  const uint32 segments = (uint32)sqrtf(options.triangleCount * 0.5f);
+  CheckMesh torus;
+  BuildTorus(segments, torus);
+  CheckMesh heightField;
+  BuildHeightField(segments, heightField);
+  CheckMesh soup;
+  BuildSoup(options.triangleCount / 10, options.seed, soup);
+
+  const bool passed = RunChecks(torus, options) && RunChecks(heightField, options) && RunChecks(soup, options);
+  printf(passed ? "All checks passed\n" : "Check failed\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
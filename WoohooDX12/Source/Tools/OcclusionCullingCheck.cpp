@@ -0,0 +1,395 @@
+// Checks the masked occlusion buffer against a full resolution depth buffer on reference scenes, see Core/Scene/Culling/OcclusionCulling.h
+//
+// Usage:
+//   OcclusionCullingCheck [--width <pixels>] [--height <pixels>] [--occludees <count>] [--workers <count>] [--seed <value>]
+// Three scenes: a city of blocks seen from the street, random walls in front of the camera, and a wall running past the camera
+// through the near plane. The occluders are rasterized into the masked buffer and into a per pixel depth buffer of the same
+// size, then random boxes are tested against both with the screen rectangle of their corners. A box the buffer hides must also
+// be hidden in the reference, and the share of the reference culling the buffer reaches is reported with the timings.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Jobs/JobSystem.h"
+#include "Scene/Camera.h"
+#include "Scene/Culling/OcclusionCulling.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct CheckOptions
+  {
+    uint32 width = 320;
+    uint32 height = 192;
+    uint32 occludeeCount = 20000;
+    uint32 workerCount = 0; // 0 is one per hardware thread except the calling one
+    uint32 seed = 1;
+  };
+
+  // Below this share of the reference culling the buffer is not worth its cost
+  static constexpr float MinCullingRatio = 0.5f;
+
+  struct Scene
+  {
+    const char* name = "";
+    Camera camera;
+    std::vector<float> positions;
+    std::vector<uint32> indices;
+    std::vector<AABB> occludees;
+  };
+
+  inline Vec4 TransformPoint(const float* p, const Mat4x4& m)
+  {
+    return Vec4(p[0] * m._11 + p[1] * m._21 + p[2] * m._31 + m._41,
+      p[0] * m._12 + p[1] * m._22 + p[2] * m._32 + m._42,
+      p[0] * m._13 + p[1] * m._23 + p[2] * m._33 + m._43,
+      p[0] * m._14 + p[1] * m._24 + p[2] * m._34 + m._44);
+  }
+
+  AABB MakeBox(const Vec3& center, const Vec3& halfExtent)
+  {
+    AABB box;
+    box.min = Vec3(center.x - halfExtent.x, center.y - halfExtent.y, center.z - halfExtent.z);
+    box.max = Vec3(center.x + halfExtent.x, center.y + halfExtent.y, center.z + halfExtent.z);
+    return box;
+  }
+
+  void AddBoxTriangles(Scene& scene, const AABB& box)
+  {
+    static const uint32 faces[12][3] =
+    {
+      { 0, 1, 3 }, { 0, 3, 2 }, { 4, 6, 7 }, { 4, 7, 5 }, { 0, 4, 5 }, { 0, 5, 1 },
+      { 2, 3, 7 }, { 2, 7, 6 }, { 0, 2, 6 }, { 0, 6, 4 }, { 1, 5, 7 }, { 1, 7, 3 }
+    };
+
+    const uint32 first = (uint32)scene.positions.size() / 3;
+    for (uint32 corner = 0; corner < 8; ++corner)
+    {
+      scene.positions.push_back(corner & 1 ? box.max.x : box.min.x);
+      scene.positions.push_back(corner & 2 ? box.max.y : box.min.y);
+      scene.positions.push_back(corner & 4 ? box.max.z : box.min.z);
+    }
+
+    for (const uint32* face : faces)
+    {
+      for (uint32 v = 0; v < 3; ++v)
+        scene.indices.push_back(first + face[v]);
+    }
+  }
+
+  // Blocks of 10 to 40 m high buildings with 12 m streets, the camera at eye height in a street
+  void MakeCityScene(Scene& scene, uint32 occludeeCount, std::mt19937& random)
+  {
+    scene.name = "city";
+    std::uniform_real_distribution<float> buildingHeight(10.0f, 40.0f);
+    for (int32 blockX = -6; blockX <= 6; ++blockX)
+    {
+      for (int32 blockZ = 0; blockZ <= 12; ++blockZ)
+      {
+        const Vec3 center(blockX * 32.0f + 16.0f, 0.0f, blockZ * 32.0f + 16.0f);
+        const float height = buildingHeight(random);
+        AddBoxTriangles(scene, MakeBox(Vec3(center.x, height * 0.5f, center.z), Vec3(10.0f, height * 0.5f, 10.0f)));
+      }
+    }
+
+    scene.camera.SetPerspectiveFov(1.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+    scene.camera.SetLookAt(Vec3(0.0f, 1.7f, -10.0f), Vec3(40.0f, 3.0f, 200.0f));
+
+    // Props and characters on the ground, in the streets and in the blocks
+    std::uniform_real_distribution<float> x(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> z(0.0f, 420.0f);
+    std::uniform_real_distribution<float> size(0.3f, 2.0f);
+    for (uint32 i = 0; i < occludeeCount; ++i)
+    {
+      const float halfSize = size(random);
+      scene.occludees.push_back(MakeBox(Vec3(x(random), halfSize, z(random)), Vec3(halfSize, halfSize, halfSize)));
+    }
+  }
+
+  // Thin walls of random sizes 5 to 40 m in front of the camera
+  void MakeWallsScene(Scene& scene, uint32 occludeeCount, std::mt19937& random)
+  {
+    scene.name = "walls";
+    std::uniform_real_distribution<float> x(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> z(5.0f, 40.0f);
+    std::uniform_real_distribution<float> extent(1.0f, 6.0f);
+    for (uint32 wall = 0; wall < 40; ++wall)
+    {
+      const bool facing = random() % 2 == 0;
+      const float width = extent(random);
+      const Vec3 halfExtent = facing ? Vec3(width, extent(random), 0.1f) : Vec3(0.1f, extent(random), width);
+      AddBoxTriangles(scene, MakeBox(Vec3(x(random), halfExtent.y, z(random)), halfExtent));
+    }
+
+    scene.camera.SetPerspectiveFov(1.2f, 16.0f / 9.0f, 0.1f, 200.0f);
+    scene.camera.SetLookAt(Vec3(0.0f, 2.0f, -5.0f), Vec3(0.0f, 1.0f, 30.0f));
+
+    std::uniform_real_distribution<float> occludeeX(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> occludeeZ(5.0f, 120.0f);
+    std::uniform_real_distribution<float> size(0.2f, 1.5f);
+    for (uint32 i = 0; i < occludeeCount; ++i)
+    {
+      const float halfSize = size(random);
+      scene.occludees.push_back(MakeBox(Vec3(occludeeX(random), halfSize + size(random), occludeeZ(random)), Vec3(halfSize, halfSize, halfSize)));
+    }
+  }
+
+  // A long wall on the left running from behind the camera, its triangles cross the near plane
+  void MakeNearPlaneScene(Scene& scene, uint32 occludeeCount, std::mt19937& random)
+  {
+    scene.name = "near plane";
+    AddBoxTriangles(scene, MakeBox(Vec3(-1.0f, 5.0f, 45.0f), Vec3(0.2f, 5.0f, 55.0f)));
+    AddBoxTriangles(scene, MakeBox(Vec3(3.0f, 1.0f, 0.5f), Vec3(2.0f, 1.0f, 0.2f)));
+
+    scene.camera.SetPerspectiveFov(1.2f, 16.0f / 9.0f, 0.1f, 200.0f);
+    scene.camera.SetLookAt(Vec3(0.0f, 1.7f, 0.0f), Vec3(-0.5f, 1.7f, 10.0f));
+
+    std::uniform_real_distribution<float> x(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> z(0.5f, 100.0f);
+    std::uniform_real_distribution<float> size(0.2f, 1.0f);
+    for (uint32 i = 0; i < occludeeCount; ++i)
+    {
+      const float halfSize = size(random);
+      scene.occludees.push_back(MakeBox(Vec3(x(random), halfSize, z(random)), Vec3(halfSize, halfSize, halfSize)));
+    }
+  }
+
+  /*
+  * Per pixel depth buffer, a pixel is covered when its center is inside the triangle.
+  * Triangles crossing the near plane are clipped like in the masked buffer, leaving them out would hide less and count
+  * the boxes behind them as visible.
+  */
+  class ReferenceDepthBuffer
+  {
+  public:
+    ReferenceDepthBuffer(uint32 width, uint32 height) : m_width(width), m_height(height), m_depths(width * height, 1.0f) {}
+
+    void RenderTriangles(const float* positions, const uint32* indices, uint32 triangleCount, const Mat4x4& viewProjection)
+    {
+      for (uint32 triangle = 0; triangle < triangleCount; ++triangle)
+      {
+        Vec4 clip[3];
+        for (uint32 v = 0; v < 3; ++v)
+          clip[v] = TransformPoint(positions + indices[triangle * 3 + v] * 3, viewProjection);
+
+        Vec4 polygon[4];
+        uint32 vertexCount = 0;
+        for (uint32 v = 0; v < 3; ++v)
+        {
+          const Vec4& a = clip[v];
+          const Vec4& b = clip[(v + 1) % 3];
+          if (a.z >= 0.0f)
+            polygon[vertexCount++] = a;
+          if ((a.z >= 0.0f) != (b.z >= 0.0f))
+          {
+            const float t = a.z / (a.z - b.z);
+            polygon[vertexCount++] = Vec4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t);
+          }
+        }
+
+        for (uint32 v = 2; v < vertexCount; ++v)
+          RasterizeTriangle(polygon[0], polygon[v - 1], polygon[v]);
+      }
+    }
+
+    // Visible when a pixel of the screen rectangle of the box is farther than its nearest corner
+    bool TestAABB(const AABB& box, const Mat4x4& viewProjection) const
+    {
+      float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+      float minDepth = FLT_MAX;
+      for (uint32 corner = 0; corner < 8; ++corner)
+      {
+        const float p[3] = { corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z };
+        const Vec4 clip = TransformPoint(p, viewProjection);
+        if (clip.z < 0.0f || clip.w <= 0.0f)
+          return true;
+
+        const float x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        const float y = (0.5f - clip.y / clip.w * 0.5f) * m_height;
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+        minDepth = std::min(minDepth, clip.z / clip.w);
+      }
+
+      if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+        return true;
+
+      const uint32 x0 = (uint32)std::max(0.0f, minX);
+      const uint32 y0 = (uint32)std::max(0.0f, minY);
+      const uint32 x1 = (uint32)std::min(m_width - 1.0f, maxX);
+      const uint32 y1 = (uint32)std::min(m_height - 1.0f, maxY);
+      for (uint32 y = y0; y <= y1; ++y)
+      {
+        for (uint32 x = x0; x <= x1; ++x)
+        {
+          if (minDepth < m_depths[y * m_width + x])
+            return true;
+        }
+      }
+
+      return false;
+    }
+
+  private:
+    void RasterizeTriangle(const Vec4& a, const Vec4& b, const Vec4& c)
+    {
+      const Vec4* vertices[3] = { &a, &b, &c };
+      float x[3], y[3], z[3];
+      for (uint32 v = 0; v < 3; ++v)
+      {
+        if (vertices[v]->w <= 0.0f)
+          return;
+        x[v] = (vertices[v]->x / vertices[v]->w * 0.5f + 0.5f) * m_width;
+        y[v] = (0.5f - vertices[v]->y / vertices[v]->w * 0.5f) * m_height;
+        z[v] = vertices[v]->z / vertices[v]->w;
+      }
+
+      const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+      if (fabsf(area) < 1e-9f)
+        return;
+
+      const int32 minX = std::max(0, (int32)floorf(std::min(x[0], std::min(x[1], x[2]))));
+      const int32 minY = std::max(0, (int32)floorf(std::min(y[0], std::min(y[1], y[2]))));
+      const int32 maxX = std::min((int32)m_width - 1, (int32)ceilf(std::max(x[0], std::max(x[1], x[2]))));
+      const int32 maxY = std::min((int32)m_height - 1, (int32)ceilf(std::max(y[0], std::max(y[1], y[2]))));
+      for (int32 py = minY; py <= maxY; ++py)
+      {
+        for (int32 px = minX; px <= maxX; ++px)
+        {
+          const float cx = px + 0.5f;
+          const float cy = py + 0.5f;
+          const float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+          const float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+          const float w2 = 1.0f - w0 - w1;
+          if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+            continue;
+
+          float& depth = m_depths[py * m_width + px];
+          depth = std::min(depth, w0 * z[0] + w1 * z[1] + w2 * z[2]);
+        }
+      }
+    }
+
+  private:
+    uint32 m_width;
+    uint32 m_height;
+    std::vector<float> m_depths;
+  };
+
+  bool CheckScene(const Scene& scene, const CheckOptions& options, JobSystem& jobSystem)
+  {
+    const Mat4x4& viewProjection = scene.camera.GetViewProjectionMatrix();
+    const uint32 triangleCount = (uint32)scene.indices.size() / 3;
+
+    ReferenceDepthBuffer reference(options.width, options.height);
+    reference.RenderTriangles(scene.positions.data(), scene.indices.data(), triangleCount, viewProjection);
+
+    // Once on the calling thread and once over the job system, the second buffer is the one tested
+    MaskedOcclusionBuffer buffer;
+    buffer.Init(options.width, options.height);
+    auto start = ToolClock::now();
+    buffer.RenderTriangles(scene.positions.data(), 3 * sizeof(float), scene.indices.data(), triangleCount, viewProjection);
+    const uint32 screenTriangleCount = buffer.GetTriangleCount(); // Rasterize empties the list
+    buffer.Rasterize(nullptr);
+    const double serialMilliseconds = GetMilliseconds(start);
+
+    buffer.Clear();
+    start = ToolClock::now();
+    buffer.RenderTriangles(scene.positions.data(), 3 * sizeof(float), scene.indices.data(), triangleCount, viewProjection);
+    buffer.Rasterize(&jobSystem);
+    const double jobsMilliseconds = GetMilliseconds(start);
+
+    uint32 referenceHidden = 0;
+    uint32 bufferHidden = 0;
+    uint32 falselyHidden = 0;
+    std::vector<uint8> visible(scene.occludees.size());
+    start = ToolClock::now();
+    for (uint32 i = 0; i < (uint32)scene.occludees.size(); ++i)
+      visible[i] = buffer.TestAABB(scene.occludees[i], viewProjection) ? 1 : 0;
+    const double testMilliseconds = GetMilliseconds(start);
+
+    for (uint32 i = 0; i < (uint32)scene.occludees.size(); ++i)
+    {
+      const bool referenceVisible = reference.TestAABB(scene.occludees[i], viewProjection);
+      referenceHidden += referenceVisible ? 0 : 1;
+      bufferHidden += visible[i] ? 0 : 1;
+      falselyHidden += !visible[i] && referenceVisible ? 1 : 0;
+    }
+
+    const float ratio = referenceHidden > 0 ? (float)bufferHidden / referenceHidden : 1.0f;
+    printf("%12s %10u %10u/%-6u %9u %8.0f%% %10.3f %10.3f %10.3f\n", scene.name, screenTriangleCount, referenceHidden,
+      (uint32)scene.occludees.size(), bufferHidden, ratio * 100.0f, serialMilliseconds, jobsMilliseconds,
+      testMilliseconds * 1000.0 / scene.occludees.size());
+
+    bool passed = true;
+    if (falselyHidden > 0)
+    {
+      printf("FAILED: %s, %u boxes hidden by the buffer are visible in the reference\n", scene.name, falselyHidden);
+      passed = false;
+    }
+
+    if (ratio < MinCullingRatio)
+    {
+      printf("FAILED: %s, the buffer hides %.0f%% of what the reference hides\n", scene.name, ratio * 100.0f);
+      passed = false;
+    }
+
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--width", options.width);
+    commandLine.Add("--height", options.height);
+    commandLine.Add("--occludees", options.occludeeCount);
+    commandLine.Add("--workers", options.workerCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    // Whole tiles, the reference buffer has the size of the masked one
+    return options.width > 0 && options.height > 0 && options.width % MaskedOcclusionBuffer::TileWidth == 0 &&
+      options.height % MaskedOcclusionBuffer::TileHeight == 0 && options.occludeeCount > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--width multiple of %u] [--height multiple of %u] [--occludees n] [--workers n] [--seed n]\n", argv[0],
+      MaskedOcclusionBuffer::TileWidth, MaskedOcclusionBuffer::TileHeight);
+    return EXIT_FAILURE;
+  }
+
+  JobSystem jobSystem(options.workerCount);
+  printf("%ux%u buffer, %u workers\n", options.width, options.height, jobSystem.GetWorkerCount());
+  printf("%12s %10s %16s %9s %9s %10s %10s %10s\n", "scene", "triangles", "reference hidden", "hidden", "of ref", "raster ms", "jobs ms",
+    "test us");
+
+  std::mt19937 random(options.seed);
+  Scene scenes[3];
+  MakeCityScene(scenes[0], options.occludeeCount, random);
+  MakeWallsScene(scenes[1], options.occludeeCount, random);
+  MakeNearPlaneScene(scenes[2], options.occludeeCount, random);
+
+  bool passed = true;
+  for (const Scene& scene : scenes)
+    passed = CheckScene(scene, options, jobSystem) && passed;
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,340 @@
+// Command line baker of potentially visible sets, see Core/Scene/Visibility/PVSBaker.h
+//
+// Usage:
+//   PVSBaker <scene.obj> <output.pvs> [options]  Bakes an OBJ file, every object or group is an occluder and a PVS object.
+//                                              Object indices follow the order of the objects in the file.
+//   PVSBaker --benchmark [options]             Bakes a generated city with 1 to N threads and prints the timings
+// Options:
+//   --cell-size <meters> --voxel-size <meters> --samples <count> --rays <count> --threads <count> --no-merge
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "Jobs/JobSystem.h"
+#include "Scene/Visibility/PVSBaker.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct ToolOptions
+  {
+    String inputPath; // Empty with --benchmark
+    String outputPath;
+    bool benchmark = false;
+    uint32 threadCount = 0; // 0 is one per hardware thread
+    PVSBakeSettings settings;
+  };
+
+  // Scene geometry is already in world space
+  Mat4x4 GetIdentity()
+  {
+    Mat4x4 identity;
+    MakeIdentity(identity);
+    return identity;
+  }
+
+  const Mat4x4 Identity = GetIdentity();
+
+  void PrintProgress(uint32 doneCount, uint32 totalCount, void*)
+  {
+    // Only when the percentage changes, the callback runs after every cell
+    const uint32 percent = (uint32)((uint64)doneCount * 100 / totalCount);
+    const uint32 previous = (uint32)((uint64)(doneCount - 1) * 100 / totalCount);
+    if (percent != previous || doneCount == totalCount)
+    {
+      printf("\r  view cells %u / %u (%u%%)", doneCount, totalCount, percent);
+      if (doneCount == totalCount)
+        printf("\n");
+      fflush(stdout);
+    }
+  }
+
+  void PrintStats(const PVSBaker& baker, const PotentiallyVisibleSet& pvs)
+  {
+    const PVSBakeStats& stats = baker.GetStats();
+    const uint32 bakedCellCount = stats.viewCellCount - stats.emptyViewCellCount;
+    const float totalMilliseconds = stats.voxelizeMilliseconds + stats.visibilityMilliseconds + stats.compressMilliseconds;
+
+    printf("  objects %u, occluder triangles %u, voxels %u (%u solid)\n", baker.GetObjectCount(), baker.GetOccluderTriangleCount(), stats.voxelCount, stats.solidVoxelCount);
+    printf("  view cells %u (%u inside geometry), average visible objects %.1f%%\n", stats.viewCellCount, stats.emptyViewCellCount,
+      bakedCellCount > 0 ? 100.0 * stats.visiblePairCount / ((double)bakedCellCount * baker.GetObjectCount()) : 0.0);
+    printf("  voxelize %.1f ms, visibility %.1f ms, compress %.1f ms, total %.1f ms\n", stats.voxelizeMilliseconds, stats.visibilityMilliseconds,
+      stats.compressMilliseconds, totalMilliseconds);
+    printf("  rays %llu (%.2f M rays/s)\n", (unsigned long long)stats.rayCount,
+      stats.visibilityMilliseconds > 0.0f ? stats.rayCount / (stats.visibilityMilliseconds * 1000.0) : 0.0);
+    printf("  bitsets %.1f KiB -> %.1f KiB compressed, %u unique of %u cells\n", stats.uncompressedSize / 1024.0, stats.compressedSize / 1024.0,
+      pvs.GetSetCount(), bakedCellCount);
+  }
+
+  void AddBox(std::vector<float>& positions, std::vector<uint32>& indices, const Vec3& min, const Vec3& max)
+  {
+    const uint32 first = (uint32)positions.size() / 3;
+    for (uint32 corner = 0; corner < 8; ++corner)
+    {
+      positions.push_back((corner & 1) ? max.x : min.x);
+      positions.push_back((corner & 2) ? max.y : min.y);
+      positions.push_back((corner & 4) ? max.z : min.z);
+    }
+
+    static const uint32 boxIndices[36] =
+    {
+      0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, // -z, +z
+      0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, // -y, +y
+      0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5  // -x, +x
+    };
+    for (uint32 index : boxIndices)
+      indices.push_back(first + index);
+  }
+
+  // Blocks of closed buildings separated by streets, with small props on the streets that only act as objects
+  void BuildCity(PVSBaker& baker, uint32 blockCount)
+  {
+    const float blockSize = 40.0f;
+    const float streetWidth = 12.0f;
+    srand(7);
+
+    for (uint32 z = 0; z < blockCount; ++z)
+    {
+      for (uint32 x = 0; x < blockCount; ++x)
+      {
+        const float originX = x * (blockSize + streetWidth);
+        const float originZ = z * (blockSize + streetWidth);
+
+        // Four buildings per block
+        for (uint32 building = 0; building < 4; ++building)
+        {
+          const float halfBlock = blockSize * 0.5f;
+          const Vec3 min(originX + (building & 1) * halfBlock + 1.0f, 0.0f, originZ + (building >> 1) * halfBlock + 1.0f);
+          const Vec3 max(min.x + halfBlock - 2.0f, 10.0f + (float)(rand() % 30), min.z + halfBlock - 2.0f);
+
+          std::vector<float> positions;
+          std::vector<uint32> indices;
+          AddBox(positions, indices, min, max);
+          baker.AddOccluder(positions.data(), sizeof(float) * 3, indices.data(), (uint32)indices.size() / 3, Identity);
+
+          AABB bounds;
+          bounds.min = min;
+          bounds.max = max;
+          baker.AddObject(bounds);
+        }
+
+        // Props in the street corner
+        for (uint32 prop = 0; prop < 4; ++prop)
+        {
+          AABB bounds;
+          bounds.min = Vec3(originX + blockSize + 1.0f + prop * 2.5f, 0.0f, originZ + blockSize + 2.0f);
+          bounds.max = Vec3(bounds.min.x + 1.0f, 2.0f, bounds.min.z + 1.0f);
+          baker.AddObject(bounds);
+        }
+      }
+    }
+
+    // Ground
+    std::vector<float> positions;
+    std::vector<uint32> indices;
+    const float size = blockCount * (blockSize + streetWidth);
+    AddBox(positions, indices, Vec3(-streetWidth, -1.0f, -streetWidth), Vec3(size, 0.0f, size));
+    baker.AddOccluder(positions.data(), sizeof(float) * 3, indices.data(), (uint32)indices.size() / 3, Identity);
+  }
+
+  // Positions and faces only, faces are triangulated as fans. Returns false if the file can not be read.
+  bool LoadOBJ(const char* path, PVSBaker& baker)
+  {
+    std::ifstream stream(path);
+    if (!stream)
+      return false;
+
+    std::vector<float> positions;
+    std::vector<uint32> indices;
+    bool hasObject = false;
+    AABB bounds;
+
+    auto flushObject = [&]()
+      {
+        if (!indices.empty())
+        {
+          baker.AddOccluder(positions.data(), sizeof(float) * 3, indices.data(), (uint32)indices.size() / 3, Identity);
+          baker.AddObject(bounds);
+        }
+        indices.clear();
+        hasObject = false;
+      };
+
+    String line;
+    while (std::getline(stream, line))
+    {
+      std::istringstream tokens(line);
+      String type;
+      tokens >> type;
+
+      if (type == "v")
+      {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        tokens >> x >> y >> z;
+        positions.push_back(x);
+        positions.push_back(y);
+        positions.push_back(z);
+      }
+      else if (type == "o" || type == "g")
+      {
+        flushObject();
+      }
+      else if (type == "f")
+      {
+        std::vector<uint32> face;
+        String vertex;
+        while (tokens >> vertex)
+        {
+          // v, v/vt, v//vn or v/vt/vn, negative indices are relative to the end
+          const long index = strtol(vertex.c_str(), nullptr, 10);
+          const long vertexCount = (long)positions.size() / 3;
+          const long resolved = index < 0 ? vertexCount + index : index - 1;
+          if (resolved < 0 || resolved >= vertexCount)
+            return false;
+          face.push_back((uint32)resolved);
+        }
+
+        for (size_t i = 2; i < face.size(); ++i)
+        {
+          const uint32 triangle[3] = { face[0], face[i - 1], face[i] };
+          for (uint32 index : triangle)
+          {
+            const Vec3 p(positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2]);
+            if (!hasObject)
+            {
+              bounds.min = p;
+              bounds.max = p;
+              hasObject = true;
+            }
+            bounds.min = Vec3(std::min(bounds.min.x, p.x), std::min(bounds.min.y, p.y), std::min(bounds.min.z, p.z));
+            bounds.max = Vec3(std::max(bounds.max.x, p.x), std::max(bounds.max.y, p.y), std::max(bounds.max.z, p.z));
+            indices.push_back(index);
+          }
+        }
+      }
+    }
+    flushObject();
+
+    return true;
+  }
+
+  bool ParseOptions(int argc, char** argv, ToolOptions& options)
+  {
+    std::vector<String> paths;
+    CommandLine commandLine;
+    commandLine.AddFlag("--benchmark", options.benchmark);
+    commandLine.AddFlag("--no-merge", options.settings.mergeNeighbours, false);
+    commandLine.Add("--cell-size", options.settings.viewCellSize);
+    commandLine.Add("--voxel-size", options.settings.voxelSize);
+    commandLine.Add("--samples", options.settings.viewSamplesPerCell);
+    commandLine.Add("--rays", options.settings.raysPerObject);
+    commandLine.Add("--threads", options.threadCount);
+    commandLine.AddPositional(paths);
+    if (!commandLine.Parse(argc, argv) || paths.size() > 2)
+      return false;
+
+    if (paths.size() == 2)
+    {
+      options.inputPath = paths[0];
+      options.outputPath = paths[1];
+    }
+    options.settings.viewSamplesPerCell = std::min(options.settings.viewSamplesPerCell, PVSBakeSettings::MaxViewSamplesPerCell);
+
+    if (options.settings.voxelSize <= 0.0f || options.settings.viewCellSize < options.settings.voxelSize)
+      return false;
+
+    return options.benchmark || !options.inputPath.empty();
+  }
+
+  int RunBenchmark(const ToolOptions& options)
+  {
+    PVSBakeSettings settings = options.settings;
+    if (settings.viewCellSize == PVSBakeSettings().viewCellSize)
+      settings.viewCellSize = 8.0f;
+    if (settings.voxelSize == PVSBakeSettings().voxelSize)
+      settings.voxelSize = 1.0f;
+
+    // Powers of two up to the thread count, then the thread count
+    const uint32 maxThreadCount = options.threadCount > 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32> threadCounts;
+    for (uint32 threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+      threadCounts.push_back(threadCount);
+    threadCounts.push_back(maxThreadCount);
+
+    for (uint32 blockCount : { 2u, 4u })
+    {
+      PVSBaker baker;
+      BuildCity(baker, blockCount);
+      printf("City of %ux%u blocks, view cells of %.1f m, voxels of %.1f m\n", blockCount, blockCount, settings.viewCellSize, settings.voxelSize);
+
+      float singleThreadMilliseconds = 0.0f;
+      for (uint32 threadCount : threadCounts)
+      {
+        // The calling thread helps while it waits, one less worker
+        std::unique_ptr<JobSystem> jobSystem = threadCount > 1 ? std::make_unique<JobSystem>(threadCount - 1) : nullptr;
+        PotentiallyVisibleSet pvs;
+        if (baker.Bake(settings, jobSystem.get(), pvs) != 0)
+          return EXIT_FAILURE;
+
+        const PVSBakeStats& stats = baker.GetStats();
+        const float milliseconds = stats.voxelizeMilliseconds + stats.visibilityMilliseconds + stats.compressMilliseconds;
+        if (threadCount == 1)
+        {
+          singleThreadMilliseconds = milliseconds;
+          PrintStats(baker, pvs);
+        }
+        printf("  %2u threads: %9.1f ms, speedup %.2fx\n", threadCount, milliseconds, singleThreadMilliseconds / milliseconds);
+      }
+    }
+
+    return EXIT_SUCCESS;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ToolOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s <scene.obj> <output.pvs> [--cell-size m] [--voxel-size m] [--samples n] [--rays n] [--threads n] [--no-merge]\n", argv[0]);
+    printf("       %s --benchmark [options]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (options.benchmark)
+    return RunBenchmark(options);
+
+  PVSBaker baker;
+  if (!LoadOBJ(options.inputPath.c_str(), baker))
+  {
+    printf("Failed to read %s\n", options.inputPath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  const uint32 threadCount = options.threadCount > 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+  std::unique_ptr<JobSystem> jobSystem = threadCount > 1 ? std::make_unique<JobSystem>(threadCount - 1) : nullptr;
+  printf("Baking %s, %u objects, %u threads\n", options.inputPath.c_str(), baker.GetObjectCount(), threadCount);
+
+  PotentiallyVisibleSet pvs;
+  if (baker.Bake(options.settings, jobSystem.get(), pvs, PrintProgress) != 0)
+  {
+    printf("Nothing to bake in %s\n", options.inputPath.c_str());
+    return EXIT_FAILURE;
+  }
+  PrintStats(baker, pvs);
+
+  if (pvs.Save(options.outputPath) != 0)
+  {
+    printf("Failed to write %s\n", options.outputPath.c_str());
+    return EXIT_FAILURE;
+  }
+  printf("Saved %s\n", options.outputPath.c_str());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+// Traversal cost of the cell and portal culler on generated room grids, see Core/Scene/Visibility/PortalCuller.h
+//
+// Usage:
+//   PortalBenchmark [--cameras <count>] [--max-visits <count>] [--far <meters>] [--seed <value>]
+// Every grid is N x N rooms of 10 m, neighbour rooms are connected by a door with the given probability.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "Scene/Visibility/PortalCuller.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  static constexpr float RoomSize = 10.0f;
+  static constexpr float RoomHeight = 3.0f;
+  static constexpr float DoorWidth = 1.5f;
+  static constexpr float DoorHeight = 2.2f;
+  static constexpr float WallThickness = 0.2f;
+
+  struct BenchmarkOptions
+  {
+    uint32 cameraCount = 1000;
+    uint32 maxVisits = PortalCuller::DefaultMaxVisits;
+    float farDistance = 500.0f;
+    uint32 seed = 1;
+  };
+
+  AABB MakeBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+  {
+    AABB box;
+    box.min = Vec3(minX, minY, minZ);
+    box.max = Vec3(maxX, maxY, maxZ);
+    return box;
+  }
+
+  // Rooms on the XZ plane, doors are boxes across the shared wall at a random position along it
+  void BuildRooms(PortalGraph& graph, uint32 roomCount, float doorChance, std::mt19937& random)
+  {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<AABB> cells;
+    std::vector<AABB> doors;
+    for (uint32 z = 0; z < roomCount; ++z)
+    {
+      for (uint32 x = 0; x < roomCount; ++x)
+      {
+        const float minX = x * RoomSize;
+        const float minZ = z * RoomSize;
+        cells.push_back(MakeBox(minX, 0.0f, minZ, minX + RoomSize, RoomHeight, minZ + RoomSize));
+
+        const float offset = 1.0f + unit(random) * (RoomSize - 2.0f - DoorWidth);
+        if (x + 1 < roomCount && unit(random) < doorChance)
+        {
+          const float wall = minX + RoomSize;
+          doors.push_back(MakeBox(wall - WallThickness, 0.0f, minZ + offset, wall + WallThickness, DoorHeight, minZ + offset + DoorWidth));
+        }
+        if (z + 1 < roomCount && unit(random) < doorChance)
+        {
+          const float wall = minZ + RoomSize;
+          doors.push_back(MakeBox(minX + offset, 0.0f, wall - WallThickness, minX + offset + DoorWidth, DoorHeight, wall + WallThickness));
+        }
+      }
+    }
+
+    graph.BuildFromBoxes(cells.data(), (uint32)cells.size(), doors.data(), (uint32)doors.size());
+  }
+
+  Vec4 MakePlane(const Vec3& normal, const Vec3& point)
+  {
+    const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    const Vec3 n = Vec3(normal.x / length, normal.y / length, normal.z / length);
+    return Vec4(n.x, n.y, n.z, -(n.x * point.x + n.y * point.y + n.z * point.z));
+  }
+
+  // 90 degree horizontal and vertical field of view looking along the yaw on the XZ plane
+  Frustum MakeFrustum(const Vec3& eye, float yaw, float pitch, float nearDistance, float farDistance)
+  {
+    const Vec3 forward = Vec3(cosf(pitch) * cosf(yaw), sinf(pitch), cosf(pitch) * sinf(yaw));
+    const Vec3 right = Vec3(sinf(yaw), 0.0f, -cosf(yaw));
+    const Vec3 up = Vec3(right.y * forward.z - right.z * forward.y, right.z * forward.x - right.x * forward.z, right.x * forward.y - right.y * forward.x);
+
+    Frustum frustum;
+    frustum.planes[0] = MakePlane(Vec3(forward.x + right.x, forward.y + right.y, forward.z + right.z), eye);
+    frustum.planes[1] = MakePlane(Vec3(forward.x - right.x, forward.y - right.y, forward.z - right.z), eye);
+    frustum.planes[2] = MakePlane(Vec3(forward.x + up.x, forward.y + up.y, forward.z + up.z), eye);
+    frustum.planes[3] = MakePlane(Vec3(forward.x - up.x, forward.y - up.y, forward.z - up.z), eye);
+    frustum.planes[4] = MakePlane(forward, Vec3(eye.x + forward.x * nearDistance, eye.y + forward.y * nearDistance, eye.z + forward.z * nearDistance));
+    frustum.planes[5] = MakePlane(Vec3(-forward.x, -forward.y, -forward.z),
+      Vec3(eye.x + forward.x * farDistance, eye.y + forward.y * farDistance, eye.z + forward.z * farDistance));
+    return frustum;
+  }
+
+  // Cells frustum culling alone would draw
+  uint32 CountCellsInFrustum(const PortalGraph& graph, const Frustum& frustum)
+  {
+    uint32 count = 0;
+    for (uint32 i = 0; i < graph.GetCellCount(); ++i)
+    {
+      const AABB& bounds = graph.GetCell(i).bounds;
+      bool inside = true;
+      for (const Vec4& plane : frustum.planes)
+      {
+        const float x = plane.x >= 0.0f ? bounds.max.x : bounds.min.x;
+        const float y = plane.y >= 0.0f ? bounds.max.y : bounds.min.y;
+        const float z = plane.z >= 0.0f ? bounds.max.z : bounds.min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+        {
+          inside = false;
+          break;
+        }
+      }
+      count += inside ? 1 : 0;
+    }
+    return count;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--cameras", options.cameraCount);
+    commandLine.Add("--max-visits", options.maxVisits);
+    commandLine.Add("--far", options.farDistance);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.cameraCount > 0 && options.maxVisits > 0 && options.farDistance > 1.0f;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--cameras n] [--max-visits n] [--far m] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%u cameras per grid, far plane %.0f m, at most %u visits\n", options.cameraCount, options.farDistance, options.maxVisits);
+  printf("%9s %6s %10s %10s %10s %12s %12s %8s\n", "rooms", "doors", "us/cull", "visits", "tests", "portal cells", "frustum cells", "gave up");
+
+  for (uint32 roomCount : { 16u, 64u, 256u })
+  {
+    for (float doorChance : { 0.3f, 0.6f, 1.0f })
+    {
+      std::mt19937 random(options.seed);
+      PortalGraph graph;
+      BuildRooms(graph, roomCount, doorChance, random);
+
+      PortalCuller culler;
+      culler.SetMaxVisits(options.maxVisits);
+
+      std::uniform_real_distribution<float> position(0.5f, roomCount * RoomSize - 0.5f);
+      std::uniform_real_distribution<float> height(1.0f, 2.0f);
+      std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+      std::uniform_real_distribution<float> pitch(-0.3f, 0.3f);
+
+      double totalSeconds = 0.0;
+      uint64 visitCount = 0;
+      uint64 portalTestCount = 0;
+      uint64 visibleCellCount = 0;
+      uint64 frustumCellCount = 0;
+      uint32 gaveUpCount = 0;
+      for (uint32 i = 0; i < options.cameraCount; ++i)
+      {
+        const Vec3 eye = Vec3(position(random), height(random), position(random));
+        const Frustum frustum = MakeFrustum(eye, angle(random), pitch(random), 0.1f, options.farDistance);
+
+        const auto start = ToolClock::now();
+        const bool culled = culler.Cull(graph, frustum, eye);
+        totalSeconds += GetSeconds(start);
+
+        const PortalCullStats& stats = culler.GetStats();
+        visitCount += stats.visitCount;
+        portalTestCount += stats.portalTestCount;
+        gaveUpCount += stats.gaveUp ? 1 : 0;
+
+        // A walk that gave up culls nothing beyond the view frustum
+        const uint32 frustumCells = CountCellsInFrustum(graph, frustum);
+        frustumCellCount += frustumCells;
+        visibleCellCount += culled ? stats.visibleCellCount : frustumCells;
+      }
+
+      const double cameraCount = options.cameraCount;
+      printf("%4ux%-4u %6u %10.2f %10.1f %10.1f %12.1f %12.1f %8u\n", roomCount, roomCount, graph.GetPortalCount(),
+        totalSeconds * 1e6 / cameraCount, visitCount / cameraCount, portalTestCount / cameraCount, visibleCellCount / cameraCount,
+        frustumCellCount / cameraCount, gaveUpCount);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
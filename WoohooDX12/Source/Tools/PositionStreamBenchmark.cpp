@@ -0,0 +1,316 @@
+// Bytes fetched by depth-only passes with the position-only stream, see Core/Graphics/Geometry/PositionStream.h
+//
+// Usage:
+//   PositionStreamBenchmark [--compact]
+// Test scenes of position and colour vertices, each mesh instanced like in a level: flat shaded props, modular pieces with a
+// colour per face, a smooth character and a terrain with a vertex set per material region. The meshes are optimized like at
+// import. For a depth-only pass, the vertex fetch of the interleaved vertices, of the position stream drawn with the mesh
+// indices and of the welded positions with their own indices is simulated (16 entry post-transform cache, 16KB of 64 byte
+// lines), with the vertex shader invocations and the extra memory of the stream. The welded triangles are checked to have the
+// positions of the source triangles. --compact uses the compact vertex formats: 12 byte vertices and 8 byte positions.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/MeshOptimizer.h"
+#include "Graphics/Geometry/PositionStream.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkVertex
+  {
+    float position[3];
+    float color[3];
+  };
+
+  struct BenchmarkOptions
+  {
+    bool compact = false;
+  };
+
+  struct BenchmarkMesh
+  {
+    std::string name;
+    std::vector<BenchmarkVertex> vertices;
+    std::vector<uint32> indices;
+    uint32 instanceCount = 1;
+  };
+
+  // Per pass over the instances of a scene
+  struct PassMetrics
+  {
+    uint64 interleavedBytes = 0;
+    uint64 streamBytes = 0;
+    uint64 weldedBytes = 0;
+    uint64 indexBytes = 0;
+    uint64 interleavedInvocations = 0;
+    uint64 weldedInvocations = 0;
+    uint64 streamMemory = 0; // Of one copy of the meshes
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.AddFlag("--compact", options.compact);
+    return commandLine.Parse(argc, argv);
+  }
+
+  void AddVertex(BenchmarkMesh& mesh, const float* position, const float* color)
+  {
+    BenchmarkVertex vertex;
+    memcpy(vertex.position, position, sizeof(vertex.position));
+    memcpy(vertex.color, color, sizeof(vertex.color));
+    mesh.vertices.push_back(vertex);
+  }
+
+  // Subdivided icosahedron, every triangle has its own vertices in the colour of its face
+  void BuildFlatShadedSphere(uint32 subdivisions, BenchmarkMesh& mesh)
+  {
+    const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+    std::vector<float> positions = { -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, 0, 0, -1, t, 0, 1, t, 0, -1, -t, 0, 1, -t, t, 0, -1, t, 0, 1, -t, 0, -1, -t, 0, 1 };
+    std::vector<uint32> indices = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+      3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+
+    // Midpoints are not shared, the welding finds them again
+    for (uint32 s = 0; s < subdivisions; ++s)
+    {
+      std::vector<uint32> subdivided;
+      for (size_t i = 0; i < indices.size(); i += 3)
+      {
+        uint32 corners[6] = { indices[i], indices[i + 1], indices[i + 2] };
+        for (uint32 edge = 0; edge < 3; ++edge)
+        {
+          corners[3 + edge] = (uint32)positions.size() / 3;
+          for (uint32 axis = 0; axis < 3; ++axis)
+            positions.push_back((positions[corners[edge] * 3 + axis] + positions[corners[(edge + 1) % 3] * 3 + axis]) * 0.5f);
+        }
+        const uint32 a = corners[0], b = corners[1], c = corners[2], ab = corners[3], bc = corners[4], ca = corners[5];
+        subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+      }
+      indices.swap(subdivided);
+    }
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+      const float color[3] = { (float)(i % 7) / 7.0f, (float)(i % 5) / 5.0f, (float)(i % 3) / 3.0f };
+      for (uint32 corner = 0; corner < 3; ++corner)
+      {
+        float position[3];
+        memcpy(position, &positions[indices[i + corner] * 3], sizeof(position));
+        const float length = sqrtf(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+        position[0] /= length;
+        position[1] /= length;
+        position[2] /= length;
+        mesh.indices.push_back((uint32)mesh.vertices.size());
+        AddVertex(mesh, position, color);
+      }
+    }
+  }
+
+  // Box with segments x segments quads per face, every face has its own vertices and colour
+  void BuildBox(uint32 segments, BenchmarkMesh& mesh)
+  {
+    for (uint32 face = 0; face < 6; ++face)
+    {
+      const uint32 axis = face / 2;
+      const float side = face % 2 == 0 ? -1.0f : 1.0f;
+      const float color[3] = { axis == 0 ? 1.0f : 0.2f, axis == 1 ? 1.0f : 0.2f, axis == 2 ? 1.0f : 0.2f };
+      const uint32 base = (uint32)mesh.vertices.size();
+      for (uint32 y = 0; y <= segments; ++y)
+      {
+        for (uint32 x = 0; x <= segments; ++x)
+        {
+          float position[3];
+          position[axis] = side;
+          position[(axis + 1) % 3] = (float)x / segments * 2.0f - 1.0f;
+          position[(axis + 2) % 3] = (float)y / segments * 2.0f - 1.0f;
+          AddVertex(mesh, position, color);
+        }
+      }
+      for (uint32 y = 0; y < segments; ++y)
+      {
+        for (uint32 x = 0; x < segments; ++x)
+        {
+          const uint32 v00 = base + y * (segments + 1) + x;
+          const uint32 v10 = v00 + 1;
+          const uint32 v01 = v00 + segments + 1;
+          const uint32 v11 = v01 + 1;
+          mesh.indices.insert(mesh.indices.end(), { v00, v01, v10, v10, v01, v11 });
+        }
+      }
+    }
+  }
+
+  void BuildTorus(uint32 segments, BenchmarkMesh& mesh)
+  {
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float position[3] = { (1.0f + 0.3f * cosf(v)) * cosf(u), 0.3f * sinf(v), (1.0f + 0.3f * cosf(v)) * sinf(u) };
+        const float color[3] = { 0.5f + 0.5f * cosf(u), 0.5f + 0.5f * sinf(v), 0.5f };
+        AddVertex(mesh, position, color);
+      }
+    }
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const uint32 v00 = y * segments + x;
+        const uint32 v10 = y * segments + (x + 1) % segments;
+        const uint32 v01 = (y + 1) % segments * segments + x;
+        const uint32 v11 = (y + 1) % segments * segments + (x + 1) % segments;
+        mesh.indices.insert(mesh.indices.end(), { v00, v01, v10, v10, v01, v11 });
+      }
+    }
+  }
+
+  // Height field cut in regions x regions materials, every region has its own vertices so the borders are doubled
+  void BuildTerrain(uint32 segments, uint32 regions, BenchmarkMesh& mesh)
+  {
+    const uint32 regionSegments = segments / regions;
+    for (uint32 ry = 0; ry < regions; ++ry)
+    {
+      for (uint32 rx = 0; rx < regions; ++rx)
+      {
+        const float color[3] = { (float)rx / regions, (float)ry / regions, 0.3f };
+        const uint32 base = (uint32)mesh.vertices.size();
+        for (uint32 y = 0; y <= regionSegments; ++y)
+        {
+          for (uint32 x = 0; x <= regionSegments; ++x)
+          {
+            const float u = (float)(rx * regionSegments + x) / segments;
+            const float v = (float)(ry * regionSegments + y) / segments;
+            const float position[3] = { u * 2.0f - 1.0f, 0.1f * sinf(u * 9.0f) * cosf(v * 7.0f), v * 2.0f - 1.0f };
+            AddVertex(mesh, position, color);
+          }
+        }
+        for (uint32 y = 0; y < regionSegments; ++y)
+        {
+          for (uint32 x = 0; x < regionSegments; ++x)
+          {
+            const uint32 v00 = base + y * (regionSegments + 1) + x;
+            const uint32 v10 = v00 + 1;
+            const uint32 v01 = v00 + regionSegments + 1;
+            const uint32 v11 = v01 + 1;
+            mesh.indices.insert(mesh.indices.end(), { v00, v01, v10, v10, v01, v11 });
+          }
+        }
+      }
+    }
+  }
+
+  // Like Mesh::OptimizeGeometry, without the overdraw pass that does not change the fetches much
+  void Optimize(BenchmarkMesh& mesh)
+  {
+    MeshOptimizer optimizer;
+    optimizer.OptimizeVertexCache(mesh.indices.data(), (uint32)mesh.indices.size(), (uint32)mesh.vertices.size());
+
+    std::vector<uint32> remap;
+    const uint32 usedCount = optimizer.OptimizeVertexFetch(mesh.indices.data(), (uint32)mesh.indices.size(), (uint32)mesh.vertices.size(), remap);
+    std::vector<BenchmarkVertex> vertices(usedCount);
+    MeshOptimizer::RemapVertices(vertices.data(), mesh.vertices.data(), (uint32)mesh.vertices.size(), sizeof(BenchmarkVertex), remap.data());
+    mesh.vertices.swap(vertices);
+  }
+
+  bool Measure(const BenchmarkMesh& mesh, const BenchmarkOptions& options, PositionStreamBuilder& builder, PassMetrics& totals)
+  {
+    const uint32 vertexSize = options.compact ? 12 : 24;
+    const uint32 positionSize = options.compact ? 8 : 12;
+    const uint32 vertexCount = (uint32)mesh.vertices.size();
+    const uint32 indexCount = (uint32)mesh.indices.size();
+
+    const uint32 positionCount = builder.Build(mesh.vertices[0].position, sizeof(BenchmarkVertex), vertexCount, mesh.indices.data(), indexCount);
+    const std::vector<uint32>& weldedIndices = builder.GetIndices();
+    for (uint32 i = 0; i < indexCount; ++i)
+    {
+      const float* source = mesh.vertices[mesh.indices[i]].position;
+      const float* welded = mesh.vertices[builder.GetSourceVertices()[weldedIndices[i]]].position;
+      if (memcmp(source, welded, 3 * sizeof(float)) != 0)
+      {
+        printf("%s: welded corner %u has another position\n", mesh.name.c_str(), i);
+        return false;
+      }
+    }
+
+    const VertexFetchStats interleaved = MeshOptimizer::AnalyzeVertexFetch(mesh.indices.data(), indexCount, vertexCount, vertexSize);
+    const VertexFetchStats stream = MeshOptimizer::AnalyzeVertexFetch(mesh.indices.data(), indexCount, vertexCount, positionSize);
+    const VertexFetchStats welded = MeshOptimizer::AnalyzeVertexFetch(weldedIndices.data(), indexCount, positionCount, positionSize);
+    const VertexCacheStats interleavedCache = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), indexCount, vertexCount);
+    const VertexCacheStats weldedCache = MeshOptimizer::AnalyzeVertexCache(weldedIndices.data(), indexCount, positionCount);
+
+    printf("%-24s %6u x %7u vertices %7u positions  %8.1f KB %8.1f KB %8.1f KB  %7u -> %7u VS\n", mesh.name.c_str(), mesh.instanceCount,
+      vertexCount, positionCount, interleaved.bytesFetched / 1024.0, stream.bytesFetched / 1024.0, welded.bytesFetched / 1024.0,
+      interleavedCache.transformedCount, weldedCache.transformedCount);
+
+    totals.interleavedBytes += (uint64)interleaved.bytesFetched * mesh.instanceCount;
+    totals.streamBytes += (uint64)stream.bytesFetched * mesh.instanceCount;
+    totals.weldedBytes += (uint64)welded.bytesFetched * mesh.instanceCount;
+    totals.indexBytes += (uint64)indexCount * sizeof(uint16) * mesh.instanceCount;
+    totals.interleavedInvocations += (uint64)interleavedCache.transformedCount * mesh.instanceCount;
+    totals.weldedInvocations += (uint64)weldedCache.transformedCount * mesh.instanceCount;
+    // Like Mesh: welded when the dropped positions pay for the index buffer
+    const bool useWelded = (uint64)(vertexCount - positionCount) * positionSize > (uint64)indexCount * sizeof(uint16);
+    totals.streamMemory += useWelded ? (uint64)positionCount * positionSize + (uint64)indexCount * sizeof(uint16) : (uint64)vertexCount * positionSize;
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--compact]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchmarkMesh> scene(4);
+  scene[0].name = "flat shaded props";
+  scene[0].instanceCount = 500;
+  BuildFlatShadedSphere(3, scene[0]);
+  scene[1].name = "modular pieces";
+  scene[1].instanceCount = 2000;
+  BuildBox(4, scene[1]);
+  scene[2].name = "smooth character";
+  scene[2].instanceCount = 10;
+  BuildTorus(128, scene[2]);
+  scene[3].name = "terrain, 8x8 materials";
+  scene[3].instanceCount = 4;
+  BuildTerrain(256, 8, scene[3]);
+
+  printf("%s vertices, fetched by a depth-only draw: interleaved, position stream, welded positions\n", options.compact ? "Compact" : "Full");
+  PositionStreamBuilder builder;
+  PassMetrics totals;
+  bool passed = true;
+  for (BenchmarkMesh& mesh : scene)
+  {
+    Optimize(mesh);
+    passed = Measure(mesh, options, builder, totals) && passed;
+  }
+
+  printf("\nper depth-only pass, with %.1f KB of 16-bit indices:\n", totals.indexBytes / 1024.0);
+  printf("  interleaved vertices      %10.1f KB\n", totals.interleavedBytes / 1024.0);
+  printf("  position stream           %10.1f KB  %5.1f%% saved\n", totals.streamBytes / 1024.0,
+    100.0 * (1.0 - (double)totals.streamBytes / totals.interleavedBytes));
+  printf("  welded positions          %10.1f KB  %5.1f%% saved\n", totals.weldedBytes / 1024.0,
+    100.0 * (1.0 - (double)totals.weldedBytes / totals.interleavedBytes));
+  printf("  vertex shader invocations %10llu -> %llu welded\n", (unsigned long long)totals.interleavedInvocations,
+    (unsigned long long)totals.weldedInvocations);
+  printf("  memory of the streams     %10.1f KB for one copy of every mesh\n", totals.streamMemory / 1024.0);
+
+  if (!passed)
+    return EXIT_FAILURE;
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,219 @@
+// Memory and upload cost of prefab instances against one mesh per entity, see Core/Scene/Scene.h and Core/Scene/Entity.h
+// The scene renderer runs without a device on the counters of Tools/HeadlessRenderer.h, the heap is measured by the memory tracker.
+//
+// Usage:
+//   PrefabMemoryBenchmark [--instances <count>] [--prefabs <count>] [--edits <count>]
+// The prefabs are triangles of their own colours. The same instances are created twice: once sharing the meshes of their prefabs,
+// and once with a private copy each, like the entities had before prefabs. Each scene is given to a new scene renderer and
+// rendered once. The table shows the meshes, the uploads and the committed GPU memory they took, and the heap held by the
+// scene and the renderer. The prefab scene must upload one mesh per prefab. Then a few instances are edited: each one must get
+// a private mesh and its only upload, and an edit of a private mesh must upload it again in place.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "Graphics/SceneRenderer.h"
+#include "Memory/MemoryTracker.h"
+#include "HeadlessRenderer.h"
+#include "ToolSupport.h"
+
+#ifndef WOH_MEMORY_TRACKING
+#error PrefabMemoryBenchmark needs WOH_MEMORY_TRACKING
+#endif
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 instanceCount = 100000;
+    uint32 prefabCount = 50;
+    uint32 editCount = 10;
+  };
+
+  static constexpr double MegaByte = 1024.0 * 1024.0;
+
+  struct SceneResult
+  {
+    const char* name = "";
+    uint32 meshCount = 0;
+    uint32 residentMeshCount = 0;
+    uint32 uploadCount = 0;
+    uint64 uploadedBytes = 0;
+    uint64 committedBytes = 0;
+    uint64 heapBytes = 0;
+    double milliseconds = 0.0;
+  };
+
+  uint64 GetHeapBytes()
+  {
+    uint64 bytes = 0;
+    for (uint32 tag = 0; tag < (uint32)MemoryTag::Count; ++tag)
+      bytes += MemoryTracker::GetStats((MemoryTag)tag).currentBytes;
+    return bytes;
+  }
+
+  // The scene only gives write access to the mesh of an entity, so the colours are set through an entity holding the only
+  // reference to the new mesh, which is edited in place
+  PrefabHandle CreateColoredPrefab(Scene& scene, const Vec3& color)
+  {
+    const Entity holder = scene.AddTriangle();
+    const MeshHandle mesh = scene.CreateMesh();
+    scene.SetMesh(holder, mesh);
+    Mesh* editedMesh = scene.EditMesh(holder);
+    for (uint32 vertex = 0; vertex < editedMesh->GetVertexCount(); ++vertex)
+      editedMesh->SetVertexColor(vertex, color);
+    const PrefabHandle prefab = scene.CreatePrefab(mesh, EntityType::Primitive);
+    scene.RemoveEntity(holder);
+    return prefab;
+  }
+
+  std::shared_ptr<Scene> CreateScene(const BenchmarkOptions& options, bool privateMeshes, std::vector<Entity>& instances)
+  {
+    std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+    std::vector<PrefabHandle> prefabs;
+    for (uint32 prefab = 0; prefab < options.prefabCount; ++prefab)
+      prefabs.push_back(CreateColoredPrefab(*scene, Vec3((float)prefab / options.prefabCount, 0.5f, 1.0f - (float)prefab / options.prefabCount)));
+
+    instances.clear();
+    for (uint32 instance = 0; instance < options.instanceCount; ++instance)
+    {
+      instances.push_back(scene->Instantiate(prefabs[instance % options.prefabCount]));
+
+      // Copy on write of a shared mesh, the instance ends up with its own copy
+      if (privateMeshes)
+        scene->EditMesh(instances.back());
+    }
+
+    scene->Update(1.0f / 60.0f);
+    return scene;
+  }
+
+  int RenderFrame(SceneRenderer& sceneRenderer)
+  {
+    g_headlessRenderer.drawCount = 0;
+    return sceneRenderer.Render();
+  }
+
+  bool RunScene(const BenchmarkOptions& options, bool privateMeshes, SceneResult& result)
+  {
+    result.name = privateMeshes ? "per entity" : "prefabs";
+    const uint64 heapBytes = GetHeapBytes();
+    const HeadlessRendererCounters counters = g_headlessRenderer;
+
+    SceneRenderer sceneRenderer;
+    if (sceneRenderer.Init(std::make_shared<Renderer>(), 1280, 720, nullptr) != 0)
+    {
+      printf("FAILED: the scene renderer did not initialize\n");
+      return false;
+    }
+
+    std::vector<Entity> instances;
+    std::shared_ptr<Scene> scene = CreateScene(options, privateMeshes, instances);
+    const auto start = ToolClock::now();
+    sceneRenderer.SetScene(scene);
+    bool passed = RenderFrame(sceneRenderer) == 0;
+    result.milliseconds = GetMilliseconds(start);
+
+    result.meshCount = scene->GetMeshCount();
+    result.residentMeshCount = sceneRenderer.GetResidentMeshCount();
+    result.uploadCount = g_headlessRenderer.uploadCount - counters.uploadCount;
+    result.uploadedBytes = g_headlessRenderer.uploadedBytes - counters.uploadedBytes;
+    result.committedBytes = g_headlessRenderer.committedBytes - counters.committedBytes;
+    result.heapBytes = GetHeapBytes() - heapBytes;
+
+    const uint32 expectedMeshCount = privateMeshes ? options.instanceCount : options.prefabCount;
+    if (!passed || sceneRenderer.GetRenderObjectCount() != options.instanceCount || result.residentMeshCount != expectedMeshCount ||
+      result.uploadCount != expectedMeshCount)
+    {
+      printf("FAILED: %s, %u render objects, %u resident meshes and %u uploads for %u instances of %u meshes\n", result.name,
+        sceneRenderer.GetRenderObjectCount(), result.residentMeshCount, result.uploadCount, options.instanceCount, expectedMeshCount);
+      passed = false;
+    }
+
+    // Edits of shared meshes copy them
+    if (passed && !privateMeshes)
+    {
+      const uint32 editCount = std::min(options.editCount, options.instanceCount);
+      const uint32 meshCount = scene->GetMeshCount();
+      uint32 uploadCount = g_headlessRenderer.uploadCount;
+      for (uint32 edit = 0; edit < editCount; ++edit)
+        scene->EditMesh(instances[edit])->SetVertexColor(0, Vec3(1.0f, 1.0f, 1.0f));
+      RenderFrame(sceneRenderer);
+
+      if (scene->GetMeshCount() != meshCount + editCount || sceneRenderer.GetResidentMeshCount() != options.prefabCount + editCount ||
+        g_headlessRenderer.uploadCount - uploadCount != editCount)
+      {
+        printf("FAILED: %u edits made %u meshes, %u resident meshes and %u uploads\n", editCount, scene->GetMeshCount() - meshCount,
+          sceneRenderer.GetResidentMeshCount(), g_headlessRenderer.uploadCount - uploadCount);
+        passed = false;
+      }
+
+      // The private mesh is uploaded again in place, in a later frame since the uploads of a frame are merged
+      uploadCount = g_headlessRenderer.uploadCount;
+      scene->EditMesh(instances[0])->SetVertexColor(1, Vec3(1.0f, 1.0f, 1.0f));
+      RenderFrame(sceneRenderer);
+      if (passed && (scene->GetMeshCount() != meshCount + editCount || g_headlessRenderer.uploadCount - uploadCount != 1))
+      {
+        printf("FAILED: the edit of a private mesh made %u meshes and %u uploads\n", scene->GetMeshCount() - meshCount,
+          g_headlessRenderer.uploadCount - uploadCount);
+        passed = false;
+      }
+    }
+
+    sceneRenderer.UnInit();
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--instances", options.instanceCount);
+    commandLine.Add("--prefabs", options.prefabCount);
+    commandLine.Add("--edits", options.editCount);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    // Every prefab has an instance
+    return options.prefabCount > 0 && options.instanceCount >= options.prefabCount;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--instances n] [--prefabs n, at most the instances] [--edits n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%u instances of %u prefabs\n", options.instanceCount, options.prefabCount);
+  printf("%12s %10s %10s %10s %12s %14s %10s %10s\n", "", "meshes", "resident", "uploads", "upload MB", "committed MB", "heap MB", "ms");
+
+  SceneResult results[2];
+  bool passed = true;
+  for (uint32 privateMeshes = 0; privateMeshes < 2; ++privateMeshes)
+  {
+    SceneResult& result = results[privateMeshes];
+    passed = RunScene(options, privateMeshes == 1, result) && passed;
+    printf("%12s %10u %10u %10u %12.2f %14.2f %10.2f %10.2f\n", result.name, result.meshCount, result.residentMeshCount, result.uploadCount,
+      result.uploadedBytes / MegaByte, result.committedBytes / MegaByte, result.heapBytes / MegaByte, result.milliseconds);
+  }
+
+  const SceneResult& prefabs = results[0];
+  const SceneResult& perEntity = results[1];
+  printf("saved: %.2f MB committed (%.1f%%), %.2f MB uploaded, %.2f MB of heap, %u uploads\n",
+    (perEntity.committedBytes - prefabs.committedBytes) / MegaByte, 100.0 * (perEntity.committedBytes - prefabs.committedBytes) / perEntity.committedBytes,
+    (perEntity.uploadedBytes - prefabs.uploadedBytes) / MegaByte, ((double)perEntity.heapBytes - (double)prefabs.heapBytes) / MegaByte,
+    perEntity.uploadCount - prefabs.uploadCount);
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+// Cost of applying the scene journal to the scene renderer per change, see Core/Scene/SceneJournal.h and Core/Graphics/SceneRenderer.h
+// The scene renderer runs without a device on the counters of Tools/HeadlessRenderer.h.
+//
+// Usage:
+//   SceneSyncBenchmark [--entities <count>] [--changes <count>] [--frames <count>] [--budget <milliseconds>] [--seed <value>]
+// Every frame --changes entities are added and as many random ones are removed, some of them added in the same frame, and a
+// few get a new mesh and colour. The renderer applies the journal of the frame, which must take less than --budget in 95% of
+// the frames, and must end with one render object per entity, one resident mesh per mesh in use and one draw per entity.
+// Then every kind of change is applied alone to measure its cost.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Graphics/SceneRenderer.h"
+#include "HeadlessRenderer.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 entityCount = 10000;
+    uint32 changeCount = 10000;
+    uint32 frameCount = 60;
+    float budgetMilliseconds = 8.0f; // Half of a 60 Hz frame
+    uint32 seed = 1;
+  };
+
+  static constexpr float MaxOverBudgetShare = 0.05f;
+
+  // The renderer state must match the scene after the journal is applied
+  bool CheckRenderer(const SceneRenderer& sceneRenderer, Scene& scene, uint32 aliveCount, const char* when)
+  {
+    std::vector<uint32> usedMeshes;
+    scene.GetWorld().Each<MeshComponent>([&](Entity entity, MeshComponent& mesh) { usedMeshes.push_back(mesh.mesh.index); });
+    std::sort(usedMeshes.begin(), usedMeshes.end());
+    const uint32 usedMeshCount = (uint32)(std::unique(usedMeshes.begin(), usedMeshes.end()) - usedMeshes.begin());
+
+    if (sceneRenderer.GetRenderObjectCount() != aliveCount)
+    {
+      printf("FAILED: %s, %u render objects for %u entities\n", when, sceneRenderer.GetRenderObjectCount(), aliveCount);
+      return false;
+    }
+
+    if (g_headlessRenderer.residentMeshCount != usedMeshCount)
+    {
+      printf("FAILED: %s, %u resident meshes for %u meshes in use\n", when, g_headlessRenderer.residentMeshCount, usedMeshCount);
+      return false;
+    }
+
+    // Every entity is at the origin, in front of the camera
+    if (g_headlessRenderer.drawCount != aliveCount)
+    {
+      printf("FAILED: %s, %u draws for %u entities\n", when, g_headlessRenderer.drawCount, aliveCount);
+      return false;
+    }
+
+    return true;
+  }
+
+  int RenderFrame(SceneRenderer& sceneRenderer)
+  {
+    g_headlessRenderer.drawCount = 0;
+    return sceneRenderer.Render();
+  }
+
+  void RemoveRandom(Scene& scene, std::vector<Entity>& alive, uint32 count, std::mt19937& random)
+  {
+    for (uint32 i = 0; i < count && !alive.empty(); ++i)
+    {
+      const size_t index = random() % alive.size();
+      scene.RemoveEntity(alive[index]);
+      alive[index] = alive.back();
+      alive.pop_back();
+    }
+  }
+
+  // Adds and removes of the size of a streaming world, with a few mesh and colour changes
+  bool RunChurn(SceneRenderer& sceneRenderer, const BenchmarkOptions& options, std::mt19937& random)
+  {
+    std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+    std::vector<Entity> alive;
+    for (uint32 i = 0; i < options.entityCount; ++i)
+      alive.push_back(scene->AddTriangle());
+    sceneRenderer.SetScene(scene);
+    RenderFrame(sceneRenderer);
+
+    const uint32 remeshedCount = std::max(1u, options.changeCount / 100);
+    double addMilliseconds = 0.0;
+    double removeMilliseconds = 0.0;
+    double updateMilliseconds = 0.0;
+    double syncMilliseconds = 0.0;
+    float worstMilliseconds = 0.0f;
+    uint64 changeCount = 0;
+    uint32 overBudgetCount = 0;
+    bool passed = true;
+    for (uint32 frame = 0; frame < options.frameCount && passed; ++frame)
+    {
+      auto start = ToolClock::now();
+      for (uint32 i = 0; i < options.changeCount; ++i)
+        alive.push_back(scene->AddTriangle());
+      addMilliseconds += GetMilliseconds(start);
+
+      start = ToolClock::now();
+      RemoveRandom(*scene, alive, options.changeCount, random);
+      removeMilliseconds += GetMilliseconds(start);
+
+      for (uint32 i = 0; i < remeshedCount && !alive.empty(); ++i)
+      {
+        const Entity entity = alive[random() % alive.size()];
+        scene->SetMesh(entity, scene->CreateMesh());
+        scene->SetColor(entity, Vec4(1.0f, 0.5f, 0.0f, 1.0f));
+      }
+      start = ToolClock::now();
+      scene->Update(1.0f / 60.0f);
+      updateMilliseconds += GetMilliseconds(start);
+
+      if (RenderFrame(sceneRenderer) != 0)
+      {
+        printf("FAILED: frame %u did not render\n", frame);
+        return false;
+      }
+
+      const SceneRenderer::SyncStats& stats = sceneRenderer.GetSyncStats();
+      syncMilliseconds += stats.milliseconds;
+      worstMilliseconds = std::max(worstMilliseconds, stats.milliseconds);
+      changeCount += stats.changeCount;
+      overBudgetCount += stats.milliseconds > options.budgetMilliseconds ? 1 : 0;
+      passed = CheckRenderer(sceneRenderer, *scene, (uint32)alive.size(), "churn");
+    }
+
+    const double frames = options.frameCount;
+    printf("churn: %u adds and %u removes per frame over %zu entities, %.0f changes per frame with the transforms\n", options.changeCount,
+      options.changeCount, alive.size(), changeCount / frames);
+    printf("  scene: add %.3f ms/frame, remove %.3f ms/frame, update %.3f ms/frame\n", addMilliseconds / frames, removeMilliseconds / frames,
+      updateMilliseconds / frames);
+    printf("  sync: %.3f ms/frame, worst %.3f ms, %u frames over %.2f ms, %.4f us per change\n", syncMilliseconds / frames, worstMilliseconds,
+      overBudgetCount, options.budgetMilliseconds, syncMilliseconds * 1000.0 / changeCount);
+
+    // A few frames are let through for the scheduling of the machine
+    if (overBudgetCount > (uint32)(options.frameCount * MaxOverBudgetShare))
+    {
+      printf("FAILED: the sync of %u frames took more than %.2f ms\n", overBudgetCount, options.budgetMilliseconds);
+      passed = false;
+    }
+
+    return passed;
+  }
+
+  // One kind of change at a time on a scene of the same size, the frames between them consume the transforms
+  bool RunChangeKinds(SceneRenderer& sceneRenderer, const BenchmarkOptions& options, std::mt19937& random)
+  {
+    std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+    std::vector<Entity> alive;
+    for (uint32 i = 0; i < options.entityCount; ++i)
+      alive.push_back(scene->AddTriangle());
+    sceneRenderer.SetScene(scene);
+    RenderFrame(sceneRenderer);
+
+    printf("%12s %10s %10s %12s\n", "change", "count", "sync ms", "us/change");
+    bool passed = true;
+    const auto runKind = [&](const char* name, SceneChangeType type, auto&& change)
+    {
+      change();
+      const uint32 count = scene->GetJournal().GetChangeCount(type);
+      const uint32 uploadCount = g_headlessRenderer.uploadCount;
+      if (RenderFrame(sceneRenderer) != 0)
+      {
+        printf("FAILED: %s did not render\n", name);
+        passed = false;
+        return;
+      }
+
+      const SceneRenderer::SyncStats& stats = sceneRenderer.GetSyncStats();
+      printf("%12s %10u %10.3f %12.4f\n", name, count, stats.milliseconds, stats.GetMicrosecondsPerChange());
+      if (type == SceneChangeType::MeshChanged && g_headlessRenderer.uploadCount - uploadCount != count)
+      {
+        printf("FAILED: %u new meshes, %u uploads\n", count, g_headlessRenderer.uploadCount - uploadCount);
+        passed = false;
+      }
+      passed = CheckRenderer(sceneRenderer, *scene, (uint32)alive.size(), name) && passed;
+    };
+
+    runKind("add", SceneChangeType::EntityAdded, [&]()
+    {
+      for (uint32 i = 0; i < options.changeCount; ++i)
+        alive.push_back(scene->AddTriangle());
+    });
+    runKind("remove", SceneChangeType::EntityRemoved, [&]() { RemoveRandom(*scene, alive, options.changeCount, random); });
+    runKind("mesh", SceneChangeType::MeshChanged, [&]()
+    {
+      for (uint32 i = 0; i < std::min(options.changeCount, (uint32)alive.size()); ++i)
+        scene->SetMesh(alive[i], scene->CreateMesh());
+    });
+    runKind("material", SceneChangeType::MaterialChanged, [&]()
+    {
+      for (uint32 i = 0; i < std::min(options.changeCount, (uint32)alive.size()); ++i)
+        scene->SetColor(alive[i], Vec4(0.0f, 0.5f, 1.0f, 1.0f));
+    });
+    runKind("transform", SceneChangeType::TransformChanged, [&]() { scene->Update(1.0f / 60.0f); });
+
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--entities", options.entityCount);
+    commandLine.Add("--changes", options.changeCount);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--budget", options.budgetMilliseconds);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.changeCount > 0 && options.frameCount > 0 && options.budgetMilliseconds > 0.0f;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--entities n] [--changes n] [--frames n] [--budget ms] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(options.seed);
+  SceneRenderer sceneRenderer;
+  if (sceneRenderer.Init(std::make_shared<Renderer>(), 1280, 720, nullptr) != 0)
+  {
+    printf("FAILED: the scene renderer did not initialize\n");
+    return EXIT_FAILURE;
+  }
+
+  bool passed = RunChurn(sceneRenderer, options, random);
+  passed = passed && RunChangeKinds(sceneRenderer, options, random);
+  sceneRenderer.UnInit();
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
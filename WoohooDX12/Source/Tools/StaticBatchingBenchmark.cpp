@@ -0,0 +1,568 @@
+// Draw count and CPU frame time of static batching, see Core/Graphics/Geometry/StaticBatcher.h
+//
+// Usage:
+//   StaticBatchingBenchmark [--props <count>] [--meshes <count>] [--materials <count>] [--extent <meters>] [--hidden <percent>] [--frames <count>]
+// A level of small static props on a square kilometre, each a mesh out of a set of modular pieces (columns with a random
+// number of sides and rings) with its own rotation, scale and colour. A camera walking on the ground looks around, for every
+// frame the CPU work of the draws is timed: frustum culling and one uniform update per draw for the per object path, frustum
+// culling and the instance stream for the instanced path, and for the batched path the culling of the batch bounds, the ranges
+// of the visible pieces and a uniform update per range, the sources left alone are instanced. The batched path is also run
+// with a share of the pieces hidden. The D3D calls are not made. The batches are checked against the sources and their
+// culling against the per object culling.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/InstanceBatcher.h"
+#include "Graphics/Geometry/StaticBatcher.h"
+#include "Scene/Culling/FrustumCulling.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 propCount = 50000;
+    uint32 meshCount = 200;
+    uint32 materialCount = 4;
+    float maxExtent = 32.0f;
+    float hiddenPercent = 5.0f;
+    uint32 frameCount = 20;
+  };
+
+  // Same layout as the uniform buffer of a material, one per draw
+  struct Uniforms
+  {
+    Mat projectionMatrix;
+    Mat viewMatrix;
+    Mat modelMatrix;
+    Vec4 color;
+  };
+  static constexpr uint32 UniformStride = (sizeof(Uniforms) + 255) & ~255;
+
+  struct Vertex
+  {
+    float position[3];
+    float color[3];
+  };
+
+  struct PropMesh
+  {
+    std::vector<Vertex> vertices;
+    std::vector<uint32> indices;
+  };
+
+  struct Prop
+  {
+    uint32 mesh = 0;
+    uint32 material = 0;
+    Mat4x4 world;
+    Vec4 color;
+  };
+
+  // Per frame results of a path
+  struct PathStats
+  {
+    double seconds = 0.0;
+    uint64 drawCount = 0;
+    uint64 triangleCount = 0;
+  };
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--props", options.propCount);
+    commandLine.Add("--meshes", options.meshCount);
+    commandLine.Add("--materials", options.materialCount);
+    commandLine.Add("--extent", options.maxExtent);
+    commandLine.Add("--hidden", options.hiddenPercent);
+    commandLine.Add("--frames", options.frameCount);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.propCount > 0 && options.meshCount > 0 && options.materialCount > 0 && options.maxExtent > 0.0f &&
+      options.hiddenPercent >= 0.0f && options.hiddenPercent <= 100.0f && options.frameCount > 0;
+  }
+
+  // A column of the given sides and rings, capped, about a metre across
+  void BuildColumn(uint32 sides, uint32 rings, float height, std::mt19937& random, PropMesh& mesh)
+  {
+    std::uniform_real_distribution<float> shade(0.5f, 1.0f);
+    for (uint32 ring = 0; ring <= rings; ++ring)
+    {
+      const float y = height * ring / rings;
+      const float radius = 0.5f - 0.2f * ring / rings;
+      const float color = shade(random);
+      for (uint32 side = 0; side < sides; ++side)
+      {
+        const float angle = 2.0f * DirectX::XM_PI * side / sides;
+        mesh.vertices.push_back({ { cosf(angle) * radius, y, sinf(angle) * radius }, { color, color, color } });
+      }
+    }
+
+    for (uint32 ring = 0; ring < rings; ++ring)
+    {
+      for (uint32 side = 0; side < sides; ++side)
+      {
+        const uint32 a = ring * sides + side;
+        const uint32 b = ring * sides + (side + 1) % sides;
+        const uint32 quad[6] = { a, a + sides, b, b, a + sides, b + sides };
+        mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+      }
+    }
+
+    // Fans over the end rings
+    for (uint32 side = 1; side + 1 < sides; ++side)
+    {
+      const uint32 top = rings * sides;
+      const uint32 bottom[3] = { 0, side, side + 1 };
+      const uint32 cap[3] = { top, top + side + 1, top + side };
+      mesh.indices.insert(mesh.indices.end(), bottom, bottom + 3);
+      mesh.indices.insert(mesh.indices.end(), cap, cap + 3);
+    }
+  }
+
+  void TransformPoint(const Mat& world, const float* local, float* result)
+  {
+    Vec3 position;
+    const Vec3 point(local[0], local[1], local[2]);
+    DirectX::XMStoreFloat3(&position, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&point), world));
+    result[0] = position.x;
+    result[1] = position.y;
+    result[2] = position.z;
+  }
+
+  Mat4x4 MakeViewProjection(const Vec3& eye, float yaw)
+  {
+    const DirectX::XMVECTOR position = DirectX::XMVectorSet(eye.x, eye.y, eye.z, 1.0f);
+    const DirectX::XMVECTOR forward = DirectX::XMVectorSet(cosf(yaw), -0.05f, sinf(yaw), 0.0f);
+    const Mat view = DirectX::XMMatrixLookToLH(position, forward, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const Mat projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4 * 1.33f, 16.0f / 9.0f, 0.1f, 300.0f);
+
+    Mat4x4 viewProjection;
+    DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+    return viewProjection;
+  }
+
+  void WriteUniforms(const Mat4x4& modelMatrix, const Vec4& color, const Uniforms& frameUniforms, uint8* uploadMemory, uint32 draw)
+  {
+    Uniforms uniforms = frameUniforms;
+    uniforms.modelMatrix = DirectX::XMLoadFloat4x4(&modelMatrix);
+    uniforms.color = color;
+    memcpy(uploadMemory + (size_t)draw * UniformStride, &uniforms, sizeof(uniforms));
+  }
+
+  // True when the box is behind one of the planes. The sphere of a batch is around the boxes of its sources, a culled batch has
+  // them behind the plane that culled it even where the spheres of the sources cross the plane.
+  bool IsBoxOutside(const Frustum& frustum, const StaticBatchSource& source)
+  {
+    for (const Vec4& plane : frustum.planes)
+    {
+      // Corner furthest along the normal
+      const float x = plane.x >= 0.0f ? source.boundsMax[0] : source.boundsMin[0];
+      const float y = plane.y >= 0.0f ? source.boundsMax[1] : source.boundsMin[1];
+      const float z = plane.z >= 0.0f ? source.boundsMax[2] : source.boundsMin[2];
+      if (plane.x * x + plane.y * y + plane.z * z + plane.w < 1e-3f)
+        return true;
+    }
+
+    return false;
+  }
+
+  // Checks the pieces against their sources, returns false on the first difference
+  bool CheckBatches(const StaticBatcher& batcher, const std::vector<StaticBatchSource>& sources, const BenchmarkOptions& options)
+  {
+    const std::vector<StaticBatchPiece>& pieces = batcher.GetPieces();
+    const std::vector<uint32>& indices = batcher.GetIndices();
+    std::vector<uint32> seen(sources.size(), 0);
+    for (const StaticBatch& batch : batcher.GetBatches())
+    {
+      uint32 indexOffset = 0;
+      uint32 vertexOffset = 0;
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        if (batch.boundsMax[axis] - batch.boundsMin[axis] > options.maxExtent)
+        {
+          printf("FAILED: batch of %u pieces is %.1f m wide\n", batch.pieceCount, batch.boundsMax[axis] - batch.boundsMin[axis]);
+          return false;
+        }
+      }
+
+      if (batch.vertexCount > 65536 || batch.pieceCount < 2)
+      {
+        printf("FAILED: batch of %u vertices and %u pieces\n", batch.vertexCount, batch.pieceCount);
+        return false;
+      }
+
+      for (uint32 i = batch.firstPiece; i < batch.firstPiece + batch.pieceCount; ++i)
+      {
+        const StaticBatchPiece& piece = pieces[i];
+        const StaticBatchSource& source = sources[piece.source];
+        seen[piece.source]++;
+        if (batcher.GetSourcePiece(piece.source) != i || source.material != batch.material || piece.indexOffset != indexOffset ||
+          piece.vertexOffset != vertexOffset || piece.indexCount != source.indexCount)
+        {
+          printf("FAILED: piece %u of source %u is out of place\n", i, piece.source);
+          return false;
+        }
+
+        for (uint32 index = 0; index < source.indexCount; ++index)
+        {
+          if (indices[batch.indexOffset + piece.indexOffset + index] != source.indices[index] + piece.vertexOffset)
+          {
+            printf("FAILED: index %u of source %u\n", index, piece.source);
+            return false;
+          }
+        }
+
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+          if (source.boundsMin[axis] < batch.boundsMin[axis] || source.boundsMax[axis] > batch.boundsMax[axis])
+          {
+            printf("FAILED: source %u is out of its batch's bounds\n", piece.source);
+            return false;
+          }
+        }
+        indexOffset += piece.indexCount;
+        vertexOffset += source.vertexCount;
+      }
+
+      if (indexOffset != batch.indexCount || vertexOffset != batch.vertexCount)
+      {
+        printf("FAILED: pieces do not cover their batch\n");
+        return false;
+      }
+    }
+
+    for (uint32 source = 0; source < (uint32)sources.size(); ++source)
+    {
+      if (seen[source] > 1 || (seen[source] == 0) != (batcher.GetSourcePiece(source) == StaticBatcher::InvalidPiece))
+      {
+        printf("FAILED: source %u is in %u pieces\n", source, seen[source]);
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--props n] [--meshes n] [--materials n] [--extent meters] [--hidden percent] [--frames n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random(1);
+  std::vector<PropMesh> meshes(options.meshCount);
+  for (PropMesh& mesh : meshes)
+  {
+    const uint32 sides = 4 + random() % 13;
+    const uint32 rings = 1 + random() % 4;
+    BuildColumn(sides, rings, 0.5f + (random() % 100) * 0.03f, random, mesh);
+  }
+
+  // Scattered on the ground, the order of creation does not follow the positions
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Prop> props(options.propCount);
+  std::vector<StaticBatchSource> sources(options.propCount);
+  BoundingSphereArray spheres;
+  spheres.Resize(options.propCount);
+  for (uint32 i = 0; i < options.propCount; ++i)
+  {
+    Prop& prop = props[i];
+    prop.mesh = random() % options.meshCount;
+    prop.material = random() % options.materialCount;
+    const Mat world = DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(1.0f, 0.5f + unit(random), 1.0f),
+      DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), unit(random) * 6.28f)),
+      DirectX::XMMatrixTranslation(position(random), 0.0f, position(random)));
+    DirectX::XMStoreFloat4x4(&prop.world, world);
+    prop.color = Vec4(unit(random), unit(random), unit(random), 1.0f);
+
+    // World box of the vertices, the culling sphere is around it so a sphere in the frustum has its batch in it
+    const PropMesh& mesh = meshes[prop.mesh];
+    StaticBatchSource& source = sources[i];
+    for (uint32 vertex = 0; vertex < (uint32)mesh.vertices.size(); ++vertex)
+    {
+      float point[3];
+      TransformPoint(world, mesh.vertices[vertex].position, point);
+      for (uint32 axis = 0; axis < 3; ++axis)
+      {
+        source.boundsMin[axis] = vertex == 0 ? point[axis] : std::min(source.boundsMin[axis], point[axis]);
+        source.boundsMax[axis] = vertex == 0 ? point[axis] : std::max(source.boundsMax[axis], point[axis]);
+      }
+    }
+    source.material = prop.material;
+    source.vertexCount = (uint32)mesh.vertices.size();
+    source.indices = mesh.indices.data();
+    source.indexCount = (uint32)mesh.indices.size();
+
+    float radiusSquared = 0.0f;
+    for (uint32 axis = 0; axis < 3; ++axis)
+      radiusSquared += (source.boundsMax[axis] - source.boundsMin[axis]) * (source.boundsMax[axis] - source.boundsMin[axis]) * 0.25f;
+    spheres.Set(i, Vec3((source.boundsMin[0] + source.boundsMax[0]) * 0.5f, (source.boundsMin[1] + source.boundsMax[1]) * 0.5f,
+      (source.boundsMin[2] + source.boundsMax[2]) * 0.5f), sqrtf(radiusSquared));
+  }
+
+  // Load time: batching and the copy of the vertices in world space
+  StaticBatchOptions batchOptions;
+  batchOptions.maxExtent = options.maxExtent;
+  StaticBatcher staticBatcher;
+  std::vector<std::vector<Vertex>> batchVertices;
+  const auto loadStart = ToolClock::now();
+  staticBatcher.Build(sources.data(), options.propCount, batchOptions);
+  const std::vector<StaticBatch>& batches = staticBatcher.GetBatches();
+  const std::vector<StaticBatchPiece>& pieces = staticBatcher.GetPieces();
+  batchVertices.resize(batches.size());
+  for (uint32 batch = 0; batch < (uint32)batches.size(); ++batch)
+  {
+    batchVertices[batch].resize(batches[batch].vertexCount);
+    for (uint32 piece = batches[batch].firstPiece; piece < batches[batch].firstPiece + batches[batch].pieceCount; ++piece)
+    {
+      const Prop& prop = props[pieces[piece].source];
+      const Mat world = DirectX::XMLoadFloat4x4(&prop.world);
+      const PropMesh& mesh = meshes[prop.mesh];
+      for (uint32 vertex = 0; vertex < (uint32)mesh.vertices.size(); ++vertex)
+      {
+        Vertex& batchVertex = batchVertices[batch][pieces[piece].vertexOffset + vertex];
+        TransformPoint(world, mesh.vertices[vertex].position, batchVertex.position);
+        batchVertex.color[0] = mesh.vertices[vertex].color[0] * prop.color.x;
+        batchVertex.color[1] = mesh.vertices[vertex].color[1] * prop.color.y;
+        batchVertex.color[2] = mesh.vertices[vertex].color[2] * prop.color.z;
+      }
+    }
+  }
+  const double loadMilliseconds = GetMilliseconds(loadStart);
+
+  if (!CheckBatches(staticBatcher, sources, options))
+    return EXIT_FAILURE;
+
+  // The sources left alone are drawn like before
+  std::vector<uint32> leftAlone;
+  BoundingSphereArray leftAloneSpheres;
+  for (uint32 i = 0; i < options.propCount; ++i)
+  {
+    if (staticBatcher.GetSourcePiece(i) == StaticBatcher::InvalidPiece)
+      leftAlone.push_back(i);
+  }
+  leftAloneSpheres.Resize((uint32)leftAlone.size());
+  for (uint32 i = 0; i < (uint32)leftAlone.size(); ++i)
+  {
+    const uint32 prop = leftAlone[i];
+    leftAloneSpheres.Set(i, Vec3(spheres.centerX[prop], spheres.centerY[prop], spheres.centerZ[prop]), spheres.radius[prop]);
+  }
+
+  BoundingSphereArray batchSpheres;
+  batchSpheres.Resize((uint32)batches.size());
+  uint64 batchBytes = 0;
+  uint32 maxPieceCount = 0;
+  for (uint32 batch = 0; batch < (uint32)batches.size(); ++batch)
+  {
+    const StaticBatch& staticBatch = batches[batch];
+    batchSpheres.Set(batch, Vec3(staticBatch.center[0], staticBatch.center[1], staticBatch.center[2]), staticBatch.radius);
+    batchBytes += (uint64)staticBatch.vertexCount * sizeof(Vertex) + (uint64)staticBatch.indexCount * sizeof(uint16);
+    maxPieceCount = std::max(maxPieceCount, staticBatch.pieceCount);
+  }
+  uint64 meshBytes = 0;
+  for (const PropMesh& mesh : meshes)
+    meshBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint16);
+
+  // Hidden pieces, and the same share of the props for the per object paths so they draw the same objects
+  std::vector<uint8> hidden(options.propCount, 0);
+  for (uint32 i = 0; i < options.propCount; ++i)
+    hidden[i] = unit(random) * 100.0f < options.hiddenPercent ? 1 : 0;
+
+  // Only their addresses are used, they stand in for the meshes and materials of the scene
+  std::vector<uint64> slots(options.meshCount + options.materialCount);
+  std::vector<Mesh*> meshPointers(options.meshCount);
+  std::vector<Material*> materialPointers(options.materialCount);
+  for (uint32 i = 0; i < options.meshCount; ++i)
+    meshPointers[i] = reinterpret_cast<Mesh*>(&slots[i]);
+  for (uint32 i = 0; i < options.materialCount; ++i)
+    materialPointers[i] = reinterpret_cast<Material*>(&slots[options.meshCount + i]);
+
+  printf("%u props, %u meshes, %u materials, %u frames\n", options.propCount, options.meshCount, options.materialCount, options.frameCount);
+  printf("  %u batches of %.1f props on average (largest %u), %u props left alone, built in %.1f ms\n", (uint32)batches.size(),
+    batches.empty() ? 0.0 : (double)pieces.size() / batches.size(), maxPieceCount, (uint32)leftAlone.size(), loadMilliseconds);
+  printf("  batch geometry %.1f MiB against %.2f MiB of shared meshes\n", batchBytes / 1048576.0, meshBytes / 1048576.0);
+
+  std::vector<uint32> visibleIndices(std::max<uint32>(options.propCount, 1));
+  std::vector<uint32> visibleBatches(std::max<uint32>((uint32)batches.size(), 1));
+  std::vector<DrawItem> drawList;
+  drawList.reserve(options.propCount);
+  std::vector<uint8> uploadMemory((size_t)options.propCount * UniformStride);
+  std::vector<IndexChunk> ranges((maxPieceCount + 1) / 2);
+  InstanceBatcher instanceBatcher;
+  Mat4x4 identity;
+  MakeIdentity(identity);
+  const Vec4 white(1.0f, 1.0f, 1.0f, 1.0f); // The colours of the pieces are in the batch vertices
+
+  PathStats perObject;
+  PathStats instanced;
+  PathStats batched[2]; // All pieces, then with the hidden ones
+  for (uint32 frame = 0; frame < options.frameCount; ++frame)
+  {
+    const Vec3 eye(position(random) * 0.8f, 1.7f, position(random) * 0.8f);
+    const Mat4x4 viewProjection = MakeViewProjection(eye, unit(random) * 6.28f);
+    const Frustum frustum = Frustum::FromViewProjection(viewProjection);
+    Uniforms frameUniforms;
+    frameUniforms.viewMatrix = DirectX::XMLoadFloat4x4(&viewProjection);
+    frameUniforms.projectionMatrix = DirectX::XMLoadFloat4x4(&identity);
+
+    // Per object
+    auto start = ToolClock::now();
+    uint32 visibleCount = FrustumCuller::CullRange(frustum, spheres, 0, options.propCount, visibleIndices.data());
+    drawList.clear();
+    for (uint32 i = 0; i < visibleCount; ++i)
+    {
+      const uint32 index = visibleIndices[i];
+      const Prop& prop = props[index];
+      if (!hidden[index])
+        drawList.push_back({ meshPointers[prop.mesh], materialPointers[prop.material], &prop.world, prop.color,
+          InstanceBatcher::MakeSortKey(prop.material, prop.mesh), index });
+    }
+    InstanceBatcher::SortDraws(drawList.data(), (uint32)drawList.size());
+    for (uint32 i = 0; i < (uint32)drawList.size(); ++i)
+      WriteUniforms(*drawList[i].modelMatrix, drawList[i].color, frameUniforms, uploadMemory.data(), i);
+    perObject.seconds += GetSeconds(start);
+    perObject.drawCount += drawList.size();
+    for (const DrawItem& draw : drawList)
+      perObject.triangleCount += sources[draw.object].indexCount / 3;
+
+    // Keeps the visible props of the frame for the conservative check of the batches
+    std::vector<uint8> visibleProps(options.propCount, 0);
+    for (const DrawItem& draw : drawList)
+      visibleProps[draw.object] = 1;
+
+    // Instanced
+    start = ToolClock::now();
+    visibleCount = FrustumCuller::CullRange(frustum, spheres, 0, options.propCount, visibleIndices.data());
+    drawList.clear();
+    for (uint32 i = 0; i < visibleCount; ++i)
+    {
+      const uint32 index = visibleIndices[i];
+      const Prop& prop = props[index];
+      if (!hidden[index])
+        drawList.push_back({ meshPointers[prop.mesh], materialPointers[prop.material], &prop.world, prop.color,
+          InstanceBatcher::MakeSortKey(prop.material, prop.mesh), index });
+    }
+    instanceBatcher.Build(drawList.data(), (uint32)drawList.size());
+    for (const DrawRun& run : instanceBatcher.GetRuns())
+      memcpy(uploadMemory.data() + (size_t)run.firstInstance * sizeof(InstanceData), instanceBatcher.GetInstances() + run.firstInstance,
+        run.instanceCount * sizeof(InstanceData));
+    instanced.seconds += GetSeconds(start);
+    instanced.drawCount += instanceBatcher.GetRuns().size();
+    for (const DrawItem& draw : drawList)
+      instanced.triangleCount += sources[draw.object].indexCount / 3;
+
+    // Batched, without then with the hidden pieces
+    for (uint32 pass = 0; pass < 2; ++pass)
+    {
+      const bool hide = pass == 1;
+      PathStats& stats = batched[pass];
+      start = ToolClock::now();
+      uint32 drawCount = 0;
+      const uint32 visibleBatchCount = FrustumCuller::CullRange(frustum, batchSpheres, 0, (uint32)batches.size(), visibleBatches.data());
+      for (uint32 i = 0; i < visibleBatchCount; ++i)
+      {
+        const StaticBatch& batch = batches[visibleBatches[i]];
+        const uint32 rangeCount = StaticBatcher::GetVisibleRanges(batch,
+          [&](uint32 piece) { return !hide || !hidden[pieces[piece].source]; }, pieces.data(), ranges.data());
+        for (uint32 range = 0; range < rangeCount; ++range)
+        {
+          WriteUniforms(identity, white, frameUniforms, uploadMemory.data(), drawCount++);
+          stats.triangleCount += ranges[range].indexCount / 3;
+        }
+      }
+
+      const uint32 leftAloneVisibleCount = FrustumCuller::CullRange(frustum, leftAloneSpheres, 0, (uint32)leftAlone.size(), visibleIndices.data());
+      drawList.clear();
+      for (uint32 i = 0; i < leftAloneVisibleCount; ++i)
+      {
+        const uint32 index = leftAlone[visibleIndices[i]];
+        const Prop& prop = props[index];
+        if (!hide || !hidden[index])
+          drawList.push_back({ meshPointers[prop.mesh], materialPointers[prop.material], &prop.world, prop.color,
+            InstanceBatcher::MakeSortKey(prop.material, prop.mesh), index });
+      }
+      instanceBatcher.Build(drawList.data(), (uint32)drawList.size());
+      for (const DrawRun& run : instanceBatcher.GetRuns())
+        memcpy(uploadMemory.data() + (size_t)run.firstInstance * sizeof(InstanceData), instanceBatcher.GetInstances() + run.firstInstance,
+          run.instanceCount * sizeof(InstanceData));
+      drawCount += (uint32)instanceBatcher.GetRuns().size();
+      stats.seconds += GetSeconds(start);
+      stats.drawCount += drawCount;
+      for (const DrawItem& draw : drawList)
+        stats.triangleCount += sources[draw.object].indexCount / 3;
+
+      // Every prop the per object path draws is in a drawn range unless its box is outside, without hidden pieces a visible
+      // batch is one range
+      std::vector<uint8> drawnPieces(pieces.size(), 0);
+      for (uint32 i = 0; i < visibleBatchCount; ++i)
+      {
+        const StaticBatch& batch = batches[visibleBatches[i]];
+        const uint32 rangeCount = StaticBatcher::GetVisibleRanges(batch,
+          [&](uint32 piece) { return !hide || !hidden[pieces[piece].source]; }, pieces.data(), ranges.data());
+        if (!hide && rangeCount != 1)
+        {
+          printf("FAILED: batch %u is %u ranges without hidden pieces\n", visibleBatches[i], rangeCount);
+          return EXIT_FAILURE;
+        }
+
+        for (uint32 range = 0; range < rangeCount; ++range)
+        {
+          for (uint32 piece = batch.firstPiece; piece < batch.firstPiece + batch.pieceCount; ++piece)
+          {
+            if (pieces[piece].indexOffset >= ranges[range].indexOffset &&
+              pieces[piece].indexOffset + pieces[piece].indexCount <= ranges[range].indexOffset + ranges[range].indexCount)
+              drawnPieces[piece] = 1;
+          }
+        }
+      }
+
+      // The props left alone are drawn like on the instanced path
+      for (uint32 prop = 0; prop < options.propCount; ++prop)
+      {
+        const uint32 piece = staticBatcher.GetSourcePiece(prop);
+        if (piece == StaticBatcher::InvalidPiece)
+          continue;
+
+        const bool drawn = drawnPieces[piece] != 0;
+        if ((visibleProps[prop] && !drawn && !IsBoxOutside(frustum, sources[prop])) || (hide && hidden[prop] && drawn))
+        {
+          printf("FAILED: prop %u is %s by the batches\n", prop, drawn ? "drawn though hidden" : "not drawn though visible");
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  const auto report = [&](const char* name, const PathStats& stats)
+  {
+    printf("  %-20s %8.1f draws, %7.1fk triangles, %7.3f ms/frame\n", name, (double)stats.drawCount / options.frameCount,
+      stats.triangleCount / 1000.0 / options.frameCount, stats.seconds * 1000.0 / options.frameCount);
+  };
+  report("per object:", perObject);
+  report("instanced:", instanced);
+  report("batched:", batched[0]);
+  char hiddenName[64];
+  snprintf(hiddenName, sizeof(hiddenName), "batched, %.0f%% hidden:", options.hiddenPercent);
+  report(hiddenName, batched[1]);
+  printf("  batched: %.1fx fewer draws than per object, %.1fx fewer than instanced, CPU %.1fx faster than per object, %.1fx than instanced\n",
+    (double)perObject.drawCount / std::max<uint64>(batched[1].drawCount, 1), (double)instanced.drawCount / std::max<uint64>(batched[1].drawCount, 1),
+    perObject.seconds / batched[1].seconds, instanced.seconds / batched[1].seconds);
+  printf("All checks passed\n");
+
+  return EXIT_SUCCESS;
+}
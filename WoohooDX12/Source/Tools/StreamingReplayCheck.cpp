@@ -0,0 +1,155 @@
+// Replays camera paths against the world partition streaming policy, see Core/Scene/Streaming/StreamingReplay.h
+//
+// Usage:
+//   StreamingReplayCheck [--seed <value>]
+// The cell sizes are random, the path crosses the grid fast then circles slowly. Every replay checks that the peak memory stays in the budget, that
+// at most 1 load in 20 is late and that a camera standing still loads and unloads nothing.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Scene/Streaming/StreamingReplay.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  static constexpr uint64 MegaByte = 1024ull * 1024;
+
+  static constexpr uint32 GridSize = 64; // Cells of 64 m per side
+  static constexpr uint32 MaxLateLoadRatio = 20; // One late load per this many loads
+
+  struct CheckOptions
+  {
+    uint32 seed = 1;
+  };
+
+  // Cells of 4 to 15 MB
+  void InitPartition(WorldPartition& partition, const WorldPartitionSettings& settings, uint32 seed)
+  {
+    partition.Init(settings, ZeroVector, GridSize, GridSize);
+
+    std::mt19937 random(seed);
+    for (uint32 cell = 0; cell < partition.GetCellCount(); ++cell)
+    {
+      CellManifest manifest;
+      manifest.memorySize = (4 + random() % 12) * MegaByte;
+      partition.SetCellManifest(cell, std::move(manifest));
+    }
+  }
+
+  // 20 s of a straight run at about 320 m/s that leaves the 4 km grid, then a slow circle in the middle of it
+  std::vector<Vec3> MakeCameraPath()
+  {
+    std::vector<Vec3> path;
+    for (uint32 frame = 0; frame < 1200; ++frame)
+      path.push_back(Vec3(200.0f + frame * 5.0f, 0.0f, 300.0f + frame * 2.0f));
+
+    for (uint32 frame = 0; frame < 1200; ++frame)
+    {
+      const float angle = frame * 0.005f;
+      path.push_back(Vec3(2900.0f + 300.0f * cosf(angle), 0.0f, 1500.0f + 300.0f * sinf(angle)));
+    }
+
+    return path;
+  }
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--seed", options.seed);
+    return commandLine.Parse(argc, argv);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<Vec3> path = MakeCameraPath();
+  printf("%ux%u cells, %u frames\n", GridSize, GridSize, (uint32)path.size());
+  printf("%10s %10s %10s %10s %8s %8s %10s %10s %12s\n", "MB/frame", "look-ahead", "budget MB", "peak MB", "loads", "unloads", "evictions",
+    "late loads", "late frames");
+
+  bool passed = true;
+  for (uint64 bandwidth : { 8ull, 2ull })
+  {
+    for (uint64 budget : { 2048ull, 640ull, 400ull })
+    {
+      for (uint32 lookAhead = 0; lookAhead < 2; ++lookAhead)
+      {
+        WorldPartitionSettings settings;
+        settings.velocityLookAhead = lookAhead ? 2.0f : 0.0f;
+        settings.memoryBudget = budget * MegaByte;
+
+        WorldPartition partition;
+        InitPartition(partition, settings, options.seed);
+
+        StreamingReplaySettings replay;
+        replay.loadBytesPerFrame = bandwidth * MegaByte;
+        const StreamingStats stats = ReplayCameraPath(partition, path.data(), (uint32)path.size(), replay);
+
+        printf("%10llu %9.0fs %10llu %10.1f %8u %8u %10u %10u %12u\n", (unsigned long long)bandwidth, settings.velocityLookAhead,
+          (unsigned long long)budget, (double)stats.peakMemory / MegaByte, stats.loadCount, stats.unloadCount, stats.evictionCount,
+          stats.lateLoadCount, stats.lateCellFrames);
+
+        if (stats.peakMemory > settings.memoryBudget)
+        {
+          printf("FAILED: peak memory over the budget\n");
+          passed = false;
+        }
+
+        if (stats.lateLoadCount * MaxLateLoadRatio > stats.loadCount)
+        {
+          printf("FAILED: too many late loads\n");
+          passed = false;
+        }
+
+        // The pending loads finish in the first still replay, the second one must not change anything
+        const std::vector<Vec3> still(300, path.back());
+        const StreamingStats settled = ReplayCameraPath(partition, still.data(), (uint32)still.size(), replay);
+        const StreamingStats stillStats = ReplayCameraPath(partition, still.data(), (uint32)still.size(), replay);
+        if (stillStats.loadCount != settled.loadCount || stillStats.unloadCount != settled.unloadCount)
+        {
+          printf("FAILED: cells streamed while the camera stood still\n");
+          passed = false;
+        }
+      }
+    }
+  }
+
+  // A camera pacing across a cell border stays inside the hysteresis
+  {
+    WorldPartitionSettings settings;
+    WorldPartition partition;
+    InitPartition(partition, settings, options.seed + 1);
+
+    const Vec3 border = partition.GetCellCenter(partition.GetCellIndex(GridSize / 2, GridSize / 2));
+    const float halfCell = settings.cellSize * 0.5f;
+    std::vector<Vec3> pacing;
+    for (uint32 frame = 0; frame < 600; ++frame)
+      pacing.push_back(Vec3(border.x + halfCell + ((frame / 10) % 2 ? 30.0f : -30.0f), 0.0f, border.z));
+
+    const StreamingStats stats = ReplayCameraPath(partition, pacing.data(), (uint32)pacing.size(), StreamingReplaySettings());
+    printf("Pacing across a cell border: %u loads, %u unloads\n", stats.loadCount, stats.unloadCount);
+    if (stats.unloadCount != 0)
+    {
+      printf("FAILED: cells unloaded while pacing across a border\n");
+      passed = false;
+    }
+  }
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+// Speedup of the parallel system scheduler over a dozen synthetic systems, see Core/Scene/ECS/SystemScheduler.h
+//
+// Usage:
+//   SystemSchedulerBenchmark [--entities <count>] [--work <iterations>] [--frames <count>] [--workers <count>]
+// Twelve systems read and write eight components with chains and independent branches between them, over entities in three
+// archetypes. The frames run serially on the calling thread, then with job systems of 1 worker up to --workers (default one per
+// hardware thread). The systems that conflict must run in registration order, so every parallel run must end with the same
+// component values as the serial one, bit for bit.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Scene/ECS/SystemScheduler.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 entityCount = 200000;
+    uint32 workIterations = 8;
+    uint32 frameCount = 20;
+    uint32 maxWorkerCount = 0; // 0 is one per hardware thread
+  };
+
+  static constexpr uint32 ValueCount = 8;
+
+  template<uint32 N>
+  struct Value
+  {
+    float v;
+  };
+
+  struct SyntheticSystem
+  {
+    const char* name;
+    uint32 reads[2];
+    uint32 readCount;
+    uint32 write;
+  };
+
+  // Three independent branches from value 0, joins, and writers of values read before them
+  static const SyntheticSystem systems[] =
+  {
+    { "0 to 1", { 0 }, 1, 1 },
+    { "0 to 2", { 0 }, 1, 2 },
+    { "0 to 3", { 0 }, 1, 3 },
+    { "1 to 4", { 1 }, 1, 4 },
+    { "2 to 5", { 2 }, 1, 5 },
+    { "3 to 6", { 3 }, 1, 6 },
+    { "1 2 to 7", { 1, 2 }, 2, 7 },
+    { "4 5 to 0", { 4, 5 }, 2, 0 },
+    { "6 to 3", { 6 }, 1, 3 },
+    { "7 to 2", { 7 }, 1, 2 },
+    { "4 to 5", { 4 }, 1, 5 },
+    { "0 6 to 4", { 0, 6 }, 2, 4 }
+  };
+
+  uint32 g_valueIds[ValueCount];
+
+  template<uint32... Ns>
+  void RegisterValues(std::integer_sequence<uint32, Ns...>)
+  {
+    ((g_valueIds[Ns] = GetComponentId<Value<Ns>>()), ...);
+  }
+
+  ComponentMask GetValueMask(uint32 value)
+  {
+    return ComponentMask(1) << g_valueIds[value];
+  }
+
+  void CreateEntities(EntityWorld& world, uint32 entityCount)
+  {
+    for (uint32 i = 0; i < entityCount; ++i)
+    {
+      const float seed = (float)(i % 1000) * 0.001f;
+      if (i % 3 == 0)
+        world.Create(Value<0>{ seed }, Value<1>{ 1 }, Value<2>{ 2 }, Value<3>{ 3 }, Value<4>{ 4 }, Value<5>{ 5 }, Value<6>{ 6 }, Value<7>{ 7 });
+      else if (i % 3 == 1)
+        world.Create(Value<0>{ seed }, Value<1>{ 1 }, Value<2>{ 2 }, Value<3>{ 3 }, Value<4>{ 4 }, Value<5>{ 5 });
+      else
+        world.Create(Value<0>{ seed }, Value<1>{ 1 }, Value<2>{ 2 }, Value<3>{ 3 }, Value<6>{ 6 }, Value<7>{ 7 });
+    }
+  }
+
+  void AddSystems(SystemScheduler& scheduler, uint32 workIterations)
+  {
+    for (const SyntheticSystem& system : systems)
+    {
+      SystemDesc desc;
+      desc.name = system.name;
+      for (uint32 read = 0; read < system.readCount; ++read)
+        desc.reads |= GetValueMask(system.reads[read]);
+      desc.writes = GetValueMask(system.write);
+      desc.update = [&system, workIterations](ChunkView& chunk, float deltaTime)
+      {
+        const float* first = reinterpret_cast<const float*>(chunk.archetype->GetComponentArray(chunk.data, g_valueIds[system.reads[0]]));
+        const float* second = system.readCount > 1 ?
+          reinterpret_cast<const float*>(chunk.archetype->GetComponentArray(chunk.data, g_valueIds[system.reads[1]])) : first;
+        float* output = reinterpret_cast<float*>(chunk.archetype->GetComponentArray(chunk.data, g_valueIds[system.write]));
+        for (uint32 i = 0; i < chunk.count; ++i)
+        {
+          float value = output[i];
+          for (uint32 iteration = 0; iteration < workIterations; ++iteration)
+            value = value * 0.5f + sqrtf(fabsf(first[i] + second[i] * deltaTime + (float)iteration));
+          output[i] = value;
+        }
+      };
+      scheduler.AddSystem(desc);
+    }
+  }
+
+  double RunFrames(EntityWorld& world, SystemScheduler& scheduler, uint32 frameCount)
+  {
+    const auto start = ToolClock::now();
+    for (uint32 frame = 0; frame < frameCount; ++frame)
+      scheduler.Run(world, 1.0f / 60.0f);
+    return GetMilliseconds(start) / frameCount;
+  }
+
+  // Values of every entity in creation order, a float that differs in any bit fails the comparison
+  void GetValues(EntityWorld& world, std::vector<float>& values)
+  {
+    values.clear();
+    world.EachChunk(0, [&](ChunkView& chunk)
+    {
+      for (uint32 value = 0; value < ValueCount; ++value)
+      {
+        if (!chunk.archetype->Has(g_valueIds[value]))
+          continue;
+
+        const float* data = reinterpret_cast<const float*>(chunk.archetype->GetComponentArray(chunk.data, g_valueIds[value]));
+        values.insert(values.end(), data, data + chunk.count);
+      }
+    });
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--entities", options.entityCount);
+    commandLine.Add("--work", options.workIterations);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--workers", options.maxWorkerCount);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.entityCount > 0 && options.frameCount > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--entities n] [--work iterations] [--frames n] [--workers n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (options.maxWorkerCount == 0)
+    options.maxWorkerCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+
+  RegisterValues(std::make_integer_sequence<uint32, ValueCount>());
+
+  std::vector<float> serialValues;
+  double serialMilliseconds = 0.0;
+  {
+    EntityWorld world;
+    CreateEntities(world, options.entityCount);
+    SystemScheduler scheduler;
+    AddSystems(scheduler, options.workIterations);
+    serialMilliseconds = RunFrames(world, scheduler, options.frameCount);
+    GetValues(world, serialValues);
+    printf("%u entities, %u archetypes, %u systems, %u frames, %u hardware threads\n", world.GetEntityCount(), world.GetArchetypeCount(),
+      scheduler.GetSystemCount(), options.frameCount, std::thread::hardware_concurrency());
+  }
+
+  printf("%10s %12s %10s\n", "workers", "ms/frame", "speedup");
+  printf("%10s %12.3f %10.2f\n", "serial", serialMilliseconds, 1.0);
+
+  bool passed = true;
+  // Powers of two and the largest count
+  std::vector<uint32> workerCounts;
+  for (uint32 workerCount = 1; workerCount < options.maxWorkerCount; workerCount *= 2)
+    workerCounts.push_back(workerCount);
+  workerCounts.push_back(options.maxWorkerCount);
+
+  std::vector<float> values;
+  for (uint32 workerCount : workerCounts)
+  {
+    EntityWorld world;
+    CreateEntities(world, options.entityCount);
+    SystemScheduler scheduler;
+    AddSystems(scheduler, options.workIterations);
+    scheduler.SetJobSystem(std::make_shared<JobSystem>(workerCount));
+    const double milliseconds = RunFrames(world, scheduler, options.frameCount);
+    printf("%10u %12.3f %10.2f\n", workerCount, milliseconds, serialMilliseconds / milliseconds);
+
+    GetValues(world, values);
+    if (values.size() != serialValues.size() || memcmp(values.data(), serialValues.data(), values.size() * sizeof(float)) != 0)
+    {
+      printf("FAILED: %u workers did not end with the values of the serial run\n", workerCount);
+      passed = false;
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
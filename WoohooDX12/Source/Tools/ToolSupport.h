@@ -0,0 +1,131 @@
+#pragma once
+
+// Command line and timing shared by the tools, see CMakeLists.txt for their build
+// It has no dependency beyond the standard library so the tools without DirectXMath can include it too.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace WoohooDX12
+{
+  typedef std::chrono::high_resolution_clock ToolClock;
+
+  inline double GetSeconds(ToolClock::time_point start)
+  {
+    return std::chrono::duration<double>(ToolClock::now() - start).count();
+  }
+
+  inline double GetMilliseconds(ToolClock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(ToolClock::now() - start).count();
+  }
+
+  // Options are "--name <value>" pairs or flags, the arguments not starting with '-' are positional.
+  // The values keep their defaults when an option is not given, the tools validate them after Parse.
+  class CommandLine
+  {
+  public:
+    void Add(const char* name, uint32_t& value)
+    {
+      Option& option = AddOption(name);
+      option.uintValue = &value;
+    }
+
+    void Add(const char* name, float& value)
+    {
+      Option& option = AddOption(name);
+      option.floatValue = &value;
+    }
+
+    void Add(const char* name, std::string& value)
+    {
+      Option& option = AddOption(name);
+      option.stringValue = &value;
+    }
+
+    // The flag sets value to state
+    void AddFlag(const char* name, bool& value, bool state = true)
+    {
+      Option& option = AddOption(name);
+      option.flag = &value;
+      option.flagState = state;
+    }
+
+    // Without it a positional argument fails the parse
+    void AddPositional(std::vector<std::string>& values)
+    {
+      m_positional = &values;
+    }
+
+    // False on an unknown option, an option without its value or an unexpected positional argument
+    bool Parse(int argc, char** argv) const
+    {
+      for (int i = 1; i < argc; ++i)
+      {
+        const std::string argument = argv[i];
+        if (argument[0] != '-')
+        {
+          if (m_positional == nullptr)
+            return false;
+          m_positional->push_back(argument);
+          continue;
+        }
+
+        const Option* option = FindOption(argument);
+        if (option == nullptr)
+          return false;
+
+        if (option->flag != nullptr)
+        {
+          *option->flag = option->flagState;
+          continue;
+        }
+
+        if (i + 1 >= argc)
+          return false;
+
+        const char* value = argv[++i];
+        if (option->uintValue != nullptr)
+          *option->uintValue = (uint32_t)atoi(value);
+        else if (option->floatValue != nullptr)
+          *option->floatValue = (float)atof(value);
+        else
+          *option->stringValue = value;
+      }
+
+      return true;
+    }
+
+  private:
+    struct Option
+    {
+      std::string name;
+      uint32_t* uintValue = nullptr;
+      float* floatValue = nullptr;
+      std::string* stringValue = nullptr;
+      bool* flag = nullptr;
+      bool flagState = true;
+    };
+
+    Option& AddOption(const char* name)
+    {
+      m_options.emplace_back();
+      m_options.back().name = name;
+      return m_options.back();
+    }
+
+    const Option* FindOption(const std::string& name) const
+    {
+      for (const Option& option : m_options)
+        if (option.name == name)
+          return &option;
+      return nullptr;
+    }
+
+    std::vector<Option> m_options;
+    std::vector<std::string>* m_positional = nullptr;
+  };
+}
@@ -0,0 +1,227 @@
+// Update time of the transform hierarchy on deep and wide trees, see Core/Scene/TransformHierarchy.h
+//
+// Usage:
+//   TransformHierarchyBenchmark [--nodes <count>] [--frames <count>] [--workers <count>] [--seed <value>]
+// The wide tree is a root with 100 groups sharing the nodes, the deep tree is chains of 100 nodes. Every frame moves 1% or
+// all of the nodes, then the world matrices are updated by a tree of node objects recomputed recursively, like a scene graph
+// without dirty flags, and by the hierarchy on the calling thread and over the job system. The world matrices of the
+// hierarchy are compared with the ones of the node tree after every frame.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Maths.h"
+#include "Jobs/JobSystem.h"
+#include "Scene/TransformHierarchy.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    uint32 nodeCount = 100000;
+    uint32 frameCount = 10;
+    uint32 workerCount = 0; // 0 is one per hardware thread except the calling one
+    uint32 seed = 1;
+  };
+
+  static constexpr uint32 WideGroupCount = 100;
+  static constexpr uint32 ChainDepth = 100;
+  static constexpr float Tolerance = 1e-3f;
+
+  // A scene graph node as an object on the heap, every world matrix is recomputed every frame
+  struct SceneNode
+  {
+    Vec3 position = ZeroVector;
+    Vec4 rotation = Vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    Vec3 scale = Vec3(1.0f, 1.0f, 1.0f);
+    Mat4x4 world;
+    std::vector<std::unique_ptr<SceneNode>> children;
+  };
+
+  void UpdateSceneNode(SceneNode& node, const Mat* parentWorld)
+  {
+    Mat world = DirectX::XMMatrixAffineTransformation(DirectX::XMLoadFloat3(&node.scale), DirectX::XMVectorZero(),
+      DirectX::XMLoadFloat4(&node.rotation), DirectX::XMLoadFloat3(&node.position));
+    if (parentWorld != nullptr)
+      world = DirectX::XMMatrixMultiply(world, *parentWorld);
+    DirectX::XMStoreFloat4x4(&node.world, world);
+
+    for (const std::unique_ptr<SceneNode>& child : node.children)
+      UpdateSceneNode(*child, &world);
+  }
+
+  // The same tree in both, node i of the hierarchy is sceneNodes[i]
+  struct Tree
+  {
+    const char* name;
+    std::vector<std::unique_ptr<SceneNode>> roots;
+    std::vector<SceneNode*> sceneNodes;
+    std::vector<TransformHandle> handles;
+    TransformHierarchy hierarchy;
+
+    void Add(SceneNode* parent, uint32 parentIndex)
+    {
+      std::unique_ptr<SceneNode> node = std::make_unique<SceneNode>();
+      sceneNodes.push_back(node.get());
+      handles.push_back(hierarchy.Create(parent != nullptr ? handles[parentIndex] : TransformHandle()));
+      if (parent != nullptr)
+        parent->children.push_back(std::move(node));
+      else
+        roots.push_back(std::move(node));
+    }
+  };
+
+  void BuildWideTree(Tree& tree, uint32 nodeCount)
+  {
+    tree.name = "wide";
+    tree.Add(nullptr, 0);
+    for (uint32 group = 0; group < WideGroupCount; ++group)
+    {
+      const uint32 groupIndex = (uint32)tree.sceneNodes.size();
+      tree.Add(tree.sceneNodes[0], 0);
+      for (uint32 child = 0; child < nodeCount / WideGroupCount; ++child)
+        tree.Add(tree.sceneNodes[groupIndex], groupIndex);
+    }
+  }
+
+  void BuildDeepTree(Tree& tree, uint32 nodeCount)
+  {
+    tree.name = "deep";
+    for (uint32 chain = 0; chain < nodeCount / ChainDepth; ++chain)
+    {
+      tree.Add(nullptr, 0);
+      for (uint32 depth = 1; depth < ChainDepth; ++depth)
+      {
+        const uint32 parentIndex = (uint32)tree.sceneNodes.size() - 1;
+        tree.Add(tree.sceneNodes[parentIndex], parentIndex);
+      }
+    }
+  }
+
+  void MoveNodes(Tree& tree, float dirtyShare, std::mt19937& random)
+  {
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    const uint32 nodeCount = (uint32)tree.sceneNodes.size();
+    const uint32 movedCount = std::max(1u, (uint32)(nodeCount * dirtyShare));
+    for (uint32 moved = 0; moved < movedCount; ++moved)
+    {
+      const uint32 node = movedCount == nodeCount ? moved : random() % nodeCount;
+      const Vec3 position(offset(random), offset(random), offset(random));
+      Vec4 rotation;
+      DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationNormal(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), offset(random) * 0.1f));
+
+      tree.sceneNodes[node]->position = position;
+      tree.sceneNodes[node]->rotation = rotation;
+      tree.hierarchy.SetLocalPosition(tree.handles[node], position);
+      tree.hierarchy.SetLocalRotation(tree.handles[node], rotation);
+    }
+  }
+
+  bool CompareWorldMatrices(const Tree& tree)
+  {
+    for (uint32 node = 0; node < (uint32)tree.sceneNodes.size(); ++node)
+    {
+      const Mat4x4& expected = tree.sceneNodes[node]->world;
+      const Mat4x4& world = tree.hierarchy.GetWorldMatrix(tree.handles[node]);
+      for (uint32 row = 0; row < 4; ++row)
+      {
+        for (uint32 column = 0; column < 4; ++column)
+        {
+          if (fabsf(world.m[row][column] - expected.m[row][column]) > Tolerance)
+          {
+            printf("FAILED: %s tree, node %u does not have the world matrix of the scene graph\n", tree.name, node);
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool RunTree(Tree& tree, float dirtyShare, JobSystem& jobSystem, const BenchmarkOptions& options)
+  {
+    std::mt19937 random(options.seed);
+
+    // The first update sorts the levels
+    tree.hierarchy.Update(&jobSystem);
+
+    double sceneGraph = 0.0;
+    double serial = 0.0;
+    double parallel = 0.0;
+    bool passed = true;
+    for (uint32 frame = 0; frame < options.frameCount * 2; ++frame)
+    {
+      MoveNodes(tree, dirtyShare, random);
+
+      auto start = ToolClock::now();
+      for (const std::unique_ptr<SceneNode>& root : tree.roots)
+        UpdateSceneNode(*root, nullptr);
+      sceneGraph += GetMilliseconds(start);
+
+      // Frames alternate between the calling thread and the job system
+      const bool useJobs = frame % 2 == 1;
+      start = ToolClock::now();
+      tree.hierarchy.Update(useJobs ? &jobSystem : nullptr);
+      (useJobs ? parallel : serial) += GetMilliseconds(start);
+
+      passed = passed && CompareWorldMatrices(tree);
+    }
+
+    printf("%6s %8u %6u %8.0f%% %12.3f %12.3f %12.3f\n", tree.name, tree.hierarchy.GetCount(), tree.hierarchy.GetDepthCount(), dirtyShare * 100.0f,
+      sceneGraph / (options.frameCount * 2), serial / options.frameCount, parallel / options.frameCount);
+    return passed;
+  }
+
+  bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--nodes", options.nodeCount);
+    commandLine.Add("--frames", options.frameCount);
+    commandLine.Add("--workers", options.workerCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.nodeCount >= ChainDepth && options.nodeCount >= WideGroupCount && options.frameCount > 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--nodes n, at least %u] [--frames n] [--workers n] [--seed n]\n", argv[0], ChainDepth);
+    return EXIT_FAILURE;
+  }
+
+  JobSystem jobSystem(options.workerCount);
+  printf("%u frames, %u workers, ms/frame\n", options.frameCount, jobSystem.GetWorkerCount());
+  printf("%6s %8s %6s %9s %12s %12s %12s\n", "tree", "nodes", "depth", "moved", "scene graph", "hierarchy", "with jobs");
+
+  bool passed = true;
+  for (float dirtyShare : { 0.01f, 1.0f })
+  {
+    Tree wide;
+    BuildWideTree(wide, options.nodeCount);
+    passed = RunTree(wide, dirtyShare, jobSystem, options) && passed;
+
+    Tree deep;
+    BuildDeepTree(deep, options.nodeCount);
+    passed = RunTree(deep, dirtyShare, jobSystem, options) && passed;
+  }
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  printf("All checks passed\n");
+  return EXIT_SUCCESS;
+}
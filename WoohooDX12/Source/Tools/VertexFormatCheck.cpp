@@ -0,0 +1,370 @@
+// Compact vertex formats, see Core/Graphics/Geometry/VertexQuantization.h
+//
+// Usage:
+//   VertexFormatCheck [--vertices <count>] [--seed <value>]
+// Checks every half float round trip and the rounding of floats to halves, the angle error of octahedral directions, and
+// that the world matrix with the dequantization folded in places the compact positions where the full ones are.
+// Test meshes are encoded in the full and the compact layouts, the bytes per vertex and the largest error of every attribute
+// are reported and checked against the precision of the formats: a torus with every attribute, the position and colour
+// vertices of the application, a building far from the origin and a large terrain with tiled UVs.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "Maths.h"
+#include "Graphics/Geometry/VertexQuantization.h"
+#include "ToolSupport.h"
+
+using namespace WoohooDX12;
+
+namespace
+{
+  constexpr uint32 AllAttributes = (1u << (uint32)VertexAttribute::Count) - 1;
+
+  struct CheckOptions
+  {
+    uint32 vertexCount = 200000;
+    uint32 seed = 1;
+  };
+
+  // Every attribute for every vertex, the layouts pick the ones they have
+  struct TestMesh
+  {
+    std::string name;
+    uint32 attributes = 0;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> tangents;
+    std::vector<float> uvs;
+    std::vector<float> colors;
+
+    inline uint32 GetVertexCount() const { return (uint32)positions.size() / 3; }
+
+    VertexSource GetSource() const
+    {
+      VertexSource source;
+      const std::vector<float>* streams[] = { &positions, &normals, &tangents, &uvs, &colors };
+      const uint32 components[] = { 3, 3, 4, 2, 3 };
+      for (uint32 i = 0; i < (uint32)VertexAttribute::Count; ++i)
+      {
+        source.attributes[i] = streams[i]->empty() ? nullptr : streams[i]->data();
+        source.strides[i] = components[i] * sizeof(float);
+      }
+      source.vertexCount = GetVertexCount();
+      return source;
+    }
+  };
+
+  bool ParseOptions(int argc, char** argv, CheckOptions& options)
+  {
+    CommandLine commandLine;
+    commandLine.Add("--vertices", options.vertexCount);
+    commandLine.Add("--seed", options.seed);
+    if (!commandLine.Parse(argc, argv))
+      return false;
+
+    return options.vertexCount >= 100;
+  }
+
+  void RandomDirection(std::mt19937& random, float* direction)
+  {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    float lengthSq = 0.0f;
+    do
+    {
+      direction[0] = normal(random);
+      direction[1] = normal(random);
+      direction[2] = normal(random);
+      lengthSq = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+    } while (lengthSq < 1e-6f);
+
+    const float length = sqrtf(lengthSq);
+    direction[0] /= length;
+    direction[1] /= length;
+    direction[2] /= length;
+  }
+
+  float GetAngleDegrees(const float* a, const float* b)
+  {
+    const float cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    return atan2f(sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) * 57.2957795f;
+  }
+
+  void BuildTorus(uint32 vertexCount, TestMesh& mesh)
+  {
+    mesh.name = "torus, every attribute";
+    mesh.attributes = AllAttributes;
+    const uint32 segments = (uint32)sqrtf((float)vertexCount);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / segments * DirectX::XM_2PI;
+        const float v = (float)y / segments * DirectX::XM_2PI;
+        const float major = 1.5f;
+        const float minor = 0.4f;
+
+        mesh.positions.insert(mesh.positions.end(), { (major + minor * cosf(v)) * cosf(u), minor * sinf(v), (major + minor * cosf(v)) * sinf(u) });
+        mesh.normals.insert(mesh.normals.end(), { cosf(v) * cosf(u), sinf(v), cosf(v) * sinf(u) });
+        // Mirrored UVs on one half flip the handedness
+        mesh.tangents.insert(mesh.tangents.end(), { -sinf(u), 0.0f, cosf(u), x < segments / 2 ? 1.0f : -1.0f });
+        mesh.uvs.insert(mesh.uvs.end(), { (float)x / segments * 8.0f, (float)y / segments * 2.0f });
+        mesh.colors.insert(mesh.colors.end(), { 0.5f + 0.5f * cosf(u), 0.5f + 0.5f * sinf(v), (float)x / segments });
+      }
+    }
+  }
+
+  // Position and colour like the application's vertices, random in a box
+  void BuildApplicationMesh(uint32 vertexCount, uint32 seed, TestMesh& mesh)
+  {
+    mesh.name = "position and colour";
+    mesh.attributes = VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Color);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> color(0.0f, 1.0f);
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+    {
+      mesh.positions.insert(mesh.positions.end(), { position(random), position(random) * 0.25f, position(random) });
+      mesh.colors.insert(mesh.colors.end(), { color(random), color(random), color(random) });
+    }
+  }
+
+  // 20 metres of building 10 km away from the origin, the bounds keep the precision of the position
+  void BuildFarBuilding(uint32 vertexCount, uint32 seed, TestMesh& mesh)
+  {
+    mesh.name = "building 10 km away";
+    mesh.attributes = VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Normal) |
+      VertexLayout::GetBit(VertexAttribute::UV);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (uint32 vertex = 0; vertex < vertexCount; ++vertex)
+    {
+      // On the faces of a box of 10 x 20 x 10 metres
+      const uint32 face = vertex % 6;
+      float local[3] = { unit(random), unit(random), unit(random) };
+      local[face / 2] = (float)(face & 1);
+      float normal[3] = { 0.0f, 0.0f, 0.0f };
+      normal[face / 2] = (face & 1) ? 1.0f : -1.0f;
+
+      mesh.positions.insert(mesh.positions.end(), { 10000.0f + local[0] * 10.0f, local[1] * 20.0f, 10000.0f + local[2] * 10.0f });
+      mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+      mesh.uvs.insert(mesh.uvs.end(), { local[(face / 2 + 1) % 3] * 10.0f, local[(face / 2 + 2) % 3] * 10.0f });
+    }
+  }
+
+  void BuildTerrain(uint32 vertexCount, TestMesh& mesh)
+  {
+    mesh.name = "terrain 1 km, tiled UVs";
+    mesh.attributes = VertexLayout::GetBit(VertexAttribute::Position) | VertexLayout::GetBit(VertexAttribute::Normal) |
+      VertexLayout::GetBit(VertexAttribute::Tangent) | VertexLayout::GetBit(VertexAttribute::UV);
+    const uint32 segments = (uint32)sqrtf((float)vertexCount);
+    for (uint32 y = 0; y < segments; ++y)
+    {
+      for (uint32 x = 0; x < segments; ++x)
+      {
+        const float u = (float)x / (segments - 1);
+        const float v = (float)y / (segments - 1);
+        const float height = 40.0f * sinf(u * 7.0f) * cosf(v * 5.0f);
+        const float slopeX = 40.0f * 7.0f * cosf(u * 7.0f) * cosf(v * 5.0f) / 1000.0f;
+        const float slopeZ = -40.0f * 5.0f * sinf(u * 7.0f) * sinf(v * 5.0f) / 1000.0f;
+
+        mesh.positions.insert(mesh.positions.end(), { u * 1000.0f, height, v * 1000.0f });
+        mesh.normals.insert(mesh.normals.end(), { -slopeX, 1.0f, -slopeZ });
+        mesh.tangents.insert(mesh.tangents.end(), { 1.0f, slopeX, 0.0f, 1.0f });
+        mesh.uvs.insert(mesh.uvs.end(), { u * 64.0f, v * 64.0f });
+      }
+    }
+  }
+
+  bool CheckHalfFloats(uint32 seed)
+  {
+    // Every half goes back to itself, NaNs stay NaNs
+    uint32 failures = 0;
+    for (uint32 value = 0; value <= 0xFFFF; ++value)
+    {
+      const float decoded = VertexQuantizer::HalfToFloat((uint16)value);
+      const uint16 encoded = VertexQuantizer::FloatToHalf(decoded);
+      const bool isNaN = (value & 0x7C00) == 0x7C00 && (value & 0x3FF) != 0;
+      if (isNaN ? !std::isnan(decoded) || (encoded & 0x7C00) != 0x7C00 || (encoded & 0x3FF) == 0 : encoded != value)
+        failures++;
+    }
+
+    // Random floats go to the closest half
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> exponent(-26.0f, 17.0f);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    for (uint32 i = 0; i < 1000000; ++i)
+    {
+      const float value = ldexpf(mantissa(random), (int)exponent(random)) * (i & 1 ? -1.0f : 1.0f);
+      const uint16 encoded = VertexQuantizer::FloatToHalf(value);
+      const float error = fabsf(VertexQuantizer::HalfToFloat(encoded) - value);
+      if ((encoded & 0x7FFF) >= 0x7C00)
+      {
+        failures += fabsf(value) < 65520.0f ? 1 : 0;
+        continue;
+      }
+
+      // Neighbours on both sides are not closer
+      const float below = fabsf(VertexQuantizer::HalfToFloat((uint16)(encoded - ((encoded & 0x7FFF) != 0 ? 1 : 0))) - value);
+      const float above = (encoded & 0x7FFF) < 0x7BFF ? fabsf(VertexQuantizer::HalfToFloat((uint16)(encoded + 1)) - value) : FLT_MAX;
+      failures += error > below || error > above ? 1 : 0;
+    }
+
+    printf("Half floats: %u failures\n", failures);
+    return failures == 0;
+  }
+
+  bool CheckOctahedral(uint32 seed)
+  {
+    // The precision of the encodings, the layouts store them in 16-bit snorm for normals and 10-bit unorm for tangents
+    std::mt19937 random(seed);
+    TestMesh directions;
+    directions.attributes = VertexLayout::GetBit(VertexAttribute::Normal) | VertexLayout::GetBit(VertexAttribute::Tangent);
+    float exactError = 0.0f;
+    for (uint32 i = 0; i < 1000000; ++i)
+    {
+      float direction[3];
+      RandomDirection(random, direction);
+      directions.normals.insert(directions.normals.end(), direction, direction + 3);
+      directions.tangents.insert(directions.tangents.end(), { direction[0], direction[1], direction[2], (i & 1) ? 1.0f : -1.0f });
+      directions.positions.insert(directions.positions.end(), { 0.0f, 0.0f, 0.0f });
+
+      float x;
+      float y;
+      float decoded[3];
+      VertexQuantizer::EncodeOctahedral(direction, x, y);
+      VertexQuantizer::DecodeOctahedral(x, y, decoded);
+      exactError = std::max(exactError, GetAngleDegrees(direction, decoded));
+    }
+
+    const VertexLayout layout = VertexLayout::Make(directions.attributes, directions.attributes);
+    std::vector<uint8> encoded((size_t)layout.stride * directions.GetVertexCount());
+    const VertexSource source = directions.GetSource();
+    VertexQuantizer::Encode(source, layout, PositionQuantization(), encoded.data());
+    const VertexQuantizationError error = VertexQuantizer::MeasureError(source, encoded.data(), layout, PositionQuantization());
+
+    printf("Octahedral: %.5f degrees unquantized, %.5f degrees in 16-bit snorm, %.4f degrees in 10-bit unorm, %u handedness errors\n",
+      exactError, error.normalDegrees, error.tangentDegrees, error.handednessErrors);
+    return exactError < 0.001f && error.normalDegrees < 0.01f && error.tangentDegrees < 0.2f && error.handednessErrors == 0;
+  }
+
+  // World matrix with the dequantization against the world matrix applied to the decoded positions
+  bool CheckFolding(const TestMesh& mesh, uint32 seed)
+  {
+    const PositionQuantization quantization = VertexQuantizer::ComputePositionQuantization(mesh.positions.data(), 3 * sizeof(float), mesh.GetVertexCount());
+    const VertexLayout layout = VertexLayout::Make(VertexLayout::GetBit(VertexAttribute::Position), VertexLayout::GetBit(VertexAttribute::Position));
+    std::vector<uint8> encoded((size_t)layout.stride * mesh.GetVertexCount());
+    VertexQuantizer::Encode(mesh.GetSource(), layout, quantization, encoded.data());
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> angle(0.0f, DirectX::XM_2PI);
+    Mat4x4 world;
+    float axis[3];
+    RandomDirection(random, axis);
+    const Mat rotation = DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(axis[0], axis[1], axis[2], 0.0f), angle(random));
+    DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(2.0f, 2.0f, 2.0f), rotation),
+      DirectX::XMMatrixTranslation(-10000.0f, 5.0f, -10000.0f)));
+    Mat4x4 folded;
+    VertexQuantizer::FoldDequantization(quantization, world, folded);
+
+    float largestError = 0.0f;
+    for (uint32 vertex = 0; vertex < mesh.GetVertexCount(); ++vertex)
+    {
+      // The input assembler reads the unorm codes as [0, 1]
+      uint16 codes[4];
+      memcpy(codes, &encoded[(size_t)vertex * layout.stride], sizeof(codes));
+      const Vec stored = DirectX::XMVectorSet(codes[0] / 65535.0f, codes[1] / 65535.0f, codes[2] / 65535.0f, 1.0f);
+
+      DecodedVertex decoded;
+      VertexQuantizer::Decode(encoded.data(), layout, quantization, vertex, decoded);
+      const Vec expected = DirectX::XMVector3Transform(DirectX::XMVectorSet(decoded.position[0], decoded.position[1], decoded.position[2], 1.0f),
+        DirectX::XMLoadFloat4x4(&world));
+      const Vec result = DirectX::XMVector3Transform(stored, DirectX::XMLoadFloat4x4(&folded));
+      largestError = std::max(largestError, DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(expected, result))));
+    }
+
+    // Both sides round at the magnitude of the translation
+    const float tolerance = 20000.0f * FLT_EPSILON * 4.0f;
+    printf("Folded dequantization: %.6f largest distance to the dequantized then transformed positions, tolerance %.6f\n", largestError, tolerance);
+    return largestError <= tolerance;
+  }
+
+  bool CheckMesh(const TestMesh& mesh)
+  {
+    const VertexSource source = mesh.GetSource();
+    const PositionQuantization quantization = VertexQuantizer::ComputePositionQuantization(mesh.positions.data(), 3 * sizeof(float), mesh.GetVertexCount());
+
+    bool passed = true;
+    printf("%s: %u vertices\n", mesh.name.c_str(), mesh.GetVertexCount());
+    for (uint32 compact = 0; compact < 2; ++compact)
+    {
+      const VertexLayout layout = VertexLayout::Make(mesh.attributes, compact ? mesh.attributes : 0);
+      std::vector<uint8> encoded((size_t)layout.stride * mesh.GetVertexCount());
+      VertexQuantizer::Encode(source, layout, quantization, encoded.data());
+      const VertexQuantizationError error = VertexQuantizer::MeasureError(source, encoded.data(), layout, quantization);
+
+      printf("  %-8s %2u bytes/vertex  position %.6f", compact ? "compact" : "full", layout.stride, error.position);
+      if (layout.Has(VertexAttribute::Normal))
+        printf("  normal %.4f deg", error.normalDegrees);
+      if (layout.Has(VertexAttribute::Tangent))
+        printf("  tangent %.4f deg", error.tangentDegrees);
+      if (layout.Has(VertexAttribute::UV))
+        printf("  uv %.6f", error.uv);
+      if (layout.Has(VertexAttribute::Color))
+        printf("  colour %.5f", error.color);
+      printf("\n");
+
+      if (!compact)
+      {
+        passed = passed && error.position == 0.0f && error.uv == 0.0f && error.color == 0.0f && error.normalDegrees < 0.01f &&
+          error.tangentDegrees < 0.01f && error.handednessErrors == 0;
+        continue;
+      }
+
+      // Half a step of every code, a half float has 11 bits of mantissa
+      float largestUV = 0.0f;
+      for (float uv : mesh.uvs)
+        largestUV = std::max(largestUV, fabsf(uv));
+      const float positionBound = quantization.scale * 0.5f / 65535.0f * sqrtf(3.0f) * 1.01f + quantization.scale * FLT_EPSILON * 4.0f;
+      const float uvBound = ldexpf(1.0f, (int)floorf(log2f(std::max(largestUV, 1e-6f))) - 11);
+
+      passed = passed && error.position <= positionBound && error.normalDegrees < 0.01f && error.tangentDegrees < 0.2f &&
+        error.handednessErrors == 0 && error.uv <= uvBound && error.color <= 0.5f / 255.0f + 1e-6f;
+      printf("  %.0f%% of the full size, position bound %.6f (%.7f of the extent)\n", 100.0f * layout.stride / VertexLayout::Make(mesh.attributes, 0).stride,
+        positionBound, positionBound / quantization.scale);
+    }
+    return passed;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  CheckOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    printf("Usage: %s [--vertices n] [--seed n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<TestMesh> meshes(4);
+  BuildTorus(options.vertexCount, meshes[0]);
+  BuildApplicationMesh(options.vertexCount, options.seed, meshes[1]);
+  BuildFarBuilding(options.vertexCount, options.seed, meshes[2]);
+  BuildTerrain(options.vertexCount, meshes[3]);
+
+  bool passed = true;
+  passed = CheckHalfFloats(options.seed) && passed;
+  passed = CheckOctahedral(options.seed) && passed;
+  passed = CheckFolding(meshes[2], options.seed) && passed;
+  for (const TestMesh& mesh : meshes)
+    passed = CheckMesh(mesh) && passed;
+
+  printf(passed ? "All checks passed\n" : "Checks failed\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}